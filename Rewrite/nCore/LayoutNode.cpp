@@ -0,0 +1,674 @@
+#include "LayoutNode.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+struct LayoutNode::Context {
+  // The content box, relative to the node.
+  float left;
+  float top;
+  float width;
+  float height;
+  float dpiX;
+  float dpiY;
+  // True if the main axis is horizontal.
+  bool horizontal;
+  float mainGap;
+  float crossGap;
+
+  float MainLength() const { return horizontal ? width : height; }
+  float CrossLength() const { return horizontal ? height : width; }
+  float MainDpi() const { return horizontal ? dpiX : dpiY; }
+  float CrossDpi() const { return horizontal ? dpiY : dpiX; }
+};
+
+
+LayoutNode::LayoutNode(void *owner)
+  : mOwner(owner)
+  , mParent(nullptr)
+  , mLayout()
+  , mItem()
+  , mIsItem(false)
+  , mRect()
+  , mRectChanged(false)
+  , mDirty(true)
+  , mArrangedWidth(-1)
+  , mArrangedHeight(-1)
+  , mArrangedDpiX(0)
+  , mArrangedDpiY(0)
+  , mMeasureDirty(true)
+  , mMeasuredAvailableWidth(-1)
+  , mMeasuredAvailableHeight(-1)
+  , mMeasuredDpiX(0)
+  , mMeasuredDpiY(0)
+  , mMeasuredWidth(0)
+  , mMeasuredHeight(0)
+{
+}
+
+
+LayoutNode::~LayoutNode() {
+  if (mParent) {
+    mParent->RemoveChild(this);
+  }
+  for (LayoutNode *child : mChildren) {
+    child->mParent = nullptr;
+  }
+}
+
+
+void LayoutNode::AppendChild(LayoutNode *child) {
+  assert(child->mParent == nullptr);
+  child->mParent = this;
+  mChildren.push_back(child);
+  MarkDirty();
+}
+
+
+void LayoutNode::RemoveChild(LayoutNode *child) {
+  auto iter = std::find(mChildren.begin(), mChildren.end(), child);
+  if (iter != mChildren.end()) {
+    mChildren.erase(iter);
+    child->mParent = nullptr;
+    MarkDirty();
+  }
+}
+
+
+void LayoutNode::SetLayout(const PaneLayout *layout) {
+  if (layout) {
+    mLayout = *layout;
+    mColumns.assign(layout->columns, layout->columns + layout->numColumns);
+    mRows.assign(layout->rows, layout->rows + layout->numRows);
+  } else {
+    // Value-initialization zeroes the lengths, which have empty constructors.
+    mLayout = PaneLayout();
+    mColumns.clear();
+    mRows.clear();
+  }
+  mLayout.columns = nullptr;
+  mLayout.rows = nullptr;
+  MarkDirty();
+}
+
+
+void LayoutNode::SetItem(const PaneLayoutItem *item) {
+  mIsItem = item != nullptr;
+  if (item) {
+    mItem = *item;
+  }
+  if (mParent) {
+    mParent->MarkDirty();
+  }
+}
+
+
+void LayoutNode::MarkDirty() {
+  // A clean parent may have skipped measuring some of its children, so we can't stop at the first
+  // node which is already dirty.
+  for (LayoutNode *node = this; node; node = node->mParent) {
+    node->mDirty = true;
+    node->mMeasureDirty = true;
+  }
+}
+
+
+bool LayoutNode::HasLayout() const {
+  return mLayout.type != PaneLayout::Type::None;
+}
+
+
+bool LayoutNode::IsItem() const {
+  return mIsItem;
+}
+
+
+void *LayoutNode::GetOwner() const {
+  return mOwner;
+}
+
+
+LayoutNode *LayoutNode::GetParent() const {
+  return mParent;
+}
+
+
+const std::vector<LayoutNode*> &LayoutNode::GetChildren() const {
+  return mChildren;
+}
+
+
+const LayoutRect &LayoutNode::GetRect() const {
+  return mRect;
+}
+
+
+bool LayoutNode::TakeRectChanged() {
+  bool changed = mRectChanged;
+  mRectChanged = false;
+  return changed;
+}
+
+
+void LayoutNode::Arrange(float width, float height, float dpiX, float dpiY) {
+  if (!mDirty && width == mArrangedWidth && height == mArrangedHeight && dpiX == mArrangedDpiX
+      && dpiY == mArrangedDpiY) {
+    return;
+  }
+  mDirty = false;
+  mArrangedWidth = width;
+  mArrangedHeight = height;
+  mArrangedDpiX = dpiX;
+  mArrangedDpiY = dpiY;
+
+  if (mLayout.type == PaneLayout::Type::None || mChildren.empty()) {
+    return;
+  }
+
+  Context ctx;
+  ctx.dpiX = dpiX;
+  ctx.dpiY = dpiY;
+  ctx.left = mLayout.padding.left.Evaluate(width, dpiX);
+  ctx.top = mLayout.padding.top.Evaluate(height, dpiY);
+  ctx.width = std::max(0.0f, width - ctx.left - mLayout.padding.right.Evaluate(width, dpiX));
+  ctx.height = std::max(0.0f, height - ctx.top - mLayout.padding.bottom.Evaluate(height, dpiY));
+  ctx.horizontal = mLayout.type != PaneLayout::Type::Column;
+  float rowGap = mLayout.rowGap.Evaluate(ctx.height, dpiY);
+  float columnGap = mLayout.columnGap.Evaluate(ctx.width, dpiX);
+  ctx.mainGap = ctx.horizontal ? columnGap : rowGap;
+  ctx.crossGap = ctx.horizontal ? rowGap : columnGap;
+
+  if (mLayout.type == PaneLayout::Type::Grid) {
+    ArrangeGrid(ctx);
+  } else {
+    ArrangeFlex(ctx);
+  }
+
+  for (LayoutNode *child : mChildren) {
+    if (child->mIsItem) {
+      child->Arrange(child->mRect.right - child->mRect.left,
+        child->mRect.bottom - child->mRect.top, dpiX, dpiY);
+    }
+  }
+}
+
+
+void LayoutNode::Measure(float availableWidth, float availableHeight, float dpiX, float dpiY,
+    float *width, float *height) {
+  if (!mMeasureDirty && availableWidth == mMeasuredAvailableWidth
+      && availableHeight == mMeasuredAvailableHeight && dpiX == mMeasuredDpiX
+      && dpiY == mMeasuredDpiY) {
+    *width = mMeasuredWidth;
+    *height = mMeasuredHeight;
+    return;
+  }
+
+  float paddingX = mLayout.padding.left.Evaluate(availableWidth, dpiX)
+    + mLayout.padding.right.Evaluate(availableWidth, dpiX);
+  float paddingY = mLayout.padding.top.Evaluate(availableHeight, dpiY)
+    + mLayout.padding.bottom.Evaluate(availableHeight, dpiY);
+
+  Context ctx;
+  ctx.left = 0;
+  ctx.top = 0;
+  ctx.width = std::max(0.0f, availableWidth - paddingX);
+  ctx.height = std::max(0.0f, availableHeight - paddingY);
+  ctx.dpiX = dpiX;
+  ctx.dpiY = dpiY;
+  ctx.horizontal = mLayout.type != PaneLayout::Type::Column;
+  float rowGap = mLayout.rowGap.Evaluate(ctx.height, dpiY);
+  float columnGap = mLayout.columnGap.Evaluate(ctx.width, dpiX);
+  ctx.mainGap = ctx.horizontal ? columnGap : rowGap;
+  ctx.crossGap = ctx.horizontal ? rowGap : columnGap;
+
+  float contentWidth = 0, contentHeight = 0;
+  switch (mLayout.type) {
+  case PaneLayout::Type::Row:
+  case PaneLayout::Type::Column:
+    {
+      float mainLength = ctx.MainLength();
+      float lineMain = 0, lineCross = 0, totalMain = 0, totalCross = 0;
+      int lineCount = 0, itemsOnLine = 0;
+      for (LayoutNode *child : mChildren) {
+        if (!child->mIsItem) {
+          continue;
+        }
+        float main = child->MainSize(ctx);
+        float cross = child->CrossSize(ctx);
+        if (mLayout.wrap && itemsOnLine > 0 && lineMain + ctx.mainGap + main > mainLength) {
+          totalMain = std::max(totalMain, lineMain);
+          totalCross += lineCross + (lineCount > 0 ? ctx.crossGap : 0);
+          ++lineCount;
+          lineMain = 0;
+          lineCross = 0;
+          itemsOnLine = 0;
+        }
+        lineMain += main + (itemsOnLine > 0 ? ctx.mainGap : 0);
+        lineCross = std::max(lineCross, cross);
+        ++itemsOnLine;
+      }
+      if (itemsOnLine > 0) {
+        totalMain = std::max(totalMain, lineMain);
+        totalCross += lineCross + (lineCount > 0 ? ctx.crossGap : 0);
+      }
+      contentWidth = ctx.horizontal ? totalMain : totalCross;
+      contentHeight = ctx.horizontal ? totalCross : totalMain;
+    }
+    break;
+
+  case PaneLayout::Type::Grid:
+    {
+      // Items are placed the same way ArrangeGrid places them, so that spans which wrap to a new
+      // row, or reach past the explicit tracks, are accounted for.
+      unsigned numColumns = std::max(1u, (unsigned)mColumns.size());
+      unsigned usedColumns, lastRow;
+      PlaceGridItems(numColumns, &usedColumns, &lastRow);
+      numColumns = std::max(numColumns, usedColumns);
+      for (unsigned i = 0; i < numColumns; ++i) {
+        if (mColumns.empty()) {
+          contentWidth += ctx.width;
+        } else {
+          contentWidth += mColumns[std::min(i, (unsigned)mColumns.size() - 1)].Evaluate(ctx.width,
+            dpiX);
+        }
+      }
+      contentWidth += (numColumns - 1) * columnGap;
+      for (unsigned i = 0; i < lastRow; ++i) {
+        if (mRows.empty()) {
+          contentHeight += ctx.height;
+        } else {
+          contentHeight += mRows[std::min(i, (unsigned)mRows.size() - 1)].Evaluate(ctx.height,
+            dpiY);
+        }
+      }
+      if (lastRow > 0) {
+        contentHeight += (lastRow - 1) * rowGap;
+      }
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  mMeasureDirty = false;
+  mMeasuredAvailableWidth = availableWidth;
+  mMeasuredAvailableHeight = availableHeight;
+  mMeasuredDpiX = dpiX;
+  mMeasuredDpiY = dpiY;
+  mMeasuredWidth = *width = contentWidth + paddingX;
+  mMeasuredHeight = *height = contentHeight + paddingY;
+}
+
+
+void LayoutNode::ArrangeFlex(const Context &ctx) {
+  struct Line {
+    size_t begin;
+    size_t end;
+    int count;
+    float cross;
+  };
+  std::vector<Line> lines;
+
+  const float mainLength = ctx.MainLength();
+  const float crossLength = ctx.CrossLength();
+  const size_t numChildren = mChildren.size();
+
+  mBaseSizes.assign(numChildren, 0.0f);
+  mMainSizes.assign(numChildren, 0.0f);
+  mFrozen.assign(numChildren, false);
+
+  // Break the items into lines, based on their hypothetical main sizes.
+  Line line = { 0, 0, 0, 0 };
+  float lineMain = 0;
+  for (size_t i = 0; i < numChildren; ++i) {
+    LayoutNode *child = mChildren[i];
+    if (!child->mIsItem) {
+      continue;
+    }
+    mBaseSizes[i] = child->MainSize(ctx);
+    mMainSizes[i] = child->ClampMain(ctx, mBaseSizes[i]);
+    if (mLayout.wrap && line.count > 0 && lineMain + ctx.mainGap + mMainSizes[i] > mainLength) {
+      line.end = i;
+      lines.push_back(line);
+      line.begin = i;
+      line.count = 0;
+      line.cross = 0;
+      lineMain = 0;
+    }
+    lineMain += mMainSizes[i] + (line.count > 0 ? ctx.mainGap : 0);
+    line.cross = std::max(line.cross, child->CrossSize(ctx));
+    ++line.count;
+  }
+  if (line.count == 0) {
+    return;
+  }
+  line.end = numChildren;
+  lines.push_back(line);
+
+  if (!mLayout.wrap) {
+    lines[0].cross = crossLength;
+  }
+
+  float totalCross = (lines.size() - 1) * ctx.crossGap;
+  for (const Line &l : lines) {
+    totalCross += l.cross;
+  }
+  float crossPosition = mLayout.wrapReverse ? crossLength - totalCross : 0;
+  if (mLayout.wrapReverse) {
+    std::reverse(lines.begin(), lines.end());
+  }
+
+  for (const Line &l : lines) {
+    const float gaps = (l.count - 1) * ctx.mainGap;
+
+    // Resolve the flexible lengths. Items which hit their limits are frozen, and the remaining
+    // free space is distributed among the others. As in CSS, the free space and the scaled shrink
+    // factors are based on the flex base sizes of the items which aren't frozen, rather than on
+    // their clamped sizes.
+    for (int iteration = 0; iteration < l.count; ++iteration) {
+      float used = gaps;
+      for (size_t i = l.begin; i < l.end; ++i) {
+        used += mFrozen[i] ? mMainSizes[i] : mBaseSizes[i];
+      }
+      float freeSpace = mainLength - used;
+      bool growing = freeSpace > 0;
+      if (freeSpace == 0) {
+        break;
+      }
+
+      float totalFactor = 0;
+      for (size_t i = l.begin; i < l.end; ++i) {
+        const LayoutNode *child = mChildren[i];
+        if (child->mIsItem && !mFrozen[i]) {
+          totalFactor += growing ? child->mItem.grow : child->mItem.shrink * mBaseSizes[i];
+        }
+      }
+      if (totalFactor <= 0) {
+        break;
+      }
+
+      bool clamped = false;
+      for (size_t i = l.begin; i < l.end; ++i) {
+        LayoutNode *child = mChildren[i];
+        if (!child->mIsItem || mFrozen[i]) {
+          continue;
+        }
+        float factor = growing ? child->mItem.grow : child->mItem.shrink * mBaseSizes[i];
+        float target = mBaseSizes[i] + freeSpace * factor / totalFactor;
+        float limited = child->ClampMain(ctx, target);
+        if (limited != target) {
+          mMainSizes[i] = limited;
+          mFrozen[i] = true;
+          clamped = true;
+        }
+      }
+
+      if (!clamped) {
+        for (size_t i = l.begin; i < l.end; ++i) {
+          const LayoutNode *child = mChildren[i];
+          if (child->mIsItem && !mFrozen[i]) {
+            float factor = growing ? child->mItem.grow : child->mItem.shrink * mBaseSizes[i];
+            mMainSizes[i] = mBaseSizes[i] + freeSpace * factor / totalFactor;
+          }
+        }
+        break;
+      }
+    }
+
+    // Distribute whatever space is left.
+    float used = gaps;
+    for (size_t i = l.begin; i < l.end; ++i) {
+      used += mMainSizes[i];
+    }
+    float freeSpace = std::max(0.0f, mainLength - used);
+    float mainPosition = 0, spacing = 0;
+    switch (mLayout.justifyContent) {
+    case PaneLayout::Align::End:
+      mainPosition = freeSpace;
+      break;
+
+    case PaneLayout::Align::Center:
+      mainPosition = freeSpace / 2;
+      break;
+
+    case PaneLayout::Align::SpaceBetween:
+      spacing = l.count > 1 ? freeSpace / (l.count - 1) : 0;
+      break;
+
+    case PaneLayout::Align::SpaceAround:
+      spacing = freeSpace / l.count;
+      mainPosition = spacing / 2;
+      break;
+
+    default:
+      break;
+    }
+
+    for (size_t i = l.begin; i < l.end; ++i) {
+      LayoutNode *child = mChildren[i];
+      if (!child->mIsItem) {
+        continue;
+      }
+
+      float crossSize, crossOffset;
+      switch (child->GetAlign(mLayout.alignItems)) {
+      case PaneLayout::Align::End:
+        crossSize = std::min(l.cross, child->CrossSize(ctx));
+        crossOffset = l.cross - crossSize;
+        break;
+
+      case PaneLayout::Align::Center:
+        crossSize = std::min(l.cross, child->CrossSize(ctx));
+        crossOffset = (l.cross - crossSize) / 2;
+        break;
+
+      case PaneLayout::Align::Start:
+        crossSize = std::min(l.cross, child->CrossSize(ctx));
+        crossOffset = 0;
+        break;
+
+      default:
+        crossSize = l.cross;
+        crossOffset = 0;
+        break;
+      }
+
+      float main = mLayout.reverse ? mainLength - mainPosition - mMainSizes[i] : mainPosition;
+      float cross = crossPosition + crossOffset;
+      if (ctx.horizontal) {
+        SetChildRect(child, ctx.left + main, ctx.top + cross, mMainSizes[i], crossSize);
+      } else {
+        SetChildRect(child, ctx.left + cross, ctx.top + main, crossSize, mMainSizes[i]);
+      }
+
+      mainPosition += mMainSizes[i] + ctx.mainGap + spacing;
+    }
+
+    crossPosition += l.cross + ctx.crossGap;
+  }
+}
+
+
+void LayoutNode::ArrangeGrid(const Context &ctx) {
+  // Fixed tracks, where the last one repeats as far as needed.
+  std::vector<float> columns, rows;
+  if (mColumns.empty()) {
+    columns.push_back(ctx.width);
+  } else {
+    for (const NLENGTH &length : mColumns) {
+      columns.push_back(length.Evaluate(ctx.width, ctx.dpiX));
+    }
+  }
+  if (mRows.empty()) {
+    rows.push_back(ctx.height);
+  } else {
+    for (const NLENGTH &length : mRows) {
+      rows.push_back(length.Evaluate(ctx.height, ctx.dpiY));
+    }
+  }
+
+  unsigned usedColumns, usedRows;
+  PlaceGridItems((unsigned)columns.size(), &usedColumns, &usedRows);
+
+  auto trackOffset = [](const std::vector<float> &tracks, float gap, unsigned index) -> float {
+    float offset = 0;
+    unsigned explicitTracks = std::min(index, (unsigned)tracks.size());
+    for (unsigned i = 0; i < explicitTracks; ++i) {
+      offset += tracks[i] + gap;
+    }
+    return offset + (index - explicitTracks) * (tracks.back() + gap);
+  };
+
+  // Columns are placed according to justifyContent.
+  float usedWidth = trackOffset(columns, ctx.mainGap, usedColumns) - ctx.mainGap;
+  float freeWidth = std::max(0.0f, ctx.width - usedWidth);
+  float gridLeft = ctx.left;
+  switch (mLayout.justifyContent) {
+  case PaneLayout::Align::End:
+    gridLeft += freeWidth;
+    break;
+
+  case PaneLayout::Align::Center:
+  case PaneLayout::Align::SpaceAround:
+    gridLeft += freeWidth / 2;
+    break;
+
+  default:
+    break;
+  }
+
+  size_t placementIndex = 0;
+  for (LayoutNode *child : mChildren) {
+    if (!child->mIsItem) {
+      continue;
+    }
+    const GridPlacement &placement = mPlacements[placementIndex++];
+
+    float cellLeft = gridLeft + trackOffset(columns, ctx.mainGap, placement.column);
+    float cellTop = ctx.top + trackOffset(rows, ctx.crossGap, placement.row);
+    float cellWidth = trackOffset(columns, ctx.mainGap, placement.column + placement.columnSpan)
+      - trackOffset(columns, ctx.mainGap, placement.column) - ctx.mainGap;
+    float cellHeight = trackOffset(rows, ctx.crossGap, placement.row + placement.rowSpan)
+      - trackOffset(rows, ctx.crossGap, placement.row) - ctx.crossGap;
+
+    PaneLayout::Align align = child->GetAlign(mLayout.alignItems);
+    if (align == PaneLayout::Align::Stretch) {
+      SetChildRect(child, cellLeft, cellTop, cellWidth, cellHeight);
+      continue;
+    }
+
+    float width, height;
+    if (child->mItem.fitContent) {
+      child->Measure(cellWidth, cellHeight, ctx.dpiX, ctx.dpiY, &width, &height);
+    } else {
+      width = child->mItem.basis.Evaluate(cellWidth, ctx.dpiX);
+      height = child->mItem.crossSize.Evaluate(cellHeight, ctx.dpiY);
+    }
+    width = std::min(width, cellWidth);
+    height = std::min(height, cellHeight);
+
+    float x = cellLeft, y = cellTop;
+    if (align == PaneLayout::Align::End) {
+      x += cellWidth - width;
+      y += cellHeight - height;
+    } else if (align == PaneLayout::Align::Center) {
+      x += (cellWidth - width) / 2;
+      y += (cellHeight - height) / 2;
+    }
+    SetChildRect(child, x, y, width, height);
+  }
+}
+
+
+void LayoutNode::PlaceGridItems(unsigned numColumns, unsigned *usedColumns, unsigned *usedRows) {
+  mPlacements.clear();
+  *usedColumns = 0;
+  *usedRows = 0;
+
+  unsigned cursorRow = 0, cursorColumn = 0;
+  for (LayoutNode *child : mChildren) {
+    if (!child->mIsItem) {
+      continue;
+    }
+    GridPlacement placement;
+    placement.rowSpan = std::max(1u, child->mItem.rowSpan);
+    placement.columnSpan = std::max(1u, std::min(numColumns, child->mItem.columnSpan));
+    if (child->mItem.column == LAYOUT_AUTO_PLACE) {
+      if (cursorColumn > 0 && cursorColumn + placement.columnSpan > numColumns) {
+        ++cursorRow;
+        cursorColumn = 0;
+      }
+      placement.column = cursorColumn;
+      placement.row = child->mItem.row == LAYOUT_AUTO_PLACE ? cursorRow : child->mItem.row;
+      cursorColumn += placement.columnSpan;
+      if (cursorColumn >= numColumns) {
+        ++cursorRow;
+        cursorColumn = 0;
+      }
+    } else {
+      placement.column = child->mItem.column;
+      placement.row = child->mItem.row == LAYOUT_AUTO_PLACE ? cursorRow : child->mItem.row;
+    }
+    *usedColumns = std::max(*usedColumns, placement.column + placement.columnSpan);
+    *usedRows = std::max(*usedRows, placement.row + placement.rowSpan);
+    mPlacements.push_back(placement);
+  }
+}
+
+
+void LayoutNode::SetChildRect(LayoutNode *child, float left, float top, float width,
+    float height) {
+  LayoutRect rect = { left, top, left + std::max(0.0f, width), top + std::max(0.0f, height) };
+  if (memcmp(&rect, &child->mRect, sizeof(LayoutRect)) != 0) {
+    child->mRect = rect;
+    child->mRectChanged = true;
+  }
+}
+
+
+float LayoutNode::MainSize(const Context &ctx) {
+  if (mItem.fitContent) {
+    float width, height;
+    Measure(ctx.width, ctx.height, ctx.dpiX, ctx.dpiY, &width, &height);
+    return ctx.horizontal ? width : height;
+  }
+  return mItem.basis.Evaluate(ctx.MainLength(), ctx.MainDpi());
+}
+
+
+float LayoutNode::CrossSize(const Context &ctx) {
+  if (mItem.fitContent) {
+    float width, height;
+    Measure(ctx.width, ctx.height, ctx.dpiX, ctx.dpiY, &width, &height);
+    return ctx.horizontal ? height : width;
+  }
+  return mItem.crossSize.Evaluate(ctx.CrossLength(), ctx.CrossDpi());
+}
+
+
+float LayoutNode::ClampMain(const Context &ctx, float size) const {
+  float maxSize = mItem.maxSize.Evaluate(ctx.MainLength(), ctx.MainDpi());
+  if (maxSize > 0) {
+    size = std::min(size, maxSize);
+  }
+  return std::max(0.0f, std::max(size, mItem.minSize.Evaluate(ctx.MainLength(), ctx.MainDpi())));
+}
+
+
+PaneLayout::Align LayoutNode::GetAlign(PaneLayout::Align containerAlign) const {
+  PaneLayout::Align align = mItem.alignSelf;
+  if (align == PaneLayout::Align::Auto) {
+    align = containerAlign;
+  }
+  switch (align) {
+  case PaneLayout::Align::Start:
+  case PaneLayout::Align::End:
+  case PaneLayout::Align::Center:
+    return align;
+
+  default:
+    return PaneLayout::Align::Stretch;
+  }
+}
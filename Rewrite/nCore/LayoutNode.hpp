@@ -0,0 +1,128 @@
+#pragma once
+
+#include "../nCoreApi/PaneLayout.h"
+
+#include <vector>
+
+/// <summary>
+/// Position of a node, in pixels, relative to the top-left corner of its parent.
+/// </summary>
+struct LayoutRect {
+  float left;
+  float top;
+  float right;
+  float bottom;
+};
+
+/// <summary>
+/// A node in the layout tree. Every pane owns one, and the tree mirrors the parts of the pane tree
+/// which take part in flex or grid layouts. This class has no dependencies on windowing, so that
+/// it can be driven with synthetic trees.
+/// </summary>
+/// <remarks>
+/// Measurements and arrangements are cached per node. Changing the layout of a node, or the item
+/// settings of one of its children, invalidates the node and its ancestors only, so a relayout
+/// re-measures just the dirty subtrees and skips clean ones which are given the same box.
+/// </remarks>
+class LayoutNode {
+public:
+  explicit LayoutNode(void *owner);
+  ~LayoutNode();
+
+  LayoutNode(const LayoutNode&) = delete;
+  LayoutNode &operator=(const LayoutNode&) = delete;
+
+public:
+  // Adds a child to the end of this node's item list.
+  void AppendChild(LayoutNode *child);
+
+  // Removes a child from this node.
+  void RemoveChild(LayoutNode *child);
+
+  // Sets how this node arranges its children. Null disables the layout.
+  void SetLayout(const PaneLayout *layout);
+
+  // Sets how this node is placed by its parent. Null excludes the node from its parent's layout.
+  void SetItem(const PaneLayoutItem *item);
+
+  // Invalidates the cached measurement and arrangement of this node and its ancestors.
+  void MarkDirty();
+
+  // Arranges the subtree rooted at this node within a box of the given size.
+  void Arrange(float width, float height, float dpiX, float dpiY);
+
+  // Measures the size this node would like to have, given the available space.
+  void Measure(float availableWidth, float availableHeight, float dpiX, float dpiY,
+    float *width, float *height);
+
+public:
+  bool HasLayout() const;
+  bool IsItem() const;
+  void *GetOwner() const;
+  LayoutNode *GetParent() const;
+  const std::vector<LayoutNode*> &GetChildren() const;
+  const LayoutRect &GetRect() const;
+
+  // Returns true if the rect has changed since the last call to this function.
+  bool TakeRectChanged();
+
+private:
+  struct Context;
+
+  // The cells of a grid item.
+  struct GridPlacement {
+    unsigned row;
+    unsigned column;
+    unsigned rowSpan;
+    unsigned columnSpan;
+  };
+
+  void ArrangeFlex(const Context&);
+  void ArrangeGrid(const Context&);
+  // Places the grid items in mPlacements, and returns the number of tracks they cover.
+  void PlaceGridItems(unsigned numColumns, unsigned *usedColumns, unsigned *usedRows);
+  void SetChildRect(LayoutNode *child, float left, float top, float width, float height);
+  // The size of this item along the parent's main and cross axis, before flexing.
+  float MainSize(const Context&);
+  float CrossSize(const Context&);
+  float ClampMain(const Context&, float size) const;
+  PaneLayout::Align GetAlign(PaneLayout::Align containerAlign) const;
+
+private:
+  void *const mOwner;
+  LayoutNode *mParent;
+  std::vector<LayoutNode*> mChildren;
+
+  PaneLayout mLayout;
+  std::vector<NLENGTH> mColumns;
+  std::vector<NLENGTH> mRows;
+
+  PaneLayoutItem mItem;
+  bool mIsItem;
+
+  // The position assigned by the parent.
+  LayoutRect mRect;
+  bool mRectChanged;
+
+  // Set when the arrangement of the children needs to be recomputed.
+  bool mDirty;
+  float mArrangedWidth;
+  float mArrangedHeight;
+  float mArrangedDpiX;
+  float mArrangedDpiY;
+
+  // The cached result of Measure, and the input it was computed for.
+  bool mMeasureDirty;
+  float mMeasuredAvailableWidth;
+  float mMeasuredAvailableHeight;
+  float mMeasuredDpiX;
+  float mMeasuredDpiY;
+  float mMeasuredWidth;
+  float mMeasuredHeight;
+
+  // Scratch space used while arranging, kept around to avoid reallocations.
+  std::vector<float> mBaseSizes;
+  std::vector<float> mMainSizes;
+  std::vector<bool> mFrozen;
+  std::vector<GridPlacement> mPlacements;
+};
@@ -10,6 +10,5 @@
 // Timers
 enum {
   NCORE_TIMER_WINDOW_MAINTENANCE = 1,
-
-  NCORE_LEASEABLE_TIMERS_START // Keep at the end
+  NCORE_TIMER_INTERVALS
 };
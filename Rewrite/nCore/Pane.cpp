@@ -84,6 +84,8 @@ Pane::Pane(const PaneInitData *initData, Pane *parent)
   , mIsTrackingMouse(false)
   , mStateDependencies(initData->numStates + 1)
   , mStateDependents(initData->numStates + 1)
+  , mLayoutNode(this)
+  , mLayoutOnUnlock(false)
 {
   mName[0] = L'\0';
   if (initData->name) {
@@ -218,6 +220,9 @@ Pane::Pane(const PaneInitData *initData, Pane *parent)
     for (Pane *child : sChildren[mName]) {
       mChildren.insert(child);
       child->mParent = this;
+      if (child->mLayoutNode.IsItem()) {
+        mLayoutNode.AppendChild(&child->mLayoutNode);
+      }
       child->ParentPositionChanged();
       child->ReCreateDeviceResources();
     }
@@ -244,6 +249,10 @@ Pane::~Pane() {
   }
   if (mParent) {
     mParent->mChildren.erase(this);
+    if (mLayoutNode.GetParent()) {
+      mParent->mLayoutNode.RemoveChild(&mLayoutNode);
+      mParent->UpdateLayout();
+    }
     mParent->Repaint(mRenderingPosition, true);
     if (mParent->mActiveChild == this) {
       mParent->mActiveChild = nullptr;
@@ -378,6 +387,9 @@ void Pane::ParentPositionChanged() {
   for (int i = 0; i < mPainters.size(); ++i) {
     mPainters[i]->PositionChanged(this, mPainterData[i], mRenderingPosition, isMove, isSize);
   }
+  if (isSize) {
+    UpdateLayout();
+  }
 }
 
 
@@ -412,6 +424,82 @@ void Pane::RepaintInvalidated() const {
 }
 
 
+void Pane::UpdateLayout() {
+  // Item settings of this pane may affect the layout of its ancestors, so start at the top-most
+  // pane of this layout tree.
+  Pane *root = this;
+  while (root->mParent && root->mLayoutNode.GetParent()) {
+    root = root->mParent;
+  }
+  if (!root->mLayoutNode.HasLayout()) {
+    return;
+  }
+  if (root->mUpdateLock != 0) {
+    root->mLayoutOnUnlock = true;
+    return;
+  }
+  root->mLayoutOnUnlock = false;
+  root->mLayoutNode.Arrange(root->mSize.width, root->mSize.height, root->mDpi.x, root->mDpi.y);
+  root->ApplyLayout(false);
+  root->RepaintInvalidated();
+}
+
+
+void Pane::ApplyLayout(bool moved) {
+  for (LayoutNode *node : mLayoutNode.GetChildren()) {
+    Pane *child = (Pane*)node->GetOwner();
+    if (node->TakeRectChanged() || moved) {
+      child->ApplyLayout(child->SetLayoutPosition(node->GetRect()));
+    } else {
+      child->ApplyLayout(false);
+    }
+  }
+  if (moved) {
+    for (Pane *child : mChildren) {
+      if (!child->mLayoutNode.GetParent()) {
+        child->ParentPositionChanged();
+      }
+    }
+  }
+}
+
+
+bool Pane::SetLayoutPosition(const LayoutRect &rect) {
+  mSettings.position = NRECT(
+    NLENGTH(rect.left, 0, 0),
+    NLENGTH(rect.top, 0, 0),
+    NLENGTH(rect.right, 0, 0),
+    NLENGTH(rect.bottom, 0, 0));
+
+  D2D1_RECT_F newPosition = D2D1::RectF(
+    rect.left + mParent->mRenderingPosition.left,
+    rect.top + mParent->mRenderingPosition.top,
+    rect.right + mParent->mRenderingPosition.left,
+    rect.bottom + mParent->mRenderingPosition.top);
+
+  bool isMove = newPosition.left != mRenderingPosition.left
+    || newPosition.top != mRenderingPosition.top;
+  bool isSize = newPosition.right - newPosition.left != mSize.width
+    || newPosition.bottom - newPosition.top != mSize.height;
+
+  if (!isMove && !isSize) {
+    return false;
+  }
+
+  Repaint(false); // Invalidate where we used to be
+  mRenderingPosition = newPosition;
+  mSize = D2D1::SizeF(
+    newPosition.right - newPosition.left,
+    newPosition.bottom - newPosition.top);
+  for (int i = 0; i < mPainters.size(); ++i) {
+    mPainters[i]->PositionChanged(this, mPainterData[i], mRenderingPosition, isMove, isSize);
+  }
+  Repaint(false); // And where we are now
+
+  return isMove;
+}
+
+
 void Pane::OnFullscreenActivated(HMONITOR monitor, HWND fullscreenWindow) {
   if (MonitorFromWindow(mWindow, MONITOR_DEFAULTTONULL) == monitor) {
     mCoveredByFullscreenWindow = true;
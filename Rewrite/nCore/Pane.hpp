@@ -1,5 +1,7 @@
 #pragma once
 
+#include "LayoutNode.hpp"
+
 #include "../nCoreApi/IPane.hpp"
 
 #include "../Headers/d2d1.h"
@@ -60,6 +62,8 @@ public:
   void APICALL Move(const NPOINT&) override;
   void APICALL Position(LPCNRECT) override;
   void APICALL Repaint(LPCNRECT) override;
+  void APICALL SetLayout(const PaneLayout*) override;
+  void APICALL SetLayoutItem(const PaneLayoutItem*) override;
   void APICALL SetText(LPCWSTR) override;
   void APICALL Show() override;
   void APICALL ToggleState(BYTE state) override;
@@ -88,6 +92,16 @@ private:
   // Repaints the invalidated area of the window.
   void RepaintInvalidated() const;
 
+  // Rearranges the children of this pane, if it has a layout.
+  void UpdateLayout();
+
+  // Positions the children which have changed since the last arrangement. If moved is set, this
+  // pane itself has moved and all children are repositioned.
+  void ApplyLayout(bool moved);
+
+  // Moves this pane to the position assigned by the parent's layout. Returns true if it moved.
+  bool SetLayoutPosition(const LayoutRect &rect);
+
   // Invalidates the given area of the pane.
   void Repaint(const D2D1_RECT_F &area, bool update);
 
@@ -126,6 +140,11 @@ private:
   // If this pane supports dynamic text.
   bool mDynamicText;
 
+  // This pane's place in the layout tree.
+  LayoutNode mLayoutNode;
+  // Set when the layout should be updated once the pane is unlocked.
+  bool mLayoutOnUnlock;
+
   bool mCoveredByFullscreenWindow;
 
   Pane *mActiveChild;
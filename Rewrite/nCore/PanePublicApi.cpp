@@ -149,6 +149,10 @@ void Pane::Lock() {
 
 
 void Pane::Move(const NPOINT &point) {
+  if (mLayoutNode.GetParent()) {
+    return;
+  }
+
   mSettings.position.bottom -= mSettings.position.top - point.y;
   mSettings.position.top = point.y;
   mSettings.position.right -= mSettings.position.left - point.x;
@@ -174,6 +178,10 @@ void Pane::Move(const NPOINT &point) {
 
 
 void Pane::Position(LPCNRECT position) {
+  if (mLayoutNode.GetParent()) {
+    return;
+  }
+
   mSettings.position = *position;
 
   if (!IsChildPane()) {
@@ -181,6 +189,7 @@ void Pane::Position(LPCNRECT position) {
     mSize = D2D1::SizeF(
       mRenderingPosition.right - mRenderingPosition.left,
       mRenderingPosition.bottom - mRenderingPosition.top);
+    UpdateLayout();
 
   } else if (mParent) {
     D2D1_RECT_F newPosition = D2D1::RectF(
@@ -207,6 +216,9 @@ void Pane::Position(LPCNRECT position) {
     for (int i = 0; i < mPainters.size(); ++i) {
       mPainters[i]->PositionChanged(this, mPainterData[i], mRenderingPosition, isMove, isSize);
     }
+    if (isSize) {
+      UpdateLayout();
+    }
     Repaint(true); // And where we are now
   }
 }
@@ -228,6 +240,25 @@ void Pane::Repaint(LPCNRECT area) {
 }
 
 
+void Pane::SetLayout(const PaneLayout *layout) {
+  mLayoutNode.SetLayout(layout);
+  UpdateLayout();
+}
+
+
+void Pane::SetLayoutItem(const PaneLayoutItem *item) {
+  mLayoutNode.SetItem(item);
+  if (mParent) {
+    if (item && !mLayoutNode.GetParent()) {
+      mParent->mLayoutNode.AppendChild(&mLayoutNode);
+    } else if (!item && mLayoutNode.GetParent()) {
+      mParent->mLayoutNode.RemoveChild(&mLayoutNode);
+    }
+    mParent->UpdateLayout();
+  }
+}
+
+
 void Pane::SetText(LPCWSTR text) {
   if (mText) {
     free(mText);
@@ -267,6 +298,9 @@ void Pane::ToggleState(BYTE state) {
 
 void Pane::Unlock() {
   if (--mUpdateLock == 0) {
+    if (mLayoutOnUnlock) {
+      UpdateLayout();
+    }
     RepaintInvalidated();
   }
 }
@@ -0,0 +1,289 @@
+#include "TimerWheel.hpp"
+
+#include <algorithm>
+#include <assert.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Ids are the index of the timer plus one in the low bits, and its generation in the high bits,
+// so that a stale id never removes a timer which has reused the same index.
+static const unsigned INDEX_BITS = 16;
+static const uint32_t MAX_TIMERS = (1 << INDEX_BITS) - 1;
+
+// The constants are bound to references, e.g. by std::fill and std::min, so they need storage.
+const uint64_t TimerWheel::NO_WAKEUP;
+const uint32_t TimerWheel::NONE;
+
+
+/// <summary>
+/// Returns the index of the lowest set bit of a non-zero value.
+/// </summary>
+static unsigned LowestBit(uint64_t value) {
+#if defined(_MSC_VER) && defined(_WIN64)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return index;
+#elif defined(_MSC_VER)
+  unsigned long index;
+  if (_BitScanForward(&index, uint32_t(value))) {
+    return index;
+  }
+  _BitScanForward(&index, uint32_t(value >> 32));
+  return index + 32;
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+
+TimerWheel::TimerWheel(uint64_t now, uint32_t slack)
+  : mNow(now)
+  , mSlack(slack)
+{
+  std::fill(std::begin(mHeads), std::end(mHeads), NONE);
+  std::fill(std::begin(mOccupied), std::end(mOccupied), 0);
+}
+
+
+TimerWheel::TimerId TimerWheel::Add(uint64_t now, uint32_t interval, void *context) {
+  uint32_t index;
+  if (!mFree.empty()) {
+    index = mFree.back();
+    mFree.pop_back();
+  } else if (mTimers.size() < MAX_TIMERS) {
+    index = uint32_t(mTimers.size());
+    mTimers.emplace_back();
+    mTimers.back().generation = 0;
+  } else {
+    return 0;
+  }
+
+  Timer &timer = mTimers[index];
+  timer.interval = std::max(interval, 1u);
+  timer.expiry = std::max(now, mNow) + timer.interval;
+  timer.context = context;
+  timer.active = true;
+  Link(index);
+
+  return MakeId(index, timer.generation);
+}
+
+
+void TimerWheel::Advance(uint64_t now, ICallback *callback) {
+  for (uint64_t time = GetNextEvent(); time <= now; time = GetNextEvent()) {
+    mNow = time;
+
+    // Move timers down from higher levels first, so that those expiring right now end up in the
+    // current slot of level 0.
+    for (unsigned level = LEVELS - 1; level > 0; --level) {
+      unsigned slot = unsigned(time >> (level * SLOT_BITS)) & (SLOTS - 1);
+      if ((mOccupied[level] & (uint64_t(1) << slot)) != 0 && SlotTime(level, slot) == time) {
+        Cascade(level, slot);
+      }
+    }
+
+    unsigned slot = unsigned(time) & (SLOTS - 1);
+    mExpired.clear();
+    for (uint32_t index = mHeads[slot]; index != NONE; index = mTimers[index].next) {
+      mExpired.push_back(MakeId(index, mTimers[index].generation));
+    }
+    for (TimerId id : mExpired) {
+      Unlink((id & MAX_TIMERS) - 1);
+    }
+
+    for (TimerId id : mExpired) {
+      // Earlier callbacks may have removed this timer.
+      if (!IsActive(id)) {
+        continue;
+      }
+
+      // Reschedule before calling out, so that the callback may remove the timer. If we have
+      // fallen behind, skip the missed intervals rather than firing them all at once.
+      Timer &timer = mTimers[(id & MAX_TIMERS) - 1];
+      timer.expiry = time + timer.interval;
+      if (timer.expiry <= now) {
+        timer.expiry += ((now - timer.expiry) / timer.interval + 1) * timer.interval;
+      }
+      Link((id & MAX_TIMERS) - 1);
+
+      callback->OnTimer(id, timer.context);
+    }
+  }
+
+  mNow = std::max(mNow, now);
+}
+
+
+uint64_t TimerWheel::GetNextWakeup() const {
+  uint64_t expiry = GetNextExpiry();
+  return expiry == NO_WAKEUP ? NO_WAKEUP : expiry + mSlack;
+}
+
+
+bool TimerWheel::IsActive(TimerId id) const {
+  uint32_t index = (id & MAX_TIMERS) - 1;
+  return index < mTimers.size() && mTimers[index].active
+    && mTimers[index].generation == uint16_t(id >> INDEX_BITS);
+}
+
+
+void TimerWheel::Remove(TimerId id) {
+  if (!IsActive(id)) {
+    return;
+  }
+
+  uint32_t index = (id & MAX_TIMERS) - 1;
+  Timer &timer = mTimers[index];
+  if (timer.slot != NONE) {
+    Unlink(index);
+  }
+  timer.active = false;
+  ++timer.generation;
+  mFree.push_back(index);
+}
+
+
+void TimerWheel::SetSlack(uint32_t slack) {
+  mSlack = slack;
+}
+
+
+uint64_t TimerWheel::GetNextExpiry() const {
+  uint64_t earliest = NO_WAKEUP;
+  for (unsigned level = 0; level < LEVELS; ++level) {
+    unsigned slot = FirstOccupiedSlot(level);
+    if (slot == NONE) {
+      continue;
+    }
+
+    if (level == 0) {
+      earliest = SlotTime(0, slot);
+    } else if (level < LEVELS - 1) {
+      // Later slots on this level hold later blocks of time, so the earliest timer on the level
+      // is in this slot.
+      earliest = std::min(earliest, GetEarliestInSlot(level, slot));
+    } else {
+      // Timers which are too far away for the wheel are parked in the slot before the current one
+      // as of when they were linked. Once time moves on, that slot may come before slots which
+      // hold earlier timers, so every slot on the top level has to be looked at.
+      for (uint64_t occupied = mOccupied[level]; occupied != 0; occupied &= occupied - 1) {
+        earliest = std::min(earliest, GetEarliestInSlot(level, LowestBit(occupied)));
+      }
+    }
+  }
+  return earliest;
+}
+
+
+uint64_t TimerWheel::GetEarliestInSlot(unsigned level, unsigned slot) const {
+  uint64_t earliest = NO_WAKEUP;
+  for (uint32_t index = mHeads[level * SLOTS + slot]; index != NONE; index = mTimers[index].next) {
+    earliest = std::min(earliest, mTimers[index].expiry);
+  }
+  return earliest;
+}
+
+
+uint64_t TimerWheel::GetNextEvent() const {
+  uint64_t earliest = NO_WAKEUP;
+  for (unsigned level = 0; level < LEVELS; ++level) {
+    unsigned slot = FirstOccupiedSlot(level);
+    if (slot != NONE) {
+      earliest = std::min(earliest, SlotTime(level, slot));
+    }
+  }
+  return earliest;
+}
+
+
+unsigned TimerWheel::FirstOccupiedSlot(unsigned level) const {
+  uint64_t occupied = mOccupied[level];
+  if (occupied == 0) {
+    return NONE;
+  }
+
+  // Rotate the bits so that the current slot comes first.
+  unsigned current = unsigned(mNow >> (level * SLOT_BITS)) & (SLOTS - 1);
+  if (current != 0) {
+    occupied = (occupied >> current) | (occupied << (SLOTS - current));
+  }
+  return (current + LowestBit(occupied)) & (SLOTS - 1);
+}
+
+
+uint64_t TimerWheel::SlotTime(unsigned level, unsigned slot) const {
+  const unsigned shift = level * SLOT_BITS;
+  uint64_t block = mNow >> shift;
+  block += (slot - unsigned(block)) & (SLOTS - 1);
+  return level == 0 ? block : block << shift;
+}
+
+
+void TimerWheel::Link(uint32_t index) {
+  Timer &timer = mTimers[index];
+  assert(timer.expiry >= mNow);
+
+  // Use the lowest level on which the expiry is less than a full turn away.
+  unsigned level = 0;
+  uint64_t block = timer.expiry;
+  while (level < LEVELS
+      && (timer.expiry >> (level * SLOT_BITS)) - (mNow >> (level * SLOT_BITS)) >= SLOTS) {
+    ++level;
+  }
+  if (level == LEVELS) {
+    // Too far away for the wheel. Park it in the last slot of the top level, and find it a new
+    // place when that slot is reached.
+    level = LEVELS - 1;
+    block = (mNow >> (level * SLOT_BITS)) + SLOTS - 1;
+  } else {
+    block = timer.expiry >> (level * SLOT_BITS);
+  }
+
+  unsigned slot = unsigned(block) & (SLOTS - 1);
+  uint32_t &head = mHeads[level * SLOTS + slot];
+  timer.slot = level * SLOTS + slot;
+  timer.prev = NONE;
+  timer.next = head;
+  if (head != NONE) {
+    mTimers[head].prev = index;
+  }
+  head = index;
+  mOccupied[level] |= uint64_t(1) << slot;
+}
+
+
+void TimerWheel::Unlink(uint32_t index) {
+  Timer &timer = mTimers[index];
+  if (timer.prev != NONE) {
+    mTimers[timer.prev].next = timer.next;
+  } else {
+    mHeads[timer.slot] = timer.next;
+    if (timer.next == NONE) {
+      mOccupied[timer.slot / SLOTS] &= ~(uint64_t(1) << (timer.slot % SLOTS));
+    }
+  }
+  if (timer.next != NONE) {
+    mTimers[timer.next].prev = timer.prev;
+  }
+  timer.slot = NONE;
+}
+
+
+void TimerWheel::Cascade(unsigned level, unsigned slot) {
+  uint32_t index = mHeads[level * SLOTS + slot];
+  mHeads[level * SLOTS + slot] = NONE;
+  mOccupied[level] &= ~(uint64_t(1) << slot);
+
+  while (index != NONE) {
+    uint32_t next = mTimers[index].next;
+    Link(index);
+    index = next;
+  }
+}
+
+
+TimerWheel::TimerId TimerWheel::MakeId(uint32_t index, uint16_t generation) {
+  return (TimerId(generation) << INDEX_BITS) | (index + 1);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+/// <summary>
+/// A hierarchical timing wheel which keeps any number of repeating timers, so that they can all
+/// be served from a single OS timer. Time is passed in explicitly, in milliseconds, so that the
+/// wheel has no dependency on a real clock.
+/// </summary>
+/// <remarks>
+/// Each level has 64 slots. A slot on level 0 spans 1 ms, a slot on level n spans 64^n ms, and
+/// timers move down a level when the time reaches the start of their slot. Adding and removing a
+/// timer is O(1). Finding the next expiry looks at the first occupied slot of the lower levels,
+/// and every timer on the top level, which only holds timers more than 64^3 ms away.
+///
+/// The wheel tolerates firing timers up to a fixed slack late. GetNextWakeup returns the latest
+/// time at which the earliest timer can still be fired, which lets timers that are due close to
+/// each other be fired by a single wakeup.
+/// </remarks>
+class TimerWheel {
+public:
+  typedef uint32_t TimerId;
+
+  /// <summary>
+  /// Receives expired timers.
+  /// </summary>
+  class ICallback {
+  public:
+    virtual void OnTimer(TimerId id, void *context) = 0;
+  };
+
+public:
+  static const uint64_t NO_WAKEUP = UINT64_MAX;
+
+public:
+  TimerWheel(uint64_t now, uint32_t slack);
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel &operator=(const TimerWheel&) = delete;
+
+public:
+  // Adds a timer which fires every interval milliseconds, starting interval milliseconds from
+  // now. Returns 0 if the wheel is full.
+  TimerId Add(uint64_t now, uint32_t interval, void *context);
+
+  // Fires every timer which expired at or before now, in order of expiry.
+  void Advance(uint64_t now, ICallback *callback);
+
+  // Returns the time at which Advance should be called next, or NO_WAKEUP if there are no timers.
+  uint64_t GetNextWakeup() const;
+
+  // Returns true if the id refers to an active timer.
+  bool IsActive(TimerId id) const;
+
+  // Removes a timer. Removing a timer which has already been removed has no effect.
+  void Remove(TimerId id);
+
+  // Sets how late, in milliseconds, timers may fire.
+  void SetSlack(uint32_t slack);
+
+private:
+  static const unsigned LEVELS = 4;
+  static const unsigned SLOT_BITS = 6;
+  static const unsigned SLOTS = 1 << SLOT_BITS;
+  static const uint32_t NONE = UINT32_MAX;
+
+  struct Timer {
+    uint64_t expiry;
+    uint32_t interval;
+    void *context;
+    uint16_t generation;
+    bool active;
+    // The slot list this timer is in, as level * SLOTS + slot, or NONE.
+    uint32_t slot;
+    uint32_t prev;
+    uint32_t next;
+  };
+
+private:
+  // Returns the earliest expiry of any timer, or NO_WAKEUP.
+  uint64_t GetNextExpiry() const;
+
+  // Returns the earliest expiry of the timers in a slot, or NO_WAKEUP.
+  uint64_t GetEarliestInSlot(unsigned level, unsigned slot) const;
+
+  // Returns the time of the next expiry or cascade, or NO_WAKEUP.
+  uint64_t GetNextEvent() const;
+
+  // Returns the index of the first occupied slot at or after the current one on the level, or
+  // NONE.
+  unsigned FirstOccupiedSlot(unsigned level) const;
+
+  // Returns the time at which the given slot is reached.
+  uint64_t SlotTime(unsigned level, unsigned slot) const;
+
+  void Link(uint32_t index);
+  void Unlink(uint32_t index);
+
+  // Moves every timer in the given slot down to the level matching its expiry.
+  void Cascade(unsigned level, unsigned slot);
+
+  static TimerId MakeId(uint32_t index, uint16_t generation);
+
+private:
+  uint64_t mNow;
+  uint32_t mSlack;
+
+  std::vector<Timer> mTimers;
+  std::vector<uint32_t> mFree;
+
+  // The first timer in each slot.
+  uint32_t mHeads[LEVELS * SLOTS];
+
+  // One bit per occupied slot, per level.
+  uint64_t mOccupied[LEVELS];
+
+  // Scratch space for Advance.
+  std::vector<uint32_t> mExpired;
+};
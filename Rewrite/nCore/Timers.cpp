@@ -1,36 +1,85 @@
 #include "Messages.h"
+#include "SettingsReader.hpp"
+#include "TimerWheel.hpp"
 #include "Timers.h"
 
-#include "../nShared/UIDGenerator.hpp"
-
 #include "../nCoreApi/IMessageHandler.hpp"
 
 #include "../Headers/Macros.h"
 
-#include <assert.h>
-#include <unordered_map>
+#include <algorithm>
+
+// Every interval is kept in this wheel, and served from a single window timer.
+static TimerWheel *sWheel = nullptr;
 
-static UIDGenerator<UINT_PTR> sIdGenerator(NCORE_LEASEABLE_TIMERS_START);
-static std::unordered_map<UINT_PTR, IMessageHandler*> sActiveTimers;
+// The time for which the window timer is set, or NO_WAKEUP.
+static uint64_t sWakeup = TimerWheel::NO_WAKEUP;
 
 extern HWND gWindow;
 
 
+class IntervalCallback : public TimerWheel::ICallback {
+public:
+  void OnTimer(TimerWheel::TimerId id, void *context) override {
+    ((IMessageHandler*)context)->HandleMessage(gWindow, WM_TIMER, id, 0, 0);
+  }
+};
+
+
+/// <summary>
+/// Sets the window timer for the next interval which is due, or kills it if there is none.
+/// </summary>
+static void UpdateWakeup() {
+  uint64_t wakeup = sWheel->GetNextWakeup();
+  if (wakeup == sWakeup) {
+    return;
+  }
+
+  sWakeup = wakeup;
+  if (wakeup == TimerWheel::NO_WAKEUP) {
+    KillTimer(gWindow, NCORE_TIMER_INTERVALS);
+  } else {
+    uint64_t now = GetTickCount64();
+    UINT delay = UINT(std::min<uint64_t>(wakeup > now ? wakeup - now : 0, USER_TIMER_MAXIMUM));
+    SetTimer(gWindow, NCORE_TIMER_INTERVALS, std::max<UINT>(delay, USER_TIMER_MINIMUM), nullptr);
+  }
+}
+
+
 EXPORT_CDECL(void) ClearInterval(UINT_PTR id) {
-  KillTimer(gWindow, id);
-  sActiveTimers.erase(id);
-  sIdGenerator.ReleaseId(id);
+  sWheel->Remove(TimerWheel::TimerId(id));
+  UpdateWakeup();
 }
 
 
 EXPORT_CDECL(UINT_PTR) SetInterval(UINT delay, IMessageHandler *handler) {
-  UINT_PTR id = sIdGenerator.GetNewId();
-  sActiveTimers[id] = handler;
-  SetTimer(gWindow, id, delay, nullptr);
+  UINT_PTR id = sWheel->Add(GetTickCount64(), delay, handler);
+  UpdateWakeup();
   return id;
 }
 
 
-void Timers::Handle(WPARAM id, LPARAM lParam) {
-  sActiveTimers[id]->HandleMessage(gWindow, WM_TIMER, id, lParam, 0);
+void Timers::Initialize() {
+  // How late, in milliseconds, intervals may fire so that they can share a wakeup with others.
+  ISettingsReader *settings = SettingsReader::Create(L"nCore", nullptr);
+  int slack = std::max(0, settings->GetInt(L"TimerSlack", 10));
+  settings->Discard();
+
+  sWheel = new TimerWheel(GetTickCount64(), UINT(slack));
+}
+
+
+void Timers::Shutdown() {
+  KillTimer(gWindow, NCORE_TIMER_INTERVALS);
+  sWakeup = TimerWheel::NO_WAKEUP;
+  delete sWheel;
+  sWheel = nullptr;
+}
+
+
+void Timers::Handle() {
+  IntervalCallback callback;
+  sWakeup = TimerWheel::NO_WAKEUP;
+  sWheel->Advance(GetTickCount64(), &callback);
+  UpdateWakeup();
 }
@@ -3,5 +3,9 @@
 #include "../Headers/Windows.h"
 
 namespace Timers {
-  void Handle(WPARAM, LPARAM);
+  void Initialize();
+  void Shutdown();
+
+  // Fires every due interval. Called when NCORE_TIMER_INTERVALS goes off.
+  void Handle();
 }
@@ -66,8 +66,11 @@ LRESULT WINAPI MessageHandler(HWND window, UINT message, WPARAM wParam, LPARAM l
     case NCORE_TIMER_WINDOW_MAINTENANCE:
       WindowMonitor::RunWindowMaintenance();
       return 0;
+
+    case NCORE_TIMER_INTERVALS:
+      Timers::Handle();
+      return 0;
     }
-    Timers::Handle(wParam, lParam);
     return 0;
 
   case LM_FULLSCREENACTIVATED:
@@ -135,6 +138,7 @@ EXPORT_CDECL(int) initModuleW(HWND /* parent */, HINSTANCE instance, LPCWSTR /*
   CreateMessageHandler(instance, sName, MessageHandler, gWindow);
   Pane::CreateWindowClasses(instance);
   Factories::Create();
+  Timers::Initialize();
   WindowMonitor::Start();
   return 0;
 }
@@ -142,6 +146,7 @@ EXPORT_CDECL(int) initModuleW(HWND /* parent */, HINSTANCE instance, LPCWSTR /*
 
 EXPORT_CDECL(void) quitModule(HINSTANCE instance) {
   WindowMonitor::Stop();
+  Timers::Shutdown();
   Factories::Destroy();
   Pane::DestroyWindowClasses(instance);
   DestroyWindow(gWindow);
@@ -191,7 +191,9 @@ namespace nCore {
   CORE_API_PROC(void, RegisterForMessages, HWND window, const UINT messages[]);
 
   /// <summary>
-  /// Sets a timer.
+  /// Sets a timer. The handler receives WM_TIMER, with the returned id as wParam, every delay
+  /// milliseconds. Intervals may fire up to nCoreTimerSlack milliseconds late, so that intervals
+  /// which are due close together are served by a single wakeup.
   /// </summary>
   CORE_API_PROC(UINT_PTR, SetInterval, UINT delay, IMessageHandler *handler);
 
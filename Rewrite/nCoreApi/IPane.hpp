@@ -6,6 +6,7 @@
 #include "IPainter.hpp"
 #include "ISettingsReader.hpp"
 #include "Lengths.h"
+#include "PaneLayout.h"
 
 #include "../Headers/d2d1.h"
 
@@ -134,6 +135,20 @@ public:
   /// </summary>
   virtual void APICALL Repaint(LPCNRECT) = 0;
 
+  /// <summary>
+  /// Sets how this pane arranges its children. Only children which have called SetLayoutItem take
+  /// part in the layout, and they are arranged in the order they made that call.
+  /// </summary>
+  /// <param name="layout">The layout to use, or null to position the children manually.</param>
+  virtual void APICALL SetLayout(const PaneLayout *layout) = 0;
+
+  /// <summary>
+  /// Sets how this pane is sized and positioned by its parent's layout. While set, calls to
+  /// Move and Position are ignored.
+  /// </summary>
+  /// <param name="item">The item settings, or null to leave the parent's layout.</param>
+  virtual void APICALL SetLayoutItem(const PaneLayoutItem *item) = 0;
+
   /// <summary>
   /// Sets the text of the pane.
   /// </summary>
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Lengths.h"
+
+// Used for PaneLayoutItem::row and column to let the grid place the item in the next free cell.
+#define LAYOUT_AUTO_PLACE 0xFFFFFFFF
+
+/// <summary>
+/// Describes how a pane arranges those of its children which have a PaneLayoutItem set.
+/// </summary>
+struct PaneLayout {
+  enum class Type : unsigned char {
+    // Children are positioned manually.
+    None,
+    // Children are placed in a line from left to right.
+    Row,
+    // Children are placed in a line from top to bottom.
+    Column,
+    // Children are placed in the cells of a grid with fixed track sizes.
+    Grid
+  };
+
+  enum class Align : unsigned char {
+    // Items only. Use the container's alignItems.
+    Auto,
+    Start,
+    End,
+    Center,
+    Stretch,
+    // justifyContent only.
+    SpaceBetween,
+    // justifyContent only.
+    SpaceAround
+  };
+
+  Type type;
+
+  // Space between the edges of the pane and the children.
+  NRECT padding;
+
+  // Vertical spacing between rows, and horizontal spacing between columns.
+  NLENGTH rowGap;
+  NLENGTH columnGap;
+
+  // Distribution of free space along the main axis. For grids, placement of the tracks.
+  Align justifyContent;
+
+  // Placement of items along the cross axis of their line. For grids, within their cell.
+  Align alignItems;
+
+  // Row & Column only. Start a new line when an item doesn't fit on the current one.
+  bool wrap;
+
+  // Row & Column only. Place items from right to left, or bottom to top.
+  bool reverse;
+
+  // Row & Column only. Stack new lines from the bottom, or from the right.
+  bool wrapReverse;
+
+  // Grid only. The sizes of the tracks. Items placed beyond the last track reuse its size.
+  const NLENGTH *columns;
+  unsigned numColumns;
+  const NLENGTH *rows;
+  unsigned numRows;
+};
+
+/// <summary>
+/// Describes how a pane is sized and positioned by its parent's layout.
+/// </summary>
+struct PaneLayoutItem {
+  // The size along the parent's main axis, before growing or shrinking. For grids, the width
+  // used when the item isn't stretched.
+  NLENGTH basis;
+
+  // The size along the parent's cross axis, unless the item is stretched. For grids, the height
+  // used when the item isn't stretched.
+  NLENGTH crossSize;
+
+  // Limits on the main axis size after growing or shrinking. A maxSize which evaluates to 0 or
+  // less is treated as unlimited.
+  NLENGTH minSize;
+  NLENGTH maxSize;
+
+  // Relative share of positive and negative free space the item takes on.
+  float grow;
+  float shrink;
+
+  // If set, basis and crossSize are ignored and the item is sized from its own children.
+  bool fitContent;
+
+  PaneLayout::Align alignSelf;
+
+  // Grid only. LAYOUT_AUTO_PLACE lets the grid pick the next free cell.
+  unsigned row;
+  unsigned column;
+  unsigned rowSpan;
+  unsigned columnSpan;
+};
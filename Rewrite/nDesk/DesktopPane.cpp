@@ -1,5 +1,7 @@
 #include "DesktopPane.hpp"
 
+#include "../nModuleBase/nModule.hpp"
+
 #include "../nCoreApi/Core.h"
 
 #include "../nShared/Math.h"
@@ -7,15 +9,21 @@
 #include "../Headers/lsapi.h"
 #include "../Headers/Macros.h"
 
-#include <algorithm>
 #include <ShlObj.h>
-#include <wincodec.h>
+#include <string>
+
+extern NModule gModule;
 
 
 DesktopPane::DesktopPane()
-  : mPane(nullptr)
+  : mWallpapersLoaded(false)
+  , mFirstPaintLogged(false)
+  , mBackgroundColor(D2D1::ColorF(D2D1::ColorF::Black))
+  , mPane(nullptr)
   , mRenderTarget(nullptr)
 {
+  QueryPerformanceCounter(&mCreationTime);
+
   PaneInitData initData;
   ZeroMemory(&initData, sizeof(PaneInitData));
   initData.cbSize = sizeof(PaneInitData);
@@ -28,6 +36,15 @@ DesktopPane::DesktopPane()
 
   ISettingsReader *reader = nCore::CreateSettingsReader(L"nDesk", nullptr);
   mEventHandler = nCore::CreateEventHandler(reader);
+  if (reader->GetBool(L"WallpaperDiskCache", true)) {
+    LPWSTR localAppData;
+    if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) {
+      std::wstring directory(localAppData);
+      directory += L"\\nModules\\nDesk\\Wallpapers";
+      mCache.SetDiskCacheDirectory(directory.c_str());
+      CoTaskMemFree(localAppData);
+    }
+  }
   reader->Discard();
 
   mPane = nCore::CreatePane(&initData);
@@ -72,106 +89,88 @@ LPVOID DesktopPane::AddPane(const IPane*) {
 
 
 HRESULT DesktopPane::CreateDeviceResources(ID2D1RenderTarget *renderTarget) {
-  HRESULT hr = S_OK;
   mRenderTarget = renderTarget;
-  IDesktopWallpaper *desktopWallpaper;
-  hr = LSCoCreateInstance(CLSID_DesktopWallpaper, nullptr, CLSCTX_ALL, IID_IDesktopWallpaper,
-    (void**)&desktopWallpaper);
-  if (SUCCEEDED(hr)) {
-    const Display &desktop = nCore::GetDisplays()->GetDesktop();
+  if (!mWallpapersLoaded) {
+    LoadWallpapers();
+  }
 
-    DESKTOP_WALLPAPER_POSITION position;
-    desktopWallpaper->GetPosition(&position);
+  // The uploaded images, until every layer has been composited. Monitors showing the same image
+  // share the upload.
+  std::vector<ID2D1Bitmap*> images(mWallpapers.size(), nullptr);
 
-    UINT numMonitors;
-    hr = desktopWallpaper->GetMonitorDevicePathCount(&numMonitors);
-    if (SUCCEEDED(hr)) {
-      mWallpapers.resize(numMonitors);
-      for (UINT i = 0; i < numMonitors; ++i) {
-        Wallpaper &wallpaper = mWallpapers[i];
-
-        LPWSTR id;
-        hr = desktopWallpaper->GetMonitorDevicePathAt(i, &id);
-        if (SUCCEEDED(hr)) {
-          RECT rect;
-          hr = desktopWallpaper->GetMonitorRECT(id, &rect);
-          if (SUCCEEDED(hr)) {
-            wallpaper.rect.top = (float)(rect.top - desktop.rect.top);
-            wallpaper.rect.left = (float)(rect.left - desktop.rect.left);
-            wallpaper.rect.right = (float)(rect.right - desktop.rect.left);
-            wallpaper.rect.bottom = (float)(rect.bottom - desktop.rect.top);
-
-            LPWSTR file;
-            hr = desktopWallpaper->GetWallpaper(id, &file);
-            if (SUCCEEDED(hr)) {
-              UINT width, height;
-              wchar_t expandedPath[MAX_PATH];
-              ID2D1BitmapBrush *bitmapBrush;
-              ExpandEnvironmentStrings(file, expandedPath, MAX_PATH);
-              hr = CreateBitmapBrush(expandedPath, renderTarget, &bitmapBrush, &width, &height);
-              if (SUCCEEDED(hr)) {
-                D2D1_SIZE_F translation = D2D1::SizeF(wallpaper.rect.left, wallpaper.rect.top);
-                D2D1_SIZE_F scale = D2D1::SizeF(1, 1);
-
-                switch (position) {
-                default:
-                case DWPOS_FILL:
-                  scale.height = scale.width = std::max(
-                    float(rect.right - rect.left) / width,
-                    float(rect.bottom - rect.top) / height);
-                  translation.width += (rect.right - rect.left - width * scale.width) / 2.0f;
-                  translation.height += (rect.bottom - rect.top - height * scale.height) / 2.0f;
-                  break;
-
-                case DWPOS_FIT:
-                  scale.height = scale.width = std::min(
-                    float(rect.right - rect.left) / width,
-                    float(rect.bottom - rect.top) / height);
-                  translation.width += (rect.right - rect.left - width * scale.width) / 2.0f;
-                  translation.height += (rect.bottom - rect.top - height * scale.height) / 2.0f;
-                  break;
-
-                case DWPOS_STRETCH:
-                  scale = D2D1::SizeF(
-                    float(rect.right - rect.left) / width,
-                    float(rect.bottom - rect.top) / height);
-                  break;
-
-                case DWPOS_CENTER:
-                  translation.width += (rect.right - rect.left - width) / 2.0f;
-                  translation.height += (rect.bottom - rect.top - height) / 2.0f;
-                  break;
-
-                case DWPOS_SPAN:
-                  break;
-
-                case DWPOS_TILE:
-                  break;
-                }
-
-                bitmapBrush->SetTransform(
-                  D2D1::Matrix3x2F::Scale(scale) * D2D1::Matrix3x2F::Translation(translation));
-                wallpaper.brush = (ID2D1Brush*)bitmapBrush;
-              }
-              CoTaskMemFree(file);
-            }
-          }
-          CoTaskMemFree(id);
-        }
-        if (FAILED(hr)) {
+  HRESULT hr = S_OK;
+  for (size_t i = 0; i < mWallpapers.size() && SUCCEEDED(hr); ++i) {
+    Wallpaper &wallpaper = mWallpapers[i];
+    if (wallpaper.image) {
+      for (size_t j = 0; j < i; ++j) {
+        if (mWallpapers[j].image == wallpaper.image && images[j]) {
+          images[i] = images[j];
+          images[i]->AddRef();
           break;
         }
       }
+      if (!images[i]) {
+        const WallpaperImage &image = *wallpaper.image;
+        hr = renderTarget->CreateBitmap(D2D1::SizeU(image.width, image.height), image.pixels,
+          image.width * 4, D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM,
+          D2D1_ALPHA_MODE_PREMULTIPLIED)), &images[i]);
+      }
+    }
+
+    if (SUCCEEDED(hr)) {
+      hr = CreateLayer(renderTarget, images[i], wallpaper);
+    }
+  }
+
+  // The layers hold everything which is needed from here on.
+  for (ID2D1Bitmap *image : images) {
+    SAFERELEASE(image);
+  }
+
+  return hr;
+}
+
+
+HRESULT DesktopPane::CreateLayer(ID2D1RenderTarget *renderTarget, ID2D1Bitmap *image,
+    Wallpaper &wallpaper) {
+  ID2D1BitmapRenderTarget *layerTarget;
+  HRESULT hr = renderTarget->CreateCompatibleRenderTarget(D2D1::SizeF(
+    wallpaper.rect.right - wallpaper.rect.left, wallpaper.rect.bottom - wallpaper.rect.top),
+    &layerTarget);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  layerTarget->BeginDraw();
+  layerTarget->Clear(mBackgroundColor);
+  if (image) {
+    ID2D1BitmapBrush *brush;
+    D2D1_EXTEND_MODE extendMode = wallpaper.tile ? D2D1_EXTEND_MODE_WRAP : D2D1_EXTEND_MODE_CLAMP;
+    if (SUCCEEDED(layerTarget->CreateBitmapBrush(image, D2D1::BitmapBrushProperties(extendMode,
+        extendMode, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR), &brush))) {
+      // The image is already at its final size, so it only needs to be moved into place.
+      const D2D1_RECT_F target = D2D1::RectF(wallpaper.target.left - wallpaper.rect.left,
+        wallpaper.target.top - wallpaper.rect.top, wallpaper.target.right - wallpaper.rect.left,
+        wallpaper.target.bottom - wallpaper.rect.top);
+      brush->SetTransform(D2D1::Matrix3x2F::Translation(target.left, target.top));
+      layerTarget->FillRectangle(target, brush);
+      brush->Release();
     }
-    desktopWallpaper->Release();
   }
+  hr = layerTarget->EndDraw();
+
+  if (SUCCEEDED(hr)) {
+    hr = layerTarget->GetBitmap(&wallpaper.layer);
+  }
+  layerTarget->Release();
+
   return hr;
 }
 
 
 void DesktopPane::DiscardDeviceResources() {
   for (Wallpaper &wallpaper : mWallpapers) {
-    SAFERELEASE(wallpaper.brush);
+    SAFERELEASE(wallpaper.layer);
   }
   mRenderTarget = nullptr;
 }
@@ -184,12 +183,30 @@ bool DesktopPane::DynamicColorChanged(ID2D1RenderTarget*) {
 
 void DesktopPane::Paint(ID2D1RenderTarget *renderTarget, const D2D1_RECT_F *area, const IPane*,
     LPVOID, UINT) const {
+  // Only copy the damaged part of each monitor's layer.
   for (const Wallpaper &wallpaper : mWallpapers) {
     D2D1_RECT_F invalidatedArea;
-    if (RectIntersection(area, &wallpaper.rect, &invalidatedArea)) {
-      renderTarget->FillRectangle(invalidatedArea, wallpaper.brush);
+    if (wallpaper.layer && RectIntersection(area, &wallpaper.rect, &invalidatedArea)) {
+      const D2D1_RECT_F source = D2D1::RectF(invalidatedArea.left - wallpaper.rect.left,
+        invalidatedArea.top - wallpaper.rect.top, invalidatedArea.right - wallpaper.rect.left,
+        invalidatedArea.bottom - wallpaper.rect.top);
+      renderTarget->DrawBitmap(wallpaper.layer, invalidatedArea, 1.0f,
+        D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR, source);
     }
   }
+
+  // Time to the first paint is what the disk cache is for, so log it to compare startups with and
+  // without the cache.
+  if (!mFirstPaintLogged) {
+    mFirstPaintLogged = true;
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    gModule.log->Info(L"First desktop paint %.1f ms after startup. "
+      L"%u wallpapers from the disk cache, %u resampled.",
+      double(now.QuadPart - mCreationTime.QuadPart) * 1000.0 / frequency.QuadPart,
+      mCache.GetDiskHits(), mCache.GetMisses());
+  }
 }
 
 
@@ -212,7 +229,7 @@ void DesktopPane::TextChanged(const IPane*, LPVOID, LPCWSTR) {
 
 
 void DesktopPane::UpdateWallpapers() {
-  // TODO(Erik):
+  LoadWallpapers();
   if (mRenderTarget) {
     ID2D1RenderTarget *renderTarget = mRenderTarget;
     DiscardDeviceResources();
@@ -222,38 +239,85 @@ void DesktopPane::UpdateWallpapers() {
 }
 
 
-HRESULT DesktopPane::CreateBitmapBrush(LPCWSTR file, ID2D1RenderTarget *renderTarget,
-    ID2D1BitmapBrush **brush, LPUINT widthOut, LPUINT heightOut) {
-  HRESULT hr = S_OK;
-  IWICImagingFactory *factory = nCore::GetWICFactory();
-  IWICBitmapDecoder *decoder;
-  hr = factory->CreateDecoderFromFilename(file, nullptr, GENERIC_READ,
-    WICDecodeMetadataCacheOnDemand, &decoder);
-  if (SUCCEEDED(hr)) {
-    IWICBitmapFrameDecode *frame;
-    hr = decoder->GetFrame(0, &frame);
-    if (SUCCEEDED(hr)) {
-      hr = frame->GetSize(widthOut, heightOut);
-      if (SUCCEEDED(hr)) {
-        IWICFormatConverter *converter;
-        hr = factory->CreateFormatConverter(&converter);
-        if (SUCCEEDED(hr)) {
-          hr = converter->Initialize(frame, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone,
-            nullptr, 0.0, WICBitmapPaletteTypeMedianCut);
-          if (SUCCEEDED(hr)) {
-            ID2D1Bitmap *bitmap;
-            hr = renderTarget->CreateBitmapFromWicBitmap(converter, &bitmap);
-            if (SUCCEEDED(hr)) {
-              hr = renderTarget->CreateBitmapBrush(bitmap, brush);
-              bitmap->Release();
-            }
+void DesktopPane::LoadWallpapers() {
+  for (Wallpaper &wallpaper : mWallpapers) {
+    SAFERELEASE(wallpaper.layer);
+  }
+  mWallpapers.clear();
+  mWallpapersLoaded = true;
+
+  LARGE_INTEGER start, end, frequency;
+  QueryPerformanceCounter(&start);
+  const UINT diskHits = mCache.GetDiskHits(), misses = mCache.GetMisses();
+
+  IDesktopWallpaper *desktopWallpaper;
+  HRESULT hr = LSCoCreateInstance(CLSID_DesktopWallpaper, nullptr, CLSCTX_ALL,
+    IID_IDesktopWallpaper, (void**)&desktopWallpaper);
+  if (FAILED(hr)) {
+    return;
+  }
+
+  const Display &desktop = nCore::GetDisplays()->GetDesktop();
+
+  DESKTOP_WALLPAPER_POSITION position;
+  if (FAILED(desktopWallpaper->GetPosition(&position))) {
+    position = DWPOS_FILL;
+  }
+
+  COLORREF background;
+  if (SUCCEEDED(desktopWallpaper->GetBackgroundColor(&background))) {
+    mBackgroundColor = D2D1::ColorF(GetRValue(background) / 255.0f,
+      GetGValue(background) / 255.0f, GetBValue(background) / 255.0f);
+  }
+
+  UINT numMonitors;
+  if (SUCCEEDED(desktopWallpaper->GetMonitorDevicePathCount(&numMonitors))) {
+    for (UINT i = 0; i < numMonitors; ++i) {
+      LPWSTR id;
+      if (FAILED(desktopWallpaper->GetMonitorDevicePathAt(i, &id))) {
+        continue;
+      }
+
+      RECT rect;
+      if (SUCCEEDED(desktopWallpaper->GetMonitorRECT(id, &rect))) {
+        Wallpaper wallpaper;
+        wallpaper.rect = D2D1::RectF(float(rect.left - desktop.rect.left),
+          float(rect.top - desktop.rect.top), float(rect.right - desktop.rect.left),
+          float(rect.bottom - desktop.rect.top));
+        wallpaper.target = wallpaper.rect;
+        wallpaper.tile = false;
+        wallpaper.layer = nullptr;
+
+        LPWSTR file;
+        if (SUCCEEDED(desktopWallpaper->GetWallpaper(id, &file))) {
+          wchar_t expandedPath[MAX_PATH];
+          WallpaperPlacement placement;
+          ExpandEnvironmentStrings(file, expandedPath, MAX_PATH);
+          wallpaper.image = mCache.Get(expandedPath, position, rect, desktop.rect, &placement);
+          if (wallpaper.image) {
+            wallpaper.tile = placement.tile;
+            wallpaper.target = D2D1::RectF(float(placement.target.left - desktop.rect.left),
+              float(placement.target.top - desktop.rect.top),
+              float(placement.target.right - desktop.rect.left),
+              float(placement.target.bottom - desktop.rect.top));
           }
-          converter->Release();
+          CoTaskMemFree(file);
         }
+
+        mWallpapers.push_back(wallpaper);
       }
-      frame->Release();
+      CoTaskMemFree(id);
     }
-    decoder->Release();
   }
-  return hr;
+
+  desktopWallpaper->Release();
+
+  // Drop the decoded sources, and any images the old wallpapers were using.
+  mCache.Trim();
+
+  QueryPerformanceCounter(&end);
+  QueryPerformanceFrequency(&frequency);
+  gModule.log->Debug(L"Loaded wallpapers in %.1f ms. %u from the disk cache, %u resampled.",
+    double(end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart,
+    mCache.GetDiskHits() - diskHits, mCache.GetMisses() - misses);
 }
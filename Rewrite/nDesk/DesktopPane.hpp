@@ -1,5 +1,7 @@
 #pragma once
 
+#include "WallpaperCache.hpp"
+
 #include "../nCoreApi/IEventHandler.hpp"
 #include "../nCoreApi/IMessageHandler.hpp"
 #include "../nCoreApi/IPane.hpp"
@@ -35,18 +37,34 @@ public:
   void APICALL RemovePane(const IPane *pane, LPVOID painterData) override;
   void APICALL TextChanged(const IPane *pane, LPVOID painterData, LPCWSTR text) override;
 
-private:
-  HRESULT CreateBitmapBrush(LPCWSTR file, ID2D1RenderTarget*, ID2D1BitmapBrush**, LPUINT widthOut,
-    LPUINT heightOut);
-
 private:
   struct Wallpaper {
+    // The monitor, in pane coordinates.
     D2D1_RECT_F rect;
-    ID2D1Brush *brush;
+    // Where the image goes, in pane coordinates.
+    D2D1_RECT_F target;
+    bool tile;
+    WallpaperCache::ImagePtr image;
+    // The background color and the image, composited to the size of the monitor. Paint only ever
+    // copies from this.
+    ID2D1Bitmap *layer;
   };
 
+private:
+  // Reads the wallpaper settings, and prepares the image for each monitor.
+  void LoadWallpapers();
+
+  // Composites the background of one monitor.
+  HRESULT CreateLayer(ID2D1RenderTarget *renderTarget, ID2D1Bitmap *image, Wallpaper &wallpaper);
+
 private:
   std::vector<Wallpaper> mWallpapers;
+  bool mWallpapersLoaded;
+  // When the pane was created, and whether the time to the first paint has been logged.
+  LARGE_INTEGER mCreationTime;
+  mutable bool mFirstPaintLogged;
+  WallpaperCache mCache;
+  D2D1_COLOR_F mBackgroundColor;
   IEventHandler *mEventHandler;
   IPane *mPane;
   ID2D1RenderTarget *mRenderTarget;
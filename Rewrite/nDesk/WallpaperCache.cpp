@@ -0,0 +1,498 @@
+#include "WallpaperCache.hpp"
+
+#include "../nCoreApi/Core.h"
+
+#include "../Headers/Macros.h"
+
+#include <algorithm>
+#include <math.h>
+#include <ShlObj.h>
+#include <wincodec.h>
+
+
+// The number of wallpapers to keep in the disk cache, across all monitor configurations.
+static const UINT MAX_DISK_CACHE_FILES = 16;
+
+
+/// <summary>
+/// A file of the disk cache, mapped into memory.
+/// </summary>
+class Win32WallpaperMapping : public WallpaperDiskCache::IMapping {
+public:
+  Win32WallpaperMapping(LPVOID view, uint64_t size)
+    : mView(view)
+    , mSize(size)
+  {
+  }
+
+  ~Win32WallpaperMapping() {
+    if (mView != nullptr) {
+      UnmapViewOfFile(mView);
+    }
+  }
+
+public:
+  const uint8_t *GetData() const override {
+    return (const uint8_t*)mView;
+  }
+
+  uint64_t GetSize() const override {
+    return mSize;
+  }
+
+private:
+  LPVOID mView;
+  uint64_t mSize;
+};
+
+
+/// <summary>
+/// Keeps the disk cache in a directory, one file per wallpaper. Files are marked as used by
+/// setting their last write time, which is what Prune goes by.
+/// </summary>
+class Win32WallpaperStorage : public WallpaperDiskCache::IStorage {
+public:
+  explicit Win32WallpaperStorage(LPCWSTR directory)
+    : mDirectory(directory)
+  {
+    SHCreateDirectoryEx(nullptr, directory, nullptr);
+  }
+
+public:
+  std::unique_ptr<WallpaperDiskCache::IMapping> Map(const std::wstring &name) override {
+    std::wstring path = GetPath(name);
+    HANDLE file = CreateFile(path.c_str(), GENERIC_READ | FILE_WRITE_ATTRIBUTES,
+      FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return nullptr;
+    }
+
+    // A file which can't be mapped, e.g. an empty one, is returned without any data, so that the
+    // cache deletes it.
+    LPVOID view = nullptr;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+      size.QuadPart = 0;
+    }
+    HANDLE mapping = size.QuadPart > 0
+      ? CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    if (mapping != nullptr) {
+      view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(file, nullptr, nullptr, &now);
+    CloseHandle(file);
+
+    return std::unique_ptr<WallpaperDiskCache::IMapping>(
+      new Win32WallpaperMapping(view, view != nullptr ? uint64_t(size.QuadPart) : 0));
+  }
+
+  bool Write(const std::wstring &name, const void *header, size_t headerSize, const void *data,
+      size_t dataSize) override {
+    // Write to a temporary file first, so that a crash never leaves a truncated file behind.
+    std::wstring path = GetPath(name);
+    std::wstring temporaryPath = path + L".tmp";
+
+    HANDLE file = CreateFile(temporaryPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+
+    DWORD written;
+    bool success = WriteFile(file, header, DWORD(headerSize), &written, nullptr) != FALSE
+      && written == headerSize
+      && WriteFile(file, data, DWORD(dataSize), &written, nullptr) != FALSE
+      && written == dataSize;
+    CloseHandle(file);
+
+    if (!success || !MoveFileEx(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+      DeleteFile(temporaryPath.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  void Delete(const std::wstring &name) override {
+    DeleteFile(GetPath(name).c_str());
+  }
+
+  void Prune(const wchar_t *extension, uint32_t maxFiles) override {
+    struct CacheFile {
+      std::wstring name;
+      FILETIME lastWrite;
+    };
+    std::vector<CacheFile> files;
+
+    WIN32_FIND_DATA findData;
+    HANDLE find = FindFirstFile(GetPath(std::wstring(L"*") + extension).c_str(), &findData);
+    if (find == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    do {
+      CacheFile file = { findData.cFileName, findData.ftLastWriteTime };
+      files.push_back(file);
+    } while (FindNextFile(find, &findData));
+    FindClose(find);
+
+    if (files.size() <= maxFiles) {
+      return;
+    }
+
+    std::sort(files.begin(), files.end(), [] (const CacheFile &a, const CacheFile &b) {
+      return CompareFileTime(&a.lastWrite, &b.lastWrite) > 0;
+    });
+    for (size_t i = maxFiles; i < files.size(); ++i) {
+      Delete(files[i].name);
+    }
+  }
+
+private:
+  std::wstring GetPath(const std::wstring &name) const {
+    return mDirectory + L"\\" + name;
+  }
+
+private:
+  std::wstring mDirectory;
+};
+
+
+static void CopyRect(const RECT &rect, int32_t out[4]) {
+  out[0] = rect.left;
+  out[1] = rect.top;
+  out[2] = rect.right;
+  out[3] = rect.bottom;
+}
+
+
+static WallpaperDiskCache::Placement ToDiskPlacement(const WallpaperPlacement &placement) {
+  WallpaperDiskCache::Placement diskPlacement;
+  diskPlacement.region[0] = placement.region.left;
+  diskPlacement.region[1] = placement.region.top;
+  diskPlacement.region[2] = placement.region.right;
+  diskPlacement.region[3] = placement.region.bottom;
+  diskPlacement.width = placement.width;
+  diskPlacement.height = placement.height;
+  CopyRect(placement.target, diskPlacement.target);
+  diskPlacement.tile = placement.tile;
+  return diskPlacement;
+}
+
+
+static void FromDiskPlacement(const WallpaperDiskCache::Placement &diskPlacement,
+    WallpaperPlacement *placement) {
+  placement->region.left = diskPlacement.region[0];
+  placement->region.top = diskPlacement.region[1];
+  placement->region.right = diskPlacement.region[2];
+  placement->region.bottom = diskPlacement.region[3];
+  placement->width = diskPlacement.width;
+  placement->height = diskPlacement.height;
+  placement->target.left = diskPlacement.target[0];
+  placement->target.top = diskPlacement.target[1];
+  placement->target.right = diskPlacement.target[2];
+  placement->target.bottom = diskPlacement.target[3];
+  placement->tile = diskPlacement.tile;
+}
+
+
+/// <summary>
+/// Retrieves the last write time and the size of the file. Both are 0 if it can't be read.
+/// </summary>
+static void GetFileInfo(LPCWSTR file, ULONGLONG *modifiedTime, ULONGLONG *size) {
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!GetFileAttributesEx(file, GetFileExInfoStandard, &data)) {
+    *modifiedTime = *size = 0;
+    return;
+  }
+  *modifiedTime =
+    ULONGLONG(data.ftLastWriteTime.dwHighDateTime) << 32 | data.ftLastWriteTime.dwLowDateTime;
+  *size = ULONGLONG(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+}
+
+
+/// <summary>
+/// Opens the first frame of the image.
+/// </summary>
+static HRESULT OpenFrame(LPCWSTR file, IWICBitmapFrameDecode **frame) {
+  IWICImagingFactory *factory = nCore::GetWICFactory();
+  IWICBitmapDecoder *decoder;
+  HRESULT hr = factory->CreateDecoderFromFilename(file, nullptr, GENERIC_READ,
+    WICDecodeMetadataCacheOnDemand, &decoder);
+  if (SUCCEEDED(hr)) {
+    hr = decoder->GetFrame(0, frame);
+    decoder->Release();
+  }
+  return hr;
+}
+
+
+WallpaperImage::WallpaperImage()
+  : width(0)
+  , height(0)
+  , pixels(nullptr)
+{
+}
+
+
+WallpaperCache::WallpaperCache()
+  : mDiskHits(0)
+  , mMisses(0)
+{
+}
+
+
+WallpaperCache::ImagePtr WallpaperCache::Get(LPCWSTR file, DESKTOP_WALLPAPER_POSITION position,
+    const RECT &monitor, const RECT &desktop, WallpaperPlacement *placement) {
+  ULONGLONG modifiedTime, fileSize;
+  GetFileInfo(file, &modifiedTime, &fileSize);
+
+  // Try the disk cache first, since it doesn't need to touch the image at all.
+  WallpaperDiskCache::Key diskKey = { file, modifiedTime, fileSize, uint32_t(position) };
+  CopyRect(monitor, diskKey.monitor);
+  CopyRect(desktop, diskKey.desktop);
+  WallpaperDiskCache::Placement diskPlacement;
+  const uint8_t *mappedPixels;
+  std::unique_ptr<WallpaperDiskCache::IMapping> mapping =
+    mDiskCache.Load(diskKey, &diskPlacement, &mappedPixels);
+  if (mapping) {
+    FromDiskPlacement(diskPlacement, placement);
+    if (const Entry *entry = FindEntry(file, modifiedTime, *placement)) {
+      return entry->image;
+    }
+    ++mDiskHits;
+    std::shared_ptr<WallpaperImage> mapped = std::make_shared<WallpaperImage>();
+    mapped->width = placement->width;
+    mapped->height = placement->height;
+    mapped->pixels = mappedPixels;
+    mapped->mapping = std::move(mapping);
+    AddEntry(file, modifiedTime, *placement, mapped);
+    return mapped;
+  }
+
+  Source *source = GetSource(file, modifiedTime);
+  if (source == nullptr) {
+    return nullptr;
+  }
+
+  if (!ComputePlacement(position, source->width, source->height, monitor, desktop, placement)) {
+    return nullptr;
+  }
+
+  if (const Entry *entry = FindEntry(file, modifiedTime, *placement)) {
+    mDiskCache.Store(diskKey, ToDiskPlacement(*placement), entry->image->pixels);
+    return entry->image;
+  }
+
+  if (source->pixels.empty() && FAILED(Decode(*source))) {
+    return nullptr;
+  }
+
+  ++mMisses;
+  std::shared_ptr<WallpaperImage> image = std::make_shared<WallpaperImage>();
+  image->width = placement->width;
+  image->height = placement->height;
+  image->buffer.resize(size_t(image->width) * image->height * 4);
+  image->pixels = image->buffer.data();
+  Resampler::Resample(source->pixels.data(), source->width, source->height, source->width * 4,
+    placement->region, image->buffer.data(), image->width, image->height, image->width * 4,
+    Resampler::Filter::Lanczos3);
+
+  mDiskCache.Store(diskKey, ToDiskPlacement(*placement), image->pixels);
+  AddEntry(file, modifiedTime, *placement, image);
+
+  return image;
+}
+
+
+void WallpaperCache::Trim() {
+  mSources.clear();
+  mEntries.erase(std::remove_if(mEntries.begin(), mEntries.end(), [] (const Entry &entry) {
+    return entry.image.use_count() == 1;
+  }), mEntries.end());
+  mDiskCache.Prune(MAX_DISK_CACHE_FILES);
+}
+
+
+void WallpaperCache::SetDiskCacheDirectory(LPCWSTR directory) {
+  mDiskCache.SetStorage(nullptr);
+  mDiskStorage.reset(directory != nullptr ? new Win32WallpaperStorage(directory) : nullptr);
+  mDiskCache.SetStorage(mDiskStorage.get());
+}
+
+
+UINT WallpaperCache::GetDiskHits() const {
+  return mDiskHits;
+}
+
+
+UINT WallpaperCache::GetMisses() const {
+  return mMisses;
+}
+
+
+bool WallpaperCache::ComputePlacement(DESKTOP_WALLPAPER_POSITION position, UINT imageWidth,
+    UINT imageHeight, const RECT &monitor, const RECT &desktop, WallpaperPlacement *placement) {
+  if (imageWidth == 0 || imageHeight == 0) {
+    return false;
+  }
+
+  placement->tile = false;
+
+  if (position == DWPOS_TILE) {
+    placement->tile = true;
+    placement->region.left = placement->region.top = 0;
+    placement->region.right = float(imageWidth);
+    placement->region.bottom = float(imageHeight);
+    placement->width = imageWidth;
+    placement->height = imageHeight;
+    placement->target = monitor;
+    return true;
+  }
+
+  // Figure out where the whole image would go.
+  const RECT &area = position == DWPOS_SPAN ? desktop : monitor;
+  const double areaWidth = double(area.right - area.left);
+  const double areaHeight = double(area.bottom - area.top);
+  double width, height;
+
+  switch (position) {
+  case DWPOS_FIT:
+    {
+      double scale = std::min(areaWidth / imageWidth, areaHeight / imageHeight);
+      width = imageWidth * scale;
+      height = imageHeight * scale;
+    }
+    break;
+
+  case DWPOS_STRETCH:
+    width = areaWidth;
+    height = areaHeight;
+    break;
+
+  case DWPOS_CENTER:
+    width = imageWidth;
+    height = imageHeight;
+    break;
+
+  default:
+  case DWPOS_FILL:
+  case DWPOS_SPAN:
+    {
+      double scale = std::max(areaWidth / imageWidth, areaHeight / imageHeight);
+      width = imageWidth * scale;
+      height = imageHeight * scale;
+    }
+    break;
+  }
+
+  const double left = area.left + (areaWidth - width) / 2.0;
+  const double top = area.top + (areaHeight - height) / 2.0;
+
+  // Only keep the part which ends up on this monitor, snapped to whole pixels.
+  RECT &target = placement->target;
+  target.left = std::max(monitor.left, LONG(floor(left + 0.5)));
+  target.top = std::max(monitor.top, LONG(floor(top + 0.5)));
+  target.right = std::min(monitor.right, LONG(floor(left + width + 0.5)));
+  target.bottom = std::min(monitor.bottom, LONG(floor(top + height + 0.5)));
+  if (target.left >= target.right || target.top >= target.bottom) {
+    return false;
+  }
+
+  const double scaleX = width / imageWidth;
+  const double scaleY = height / imageHeight;
+  placement->region.left = float((target.left - left) / scaleX);
+  placement->region.top = float((target.top - top) / scaleY);
+  placement->region.right = float((target.right - left) / scaleX);
+  placement->region.bottom = float((target.bottom - top) / scaleY);
+  placement->width = UINT(target.right - target.left);
+  placement->height = UINT(target.bottom - target.top);
+
+  return true;
+}
+
+
+const WallpaperCache::Entry *WallpaperCache::FindEntry(LPCWSTR file, ULONGLONG modifiedTime,
+    const WallpaperPlacement &placement) const {
+  for (const Entry &entry : mEntries) {
+    if (entry.modifiedTime == modifiedTime && entry.width == placement.width
+        && entry.height == placement.height && entry.region.left == placement.region.left
+        && entry.region.top == placement.region.top
+        && entry.region.right == placement.region.right
+        && entry.region.bottom == placement.region.bottom
+        && _wcsicmp(entry.file.c_str(), file) == 0) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+
+void WallpaperCache::AddEntry(LPCWSTR file, ULONGLONG modifiedTime,
+    const WallpaperPlacement &placement, const ImagePtr &image) {
+  Entry entry;
+  entry.file = file;
+  entry.modifiedTime = modifiedTime;
+  entry.region = placement.region;
+  entry.width = placement.width;
+  entry.height = placement.height;
+  entry.image = image;
+  mEntries.push_back(std::move(entry));
+}
+
+
+WallpaperCache::Source *WallpaperCache::GetSource(LPCWSTR file, ULONGLONG modifiedTime) {
+  for (Source &source : mSources) {
+    if (source.modifiedTime == modifiedTime && _wcsicmp(source.file.c_str(), file) == 0) {
+      return &source;
+    }
+  }
+
+  // Only read the size for now. Most of the time the scaled image is cached already.
+  IWICBitmapFrameDecode *frame;
+  UINT width, height;
+  HRESULT hr = OpenFrame(file, &frame);
+  if (SUCCEEDED(hr)) {
+    hr = frame->GetSize(&width, &height);
+    frame->Release();
+  }
+  if (FAILED(hr)) {
+    return nullptr;
+  }
+
+  mSources.emplace_back();
+  Source &source = mSources.back();
+  source.file = file;
+  source.modifiedTime = modifiedTime;
+  source.width = width;
+  source.height = height;
+  return &source;
+}
+
+
+HRESULT WallpaperCache::Decode(Source &source) {
+  IWICImagingFactory *factory = nCore::GetWICFactory();
+  IWICBitmapFrameDecode *frame;
+  HRESULT hr = OpenFrame(source.file.c_str(), &frame);
+  if (SUCCEEDED(hr)) {
+    IWICFormatConverter *converter;
+    hr = factory->CreateFormatConverter(&converter);
+    if (SUCCEEDED(hr)) {
+      hr = converter->Initialize(frame, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone,
+        nullptr, 0.0, WICBitmapPaletteTypeMedianCut);
+      if (SUCCEEDED(hr)) {
+        source.pixels.resize(size_t(source.width) * source.height * 4);
+        hr = converter->CopyPixels(nullptr, source.width * 4, UINT(source.pixels.size()),
+          source.pixels.data());
+        if (FAILED(hr)) {
+          source.pixels.clear();
+        }
+      }
+      converter->Release();
+    }
+    frame->Release();
+  }
+  return hr;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "WallpaperDiskCache.hpp"
+#include "WallpaperImage.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Decodes wallpapers and resamples them to each monitor, once. Images are cached by what they
+/// contain, i.e. the file, its modification time, and the exact region and size they were scaled
+/// to, so monitors with identical wallpapers and resolutions share an image. Resampled images are
+/// also written to a disk cache, if one is set, and read from there on the next start.
+/// </summary>
+class WallpaperCache {
+public:
+  typedef std::shared_ptr<const WallpaperImage> ImagePtr;
+
+public:
+  WallpaperCache();
+  WallpaperCache(const WallpaperCache&) = delete;
+  WallpaperCache &operator=(const WallpaperCache&) = delete;
+
+public:
+  /// <summary>
+  /// Returns the wallpaper for the given monitor.
+  /// </summary>
+  /// <param name="file">The wallpaper file.</param>
+  /// <param name="position">How the wallpaper is positioned.</param>
+  /// <param name="monitor">The monitor rect.</param>
+  /// <param name="desktop">The rect of the entire desktop, for spanned wallpapers.</param>
+  /// <param name="placement">Receives where to draw the image.</param>
+  /// <returns>The image, or nullptr if the wallpaper can't be loaded or isn't visible.</returns>
+  ImagePtr Get(LPCWSTR file, DESKTOP_WALLPAPER_POSITION position, const RECT &monitor,
+    const RECT &desktop, WallpaperPlacement *placement);
+
+  /// <summary>
+  /// Frees decoded source images, and every wallpaper which is no longer in use. Call this once
+  /// all monitors have been updated.
+  /// </summary>
+  void Trim();
+
+  /// <summary>
+  /// Sets the directory of the disk cache, or turns it off if the directory is nullptr.
+  /// </summary>
+  void SetDiskCacheDirectory(LPCWSTR directory);
+
+public:
+  // The number of images which have been read from the disk cache.
+  UINT GetDiskHits() const;
+
+  // The number of images which have been resampled.
+  UINT GetMisses() const;
+
+public:
+  /// <summary>
+  /// Computes where an image of the given size goes on the monitor. Returns false if none of it
+  /// is visible.
+  /// </summary>
+  static bool ComputePlacement(DESKTOP_WALLPAPER_POSITION position, UINT imageWidth,
+    UINT imageHeight, const RECT &monitor, const RECT &desktop, WallpaperPlacement *placement);
+
+private:
+  struct Source {
+    std::wstring file;
+    ULONGLONG modifiedTime;
+    UINT width;
+    UINT height;
+    // Empty until needed.
+    std::vector<BYTE> pixels;
+  };
+
+  struct Entry {
+    std::wstring file;
+    ULONGLONG modifiedTime;
+    Resampler::Region region;
+    UINT width;
+    UINT height;
+    ImagePtr image;
+  };
+
+private:
+  // Returns the cached image with the given contents, or nullptr.
+  const Entry *FindEntry(LPCWSTR file, ULONGLONG modifiedTime,
+    const WallpaperPlacement &placement) const;
+  void AddEntry(LPCWSTR file, ULONGLONG modifiedTime, const WallpaperPlacement &placement,
+    const ImagePtr &image);
+
+  Source *GetSource(LPCWSTR file, ULONGLONG modifiedTime);
+  HRESULT Decode(Source &source);
+
+private:
+  std::vector<Source> mSources;
+  std::vector<Entry> mEntries;
+  std::unique_ptr<WallpaperDiskCache::IStorage> mDiskStorage;
+  WallpaperDiskCache mDiskCache;
+
+  UINT mDiskHits;
+  UINT mMisses;
+};
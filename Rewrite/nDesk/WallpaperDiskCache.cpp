@@ -0,0 +1,176 @@
+#include "WallpaperDiskCache.hpp"
+
+#include <algorithm>
+#include <stddef.h>
+#include <string.h>
+#include <wctype.h>
+
+// Identifies wallpaper cache files, and the version of their layout.
+static const uint32_t FILE_MAGIC = 0x4350574E; // 'CPWN'
+static const uint32_t FILE_VERSION = 1;
+
+const wchar_t WallpaperDiskCache::FILE_EXTENSION[] = L".wallpaper";
+const size_t WallpaperDiskCache::HEADER_SIZE;
+
+
+/// <summary>
+/// The start of every cache file. The pixels follow immediately.
+/// </summary>
+struct WallpaperDiskCache::Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t headerSize;
+  uint32_t position;
+
+  // The key. The file name is a hash of these fields.
+  uint64_t sourceHash;
+  uint64_t modifiedTime;
+  uint64_t fileSize;
+  int32_t monitor[4];
+  int32_t desktop[4];
+
+  // The placement.
+  int32_t target[4];
+  float region[4];
+  uint32_t width;
+  uint32_t height;
+  uint32_t tile;
+
+  uint32_t reserved[3];
+};
+
+
+/// <summary>
+/// 64-bit FNV-1a.
+/// </summary>
+static uint64_t Hash(const void *data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+  const uint8_t *bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+WallpaperDiskCache::WallpaperDiskCache()
+  : mStorage(nullptr)
+{
+}
+
+
+void WallpaperDiskCache::SetStorage(IStorage *storage) {
+  mStorage = storage;
+}
+
+
+std::unique_ptr<WallpaperDiskCache::IMapping> WallpaperDiskCache::Load(const Key &key,
+    Placement *placement, const uint8_t **pixels) {
+  if (mStorage == nullptr) {
+    return nullptr;
+  }
+
+  Header expected;
+  InitializeHeader(key, &expected);
+  std::wstring name = GetFileName(expected);
+
+  std::unique_ptr<IMapping> mapping = mStorage->Map(name);
+  if (!mapping) {
+    return nullptr;
+  }
+
+  const uint64_t size = mapping->GetSize();
+  Header header;
+  bool valid = mapping->GetData() != nullptr && size >= sizeof(Header);
+  if (valid) {
+    // The mapping need not be aligned for the header.
+    memcpy(&header, mapping->GetData(), sizeof(Header));
+    valid = header.magic == FILE_MAGIC && header.version == FILE_VERSION
+      && header.headerSize == sizeof(Header)
+      && memcmp(&header.sourceHash, &expected.sourceHash,
+        offsetof(Header, target) - offsetof(Header, sourceHash)) == 0
+      && header.position == expected.position && header.width > 0 && header.height > 0
+      && size == sizeof(Header) + uint64_t(header.width) * header.height * 4;
+  }
+
+  if (!valid) {
+    mapping.reset();
+    mStorage->Delete(name);
+    return nullptr;
+  }
+
+  std::copy(header.target, header.target + 4, placement->target);
+  std::copy(header.region, header.region + 4, placement->region);
+  placement->width = header.width;
+  placement->height = header.height;
+  placement->tile = header.tile != 0;
+  *pixels = mapping->GetData() + sizeof(Header);
+
+  return mapping;
+}
+
+
+void WallpaperDiskCache::Store(const Key &key, const Placement &placement,
+    const uint8_t *pixels) {
+  if (mStorage == nullptr) {
+    return;
+  }
+
+  Header header;
+  InitializeHeader(key, &header);
+  std::copy(placement.target, placement.target + 4, header.target);
+  std::copy(placement.region, placement.region + 4, header.region);
+  header.width = placement.width;
+  header.height = placement.height;
+  header.tile = placement.tile ? 1 : 0;
+
+  mStorage->Write(GetFileName(header), &header, sizeof(Header), pixels,
+    size_t(placement.width) * placement.height * 4);
+}
+
+
+void WallpaperDiskCache::Prune(uint32_t maxFiles) {
+  if (mStorage != nullptr) {
+    mStorage->Prune(FILE_EXTENSION, maxFiles);
+  }
+}
+
+
+std::wstring WallpaperDiskCache::GetFileName(const Key &key) {
+  Header header;
+  InitializeHeader(key, &header);
+  return GetFileName(header);
+}
+
+
+void WallpaperDiskCache::InitializeHeader(const Key &key, Header *header) {
+  static_assert(sizeof(Header) == HEADER_SIZE, "The header should not have any padding");
+
+  memset(header, 0, sizeof(Header));
+  header->magic = FILE_MAGIC;
+  header->version = FILE_VERSION;
+  header->headerSize = sizeof(Header);
+  header->position = key.position;
+
+  // Paths are case insensitive, so hash them in lower case.
+  std::wstring file(key.file);
+  std::transform(file.begin(), file.end(), file.begin(), towlower);
+  header->sourceHash = Hash(file.c_str(), file.length() * sizeof(wchar_t));
+
+  header->modifiedTime = key.modifiedTime;
+  header->fileSize = key.fileSize;
+  std::copy(key.monitor, key.monitor + 4, header->monitor);
+  std::copy(key.desktop, key.desktop + 4, header->desktop);
+}
+
+
+std::wstring WallpaperDiskCache::GetFileName(const Header &header) {
+  uint64_t hash = Hash(&header.position, sizeof(header.position));
+  hash = Hash(&header.sourceHash, offsetof(Header, target) - offsetof(Header, sourceHash), hash);
+
+  static const wchar_t digits[] = L"0123456789abcdef";
+  std::wstring name(16, L'0');
+  for (int i = 15; i >= 0; --i, hash >>= 4) {
+    name[i] = digits[hash & 0xF];
+  }
+  return name + FILE_EXTENSION;
+}
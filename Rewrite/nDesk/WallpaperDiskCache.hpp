@@ -0,0 +1,121 @@
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/// <summary>
+/// Keeps resampled wallpapers on disk between sessions, so that the desktop can be painted at
+/// startup without decoding anything. Each monitor configuration gets a file named after the hash
+/// of everything that determines its pixels, which holds a fixed header followed by the raw
+/// premultiplied BGRA pixels. Files are mapped into memory and uploaded straight from the mapping.
+///
+/// The files themselves are handled by an IStorage, so that the format doesn't depend on Windows.
+/// </summary>
+class WallpaperDiskCache {
+public:
+  /// <summary>
+  /// Everything which determines what a monitor's wallpaper looks like.
+  /// </summary>
+  struct Key {
+    const wchar_t *file;
+    uint64_t modifiedTime;
+    uint64_t fileSize;
+    // A DESKTOP_WALLPAPER_POSITION.
+    uint32_t position;
+    // Left, top, right, bottom.
+    int32_t monitor[4];
+    int32_t desktop[4];
+  };
+
+  /// <summary>
+  /// Where, and from which part of the source image, the wallpaper is drawn.
+  /// </summary>
+  struct Placement {
+    // Left, top, right, bottom.
+    float region[4];
+    uint32_t width;
+    uint32_t height;
+    int32_t target[4];
+    bool tile;
+  };
+
+  /// <summary>
+  /// A read-only view of a whole file.
+  /// </summary>
+  class IMapping {
+  public:
+    virtual ~IMapping() {}
+
+  public:
+    virtual const uint8_t *GetData() const = 0;
+    virtual uint64_t GetSize() const = 0;
+  };
+
+  /// <summary>
+  /// The directory which holds the files.
+  /// </summary>
+  class IStorage {
+  public:
+    virtual ~IStorage() {}
+
+  public:
+    // Maps the file, and marks it as recently used. Returns nullptr if there is no such file.
+    virtual std::unique_ptr<IMapping> Map(const std::wstring &name) = 0;
+
+    // Creates or replaces the file with the header followed by the data. Should never leave a
+    // partially written file behind.
+    virtual bool Write(const std::wstring &name, const void *header, size_t headerSize,
+      const void *data, size_t dataSize) = 0;
+
+    virtual void Delete(const std::wstring &name) = 0;
+
+    // Deletes all but the most recently used files with the given extension.
+    virtual void Prune(const wchar_t *extension, uint32_t maxFiles) = 0;
+  };
+
+public:
+  // The extension of every cache file.
+  static const wchar_t FILE_EXTENSION[];
+
+  // The size of the header which comes before the pixels.
+  static const size_t HEADER_SIZE = 128;
+
+public:
+  WallpaperDiskCache();
+  WallpaperDiskCache(const WallpaperDiskCache&) = delete;
+  WallpaperDiskCache &operator=(const WallpaperDiskCache&) = delete;
+
+public:
+  // Turns the cache on or off. The cache is off until storage has been set. The storage must
+  // outlive the cache.
+  void SetStorage(IStorage *storage);
+
+  // Maps the cached wallpaper for the key, and retrieves its placement and pixels, which stay
+  // valid for as long as the mapping. Returns nullptr, and deletes the file, if there is no valid
+  // cached wallpaper.
+  std::unique_ptr<IMapping> Load(const Key &key, Placement *placement, const uint8_t **pixels);
+
+  // Writes a wallpaper to the cache. The pixels are tightly packed, placement.width by
+  // placement.height.
+  void Store(const Key &key, const Placement &placement, const uint8_t *pixels);
+
+  // Deletes all but the most recently used files.
+  void Prune(uint32_t maxFiles);
+
+public:
+  // Returns the name of the file which holds the wallpaper for the key.
+  static std::wstring GetFileName(const Key &key);
+
+private:
+  struct Header;
+
+private:
+  // Fills in the parts of the header which identify the key.
+  static void InitializeHeader(const Key &key, Header *header);
+  static std::wstring GetFileName(const Header &header);
+
+private:
+  IStorage *mStorage;
+};
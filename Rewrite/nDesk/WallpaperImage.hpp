@@ -0,0 +1,46 @@
+#pragma once
+
+#include "WallpaperDiskCache.hpp"
+
+#include "../nShared/Resampler.h"
+
+#include "../Headers/Windows.h"
+
+#include <memory>
+#include <ShObjIdl.h>
+#include <vector>
+
+/// <summary>
+/// Wallpaper pixels, scaled and cropped to exactly the part of a monitor they cover, in
+/// premultiplied 32bpp BGRA.
+/// </summary>
+struct WallpaperImage {
+  WallpaperImage();
+  WallpaperImage(const WallpaperImage&) = delete;
+  WallpaperImage &operator=(const WallpaperImage&) = delete;
+
+  UINT width;
+  UINT height;
+  // Tightly packed, i.e. the stride is width * 4.
+  const BYTE *pixels;
+  // Owns the pixels when they were resampled in memory.
+  std::vector<BYTE> buffer;
+  // Owns the pixels when they are mapped from the disk cache.
+  std::unique_ptr<WallpaperDiskCache::IMapping> mapping;
+};
+
+
+/// <summary>
+/// Where, and from which part of the source image, a wallpaper is drawn on a monitor.
+/// </summary>
+struct WallpaperPlacement {
+  // The part of the source image which is visible.
+  Resampler::Region region;
+  // The size to scale the region to.
+  UINT width;
+  UINT height;
+  // Where the scaled region goes, in the same coordinates as the monitor rect.
+  RECT target;
+  // True if the image should be repeated over the whole target.
+  bool tile;
+};
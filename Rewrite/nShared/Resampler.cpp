@@ -0,0 +1,215 @@
+#include "Resampler.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESAMPLER_SSE2
+#include <emmintrin.h>
+#endif
+
+using Resampler::Filter;
+
+static const double PI = 3.14159265358979323846;
+
+
+/// <summary>
+/// The source pixels, and their weights, which make up one destination pixel.
+/// </summary>
+struct Taps {
+  uint32_t first;
+  uint32_t count;
+  // Index of the first weight in the weight list.
+  size_t weights;
+};
+
+
+static double Sinc(double x) {
+  if (x == 0.0) {
+    return 1.0;
+  }
+  x *= PI;
+  return sin(x) / x;
+}
+
+
+/// <summary>
+/// Computes the taps for scaling [start, end) of a row or column of source pixels to dest pixels.
+/// </summary>
+static void ComputeTaps(uint32_t source, double start, double end, uint32_t dest, Filter filter,
+    std::vector<Taps> &taps, std::vector<float> &weights, uint32_t *maxCount) {
+  const double scale = double(dest) / (end - start);
+  // Stretch the filter over the source when shrinking, so that it acts as a low pass filter.
+  const double filterScale = std::max(1.0, 1.0 / scale);
+  const double support = (filter == Filter::Lanczos3 ? 3.0 : 0.5) * filterScale;
+
+  taps.resize(dest);
+  weights.clear();
+  *maxCount = 0;
+
+  for (uint32_t i = 0; i < dest; ++i) {
+    const double center = start + (i + 0.5) / scale;
+    const int64_t first = std::max<int64_t>(0, int64_t(floor(center - support)));
+    const int64_t last = std::min<int64_t>(int64_t(source) - 1, int64_t(ceil(center + support)));
+
+    Taps &tap = taps[i];
+    tap.weights = weights.size();
+    tap.first = uint32_t(first);
+    tap.count = 0;
+
+    double total = 0.0;
+    for (int64_t x = first; x <= last; ++x) {
+      double weight;
+      if (filter == Filter::Lanczos3) {
+        const double distance = (x + 0.5 - center) / filterScale;
+        weight = fabs(distance) < 3.0 ? Sinc(distance) * Sinc(distance / 3.0) : 0.0;
+      } else {
+        // The overlap between the source pixel and the destination pixel's footprint.
+        weight = std::max(0.0, std::min(double(x + 1), center + support)
+          - std::max(double(x), center - support));
+      }
+
+      // Skip leading zeros, but keep interior ones to keep the taps contiguous.
+      if (tap.count == 0 && weight == 0.0) {
+        tap.first = uint32_t(x + 1);
+        continue;
+      }
+      weights.push_back(float(weight));
+      total += weight;
+      ++tap.count;
+    }
+
+    if (total != 0.0) {
+      for (size_t w = tap.weights; w < weights.size(); ++w) {
+        weights[w] = float(weights[w] / total);
+      }
+    } else {
+      // Only happens for degenerate regions. Use the nearest pixel.
+      weights.resize(tap.weights);
+      weights.push_back(1.0f);
+      tap.first = uint32_t(std::min<int64_t>(int64_t(source) - 1,
+        std::max<int64_t>(0, int64_t(center))));
+      tap.count = 1;
+    }
+
+    *maxCount = std::max(*maxCount, tap.count);
+  }
+}
+
+
+/// <summary>
+/// Filters one source row horizontally, into destWidth float pixels.
+/// </summary>
+static void FilterRow(const uint8_t *in, const std::vector<Taps> &taps,
+    const std::vector<float> &weights, float *out) {
+  for (const Taps &tap : taps) {
+    const uint8_t *pixel = in + size_t(tap.first) * 4;
+    const float *weight = weights.data() + tap.weights;
+#ifdef RESAMPLER_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128 sum = _mm_setzero_ps();
+    for (uint32_t i = 0; i < tap.count; ++i, pixel += 4) {
+      __m128i bytes = _mm_cvtsi32_si128(*(const int*)pixel);
+      __m128 value = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+      sum = _mm_add_ps(sum, _mm_mul_ps(value, _mm_set1_ps(weight[i])));
+    }
+    _mm_storeu_ps(out, sum);
+#else
+    float sum[4] = { 0, 0, 0, 0 };
+    for (uint32_t i = 0; i < tap.count; ++i, pixel += 4) {
+      for (int c = 0; c < 4; ++c) {
+        sum[c] += pixel[c] * weight[i];
+      }
+    }
+    std::copy(sum, sum + 4, out);
+#endif
+    out += 4;
+  }
+}
+
+
+/// <summary>
+/// Filters a column of horizontally filtered rows into one destination row.
+/// </summary>
+static void FilterColumn(const float *const *rows, const float *weight, uint32_t count,
+    uint32_t width, uint8_t *out) {
+  for (uint32_t x = 0; x < width; ++x, out += 4) {
+    const size_t offset = size_t(x) * 4;
+#ifdef RESAMPLER_SSE2
+    __m128 sum = _mm_setzero_ps();
+    for (uint32_t i = 0; i < count; ++i) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[i] + offset), _mm_set1_ps(weight[i])));
+    }
+
+    // Ringing can push values out of range. Keep the color channels premultiplied, i.e. never
+    // brighter than alpha.
+    sum = _mm_max_ps(sum, _mm_setzero_ps());
+    __m128 alpha = _mm_min_ps(_mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 3, 3)),
+      _mm_set1_ps(255.0f));
+    sum = _mm_min_ps(sum, alpha);
+
+    __m128i value = _mm_cvtps_epi32(sum);
+    value = _mm_packs_epi32(value, value);
+    value = _mm_packus_epi16(value, value);
+    *(int*)out = _mm_cvtsi128_si32(value);
+#else
+    float sum[4] = { 0, 0, 0, 0 };
+    for (uint32_t i = 0; i < count; ++i) {
+      for (int c = 0; c < 4; ++c) {
+        sum[c] += rows[i][offset + c] * weight[i];
+      }
+    }
+
+    // Ringing can push values out of range. Keep the color channels premultiplied, i.e. never
+    // brighter than alpha.
+    const float alpha = std::min(255.0f, std::max(0.0f, sum[3]));
+    for (int c = 0; c < 3; ++c) {
+      out[c] = uint8_t(std::min(alpha, std::max(0.0f, sum[c])) + 0.5f);
+    }
+    out[3] = uint8_t(alpha + 0.5f);
+#endif
+  }
+}
+
+
+void Resampler::Resample(const uint8_t *source, uint32_t sourceWidth, uint32_t sourceHeight,
+    uint32_t sourceStride, const Region &region, uint8_t *dest, uint32_t destWidth,
+    uint32_t destHeight, uint32_t destStride, Filter filter) {
+  if (sourceWidth == 0 || sourceHeight == 0 || destWidth == 0 || destHeight == 0
+      || region.right <= region.left || region.bottom <= region.top) {
+    return;
+  }
+
+  std::vector<Taps> columnTaps, rowTaps;
+  std::vector<float> columnWeights, rowWeights;
+  uint32_t maxColumnTaps, maxRowTaps;
+  ComputeTaps(sourceWidth, region.left, region.right, destWidth, filter, columnTaps,
+    columnWeights, &maxColumnTaps);
+  ComputeTaps(sourceHeight, region.top, region.bottom, destHeight, filter, rowTaps, rowWeights,
+    &maxRowTaps);
+
+  // Horizontally filtered rows are kept in a ring, indexed by source row. The rows used by each
+  // destination row only ever move down, so every source row is filtered exactly once, and only
+  // a few rows are in memory at a time.
+  const uint32_t ringSize = maxRowTaps;
+  std::vector<float> ring(size_t(ringSize) * destWidth * 4);
+  std::vector<int64_t> ringRows(ringSize, -1);
+  std::vector<const float*> rows(ringSize);
+
+  for (uint32_t y = 0; y < destHeight; ++y) {
+    const Taps &tap = rowTaps[y];
+    for (uint32_t i = 0; i < tap.count; ++i) {
+      const uint32_t row = tap.first + i;
+      const uint32_t slot = row % ringSize;
+      float *filtered = ring.data() + size_t(slot) * destWidth * 4;
+      if (ringRows[slot] != row) {
+        FilterRow(source + size_t(row) * sourceStride, columnTaps, columnWeights, filtered);
+        ringRows[slot] = row;
+      }
+      rows[i] = filtered;
+    }
+    FilterColumn(rows.data(), rowWeights.data() + tap.weights, tap.count, destWidth,
+      dest + size_t(y) * destStride);
+  }
+}
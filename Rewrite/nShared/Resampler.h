@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+/// <summary>
+/// High quality scaling of premultiplied 32bpp images, done once on the CPU so that the result can
+/// be drawn 1:1.
+/// </summary>
+namespace Resampler {
+  enum class Filter {
+    // Averages the source pixels covered by each destination pixel.
+    Box,
+    // Windowed sinc with 3 lobes. Sharper than Box, at the cost of slight ringing.
+    Lanczos3
+  };
+
+  /// <summary>
+  /// A region of the source image, in source pixels. May be fractional.
+  /// </summary>
+  struct Region {
+    float left;
+    float top;
+    float right;
+    float bottom;
+  };
+
+  /// <summary>
+  /// Scales the given region of the source image to fill the destination image. The filter is
+  /// separable, and widens when shrinking, so that every source pixel contributes.
+  /// </summary>
+  void Resample(const uint8_t *source, uint32_t sourceWidth, uint32_t sourceHeight,
+    uint32_t sourceStride, const Region &region, uint8_t *dest, uint32_t destWidth,
+    uint32_t destHeight, uint32_t destStride, Filter filter);
+}
@@ -0,0 +1,83 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/AlgorithmExtensionTests.cpp
+// The nModules Project
+//
+// Tests for merging sorted runs, which popups use to add new items to the ones they have.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../Utilities/AlgorithmExtension.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+  // A key, and where it came from.
+  typedef std::pair<int, int> Tagged;
+
+  bool KeyLess(const Tagged &a, const Tagged &b) {
+    return a.first < b.first;
+  }
+}
+
+
+TEST(AlgorithmExtension, MergesRuns) {
+  std::vector<std::vector<int>> runs = { { 1, 4, 7 }, { 2, 5, 8 }, { 3, 6, 9 } };
+  std::vector<int> merged;
+  std::merge_runs(runs, merged, std::less<int>());
+  CHECK(std::vector<int>({ 1, 2, 3, 4, 5, 6, 7, 8, 9 }) == merged);
+}
+
+
+TEST(AlgorithmExtension, SkipsEmptyRuns) {
+  std::vector<std::vector<int>> runs = { {}, { 2, 3 }, {}, { 1 }, {} };
+  std::vector<int> merged = { 42 };
+  std::merge_runs(runs, merged, std::less<int>());
+  CHECK(std::vector<int>({ 1, 2, 3 }) == merged);
+
+  runs.clear();
+  std::merge_runs(runs, merged, std::less<int>());
+  CHECK(merged.empty());
+}
+
+
+TEST(AlgorithmExtension, EqualElementsKeepTheOrderOfTheirRuns) {
+  std::vector<std::vector<Tagged>> runs = {
+    { { 1, 0 }, { 2, 0 }, { 2, 1 } },
+    { { 1, 10 }, { 2, 10 } },
+    { { 2, 20 } }
+  };
+  std::vector<Tagged> merged;
+  std::merge_runs(runs, merged, KeyLess);
+
+  std::vector<int> tags;
+  for (const Tagged &element : merged) {
+    tags.push_back(element.second);
+  }
+  CHECK(std::vector<int>({ 0, 10, 0, 1, 10, 20 }) == tags);
+}
+
+
+TEST(AlgorithmExtension, MatchesAStableSortOfEveryRun) {
+  std::mt19937 random(7);
+  for (int round = 0; round < 50; ++round) {
+    std::vector<std::vector<Tagged>> runs(random() % 6);
+    std::vector<Tagged> all;
+    for (size_t run = 0; run < runs.size(); ++run) {
+      size_t count = random() % 40;
+      for (size_t i = 0; i < count; ++i) {
+        runs[run].push_back(Tagged(int(random() % 20), int(run * 1000 + i)));
+      }
+      std::stable_sort(runs[run].begin(), runs[run].end(), KeyLess);
+      all.insert(all.end(), runs[run].begin(), runs[run].end());
+    }
+    std::stable_sort(all.begin(), all.end(), KeyLess);
+
+    std::vector<Tagged> merged;
+    std::merge_runs(runs, merged, KeyLess);
+    CHECK_EQUAL(all.size(), merged.size());
+    CHECK(all == merged);
+  }
+}
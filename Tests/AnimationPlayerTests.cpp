@@ -0,0 +1,413 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/AnimationPlayerTests.cpp
+// The nModules Project
+//
+// Tests for nDesk's animated wallpaper player, with a source the tests can hold up.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nDesk/AnimationPlayer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+  // How long every frame of the fake animations is shown. Exact in binary, so that due times add
+  // up without rounding.
+  const double FRAME_DURATION = 0.125;
+
+  /// <summary>
+  /// What the source did, which the tests keep hold of once the player owns the source.
+  /// </summary>
+  struct SourceLog {
+    SourceLog() : renderLimit(std::numeric_limits<uint64_t>::max()), closed(false) {}
+
+    // Lets the source render frames before the given sequence number. Frames after it block
+    // until the limit is raised, or the player is destroyed.
+    void SetRenderLimit(uint64_t limit) {
+      std::lock_guard<std::mutex> lock(mutex);
+      renderLimit = limit;
+      changed.notify_all();
+    }
+
+    std::vector<uint32_t> GetComposed() {
+      std::lock_guard<std::mutex> lock(mutex);
+      return composed;
+    }
+
+    std::vector<uint64_t> GetRendered() {
+      std::lock_guard<std::mutex> lock(mutex);
+      return rendered;
+    }
+
+    bool IsClosed() {
+      std::lock_guard<std::mutex> lock(mutex);
+      return closed;
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint64_t renderLimit;
+    bool closed;
+    std::vector<uint32_t> composed;
+    std::vector<uint64_t> rendered;
+  };
+
+  /// <summary>
+  /// An animation of 1x1 frames, where every pixel holds the index of its frame.
+  /// </summary>
+  class FakeSource : public AnimationPlayer::ISource {
+  public:
+    FakeSource(SourceLog *log, uint32_t frameCount, uint32_t loopCount, bool opens = true)
+      : mLog(log), mFrameCount(frameCount), mLoopCount(loopCount), mOpens(opens), mIndex(0) {}
+
+    bool Open() override {
+      return mOpens;
+    }
+
+    void Close() override {
+      std::lock_guard<std::mutex> lock(mLog->mutex);
+      mLog->closed = true;
+    }
+
+    uint32_t GetFrameCount() override {
+      return mFrameCount;
+    }
+
+    uint32_t GetLoopCount() override {
+      return mLoopCount;
+    }
+
+    bool Compose(uint32_t index, double *duration) override {
+      std::lock_guard<std::mutex> lock(mLog->mutex);
+      mLog->composed.push_back(index);
+      mIndex = index;
+      *duration = FRAME_DURATION;
+      return true;
+    }
+
+    bool Render(const std::function<bool()> &cancelled, AnimationPlayer::Frame *frame) override {
+      std::unique_lock<std::mutex> lock(mLog->mutex);
+      while (frame->sequence >= mLog->renderLimit) {
+        if (cancelled()) {
+          return false;
+        }
+        mLog->changed.wait_for(lock, std::chrono::milliseconds(1));
+      }
+      mLog->rendered.push_back(frame->sequence);
+      frame->width = 1;
+      frame->height = 1;
+      frame->pixels.assign(4, uint8_t(mIndex));
+      return true;
+    }
+
+  private:
+    SourceLog *mLog;
+    const uint32_t mFrameCount;
+    const uint32_t mLoopCount;
+    const bool mOpens;
+    uint32_t mIndex;
+  };
+
+  /// <summary>
+  /// Counts the player's ready notifications.
+  /// </summary>
+  class ReadyCounter {
+  public:
+    ReadyCounter() : count(0) {}
+
+    void Notify() {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++count;
+      changed.notify_all();
+    }
+
+    bool WaitFor(int expected) {
+      std::unique_lock<std::mutex> lock(mutex);
+      return changed.wait_for(lock, std::chrono::seconds(5), [this, expected] () {
+        return count >= expected;
+      });
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    int count;
+  };
+
+  std::unique_ptr<AnimationPlayer> MakePlayer(SourceLog *log, uint32_t frameCount,
+      uint32_t loopCount, size_t capacity, ReadyCounter *ready = nullptr) {
+    std::unique_ptr<AnimationPlayer::ISource> source(new FakeSource(log, frameCount, loopCount));
+    return std::unique_ptr<AnimationPlayer>(new AnimationPlayer(std::move(source), capacity,
+      [ready] () {
+        if (ready != nullptr) {
+          ready->Notify();
+        }
+      }));
+  }
+
+  // Polls until the condition holds, or a few seconds have passed.
+  template <typename Condition>
+  bool WaitUntil(Condition condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!condition()) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+  }
+
+  bool WaitForBuffered(AnimationPlayer &player, size_t count) {
+    return WaitUntil([&player, count] () { return player.GetBufferedCount() >= count; });
+  }
+
+  bool Contains(const std::vector<uint64_t> &values, uint64_t value) {
+    return std::find(values.begin(), values.end(), value) != values.end();
+  }
+}
+
+
+TEST(AnimationPlayer, TheFirstUpdateShowsTheFirstFrame) {
+  SourceLog log;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 4, 0, 4);
+  CHECK(WaitForBuffered(*player, 1));
+
+  const AnimationPlayer::Frame *present;
+  CHECK_EQUAL(FRAME_DURATION, player->Update(0, &present));
+  CHECK(present != nullptr);
+  CHECK_EQUAL(0u, present->sequence);
+  CHECK_EQUAL(1u, present->width);
+  CHECK_EQUAL(size_t(4), present->pixels.size());
+}
+
+
+TEST(AnimationPlayer, FramesAreShownWhenTheyAreDue) {
+  SourceLog log;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 4, 0, 4);
+  CHECK(WaitForBuffered(*player, 4));
+
+  const AnimationPlayer::Frame *present;
+  player->Update(0, &present);
+
+  // Nothing changes until the next frame is due.
+  CHECK_EQUAL(FRAME_DURATION, player->Update(0.1, &present));
+  CHECK(present == nullptr);
+
+  CHECK(WaitForBuffered(*player, 3));
+  CHECK_EQUAL(2 * FRAME_DURATION, player->Update(FRAME_DURATION, &present));
+  CHECK(present != nullptr);
+  CHECK_EQUAL(1u, present->sequence);
+  CHECK_EQUAL(uint8_t(1), present->pixels[0]);
+  CHECK_EQUAL(uint64_t(0), player->GetDroppedCount());
+}
+
+
+TEST(AnimationPlayer, LateUpdatesDropTheFramesInBetween) {
+  SourceLog log;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 8, 0, 4);
+  CHECK(WaitForBuffered(*player, 4));
+
+  const AnimationPlayer::Frame *present;
+  player->Update(0, &present);
+  CHECK(WaitForBuffered(*player, 4));
+
+  // Frames 1 and 2 are both due. Only the last of them is shown.
+  CHECK_EQUAL(3 * FRAME_DURATION, player->Update(2.5 * FRAME_DURATION, &present));
+  CHECK(present != nullptr);
+  CHECK_EQUAL(2u, present->sequence);
+  CHECK_EQUAL(uint64_t(1), player->GetDroppedCount());
+}
+
+
+TEST(AnimationPlayer, PlaybackSlipsWhenUpdatesFallFarBehind) {
+  SourceLog log;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 8, 0, 4);
+  CHECK(WaitForBuffered(*player, 4));
+
+  const AnimationPlayer::Frame *present;
+  player->Update(0, &present);
+  CHECK(WaitForBuffered(*player, 4));
+
+  // Rather than racing through every frame which was missed, playback carries on from now.
+  CHECK_EQUAL(10 + FRAME_DURATION, player->Update(10, &present));
+  CHECK(present != nullptr);
+  CHECK_EQUAL(1u, present->sequence);
+  CHECK_EQUAL(uint64_t(0), player->GetDroppedCount());
+}
+
+
+TEST(AnimationPlayer, TheWorkerStopsOnceTheBufferIsFull) {
+  SourceLog log;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 8, 0, 2);
+  CHECK(WaitForBuffered(*player, 2));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK_EQUAL(size_t(2), player->GetBufferedCount());
+  CHECK_EQUAL(size_t(2), log.GetComposed().size());
+
+  // Showing a frame makes room for the next one.
+  const AnimationPlayer::Frame *present;
+  player->Update(0, &present);
+  CHECK(WaitUntil([&log] () { return log.GetComposed().size() == 3; }));
+}
+
+
+TEST(AnimationPlayer, FramesAreComposedInOrderForEveryLoop) {
+  SourceLog log;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 3, 2, 8);
+  CHECK(WaitUntil([&log] () { return log.IsClosed(); }));
+
+  std::vector<uint32_t> expected = { 0, 1, 2, 0, 1, 2 };
+  CHECK(log.GetComposed() == expected);
+  CHECK_EQUAL(size_t(6), player->GetBufferedCount());
+  CHECK(!player->IsFinished());
+}
+
+
+TEST(AnimationPlayer, FinishesAfterTheLastLoop) {
+  SourceLog log;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 2, 1, 4);
+  CHECK(WaitUntil([&log] () { return log.IsClosed(); }));
+
+  const AnimationPlayer::Frame *present;
+  CHECK_EQUAL(FRAME_DURATION, player->Update(0, &present));
+  CHECK_EQUAL(AnimationPlayer::IDLE, player->Update(FRAME_DURATION, &present));
+  CHECK(present != nullptr);
+  CHECK_EQUAL(1u, present->sequence);
+  CHECK(player->IsFinished());
+
+  // The last frame stays up.
+  CHECK_EQUAL(AnimationPlayer::IDLE, player->Update(1, &present));
+  CHECK(present == nullptr);
+}
+
+
+TEST(AnimationPlayer, ASingleFrameIsNotAnimated) {
+  SourceLog log;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 1, 0, 4);
+  CHECK(WaitUntil([&player] () { return player->IsFinished(); }));
+
+  const AnimationPlayer::Frame *present;
+  CHECK_EQUAL(AnimationPlayer::IDLE, player->Update(0, &present));
+  CHECK(present == nullptr);
+  CHECK(log.GetComposed().empty());
+}
+
+
+TEST(AnimationPlayer, SourcesWhichFailToOpenFinishAtOnce) {
+  SourceLog log;
+  std::unique_ptr<AnimationPlayer::ISource> source(new FakeSource(&log, 4, 0, false));
+  AnimationPlayer player(std::move(source), 4, [] () {});
+
+  CHECK(WaitUntil([&player] () { return player.IsFinished(); }));
+  CHECK(log.IsClosed());
+}
+
+
+TEST(AnimationPlayer, PausingHoldsTheCurrentFrame) {
+  SourceLog log;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 4, 0, 4);
+  CHECK(WaitForBuffered(*player, 4));
+
+  const AnimationPlayer::Frame *present;
+  player->Update(0, &present);
+  player->SetPaused(true, 0.0625);
+  CHECK(player->IsPaused());
+  CHECK_EQUAL(AnimationPlayer::IDLE, player->Update(1, &present));
+  CHECK(present == nullptr);
+
+  // Playback carries on with what was left of the frame.
+  player->SetPaused(false, 1);
+  CHECK(!player->IsPaused());
+  CHECK_EQUAL(1.0625, player->Update(1, &present));
+  CHECK(present == nullptr);
+  player->Update(1.0625, &present);
+  CHECK(present != nullptr);
+  CHECK_EQUAL(1u, present->sequence);
+}
+
+
+TEST(AnimationPlayer, CoveringEveryMonitorPauses) {
+  SourceLog log;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 4, 0, 4);
+  player->SetMonitorCount(2);
+
+  player->SetMonitorCovered(0, true, 0);
+  CHECK(player->IsCovered(0));
+  CHECK(!player->IsCovered(1));
+  CHECK(!player->IsPaused());
+
+  player->SetMonitorCovered(1, true, 0);
+  CHECK(player->IsPaused());
+
+  player->SetMonitorCovered(0, false, 0);
+  CHECK(!player->IsPaused());
+
+  // Monitors which don't exist are ignored.
+  player->SetMonitorCovered(5, true, 0);
+  CHECK(!player->IsCovered(5));
+  CHECK(!player->IsPaused());
+}
+
+
+TEST(AnimationPlayer, ReportsWhenAFrameArrivesAfterRunningOut) {
+  SourceLog log;
+  log.SetRenderLimit(0);
+  ReadyCounter ready;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 4, 0, 4, &ready);
+
+  const AnimationPlayer::Frame *present;
+  CHECK_EQUAL(AnimationPlayer::IDLE, player->Update(0, &present));
+  CHECK(present == nullptr);
+
+  log.SetRenderLimit(std::numeric_limits<uint64_t>::max());
+  CHECK(ready.WaitFor(1));
+  player->Update(0, &present);
+  CHECK(present != nullptr);
+  CHECK_EQUAL(0u, present->sequence);
+}
+
+
+TEST(AnimationPlayer, ASlowWorkerSkipsFramesWhichWouldBeLate) {
+  SourceLog log;
+  log.SetRenderLimit(1);
+  ReadyCounter ready;
+  std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 16, 0, 8, &ready);
+  CHECK(WaitForBuffered(*player, 1));
+
+  const AnimationPlayer::Frame *present;
+  player->Update(0, &present);
+  CHECK(WaitUntil([&log] () { return log.GetComposed().size() == 2; }));
+
+  // Frame 1 was due at 0.125 and is still being rendered. By the time it's done, frames 2 to 4
+  // are late too.
+  CHECK_EQUAL(AnimationPlayer::IDLE, player->Update(4 * FRAME_DURATION, &present));
+  log.SetRenderLimit(std::numeric_limits<uint64_t>::max());
+  CHECK(ready.WaitFor(1));
+  CHECK(WaitUntil([&log] () { return log.GetRendered().size() >= 3; }));
+
+  std::vector<uint64_t> rendered = log.GetRendered();
+  CHECK(Contains(rendered, 1));
+  CHECK(!Contains(rendered, 2));
+  CHECK(!Contains(rendered, 3));
+  CHECK(!Contains(rendered, 4));
+  CHECK(Contains(rendered, 5));
+}
+
+
+TEST(AnimationPlayer, DestroyingThePlayerCancelsRendering) {
+  SourceLog log;
+  log.SetRenderLimit(0);
+  {
+    std::unique_ptr<AnimationPlayer> player = MakePlayer(&log, 4, 0, 4);
+    CHECK(WaitUntil([&log] () { return log.GetComposed().size() == 1; }));
+  }
+  CHECK(log.IsClosed());
+  CHECK(log.GetRendered().empty());
+}
@@ -0,0 +1,35 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Benchmarks/Benchmark.hpp
+// The nModules Project
+//
+// A minimal harness for timing the parts of the modules which don't depend on Windows.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <chrono>
+#include <functional>
+
+namespace Benchmark {
+  typedef void (*Function)();
+
+  // Adds a benchmark to the list which BenchmarkMain runs. Used by the BENCHMARK macro.
+  struct Registrar {
+    Registrar(const char *name, Function function);
+  };
+
+  /// <summary>
+  /// Runs the operation until enough time has passed to get a stable figure, and prints how long
+  /// each run took. Setup, if given, runs before every run of the operation, and isn't timed.
+  /// </summary>
+  /// <param name="units">What one run of the operation processes, e.g. pixels, for throughput.</param>
+  void Measure(const char *label, double units, const char *unitName,
+    const std::function<void()> &operation, const std::function<void()> &setup = nullptr);
+
+  // Keeps the compiler from optimizing away a computation whose result isn't otherwise used.
+  void Consume(const void *value);
+}
+
+#define BENCHMARK(name) \
+  static void Benchmark_##name(); \
+  static Benchmark::Registrar Benchmark_##name##_registrar(#name, Benchmark_##name); \
+  static void Benchmark_##name()
@@ -0,0 +1,92 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Benchmarks/BenchmarkMain.cpp
+// The nModules Project
+//
+// Runs the benchmarks.
+//-------------------------------------------------------------------------------------------------
+#include "Benchmark.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+  struct Entry {
+    const char *name;
+    Benchmark::Function function;
+  };
+
+  std::vector<Entry> &GetEntries() {
+    static std::vector<Entry> entries;
+    return entries;
+  }
+
+  // How long to keep running an operation for.
+  const double MIN_DURATION = 0.5;
+
+  volatile const void *sSink;
+}
+
+
+Benchmark::Registrar::Registrar(const char *name, Function function) {
+  Entry entry = { name, function };
+  GetEntries().push_back(entry);
+}
+
+
+void Benchmark::Measure(const char *label, double units, const char *unitName,
+    const std::function<void()> &operation, const std::function<void()> &setup) {
+  typedef std::chrono::steady_clock Clock;
+
+  // One untimed run, to warm up caches.
+  if (setup) {
+    setup();
+  }
+  operation();
+
+  double total = 0;
+  long runs = 0;
+  do {
+    if (setup) {
+      setup();
+    }
+    Clock::time_point start = Clock::now();
+    operation();
+    total += std::chrono::duration<double>(Clock::now() - start).count();
+    ++runs;
+  } while (total < MIN_DURATION);
+
+  double perRun = total / runs;
+  if (perRun >= 1e-3) {
+    printf("  %-48s %10.3f ms", label, perRun * 1e3);
+  } else {
+    printf("  %-48s %10.3f us", label, perRun * 1e6);
+  }
+  if (units > 0) {
+    printf("  %12.1f M%s/s", units / perRun / 1e6, unitName);
+  }
+  printf("\n");
+}
+
+
+void Benchmark::Consume(const void *value) {
+  sSink = value;
+}
+
+
+/// <summary>
+/// Runs every benchmark, or only those given on the command line.
+/// </summary>
+int main(int argc, char **argv) {
+  for (const Entry &entry : GetEntries()) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; ++i) {
+      selected = selected || strcmp(argv[i], entry.name) == 0;
+    }
+    if (selected) {
+      printf("%s\n", entry.name);
+      entry.function();
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Benchmarks/EasingBenchmark.cpp
+// The nModules Project
+//
+// Compares evaluating each easing directly with looking it up in its table, for speed and for
+// accuracy.
+//-------------------------------------------------------------------------------------------------
+#include "Benchmark.hpp"
+
+#include "../../nShared/Easing.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+
+BENCHMARK(Easing) {
+  const struct {
+    Easing::Type type;
+    const char *name;
+  } easings[] = {
+    { Easing::Type::Linear, "Linear" },
+    { Easing::Type::QuadInOut, "QuadInOut" },
+    { Easing::Type::CubicOut, "CubicOut" },
+    { Easing::Type::QuartInOut, "QuartInOut" },
+    { Easing::Type::ExpoInOut, "ExpoInOut" },
+    { Easing::Type::BackOut, "BackOut" },
+    { Easing::Type::ElasticOut, "ElasticOut" },
+    { Easing::Type::BounceOut, "BounceOut" },
+    { Easing::Type::SineInOut, "SineInOut" },
+  };
+
+  // Progress values in a shuffled order, like many animations at different points.
+  const int count = 4096;
+  std::vector<float> progress(count);
+  for (int i = 0; i < count; ++i) {
+    progress[i] = float((i * 2654435761u) % count) / (count - 1);
+  }
+
+  for (auto &easing : easings) {
+    const Easing::Table &table = Easing::GetTable(easing.type);
+    double maxError = 0;
+    for (int i = 0; i <= 100000; ++i) {
+      const float p = i / 100000.0f;
+      const double error = fabs(double(table.Transform(p) - Easing::Transform(p, easing.type)));
+      maxError = std::max(maxError, error);
+    }
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s analytic", easing.name);
+    Benchmark::Measure(label, count, "evaluations", [&] () {
+      float sum = 0;
+      for (float p : progress) {
+        sum += Easing::Transform(p, easing.type);
+      }
+      Benchmark::Consume(&sum);
+    });
+    snprintf(label, sizeof(label), "%s table, max error %.1e", easing.name, maxError);
+    Benchmark::Measure(label, count, "evaluations", [&] () {
+      float sum = 0;
+      for (float p : progress) {
+        sum += table.Transform(p);
+      }
+      Benchmark::Consume(&sum);
+    });
+  }
+
+  Easing::CubicBezier curve(0.25f, 0.1f, 0.25f, 1.0f);
+  Easing::Table curveTable(curve);
+  Benchmark::Measure("cubic-bezier(.25, .1, .25, 1) solved", count, "evaluations", [&] () {
+    float sum = 0;
+    for (float p : progress) {
+      sum += curve.Transform(p);
+    }
+    Benchmark::Consume(&sum);
+  });
+  Benchmark::Measure("cubic-bezier(.25, .1, .25, 1) table", count, "evaluations", [&] () {
+    float sum = 0;
+    for (float p : progress) {
+      sum += curveTable.Transform(p);
+    }
+    Benchmark::Consume(&sum);
+  });
+}
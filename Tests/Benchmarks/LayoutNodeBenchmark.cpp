@@ -0,0 +1,68 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Benchmarks/LayoutNodeBenchmark.cpp
+// The nModules Project
+//
+// Times full and partial relayouts of a synthetic tree of 10k nodes.
+//-------------------------------------------------------------------------------------------------
+#include "Benchmark.hpp"
+
+#include "../../Rewrite/nCore/LayoutNode.hpp"
+
+#include <memory>
+#include <vector>
+
+
+BENCHMARK(LayoutNode) {
+  PaneLayout column = PaneLayout();
+  column.type = PaneLayout::Type::Column;
+  PaneLayout row = PaneLayout();
+  row.type = PaneLayout::Type::Row;
+  row.wrap = true;
+
+  PaneLayoutItem rowItem = PaneLayoutItem();
+  rowItem.fitContent = true;
+  PaneLayoutItem leafItem = PaneLayoutItem();
+  leafItem.basis = NLength(8, 0, 0);
+  leafItem.crossSize = NLength(0, 0, 16);
+  leafItem.grow = 1;
+  leafItem.shrink = 1;
+  PaneLayoutItem changedItem = leafItem;
+  changedItem.grow = 2;
+
+  // 100 wrapping rows of 100 items each.
+  LayoutNode root(nullptr);
+  root.SetLayout(&column);
+  std::vector<std::unique_ptr<LayoutNode>> nodes;
+  for (int i = 0; i < 100; ++i) {
+    nodes.emplace_back(new LayoutNode(nullptr));
+    LayoutNode *rowNode = nodes.back().get();
+    rowNode->SetLayout(&row);
+    rowNode->SetItem(&rowItem);
+    root.AppendChild(rowNode);
+    for (int j = 0; j < 100; ++j) {
+      nodes.emplace_back(new LayoutNode(nullptr));
+      nodes.back()->SetItem(&leafItem);
+      rowNode->AppendChild(nodes.back().get());
+    }
+  }
+
+  float width = 1000;
+  Benchmark::Measure("full relayout, 10k nodes", 10100, "nodes", [&] () {
+    root.Arrange(width, 4000, 96, 96);
+  }, [&] () {
+    // A new width invalidates every cached arrangement.
+    width = width == 1000 ? 1001 : 1000;
+  });
+
+  bool changed = false;
+  Benchmark::Measure("relayout after changing one item", 0, nullptr, [&] () {
+    root.Arrange(1000, 4000, 96, 96);
+  }, [&] () {
+    changed = !changed;
+    nodes[5050]->SetItem(changed ? &changedItem : &leafItem);
+  });
+
+  Benchmark::Measure("relayout with nothing dirty", 0, nullptr, [&] () {
+    root.Arrange(1000, 4000, 96, 96);
+  });
+}
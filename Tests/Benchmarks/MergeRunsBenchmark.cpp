@@ -0,0 +1,185 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Benchmarks/MergeRunsBenchmark.cpp
+// The nModules Project
+//
+// How long a popup takes to put a 5,000 entry Programs menu, loaded from two roots, in order, and
+// to add a few new entries to it, by sorting everything against merging sorted runs. Also times
+// finding the folders which the two roots have in common, by scanning against hashing.
+//-------------------------------------------------------------------------------------------------
+#include "Benchmark.hpp"
+
+#include "../../Utilities/AlgorithmExtension.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+  /// <summary>
+  /// Stands in for a popup item. Popups sort pointers to their items.
+  /// </summary>
+  struct Entry {
+    bool folder;
+    std::string name;
+  };
+
+  typedef std::vector<const Entry*> Run;
+
+  int CompareNoCase(const std::string &a, const std::string &b) {
+    size_t length = std::min(a.size(), b.size());
+    for (size_t i = 0; i < length; ++i) {
+      int difference = tolower((unsigned char)a[i]) - tolower((unsigned char)b[i]);
+      if (difference != 0) {
+        return difference;
+      }
+    }
+    return int(a.size()) - int(b.size());
+  }
+
+  // The order of PopupItem::CompareTo, folders first, then by name.
+  bool ComesBefore(const Entry *a, const Entry *b) {
+    return (a->folder && !b->folder) ||
+      (a->folder == b->folder && CompareNoCase(a->name, b->name) < 0);
+  }
+
+  struct HashNoCase {
+    size_t operator()(const std::string &key) const {
+      size_t hash = 2166136261u;
+      for (char c : key) {
+        hash = (hash ^ size_t(tolower((unsigned char)c))) * 16777619u;
+      }
+      return hash;
+    }
+  };
+
+  struct EqualNoCase {
+    bool operator()(const std::string &a, const std::string &b) const {
+      return CompareNoCase(a, b) == 0;
+    }
+  };
+
+  // Makes a root with the given number of entries, one in ten a folder, in enumeration order.
+  // Folders are named so that the two roots have some in common, as the user's and the common
+  // Programs folders do.
+  std::vector<Entry> MakeRoot(const char *prefix, int count, std::mt19937 &random) {
+    std::vector<Entry> root;
+    char name[64];
+    for (int i = 0; i < count; ++i) {
+      if (i % 10 == 0) {
+        snprintf(name, sizeof(name), "Vendor %d", int(random() % 500));
+        root.push_back(Entry { true, name });
+      } else {
+        snprintf(name, sizeof(name), "%s Application %d", prefix, int(random() % 100000));
+        root.push_back(Entry { false, name });
+      }
+    }
+    return root;
+  }
+
+  Run Pointers(const std::vector<Entry> &entries) {
+    Run run;
+    for (const Entry &entry : entries) {
+      run.push_back(&entry);
+    }
+    return run;
+  }
+}
+
+
+BENCHMARK(MergeRuns) {
+  std::mt19937 random(12345);
+  std::vector<Entry> user = MakeRoot("User", 1000, random);
+  std::vector<Entry> common = MakeRoot("Common", 4000, random);
+  std::vector<Entry> added = MakeRoot("New", 50, random);
+
+  Run all = Pointers(user);
+  Run commonRun = Pointers(common);
+  all.insert(all.end(), commonRun.begin(), commonRun.end());
+
+  // Loading the popup.
+  Run items;
+  Benchmark::Measure("5000 entries from 2 roots, sorted together", 5000, "entries", [&] () {
+    std::sort(items.begin(), items.end(), ComesBefore);
+    Benchmark::Consume(items.data());
+  }, [&] () {
+    items = all;
+  });
+
+  std::vector<Run> runs;
+  Benchmark::Measure("5000 entries from 2 roots, runs merged", 5000, "entries", [&] () {
+    for (Run &run : runs) {
+      std::sort(run.begin(), run.end(), ComesBefore);
+    }
+    std::merge_runs(runs, items, ComesBefore);
+    Benchmark::Consume(items.data());
+  }, [&] () {
+    runs.clear();
+    runs.push_back(Pointers(user));
+    runs.push_back(Pointers(common));
+  });
+
+  // Entries which show up in a watched folder while the popup is open.
+  Run sorted = all;
+  std::sort(sorted.begin(), sorted.end(), ComesBefore);
+  Run addedRun = Pointers(added);
+
+  Benchmark::Measure("50 new entries into 5000, sorted together", 0, "", [&] () {
+    std::sort(items.begin(), items.end(), ComesBefore);
+    Benchmark::Consume(items.data());
+  }, [&] () {
+    items = sorted;
+    items.insert(items.end(), addedRun.begin(), addedRun.end());
+  });
+
+  Benchmark::Measure("50 new entries into 5000, runs merged", 0, "", [&] () {
+    std::sort(runs[1].begin(), runs[1].end(), ComesBefore);
+    std::merge_runs(runs, items, ComesBefore);
+    Benchmark::Consume(items.data());
+  }, [&] () {
+    runs.clear();
+    runs.push_back(sorted);
+    runs.push_back(addedRun);
+  });
+
+  // Finding the folder which a folder from the second root is merged into, for every entry of
+  // the second root.
+  Run userRun = Pointers(user);
+  Benchmark::Measure("Folder merges for 4000 entries, scanned", 4000, "entries", [&] () {
+    items = userRun;
+    for (const Entry *entry : commonRun) {
+      const Entry *match = nullptr;
+      if (entry->folder) {
+        for (const Entry *item : items) {
+          if (item->folder && CompareNoCase(item->name, entry->name) == 0) {
+            match = item;
+            break;
+          }
+        }
+      }
+      if (match == nullptr) {
+        items.push_back(entry);
+      }
+    }
+    Benchmark::Consume(items.data());
+  });
+
+  Benchmark::Measure("Folder merges for 4000 entries, hashed", 4000, "entries", [&] () {
+    std::unordered_map<std::string, const Entry*, HashNoCase, EqualNoCase> folders;
+    items = userRun;
+    for (const Entry *item : items) {
+      if (item->folder) {
+        folders.emplace(item->name, item);
+      }
+    }
+    for (const Entry *entry : commonRun) {
+      if (!entry->folder || folders.emplace(entry->name, entry).second) {
+        items.push_back(entry);
+      }
+    }
+    Benchmark::Consume(items.data());
+  });
+}
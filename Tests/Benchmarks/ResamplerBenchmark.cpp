@@ -0,0 +1,73 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Benchmarks/ResamplerBenchmark.cpp
+// The nModules Project
+//
+// Times scaling 6K and 8K wallpapers down to common monitor resolutions.
+//-------------------------------------------------------------------------------------------------
+#include "Benchmark.hpp"
+
+#include "../../Rewrite/nShared/Resampler.h"
+
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+
+BENCHMARK(Resampler) {
+  struct Case {
+    uint32_t sourceWidth, sourceHeight, destWidth, destHeight;
+  };
+  const Case cases[] = {
+    { 6144, 3456, 1920, 1080 },
+    { 6144, 3456, 2560, 1440 },
+    { 7680, 4320, 3840, 2160 },
+    // Fill mode on a portrait monitor, which crops most of the width away.
+    { 7680, 4320, 1080, 1920 },
+  };
+  const struct {
+    Resampler::Filter filter;
+    const char *name;
+  } filters[] = {
+    { Resampler::Filter::Box, "box" },
+    { Resampler::Filter::Lanczos3, "lanczos3" },
+  };
+
+  std::mt19937 random(31);
+  std::vector<uint8_t> source;
+  std::vector<uint8_t> dest;
+  for (const Case &test : cases) {
+    source.resize(size_t(test.sourceWidth) * test.sourceHeight * 4);
+    for (size_t i = 0; i < source.size(); i += 4) {
+      uint32_t value = random();
+      source[i] = uint8_t(value);
+      source[i + 1] = uint8_t(value >> 8);
+      source[i + 2] = uint8_t(value >> 16);
+      source[i + 3] = 255;
+    }
+    dest.resize(size_t(test.destWidth) * test.destHeight * 4);
+
+    // Crop the source to the aspect ratio of the destination, like the fill mode does.
+    Resampler::Region region;
+    float cropWidth = std::min(float(test.sourceWidth),
+      float(test.sourceHeight) * test.destWidth / test.destHeight);
+    float cropHeight = std::min(float(test.sourceHeight),
+      float(test.sourceWidth) * test.destHeight / test.destWidth);
+    region.left = (test.sourceWidth - cropWidth) / 2;
+    region.top = (test.sourceHeight - cropHeight) / 2;
+    region.right = region.left + cropWidth;
+    region.bottom = region.top + cropHeight;
+
+    for (auto &filter : filters) {
+      char label[64];
+      snprintf(label, sizeof(label), "%ux%u -> %ux%u %s", test.sourceWidth, test.sourceHeight,
+        test.destWidth, test.destHeight, filter.name);
+      Benchmark::Measure(label, double(cropWidth) * cropHeight, "source pixels", [&] () {
+        Resampler::Resample(source.data(), test.sourceWidth, test.sourceHeight,
+          test.sourceWidth * 4, region, dest.data(), test.destWidth, test.destHeight,
+          test.destWidth * 4, filter.filter);
+        Benchmark::Consume(dest.data());
+      });
+    }
+  }
+}
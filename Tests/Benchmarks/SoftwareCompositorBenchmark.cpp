@@ -0,0 +1,67 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Benchmarks/SoftwareCompositorBenchmark.cpp
+// The nModules Project
+//
+// Times a frame of each transition at 3840x2160, with every instruction set.
+//-------------------------------------------------------------------------------------------------
+#include "Benchmark.hpp"
+
+#include "../../nDesk/BlendKernels.hpp"
+#include "../../nDesk/SoftwareCompositor.hpp"
+
+#include <stdio.h>
+#include <vector>
+
+
+BENCHMARK(SoftwareCompositor) {
+  const uint32_t width = 3840, height = 2160;
+  std::vector<uint8_t> oldPixels(size_t(width) * height * 4, 0x40);
+  std::vector<uint8_t> newPixels(oldPixels.size(), 0xC0);
+  std::vector<uint8_t> targetPixels(oldPixels.size());
+  const SoftwareCompositor::Surface oldImage = { oldPixels.data(), width, height, width * 4 };
+  const SoftwareCompositor::Surface newImage = { newPixels.data(), width, height, width * 4 };
+  const SoftwareCompositor::Surface target = { targetPixels.data(), width, height, width * 4 };
+
+  const struct {
+    SoftwareCompositor::Effect effect;
+    const char *name;
+  } effects[] = {
+    { SoftwareCompositor::Effect::Fade, "fade" },
+    { SoftwareCompositor::Effect::Slide, "slide" },
+    { SoftwareCompositor::Effect::Grid, "grid" },
+    { SoftwareCompositor::Effect::Blinds, "blinds" },
+    { SoftwareCompositor::Effect::Circular, "circular" },
+  };
+  const struct {
+    BlendKernels::InstructionSet instructionSet;
+    const char *name;
+  } instructionSets[] = {
+    { BlendKernels::InstructionSet::Scalar, "scalar" },
+    { BlendKernels::InstructionSet::SSE2, "SSE2" },
+    { BlendKernels::InstructionSet::AVX2, "AVX2" },
+  };
+
+  const BlendKernels::InstructionSet original = BlendKernels::GetInstructionSet();
+  for (auto &instructionSet : instructionSets) {
+    BlendKernels::SetInstructionSet(instructionSet.instructionSet);
+    if (BlendKernels::GetInstructionSet() != instructionSet.instructionSet) {
+      printf("  %s is not supported\n", instructionSet.name);
+      continue;
+    }
+    for (auto &effect : effects) {
+      SoftwareCompositor compositor;
+      SoftwareCompositor::Transition transition;
+      transition.effect = effect.effect;
+      compositor.SetTransition(transition);
+
+      char label[64];
+      snprintf(label, sizeof(label), "%s frame, %s", effect.name, instructionSet.name);
+      Benchmark::Measure(label, double(width) * height, "pixels", [&] () {
+        // Mid-transition, where the most pixels are blended.
+        compositor.Paint(oldImage, newImage, target, 0.45f);
+        Benchmark::Consume(targetPixels.data());
+      });
+    }
+  }
+  BlendKernels::SetInstructionSet(original);
+}
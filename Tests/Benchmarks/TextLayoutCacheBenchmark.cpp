@@ -0,0 +1,49 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Benchmarks/TextLayoutCacheBenchmark.cpp
+// The nModules Project
+//
+// Times lookups in the text layout cache, with a fake shaper.
+//-------------------------------------------------------------------------------------------------
+#include "Benchmark.hpp"
+#include "../FakeTextShaper.hpp"
+
+#include "../../nShared/TextLayoutCache.hpp"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+
+BENCHMARK(TextLayoutCache) {
+  FakeTextShaper shaper;
+  int format;
+
+  // Labels like those of a taskbar with 1000 buttons.
+  std::vector<std::wstring> texts;
+  for (int i = 0; i < 1000; ++i) {
+    wchar_t text[64];
+    swprintf(text, 64, L"Document %d - Some Application", i);
+    texts.push_back(text);
+  }
+
+  TextLayoutCache cache(&shaper, 64 << 20);
+  for (const std::wstring &text : texts) {
+    cache.Get(text.c_str(), &format, 200, 20);
+  }
+  Benchmark::Measure("1000 hits", 1000, "lookups", [&] () {
+    for (const std::wstring &text : texts) {
+      Benchmark::Consume(cache.Get(text.c_str(), &format, 200, 20).get());
+    }
+  });
+
+  // A budget which holds half of the layouts, cycled through in order, so that every lookup
+  // misses and evicts.
+  TextLayoutCache small(&shaper, 0);
+  small.Get(texts[0].c_str(), &format, 200, 20);
+  small.SetBudget(small.GetCost() * 500);
+  Benchmark::Measure("1000 misses with evictions", 1000, "lookups", [&] () {
+    for (const std::wstring &text : texts) {
+      Benchmark::Consume(small.Get(text.c_str(), &format, 200, 20).get());
+    }
+  });
+}
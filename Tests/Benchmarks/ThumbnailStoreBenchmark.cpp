@@ -0,0 +1,77 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Benchmarks/ThumbnailStoreBenchmark.cpp
+// The nModules Project
+//
+// How long nCore's thumbnail store takes to add, look up and reopen 5,000 48px thumbnails, i.e. a
+// large desktop. The files are kept in memory, so this is the store's own cost, without the disk.
+//-------------------------------------------------------------------------------------------------
+#include "Benchmark.hpp"
+
+#include "../MemoryThumbnailStorage.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+  ThumbnailStore::Key MakeKey(int file) {
+    ThumbnailStore::Key key = {
+      L"C:\\Users\\Someone\\Desktop\\File " + std::to_wstring(file) + L".txt",
+      uint64_t(1000 + file), uint64_t(file * 7), 48
+    };
+    return key;
+  }
+}
+
+
+BENCHMARK(ThumbnailStore) {
+  const int count = 5000;
+  const uint64_t capacity = 256ull << 20;
+
+  std::vector<uint8_t> pixels(48 * 48 * 4, 0x80);
+  std::vector<ThumbnailStore::Key> keys;
+  for (int i = 0; i < count; ++i) {
+    keys.push_back(MakeKey(i));
+  }
+
+  MemoryThumbnailStorage storage;
+  Benchmark::Measure("Insert 5000 48px thumbnails", 0, "", [&] () {
+    ThumbnailStore store(&storage, capacity);
+    store.Open();
+    for (const ThumbnailStore::Key &key : keys) {
+      store.Insert(key, 48, 48, pixels.data());
+    }
+    store.Flush();
+  }, [&] () {
+    storage.data.clear();
+    storage.hasIndex = false;
+  });
+
+  // The storage now holds all of them, with an index.
+  ThumbnailStore store(&storage, capacity);
+  store.Open();
+  std::mt19937 random(5);
+  std::vector<uint8_t> found;
+  Benchmark::Measure("Look up 5000 thumbnails at random", 0, "", [&] () {
+    uint32_t width, height;
+    for (int i = 0; i < count; ++i) {
+      store.Lookup(keys[random() % count], &width, &height, &found);
+    }
+    Benchmark::Consume(found.data());
+  });
+
+  // Startup, which is what the index is for.
+  Benchmark::Measure("Open 5000 thumbnails from the index", 0, "", [&] () {
+    ThumbnailStore reopened(&storage, capacity);
+    reopened.Open();
+    Benchmark::Consume(&reopened);
+  });
+
+  Benchmark::Measure("Open 5000 thumbnails without the index", 0, "", [&] () {
+    ThumbnailStore reopened(&storage, capacity);
+    reopened.Open();
+    Benchmark::Consume(&reopened);
+  }, [&] () {
+    storage.hasIndex = false;
+  });
+}
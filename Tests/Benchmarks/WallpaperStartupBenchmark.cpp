@@ -0,0 +1,213 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Benchmarks/WallpaperStartupBenchmark.cpp
+// The nModules Project
+//
+// Compares the two ways nDesk gets a monitor's wallpaper at startup. Without the disk cache, the
+// source is resampled to the monitor. With it, WallpaperDiskCache::Load maps the cached file, and
+// the pixels are copied out of the mapping, as uploading them to the GPU does.
+//-------------------------------------------------------------------------------------------------
+#include "Benchmark.hpp"
+
+#include "../../Rewrite/nDesk/WallpaperDiskCache.hpp"
+#include "../../Rewrite/nShared/Resampler.h"
+
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  /// <summary>
+  /// Keeps the cache in the temporary directory. Files are mapped on Linux, and read in whole
+  /// elsewhere.
+  /// </summary>
+  class FileStorage : public WallpaperDiskCache::IStorage {
+  public:
+    class Mapping : public WallpaperDiskCache::IMapping {
+    public:
+      Mapping(const uint8_t *data, uint64_t size) : mData(data), mSize(size) {}
+
+      ~Mapping() {
+#if defined(__linux__)
+        if (mData != nullptr) {
+          munmap((void*)mData, size_t(mSize));
+        }
+#endif
+      }
+
+      const uint8_t *GetData() const override {
+        return mData;
+      }
+
+      uint64_t GetSize() const override {
+        return mSize;
+      }
+
+    public:
+      std::vector<uint8_t> buffer;
+
+    private:
+      const uint8_t *mData;
+      uint64_t mSize;
+    };
+
+  public:
+    FileStorage() {
+#if defined(_WIN32)
+      const char *directory = getenv("TEMP");
+      mDirectory = directory != nullptr ? directory : ".";
+#else
+      const char *directory = getenv("TMPDIR");
+      mDirectory = directory != nullptr ? directory : "/tmp";
+#endif
+    }
+
+    std::string GetPath(const std::wstring &name) const {
+      // Cache file names are plain ASCII.
+      return mDirectory + "/" + std::string(name.begin(), name.end());
+    }
+
+    std::unique_ptr<WallpaperDiskCache::IMapping> Map(const std::wstring &name) override {
+      std::string path = GetPath(name);
+#if defined(__linux__)
+      int file = open(path.c_str(), O_RDONLY);
+      if (file == -1) {
+        return nullptr;
+      }
+      struct stat info;
+      void *view = MAP_FAILED;
+      if (fstat(file, &info) == 0 && info.st_size > 0) {
+        view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, file, 0);
+      }
+      close(file);
+      if (view == MAP_FAILED) {
+        return std::unique_ptr<WallpaperDiskCache::IMapping>(new Mapping(nullptr, 0));
+      }
+      return std::unique_ptr<WallpaperDiskCache::IMapping>(
+        new Mapping((const uint8_t*)view, uint64_t(info.st_size)));
+#else
+      FILE *file = fopen(path.c_str(), "rb");
+      if (file == nullptr) {
+        return nullptr;
+      }
+      std::vector<uint8_t> buffer;
+      uint8_t chunk[65536];
+      for (size_t read; (read = fread(chunk, 1, sizeof(chunk), file)) > 0;) {
+        buffer.insert(buffer.end(), chunk, chunk + read);
+      }
+      fclose(file);
+      std::unique_ptr<Mapping> mapping(new Mapping(buffer.data(), buffer.size()));
+      mapping->buffer.swap(buffer);
+      return std::move(mapping);
+#endif
+    }
+
+    bool Write(const std::wstring &name, const void *header, size_t headerSize, const void *data,
+        size_t dataSize) override {
+      std::string path = GetPath(name);
+      FILE *file = fopen(path.c_str(), "wb");
+      if (file == nullptr) {
+        return false;
+      }
+      bool success = fwrite(header, 1, headerSize, file) == headerSize
+        && fwrite(data, 1, dataSize, file) == dataSize;
+      return fclose(file) == 0 && success;
+    }
+
+    void Delete(const std::wstring &name) override {
+      remove(GetPath(name).c_str());
+    }
+
+    void Prune(const wchar_t*, uint32_t) override {}
+
+  private:
+    std::string mDirectory;
+  };
+}
+
+
+BENCHMARK(WallpaperStartup) {
+  const uint32_t sourceWidth = 6144, sourceHeight = 3456;
+  const uint32_t monitorWidth = 2560, monitorHeight = 1440;
+
+  std::mt19937 random(32);
+  std::vector<uint8_t> source(size_t(sourceWidth) * sourceHeight * 4);
+  for (size_t i = 0; i < source.size(); i += 4) {
+    uint32_t value = random();
+    source[i] = uint8_t(value);
+    source[i + 1] = uint8_t(value >> 8);
+    source[i + 2] = uint8_t(value >> 16);
+    source[i + 3] = 255;
+  }
+  std::vector<uint8_t> pixels(size_t(monitorWidth) * monitorHeight * 4);
+  const Resampler::Region region = { 0, 0, float(sourceWidth), float(sourceHeight) };
+
+  // This leaves out decoding the JPEG, which the cache saves as well.
+  Benchmark::Measure("Cache miss: resample 6144x3456 to 2560x1440",
+      double(sourceWidth) * sourceHeight, "source pixels", [&] () {
+    Resampler::Resample(source.data(), sourceWidth, sourceHeight, sourceWidth * 4, region,
+      pixels.data(), monitorWidth, monitorHeight, monitorWidth * 4, Resampler::Filter::Lanczos3);
+    Benchmark::Consume(pixels.data());
+  });
+
+  FileStorage storage;
+  WallpaperDiskCache cache;
+  cache.SetStorage(&storage);
+
+  const WallpaperDiskCache::Key key = {
+    L"C:\\Wallpapers\\Benchmark.jpg", 1, source.size(), 4,
+    { 0, 0, int32_t(monitorWidth), int32_t(monitorHeight) },
+    { 0, 0, int32_t(monitorWidth), int32_t(monitorHeight) }
+  };
+  const WallpaperDiskCache::Placement placement = {
+    { region.left, region.top, region.right, region.bottom }, monitorWidth, monitorHeight,
+    { 0, 0, int32_t(monitorWidth), int32_t(monitorHeight) }, false
+  };
+  cache.Store(key, placement, pixels.data());
+
+  std::vector<uint8_t> uploaded(pixels.size());
+  bool hit = true;
+  auto load = [&] () {
+    WallpaperDiskCache::Placement loadedPlacement;
+    const uint8_t *loaded;
+    std::unique_ptr<WallpaperDiskCache::IMapping> mapping =
+      cache.Load(key, &loadedPlacement, &loaded);
+    if (!mapping) {
+      hit = false;
+      return;
+    }
+    memcpy(uploaded.data(), loaded, uploaded.size());
+    Benchmark::Consume(uploaded.data());
+  };
+
+  const double bytes = double(WallpaperDiskCache::HEADER_SIZE + pixels.size());
+  Benchmark::Measure("Cache hit, file in the page cache", bytes, "bytes", load);
+
+#if defined(__linux__)
+  // The first start after a reboot has to go to the disk. Dropping the file from the page cache
+  // only needs it to be clean.
+  const std::string path = storage.GetPath(WallpaperDiskCache::GetFileName(key));
+  Benchmark::Measure("Cache hit, file not in the page cache", bytes, "bytes", load, [&] () {
+    int file = open(path.c_str(), O_RDONLY);
+    if (file != -1) {
+      fdatasync(file);
+      posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+      close(file);
+    }
+  });
+#endif
+
+  if (!hit) {
+    printf("  The cached wallpaper could not be loaded\n");
+  }
+  storage.Delete(WallpaperDiskCache::GetFileName(key));
+}
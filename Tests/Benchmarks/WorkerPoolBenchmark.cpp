@@ -0,0 +1,123 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Benchmarks/WorkerPoolBenchmark.cpp
+// The nModules Project
+//
+// How long nCore's worker pool takes to get to a job which is needed on screen while it is busy
+// with others, and how it compares to the thread per request which it replaced. The jobs are fake,
+// and spin for about as long as a quick shell call.
+//-------------------------------------------------------------------------------------------------
+#include "Benchmark.hpp"
+
+#include "../../nCore/WorkerPool.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  // Stands in for a shell call, e.g. extracting a thumbnail.
+  void Spin(std::chrono::microseconds duration) {
+    Clock::time_point end = Clock::now() + duration;
+    while (Clock::now() < end);
+  }
+
+  /// <summary>
+  /// Lets a thread wait for a number of jobs to finish.
+  /// </summary>
+  class Latch {
+  public:
+    Latch() : mCount(0) {}
+
+    void Reset(int count) {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mCount = count;
+    }
+
+    void CountDown() {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (--mCount == 0) {
+        mDone.notify_all();
+      }
+    }
+
+    void Wait() {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mDone.wait(lock, [this] () { return mCount <= 0; });
+    }
+
+  private:
+    std::mutex mMutex;
+    std::condition_variable mDone;
+    int mCount;
+  };
+}
+
+
+BENCHMARK(WorkerPool) {
+  const size_t threads = 4;
+  const int backlog = 256;
+  const std::chrono::microseconds jobDuration(50);
+
+  WorkerPool pool(threads);
+  Latch backlogDone, jobDone;
+  WorkerPool::CancellationToken token;
+
+  // A folder is being prefetched when a tile scrolls into view, and needs its icon.
+  auto queueBacklog = [&] () {
+    backlogDone.Wait();
+    backlogDone.Reset(backlog);
+    for (int i = 0; i < backlog; ++i) {
+      pool.Submit(WorkerPool::Priority::Prefetch, token, [&] () {
+        Spin(jobDuration);
+        backlogDone.CountDown();
+      });
+    }
+  };
+  auto loadIcon = [&] (WorkerPool::Priority priority) {
+    jobDone.Reset(1);
+    pool.Submit(priority, token, [&] () {
+      Spin(jobDuration);
+      jobDone.CountDown();
+    });
+    jobDone.Wait();
+  };
+
+  Benchmark::Measure("Visible load behind 256 prefetch jobs", 0, "", [&] () {
+    loadIcon(WorkerPool::Priority::Visible);
+  }, queueBacklog);
+
+  // Where it would be with a single lane.
+  Benchmark::Measure("Same load in the prefetch lane", 0, "", [&] () {
+    loadIcon(WorkerPool::Priority::Prefetch);
+  }, queueBacklog);
+  backlogDone.Wait();
+
+  // Pasting a few hundred files onto the desktop used to start a thread for every one of them.
+  const int files = 500;
+  const std::chrono::microseconds fileDuration(20);
+
+  Benchmark::Measure("500 loads on a thread each", 0, "", [&] () {
+    std::vector<std::thread> spawned;
+    for (int i = 0; i < files; ++i) {
+      spawned.emplace_back([&] () { Spin(fileDuration); });
+    }
+    for (std::thread &thread : spawned) {
+      thread.join();
+    }
+  });
+
+  Benchmark::Measure("500 loads on a pool of 4 threads", 0, "", [&] () {
+    jobDone.Reset(files);
+    for (int i = 0; i < files; ++i) {
+      pool.Submit(WorkerPool::Priority::Offscreen, token, [&] () {
+        Spin(fileDuration);
+        jobDone.CountDown();
+      });
+    }
+    jobDone.Wait();
+  });
+}
@@ -0,0 +1,213 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/ChangeCoalescerTests.cpp
+// The nModules Project
+//
+// Tests for how bursts of shell change notifications are boiled down to their net effect.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../Utilities/ChangeCoalescer.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+  typedef ChangeCoalescer<std::string, int> Coalescer;
+
+  // Joins the entries of a list, in order of name, so that the map order doesn't matter.
+  std::string Join(std::vector<std::string> entries) {
+    std::sort(entries.begin(), entries.end());
+    std::string joined;
+    for (const std::string &entry : entries) {
+      joined += (joined.empty() ? "" : " ") + entry;
+    }
+    return joined;
+  }
+
+  /// <summary>
+  /// Takes the changes from a coalescer, and writes them down as e.g.
+  /// "deleted: a | renamed: b>c=1 | created: d=2 | updated: e=3".
+  /// </summary>
+  std::string Take(Coalescer &coalescer) {
+    Coalescer::Changes changes = coalescer.Take();
+    std::vector<std::string> deleted, renamed, created, updated;
+
+    for (const std::string &key : changes.deleted) {
+      deleted.push_back(key);
+    }
+    for (const Coalescer::NameChange &change : changes.renamed) {
+      renamed.push_back(change.from + ">" + change.to + "=" + std::to_string(change.value));
+    }
+    for (const Coalescer::Change &change : changes.created) {
+      created.push_back(change.key + "=" + std::to_string(change.value));
+    }
+    for (const Coalescer::Change &change : changes.updated) {
+      updated.push_back(change.key + "=" + std::to_string(change.value));
+    }
+
+    return "deleted: " + Join(deleted) + " | renamed: " + Join(renamed) + " | created: " +
+      Join(created) + " | updated: " + Join(updated);
+  }
+}
+
+
+TEST(ChangeCoalescer, NothingHappened) {
+  Coalescer coalescer;
+  CHECK(coalescer.IsEmpty());
+  CHECK_EQUAL(std::string("deleted:  | renamed:  | created:  | updated: "), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, SingleEventsPassThrough) {
+  Coalescer coalescer;
+  coalescer.Create("new", 1);
+  coalescer.Delete("old");
+  coalescer.Rename("from", "to", 2);
+  coalescer.Update("changed", 3);
+  CHECK(!coalescer.IsEmpty());
+  CHECK_EQUAL(
+    std::string("deleted: old | renamed: from>to=2 | created: new=1 | updated: changed=3"),
+    Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, CreateThenDeleteCancelsOut) {
+  Coalescer coalescer;
+  coalescer.Create("a", 1);
+  coalescer.Update("a", 2);
+  coalescer.Delete("a");
+  CHECK_EQUAL(std::string("deleted:  | renamed:  | created:  | updated: "), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, DeleteThenCreateIsAnUpdate) {
+  Coalescer coalescer;
+  coalescer.Delete("a");
+  coalescer.Create("a", 2);
+  CHECK_EQUAL(std::string("deleted:  | renamed:  | created:  | updated: a=2"), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, MissedDeleteIsAnUpdate) {
+  Coalescer coalescer;
+  coalescer.Update("a", 1);
+  coalescer.Create("a", 2);
+  CHECK_EQUAL(std::string("deleted:  | renamed:  | created:  | updated: a=2"), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, LastValueWins) {
+  Coalescer coalescer;
+  coalescer.Update("a", 1);
+  coalescer.Update("a", 2);
+  coalescer.Create("b", 3);
+  coalescer.Update("b", 4);
+  CHECK_EQUAL(std::string("deleted:  | renamed:  | created: b=4 | updated: a=2"), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, RenameBackAndForthCancelsOut) {
+  Coalescer coalescer;
+  coalescer.Rename("a", "b", 1);
+  coalescer.Rename("b", "c", 2);
+  coalescer.Rename("c", "a", 3);
+  CHECK_EQUAL(std::string("deleted:  | renamed:  | created:  | updated: "), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, RenameToTheSameNameIsAnUpdate) {
+  Coalescer coalescer;
+  coalescer.Rename("a", "a", 1);
+  CHECK_EQUAL(std::string("deleted:  | renamed:  | created:  | updated: a=1"), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, RenameChainIsOneRename) {
+  Coalescer coalescer;
+  coalescer.Rename("a", "b", 1);
+  coalescer.Rename("b", "c", 2);
+  CHECK_EQUAL(std::string("deleted:  | renamed: a>c=2 | created:  | updated: "), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, RenameKeepsTheUpdate) {
+  Coalescer coalescer;
+  coalescer.Update("a", 1);
+  coalescer.Rename("a", "b", 2);
+  coalescer.Update("c", 3);
+  coalescer.Rename("c", "d", 4);
+  coalescer.Update("d", 5);
+  CHECK_EQUAL(std::string("deleted:  | renamed: a>b=2 c>d=5 | created:  | updated: b=2 d=5"),
+    Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, RenameOverAKnownItemDeletesIt) {
+  Coalescer coalescer;
+  coalescer.Update("b", 2);
+  coalescer.Rename("a", "b", 1);
+  CHECK_EQUAL(std::string("deleted: b | renamed: a>b=1 | created:  | updated: "), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, RenameOverAnUnknownNameAssumesItWasFree) {
+  Coalescer coalescer;
+  coalescer.Rename("a", "b", 1);
+  CHECK_EQUAL(std::string("deleted:  | renamed: a>b=1 | created:  | updated: "), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, SwappedNamesAreTwoRenames) {
+  Coalescer coalescer;
+  coalescer.Rename("a", "temp", 1);
+  coalescer.Rename("b", "a", 2);
+  coalescer.Rename("temp", "b", 3);
+  CHECK_EQUAL(std::string("deleted:  | renamed: a>b=3 b>a=2 | created:  | updated: "),
+    Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, RenamedThenDeletedIsDeleted) {
+  Coalescer coalescer;
+  coalescer.Rename("a", "b", 1);
+  coalescer.Delete("b");
+  CHECK_EQUAL(std::string("deleted: a | renamed:  | created:  | updated: "), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, CreatedThenRenamedIsCreatedUnderTheNewName) {
+  Coalescer coalescer;
+  coalescer.Create("a", 1);
+  coalescer.Rename("a", "b", 2);
+  CHECK_EQUAL(std::string("deleted:  | renamed:  | created: b=2 | updated: "), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, RenameOfADeletedItemIsACreate) {
+  Coalescer coalescer;
+  coalescer.Delete("a");
+  coalescer.Rename("a", "b", 1);
+  CHECK_EQUAL(std::string("deleted: a | renamed:  | created: b=1 | updated: "), Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, NameFreedByARenameCanBeTakenAgain) {
+  Coalescer coalescer;
+  coalescer.Rename("a", "b", 1);
+  coalescer.Create("a", 2);
+  CHECK_EQUAL(std::string("deleted:  | renamed: a>b=1 | created: a=2 | updated: "),
+    Take(coalescer));
+}
+
+
+TEST(ChangeCoalescer, TakeStartsOver) {
+  Coalescer coalescer;
+  coalescer.Create("a", 1);
+  Take(coalescer);
+  CHECK(coalescer.IsEmpty());
+
+  // The item exists now, so deleting it is reported.
+  coalescer.Delete("a");
+  CHECK_EQUAL(std::string("deleted: a | renamed:  | created:  | updated: "), Take(coalescer));
+}
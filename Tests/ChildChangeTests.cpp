@@ -0,0 +1,107 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/ChildChangeTests.cpp
+// The nModules Project
+//
+// Tests for which change notifications popups act on. Only changes to the direct children of a
+// watched folder are about its items.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nPopup/ChildChange.hpp"
+#include "../Utilities/ChangeCoalescer.hpp"
+
+#include <string>
+
+namespace {
+  typedef ChangeCoalescer<std::string, int> Coalescer;
+
+  const std::string WATCHED = "Programs";
+
+  // True if the path is directly in the watched folder, the way ILIsParent checks item IDs.
+  bool IsChild(const std::string &path) {
+    size_t separator = path.rfind('\\');
+    return separator != std::string::npos && path.compare(0, separator, WATCHED) == 0 &&
+      separator == WATCHED.size();
+  }
+
+  /// <summary>
+  /// Queues up a notification about a path, the way ContentPopup does.
+  /// </summary>
+  void Notify(Coalescer &changes, ChangeEvent event, const std::string &path,
+      const std::string &newPath = std::string()) {
+    bool isChild = IsChild(path);
+    bool newIsChild = event == ChangeEvent::Rename && IsChild(newPath);
+    switch (ClassifyChildChange(event, isChild, newIsChild)) {
+    case ChildChange::Create:
+      changes.Create(isChild ? path : newPath, 1);
+      break;
+    case ChildChange::Delete:
+      changes.Delete(path);
+      break;
+    case ChildChange::Update:
+      changes.Update(path, 1);
+      break;
+    case ChildChange::Rename:
+      changes.Rename(path, newPath, 1);
+      break;
+    case ChildChange::Ignore:
+      break;
+    }
+  }
+
+  size_t CountChanges(Coalescer &changes) {
+    Coalescer::Changes taken = changes.Take();
+    return taken.deleted.size() + taken.renamed.size() + taken.created.size() +
+      taken.updated.size();
+  }
+}
+
+
+TEST(ChildChange, ChildrenAreActedOn) {
+  CHECK(ClassifyChildChange(ChangeEvent::Create, true, false) == ChildChange::Create);
+  CHECK(ClassifyChildChange(ChangeEvent::Delete, true, false) == ChildChange::Delete);
+  CHECK(ClassifyChildChange(ChangeEvent::Update, true, false) == ChildChange::Update);
+  CHECK(ClassifyChildChange(ChangeEvent::Rename, true, true) == ChildChange::Rename);
+}
+
+
+TEST(ChildChange, ChangesFurtherDownAreIgnored) {
+  CHECK(ClassifyChildChange(ChangeEvent::Create, false, false) == ChildChange::Ignore);
+  CHECK(ClassifyChildChange(ChangeEvent::Delete, false, false) == ChildChange::Ignore);
+  CHECK(ClassifyChildChange(ChangeEvent::Update, false, false) == ChildChange::Ignore);
+  CHECK(ClassifyChildChange(ChangeEvent::Rename, false, false) == ChildChange::Ignore);
+}
+
+
+TEST(ChildChange, MovesAcrossTheFolderAreCreatesAndDeletes) {
+  CHECK(ClassifyChildChange(ChangeEvent::Rename, false, true) == ChildChange::Create);
+  CHECK(ClassifyChildChange(ChangeEvent::Rename, true, false) == ChildChange::Delete);
+}
+
+
+TEST(ChildChange, NestedFilesDontBecomeItems) {
+  Coalescer changes;
+  Notify(changes, ChangeEvent::Create, "Programs\\Vendor\\app.lnk");
+  Notify(changes, ChangeEvent::Update, "Programs\\Vendor\\app.lnk");
+  Notify(changes, ChangeEvent::Rename, "Programs\\Vendor\\a.lnk", "Programs\\Vendor\\b.lnk");
+  Notify(changes, ChangeEvent::Delete, "Programs\\Vendor\\Programs");
+  CHECK_EQUAL(size_t(0), CountChanges(changes));
+
+  // Changes to the folder's own items still come through.
+  Notify(changes, ChangeEvent::Create, "Programs\\app.lnk");
+  Notify(changes, ChangeEvent::Update, "Programs\\Vendor");
+  Coalescer::Changes taken = changes.Take();
+  CHECK_EQUAL(size_t(1), taken.created.size());
+  CHECK_EQUAL(size_t(1), taken.updated.size());
+}
+
+
+TEST(ChildChange, MovingAnItemOutOfTheFolderDeletesIt) {
+  Coalescer changes;
+  Notify(changes, ChangeEvent::Rename, "Programs\\app.lnk", "Programs\\Vendor\\app.lnk");
+  Notify(changes, ChangeEvent::Rename, "Programs\\Vendor\\tool.lnk", "Programs\\tool.lnk");
+  Coalescer::Changes taken = changes.Take();
+  CHECK_EQUAL(size_t(1), taken.deleted.size());
+  CHECK_EQUAL(size_t(1), taken.created.size());
+  CHECK(taken.renamed.empty());
+}
@@ -0,0 +1,158 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/ChunkPolicyTests.cpp
+// The nModules Project
+//
+// Tests for how nCore streams folder contents: the chunk sizes, and the back pressure between a
+// loader thread and the frames which deliver its chunks.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nCore/ChunkPolicy.hpp"
+#include "../nCore/CompletionQueue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+  // Adds results at the given time until the policy sends a chunk, and returns the chunk's size.
+  size_t FillChunk(ChunkPolicy &policy, double now) {
+    size_t count = 1;
+    while (!policy.Add(now)) {
+      ++count;
+    }
+    return count;
+  }
+
+  /// <summary>
+  /// A chunk of a streamed folder: the index of its first item, and how many items it holds.
+  /// </summary>
+  struct Chunk {
+    size_t first;
+    size_t count;
+  };
+}
+
+
+TEST(ChunkPolicy, ChunksDoubleUpToTheLimit) {
+  ChunkPolicy policy(4, 32, 1.0);
+
+  std::vector<size_t> sizes;
+  for (int i = 0; i < 6; ++i) {
+    sizes.push_back(FillChunk(policy, 0));
+  }
+
+  std::vector<size_t> expected = { 4, 8, 16, 32, 32, 32 };
+  CHECK(sizes == expected);
+}
+
+
+TEST(ChunkPolicy, TracksTheCurrentChunk) {
+  ChunkPolicy policy(4, 32, 1.0);
+  CHECK_EQUAL(size_t(4), policy.GetLimit());
+  CHECK_EQUAL(size_t(0), policy.GetCount());
+
+  CHECK(!policy.Add(0));
+  CHECK(!policy.Add(0));
+  CHECK_EQUAL(size_t(2), policy.GetCount());
+
+  CHECK(!policy.Add(0));
+  CHECK(policy.Add(0));
+  CHECK_EQUAL(size_t(0), policy.GetCount());
+  CHECK_EQUAL(size_t(8), policy.GetLimit());
+}
+
+
+TEST(ChunkPolicy, SlowStreamsAreSentAfterTheDelay) {
+  ChunkPolicy policy(4, 32, 0.05);
+
+  // The delay counts from the first result of the chunk.
+  CHECK(!policy.Add(10.0));
+  CHECK(!policy.Add(10.04));
+  CHECK(policy.Add(10.05));
+
+  // Which still makes the next chunk larger.
+  CHECK_EQUAL(size_t(8), policy.GetLimit());
+  CHECK(!policy.Add(11.0));
+  CHECK(!policy.Add(11.01));
+}
+
+
+TEST(ChunkPolicy, SizesAreClamped) {
+  ChunkPolicy empty(0, 0, 1.0);
+  CHECK_EQUAL(size_t(1), empty.GetLimit());
+  CHECK(empty.Add(0));
+  CHECK(empty.Add(0));
+
+  ChunkPolicy large(100, 10, 1.0);
+  CHECK_EQUAL(size_t(10), large.GetLimit());
+  CHECK_EQUAL(size_t(10), FillChunk(large, 0));
+}
+
+
+TEST(ChunkPolicy, StreamsEveryItemInOrderWithBoundedFrames) {
+  const size_t itemCount = 2000;
+  const size_t capacity = 256;
+  const size_t itemsPerFrame = 64;
+
+  CompletionQueue<Chunk> queue(capacity);
+  std::atomic<size_t> peakWeight(0);
+  std::atomic<int> wakeUps(0);
+
+  // The loader thread, enumerating a folder.
+  std::thread loader([&] () {
+    ChunkPolicy policy(8, 128, 1.0);
+    size_t first = 0;
+    for (size_t i = 0; i < itemCount; ++i) {
+      if (policy.Add(0) || i + 1 == itemCount) {
+        Chunk chunk = { first, i + 1 - first };
+        if (queue.Push(std::move(chunk), chunk.count)) {
+          ++wakeUps;
+        }
+        size_t weight = queue.GetWeight();
+        if (weight > peakWeight) {
+          peakWeight = weight;
+        }
+        first = i + 1;
+      }
+    }
+  });
+
+  // The UI thread, delivering a frame's worth of items at a time.
+  std::vector<Chunk> delivered;
+  size_t deliveredItems = 0;
+  size_t frames = 0;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (deliveredItems < itemCount && std::chrono::steady_clock::now() < deadline) {
+    std::vector<Chunk> batch;
+    queue.Drain(batch, itemsPerFrame);
+    size_t frameItems = 0;
+    for (const Chunk &chunk : batch) {
+      frameItems += chunk.count;
+      delivered.push_back(chunk);
+    }
+    // A frame may go over its budget by at most one chunk.
+    if (!batch.empty()) {
+      CHECK(frameItems - batch.back().count < itemsPerFrame);
+      ++frames;
+    }
+    deliveredItems += frameItems;
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  loader.join();
+
+  CHECK_EQUAL(itemCount, deliveredItems);
+  size_t next = 0;
+  bool inOrder = true;
+  for (const Chunk &chunk : delivered) {
+    inOrder = inOrder && chunk.first == next;
+    next = chunk.first + chunk.count;
+  }
+  CHECK(inOrder);
+
+  // The loader waited for the frames to catch up, rather than queueing up the whole folder.
+  CHECK(peakWeight.load() < capacity + 128);
+  CHECK(wakeUps.load() >= 1);
+  CHECK(frames >= itemCount / (itemsPerFrame + 128));
+}
@@ -0,0 +1,120 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/EasingTests.cpp
+// The nModules Project
+//
+// Tests for the easings, their lookup tables, and cubic bezier curves.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nShared/Easing.h"
+
+#include <algorithm>
+#include <math.h>
+
+using Easing::Type;
+
+
+TEST(Easing, EveryEasingStartsAtZeroAndEndsAtOne) {
+  for (int i = 0; i < int(Type::Count); ++i) {
+    CHECK_NEAR(0.0, Easing::Transform(0.0f, Type(i)), 1e-6);
+    CHECK_NEAR(1.0, Easing::Transform(1.0f, Type(i)), 1e-6);
+  }
+}
+
+
+TEST(Easing, OriginalEasingsKeepTheirCurves) {
+  for (float p = 0.0f; p <= 1.0f; p += 1.0f / 64) {
+    CHECK_NEAR(p, Easing::Transform(p, Type::Linear), 1e-6);
+    // Squared and Quadractic have always been linear.
+    CHECK_NEAR(p, Easing::Transform(p, Type::Squared), 1e-6);
+    CHECK_NEAR(p, Easing::Transform(p, Type::Quadractic), 1e-6);
+    CHECK_NEAR(p * p * p, Easing::Transform(p, Type::Cubic), 1e-6);
+    CHECK_NEAR(sin(1.57079632679 * p), Easing::Transform(p, Type::Sine), 1e-6);
+  }
+}
+
+
+TEST(Easing, InIsOutMirrored) {
+  const Type pairs[][2] = {
+    { Type::QuadIn, Type::QuadOut }, { Type::CubicIn, Type::CubicOut },
+    { Type::QuartIn, Type::QuartOut }, { Type::ExpoIn, Type::ExpoOut },
+    { Type::BackIn, Type::BackOut }, { Type::ElasticIn, Type::ElasticOut },
+    { Type::BounceIn, Type::BounceOut }, { Type::SineIn, Type::SineOut }
+  };
+  for (auto &pair : pairs) {
+    for (float p = 0.0f; p <= 1.0f; p += 1.0f / 64) {
+      const float mirrored = 1.0f - Easing::Transform(1.0f - p, pair[1]);
+      CHECK_NEAR(mirrored, Easing::Transform(p, pair[0]), 1e-5);
+    }
+  }
+}
+
+
+TEST(Easing, InOutIsHalfwayAtTheMiddle) {
+  const Type types[] = {
+    Type::QuadInOut, Type::CubicInOut, Type::QuartInOut, Type::ExpoInOut, Type::BackInOut,
+    Type::ElasticInOut, Type::BounceInOut, Type::SineInOut
+  };
+  for (Type type : types) {
+    CHECK_NEAR(0.5, Easing::Transform(0.5f, type), 1e-5);
+  }
+}
+
+
+TEST(Easing, TablesMatchTheAnalyticForms) {
+  for (int i = 0; i < int(Type::Count); ++i) {
+    const Easing::Table &table = Easing::GetTable(Type(i));
+    double maxError = 0;
+    for (int step = 0; step <= 10000; ++step) {
+      const float p = step / 10000.0f;
+      const double error = fabs(double(table.Transform(p) - Easing::Transform(p, Type(i))));
+      maxError = std::max(maxError, error);
+    }
+    // Bounce has corners, which the interpolation cuts.
+    CHECK(maxError < 3e-3);
+  }
+}
+
+
+TEST(Easing, TablesClampProgress) {
+  const Easing::Table &table = Easing::GetTable(Type::CubicOut);
+  CHECK_NEAR(0.0, table.Transform(-0.5f), 1e-6);
+  CHECK_NEAR(1.0, table.Transform(1.5f), 1e-6);
+}
+
+
+TEST(Easing, CubicBezierMatchesKnownCurves) {
+  // cubic-bezier(0, 0, 1, 1) is linear.
+  Easing::CubicBezier linear(0, 0, 1, 1);
+  // CSS's ease-in-out.
+  Easing::CubicBezier easeInOut(0.42f, 0, 0.58f, 1);
+
+  for (float p = 0.0f; p <= 1.0f; p += 1.0f / 64) {
+    CHECK_NEAR(p, linear.Transform(p), 1e-5);
+    // Symmetric around the middle.
+    CHECK_NEAR(1.0f - easeInOut.Transform(1.0f - p), easeInOut.Transform(p), 1e-5);
+  }
+  CHECK_NEAR(0.5, easeInOut.Transform(0.5f), 1e-5);
+  CHECK(easeInOut.Transform(0.25f) < 0.25f);
+}
+
+
+TEST(Easing, CubicBezierSolvesFlatCurves) {
+  // Flat in x at both ends, where Newton's method has to fall back to bisection.
+  Easing::CubicBezier curve(1, 0, 0, 1);
+  float previous = 0.0f;
+  for (float p = 0.0f; p <= 1.0f; p += 1.0f / 256) {
+    const float value = curve.Transform(p);
+    CHECK(value >= previous - 1e-5f);
+    previous = value;
+  }
+  Easing::Table table(curve);
+  CHECK_NEAR(curve.Transform(0.3f), table.Transform(0.3f), 1e-3);
+}
+
+
+TEST(Easing, CubicBezierCanOvershoot) {
+  Easing::CubicBezier curve(0.3f, 1.5f, 0.7f, 1.5f);
+  CHECK(curve.Transform(0.5f) > 1.0f);
+  CHECK_NEAR(1.0, curve.Transform(1.0f), 1e-6);
+}
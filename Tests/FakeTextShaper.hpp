@@ -0,0 +1,55 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/FakeTextShaper.hpp
+// The nModules Project
+//
+// A text shaper which makes up layouts, for testing and benchmarking the text layout cache.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../nShared/TextShaper.hpp"
+
+/// <summary>
+/// Lays text out as a single line of 10 pixel wide characters, and counts the layouts it creates
+/// and which are still alive.
+/// </summary>
+class FakeTextShaper : public ITextShaper {
+public:
+  class FakeLayout : public Layout {
+  public:
+    FakeLayout(FakeTextShaper *shaper, size_t length) : mShaper(shaper), mLength(length) {
+      ++mShaper->alive;
+    }
+
+    ~FakeLayout() override {
+      --mShaper->alive;
+    }
+
+    void GetSize(float *width, float *height) const override {
+      *width = 10.0f * mLength;
+      *height = 16.0f;
+    }
+
+  private:
+    FakeTextShaper *mShaper;
+    size_t mLength;
+  };
+
+public:
+  FakeTextShaper() : created(0), alive(0), cost(256), fail(false) {}
+
+  Layout *CreateLayout(const wchar_t*, size_t length, const void*, float, float,
+      size_t *layoutCost) override {
+    if (fail) {
+      return nullptr;
+    }
+    ++created;
+    *layoutCost = cost;
+    return new FakeLayout(this, length);
+  }
+
+public:
+  int created;
+  int alive;
+  size_t cost;
+  bool fail;
+};
@@ -0,0 +1,101 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Fixtures.cpp
+// The nModules Project
+//
+// Reads and writes the files in the fixtures directory.
+//-------------------------------------------------------------------------------------------------
+#include "Fixtures.hpp"
+
+#include <stdio.h>
+
+
+static uint32_t Read32(const uint8_t *bytes) {
+  return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | uint32_t(bytes[3]) << 24;
+}
+
+
+static void Write32(uint8_t *bytes, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    bytes[i] = uint8_t(value >> (8 * i));
+  }
+}
+
+
+std::string Fixtures::GetPath(const char *name) {
+  // The fixtures directory is next to this file.
+  std::string path = __FILE__;
+  size_t slash = path.find_last_of("/\\");
+  path = (slash == std::string::npos ? std::string() : path.substr(0, slash + 1)) + "Fixtures/";
+  return path + name;
+}
+
+
+bool Fixtures::ReadBitmap(const std::string &path, uint32_t *width, uint32_t *height,
+    std::vector<uint8_t> *pixels) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buffer[4096];
+  for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+    data.insert(data.end(), buffer, buffer + read);
+  }
+  fclose(file);
+
+  if (data.size() < 54 || data[0] != 'B' || data[1] != 'M') {
+    return false;
+  }
+  uint32_t offset = Read32(&data[10]);
+  int32_t bmpWidth = int32_t(Read32(&data[18]));
+  int32_t bmpHeight = int32_t(Read32(&data[22]));
+  uint16_t bpp = uint16_t(data[28] | data[29] << 8);
+  if (Read32(&data[30]) != 0 || (bpp != 24 && bpp != 32) || bmpWidth <= 0 || bmpHeight == 0) {
+    return false;
+  }
+
+  // Positive heights are stored bottom-up.
+  bool bottomUp = bmpHeight > 0;
+  *width = uint32_t(bmpWidth);
+  *height = uint32_t(bottomUp ? bmpHeight : -bmpHeight);
+  size_t stride = (size_t(*width) * bpp / 8 + 3) & ~size_t(3);
+  if (data.size() < offset + stride * *height) {
+    return false;
+  }
+
+  pixels->resize(size_t(*width) * *height * 4);
+  for (uint32_t y = 0; y < *height; ++y) {
+    const uint8_t *in = &data[offset + stride * (bottomUp ? *height - 1 - y : y)];
+    uint8_t *out = pixels->data() + size_t(y) * *width * 4;
+    for (uint32_t x = 0; x < *width; ++x, in += bpp / 8, out += 4) {
+      out[0] = in[0];
+      out[1] = in[1];
+      out[2] = in[2];
+      out[3] = bpp == 32 ? in[3] : 255;
+    }
+  }
+  return true;
+}
+
+
+bool Fixtures::WriteBitmap(const std::string &path, uint32_t width, uint32_t height,
+    const uint8_t *pixels) {
+  const uint32_t size = width * height * 4;
+  uint8_t header[54] = { 'B', 'M' };
+  Write32(header + 2, 54 + size);
+  Write32(header + 10, 54);
+  Write32(header + 14, 40);
+  Write32(header + 18, width);
+  Write32(header + 22, uint32_t(-int32_t(height)));
+  header[26] = 1;
+  header[28] = 32;
+  Write32(header + 34, size);
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  bool success = fwrite(header, 1, sizeof(header), file) == sizeof(header)
+    && fwrite(pixels, 1, size, file) == size;
+  return fclose(file) == 0 && success;
+}
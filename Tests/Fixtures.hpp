@@ -0,0 +1,31 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Fixtures.hpp
+// The nModules Project
+//
+// Reads and writes the files in the fixtures directory.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Fixtures {
+  /// <summary>
+  /// Returns the path to a file in the fixtures directory.
+  /// </summary>
+  std::string GetPath(const char *name);
+
+  /// <summary>
+  /// Reads an uncompressed 24 or 32 bpp BMP file into tightly packed 32bpp BGRA, as stored. 24 bpp
+  /// files get an alpha of 255.
+  /// </summary>
+  bool ReadBitmap(const std::string &path, uint32_t *width, uint32_t *height,
+    std::vector<uint8_t> *pixels);
+
+  /// <summary>
+  /// Writes tightly packed 32bpp BGRA pixels to a top-down BMP file.
+  /// </summary>
+  bool WriteBitmap(const std::string &path, uint32_t width, uint32_t height,
+    const uint8_t *pixels);
+}
@@ -0,0 +1,409 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/FrameSchedulerTests.cpp
+// The nModules Project
+//
+// Tests for nCore's frame scheduler, on a fake clock: that surfaces are painted once per frame,
+// that nothing wakes the shell up while it's idle, and that listeners can safely cancel each other.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nCore/FrameScheduler.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+  // Frames are a quarter of a second apart, so that frame times add up exactly.
+  const double INTERVAL = 0.25;
+
+  class FakeClock : public FrameScheduler::IClock {
+  public:
+    double GetTime() override {
+      return time;
+    }
+
+    double GetFrameInterval() override {
+      return INTERVAL;
+    }
+
+    double GetFramePhase() override {
+      return phase;
+    }
+
+    double time = 1.0;
+    double phase = 0.0;
+  };
+
+  class FakeHost : public FrameScheduler::IHost {
+  public:
+    void RequestTick(double delay) override {
+      ++requests;
+      lastDelay = delay;
+      pending = true;
+    }
+
+    void CancelTick() override {
+      ++cancels;
+      pending = false;
+    }
+
+    int requests = 0;
+    int cancels = 0;
+    double lastDelay = -1.0;
+    bool pending = false;
+  };
+
+  // Runs the tick which the host was asked for. Requests are for a single tick.
+  void Fire(FrameScheduler &scheduler, FakeHost &host) {
+    host.pending = false;
+    scheduler.Tick();
+  }
+
+  // Everything the scheduler calls, in order.
+  typedef std::vector<std::string> Log;
+
+  class Surface : public IFrameSurface {
+  public:
+    Surface(const char *name, Log &log) : mName(name), mLog(log) {}
+
+    void BeginFrame() override {
+      mLog.push_back("begin " + mName);
+    }
+
+    void EndFrame() override {
+      mLog.push_back("end " + mName);
+    }
+
+  private:
+    std::string mName;
+    Log &mLog;
+  };
+
+  /// <summary>
+  /// Logs its calls, and does whatever the test wants when it is called.
+  /// </summary>
+  class Listener : public IFrameListener {
+  public:
+    Listener(const char *name, Log &log) : mName(name), mLog(log) {}
+
+    double OnFrame(double time) override {
+      mLog.push_back(mName);
+      ++calls;
+      if (onFrame) {
+        onFrame();
+      }
+      return next < 0 ? next : time + next;
+    }
+
+    int calls = 0;
+
+    // When to be called again, relative to the frame, or a negative value to stop.
+    double next = -1.0;
+
+    std::function<void()> onFrame;
+
+  private:
+    std::string mName;
+    Log &mLog;
+  };
+
+  int Count(const Log &log, const std::string &entry) {
+    int count = 0;
+    for (const std::string &logged : log) {
+      count += logged == entry ? 1 : 0;
+    }
+    return count;
+  }
+
+  int IndexOf(const Log &log, const std::string &entry) {
+    for (size_t i = 0; i < log.size(); ++i) {
+      if (log[i] == entry) {
+        return int(i);
+      }
+    }
+    return -1;
+  }
+}
+
+
+TEST(FrameScheduler, PaintsEachSurfaceOncePerFrame) {
+  FakeClock clock;
+  FakeHost host;
+  FrameScheduler scheduler(&clock, &host);
+
+  Log log;
+  Surface first("first", log), second("second", log);
+  Listener a("a", log), b("b", log), c("c", log), d("d", log), e("e", log);
+  scheduler.Schedule(&a, &first, 1.25);
+  scheduler.Schedule(&d, &second, 1.25);
+  scheduler.Schedule(&b, &first, 1.25);
+  scheduler.Schedule(&e, &second, 1.25);
+  scheduler.Schedule(&c, &first, 1.25);
+
+  clock.time = 1.25;
+  Fire(scheduler, host);
+
+  CHECK_EQUAL(size_t(9), log.size());
+  CHECK_EQUAL(1, Count(log, "begin first"));
+  CHECK_EQUAL(1, Count(log, "end first"));
+  CHECK_EQUAL(1, Count(log, "begin second"));
+  CHECK_EQUAL(1, Count(log, "end second"));
+
+  // Each listener runs once, between the BeginFrame and EndFrame of its own surface.
+  for (const char *name : { "a", "b", "c" }) {
+    CHECK_EQUAL(1, Count(log, name));
+    CHECK(IndexOf(log, "begin first") < IndexOf(log, name));
+    CHECK(IndexOf(log, name) < IndexOf(log, "end first"));
+  }
+  for (const char *name : { "d", "e" }) {
+    CHECK_EQUAL(1, Count(log, name));
+    CHECK(IndexOf(log, "begin second") < IndexOf(log, name));
+    CHECK(IndexOf(log, name) < IndexOf(log, "end second"));
+  }
+}
+
+
+TEST(FrameScheduler, ListenersWithoutASurfaceRunToo) {
+  FakeClock clock;
+  FakeHost host;
+  FrameScheduler scheduler(&clock, &host);
+
+  Log log;
+  Listener a("a", log);
+  scheduler.Schedule(&a, nullptr, 1.0);
+  Fire(scheduler, host);
+  CHECK_EQUAL(1, a.calls);
+  CHECK_EQUAL(size_t(1), log.size());
+}
+
+
+TEST(FrameScheduler, IdleSchedulerRequestsNoWakeups) {
+  FakeClock clock;
+  FakeHost host;
+  FrameScheduler scheduler(&clock, &host);
+  CHECK(scheduler.IsIdle());
+  CHECK_EQUAL(0, host.requests);
+
+  // A listener which runs once.
+  Log log;
+  Surface surface("surface", log);
+  Listener a("a", log);
+  scheduler.Schedule(&a, &surface, 1.5);
+  CHECK(!scheduler.IsIdle());
+  CHECK_EQUAL(1, host.requests);
+  CHECK(host.pending);
+
+  clock.time = 1.5;
+  Fire(scheduler, host);
+  CHECK_EQUAL(1, a.calls);
+  CHECK(scheduler.IsIdle());
+  CHECK(!host.pending);
+  CHECK_EQUAL(1, host.requests);
+
+  // Nothing runs, and nothing is requested, even if the host ticks anyway.
+  clock.time = 2.0;
+  Fire(scheduler, host);
+  CHECK_EQUAL(1, a.calls);
+  CHECK_EQUAL(1, host.requests);
+  CHECK(!host.pending);
+
+  // Unscheduling the last listener cancels the wakeup for it.
+  scheduler.Schedule(&a, &surface, 3.0);
+  CHECK(host.pending);
+  scheduler.Unschedule(&a);
+  CHECK(!host.pending);
+  CHECK(scheduler.IsIdle());
+}
+
+
+TEST(FrameScheduler, RepeatingListenersKeepTheSchedulerAwake) {
+  FakeClock clock;
+  FakeHost host;
+  FrameScheduler scheduler(&clock, &host);
+
+  Log log;
+  Listener a("a", log);
+  a.next = 0.0;
+  scheduler.Schedule(&a, nullptr, 1.0);
+
+  for (int frame = 0; frame < 4; ++frame) {
+    Fire(scheduler, host);
+    CHECK(host.pending);
+    CHECK_NEAR(INTERVAL, host.lastDelay, 1e-9);
+    clock.time += INTERVAL;
+  }
+  CHECK_EQUAL(4, a.calls);
+
+  a.next = -1.0;
+  Fire(scheduler, host);
+  CHECK_EQUAL(5, a.calls);
+  CHECK(!host.pending);
+  CHECK(scheduler.IsIdle());
+}
+
+
+TEST(FrameScheduler, ListenersCanUnscheduleEachOther) {
+  FakeClock clock;
+  FakeHost host;
+  FrameScheduler scheduler(&clock, &host);
+
+  // Whichever runs first cancels the other, both on the same surface and across surfaces.
+  Log log;
+  Surface first("first", log), second("second", log);
+  Listener a("a", log), b("b", log), c("c", log), d("d", log);
+  a.onFrame = [&] () { scheduler.Unschedule(&b); };
+  b.onFrame = [&] () { scheduler.Unschedule(&a); };
+  c.onFrame = [&] () { scheduler.Unschedule(&d); };
+  d.onFrame = [&] () { scheduler.Unschedule(&c); };
+  scheduler.Schedule(&a, &first, 1.0);
+  scheduler.Schedule(&b, &first, 1.0);
+  scheduler.Schedule(&c, &first, 1.0);
+  scheduler.Schedule(&d, &second, 1.0);
+
+  Fire(scheduler, host);
+  CHECK_EQUAL(1, a.calls + b.calls);
+  CHECK_EQUAL(1, c.calls + d.calls);
+  CHECK(scheduler.IsIdle());
+  CHECK(!host.pending);
+}
+
+
+TEST(FrameScheduler, ListenersCanRescheduleThemselvesOntoAnotherSurface) {
+  FakeClock clock;
+  FakeHost host;
+  FrameScheduler scheduler(&clock, &host);
+
+  Log log;
+  Surface first("first", log), second("second", log);
+  Listener a("a", log);
+  a.next = 0.0;
+  a.onFrame = [&] () { scheduler.Schedule(&a, &second, 2.0); };
+  scheduler.Schedule(&a, &first, 1.0);
+
+  // The new schedule wins over what OnFrame returns.
+  Fire(scheduler, host);
+  CHECK_EQUAL(1, a.calls);
+  CHECK(host.pending);
+  CHECK_NEAR(1.0, host.lastDelay, 1e-9);
+
+  a.onFrame = nullptr;
+  a.next = -1.0;
+  clock.time = 2.0;
+  Fire(scheduler, host);
+  CHECK_EQUAL(2, a.calls);
+  CHECK_EQUAL(1, Count(log, "begin second"));
+}
+
+
+TEST(FrameScheduler, SurfacesCanBeRemovedWhileTicking) {
+  FakeClock clock;
+  FakeHost host;
+  FrameScheduler scheduler(&clock, &host);
+
+  // The listener which runs first on each surface closes the other surface.
+  Log log;
+  Surface first("first", log), second("second", log);
+  Listener a("a", log), b("b", log), c("c", log), d("d", log);
+  a.onFrame = [&] () { scheduler.RemoveSurface(&second); };
+  b.onFrame = [&] () { scheduler.RemoveSurface(&second); };
+  c.onFrame = [&] () { scheduler.RemoveSurface(&first); };
+  d.onFrame = [&] () { scheduler.RemoveSurface(&first); };
+  a.next = b.next = c.next = d.next = 0.0;
+  scheduler.Schedule(&a, &first, 1.0);
+  scheduler.Schedule(&b, &first, 1.0);
+  scheduler.Schedule(&c, &second, 1.0);
+  scheduler.Schedule(&d, &second, 1.0);
+
+  Fire(scheduler, host);
+
+  // Whichever surface went first was painted completely; the other one was never touched.
+  bool firstWent = Count(log, "begin first") == 1;
+  CHECK_EQUAL(firstWent ? 2 : 0, a.calls + b.calls);
+  CHECK_EQUAL(firstWent ? 0 : 2, c.calls + d.calls);
+  CHECK_EQUAL(firstWent ? 1 : 0, Count(log, "end first"));
+  CHECK_EQUAL(firstWent ? 0 : 1, Count(log, "begin second"));
+  CHECK_EQUAL(firstWent ? 0 : 1, Count(log, "end second"));
+
+  // Listeners on the surface which is left are still scheduled.
+  CHECK(!scheduler.IsIdle());
+  CHECK(host.pending);
+}
+
+
+TEST(FrameScheduler, ListenersCanRemoveTheirOwnSurface) {
+  FakeClock clock;
+  FakeHost host;
+  FrameScheduler scheduler(&clock, &host);
+
+  Log log;
+  Surface surface("surface", log);
+  Listener a("a", log), b("b", log);
+  a.onFrame = [&] () { scheduler.RemoveSurface(&surface); };
+  b.onFrame = [&] () { scheduler.RemoveSurface(&surface); };
+  a.next = b.next = 0.0;
+  scheduler.Schedule(&a, &surface, 1.0);
+  scheduler.Schedule(&b, &surface, 1.0);
+
+  Fire(scheduler, host);
+
+  // The surface is gone by the time its frame would end.
+  CHECK_EQUAL(1, a.calls + b.calls);
+  CHECK_EQUAL(1, Count(log, "begin surface"));
+  CHECK_EQUAL(0, Count(log, "end surface"));
+  CHECK(scheduler.IsIdle());
+  CHECK(!host.pending);
+}
+
+
+TEST(FrameScheduler, ListenersDueWithinHalfAFrameRunInThisFrame) {
+  FakeClock clock;
+  FakeHost host;
+  FrameScheduler scheduler(&clock, &host);
+
+  Log log;
+  Listener early("early", log), late("late", log);
+  scheduler.Schedule(&early, nullptr, 1.0 + INTERVAL * 0.4);
+  scheduler.Schedule(&late, nullptr, 1.0 + INTERVAL * 0.6);
+
+  // Timer wakeups are rarely exact, so the first belongs to this frame, and the second to the next.
+  Fire(scheduler, host);
+  CHECK_EQUAL(1, early.calls);
+  CHECK_EQUAL(0, late.calls);
+  CHECK_NEAR(INTERVAL, host.lastDelay, 1e-9);
+
+  clock.time += INTERVAL;
+  Fire(scheduler, host);
+  CHECK_EQUAL(1, late.calls);
+}
+
+
+TEST(FrameScheduler, WakeupsAreAlignedToFrames) {
+  FakeClock clock;
+  FakeHost host;
+  FrameScheduler scheduler(&clock, &host);
+
+  // Anything due in the current frame waits for the next one.
+  Log log;
+  Listener a("a", log);
+  scheduler.Schedule(&a, nullptr, 1.0);
+  CHECK_NEAR(INTERVAL, host.lastDelay, 1e-9);
+
+  // Later times are rounded up to the frame they fall in.
+  scheduler.Schedule(&a, nullptr, 1.3);
+  CHECK_NEAR(0.5, host.lastDelay, 1e-9);
+  scheduler.Schedule(&a, nullptr, 1.5);
+  CHECK_NEAR(0.5, host.lastDelay, 1e-9);
+
+  // Frames start wherever the clock's vertical blanks are.
+  clock.phase = 0.1;
+  scheduler.SetClock(&clock);
+  CHECK_NEAR(0.6, host.lastDelay, 1e-9);
+  scheduler.Schedule(&a, nullptr, 1.0);
+  CHECK_NEAR(0.35, host.lastDelay, 1e-9);
+
+  // Asking for the same frame again doesn't ask the host again.
+  int requests = host.requests;
+  scheduler.Schedule(&a, nullptr, 1.0);
+  CHECK_EQUAL(requests, host.requests);
+}
@@ -0,0 +1,200 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/GridScheduleTests.cpp
+// The nModules Project
+//
+// Tests for the order in which the squares of nDesk's grid transitions fade, and for how many of
+// them a frame has to look at.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nDesk/TransitionEffects/GridSchedule.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <set>
+#include <vector>
+
+namespace {
+  const GridSchedule::GridType GRID_TYPES[] = {
+    GridSchedule::RANDOM,
+    GridSchedule::LINEAR_VERTICAL,
+    GridSchedule::LINEAR_HORIZONTAL,
+    GridSchedule::TRIANGULAR,
+    GridSchedule::CLOCKWISE,
+    GridSchedule::COUNTERCLOCKWISE
+  };
+
+  // Grid sizes, including ones with an odd number of squares, and ones which aren't square.
+  const int GRID_SIZES[][2] = { { 1, 1 }, { 4, 4 }, { 7, 5 }, { 3, 9 }, { 16, 9 }, { 116, 22 } };
+
+  std::vector<int> Order(const GridSchedule::Timeline &timeline) {
+    std::vector<int> order;
+    for (size_t i = 0; i < timeline.GetCount(); ++i) {
+      order.push_back(timeline.GetSquare(i));
+    }
+    return order;
+  }
+
+  // Counts the squares which are fading at the given progress, by looking at every one of them.
+  size_t CountFading(const GridSchedule::Timeline &timeline, float progress, float fadeTime) {
+    size_t fading = 0;
+    for (size_t i = 0; i < timeline.GetCount(); ++i) {
+      float startTime = timeline.GetStartTime(i);
+      fading += startTime <= progress && progress - fadeTime < startTime ? 1 : 0;
+    }
+    return fading;
+  }
+}
+
+
+TEST(GridSchedule, TheSameSeedGivesTheSameOrder) {
+  GridSchedule::Timeline first, second, other;
+  first.Build(GridSchedule::RANDOM, 16, 9, 0.2f, 1234, false);
+  second.Build(GridSchedule::RANDOM, 16, 9, 0.2f, 1234, false);
+  other.Build(GridSchedule::RANDOM, 16, 9, 0.2f, 4321, false);
+
+  CHECK(Order(first) == Order(second));
+  CHECK(Order(first) != Order(other));
+
+  bool sameTimes = true;
+  for (size_t i = 0; i < first.GetCount(); ++i) {
+    sameTimes &= first.GetStartTime(i) == second.GetStartTime(i);
+  }
+  CHECK(sameTimes);
+}
+
+
+TEST(GridSchedule, EverySquareIsScheduledOnce) {
+  const float fadeTime = 0.25f;
+  for (GridSchedule::GridType gridType : GRID_TYPES) {
+    for (const int *size : GRID_SIZES) {
+      for (bool reverse : { false, true }) {
+        GridSchedule::Timeline timeline;
+        timeline.Build(gridType, size[0], size[1], fadeTime, 7, reverse);
+        const size_t squares = size_t(size[0] * size[1]);
+        CHECK_EQUAL(squares, timeline.GetCount());
+
+        // Every square shows up once, and in order of start time within [0, 1 - fadeTime].
+        std::vector<int> order = Order(timeline);
+        std::sort(order.begin(), order.end());
+        bool permutation = true;
+        for (size_t i = 0; i < order.size(); ++i) {
+          permutation &= order[i] == int(i);
+        }
+        CHECK(permutation);
+
+        bool inRange = true, sorted = true;
+        for (size_t i = 0; i < timeline.GetCount(); ++i) {
+          float startTime = timeline.GetStartTime(i);
+          inRange &= startTime >= -1e-6f && startTime <= 1.0f - fadeTime + 1e-6f;
+          sorted &= i == 0 || timeline.GetStartTime(i - 1) <= startTime;
+        }
+        CHECK(inRange);
+        CHECK(sorted);
+      }
+    }
+  }
+}
+
+
+TEST(GridSchedule, OrderedSquaresEachGetTheirOwnTurn) {
+  // The linear and spiral orders give every square they reach a turn of its own. Squares in the
+  // middle of non-square grids, which the spirals don't reach, all go last.
+  const GridSchedule::GridType ordered[] = {
+    GridSchedule::LINEAR_VERTICAL,
+    GridSchedule::LINEAR_HORIZONTAL,
+    GridSchedule::CLOCKWISE,
+    GridSchedule::COUNTERCLOCKWISE
+  };
+  const float fadeTime = 0.25f;
+  for (GridSchedule::GridType gridType : ordered) {
+    for (const int *size : GRID_SIZES) {
+      std::vector<float> startTimes(size_t(size[0] * size[1]));
+      GridSchedule::ComputeStartTimes(gridType, size[0], size[1], fadeTime, 0, startTimes.data());
+
+      std::set<float> turns;
+      size_t reached = 0;
+      for (float startTime : startTimes) {
+        if (startTime < 1.0f - fadeTime) {
+          turns.insert(startTime);
+          ++reached;
+        }
+      }
+      CHECK_EQUAL(reached, turns.size());
+    }
+  }
+}
+
+
+TEST(GridSchedule, TheActiveBandIsBounded) {
+  // 100 pixel squares on three 4K monitors side by side.
+  const int squaresX = 116, squaresY = 22, squares = squaresX * squaresY;
+  const float fadeTime = 0.1f;
+
+  for (GridSchedule::GridType gridType : GRID_TYPES) {
+    GridSchedule::Timeline timeline;
+    timeline.Build(gridType, squaresX, squaresY, fadeTime, 99, false);
+
+    // The linear orders start a square every (1 - fadeTime) / squares, so that many fit in the
+    // fade time. The others bunch up more, but never beyond the brute force count.
+    const size_t bound = size_t(ceil(fadeTime * squares / (1.0f - fadeTime))) + 1;
+    bool matches = true, bounded = true;
+    size_t widest = 0;
+    for (int frame = 0; frame <= 600; ++frame) {
+      float progress = frame / 600.0f;
+      GridSchedule::Timeline::Band band = timeline.GetBand(progress);
+      matches &= band.done <= band.started && band.started <= timeline.GetCount();
+      matches &= band.started - band.done == CountFading(timeline, progress, fadeTime);
+      widest = std::max(widest, band.started - band.done);
+      if (gridType == GridSchedule::LINEAR_VERTICAL
+          || gridType == GridSchedule::LINEAR_HORIZONTAL) {
+        bounded &= band.started - band.done <= bound;
+      }
+    }
+    CHECK(matches);
+    CHECK(bounded);
+    CHECK(widest < size_t(squares));
+  }
+}
+
+
+TEST(GridSchedule, FramesOnlyTouchTheSquaresInFlight) {
+  // A frame paints the squares which are fading, and adds the ones which finished since the last
+  // frame to the layer. Over the whole transition, each square is added to the layer once.
+  const int squaresX = 116, squaresY = 22, squares = squaresX * squaresY;
+  const float fadeTime = 0.05f;
+  const int frames = 60;
+
+  for (GridSchedule::GridType gridType : GRID_TYPES) {
+    GridSchedule::Timeline timeline;
+    timeline.Build(gridType, squaresX, squaresY, fadeTime, 5, true);
+
+    size_t layered = 0, painted = 0, busiest = 0;
+    bool monotonic = true;
+    GridSchedule::Timeline::Band last = { 0, 0 };
+    for (int frame = 0; frame <= frames; ++frame) {
+      GridSchedule::Timeline::Band band = timeline.GetBand(float(frame) / frames);
+      monotonic &= band.done >= last.done && band.started >= last.started;
+
+      size_t work = (band.done - last.done) + (band.started - band.done);
+      layered += band.done - last.done;
+      painted += band.started - band.done;
+      busiest = std::max(busiest, work);
+      last = band;
+    }
+
+    CHECK(monotonic);
+    CHECK_EQUAL(size_t(squares), layered);
+    CHECK_EQUAL(size_t(squares), last.done);
+
+    // In the linear orders, squares start evenly, so a frame only touches the ones which finished
+    // since the last frame, and the ones which are fading.
+    const float spacing = (1.0f - fadeTime) / squares;
+    if (gridType == GridSchedule::LINEAR_VERTICAL || gridType == GridSchedule::LINEAR_HORIZONTAL) {
+      CHECK(busiest <= size_t(ceil(1.0f / frames / spacing) + ceil(fadeTime / spacing)) + 2);
+    }
+
+    // Rather than every square, every frame.
+    CHECK(painted < size_t(squares) * frames / 4);
+  }
+}
@@ -0,0 +1,306 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/HoverIntentTests.cpp
+// The nModules Project
+//
+// Tests for how popups guess which folder the user is about to open, and for the prefetches
+// which load the folder ahead of time.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nPopup/FolderPrefetch.hpp"
+#include "../nPopup/HoverIntent.hpp"
+
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace {
+  // The settings popups use by default.
+  const double DWELL_TIME = 0.15;
+  const float DWELL_RADIUS = 4.0f;
+  const float PROXIMITY = 8.0f;
+  const double AIM_TIME = 0.25;
+  const float MIN_SPEED = 200.0f;
+
+  // How often popups sample the mouse.
+  const double INTERVAL = 0.025;
+
+  // Stand in for the folder items.
+  const int firstItem = 0, secondItem = 0;
+  const HoverIntent::Target FIRST = &firstItem;
+  const HoverIntent::Target SECOND = &secondItem;
+
+  HoverIntent MakeIntent() {
+    return HoverIntent(DWELL_TIME, DWELL_RADIUS, PROXIMITY, AIM_TIME, MIN_SPEED);
+  }
+
+  void SetTargets(HoverIntent &intent, std::vector<HoverIntent::Area> targets) {
+    intent.SetTargets(std::move(targets));
+  }
+
+  // An item 100 pixels wide and 20 high, with its top at the given height.
+  HoverIntent::Area ItemAt(HoverIntent::Target target, float top) {
+    HoverIntent::Area area = { target, 0.0f, top, 100.0f, top + 20.0f };
+    return area;
+  }
+
+  /// <summary>
+  /// Moves the mouse in a straight line, one sample at a time, and returns the last guess.
+  /// </summary>
+  HoverIntent::Target MoveFor(HoverIntent &intent, float x, float y, float dx, float dy,
+      double &now, int samples) {
+    HoverIntent::Target target = nullptr;
+    for (int i = 0; i < samples; ++i) {
+      target = intent.Move(x, y, now);
+      x += dx * float(INTERVAL);
+      y += dy * float(INTERVAL);
+      now += INTERVAL;
+    }
+    return target;
+  }
+
+  /// <summary>
+  /// Counts the loads which are cancelled.
+  /// </summary>
+  struct Loads {
+    int cancelled = 0;
+
+    std::function<void()> Canceller() {
+      return [this] () { ++this->cancelled; };
+    }
+  };
+
+  typedef FolderPrefetch<int, std::unique_ptr<int>> Prefetch;
+}
+
+
+TEST(HoverIntent, NothingWithoutTargets) {
+  HoverIntent intent = MakeIntent();
+  double now = 0.0;
+  CHECK(MoveFor(intent, 50.0f, 10.0f, 0.0f, 0.0f, now, 20) == nullptr);
+  CHECK(MoveFor(intent, 50.0f, 10.0f, 0.0f, 400.0f, now, 10) == nullptr);
+}
+
+
+TEST(HoverIntent, RestingByAnItemPicksItAfterTheDwellTime) {
+  HoverIntent intent = MakeIntent();
+  SetTargets(intent, { ItemAt(FIRST, 0.0f) });
+
+  // Five pixels below the item. Samples stay clear of the dwell time itself, since they add up
+  // with rounding errors.
+  double now = 0.0;
+  CHECK(MoveFor(intent, 50.0f, 25.0f, 0.0f, 0.0f, now, 6) == nullptr);
+  CHECK(MoveFor(intent, 50.0f, 25.0f, 0.0f, 0.0f, now, 2) == FIRST);
+}
+
+
+TEST(HoverIntent, JitterCountsAsResting) {
+  HoverIntent intent = MakeIntent();
+  SetTargets(intent, { ItemAt(FIRST, 0.0f) });
+
+  HoverIntent::Target target = nullptr;
+  for (int i = 0; i <= 7; ++i) {
+    target = intent.Move(i % 2 == 0 ? 50.0f : 52.0f, i % 2 == 0 ? 25.0f : 26.0f, i * INTERVAL);
+  }
+  CHECK(target == FIRST);
+}
+
+
+TEST(HoverIntent, RestingAwayFromItemsPicksNothing) {
+  HoverIntent intent = MakeIntent();
+  SetTargets(intent, { ItemAt(FIRST, 0.0f) });
+
+  double now = 0.0;
+  CHECK(MoveFor(intent, 50.0f, 40.0f, 0.0f, 0.0f, now, 20) == nullptr);
+}
+
+
+TEST(HoverIntent, HeadingTowardsAnItemPicksItEarly) {
+  HoverIntent intent = MakeIntent();
+  SetTargets(intent, { ItemAt(FIRST, 100.0f) });
+
+  // One sample isn't enough to tell where the mouse is going.
+  double now = 0.0;
+  CHECK(MoveFor(intent, 50.0f, 0.0f, 0.0f, 400.0f, now, 2) == nullptr);
+
+  // The mouse is at 20 pixels, and gets to the item in 0.2 seconds.
+  CHECK(intent.Move(50.0f, 20.0f, now) == FIRST);
+}
+
+
+TEST(HoverIntent, HeadingAwayPicksNothing) {
+  HoverIntent intent = MakeIntent();
+  SetTargets(intent, { ItemAt(FIRST, 100.0f) });
+
+  double now = 0.0;
+  CHECK(MoveFor(intent, 50.0f, 90.0f, 0.0f, -400.0f, now, 4) == nullptr);
+}
+
+
+TEST(HoverIntent, SlowOrDistantMovesPickNothing) {
+  HoverIntent intent = MakeIntent();
+  SetTargets(intent, { ItemAt(FIRST, 100.0f) });
+
+  // Too slow to be heading anywhere.
+  double now = 0.0;
+  CHECK(MoveFor(intent, 50.0f, 40.0f, 0.0f, 100.0f, now, 4) == nullptr);
+
+  // Fast, but too far away to get there within the aim time.
+  intent.Leave();
+  SetTargets(intent, { ItemAt(FIRST, 1000.0f) });
+  CHECK(MoveFor(intent, 50.0f, 0.0f, 0.0f, 400.0f, now, 4) == nullptr);
+}
+
+
+TEST(HoverIntent, PicksTheItemWhichIsReachedFirst) {
+  HoverIntent intent = MakeIntent();
+  SetTargets(intent, { ItemAt(FIRST, 100.0f), ItemAt(SECOND, 50.0f) });
+
+  double now = 0.0;
+  CHECK(MoveFor(intent, 50.0f, 0.0f, 0.0f, 400.0f, now, 3) == SECOND);
+}
+
+
+TEST(HoverIntent, LeavingForgetsTheRest) {
+  HoverIntent intent = MakeIntent();
+  SetTargets(intent, { ItemAt(FIRST, 0.0f) });
+
+  double now = 0.0;
+  CHECK(MoveFor(intent, 50.0f, 25.0f, 0.0f, 0.0f, now, 5) == nullptr);
+  intent.Leave();
+
+  // The dwell time starts over.
+  CHECK(MoveFor(intent, 50.0f, 25.0f, 0.0f, 0.0f, now, 3) == nullptr);
+  CHECK(MoveFor(intent, 50.0f, 25.0f, 0.0f, 0.0f, now, 5) == FIRST);
+}
+
+
+TEST(HoverIntent, NewTargetsReplaceTheOldOnes) {
+  HoverIntent intent = MakeIntent();
+  SetTargets(intent, { ItemAt(FIRST, 0.0f) });
+  SetTargets(intent, { ItemAt(SECOND, 0.0f) });
+
+  double now = 0.0;
+  CHECK(MoveFor(intent, 50.0f, 25.0f, 0.0f, 0.0f, now, 8) == SECOND);
+
+  SetTargets(intent, {});
+  CHECK(intent.Move(50.0f, 25.0f, now) == nullptr);
+}
+
+
+TEST(FolderPrefetch, HandsOverCompleteItems) {
+  Loads loads;
+  Prefetch prefetch;
+  CHECK(prefetch.GetState() == Prefetch::State::Idle);
+
+  prefetch.Start(1, loads.Canceller());
+  CHECK(prefetch.GetState() == Prefetch::State::Loading);
+  prefetch.Add(std::unique_ptr<int>(new int(10)));
+  prefetch.Add(std::unique_ptr<int>(new int(20)));
+  prefetch.Complete();
+  CHECK(prefetch.GetState() == Prefetch::State::Complete);
+
+  std::vector<std::unique_ptr<int>> items;
+  CHECK(prefetch.Take(1, items));
+  CHECK_EQUAL(size_t(2), items.size());
+  CHECK_EQUAL(10, *items[0]);
+  CHECK_EQUAL(20, *items[1]);
+  CHECK(prefetch.GetState() == Prefetch::State::Finished);
+  CHECK_EQUAL(0, loads.cancelled);
+
+  // The items can only be taken once.
+  std::vector<std::unique_ptr<int>> again;
+  CHECK(!prefetch.Take(1, again));
+  CHECK(again.empty());
+}
+
+
+TEST(FolderPrefetch, StaleItemsAreThrownAway) {
+  Loads loads;
+  Prefetch prefetch;
+  prefetch.Start(1, loads.Canceller());
+  prefetch.Add(std::unique_ptr<int>(new int(10)));
+  prefetch.Complete();
+
+  // The folder was modified after the prefetch started.
+  std::vector<std::unique_ptr<int>> items;
+  CHECK(!prefetch.Take(2, items));
+  CHECK(items.empty());
+  CHECK(prefetch.GetState() == Prefetch::State::Finished);
+
+  // The load was done already, so there was nothing to stop.
+  CHECK_EQUAL(0, loads.cancelled);
+}
+
+
+TEST(FolderPrefetch, TakingAnUnfinishedPrefetchStopsTheLoad) {
+  Loads loads;
+  Prefetch prefetch;
+  prefetch.Start(1, loads.Canceller());
+  prefetch.Add(std::unique_ptr<int>(new int(10)));
+
+  std::vector<std::unique_ptr<int>> items;
+  CHECK(!prefetch.Take(1, items));
+  CHECK(items.empty());
+  CHECK_EQUAL(1, loads.cancelled);
+  CHECK(prefetch.GetState() == Prefetch::State::Finished);
+}
+
+
+TEST(FolderPrefetch, CancelledPrefetchIgnoresLateItems) {
+  Loads loads;
+  Prefetch prefetch;
+  prefetch.Start(1, loads.Canceller());
+  prefetch.Cancel();
+  CHECK_EQUAL(1, loads.cancelled);
+
+  // Results which were on their way when the load was stopped.
+  prefetch.Add(std::unique_ptr<int>(new int(10)));
+  prefetch.Complete();
+  CHECK(prefetch.GetState() == Prefetch::State::Finished);
+
+  std::vector<std::unique_ptr<int>> items;
+  CHECK(!prefetch.Take(1, items));
+  CHECK(items.empty());
+
+  // Cancelling again doesn't stop the load twice.
+  prefetch.Cancel();
+  CHECK_EQUAL(1, loads.cancelled);
+}
+
+
+TEST(FolderPrefetch, RestartingStopsThePreviousLoad) {
+  Loads first, second;
+  Prefetch prefetch;
+  prefetch.Start(1, first.Canceller());
+  prefetch.Add(std::unique_ptr<int>(new int(10)));
+  prefetch.Start(2, second.Canceller());
+  CHECK_EQUAL(1, first.cancelled);
+
+  prefetch.Add(std::unique_ptr<int>(new int(20)));
+  prefetch.Complete();
+
+  std::vector<std::unique_ptr<int>> items;
+  CHECK(prefetch.Take(2, items));
+  CHECK_EQUAL(size_t(1), items.size());
+  CHECK_EQUAL(20, *items[0]);
+  CHECK_EQUAL(0, second.cancelled);
+}
+
+
+TEST(FolderPrefetch, DestroyingALoadingPrefetchStopsTheLoad) {
+  Loads loads;
+  {
+    Prefetch loading;
+    loading.Start(1, loads.Canceller());
+  }
+  CHECK_EQUAL(1, loads.cancelled);
+
+  {
+    Prefetch complete;
+    complete.Start(1, loads.Canceller());
+    complete.Complete();
+  }
+  CHECK_EQUAL(1, loads.cancelled);
+}
@@ -0,0 +1,254 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/IconStoreTests.cpp
+// The nModules Project
+//
+// Tests for nCore's icon store: that icons which look the same are only kept once, that icons in
+// use are never destroyed, and that icons stored without a location can't be found by one.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nCore/IconStore.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+  /// <summary>
+  /// Hands out distinct icons, and records which ones the store destroys.
+  /// </summary>
+  class Icons {
+  public:
+    Icons() : mIcons(64) {}
+
+    IconStore::Icon Get(size_t i) {
+      return &mIcons[i];
+    }
+
+    std::function<void(IconStore::Icon)> Destroyer() {
+      return [this] (IconStore::Icon icon) { destroyed.push_back(icon); };
+    }
+
+    bool WasDestroyed(IconStore::Icon icon) const {
+      return std::count(destroyed.begin(), destroyed.end(), icon) != 0;
+    }
+
+  public:
+    std::vector<IconStore::Icon> destroyed;
+
+  private:
+    std::vector<int> mIcons;
+  };
+
+  IconStore::Location At(const wchar_t *path, int index) {
+    IconStore::Location location = { path, index, 32 };
+    return location;
+  }
+}
+
+
+TEST(IconStore, FindsIconsByLocation) {
+  Icons icons;
+  IconStore store(1 << 20, icons.Destroyer());
+  const IconStore::Location location = At(L"C:\\Windows\\explorer.exe", 0);
+
+  CHECK(store.Find(location) == nullptr);
+  CHECK(store.Insert(&location, icons.Get(0), 100, 4096) == icons.Get(0));
+  store.Release(icons.Get(0));
+
+  // Paths are case insensitive, but the index and size have to match.
+  CHECK(store.Find(At(L"c:\\windows\\EXPLORER.EXE", 0)) == icons.Get(0));
+  store.Release(icons.Get(0));
+  CHECK(store.Find(At(L"C:\\Windows\\explorer.exe", 1)) == nullptr);
+  IconStore::Location larger = location;
+  larger.size = 48;
+  CHECK(store.Find(larger) == nullptr);
+}
+
+
+TEST(IconStore, IdenticalIconsShareOneEntry) {
+  Icons icons;
+  IconStore store(1 << 20, icons.Destroyer());
+  const IconStore::Location first = At(L"C:\\a.lnk", 0);
+  const IconStore::Location second = At(L"C:\\b.lnk", 0);
+
+  CHECK(store.Insert(&first, icons.Get(0), 100, 4096) == icons.Get(0));
+
+  // The second copy is destroyed, and both locations lead to the first.
+  CHECK(store.Insert(&second, icons.Get(1), 100, 4096) == icons.Get(0));
+  CHECK(icons.WasDestroyed(icons.Get(1)));
+  CHECK(!icons.WasDestroyed(icons.Get(0)));
+  CHECK(store.Insert(nullptr, icons.Get(2), 100, 4096) == icons.Get(0));
+  CHECK_EQUAL(size_t(1), store.GetCount());
+  CHECK_EQUAL(size_t(4096), store.GetCost());
+
+  CHECK(store.Find(second) == icons.Get(0));
+
+  // Every one of those is a reference.
+  for (int i = 0; i < 3; ++i) {
+    store.Release(icons.Get(0));
+  }
+  store.SetBudget(0);
+  CHECK_EQUAL(size_t(1), store.GetCount());
+  store.Release(icons.Get(0));
+  CHECK_EQUAL(size_t(0), store.GetCount());
+  CHECK(icons.WasDestroyed(icons.Get(0)));
+}
+
+
+TEST(IconStore, InsertingTheStoredIconAgainKeepsIt) {
+  Icons icons;
+  IconStore store(1 << 20, icons.Destroyer());
+  const IconStore::Location location = At(L"C:\\a.lnk", 0);
+
+  store.Insert(&location, icons.Get(0), 100, 4096);
+  CHECK(store.Insert(&location, icons.Get(0), 100, 4096) == icons.Get(0));
+  CHECK(icons.destroyed.empty());
+  store.Release(icons.Get(0));
+  store.Release(icons.Get(0));
+}
+
+
+TEST(IconStore, EvictionNeverDestroysReferencedIcons) {
+  Icons icons;
+  IconStore store(3 * 1000, icons.Destroyer());
+
+  // Ten icons, of which every other one is still in use.
+  for (int i = 0; i < 10; ++i) {
+    const IconStore::Location location = At(L"C:\\icons.dll", i);
+    store.Insert(&location, icons.Get(i), uint64_t(i), 1000);
+    if (i % 2 == 1) {
+      store.Release(icons.Get(i));
+    }
+  }
+
+  for (int i = 0; i < 10; i += 2) {
+    CHECK(!icons.WasDestroyed(icons.Get(i)));
+  }
+  CHECK_EQUAL(size_t(5), store.GetCount());
+  CHECK_EQUAL(5u, uint32_t(store.GetStatistics().evictions));
+
+  // Over budget, with nothing left to evict.
+  store.SetBudget(0);
+  CHECK_EQUAL(size_t(5), store.GetCount());
+  CHECK_EQUAL(size_t(5000), store.GetCost());
+
+  // Icons go as soon as they are released.
+  store.Release(icons.Get(4));
+  CHECK(icons.WasDestroyed(icons.Get(4)));
+  CHECK(store.Find(At(L"C:\\icons.dll", 4)) == nullptr);
+  CHECK_EQUAL(size_t(4), store.GetCount());
+}
+
+
+TEST(IconStore, EvictsLeastRecentlyUsedFirst) {
+  Icons icons;
+  IconStore store(3 * 1000, icons.Destroyer());
+  for (int i = 0; i < 3; ++i) {
+    const IconStore::Location location = At(L"C:\\icons.dll", i);
+    store.Insert(&location, icons.Get(i), uint64_t(i), 1000);
+    store.Release(icons.Get(i));
+  }
+
+  // Using the oldest one makes the next oldest go first.
+  store.Find(At(L"C:\\icons.dll", 0));
+  store.Release(icons.Get(0));
+  const IconStore::Location location = At(L"C:\\icons.dll", 3);
+  store.Insert(&location, icons.Get(3), 3, 1000);
+  store.Release(icons.Get(3));
+
+  CHECK(icons.WasDestroyed(icons.Get(1)));
+  CHECK_EQUAL(size_t(1), icons.destroyed.size());
+}
+
+
+TEST(IconStore, IconsWithoutALocationAreNeverFound) {
+  // A popup item whose own icon couldn't be extracted stores a fallback icon without a location,
+  // so that the next lookup of its location tries again rather than finding the fallback.
+  Icons icons;
+  IconStore store(1 << 20, icons.Destroyer());
+  const IconStore::Location item = At(L"C:\\broken.lnk", 0);
+
+  CHECK(store.Insert(nullptr, icons.Get(0), 7, 4096) == icons.Get(0));
+  CHECK(store.Find(item) == nullptr);
+
+  // Even when the fallback is shared with an icon which does have a location.
+  const IconStore::Location folder = At(L"C:\\Windows\\shell32.dll", 4);
+  CHECK(store.Insert(&folder, icons.Get(1), 7, 4096) == icons.Get(0));
+  CHECK(store.Find(item) == nullptr);
+  CHECK(store.Find(folder) == icons.Get(0));
+
+  // And a location which led somewhere else keeps doing so.
+  const IconStore::Location other = At(L"C:\\other.lnk", 0);
+  store.Insert(&other, icons.Get(2), 8, 4096);
+  store.Insert(nullptr, icons.Get(3), 7, 4096);
+  CHECK(store.Find(other) == icons.Get(2));
+}
+
+
+TEST(IconStore, ChangedIconsReplaceTheirLocation) {
+  Icons icons;
+  IconStore store(1 << 20, icons.Destroyer());
+  const IconStore::Location location = At(L"C:\\app.exe", 0);
+
+  store.Insert(&location, icons.Get(0), 1, 4096);
+  store.Release(icons.Get(0));
+  store.Insert(&location, icons.Get(1), 2, 4096);
+  store.Release(icons.Get(1));
+  CHECK(store.Find(location) == icons.Get(1));
+  store.Release(icons.Get(1));
+
+  // The old icon is kept until the store needs the room.
+  CHECK_EQUAL(size_t(2), store.GetCount());
+  store.SetBudget(4096);
+  CHECK(icons.WasDestroyed(icons.Get(0)));
+  CHECK(!icons.WasDestroyed(icons.Get(1)));
+}
+
+
+TEST(IconStore, CountsHitsMissesSharesAndEvictions) {
+  Icons icons;
+  IconStore store(2 * 1000, icons.Destroyer());
+  const IconStore::Location a = At(L"C:\\a.lnk", 0);
+  const IconStore::Location b = At(L"C:\\b.lnk", 0);
+  const IconStore::Location c = At(L"C:\\c.lnk", 0);
+
+  store.Find(a);
+  store.Insert(&a, icons.Get(0), 1, 1000);
+  store.Find(a);
+  store.Find(a);
+  store.Find(b);
+  store.Insert(&b, icons.Get(1), 1, 1000);
+  store.Insert(&c, icons.Get(2), 2, 1000);
+  store.Insert(nullptr, icons.Get(3), 3, 1000);
+
+  IconStore::Statistics statistics = store.GetStatistics();
+  CHECK_EQUAL(2u, uint32_t(statistics.hits));
+  CHECK_EQUAL(2u, uint32_t(statistics.misses));
+  CHECK_EQUAL(1u, uint32_t(statistics.shared));
+  CHECK_EQUAL(0u, uint32_t(statistics.evictions));
+
+  // Two inserts and two finds, all of the same icon. Releasing them puts the store over budget.
+  for (int i = 0; i < 4; ++i) {
+    store.Release(icons.Get(0));
+  }
+  store.Release(icons.Get(2));
+  store.Release(icons.Get(3));
+  CHECK_EQUAL(1u, uint32_t(store.GetStatistics().evictions));
+
+  // Clearing doesn't count as evicting.
+  store.Clear();
+  CHECK_EQUAL(size_t(0), store.GetCount());
+  CHECK_EQUAL(1u, uint32_t(store.GetStatistics().evictions));
+}
+
+
+TEST(IconStore, DestroyingTheStoreDestroysEveryIcon) {
+  Icons icons;
+  {
+    IconStore store(1 << 20, icons.Destroyer());
+    store.Insert(nullptr, icons.Get(0), 1, 1000);
+    store.Insert(nullptr, icons.Get(1), 2, 1000);
+    store.Release(icons.Get(1));
+  }
+  CHECK_EQUAL(size_t(2), icons.destroyed.size());
+}
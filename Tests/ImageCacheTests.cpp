@@ -0,0 +1,432 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/ImageCacheTests.cpp
+// The nModules Project
+//
+// Tests for nCore's image cache, with images decoded from the BMP fixtures.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+#include "Fixtures.hpp"
+
+#include "../nCore/ImageCache.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string.h>
+#include <string>
+#include <thread>
+
+
+/// <summary>
+/// Decodes the BMP fixtures, and makes up modification times.
+/// </summary>
+class FixtureDecoder : public ImageCache::IDecoder {
+public:
+  FixtureDecoder() : decodes(0) {}
+
+  bool GetModifiedTime(const wchar_t *path, uint64_t *time) override {
+    auto iter = times.find(path);
+    *time = iter == times.end() ? 1 : iter->second;
+    return true;
+  }
+
+  bool Decode(const wchar_t *path, uint32_t *width, uint32_t *height,
+      std::vector<uint8_t> *pixels) override {
+    ++decodes;
+    if (!Fixtures::ReadBitmap(std::string(path, path + wcslen(path)), width, height, pixels)) {
+      return false;
+    }
+    for (size_t i = 0; i < pixels->size(); i += 4) {
+      uint8_t *pixel = &(*pixels)[i];
+      for (int c = 0; c < 3; ++c) {
+        pixel[c] = uint8_t((pixel[c] * pixel[3] + 127) / 255);
+      }
+    }
+    return true;
+  }
+
+public:
+  int decodes;
+  std::map<std::wstring, uint64_t> times;
+};
+
+
+/// <summary>
+/// Holds decodes of one path until the test lets them through.
+/// </summary>
+class GatedDecoder : public ImageCache::IDecoder {
+public:
+  explicit GatedDecoder(const std::wstring &gated)
+    : decodes(0)
+    , mGated(gated)
+    , mOpen(false)
+    , mWaiting(0)
+  {
+  }
+
+  bool GetModifiedTime(const wchar_t *path, uint64_t *time) override {
+    return mFixtures.GetModifiedTime(path, time);
+  }
+
+  bool Decode(const wchar_t *path, uint32_t *width, uint32_t *height,
+      std::vector<uint8_t> *pixels) override {
+    ++decodes;
+    if (mGated == path) {
+      std::unique_lock<std::mutex> lock(mMutex);
+      ++mWaiting;
+      mChanged.notify_all();
+      mChanged.wait(lock, [this] () { return mOpen; });
+    }
+
+    std::string narrow(path, path + wcslen(path));
+    return Fixtures::ReadBitmap(narrow, width, height, pixels);
+  }
+
+  void Open() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mOpen = true;
+    mChanged.notify_all();
+  }
+
+  // Waits for count decodes to be held up.
+  bool WaitForWaiting(int count) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mChanged.wait_for(lock, std::chrono::seconds(5), [this, count] () {
+      return mWaiting >= count;
+    });
+  }
+
+public:
+  std::atomic<int> decodes;
+
+private:
+  FixtureDecoder mFixtures;
+  const std::wstring mGated;
+  std::mutex mMutex;
+  std::condition_variable mChanged;
+  bool mOpen;
+  int mWaiting;
+};
+
+
+static std::wstring Fixture(const char *name) {
+  std::string path = Fixtures::GetPath(name);
+  return std::wstring(path.begin(), path.end());
+}
+
+
+static uint32_t PixelAt(const CachedImage *image, uint32_t x, uint32_t y) {
+  const uint8_t *pixel = image->pixels + size_t(y) * image->stride + x * 4;
+  return uint32_t(pixel[0]) | pixel[1] << 8 | pixel[2] << 16 | uint32_t(pixel[3]) << 24;
+}
+
+
+TEST(ImageCache, DecodesRgbFixture) {
+  FixtureDecoder decoder;
+  ImageCache cache(&decoder, 1 << 20);
+
+  const CachedImage *image = cache.Acquire(Fixture("rgb24.bmp").c_str(), 0, 0);
+  CHECK(image != nullptr);
+  CHECK_EQUAL(3u, image->width);
+  CHECK_EQUAL(2u, image->height);
+  CHECK_EQUAL(12u, image->stride);
+  CHECK_EQUAL(0xff0000ffu, PixelAt(image, 0, 0));
+  CHECK_EQUAL(0xff00ff00u, PixelAt(image, 1, 0));
+  CHECK_EQUAL(0xffff0000u, PixelAt(image, 2, 0));
+  CHECK_EQUAL(0xff000000u, PixelAt(image, 0, 1));
+  CHECK_EQUAL(0xff808080u, PixelAt(image, 1, 1));
+  CHECK_EQUAL(0xffffffffu, PixelAt(image, 2, 1));
+  cache.Release(image);
+}
+
+
+TEST(ImageCache, DecodesAlphaFixturePremultiplied) {
+  FixtureDecoder decoder;
+  ImageCache cache(&decoder, 1 << 20);
+
+  const CachedImage *image = cache.Acquire(Fixture("alpha32.bmp").c_str(), 0, 0);
+  CHECK(image != nullptr);
+  CHECK_EQUAL(0xffffffffu, PixelAt(image, 0, 0));
+  CHECK_EQUAL(0x00000000u, PixelAt(image, 1, 0));
+  CHECK_EQUAL(0x80193264u, PixelAt(image, 0, 1));
+  CHECK_EQUAL(0x40400000u, PixelAt(image, 1, 1));
+  cache.Release(image);
+}
+
+
+TEST(ImageCache, SharesImagesBetweenCallers) {
+  FixtureDecoder decoder;
+  ImageCache cache(&decoder, 1 << 20);
+  std::wstring path = Fixture("rgb24.bmp");
+
+  const CachedImage *first = cache.Acquire(path.c_str(), 0, 0);
+  const CachedImage *second = cache.Acquire(path.c_str(), 0, 0);
+  CHECK(first == second);
+  CHECK_EQUAL(1, decoder.decodes);
+  CHECK_EQUAL(size_t(3 * 2 * 4), cache.GetCost());
+
+  cache.Release(first);
+  cache.Release(second);
+  CHECK_EQUAL(size_t(1), cache.GetCount());
+}
+
+
+TEST(ImageCache, PathsAreCaseInsensitive) {
+  FixtureDecoder decoder;
+  ImageCache cache(&decoder, 1 << 20);
+  std::wstring path = Fixture("rgb24.bmp");
+  std::wstring upper = path.substr(0, path.size() - 9) + L"RGB24.BMP";
+
+  const CachedImage *first = cache.Acquire(path.c_str(), 0, 0);
+  const CachedImage *second = cache.Acquire(upper.c_str(), 0, 0);
+  CHECK(first == second);
+  CHECK_EQUAL(1, decoder.decodes);
+  cache.Release(first);
+  cache.Release(second);
+}
+
+
+TEST(ImageCache, ChangedFilesAreDecodedAgain) {
+  FixtureDecoder decoder;
+  ImageCache cache(&decoder, 1 << 20);
+  std::wstring path = Fixture("rgb24.bmp");
+
+  const CachedImage *old = cache.Acquire(path.c_str(), 0, 0);
+  decoder.times[path] = 2;
+  const CachedImage *fresh = cache.Acquire(path.c_str(), 0, 0);
+  CHECK(old != fresh);
+  CHECK_EQUAL(2, decoder.decodes);
+
+  // The old image stays valid until it is released.
+  CHECK_EQUAL(size_t(2), cache.GetCount());
+  CHECK_EQUAL(0xff0000ffu, PixelAt(old, 0, 0));
+  cache.Release(old);
+  CHECK_EQUAL(size_t(1), cache.GetCount());
+
+  cache.Release(fresh);
+  CHECK(cache.Acquire(path.c_str(), 0, 0) == fresh);
+  cache.Release(fresh);
+}
+
+
+TEST(ImageCache, MissingFilesFail) {
+  FixtureDecoder decoder;
+  ImageCache cache(&decoder, 1 << 20);
+
+  CHECK(cache.Acquire(Fixture("missing.bmp").c_str(), 0, 0) == nullptr);
+  CHECK(cache.Acquire(Fixture("missing.bmp").c_str(), 4, 4) == nullptr);
+  CHECK_EQUAL(size_t(0), cache.GetCount());
+  CHECK_EQUAL(size_t(0), cache.GetCost());
+}
+
+
+TEST(ImageCache, ScaledVariantsShareTheDecode) {
+  FixtureDecoder decoder;
+  ImageCache cache(&decoder, 1 << 20);
+  std::wstring path = Fixture("rgb24.bmp");
+
+  const CachedImage *small = cache.Acquire(path.c_str(), 2, 1);
+  const CachedImage *large = cache.Acquire(path.c_str(), 6, 4);
+  CHECK(small != nullptr && large != nullptr);
+  CHECK_EQUAL(2u, small->width);
+  CHECK_EQUAL(1u, small->height);
+  CHECK_EQUAL(6u, large->width);
+  CHECK_EQUAL(4u, large->height);
+  CHECK_EQUAL(1, decoder.decodes);
+  // The original, and the two variants.
+  CHECK_EQUAL(size_t(3), cache.GetCount());
+
+  // Asking for the original size gives the original.
+  const CachedImage *original = cache.Acquire(path.c_str(), 0, 0);
+  const CachedImage *same = cache.Acquire(path.c_str(), 3, 2);
+  CHECK(original == same);
+
+  cache.Release(small);
+  cache.Release(large);
+  cache.Release(original);
+  cache.Release(same);
+}
+
+
+TEST(ImageCache, EvictsUnreferencedImagesLeastRecentlyUsedFirst) {
+  FixtureDecoder decoder;
+  std::wstring rgb = Fixture("rgb24.bmp"), alpha = Fixture("alpha32.bmp");
+  // Room for the 24 byte rgb image, and the 16 byte alpha image.
+  ImageCache cache(&decoder, 40);
+
+  cache.Release(cache.Acquire(rgb.c_str(), 0, 0));
+  cache.Release(cache.Acquire(alpha.c_str(), 0, 0));
+  CHECK_EQUAL(size_t(2), cache.GetCount());
+
+  // Touch rgb, so that alpha is the oldest.
+  cache.Release(cache.Acquire(rgb.c_str(), 0, 0));
+  cache.SetBudget(30);
+  CHECK_EQUAL(size_t(1), cache.GetCount());
+  cache.Release(cache.Acquire(rgb.c_str(), 0, 0));
+  CHECK_EQUAL(2, decoder.decodes);
+
+  // Referenced images are never evicted, whatever the budget.
+  const CachedImage *held = cache.Acquire(alpha.c_str(), 0, 0);
+  cache.SetBudget(0);
+  CHECK_EQUAL(size_t(1), cache.GetCount());
+  CHECK_EQUAL(size_t(16), cache.GetCost());
+  cache.Release(held);
+  CHECK_EQUAL(size_t(0), cache.GetCount());
+  CHECK_EQUAL(size_t(0), cache.GetCost());
+}
+
+
+TEST(ImageCache, ClearKeepsReferencedImages) {
+  FixtureDecoder decoder;
+  ImageCache cache(&decoder, 1 << 20);
+
+  const CachedImage *held = cache.Acquire(Fixture("rgb24.bmp").c_str(), 0, 0);
+  cache.Release(cache.Acquire(Fixture("alpha32.bmp").c_str(), 0, 0));
+  cache.Clear();
+  CHECK_EQUAL(size_t(1), cache.GetCount());
+  CHECK_EQUAL(0xff0000ffu, PixelAt(held, 0, 0));
+  cache.Release(held);
+}
+
+
+TEST(ImageCache, ResamplingAtTheSameSizeIsExact) {
+  std::mt19937 random(30);
+  std::vector<uint8_t> source(7 * 5 * 4), dest(source.size());
+  for (size_t i = 0; i < source.size(); i += 4) {
+    source[i + 3] = uint8_t(random());
+    for (int c = 0; c < 3; ++c) {
+      source[i + c] = uint8_t(random() % (source[i + 3] + 1));
+    }
+  }
+
+  ImageCache::Resample(source.data(), 7, 5, 28, dest.data(), 7, 5, 28);
+  CHECK(source == dest);
+}
+
+
+TEST(ImageCache, ResamplingKeepsSolidColors) {
+  std::vector<uint8_t> source(5 * 3 * 4);
+  for (size_t i = 0; i < source.size(); i += 4) {
+    source[i] = 20;
+    source[i + 1] = 40;
+    source[i + 2] = 60;
+    source[i + 3] = 80;
+  }
+
+  const uint32_t sizes[][2] = { { 1, 1 }, { 2, 2 }, { 5, 7 }, { 13, 2 }, { 40, 30 } };
+  for (auto &size : sizes) {
+    std::vector<uint8_t> dest(size[0] * size[1] * 4);
+    ImageCache::Resample(source.data(), 5, 3, 20, dest.data(), size[0], size[1], size[0] * 4);
+    for (size_t i = 0; i < dest.size(); i += 4) {
+      CHECK_EQUAL(20, dest[i]);
+      CHECK_EQUAL(40, dest[i + 1]);
+      CHECK_EQUAL(60, dest[i + 2]);
+      CHECK_EQUAL(80, dest[i + 3]);
+    }
+  }
+}
+
+
+TEST(ImageCache, ResamplingStaysPremultiplied) {
+  std::mt19937 random(31);
+  std::vector<uint8_t> source(9 * 9 * 4);
+  for (size_t i = 0; i < source.size(); i += 4) {
+    source[i + 3] = uint8_t(random());
+    for (int c = 0; c < 3; ++c) {
+      source[i + c] = uint8_t(random() % (source[i + 3] + 1));
+    }
+  }
+
+  const uint32_t sizes[][2] = { { 2, 3 }, { 4, 4 }, { 17, 11 }, { 30, 5 } };
+  for (auto &size : sizes) {
+    std::vector<uint8_t> dest(size[0] * size[1] * 4);
+    ImageCache::Resample(source.data(), 9, 9, 36, dest.data(), size[0], size[1], size[0] * 4);
+    for (size_t i = 0; i < dest.size(); i += 4) {
+      CHECK(dest[i] <= dest[i + 3] && dest[i + 1] <= dest[i + 3] && dest[i + 2] <= dest[i + 3]);
+    }
+  }
+}
+
+
+TEST(ImageCache, ShrinkingAverages) {
+  // A 4x1 image which is black on the left half, and white on the right.
+  const uint8_t source[] = {
+    0, 0, 0, 255,  0, 0, 0, 255,  255, 255, 255, 255,  255, 255, 255, 255
+  };
+  uint8_t dest[8];
+
+  ImageCache::Resample(source, 4, 1, 16, dest, 2, 1, 8);
+  // The tent reaches a pixel into the other half, so the halves bleed into each other a little.
+  CHECK(dest[0] < 64);
+  CHECK(dest[4] > 191);
+  CHECK_EQUAL(255 - dest[0], int(dest[4]));
+
+  ImageCache::Resample(source, 4, 1, 16, dest, 1, 1, 4);
+  CHECK_NEAR(127.5, dest[0], 1);
+  CHECK_EQUAL(255, dest[3]);
+}
+
+
+TEST(ImageCache, SlowDecodesDontHoldUpOtherThreads) {
+  const std::wstring slow = Fixture("alpha32.bmp");
+  const std::wstring fast = Fixture("rgb24.bmp");
+  GatedDecoder decoder(slow);
+  ImageCache cache(&decoder, 1 << 20);
+
+  const CachedImage *cached = cache.Acquire(fast.c_str(), 0, 0);
+  CHECK(cached != nullptr);
+
+  const CachedImage *slowImage = nullptr;
+  std::thread loader([&] () {
+    slowImage = cache.Acquire(slow.c_str(), 0, 0);
+  });
+  CHECK(decoder.WaitForWaiting(1));
+
+  // The decode is stuck, but cached images, new decodes and releases all go through.
+  const CachedImage *again = cache.Acquire(fast.c_str(), 0, 0);
+  CHECK(again == cached);
+  cache.Release(again);
+  const CachedImage *scaled = cache.Acquire(fast.c_str(), 6, 4);
+  CHECK(scaled != nullptr);
+  cache.Release(scaled);
+  cache.Release(cached);
+  CHECK_EQUAL(size_t(2), cache.GetCount());
+
+  decoder.Open();
+  loader.join();
+  CHECK(slowImage != nullptr);
+  cache.Release(slowImage);
+  CHECK_EQUAL(size_t(3), cache.GetCount());
+}
+
+
+TEST(ImageCache, RacingLoadsShareTheFirstImage) {
+  const std::wstring path = Fixture("rgb24.bmp");
+  GatedDecoder decoder(path);
+  ImageCache cache(&decoder, 1 << 20);
+
+  // Both threads miss, and decode the image.
+  const CachedImage *images[2] = { nullptr, nullptr };
+  std::thread first([&] () { images[0] = cache.Acquire(path.c_str(), 0, 0); });
+  std::thread second([&] () { images[1] = cache.Acquire(path.c_str(), 0, 0); });
+  CHECK(decoder.WaitForWaiting(2));
+  decoder.Open();
+  first.join();
+  second.join();
+
+  CHECK_EQUAL(2, decoder.decodes.load());
+  CHECK(images[0] != nullptr);
+  CHECK(images[0] == images[1]);
+  CHECK_EQUAL(size_t(1), cache.GetCount());
+  CHECK_EQUAL(size_t(3 * 2 * 4), cache.GetCost());
+
+  // The image has a reference for each thread.
+  cache.Release(images[0]);
+  cache.SetBudget(0);
+  CHECK_EQUAL(size_t(1), cache.GetCount());
+  cache.Release(images[1]);
+  CHECK_EQUAL(size_t(0), cache.GetCount());
+}
@@ -0,0 +1,391 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/LayoutNodeTests.cpp
+// The nModules Project
+//
+// Tests for the flex and grid layouts of the Rewrite's nCore.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../Rewrite/nCore/LayoutNode.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace {
+  PaneLayout MakeLayout(PaneLayout::Type type) {
+    PaneLayout layout = PaneLayout();
+    layout.type = type;
+    layout.alignItems = PaneLayout::Align::Stretch;
+    return layout;
+  }
+
+  PaneLayoutItem MakeItem(float basis, float grow = 0, float shrink = 0) {
+    PaneLayoutItem item = PaneLayoutItem();
+    item.basis = NLength(basis, 0, 0);
+    item.crossSize = NLength(10, 0, 0);
+    item.grow = grow;
+    item.shrink = shrink;
+    item.row = LAYOUT_AUTO_PLACE;
+    item.column = LAYOUT_AUTO_PLACE;
+    return item;
+  }
+
+  // A node with a number of children, which are owned by the tree.
+  struct Tree {
+    LayoutNode root;
+    std::vector<std::unique_ptr<LayoutNode>> children;
+
+    Tree() : root(nullptr) {}
+
+    LayoutNode *Add(const PaneLayoutItem &item) {
+      children.emplace_back(new LayoutNode(nullptr));
+      children.back()->SetItem(&item);
+      root.AppendChild(children.back().get());
+      return children.back().get();
+    }
+  };
+
+  void CheckRect(const LayoutNode *node, float left, float top, float right, float bottom) {
+    const LayoutRect &rect = node->GetRect();
+    CHECK_NEAR(left, rect.left, 0.01);
+    CHECK_NEAR(top, rect.top, 0.01);
+    CHECK_NEAR(right, rect.right, 0.01);
+    CHECK_NEAR(bottom, rect.bottom, 0.01);
+  }
+}
+
+
+TEST(LayoutNode, NewNodeHasNoLayout) {
+  LayoutNode node(nullptr);
+  CHECK(!node.HasLayout());
+  CHECK(!node.IsItem());
+  CheckRect(&node, 0, 0, 0, 0);
+}
+
+
+TEST(LayoutNode, RowGrowsItemsByTheirFactors) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Row);
+  tree.root.SetLayout(&layout);
+  LayoutNode *a = tree.Add(MakeItem(10, 1));
+  LayoutNode *b = tree.Add(MakeItem(10, 3));
+
+  tree.root.Arrange(100, 20, 96, 96);
+
+  CheckRect(a, 0, 0, 30, 20);
+  CheckRect(b, 30, 0, 100, 20);
+}
+
+
+TEST(LayoutNode, RowShrinksItemsByTheirScaledFactors) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Row);
+  tree.root.SetLayout(&layout);
+  LayoutNode *a = tree.Add(MakeItem(100, 0, 1));
+  LayoutNode *b = tree.Add(MakeItem(50, 0, 1));
+
+  tree.root.Arrange(120, 20, 96, 96);
+
+  // 30 pixels too much, taken in proportion to the basis.
+  CheckRect(a, 0, 0, 80, 20);
+  CheckRect(b, 80, 0, 120, 20);
+}
+
+
+TEST(LayoutNode, ShrinkingIsWeightedByTheFlexBaseSize) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Row);
+  tree.root.SetLayout(&layout);
+  PaneLayoutItem limited = MakeItem(200, 0, 1);
+  limited.maxSize = NLength(150, 0, 0);
+  LayoutNode *a = tree.Add(limited);
+  LayoutNode *b = tree.Add(MakeItem(100, 0, 1));
+
+  tree.root.Arrange(200, 20, 96, 96);
+
+  // The bases add up to 100 pixels too much, which is taken 2:1, even though a starts out clamped
+  // to 150.
+  CheckRect(a, 0, 0, 133.33f, 20);
+  CheckRect(b, 133.33f, 0, 200, 20);
+}
+
+
+TEST(LayoutNode, GrowingStopsAtMaxSize) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Row);
+  tree.root.SetLayout(&layout);
+  PaneLayoutItem limited = MakeItem(10, 1);
+  limited.maxSize = NLength(20, 0, 0);
+  LayoutNode *a = tree.Add(limited);
+  LayoutNode *b = tree.Add(MakeItem(10, 1));
+
+  tree.root.Arrange(100, 20, 96, 96);
+
+  CheckRect(a, 0, 0, 20, 20);
+  CheckRect(b, 20, 0, 100, 20);
+}
+
+
+TEST(LayoutNode, ColumnWithGapsAndPadding) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Column);
+  layout.padding = NRect(NLength(5, 0, 0), NLength(5, 0, 0), NLength(5, 0, 0), NLength(5, 0, 0));
+  layout.rowGap = NLength(2, 0, 0);
+  tree.root.SetLayout(&layout);
+  LayoutNode *a = tree.Add(MakeItem(10));
+  LayoutNode *b = tree.Add(MakeItem(20));
+
+  tree.root.Arrange(50, 100, 96, 96);
+
+  CheckRect(a, 5, 5, 45, 15);
+  CheckRect(b, 5, 17, 45, 37);
+}
+
+
+TEST(LayoutNode, WrapStartsNewLines) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Row);
+  layout.wrap = true;
+  layout.alignItems = PaneLayout::Align::Start;
+  tree.root.SetLayout(&layout);
+  LayoutNode *a = tree.Add(MakeItem(40));
+  LayoutNode *b = tree.Add(MakeItem(40));
+  LayoutNode *c = tree.Add(MakeItem(40));
+
+  tree.root.Arrange(100, 100, 96, 96);
+
+  CheckRect(a, 0, 0, 40, 10);
+  CheckRect(b, 40, 0, 80, 10);
+  CheckRect(c, 0, 10, 40, 20);
+}
+
+
+TEST(LayoutNode, JustifySpaceBetween) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Row);
+  layout.justifyContent = PaneLayout::Align::SpaceBetween;
+  tree.root.SetLayout(&layout);
+  LayoutNode *a = tree.Add(MakeItem(10));
+  LayoutNode *b = tree.Add(MakeItem(10));
+  LayoutNode *c = tree.Add(MakeItem(10));
+
+  tree.root.Arrange(100, 10, 96, 96);
+
+  CheckRect(a, 0, 0, 10, 10);
+  CheckRect(b, 45, 0, 55, 10);
+  CheckRect(c, 90, 0, 100, 10);
+}
+
+
+TEST(LayoutNode, DipsScaleWithDpi) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Row);
+  tree.root.SetLayout(&layout);
+  PaneLayoutItem item = MakeItem(0);
+  item.basis = NLength(0, 0, 10);
+  LayoutNode *a = tree.Add(item);
+
+  tree.root.Arrange(100, 10, 192, 192);
+
+  CheckRect(a, 0, 0, 20, 10);
+}
+
+
+TEST(LayoutNode, GridAutoPlacesItems) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Grid);
+  NLENGTH columns[] = { NLength(30, 0, 0), NLength(20, 0, 0) };
+  NLENGTH rows[] = { NLength(10, 0, 0) };
+  layout.columns = columns;
+  layout.numColumns = 2;
+  layout.rows = rows;
+  layout.numRows = 1;
+  layout.columnGap = NLength(1, 0, 0);
+  tree.root.SetLayout(&layout);
+  LayoutNode *a = tree.Add(MakeItem(0));
+  LayoutNode *b = tree.Add(MakeItem(0));
+  LayoutNode *c = tree.Add(MakeItem(0));
+
+  tree.root.Arrange(100, 100, 96, 96);
+
+  CheckRect(a, 0, 0, 30, 10);
+  CheckRect(b, 31, 0, 51, 10);
+  // The last row repeats.
+  CheckRect(c, 0, 10, 30, 20);
+}
+
+
+TEST(LayoutNode, GridSpans) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Grid);
+  NLENGTH columns[] = { NLength(10, 0, 0) };
+  NLENGTH rows[] = { NLength(10, 0, 0) };
+  layout.columns = columns;
+  layout.numColumns = 1;
+  layout.rows = rows;
+  layout.numRows = 1;
+  tree.root.SetLayout(&layout);
+  PaneLayoutItem item = MakeItem(0);
+  item.row = 1;
+  item.column = 0;
+  item.rowSpan = 2;
+  LayoutNode *a = tree.Add(item);
+
+  tree.root.Arrange(100, 100, 96, 96);
+
+  CheckRect(a, 0, 10, 10, 30);
+}
+
+
+TEST(LayoutNode, GridMeasuresSpanningItems) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Grid);
+  NLENGTH columns[] = { NLength(20, 0, 0), NLength(10, 0, 0) };
+  NLENGTH rows[] = { NLength(10, 0, 0) };
+  layout.columns = columns;
+  layout.numColumns = 2;
+  layout.rows = rows;
+  layout.numRows = 1;
+  layout.rowGap = NLength(2, 0, 0);
+  tree.root.SetLayout(&layout);
+  LayoutNode *a = tree.Add(MakeItem(0));
+  PaneLayoutItem spanning = MakeItem(0);
+  spanning.columnSpan = 2;
+  LayoutNode *b = tree.Add(spanning);
+  LayoutNode *c = tree.Add(MakeItem(0));
+
+  // The spanning item doesn't fit next to a, so the three items take three rows rather than two.
+  float width, height;
+  tree.root.Measure(1000, 1000, 96, 96, &width, &height);
+  CHECK_NEAR(30, width, 0.01);
+  CHECK_NEAR(34, height, 0.01);
+
+  tree.root.Arrange(width, height, 96, 96);
+  CheckRect(a, 0, 0, 20, 10);
+  CheckRect(b, 0, 12, 30, 22);
+  CheckRect(c, 0, 24, 20, 34);
+
+  // An item placed past the explicit columns repeats the last one.
+  PaneLayoutItem outside = MakeItem(0);
+  outside.row = 0;
+  outside.column = 2;
+  tree.Add(outside);
+  tree.root.Measure(1000, 1000, 96, 96, &width, &height);
+  CHECK_NEAR(40, width, 0.01);
+}
+
+
+TEST(LayoutNode, MeasureFitsContent) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Row);
+  layout.columnGap = NLength(4, 0, 0);
+  tree.root.SetLayout(&layout);
+  tree.Add(MakeItem(10));
+  tree.Add(MakeItem(20));
+
+  float width, height;
+  tree.root.Measure(1000, 1000, 96, 96, &width, &height);
+
+  CHECK_NEAR(34, width, 0.01);
+  CHECK_NEAR(10, height, 0.01);
+}
+
+
+TEST(LayoutNode, RectChangesAreReportedOnce) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Row);
+  tree.root.SetLayout(&layout);
+  LayoutNode *a = tree.Add(MakeItem(10, 1));
+
+  tree.root.Arrange(100, 10, 96, 96);
+  CHECK(a->TakeRectChanged());
+  CHECK(!a->TakeRectChanged());
+
+  // Same box, nothing dirty.
+  tree.root.Arrange(100, 10, 96, 96);
+  CHECK(!a->TakeRectChanged());
+
+  tree.root.Arrange(50, 10, 96, 96);
+  CHECK(a->TakeRectChanged());
+  CheckRect(a, 0, 0, 50, 10);
+}
+
+
+TEST(LayoutNode, ChangingAnItemRelaysOutItsParent) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Row);
+  tree.root.SetLayout(&layout);
+  LayoutNode *a = tree.Add(MakeItem(10));
+  LayoutNode *b = tree.Add(MakeItem(10));
+  tree.root.Arrange(100, 10, 96, 96);
+  a->TakeRectChanged();
+  b->TakeRectChanged();
+
+  PaneLayoutItem wider = MakeItem(30);
+  a->SetItem(&wider);
+  tree.root.Arrange(100, 10, 96, 96);
+
+  CHECK(a->TakeRectChanged());
+  CHECK(b->TakeRectChanged());
+  CheckRect(b, 30, 0, 40, 10);
+}
+
+
+TEST(LayoutNode, ClearingTheLayoutResetsIt) {
+  Tree tree;
+  PaneLayout layout = MakeLayout(PaneLayout::Type::Grid);
+  layout.rowGap = NLength(5, 0, 0);
+  tree.root.SetLayout(&layout);
+  CHECK(tree.root.HasLayout());
+
+  tree.root.SetLayout(nullptr);
+  CHECK(!tree.root.HasLayout());
+  float width, height;
+  tree.root.Measure(100, 100, 96, 96, &width, &height);
+  CHECK_NEAR(0, width, 0.01);
+  CHECK_NEAR(0, height, 0.01);
+}
+
+
+TEST(LayoutNode, SyntheticTreeOf10kNodes) {
+  // 100 rows of 100 items each.
+  LayoutNode root(nullptr);
+  PaneLayout column = MakeLayout(PaneLayout::Type::Column);
+  PaneLayout row = MakeLayout(PaneLayout::Type::Row);
+  root.SetLayout(&column);
+
+  std::vector<std::unique_ptr<LayoutNode>> nodes;
+  PaneLayoutItem rowItem = MakeItem(10);
+  PaneLayoutItem leafItem = MakeItem(1, 1);
+  for (int i = 0; i < 100; ++i) {
+    nodes.emplace_back(new LayoutNode(nullptr));
+    LayoutNode *rowNode = nodes.back().get();
+    rowNode->SetLayout(&row);
+    rowNode->SetItem(&rowItem);
+    root.AppendChild(rowNode);
+    for (int j = 0; j < 100; ++j) {
+      nodes.emplace_back(new LayoutNode(nullptr));
+      nodes.back()->SetItem(&leafItem);
+      rowNode->AppendChild(nodes.back().get());
+    }
+  }
+
+  root.Arrange(1000, 1000, 96, 96);
+  const LayoutNode *last = nodes.back().get();
+  CheckRect(last, 990, 0, 1000, 10);
+  CheckRect(last->GetParent(), 0, 990, 1000, 1000);
+
+  // Only the row which was changed is arranged again.
+  for (auto &node : nodes) {
+    node->TakeRectChanged();
+  }
+  PaneLayoutItem wider = MakeItem(1, 3);
+  nodes[1]->SetItem(&wider);
+  root.Arrange(1000, 1000, 96, 96);
+
+  int changed = 0;
+  for (auto &node : nodes) {
+    changed += node->TakeRectChanged() ? 1 : 0;
+  }
+  CHECK_EQUAL(100, changed);
+}
@@ -0,0 +1,74 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/MemoryThumbnailStorage.hpp
+// The nModules Project
+//
+// Keeps a thumbnail store's files in memory, for testing and benchmarking the store.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../nCore/ThumbnailStore.hpp"
+
+/// <summary>
+/// Holds the data file and the index in memory. Outlives any number of stores, so that reopening
+/// the store can be tested, and the files can be damaged in between.
+/// </summary>
+class MemoryThumbnailStorage : public ThumbnailStore::IStorage {
+public:
+  MemoryThumbnailStorage() : hasIndex(false), failAppends(false) {}
+
+  uint64_t GetDataSize() override {
+    return data.size();
+  }
+
+  bool AppendData(const void *buffer, size_t size) override {
+    if (failAppends) {
+      // Leaves half of it behind, like a full disk would.
+      data.insert(data.end(), (const uint8_t*)buffer, (const uint8_t*)buffer + size / 2);
+      return false;
+    }
+    data.insert(data.end(), (const uint8_t*)buffer, (const uint8_t*)buffer + size);
+    return true;
+  }
+
+  bool TruncateData(uint64_t size) override {
+    data.resize(size_t(size));
+    return true;
+  }
+
+  const uint8_t *MapData() override {
+    return data.empty() ? nullptr : data.data();
+  }
+
+  bool RewriteData(const void *header, size_t headerSize,
+      const std::vector<std::pair<uint64_t, uint64_t>> &ranges) override {
+    std::vector<uint8_t> rewritten((const uint8_t*)header, (const uint8_t*)header + headerSize);
+    for (const auto &range : ranges) {
+      rewritten.insert(rewritten.end(), data.begin() + size_t(range.first),
+        data.begin() + size_t(range.first + range.second));
+    }
+    data.swap(rewritten);
+    return true;
+  }
+
+  bool ReadIndex(std::vector<uint8_t> *buffer) override {
+    if (!hasIndex) {
+      return false;
+    }
+    *buffer = index;
+    return true;
+  }
+
+  bool WriteIndex(const std::vector<uint8_t> &buffer) override {
+    index = buffer;
+    hasIndex = true;
+    return true;
+  }
+
+public:
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> index;
+  bool hasIndex;
+
+  // Makes appends fail halfway through.
+  bool failAppends;
+};
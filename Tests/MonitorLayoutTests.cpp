@@ -0,0 +1,182 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/MonitorLayoutTests.cpp
+// The nModules Project
+//
+// Tests for how nDesk splits the desktop into monitors, and routes damage to them.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nDesk/MonitorLayout.hpp"
+
+#include <vector>
+
+namespace {
+  MonitorLayout::Rect MakeRect(long left, long top, long right, long bottom) {
+    MonitorLayout::Rect rect = { left, top, right, bottom };
+    return rect;
+  }
+
+  bool Equal(const MonitorLayout::Rect &a, const MonitorLayout::Rect &b) {
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+  }
+
+  // Two 1920x1080 monitors side by side, and a smaller one below the first, leaving a gap.
+  MonitorLayout ThreeMonitors() {
+    MonitorLayout layout;
+    layout.SetMonitors({
+      MakeRect(0, 0, 1920, 1080),
+      MakeRect(1920, 0, 3840, 1080),
+      MakeRect(0, 1080, 1280, 2104)
+    });
+    return layout;
+  }
+
+  std::vector<MonitorLayout::Rect> TakeDirty(MonitorLayout &layout, size_t surface) {
+    std::vector<MonitorLayout::Rect> rects;
+    layout.TakeDirty(surface, rects);
+    return rects;
+  }
+}
+
+
+TEST(MonitorLayout, EveryMonitorGetsASurface) {
+  MonitorLayout layout = ThreeMonitors();
+
+  CHECK_EQUAL(size_t(3), layout.GetSurfaceCount());
+  CHECK(Equal(MakeRect(1920, 0, 3840, 1080), layout.GetSurface(1)));
+  CHECK(Equal(MakeRect(0, 1080, 1280, 2104), layout.GetSurface(2)));
+}
+
+
+TEST(MonitorLayout, MirroredMonitorsShareASurface) {
+  MonitorLayout layout;
+  layout.SetMonitors({
+    MakeRect(0, 0, 1920, 1080),
+    MakeRect(0, 0, 1920, 1080),
+    MakeRect(1920, 0, 3840, 1080),
+    MakeRect(0, 0, 0, 0)
+  });
+
+  CHECK_EQUAL(size_t(2), layout.GetSurfaceCount());
+}
+
+
+TEST(MonitorLayout, NothingIsDirtyAtFirst) {
+  MonitorLayout layout = ThreeMonitors();
+
+  for (size_t surface = 0; surface < layout.GetSurfaceCount(); ++surface) {
+    std::vector<MonitorLayout::Rect> rects;
+    CHECK(!layout.TakeDirty(surface, rects));
+    CHECK(rects.empty());
+  }
+}
+
+
+TEST(MonitorLayout, DamageIsRoutedToTheMonitorsItTouches) {
+  MonitorLayout layout = ThreeMonitors();
+
+  // An icon group straddling the first two monitors.
+  layout.Invalidate(MakeRect(1800, 100, 2000, 200));
+
+  std::vector<MonitorLayout::Rect> first = TakeDirty(layout, 0);
+  std::vector<MonitorLayout::Rect> second = TakeDirty(layout, 1);
+  std::vector<MonitorLayout::Rect> third = TakeDirty(layout, 2);
+
+  CHECK_EQUAL(size_t(1), first.size());
+  CHECK(Equal(MakeRect(1800, 100, 1920, 200), first[0]));
+  CHECK_EQUAL(size_t(1), second.size());
+  CHECK(Equal(MakeRect(1920, 100, 2000, 200), second[0]));
+  CHECK(third.empty());
+}
+
+
+TEST(MonitorLayout, DamageInTheGapsIsDropped) {
+  MonitorLayout layout = ThreeMonitors();
+
+  // Below the second monitor, and right of the third, there is no monitor at all.
+  layout.Invalidate(MakeRect(2000, 1200, 2400, 1400));
+
+  for (size_t surface = 0; surface < layout.GetSurfaceCount(); ++surface) {
+    CHECK(TakeDirty(layout, surface).empty());
+  }
+}
+
+
+TEST(MonitorLayout, TakingTheDamageClearsIt) {
+  MonitorLayout layout = ThreeMonitors();
+  layout.Invalidate(MakeRect(10, 10, 20, 20));
+
+  CHECK_EQUAL(size_t(1), TakeDirty(layout, 0).size());
+  CHECK(TakeDirty(layout, 0).empty());
+}
+
+
+TEST(MonitorLayout, ContainedDamageIsDropped) {
+  MonitorLayout layout = ThreeMonitors();
+  layout.Invalidate(MakeRect(10, 10, 20, 20));
+  layout.Invalidate(MakeRect(0, 0, 100, 100));
+  layout.Invalidate(MakeRect(50, 50, 60, 60));
+
+  std::vector<MonitorLayout::Rect> rects = TakeDirty(layout, 0);
+  CHECK_EQUAL(size_t(1), rects.size());
+  CHECK(Equal(MakeRect(0, 0, 100, 100), rects[0]));
+}
+
+
+TEST(MonitorLayout, ScatteredDamageIsKeptApart) {
+  MonitorLayout layout = ThreeMonitors();
+  layout.Invalidate(MakeRect(0, 0, 10, 10));
+  layout.Invalidate(MakeRect(1000, 1000, 1010, 1010));
+
+  std::vector<MonitorLayout::Rect> rects = TakeDirty(layout, 0);
+  CHECK_EQUAL(size_t(2), rects.size());
+  CHECK(Equal(MakeRect(0, 0, 10, 10), rects[0]));
+  CHECK(Equal(MakeRect(1000, 1000, 1010, 1010), rects[1]));
+}
+
+
+TEST(MonitorLayout, DamageCoveringMostOfItsBoundsIsMerged) {
+  MonitorLayout layout = ThreeMonitors();
+  layout.Invalidate(MakeRect(0, 0, 100, 100));
+  layout.Invalidate(MakeRect(100, 0, 200, 100));
+
+  std::vector<MonitorLayout::Rect> rects = TakeDirty(layout, 0);
+  CHECK_EQUAL(size_t(1), rects.size());
+  CHECK(Equal(MakeRect(0, 0, 200, 100), rects[0]));
+}
+
+
+TEST(MonitorLayout, TooManyRectsAreMerged) {
+  MonitorLayout layout = ThreeMonitors();
+  const size_t count = MonitorLayout::MAX_DIRTY_RECTS + 1;
+  for (size_t i = 0; i < count; ++i) {
+    long offset = long(i) * 100;
+    layout.Invalidate(MakeRect(offset, offset, offset + 1, offset + 1));
+  }
+
+  std::vector<MonitorLayout::Rect> rects = TakeDirty(layout, 0);
+  CHECK_EQUAL(size_t(1), rects.size());
+  CHECK(Equal(MakeRect(0, 0, long(count - 1) * 100 + 1, long(count - 1) * 100 + 1), rects[0]));
+}
+
+
+TEST(MonitorLayout, InvalidateAllCoversEveryMonitor) {
+  MonitorLayout layout = ThreeMonitors();
+  layout.Invalidate(MakeRect(10, 10, 20, 20));
+  layout.InvalidateAll();
+
+  for (size_t surface = 0; surface < layout.GetSurfaceCount(); ++surface) {
+    std::vector<MonitorLayout::Rect> rects = TakeDirty(layout, surface);
+    CHECK_EQUAL(size_t(1), rects.size());
+    CHECK(Equal(layout.GetSurface(surface), rects[0]));
+  }
+}
+
+
+TEST(MonitorLayout, SettingTheMonitorsDropsTheDamage) {
+  MonitorLayout layout = ThreeMonitors();
+  layout.Invalidate(MakeRect(10, 10, 20, 20));
+  layout.SetMonitors({ MakeRect(0, 0, 1920, 1080) });
+
+  CHECK(TakeDirty(layout, 0).empty());
+}
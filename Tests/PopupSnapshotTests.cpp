@@ -0,0 +1,252 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/PopupSnapshotTests.cpp
+// The nModules Project
+//
+// Tests for the snapshot which popups are shown from right after startup: that it reads back what
+// was written, that damage is caught, and that folders which have changed are dropped.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nPopup/PopupSnapshot.hpp"
+
+#include <map>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+  // Where the counts are in a written snapshot, for a snapshot with one folder.
+  const size_t FOLDER_COUNT_OFFSET = 8;
+  const size_t CHECKSUM_OFFSET = 16;
+  const size_t HEADER_SIZE = 24;
+  const size_t ITEM_COUNT_OFFSET = HEADER_SIZE + 12;
+
+  PopupSnapshot::Item MakeItem(const wchar_t *title, const wchar_t *command, bool folder) {
+    PopupSnapshot::Item item = { title, command, folder };
+    return item;
+  }
+
+  std::vector<PopupSnapshot::Item> ProgramsItems() {
+    std::vector<PopupSnapshot::Item> items;
+    items.push_back(MakeItem(L"Accessories", L"C:\\Programs\\Accessories", true));
+    items.push_back(MakeItem(L"Calculator", L"C:\\Programs\\Calculator.lnk", false));
+    items.push_back(MakeItem(L"Caf\u00e9 \u65e5\u672c", L"C:\\Programs\\Caf\u00e9.lnk", false));
+    items.push_back(MakeItem(L"", L"", false));
+    return items;
+  }
+
+  std::vector<PopupSnapshot::Item> StartupItems() {
+    std::vector<PopupSnapshot::Item> items;
+    items.push_back(MakeItem(L"Dropbox", L"C:\\Startup\\Dropbox.lnk", false));
+    return items;
+  }
+
+  bool SameItems(const std::vector<PopupSnapshot::Item> &a,
+      const std::vector<PopupSnapshot::Item> &b) {
+    if (a.size() != b.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+      if (a[i].title != b[i].title || a[i].command != b[i].command || a[i].folder != b[i].folder) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<uint8_t> WriteOneFolder() {
+    PopupSnapshot snapshot;
+    snapshot.Store(L"C:\\Startup", 7, StartupItems());
+    std::vector<uint8_t> data;
+    snapshot.Write(data);
+    return data;
+  }
+
+  // Puts the checksum of the data back in its header, as if it had been written that way.
+  void Reseal(std::vector<uint8_t> &data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = HEADER_SIZE; i < data.size(); ++i) {
+      hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    memcpy(data.data() + CHECKSUM_OFFSET, &hash, sizeof(hash));
+  }
+
+  void SetCount(std::vector<uint8_t> &data, size_t offset, uint32_t count) {
+    memcpy(data.data() + offset, &count, sizeof(count));
+  }
+}
+
+
+TEST(PopupSnapshot, RoundTrips) {
+  PopupSnapshot written;
+  written.Store(L"C:\\Programs", 1234567890123ULL, ProgramsItems());
+  written.Store(L"C:\\Startup", 7, StartupItems());
+  written.Store(L"C:\\Empty", 42, std::vector<PopupSnapshot::Item>());
+  CHECK(written.IsDirty());
+
+  std::vector<uint8_t> data;
+  written.Write(data);
+
+  PopupSnapshot read;
+  CHECK(read.Read(data.data(), data.size()));
+  CHECK_EQUAL(size_t(3), read.GetFolderCount());
+  CHECK(!read.IsDirty());
+
+  const PopupSnapshot::Folder *programs = read.Find(L"C:\\Programs", 1234567890123ULL);
+  CHECK(programs != nullptr);
+  if (programs != nullptr) {
+    CHECK(SameItems(ProgramsItems(), programs->items));
+    CHECK(!programs->verified);
+  }
+
+  const PopupSnapshot::Folder *startup = read.Find(L"C:\\Startup", 7);
+  CHECK(startup != nullptr && SameItems(StartupItems(), startup->items));
+
+  const PopupSnapshot::Folder *empty = read.Find(L"C:\\Empty", 42);
+  CHECK(empty != nullptr && empty->items.empty());
+
+  // Writing what was read gives a snapshot which reads back the same way.
+  std::vector<uint8_t> again;
+  read.Write(again);
+  CHECK_EQUAL(data.size(), again.size());
+  PopupSnapshot reread;
+  CHECK(reread.Read(again.data(), again.size()));
+  CHECK_EQUAL(size_t(3), reread.GetFolderCount());
+}
+
+
+TEST(PopupSnapshot, EmptySnapshotRoundTrips) {
+  PopupSnapshot written;
+  std::vector<uint8_t> data;
+  written.Write(data);
+  CHECK_EQUAL(HEADER_SIZE, data.size());
+
+  PopupSnapshot read;
+  CHECK(read.Read(data.data(), data.size()));
+  CHECK_EQUAL(size_t(0), read.GetFolderCount());
+}
+
+
+TEST(PopupSnapshot, FindNeedsTheSameStamp) {
+  PopupSnapshot snapshot;
+  snapshot.Store(L"C:\\Startup", 7, StartupItems());
+  CHECK(snapshot.Find(L"C:\\Startup", 7) != nullptr);
+  CHECK(snapshot.Find(L"C:\\Startup", 8) == nullptr);
+  CHECK(snapshot.Find(L"C:\\Other", 7) == nullptr);
+}
+
+
+TEST(PopupSnapshot, EveryDamagedByteIsCaught) {
+  std::vector<uint8_t> data = WriteOneFolder();
+  for (size_t i = 0; i < data.size(); ++i) {
+    // The reserved field isn't looked at.
+    if (i >= 12 && i < 16) {
+      continue;
+    }
+    std::vector<uint8_t> damaged = data;
+    damaged[i] ^= 0x20;
+
+    PopupSnapshot snapshot;
+    snapshot.Store(L"C:\\Before", 1, StartupItems());
+    CHECK(!snapshot.Read(damaged.data(), damaged.size()));
+    CHECK_EQUAL(size_t(0), snapshot.GetFolderCount());
+  }
+}
+
+
+TEST(PopupSnapshot, TruncatedOrExtendedSnapshotsAreRejected) {
+  std::vector<uint8_t> data = WriteOneFolder();
+  for (size_t size = 0; size < data.size(); ++size) {
+    PopupSnapshot snapshot;
+    CHECK(!snapshot.Read(data.data(), size));
+    CHECK_EQUAL(size_t(0), snapshot.GetFolderCount());
+  }
+
+  // Trailing data is rejected even if the checksum covers it.
+  data.push_back(0);
+  Reseal(data);
+  PopupSnapshot snapshot;
+  CHECK(!snapshot.Read(data.data(), data.size()));
+  CHECK_EQUAL(size_t(0), snapshot.GetFolderCount());
+}
+
+
+TEST(PopupSnapshot, CountsWhichDontFitAreRejected) {
+  // The folder count isn't covered by the checksum.
+  std::vector<uint8_t> data = WriteOneFolder();
+  SetCount(data, FOLDER_COUNT_OFFSET, 0xFFFFFFFF);
+  PopupSnapshot snapshot;
+  CHECK(!snapshot.Read(data.data(), data.size()));
+
+  // A snapshot which was written wrong, but sealed, mustn't make the reader allocate billions of
+  // items.
+  data = WriteOneFolder();
+  SetCount(data, ITEM_COUNT_OFFSET, 0x10000000);
+  Reseal(data);
+  CHECK(!snapshot.Read(data.data(), data.size()));
+  CHECK_EQUAL(size_t(0), snapshot.GetFolderCount());
+}
+
+
+TEST(PopupSnapshot, ValidateDropsChangedFolders) {
+  PopupSnapshot snapshot;
+  snapshot.Store(L"C:\\Programs", 1, ProgramsItems());
+  snapshot.Store(L"C:\\Startup", 2, StartupItems());
+  snapshot.Store(L"C:\\Removed", 3, StartupItems());
+  snapshot.ClearDirty();
+
+  std::map<std::wstring, uint64_t> stamps;
+  stamps[L"C:\\Programs"] = 1;
+  stamps[L"C:\\Startup"] = 5;
+  auto getStamp = [&stamps] (const std::wstring &path, uint64_t *modifiedTime) -> bool {
+    auto stamp = stamps.find(path);
+    if (stamp == stamps.end()) {
+      return false;
+    }
+    *modifiedTime = stamp->second;
+    return true;
+  };
+
+  snapshot.Validate(getStamp);
+  CHECK(snapshot.IsDirty());
+  CHECK_EQUAL(size_t(1), snapshot.GetFolderCount());
+  CHECK(snapshot.Find(L"C:\\Programs", 1) != nullptr);
+
+  // Nothing else has changed.
+  snapshot.ClearDirty();
+  snapshot.Validate(getStamp);
+  CHECK(!snapshot.IsDirty());
+  CHECK_EQUAL(size_t(1), snapshot.GetFolderCount());
+}
+
+
+TEST(PopupSnapshot, StoringTheSameItemsOnlyVerifiesThem) {
+  PopupSnapshot written;
+  written.Store(L"C:\\Startup", 7, StartupItems());
+  std::vector<uint8_t> data;
+  written.Write(data);
+
+  PopupSnapshot snapshot;
+  CHECK(snapshot.Read(data.data(), data.size()));
+  snapshot.Store(L"C:\\Startup", 7, StartupItems());
+  CHECK(!snapshot.IsDirty());
+  CHECK(snapshot.Find(L"C:\\Startup", 7)->verified);
+
+  // A folder which has changed is replaced.
+  std::vector<PopupSnapshot::Item> items = StartupItems();
+  items.push_back(MakeItem(L"Steam", L"C:\\Startup\\Steam.lnk", false));
+  snapshot.Store(L"C:\\Startup", 8, std::vector<PopupSnapshot::Item>(items));
+  CHECK(snapshot.IsDirty());
+  CHECK(snapshot.Find(L"C:\\Startup", 7) == nullptr);
+  CHECK(SameItems(items, snapshot.Find(L"C:\\Startup", 8)->items));
+}
+
+
+TEST(PopupSnapshot, StoringANewFolderMarksItDirty) {
+  // Even one which looks like a default folder.
+  PopupSnapshot snapshot;
+  snapshot.Store(L"C:\\Empty", 0, std::vector<PopupSnapshot::Item>());
+  CHECK(snapshot.IsDirty());
+  CHECK(snapshot.Find(L"C:\\Empty", 0) != nullptr);
+}
@@ -0,0 +1,235 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/ResamplerTests.cpp
+// The nModules Project
+//
+// Tests for the resampler which scales wallpapers to the monitor: that it leaves images which
+// don't need scaling alone, doesn't change flat colors, and keeps premultiplied pixels valid.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../Rewrite/nShared/Resampler.h"
+
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+namespace {
+  const Resampler::Filter FILTERS[] = { Resampler::Filter::Box, Resampler::Filter::Lanczos3 };
+
+  /// <summary>
+  /// A premultiplied BGRA image, with some padding at the end of every row.
+  /// </summary>
+  struct Image {
+    Image(uint32_t width, uint32_t height, uint8_t padding = 0)
+      : width(width)
+      , height(height)
+      , stride(width * 4 + 12)
+      , pixels(size_t(stride) * height, padding)
+    {
+    }
+
+    uint8_t *At(uint32_t x, uint32_t y) {
+      return pixels.data() + size_t(y) * stride + size_t(x) * 4;
+    }
+
+    void Fill(uint8_t b, uint8_t g, uint8_t r, uint8_t a) {
+      for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+          Set(x, y, b, g, r, a);
+        }
+      }
+    }
+
+    void Set(uint32_t x, uint32_t y, uint8_t b, uint8_t g, uint8_t r, uint8_t a) {
+      uint8_t *pixel = At(x, y);
+      pixel[0] = b;
+      pixel[1] = g;
+      pixel[2] = r;
+      pixel[3] = a;
+    }
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    std::vector<uint8_t> pixels;
+  };
+
+  Resampler::Region Whole(const Image &image) {
+    Resampler::Region region = { 0.0f, 0.0f, float(image.width), float(image.height) };
+    return region;
+  }
+
+  void Resample(Image &source, const Resampler::Region &region, Image &dest,
+      Resampler::Filter filter) {
+    Resampler::Resample(source.pixels.data(), source.width, source.height, source.stride, region,
+      dest.pixels.data(), dest.width, dest.height, dest.stride, filter);
+  }
+
+  // Returns true if every color channel is at most alpha.
+  bool IsPremultiplied(Image &image) {
+    for (uint32_t y = 0; y < image.height; ++y) {
+      for (uint32_t x = 0; x < image.width; ++x) {
+        const uint8_t *pixel = image.At(x, y);
+        if (pixel[0] > pixel[3] || pixel[1] > pixel[3] || pixel[2] > pixel[3]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+}
+
+
+TEST(Resampler, SameSizeCopiesThePixels) {
+  std::mt19937 random(31);
+  Image source(37, 23, 0xCD);
+  for (uint32_t y = 0; y < source.height; ++y) {
+    for (uint32_t x = 0; x < source.width; ++x) {
+      uint8_t a = uint8_t(random());
+      source.Set(x, y, uint8_t(random() % (a + 1)), uint8_t(random() % (a + 1)),
+        uint8_t(random() % (a + 1)), a);
+    }
+  }
+
+  for (Resampler::Filter filter : FILTERS) {
+    Image dest(source.width, source.height, 0xAB);
+    Resample(source, Whole(source), dest, filter);
+
+    bool same = true;
+    for (uint32_t y = 0; y < source.height; ++y) {
+      for (uint32_t x = 0; x < source.width * 4; ++x) {
+        same &= source.At(0, y)[x] == dest.At(0, y)[x];
+      }
+      // The padding is left alone.
+      for (uint32_t x = source.width * 4; x < dest.stride; ++x) {
+        same &= dest.At(0, y)[x] == 0xAB;
+      }
+    }
+    CHECK(same);
+  }
+}
+
+
+TEST(Resampler, FlatColorsStayFlat) {
+  Image source(64, 40);
+  source.Fill(40, 80, 120, 200);
+
+  // Shrinking, stretching, both at once, and fractional regions.
+  const uint32_t sizes[][2] = { { 16, 10 }, { 173, 91 }, { 7, 120 }, { 1, 1 }, { 64, 40 } };
+  const Resampler::Region regions[] = {
+    Whole(source), { 10.25f, 3.5f, 50.75f, 39.9f }, { 0.0f, 0.0f, 1.5f, 0.5f }
+  };
+
+  for (Resampler::Filter filter : FILTERS) {
+    for (const Resampler::Region &region : regions) {
+      for (const uint32_t *size : sizes) {
+        Image dest(size[0], size[1]);
+        Resample(source, region, dest, filter);
+
+        bool flat = true;
+        for (uint32_t y = 0; y < dest.height; ++y) {
+          for (uint32_t x = 0; x < dest.width; ++x) {
+            const uint8_t *pixel = dest.At(x, y);
+            flat &= pixel[0] == 40 && pixel[1] == 80 && pixel[2] == 120 && pixel[3] == 200;
+          }
+        }
+        CHECK(flat);
+      }
+    }
+  }
+}
+
+
+TEST(Resampler, TransparentPixelsDontBleed) {
+  // Opaque blue next to transparent pixels. Only the alpha may fade, never the hue.
+  Image source(40, 40);
+  for (uint32_t y = 0; y < source.height; ++y) {
+    for (uint32_t x = 0; x < source.width; ++x) {
+      if ((x / 5 + y / 7) % 2 == 0) {
+        source.Set(x, y, 255, 0, 0, 255);
+      } else {
+        source.Set(x, y, 0, 0, 0, 0);
+      }
+    }
+  }
+
+  const uint32_t sizes[][2] = { { 13, 9 }, { 97, 61 } };
+  for (Resampler::Filter filter : FILTERS) {
+    for (const uint32_t *size : sizes) {
+      Image dest(size[0], size[1]);
+      Resample(source, Whole(source), dest, filter);
+
+      bool blue = true, faded = false;
+      for (uint32_t y = 0; y < dest.height; ++y) {
+        for (uint32_t x = 0; x < dest.width; ++x) {
+          const uint8_t *pixel = dest.At(x, y);
+          blue &= pixel[1] == 0 && pixel[2] == 0 && pixel[0] + 1 >= pixel[3]
+            && pixel[0] <= pixel[3];
+          faded |= pixel[3] > 0 && pixel[3] < 255;
+        }
+      }
+      CHECK(blue);
+      CHECK(faded);
+    }
+  }
+}
+
+
+TEST(Resampler, RingingIsClamped) {
+  // A hard edge, which makes Lanczos3 overshoot on both sides, in color and in alpha.
+  Image opaque(8, 4), translucent(8, 4);
+  for (uint32_t y = 0; y < opaque.height; ++y) {
+    for (uint32_t x = 0; x < opaque.width; ++x) {
+      if (x < 4) {
+        opaque.Set(x, y, 0, 0, 0, 255);
+        translucent.Set(x, y, 0, 0, 0, 0);
+      } else {
+        opaque.Set(x, y, 255, 255, 255, 255);
+        translucent.Set(x, y, 255, 255, 255, 255);
+      }
+    }
+  }
+
+  for (Image *source : { &opaque, &translucent }) {
+    Image dest(64, 4);
+    Resample(*source, Whole(*source), dest, Resampler::Filter::Lanczos3);
+    CHECK(IsPremultiplied(dest));
+
+    // Values which went past 0 or 255 must not wrap around to the other end.
+    bool clamped = true;
+    for (uint32_t y = 0; y < dest.height; ++y) {
+      for (uint32_t x = 0; x < dest.width; ++x) {
+        const uint8_t *pixel = dest.At(x, y);
+        const double center = (x + 0.5) / 8.0;
+        if (center < 3.5) {
+          clamped &= pixel[0] < 128 && pixel[1] < 128 && pixel[2] < 128;
+        } else if (center > 4.5) {
+          clamped &= pixel[0] > 128 && pixel[1] > 128 && pixel[2] > 128 && pixel[3] > 128;
+        }
+        if (center < 1.0) {
+          clamped &= pixel[0] == 0;
+        } else if (center > 7.0) {
+          clamped &= pixel[0] == 255 && pixel[3] == 255;
+        }
+      }
+    }
+    CHECK(clamped);
+  }
+}
+
+
+TEST(Resampler, EmptyImagesAreIgnored) {
+  Image source(4, 4);
+  source.Fill(10, 20, 30, 40);
+  Image dest(4, 4, 0x77);
+  const Resampler::Region empty = { 2.0f, 0.0f, 2.0f, 4.0f };
+  Resample(source, empty, dest, Resampler::Filter::Lanczos3);
+  Resampler::Resample(source.pixels.data(), 0, 4, source.stride, Whole(source),
+    dest.pixels.data(), dest.width, dest.height, dest.stride, Resampler::Filter::Box);
+
+  bool untouched = true;
+  for (uint8_t byte : dest.pixels) {
+    untouched &= byte == 0x77;
+  }
+  CHECK(untouched);
+}
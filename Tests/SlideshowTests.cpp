@@ -0,0 +1,413 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/SlideshowTests.cpp
+// The nModules Project
+//
+// Tests for nWallpaper's slideshow, and the playlist and prefetcher it is made of.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nWallpaper/Playlist.hpp"
+#include "../nWallpaper/Prefetcher.hpp"
+#include "../nWallpaper/Slideshow.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace {
+  std::vector<std::wstring> MakeFiles(size_t count) {
+    std::vector<std::wstring> files;
+    for (size_t i = 0; i < count; ++i) {
+      files.push_back(L"file" + std::to_wstring(i));
+    }
+    return files;
+  }
+
+  /// <summary>
+  /// Prepares every file as "prepared:" followed by its name, except files starting with "bad",
+  /// which fail. Preparation blocks while the preparer is held, until it is released or
+  /// cancelled.
+  /// </summary>
+  class FakePreparer : public Prefetcher::IPreparer {
+  public:
+    FakePreparer() : held(false), cancellations(0) {}
+
+    bool Prepare(const std::function<bool()> &cancelled, Prefetcher::Image *image) override {
+      std::unique_lock<std::mutex> lock(mutex);
+      started.push_back(image->source);
+      changed.notify_all();
+      while (held) {
+        if (cancelled()) {
+          ++cancellations;
+          changed.notify_all();
+          return false;
+        }
+        changed.wait_for(lock, std::chrono::milliseconds(1));
+      }
+      if (image->source.compare(0, 3, L"bad") == 0) {
+        return false;
+      }
+      image->path = L"prepared:" + image->source;
+      auto size = sizes.find(image->source);
+      image->bytes = size == sizes.end() ? 100 : size->second;
+      return true;
+    }
+
+    void Discard(const Prefetcher::Image &image) override {
+      std::lock_guard<std::mutex> lock(mutex);
+      discarded.push_back(image.path);
+    }
+
+    void Hold() {
+      std::lock_guard<std::mutex> lock(mutex);
+      held = true;
+    }
+
+    void Release() {
+      std::lock_guard<std::mutex> lock(mutex);
+      held = false;
+      changed.notify_all();
+    }
+
+    bool WaitForStarted(size_t count) {
+      std::unique_lock<std::mutex> lock(mutex);
+      return changed.wait_for(lock, std::chrono::seconds(5), [this, count] () {
+        return started.size() >= count;
+      });
+    }
+
+    bool WaitForCancellations(int count) {
+      std::unique_lock<std::mutex> lock(mutex);
+      return changed.wait_for(lock, std::chrono::seconds(5), [this, count] () {
+        return cancellations >= count;
+      });
+    }
+
+    size_t CountStarted(const std::wstring &source) {
+      std::lock_guard<std::mutex> lock(mutex);
+      return size_t(std::count(started.begin(), started.end(), source));
+    }
+
+    std::vector<std::wstring> GetDiscarded() {
+      std::lock_guard<std::mutex> lock(mutex);
+      return discarded;
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool held;
+    int cancellations;
+    std::map<std::wstring, uint64_t> sizes;
+    std::vector<std::wstring> started;
+    std::vector<std::wstring> discarded;
+  };
+
+  // The prefetcher works through one file at a time, so once a file has been started, the ones
+  // before it have been stored.
+  bool WaitForStarted(FakePreparer &preparer, const std::wstring &source, size_t count) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (preparer.CountStarted(source) < count) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+  }
+
+  bool WaitForIdle(Prefetcher &prefetcher) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!prefetcher.IsIdle()) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+  }
+}
+
+
+TEST(Slideshow, SequentialPlaylistsWrapAround) {
+  Playlist playlist;
+  playlist.SetFiles(MakeFiles(3));
+  CHECK(playlist.GetCurrent() == nullptr);
+  CHECK(playlist.Peek(0) == L"file0");
+  CHECK(playlist.Peek(4) == L"file1");
+  CHECK(playlist.Next() == L"file0");
+  CHECK(playlist.Next() == L"file1");
+  CHECK(playlist.Next() == L"file2");
+  CHECK(playlist.Next() == L"file0");
+  CHECK(*playlist.GetCurrent() == L"file0");
+}
+
+
+TEST(Slideshow, SequentialPlaylistsContinueFromTheCurrentFileWhenItIsKept) {
+  Playlist playlist;
+  playlist.SetFiles(MakeFiles(4));
+  playlist.Next();
+  playlist.Next();
+  CHECK(*playlist.GetCurrent() == L"file1");
+
+  std::vector<std::wstring> files = { L"new", L"file1", L"file3" };
+  playlist.SetFiles(std::move(files));
+  CHECK(*playlist.GetCurrent() == L"file1");
+  CHECK(playlist.Next() == L"file3");
+
+  // Once the current file is gone, the playlist starts over.
+  files = { L"a", L"b" };
+  playlist.SetFiles(std::move(files));
+  CHECK(playlist.GetCurrent() == nullptr);
+  CHECK(playlist.Next() == L"a");
+}
+
+
+TEST(Slideshow, PeekShowsWhatNextReturns) {
+  const Playlist::Order orders[] = {
+    Playlist::Order::Sequential, Playlist::Order::Shuffle, Playlist::Order::Random
+  };
+  for (Playlist::Order order : orders) {
+    Playlist playlist;
+    playlist.SetFiles(MakeFiles(5));
+    playlist.SetOrder(order);
+    playlist.SetSeed(1234);
+    for (int round = 0; round < 20; ++round) {
+      const std::wstring peeked[] = { playlist.Peek(0), playlist.Peek(1), playlist.Peek(7) };
+      CHECK(playlist.Next() == peeked[0]);
+      CHECK(playlist.Peek(0) == peeked[1]);
+      CHECK(playlist.Peek(6) == peeked[2]);
+    }
+  }
+}
+
+
+TEST(Slideshow, ShufflesShowEveryFileOncePerCycle) {
+  Playlist playlist;
+  playlist.SetFiles(MakeFiles(7));
+  playlist.SetOrder(Playlist::Order::Shuffle);
+  playlist.SetSeed(42);
+
+  std::wstring previous;
+  for (int cycle = 0; cycle < 50; ++cycle) {
+    std::set<std::wstring> seen;
+    for (int i = 0; i < 7; ++i) {
+      const std::wstring file = playlist.Next();
+      CHECK(file != previous);
+      seen.insert(file);
+      previous = file;
+    }
+    CHECK_EQUAL(7u, seen.size());
+  }
+}
+
+
+TEST(Slideshow, RandomOrderNeverRepeatsAFileRightAway) {
+  Playlist playlist;
+  playlist.SetFiles(MakeFiles(3));
+  playlist.SetOrder(Playlist::Order::Random);
+  playlist.SetSeed(7);
+
+  std::map<std::wstring, int> counts;
+  std::wstring previous;
+  for (int i = 0; i < 3000; ++i) {
+    const std::wstring file = playlist.Next();
+    CHECK(file != previous);
+    ++counts[file];
+    previous = file;
+  }
+  CHECK_EQUAL(3u, counts.size());
+  for (auto &count : counts) {
+    CHECK(count.second > 800);
+  }
+
+  // With a single file, there is nothing else to pick.
+  playlist.SetFiles(MakeFiles(1));
+  CHECK(playlist.Next() == L"file0");
+  CHECK(playlist.Next() == L"file0");
+}
+
+
+TEST(Slideshow, PrefetcherPreparesUpToTheImageLimit) {
+  FakePreparer preparer;
+  Prefetcher prefetcher(&preparer);
+  prefetcher.SetLimits(2, 1000);
+  prefetcher.SetUpcoming(MakeFiles(5));
+  CHECK(WaitForIdle(prefetcher));
+
+  CHECK_EQUAL(2u, prefetcher.GetPreparedCount());
+  CHECK_EQUAL(200u, prefetcher.GetPreparedBytes());
+  CHECK_EQUAL(0u, preparer.CountStarted(L"file2"));
+
+  Prefetcher::Image image;
+  CHECK(prefetcher.Take(L"file0", &image));
+  CHECK(image.path == L"prepared:file0");
+  CHECK_EQUAL(100u, image.bytes);
+  CHECK_EQUAL(100u, prefetcher.GetPreparedBytes());
+  prefetcher.Discard(image);
+  CHECK(preparer.GetDiscarded() == std::vector<std::wstring>({ L"prepared:file0" }));
+
+  // Taking a file which hasn't been prepared fails.
+  CHECK(!prefetcher.Take(L"file4", &image));
+}
+
+
+TEST(Slideshow, PrefetcherStaysWithinTheByteBudget) {
+  FakePreparer preparer;
+  preparer.sizes[L"file0"] = 600;
+  preparer.sizes[L"file1"] = 300;
+  Prefetcher prefetcher(&preparer);
+  prefetcher.SetLimits(4, 1000);
+  prefetcher.SetUpcoming(MakeFiles(4));
+  CHECK(WaitForIdle(prefetcher));
+
+  // Preparing another one could take 600 more bytes, which wouldn't fit.
+  CHECK_EQUAL(1u, prefetcher.GetPreparedCount());
+  CHECK_EQUAL(600u, prefetcher.GetPreparedBytes());
+
+  // The first image is always prepared, whatever its size.
+  FakePreparer largePreparer;
+  largePreparer.sizes[L"file0"] = 5000;
+  Prefetcher large(&largePreparer);
+  large.SetLimits(4, 1000);
+  large.SetUpcoming(MakeFiles(4));
+  CHECK(WaitForIdle(large));
+  CHECK_EQUAL(1u, large.GetPreparedCount());
+  CHECK_EQUAL(5000u, large.GetPreparedBytes());
+
+  // Taking it makes room for the next.
+  Prefetcher::Image image;
+  CHECK(large.Take(L"file0", &image));
+  CHECK(WaitForIdle(large));
+  CHECK_EQUAL(1u, large.GetPreparedCount());
+  CHECK_EQUAL(1u, largePreparer.CountStarted(L"file1"));
+  large.Discard(image);
+}
+
+
+TEST(Slideshow, PrefetcherDiscardsWhatIsNoLongerUpcoming) {
+  FakePreparer preparer;
+  Prefetcher prefetcher(&preparer);
+  prefetcher.SetLimits(2, 1000);
+  prefetcher.SetUpcoming(MakeFiles(2));
+  CHECK(WaitForIdle(prefetcher));
+
+  std::vector<std::wstring> upcoming = { L"file1", L"other" };
+  prefetcher.SetUpcoming(upcoming);
+  CHECK(WaitForIdle(prefetcher));
+  CHECK(preparer.GetDiscarded() == std::vector<std::wstring>({ L"prepared:file0" }));
+  CHECK_EQUAL(2u, prefetcher.GetPreparedCount());
+  // file1 was kept rather than prepared again.
+  CHECK_EQUAL(1u, preparer.CountStarted(L"file1"));
+}
+
+
+TEST(Slideshow, PrefetcherCancelsWorkWhichIsNoLongerNeeded) {
+  FakePreparer preparer;
+  Prefetcher prefetcher(&preparer);
+  prefetcher.SetLimits(1, 1000);
+
+  preparer.Hold();
+  std::vector<std::wstring> upcoming = { L"slow" };
+  prefetcher.SetUpcoming(upcoming);
+  CHECK(preparer.WaitForStarted(1));
+  upcoming = { L"fast" };
+  prefetcher.SetUpcoming(upcoming);
+  CHECK(preparer.WaitForCancellations(1));
+  preparer.Release();
+  CHECK(WaitForIdle(prefetcher));
+
+  Prefetcher::Image image;
+  CHECK(!prefetcher.Take(L"slow", &image));
+  CHECK(prefetcher.Take(L"fast", &image));
+  prefetcher.Discard(image);
+}
+
+
+TEST(Slideshow, PrefetcherDoesNotRetryFailures) {
+  FakePreparer preparer;
+  Prefetcher prefetcher(&preparer);
+  std::vector<std::wstring> upcoming = { L"bad", L"good" };
+  prefetcher.SetUpcoming(upcoming);
+  CHECK(WaitForIdle(prefetcher));
+  prefetcher.SetUpcoming(upcoming);
+  CHECK(WaitForIdle(prefetcher));
+
+  CHECK_EQUAL(1u, preparer.CountStarted(L"bad"));
+  CHECK_EQUAL(1u, prefetcher.GetPreparedCount());
+  Prefetcher::Image image;
+  CHECK(!prefetcher.Take(L"bad", &image));
+}
+
+
+TEST(Slideshow, PrefetcherDiscardsPreparedImagesWhenDestroyed) {
+  FakePreparer preparer;
+  {
+    Prefetcher prefetcher(&preparer);
+    prefetcher.SetUpcoming(MakeFiles(2));
+    CHECK(WaitForIdle(prefetcher));
+  }
+  CHECK_EQUAL(2u, preparer.GetDiscarded().size());
+}
+
+
+TEST(Slideshow, SwitchesAtTheInterval) {
+  FakePreparer preparer;
+  std::vector<std::wstring> applied;
+  Slideshow slideshow(&preparer, [&applied] (const std::wstring &file) {
+    applied.push_back(file);
+  });
+  slideshow.SetInterval(1000);
+  slideshow.SetFiles(MakeFiles(3));
+
+  CHECK_EQUAL(Slideshow::NEVER, slideshow.Update(0));
+  slideshow.Start(5000);
+  CHECK(slideshow.IsRunning());
+  CHECK_EQUAL(400u, slideshow.Update(5600));
+  CHECK(applied.empty());
+  CHECK_EQUAL(1000u, slideshow.Update(6000));
+  CHECK_EQUAL(1u, applied.size());
+
+  // Changing the interval moves the next switch, relative to the last one.
+  slideshow.SetInterval(500);
+  CHECK_EQUAL(200u, slideshow.Update(6300));
+
+  slideshow.Stop();
+  CHECK_EQUAL(Slideshow::NEVER, slideshow.Update(100000));
+  CHECK_EQUAL(1u, applied.size());
+}
+
+
+TEST(Slideshow, AppliesPreparedImagesAndFreesThePreviousOne) {
+  FakePreparer preparer;
+  std::vector<std::wstring> applied;
+  Slideshow slideshow(&preparer, [&applied] (const std::wstring &file) {
+    applied.push_back(file);
+  });
+  slideshow.SetPrefetch(2, 1000);
+
+  // Nothing has been prepared yet, so the first switch has to use the original.
+  preparer.Hold();
+  slideshow.SetFiles(MakeFiles(3));
+  CHECK(WaitForStarted(preparer, L"file0", 1));
+  slideshow.Next(0);
+  CHECK(applied.back() == L"file0");
+  // It's no longer upcoming, so it's cancelled.
+  CHECK(preparer.WaitForCancellations(1));
+  preparer.Release();
+
+  // The prefetcher moves on to the next two.
+  CHECK(WaitForStarted(preparer, L"file2", 1));
+  slideshow.Next(1);
+  CHECK(applied.back() == L"prepared:file1");
+  CHECK(preparer.GetDiscarded().empty());
+
+  // file0 comes after file2, and was started once before, for the first switch.
+  CHECK(WaitForStarted(preparer, L"file0", 2));
+  slideshow.Next(2);
+  CHECK(applied.back() == L"prepared:file2");
+  CHECK(preparer.GetDiscarded() == std::vector<std::wstring>({ L"prepared:file1" }));
+}
@@ -0,0 +1,240 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/SoftwareCompositorTests.cpp
+// The nModules Project
+//
+// Compares the frames of the software compositor's transitions against golden frames.
+//
+// The golden frames are in Fixtures/SoftwareCompositor. After an intended change to an effect,
+// run the suite with NMODULES_UPDATE_GOLDEN set to write them again, and look them over.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+#include "Fixtures.hpp"
+
+#include "../nDesk/BlendKernels.hpp"
+#include "../nDesk/SoftwareCompositor.hpp"
+
+#include <stdlib.h>
+#include <vector>
+
+typedef SoftwareCompositor::Surface Surface;
+typedef SoftwareCompositor::Transition Transition;
+
+// Small, so that the golden frames stay small, but with partial squares and slats.
+static const uint32_t WIDTH = 48;
+static const uint32_t HEIGHT = 32;
+
+
+/// <summary>
+/// An image which owns its pixels.
+/// </summary>
+struct Image {
+  Image(uint32_t width, uint32_t height) : pixels(size_t(width) * height * 4) {
+    surface.pixels = pixels.data();
+    surface.width = width;
+    surface.height = height;
+    surface.stride = width * 4;
+  }
+
+  uint32_t At(uint32_t x, uint32_t y) const {
+    const uint8_t *pixel = &pixels[(size_t(y) * surface.width + x) * 4];
+    return uint32_t(pixel[0]) | pixel[1] << 8 | pixel[2] << 16 | uint32_t(pixel[3]) << 24;
+  }
+
+  std::vector<uint8_t> pixels;
+  Surface surface;
+};
+
+
+/// <summary>
+/// The old wallpaper is a red and blue gradient, and the new one a green and white checkerboard,
+/// so that every effect is easy to make out in the golden frames.
+/// </summary>
+static void MakeImages(Image &oldImage, Image &newImage) {
+  for (uint32_t y = 0; y < HEIGHT; ++y) {
+    for (uint32_t x = 0; x < WIDTH; ++x) {
+      uint8_t *oldPixel = &oldImage.pixels[(y * WIDTH + x) * 4];
+      oldPixel[0] = uint8_t(y * 255 / (HEIGHT - 1));
+      oldPixel[1] = 0;
+      oldPixel[2] = uint8_t(x * 255 / (WIDTH - 1));
+      oldPixel[3] = 255;
+
+      uint8_t *newPixel = &newImage.pixels[(y * WIDTH + x) * 4];
+      const bool white = (x / 6 + y / 6) % 2 == 0;
+      newPixel[0] = white ? 255 : 0;
+      newPixel[1] = white ? 255 : 160;
+      newPixel[2] = white ? 255 : 0;
+      newPixel[3] = 255;
+    }
+  }
+}
+
+
+/// <summary>
+/// Paints a frame of the transition, and compares it with the golden frame of the given name.
+/// Every instruction set has to give the same frame.
+/// </summary>
+static void CheckGolden(const char *name, const Transition &transition, float progress) {
+  Image oldImage(WIDTH, HEIGHT), newImage(WIDTH, HEIGHT);
+  MakeImages(oldImage, newImage);
+
+  const std::string path = Fixtures::GetPath("SoftwareCompositor/") + name + ".bmp";
+  const BlendKernels::InstructionSet original = BlendKernels::GetInstructionSet();
+  const BlendKernels::InstructionSet instructionSets[] = {
+    BlendKernels::InstructionSet::Scalar,
+    BlendKernels::InstructionSet::SSE2,
+    BlendKernels::InstructionSet::AVX2
+  };
+
+  for (BlendKernels::InstructionSet instructionSet : instructionSets) {
+    BlendKernels::SetInstructionSet(instructionSet);
+    Image frame(WIDTH, HEIGHT);
+    SoftwareCompositor compositor;
+    compositor.SetTransition(transition);
+    compositor.Paint(oldImage.surface, newImage.surface, frame.surface, progress);
+
+    if (getenv("NMODULES_UPDATE_GOLDEN") != nullptr) {
+      CHECK(Fixtures::WriteBitmap(path, WIDTH, HEIGHT, frame.pixels.data()));
+      continue;
+    }
+
+    uint32_t width, height;
+    std::vector<uint8_t> golden;
+    if (!Fixtures::ReadBitmap(path, &width, &height, &golden)) {
+      Test::Fail(__FILE__, __LINE__, "Missing golden frame " + path);
+      break;
+    }
+    CHECK_EQUAL(WIDTH, width);
+    CHECK_EQUAL(HEIGHT, height);
+    if (golden != frame.pixels) {
+      size_t i = 0;
+      while (i < golden.size() && golden[i] == frame.pixels[i]) {
+        ++i;
+      }
+      Test::Fail(__FILE__, __LINE__, std::string(name) + " differs from the golden frame at (" +
+        Test::Describe(i / 4 % WIDTH) + ", " + Test::Describe(i / 4 / WIDTH) + ")" +
+        " with instruction set " + Test::Describe(int(BlendKernels::GetInstructionSet())));
+    }
+  }
+
+  BlendKernels::SetInstructionSet(original);
+}
+
+
+static Transition MakeTransition(SoftwareCompositor::Effect effect) {
+  Transition transition;
+  transition.effect = effect;
+  transition.squareSize = 10;
+  transition.seed = 33;
+  return transition;
+}
+
+
+TEST(SoftwareCompositor, Fade) {
+  Transition transition = MakeTransition(SoftwareCompositor::Effect::Fade);
+  CheckGolden("fade_30", transition, 0.3f);
+}
+
+
+TEST(SoftwareCompositor, Slide) {
+  Transition transition = MakeTransition(SoftwareCompositor::Effect::Slide);
+  transition.direction = SoftwareCompositor::Direction::Left;
+  CheckGolden("slide_both_left_40", transition, 0.4f);
+  transition.direction = SoftwareCompositor::Direction::Down;
+  transition.slideType = SoftwareCompositor::SlideType::New;
+  CheckGolden("slide_new_down_40", transition, 0.4f);
+  transition.direction = SoftwareCompositor::Direction::Right;
+  transition.slideType = SoftwareCompositor::SlideType::Old;
+  CheckGolden("slide_old_right_40", transition, 0.4f);
+  transition.direction = SoftwareCompositor::Direction::Up;
+  transition.slideType = SoftwareCompositor::SlideType::Scan;
+  CheckGolden("scan_up_40", transition, 0.4f);
+}
+
+
+TEST(SoftwareCompositor, Grid) {
+  Transition transition = MakeTransition(SoftwareCompositor::Effect::Grid);
+  CheckGolden("grid_random_50", transition, 0.5f);
+  transition.hideOld = true;
+  CheckGolden("grid_random_hide_50", transition, 0.5f);
+  transition.hideOld = false;
+  transition.gridType = GridSchedule::CLOCKWISE;
+  CheckGolden("grid_clockwise_50", transition, 0.5f);
+  transition.gridType = GridSchedule::TRIANGULAR;
+  CheckGolden("grid_triangular_50", transition, 0.5f);
+}
+
+
+TEST(SoftwareCompositor, Blinds) {
+  Transition transition = MakeTransition(SoftwareCompositor::Effect::Blinds);
+  transition.direction = SoftwareCompositor::Direction::Down;
+  CheckGolden("blinds_down_45", transition, 0.45f);
+  transition.direction = SoftwareCompositor::Direction::Left;
+  CheckGolden("blinds_left_45", transition, 0.45f);
+}
+
+
+TEST(SoftwareCompositor, Circular) {
+  Transition transition = MakeTransition(SoftwareCompositor::Effect::Circular);
+  CheckGolden("circular_50", transition, 0.5f);
+  transition.hideOld = true;
+  CheckGolden("circular_hide_50", transition, 0.5f);
+}
+
+
+TEST(SoftwareCompositor, EndsShowOnlyOneImage) {
+  Image oldImage(WIDTH, HEIGHT), newImage(WIDTH, HEIGHT), frame(WIDTH, HEIGHT);
+  MakeImages(oldImage, newImage);
+
+  const SoftwareCompositor::Effect effects[] = {
+    SoftwareCompositor::Effect::Fade, SoftwareCompositor::Effect::Slide,
+    SoftwareCompositor::Effect::Grid, SoftwareCompositor::Effect::Blinds,
+    SoftwareCompositor::Effect::Circular
+  };
+  for (SoftwareCompositor::Effect effect : effects) {
+    SoftwareCompositor compositor;
+    compositor.SetTransition(MakeTransition(effect));
+    compositor.Paint(oldImage.surface, newImage.surface, frame.surface, 0.0f);
+    CHECK(frame.pixels == oldImage.pixels);
+    compositor.Paint(oldImage.surface, newImage.surface, frame.surface, 1.0f);
+    CHECK(frame.pixels == newImage.pixels);
+    CHECK_EQUAL(2u, compositor.GetFrameStats().frames);
+  }
+}
+
+
+TEST(SoftwareCompositor, FillIsClipped) {
+  Image image(8, 4);
+  SoftwareCompositor::Rect clip = { -2, 1, 3, 10 };
+  SoftwareCompositor::Fill(image.surface, clip, 0xff102030);
+
+  CHECK_EQUAL(0u, image.At(0, 0));
+  CHECK_EQUAL(0xff102030u, image.At(0, 1));
+  CHECK_EQUAL(0xff102030u, image.At(2, 3));
+  CHECK_EQUAL(0u, image.At(3, 1));
+}
+
+
+TEST(SoftwareCompositor, BlitIsClipped) {
+  Image source(4, 4), target(6, 6);
+  for (uint32_t i = 0; i < 16; ++i) {
+    source.pixels[i * 4] = uint8_t(i + 1);
+    source.pixels[i * 4 + 3] = 255;
+  }
+
+  // Hangs off the top left of the target, and is clipped on the right by the clip rect.
+  SoftwareCompositor::Rect clip = { 0, 0, 2, 6 };
+  SoftwareCompositor::Blit(source.surface, target.surface, -1, -2, clip);
+
+  CHECK_EQUAL(0xff000000u | 10, target.At(0, 0));
+  CHECK_EQUAL(0xff000000u | 11, target.At(1, 0));
+  CHECK_EQUAL(0u, target.At(2, 0));
+  CHECK_EQUAL(0xff000000u | 14, target.At(0, 1));
+  CHECK_EQUAL(0u, target.At(0, 2));
+
+  // Entirely outside.
+  Image untouched(6, 6);
+  SoftwareCompositor::Rect everything = { 0, 0, 6, 6 };
+  SoftwareCompositor::Blit(source.surface, untouched.surface, 6, 0, everything);
+  SoftwareCompositor::Blit(source.surface, untouched.surface, 0, -4, everything);
+  CHECK(untouched.pixels == std::vector<uint8_t>(6 * 6 * 4));
+}
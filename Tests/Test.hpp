@@ -0,0 +1,65 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/Test.hpp
+// The nModules Project
+//
+// A minimal unit test harness for the parts of the modules which don't depend on Windows.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <sstream>
+#include <string>
+
+namespace Test {
+  typedef void (*Function)();
+
+  // Adds a test to the list which TestMain runs. Used by the TEST macro.
+  struct Registrar {
+    Registrar(const char *suite, const char *name, Function function);
+  };
+
+  // Reports a failed check. The test keeps running.
+  void Fail(const char *file, int line, const std::string &message);
+
+  template <typename T>
+  std::string Describe(const T &value) {
+    std::ostringstream stream;
+    stream << value;
+    return stream.str();
+  }
+}
+
+/// <summary>
+/// Defines a test. Tests are grouped in suites, which can be run on their own by passing the
+/// suite name to the test runner.
+/// </summary>
+#define TEST(suite, name) \
+  static void suite##_##name(); \
+  static Test::Registrar suite##_##name##_registrar(#suite, #name, suite##_##name); \
+  static void suite##_##name()
+
+#define CHECK(expression) \
+  do { \
+    if (!(expression)) { \
+      Test::Fail(__FILE__, __LINE__, #expression); \
+    } \
+  } while (false)
+
+#define CHECK_EQUAL(expected, actual) \
+  do { \
+    auto &&_expected = (expected); \
+    auto &&_actual = (actual); \
+    if (!(_expected == _actual)) { \
+      Test::Fail(__FILE__, __LINE__, std::string(#actual) + " is " + Test::Describe(_actual) + \
+        ", expected " + Test::Describe(_expected)); \
+    } \
+  } while (false)
+
+#define CHECK_NEAR(expected, actual, tolerance) \
+  do { \
+    double _expected = (expected); \
+    double _actual = (actual); \
+    if (!(_actual >= _expected - (tolerance) && _actual <= _expected + (tolerance))) { \
+      Test::Fail(__FILE__, __LINE__, std::string(#actual) + " is " + Test::Describe(_actual) + \
+        ", expected " + Test::Describe(_expected)); \
+    } \
+  } while (false)
@@ -0,0 +1,67 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/TestMain.cpp
+// The nModules Project
+//
+// Runs the unit tests.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+  struct Case {
+    const char *suite;
+    const char *name;
+    Test::Function function;
+  };
+
+  // Constructed on first use, since the registrars run during static initialization.
+  std::vector<Case> &GetCases() {
+    static std::vector<Case> cases;
+    return cases;
+  }
+
+  int sFailures = 0;
+}
+
+
+Test::Registrar::Registrar(const char *suite, const char *name, Function function) {
+  Case testCase = { suite, name, function };
+  GetCases().push_back(testCase);
+}
+
+
+void Test::Fail(const char *file, int line, const std::string &message) {
+  fprintf(stderr, "%s(%d): check failed: %s\n", file, line, message.c_str());
+  ++sFailures;
+}
+
+
+/// <summary>
+/// Runs every test, or only those of the suites given on the command line.
+/// </summary>
+int main(int argc, char **argv) {
+  int run = 0, failed = 0;
+  for (const Case &testCase : GetCases()) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; ++i) {
+      selected = selected || strcmp(argv[i], testCase.suite) == 0;
+    }
+    if (!selected) {
+      continue;
+    }
+
+    int failuresBefore = sFailures;
+    testCase.function();
+    ++run;
+    if (sFailures != failuresBefore) {
+      fprintf(stderr, "FAILED %s.%s\n", testCase.suite, testCase.name);
+      ++failed;
+    }
+  }
+
+  printf("%d tests, %d failed\n", run, failed);
+  return run == 0 || failed != 0 ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/TextLayoutCacheTests.cpp
+// The nModules Project
+//
+// Tests for the text layout cache, with a fake shaper.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+#include "FakeTextShaper.hpp"
+
+#include "../nShared/TextLayoutCache.hpp"
+
+
+TEST(TextLayoutCache, IdenticalRequestsShareALayout) {
+  FakeTextShaper shaper;
+  TextLayoutCache cache(&shaper, 1 << 20);
+  int format;
+
+  TextLayoutCache::LayoutPtr first = cache.Get(L"Hello", &format, 100, 20);
+  TextLayoutCache::LayoutPtr second = cache.Get(L"Hello", &format, 100, 20);
+
+  CHECK(first != nullptr);
+  CHECK(first == second);
+  CHECK_EQUAL(1, shaper.created);
+  CHECK_EQUAL(size_t(1), cache.GetHits());
+  CHECK_EQUAL(size_t(1), cache.GetMisses());
+}
+
+
+TEST(TextLayoutCache, EveryPartOfTheKeyMatters) {
+  FakeTextShaper shaper;
+  TextLayoutCache cache(&shaper, 1 << 20);
+  int format, otherFormat;
+
+  cache.Get(L"Hello", &format, 100, 20);
+  cache.Get(L"Hello!", &format, 100, 20);
+  cache.Get(L"Hello", &otherFormat, 100, 20);
+  cache.Get(L"Hello", &format, 101, 20);
+  cache.Get(L"Hello", &format, 100, 21);
+
+  CHECK_EQUAL(5, shaper.created);
+  CHECK_EQUAL(size_t(5), cache.GetCount());
+}
+
+
+TEST(TextLayoutCache, EvictsTheLeastRecentlyUsed) {
+  FakeTextShaper shaper;
+  shaper.cost = 1000;
+  int format;
+  TextLayoutCache cache(&shaper, 0);
+  cache.Get(L"a", &format, 10, 10);
+  size_t entryCost = cache.GetCost();
+  cache.SetBudget(3 * entryCost);
+
+  cache.Get(L"b", &format, 10, 10);
+  cache.Get(L"c", &format, 10, 10);
+  // Touch a, so that b is the oldest.
+  cache.Get(L"a", &format, 10, 10);
+  cache.Get(L"d", &format, 10, 10);
+
+  CHECK_EQUAL(size_t(3), cache.GetCount());
+  CHECK(cache.GetCost() <= 3 * entryCost);
+  int created = shaper.created;
+  cache.Get(L"a", &format, 10, 10);
+  cache.Get(L"c", &format, 10, 10);
+  cache.Get(L"d", &format, 10, 10);
+  CHECK_EQUAL(created, shaper.created);
+  cache.Get(L"b", &format, 10, 10);
+  CHECK_EQUAL(created + 1, shaper.created);
+}
+
+
+TEST(TextLayoutCache, KeepsTheNewestEntryWhenOverBudget) {
+  FakeTextShaper shaper;
+  shaper.cost = 1 << 20;
+  int format;
+  TextLayoutCache cache(&shaper, 100);
+
+  cache.Get(L"a", &format, 10, 10);
+  cache.Get(L"b", &format, 10, 10);
+
+  CHECK_EQUAL(size_t(1), cache.GetCount());
+  cache.Get(L"b", &format, 10, 10);
+  CHECK_EQUAL(size_t(1), cache.GetHits());
+}
+
+
+TEST(TextLayoutCache, EvictedLayoutsLiveOnWhileInUse) {
+  FakeTextShaper shaper;
+  int format;
+  TextLayoutCache cache(&shaper, 1 << 20);
+
+  TextLayoutCache::LayoutPtr layout = cache.Get(L"a", &format, 10, 10);
+  cache.Clear();
+
+  CHECK_EQUAL(size_t(0), cache.GetCount());
+  CHECK_EQUAL(size_t(0), cache.GetCost());
+  CHECK_EQUAL(1, shaper.alive);
+  float width, height;
+  layout->GetSize(&width, &height);
+  CHECK_NEAR(10, width, 0.001);
+
+  layout.reset();
+  CHECK_EQUAL(0, shaper.alive);
+}
+
+
+TEST(TextLayoutCache, PurgeOnlyDropsTheFormat) {
+  FakeTextShaper shaper;
+  int format, otherFormat;
+  TextLayoutCache cache(&shaper, 1 << 20);
+
+  cache.Get(L"a", &format, 10, 10);
+  cache.Get(L"b", &otherFormat, 10, 10);
+  size_t cost = cache.GetCost();
+  cache.Purge(&format);
+
+  CHECK_EQUAL(size_t(1), cache.GetCount());
+  CHECK(cache.GetCost() < cost);
+  cache.Get(L"b", &otherFormat, 10, 10);
+  CHECK_EQUAL(size_t(1), cache.GetHits());
+}
+
+
+TEST(TextLayoutCache, FailedLayoutsAreNotCached) {
+  FakeTextShaper shaper;
+  shaper.fail = true;
+  int format;
+  TextLayoutCache cache(&shaper, 1 << 20);
+
+  CHECK(cache.Get(L"a", &format, 10, 10) == nullptr);
+  CHECK_EQUAL(size_t(0), cache.GetCount());
+  CHECK_EQUAL(size_t(0), cache.GetCost());
+}
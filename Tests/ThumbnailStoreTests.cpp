@@ -0,0 +1,264 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/ThumbnailStoreTests.cpp
+// The nModules Project
+//
+// Tests for nCore's persistent thumbnail store, on storage held in memory.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "MemoryThumbnailStorage.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+  const uint64_t CAPACITY = 4 << 20;
+
+  ThumbnailStore::Key MakeKey(int file, uint32_t iconSize = 48) {
+    ThumbnailStore::Key key = {
+      L"C:\\Users\\Someone\\Desktop\\File " + std::to_wstring(file) + L".txt",
+      uint64_t(1000 + file), uint64_t(file * 7), iconSize
+    };
+    return key;
+  }
+
+  std::vector<uint8_t> MakePixels(int file, uint32_t size) {
+    std::vector<uint8_t> pixels(size_t(size) * size * 4);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+      pixels[i] = uint8_t(file * 31 + i);
+    }
+    return pixels;
+  }
+
+  bool Insert(ThumbnailStore &store, int file, uint32_t size = 48) {
+    std::vector<uint8_t> pixels = MakePixels(file, size);
+    return store.Insert(MakeKey(file, size), size, size, pixels.data());
+  }
+
+  // Whether the store holds the right thumbnail for the file.
+  bool Holds(ThumbnailStore &store, int file, uint32_t size = 48) {
+    uint32_t width, height;
+    std::vector<uint8_t> pixels;
+    return store.Lookup(MakeKey(file, size), &width, &height, &pixels) && width == size
+      && height == size && pixels == MakePixels(file, size);
+  }
+}
+
+
+TEST(ThumbnailStore, LooksUpWhatWasInserted) {
+  MemoryThumbnailStorage storage;
+  ThumbnailStore store(&storage, CAPACITY);
+  CHECK(store.Open());
+  CHECK_EQUAL(size_t(0), store.GetCount());
+
+  for (int i = 0; i < 20; ++i) {
+    CHECK(Insert(store, i));
+  }
+  CHECK_EQUAL(size_t(20), store.GetCount());
+  CHECK(Holds(store, 0));
+  CHECK(Holds(store, 19));
+  CHECK(!Holds(store, 20));
+}
+
+
+TEST(ThumbnailStore, EveryPartOfTheKeyCounts) {
+  MemoryThumbnailStorage storage;
+  ThumbnailStore store(&storage, CAPACITY);
+  store.Open();
+  Insert(store, 1);
+
+  uint32_t width, height;
+  std::vector<uint8_t> pixels;
+  ThumbnailStore::Key key = MakeKey(1);
+  key.modifiedTime++;
+  CHECK(!store.Lookup(key, &width, &height, &pixels));
+
+  key = MakeKey(1);
+  key.fileSize++;
+  CHECK(!store.Lookup(key, &width, &height, &pixels));
+
+  key = MakeKey(1);
+  key.iconSize = 32;
+  CHECK(!store.Lookup(key, &width, &height, &pixels));
+
+  key = MakeKey(1);
+  key.path += L"x";
+  CHECK(!store.Lookup(key, &width, &height, &pixels));
+
+  // Sizes are kept apart.
+  CHECK(Insert(store, 1, 32));
+  CHECK(Holds(store, 1, 32));
+  CHECK(Holds(store, 1, 48));
+}
+
+
+TEST(ThumbnailStore, RejectsThumbnailsItCantHold) {
+  MemoryThumbnailStorage storage;
+  ThumbnailStore store(&storage, 64 << 10);
+
+  // Not open yet.
+  CHECK(!Insert(store, 1));
+
+  store.Open();
+  std::vector<uint8_t> pixels(4);
+  CHECK(!store.Insert(MakeKey(1), 0, 1, pixels.data()));
+
+  // More than a quarter of the capacity.
+  CHECK(!Insert(store, 1, 96));
+  CHECK(Insert(store, 1, 48));
+}
+
+
+TEST(ThumbnailStore, ReopensFromTheIndex) {
+  MemoryThumbnailStorage storage;
+  {
+    ThumbnailStore store(&storage, CAPACITY);
+    store.Open();
+    for (int i = 0; i < 50; ++i) {
+      Insert(store, i);
+    }
+    store.Flush();
+  }
+  CHECK(storage.hasIndex);
+
+  ThumbnailStore store(&storage, CAPACITY);
+  CHECK(store.Open());
+  CHECK_EQUAL(size_t(50), store.GetCount());
+  for (int i = 0; i < 50; ++i) {
+    CHECK(Holds(store, i));
+  }
+}
+
+
+TEST(ThumbnailStore, RecoversWhatWasAddedAfterTheIndex) {
+  MemoryThumbnailStorage storage;
+  {
+    ThumbnailStore store(&storage, CAPACITY);
+    store.Open();
+    for (int i = 0; i < 10; ++i) {
+      Insert(store, i);
+    }
+    store.Flush();
+    for (int i = 10; i < 15; ++i) {
+      Insert(store, i);
+    }
+  }
+
+  ThumbnailStore store(&storage, CAPACITY);
+  CHECK(store.Open());
+  CHECK_EQUAL(size_t(15), store.GetCount());
+  CHECK(Holds(store, 12));
+}
+
+
+TEST(ThumbnailStore, RecoversWithoutAnIndex) {
+  MemoryThumbnailStorage storage;
+  {
+    ThumbnailStore store(&storage, CAPACITY);
+    store.Open();
+    for (int i = 0; i < 10; ++i) {
+      Insert(store, i);
+    }
+    store.Flush();
+  }
+
+  // A broken index is as good as none.
+  storage.index.assign(77, 1);
+
+  ThumbnailStore store(&storage, CAPACITY);
+  CHECK(store.Open());
+  CHECK_EQUAL(size_t(10), store.GetCount());
+  CHECK(Holds(store, 9));
+}
+
+
+TEST(ThumbnailStore, CutsOffATornTail) {
+  MemoryThumbnailStorage storage;
+  uint64_t size;
+  {
+    ThumbnailStore store(&storage, CAPACITY);
+    store.Open();
+    for (int i = 0; i < 10; ++i) {
+      Insert(store, i);
+    }
+    size = store.GetDataSize();
+
+    // Half of the last record again, as if the process died while appending it. All of the
+    // records are the same length, and follow a 16 byte file header.
+    const size_t length = size_t(size - 16) / 10;
+    std::vector<uint8_t> record(storage.data.end() - length, storage.data.end());
+    storage.data.insert(storage.data.end(), record.begin(), record.begin() + length / 2);
+  }
+
+  ThumbnailStore store(&storage, CAPACITY);
+  CHECK(store.Open());
+  CHECK_EQUAL(size_t(10), store.GetCount());
+  CHECK_EQUAL(size, storage.GetDataSize());
+  CHECK(Insert(store, 10));
+  CHECK(Holds(store, 10));
+}
+
+
+TEST(ThumbnailStore, FailedAppendsLeaveNothingBehind) {
+  MemoryThumbnailStorage storage;
+  ThumbnailStore store(&storage, CAPACITY);
+  store.Open();
+  Insert(store, 1);
+  const uint64_t size = storage.GetDataSize();
+
+  storage.failAppends = true;
+  CHECK(!Insert(store, 2));
+  CHECK_EQUAL(size, storage.GetDataSize());
+  CHECK(!Holds(store, 2));
+
+  storage.failAppends = false;
+  CHECK(Insert(store, 2));
+  CHECK(Holds(store, 1));
+  CHECK(Holds(store, 2));
+}
+
+
+TEST(ThumbnailStore, KeepsTheMostRecentlyUsedWithinTheCap) {
+  const uint64_t capacity = 1 << 20;
+  MemoryThumbnailStorage storage;
+  size_t count;
+  {
+    ThumbnailStore store(&storage, capacity);
+    store.Open();
+    for (int i = 0; i < 400; ++i) {
+      CHECK(Insert(store, i));
+      // Keeps the first one in use.
+      CHECK(Holds(store, 0));
+      CHECK(store.GetDataSize() <= capacity);
+    }
+    CHECK(Holds(store, 399));
+    CHECK(!Holds(store, 1));
+    count = store.GetCount();
+    CHECK(count < 400);
+    store.Flush();
+  }
+
+  // The compacted file reopens from its index.
+  ThumbnailStore store(&storage, capacity);
+  CHECK(store.Open());
+  CHECK_EQUAL(count, store.GetCount());
+  CHECK(Holds(store, 0));
+  CHECK(Holds(store, 399));
+}
+
+
+TEST(ThumbnailStore, CompactsOnRequest) {
+  MemoryThumbnailStorage storage;
+  ThumbnailStore store(&storage, CAPACITY);
+  store.Open();
+  for (int i = 0; i < 10; ++i) {
+    Insert(store, i);
+  }
+  CHECK(Holds(store, 3));
+
+  // Only room for about one record.
+  store.Compact(12 << 10);
+  CHECK_EQUAL(size_t(1), store.GetCount());
+  CHECK(Holds(store, 3));
+  CHECK_EQUAL(storage.GetDataSize(), store.GetDataSize());
+}
@@ -0,0 +1,171 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/TileGridTests.cpp
+// The nModules Project
+//
+// Tests for the spatial index which nIcon's rectangle selection uses, against looking at every
+// tile.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nIcon/TileGrid.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+  typedef TileGrid<int> Grid;
+
+  Grid::Rect MakeRect(int left, int top, int width, int height) {
+    Grid::Rect rect = { left, top, left + width, top + height };
+    return rect;
+  }
+
+  // Returns the values found in the area, in order, with any repeats.
+  std::vector<int> Find(const Grid &grid, const Grid::Rect &area) {
+    std::vector<int> found;
+    grid.FindInRect(area, [&found] (int value) { found.push_back(value); });
+    std::sort(found.begin(), found.end());
+    return found;
+  }
+
+  // Does the same by looking at every tile.
+  std::vector<int> BruteForce(const std::map<int, Grid::Rect> &tiles, const Grid::Rect &area) {
+    std::vector<int> found;
+    for (auto &tile : tiles) {
+      const Grid::Rect &rect = tile.second;
+      if (std::max(rect.left, area.left) < std::min(rect.right, area.right)
+          && std::max(rect.top, area.top) < std::min(rect.bottom, area.bottom)) {
+        found.push_back(tile.first);
+      }
+    }
+    return found;
+  }
+
+  // A tile somewhere around the origin, which doesn't necessarily line up with the cells.
+  Grid::Rect RandomTile(std::mt19937 &random) {
+    return MakeRect(int(random() % 1200) - 400, int(random() % 900) - 300, 20 + random() % 90,
+      20 + random() % 90);
+  }
+
+  Grid::Rect RandomArea(std::mt19937 &random) {
+    return MakeRect(int(random() % 1400) - 500, int(random() % 1100) - 400, random() % 600,
+      random() % 500);
+  }
+}
+
+
+TEST(TileGrid, FindsTilesInARect) {
+  Grid grid;
+  grid.Reset(80, 60);
+
+  // Tiles the size of a cell, laid out on the grid, with spacing.
+  grid.Insert(1, MakeRect(0, 0, 70, 50));
+  grid.Insert(2, MakeRect(80, 0, 70, 50));
+  grid.Insert(3, MakeRect(0, 60, 70, 50));
+  grid.Insert(4, MakeRect(-80, -60, 70, 50));
+
+  CHECK(Find(grid, MakeRect(10, 10, 10, 10)) == std::vector<int>({ 1 }));
+  CHECK(Find(grid, MakeRect(60, 40, 30, 30)) == std::vector<int>({ 1, 2, 3 }));
+  CHECK(Find(grid, MakeRect(-100, -100, 400, 400)) == std::vector<int>({ 1, 2, 3, 4 }));
+
+  // Only in the spacing.
+  CHECK(Find(grid, MakeRect(71, 51, 8, 8)).empty());
+
+  // Touching an edge isn't enough.
+  CHECK(Find(grid, MakeRect(70, 0, 10, 10)).empty());
+  CHECK(Find(grid, MakeRect(-10, -10, 10, 10)).empty());
+  CHECK(Find(grid, MakeRect(-11, -11, 2, 2)) == std::vector<int>({ 4 }));
+
+  // Empty areas don't find anything.
+  CHECK(Find(grid, MakeRect(10, 10, 0, 10)).empty());
+  CHECK(Find(grid, MakeRect(10, 10, 10, 0)).empty());
+}
+
+
+TEST(TileGrid, MovesAndRemovesTiles) {
+  Grid grid;
+  grid.Reset(80, 60);
+  grid.Insert(1, MakeRect(0, 0, 70, 50));
+  grid.Insert(2, MakeRect(40, 30, 70, 50));
+
+  grid.Move(1, MakeRect(0, 0, 70, 50), MakeRect(500, 500, 70, 50));
+  CHECK(Find(grid, MakeRect(0, 0, 30, 30)).empty());
+  CHECK(Find(grid, MakeRect(0, 0, 50, 40)) == std::vector<int>({ 2 }));
+  CHECK(Find(grid, MakeRect(510, 510, 1, 1)) == std::vector<int>({ 1 }));
+
+  grid.Remove(2, MakeRect(40, 30, 70, 50));
+  CHECK(Find(grid, MakeRect(0, 0, 200, 200)).empty());
+
+  // Cells which become empty are let go of.
+  grid.Remove(1, MakeRect(500, 500, 70, 50));
+  CHECK_EQUAL(size_t(0), grid.GetCellCount());
+}
+
+
+TEST(TileGrid, ReportsTilesOnce) {
+  // Tiles larger than a cell, and areas covering many cells.
+  Grid grid;
+  grid.Reset(16, 16);
+  grid.Insert(1, MakeRect(-40, -40, 100, 100));
+  grid.Insert(2, MakeRect(5, 5, 3, 3));
+
+  CHECK(Find(grid, MakeRect(-100, -100, 300, 300)) == std::vector<int>({ 1, 2 }));
+  CHECK(Find(grid, MakeRect(30, -20, 50, 5)) == std::vector<int>({ 1 }));
+  CHECK(Find(grid, MakeRect(0, 0, 16, 16)) == std::vector<int>({ 1, 2 }));
+}
+
+
+TEST(TileGrid, MatchesABruteForceScan) {
+  std::mt19937 random(46);
+  const int cellSizes[][2] = { { 80, 60 }, { 7, 13 }, { 1, 1 }, { 500, 500 } };
+
+  for (const int *cellSize : cellSizes) {
+    Grid grid;
+    grid.Reset(cellSize[0], cellSize[1]);
+    std::map<int, Grid::Rect> tiles;
+    int nextValue = 0;
+    bool same = true;
+
+    for (int step = 0; step < 600; ++step) {
+      unsigned action = random() % 10;
+      if (action < 4 || tiles.empty()) {
+        Grid::Rect rect = RandomTile(random);
+        grid.Insert(nextValue, rect);
+        tiles[nextValue++] = rect;
+      } else if (action < 6) {
+        auto tile = std::next(tiles.begin(), random() % tiles.size());
+        Grid::Rect rect = RandomTile(random);
+        grid.Move(tile->first, tile->second, rect);
+        tile->second = rect;
+      } else if (action < 7) {
+        auto tile = std::next(tiles.begin(), random() % tiles.size());
+        grid.Remove(tile->first, tile->second);
+        tiles.erase(tile);
+      } else {
+        Grid::Rect area = RandomArea(random);
+        same &= Find(grid, area) == BruteForce(tiles, area);
+      }
+    }
+    CHECK(same);
+  }
+}
+
+
+TEST(TileGrid, ResetEmptiesTheGrid) {
+  Grid grid;
+  grid.Reset(10, 10);
+  grid.Insert(1, MakeRect(0, 0, 50, 50));
+  CHECK(grid.GetCellCount() > 0);
+
+  grid.Reset(20, 20);
+  CHECK_EQUAL(size_t(0), grid.GetCellCount());
+  CHECK(Find(grid, MakeRect(0, 0, 50, 50)).empty());
+
+  // Cells can't be less than a pixel.
+  grid.Reset(0, -5);
+  grid.Insert(1, MakeRect(0, 0, 3, 2));
+  CHECK_EQUAL(size_t(6), grid.GetCellCount());
+}
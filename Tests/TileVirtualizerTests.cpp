@@ -0,0 +1,203 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/TileVirtualizerTests.cpp
+// The nModules Project
+//
+// Tests for how nIcon hands out tiles to the items near the visible area: that tiles are reused,
+// that only so many are kept around, and that items keep their selection while off screen.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nIcon/TileVirtualizer.hpp"
+
+#include <vector>
+
+namespace {
+  /// <summary>
+  /// Stands in for a tile window, and counts how many are alive.
+  /// </summary>
+  class FakeTile {
+  public:
+    explicit FakeTile(int item)
+      : item(item)
+      , selected(false)
+      , ghosted(false)
+      , visible(true)
+    {
+      ++sAlive;
+    }
+
+    ~FakeTile() {
+      --sAlive;
+    }
+
+    bool IsSelected() { return selected; }
+    bool IsGhosted() { return ghosted; }
+    void Select() { selected = true; }
+    void Deselect() { selected = false; }
+    void SetGhost() { ghosted = true; }
+    void Show() { visible = true; }
+    void Hide() { visible = false; }
+
+    // Switches the tile over to another item, as Tile::SetItem does.
+    void SetItem(int newItem) {
+      item = newItem;
+      selected = false;
+      ghosted = false;
+    }
+
+  public:
+    int item;
+    bool selected;
+    bool ghosted;
+    bool visible;
+
+    static int sAlive;
+  };
+
+  int FakeTile::sAlive = 0;
+
+  typedef TileVirtualizer<FakeTile> Virtualizer;
+
+  struct Item : Virtualizer::Slot {
+    explicit Item(int id) : id(id) {}
+    int id;
+  };
+
+  /// <summary>
+  /// Materializes an item, counting the tiles which had to be created.
+  /// </summary>
+  FakeTile *Materialize(Virtualizer &tiles, Item &item, int *created = nullptr) {
+    return tiles.Materialize(item, [&item, created] () {
+      if (created) {
+        ++*created;
+      }
+      return new FakeTile(item.id);
+    }, [&item] (FakeTile *tile) {
+      tile->SetItem(item.id);
+    });
+  }
+}
+
+
+TEST(TileVirtualizer, ReusesTilesOfItemsWhichWentOutOfView) {
+  {
+    Virtualizer tiles(4);
+    Item a(1), b(2);
+    int created = 0;
+
+    FakeTile *tile = Materialize(tiles, a, &created);
+    CHECK(a.tile == tile);
+    CHECK_EQUAL(1, tile->item);
+    CHECK_EQUAL(1, created);
+
+    tiles.Dematerialize(a);
+    CHECK(a.tile == nullptr);
+    CHECK(!tile->visible);
+    CHECK_EQUAL(size_t(1), tiles.GetSpareCount());
+
+    CHECK(Materialize(tiles, b, &created) == tile);
+    CHECK_EQUAL(1, created);
+    CHECK_EQUAL(2, tile->item);
+    CHECK(tile->visible);
+    CHECK_EQUAL(size_t(0), tiles.GetSpareCount());
+
+    // Without spares, tiles are created.
+    Materialize(tiles, a, &created);
+    CHECK_EQUAL(2, created);
+
+    tiles.Destroy(a);
+    tiles.Destroy(b);
+    CHECK(a.tile == nullptr);
+  }
+  CHECK_EQUAL(0, FakeTile::sAlive);
+}
+
+
+TEST(TileVirtualizer, KeepsOnlySoManySpareTiles) {
+  {
+    Virtualizer tiles(3);
+    std::vector<Item> items;
+    for (int i = 0; i < 10; ++i) {
+      items.emplace_back(i);
+    }
+    for (Item &item : items) {
+      Materialize(tiles, item);
+    }
+    CHECK_EQUAL(10, FakeTile::sAlive);
+
+    // The whole view scrolls away.
+    for (Item &item : items) {
+      tiles.Dematerialize(item);
+    }
+    CHECK_EQUAL(size_t(3), tiles.GetSpareCount());
+    CHECK_EQUAL(3, FakeTile::sAlive);
+
+    // And back. Only the tiles which weren't kept are created again.
+    int created = 0;
+    for (Item &item : items) {
+      Materialize(tiles, item, &created);
+    }
+    CHECK_EQUAL(7, created);
+    CHECK_EQUAL(10, FakeTile::sAlive);
+
+    for (Item &item : items) {
+      tiles.Destroy(item);
+    }
+  }
+  CHECK_EQUAL(0, FakeTile::sAlive);
+}
+
+
+TEST(TileVirtualizer, ItemsKeepTheirStateWithoutATile) {
+  Virtualizer tiles(1);
+  Item selected(1), ghosted(2), plain(3);
+
+  Materialize(tiles, selected)->Select();
+  Materialize(tiles, ghosted)->SetGhost();
+  Materialize(tiles, plain);
+  tiles.Dematerialize(selected);
+  tiles.Dematerialize(ghosted);
+  tiles.Dematerialize(plain);
+  CHECK(selected.selected && !selected.ghosted);
+  CHECK(!ghosted.selected && ghosted.ghosted);
+  CHECK(tiles.IsSelected(selected));
+  CHECK(!tiles.IsSelected(ghosted));
+
+  // The spare tile was selected when it was put away. Whoever gets it next starts over.
+  FakeTile *tile = Materialize(tiles, plain);
+  CHECK(!tile->selected && !tile->ghosted);
+
+  CHECK(Materialize(tiles, selected)->selected);
+  CHECK(Materialize(tiles, ghosted)->ghosted);
+
+  tiles.Destroy(selected);
+  tiles.Destroy(ghosted);
+  tiles.Destroy(plain);
+}
+
+
+TEST(TileVirtualizer, SelectsItemsWithOrWithoutATile) {
+  Virtualizer tiles(0);
+  Item onScreen(1), offScreen(2);
+  Materialize(tiles, onScreen);
+
+  tiles.SetSelected(onScreen, true);
+  tiles.SetSelected(offScreen, true);
+  CHECK(onScreen.tile->selected);
+  CHECK(tiles.IsSelected(onScreen));
+  CHECK(tiles.IsSelected(offScreen));
+
+  // With no room for spares, tiles are deleted right away.
+  tiles.Dematerialize(onScreen);
+  CHECK_EQUAL(0, FakeTile::sAlive);
+  CHECK(tiles.IsSelected(onScreen));
+
+  tiles.SetSelected(onScreen, false);
+  CHECK(!Materialize(tiles, onScreen)->selected);
+  CHECK(Materialize(tiles, offScreen)->selected);
+  tiles.SetSelected(offScreen, false);
+  CHECK(!tiles.IsSelected(offScreen));
+
+  tiles.Destroy(onScreen);
+  tiles.Destroy(offScreen);
+}
@@ -0,0 +1,261 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/TimerWheelTests.cpp
+// The nModules Project
+//
+// Tests for the timer wheel of the Rewrite's nCore, against a simple reference model.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../Rewrite/nCore/TimerWheel.hpp"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+  // Records the timers which fire.
+  class Recorder : public TimerWheel::ICallback {
+  public:
+    void OnTimer(TimerWheel::TimerId id, void *context) override {
+      fired.push_back(id);
+      contexts.push_back(context);
+    }
+
+    std::vector<TimerWheel::TimerId> fired;
+    std::vector<void*> contexts;
+  };
+
+  /// <summary>
+  /// What the wheel should do, worked out the slow and obvious way.
+  /// </summary>
+  class Model {
+  public:
+    struct Timer {
+      uint64_t expiry;
+      uint32_t interval;
+    };
+
+    void Add(TimerWheel::TimerId id, uint64_t now, uint32_t interval) {
+      Timer timer = { std::max(now, mNow) + std::max(interval, 1u), std::max(interval, 1u) };
+      mTimers[id] = timer;
+    }
+
+    void Remove(TimerWheel::TimerId id) {
+      mTimers.erase(id);
+    }
+
+    // Returns the expiries of the timers which fire, by id.
+    std::map<TimerWheel::TimerId, uint64_t> Advance(uint64_t now) {
+      std::map<TimerWheel::TimerId, uint64_t> fired;
+      for (auto &entry : mTimers) {
+        Timer &timer = entry.second;
+        if (timer.expiry <= now) {
+          fired[entry.first] = timer.expiry;
+          // Missed intervals are skipped.
+          timer.expiry += ((now - timer.expiry) / timer.interval + 1) * timer.interval;
+        }
+      }
+      mNow = std::max(mNow, now);
+      return fired;
+    }
+
+    uint64_t GetNextExpiry() const {
+      uint64_t earliest = TimerWheel::NO_WAKEUP;
+      for (auto &entry : mTimers) {
+        earliest = std::min(earliest, entry.second.expiry);
+      }
+      return earliest;
+    }
+
+    std::vector<TimerWheel::TimerId> GetIds() const {
+      std::vector<TimerWheel::TimerId> ids;
+      for (auto &entry : mTimers) {
+        ids.push_back(entry.first);
+      }
+      return ids;
+    }
+
+    explicit Model(uint64_t now) : mNow(now) {}
+
+  private:
+    uint64_t mNow;
+    std::map<TimerWheel::TimerId, Timer> mTimers;
+  };
+
+  uint64_t ExpectedWakeup(const Model &model, uint32_t slack) {
+    uint64_t expiry = model.GetNextExpiry();
+    return expiry == TimerWheel::NO_WAKEUP ? TimerWheel::NO_WAKEUP : expiry + slack;
+  }
+}
+
+
+TEST(TimerWheel, EmptyWheelNeverWakesUp) {
+  TimerWheel wheel(1000, 10);
+  CHECK_EQUAL(TimerWheel::NO_WAKEUP, wheel.GetNextWakeup());
+}
+
+
+TEST(TimerWheel, RepeatingTimerFiresEveryInterval) {
+  TimerWheel wheel(1000, 0);
+  Recorder recorder;
+  int context;
+  TimerWheel::TimerId id = wheel.Add(1000, 100, &context);
+  CHECK(id != 0);
+  CHECK_EQUAL(uint64_t(1100), wheel.GetNextWakeup());
+
+  wheel.Advance(1099, &recorder);
+  CHECK(recorder.fired.empty());
+
+  wheel.Advance(1100, &recorder);
+  CHECK_EQUAL(size_t(1), recorder.fired.size());
+  CHECK(recorder.contexts[0] == &context);
+  CHECK_EQUAL(uint64_t(1200), wheel.GetNextWakeup());
+}
+
+
+TEST(TimerWheel, SlackDelaysTheWakeup) {
+  TimerWheel wheel(0, 0);
+  wheel.Add(0, 50, nullptr);
+  CHECK_EQUAL(uint64_t(50), wheel.GetNextWakeup());
+  wheel.SetSlack(20);
+  CHECK_EQUAL(uint64_t(70), wheel.GetNextWakeup());
+}
+
+
+TEST(TimerWheel, MissedIntervalsAreSkipped) {
+  TimerWheel wheel(0, 0);
+  Recorder recorder;
+  wheel.Add(0, 10, nullptr);
+
+  wheel.Advance(55, &recorder);
+  CHECK_EQUAL(size_t(1), recorder.fired.size());
+  CHECK_EQUAL(uint64_t(60), wheel.GetNextWakeup());
+}
+
+
+TEST(TimerWheel, RemovedTimersDontFire) {
+  TimerWheel wheel(0, 0);
+  Recorder recorder;
+  TimerWheel::TimerId id = wheel.Add(0, 10, nullptr);
+  wheel.Remove(id);
+  CHECK(!wheel.IsActive(id));
+  wheel.Advance(100, &recorder);
+  CHECK(recorder.fired.empty());
+
+  // Removing twice has no effect, and a stale id doesn't remove the timer reusing its slot.
+  wheel.Remove(id);
+  TimerWheel::TimerId reused = wheel.Add(100, 10, nullptr);
+  wheel.Remove(id);
+  CHECK(wheel.IsActive(reused));
+}
+
+
+TEST(TimerWheel, TimersFireInOrderOfExpiry) {
+  TimerWheel wheel(0, 0);
+  Recorder recorder;
+  TimerWheel::TimerId late = wheel.Add(0, 5000, nullptr);
+  TimerWheel::TimerId early = wheel.Add(0, 70, nullptr);
+  TimerWheel::TimerId middle = wheel.Add(0, 300, nullptr);
+
+  wheel.Advance(5000, &recorder);
+  CHECK(recorder.fired.size() == 3);
+  CHECK(recorder.fired[0] == early);
+  CHECK(recorder.fired[1] == middle);
+  CHECK(recorder.fired[2] == late);
+}
+
+
+TEST(TimerWheel, LongIntervalsDontHideShortOnes) {
+  // Timers further away than the wheel covers are parked in the last slot of the top level. Once
+  // time moves on, that slot comes before slots holding earlier timers, which used to be hidden.
+  const uint64_t topSlot = 64 * 64 * 64;
+  TimerWheel wheel(0, 0);
+  Recorder recorder;
+  wheel.Add(0, 4000000000u, nullptr);
+  wheel.Advance(10 * topSlot, &recorder);
+  TimerWheel::TimerId id = wheel.Add(10 * topSlot, 60 * topSlot, nullptr);
+
+  CHECK_EQUAL(70 * topSlot, wheel.GetNextWakeup());
+  wheel.Advance(70 * topSlot, &recorder);
+  CHECK(recorder.fired.size() == 1 && recorder.fired[0] == id);
+}
+
+
+TEST(TimerWheel, TheWheelCanFillUp) {
+  TimerWheel wheel(0, 0);
+  int added = 0;
+  while (wheel.Add(0, 1000, nullptr) != 0) {
+    ++added;
+  }
+  CHECK_EQUAL(65535, added);
+}
+
+
+TEST(TimerWheel, MatchesTheModel) {
+  std::mt19937_64 random(28);
+  for (int round = 0; round < 200; ++round) {
+    const uint32_t slack = uint32_t(random() % 50);
+    uint64_t now = random() % 200000000;
+    TimerWheel wheel(now, slack);
+    Model model(now);
+    Recorder recorder;
+
+    for (int step = 0; step < 400; ++step) {
+      switch (random() % 6) {
+      case 0:
+      case 1:
+        {
+          // Mostly short intervals, some of them beyond what the wheel covers.
+          static const uint32_t limits[] = { 100, 10000, 1000000, 100000000, 4000000000u };
+          uint32_t interval = uint32_t(random() % limits[random() % 5]);
+          TimerWheel::TimerId id = wheel.Add(now, interval, nullptr);
+          model.Add(id, now, interval);
+        }
+        break;
+
+      case 2:
+        {
+          std::vector<TimerWheel::TimerId> ids = model.GetIds();
+          if (!ids.empty()) {
+            TimerWheel::TimerId id = ids[random() % ids.size()];
+            wheel.Remove(id);
+            model.Remove(id);
+            CHECK(!wheel.IsActive(id));
+          }
+        }
+        break;
+
+      default:
+        {
+          // Either up to the next wakeup, like the OS timer does, or some way beyond it.
+          uint64_t wakeup = wheel.GetNextWakeup();
+          if (wakeup != TimerWheel::NO_WAKEUP && random() % 2 == 0) {
+            now = std::max(now, wakeup);
+          } else {
+            static const uint64_t steps[] = { 10, 1000, 100000, 10000000, 1000000000 };
+            now += random() % steps[random() % 5];
+          }
+
+          std::map<TimerWheel::TimerId, uint64_t> expected = model.Advance(now);
+          recorder.fired.clear();
+          wheel.Advance(now, &recorder);
+
+          CHECK_EQUAL(expected.size(), recorder.fired.size());
+          uint64_t previous = 0;
+          for (TimerWheel::TimerId id : recorder.fired) {
+            auto expiry = expected.find(id);
+            CHECK(expiry != expected.end());
+            if (expiry != expected.end()) {
+              CHECK(expiry->second >= previous);
+              previous = expiry->second;
+            }
+          }
+        }
+        break;
+      }
+
+      CHECK_EQUAL(ExpectedWakeup(model, slack), wheel.GetNextWakeup());
+    }
+  }
+}
@@ -0,0 +1,326 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/WallpaperDiskCacheTests.cpp
+// The nModules Project
+//
+// Tests for the disk cache which nDesk paints the wallpaper from at startup: that wallpapers read
+// back as they were written, straight from the mapping, and that anything stale or damaged is
+// thrown away rather than drawn.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../Rewrite/nDesk/WallpaperDiskCache.hpp"
+
+#include <map>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <wchar.h>
+
+namespace {
+  // Where the fields are in the header.
+  const size_t KEY_END = 72;
+  const size_t WIDTH_OFFSET = 104;
+  const size_t TILE_OFFSET = 112;
+
+  /// <summary>
+  /// Keeps the files in memory. Mappings point straight at the stored bytes.
+  /// </summary>
+  class MemoryStorage : public WallpaperDiskCache::IStorage {
+  public:
+    class Mapping : public WallpaperDiskCache::IMapping {
+    public:
+      explicit Mapping(const std::vector<uint8_t> &data) : mData(data) {}
+
+      const uint8_t *GetData() const override {
+        return mData.data();
+      }
+
+      uint64_t GetSize() const override {
+        return mData.size();
+      }
+
+    private:
+      const std::vector<uint8_t> &mData;
+    };
+
+  public:
+    std::unique_ptr<WallpaperDiskCache::IMapping> Map(const std::wstring &name) override {
+      ++maps;
+      auto file = files.find(name);
+      if (file == files.end()) {
+        return nullptr;
+      }
+      return std::unique_ptr<WallpaperDiskCache::IMapping>(new Mapping(file->second));
+    }
+
+    bool Write(const std::wstring &name, const void *header, size_t headerSize, const void *data,
+        size_t dataSize) override {
+      std::vector<uint8_t> &file = files[name];
+      file.assign((const uint8_t*)header, (const uint8_t*)header + headerSize);
+      file.insert(file.end(), (const uint8_t*)data, (const uint8_t*)data + dataSize);
+      return true;
+    }
+
+    void Delete(const std::wstring &name) override {
+      files.erase(name);
+    }
+
+    void Prune(const wchar_t *extension, uint32_t maxFiles) override {
+      pruneExtension = extension;
+      pruneLimit = maxFiles;
+    }
+
+  public:
+    std::map<std::wstring, std::vector<uint8_t>> files;
+    int maps = 0;
+    std::wstring pruneExtension;
+    uint32_t pruneLimit = 0;
+  };
+
+  WallpaperDiskCache::Key MakeKey() {
+    WallpaperDiskCache::Key key = {
+      L"C:\\Wallpapers\\Mountains.jpg", 131000000000000000ULL, 2500000, 4,
+      { 0, 0, 2560, 1440 }, { -1920, 0, 2560, 1440 }
+    };
+    return key;
+  }
+
+  WallpaperDiskCache::Placement MakePlacement(uint32_t width, uint32_t height) {
+    WallpaperDiskCache::Placement placement = {
+      { 12.5f, 0.0f, 6000.25f, 3456.0f }, width, height, { 0, -10, 2560, 1450 }, false
+    };
+    return placement;
+  }
+
+  std::vector<uint8_t> MakePixels(uint32_t width, uint32_t height) {
+    std::vector<uint8_t> pixels(size_t(width) * height * 4);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+      pixels[i] = uint8_t(i * 7 + i / 256);
+    }
+    return pixels;
+  }
+
+  // Stores a 16x8 wallpaper for MakeKey, and returns the name of its file.
+  std::wstring StoreOne(WallpaperDiskCache &cache, MemoryStorage &storage) {
+    std::vector<uint8_t> pixels = MakePixels(16, 8);
+    cache.Store(MakeKey(), MakePlacement(16, 8), pixels.data());
+    CHECK_EQUAL(size_t(1), storage.files.size());
+    return storage.files.begin()->first;
+  }
+
+  bool Loads(WallpaperDiskCache &cache, const WallpaperDiskCache::Key &key) {
+    WallpaperDiskCache::Placement placement;
+    const uint8_t *pixels = nullptr;
+    return cache.Load(key, &placement, &pixels) != nullptr;
+  }
+}
+
+
+TEST(WallpaperDiskCache, RoundTripsStraightFromTheMapping) {
+  MemoryStorage storage;
+  WallpaperDiskCache cache;
+  cache.SetStorage(&storage);
+
+  std::vector<uint8_t> pixels = MakePixels(16, 8);
+  WallpaperDiskCache::Placement stored = MakePlacement(16, 8);
+  stored.tile = true;
+  cache.Store(MakeKey(), stored, pixels.data());
+
+  CHECK_EQUAL(size_t(1), storage.files.size());
+  const std::wstring name = storage.files.begin()->first;
+  CHECK(name == WallpaperDiskCache::GetFileName(MakeKey()));
+  CHECK_EQUAL(WallpaperDiskCache::HEADER_SIZE + pixels.size(), storage.files[name].size());
+
+  WallpaperDiskCache::Placement placement;
+  const uint8_t *loaded = nullptr;
+  std::unique_ptr<WallpaperDiskCache::IMapping> mapping =
+    cache.Load(MakeKey(), &placement, &loaded);
+  CHECK(mapping != nullptr);
+  if (mapping == nullptr) {
+    return;
+  }
+
+  // The pixels are used where they are mapped, rather than copied out.
+  CHECK(loaded == storage.files[name].data() + WallpaperDiskCache::HEADER_SIZE);
+  CHECK(memcmp(pixels.data(), loaded, pixels.size()) == 0);
+
+  CHECK_EQUAL(16u, placement.width);
+  CHECK_EQUAL(8u, placement.height);
+  CHECK(placement.tile);
+  for (int i = 0; i < 4; ++i) {
+    CHECK_EQUAL(stored.region[i], placement.region[i]);
+    CHECK_EQUAL(stored.target[i], placement.target[i]);
+  }
+}
+
+
+TEST(WallpaperDiskCache, StoringAgainReplacesTheFile) {
+  MemoryStorage storage;
+  WallpaperDiskCache cache;
+  cache.SetStorage(&storage);
+  StoreOne(cache, storage);
+
+  std::vector<uint8_t> pixels = MakePixels(4, 4);
+  cache.Store(MakeKey(), MakePlacement(4, 4), pixels.data());
+  CHECK_EQUAL(size_t(1), storage.files.size());
+
+  WallpaperDiskCache::Placement placement;
+  const uint8_t *loaded = nullptr;
+  CHECK(cache.Load(MakeKey(), &placement, &loaded) != nullptr);
+  CHECK_EQUAL(4u, placement.width);
+  CHECK(memcmp(pixels.data(), loaded, pixels.size()) == 0);
+}
+
+
+TEST(WallpaperDiskCache, DoesNothingWithoutStorage) {
+  MemoryStorage storage;
+  WallpaperDiskCache cache;
+  std::vector<uint8_t> pixels = MakePixels(16, 8);
+  cache.Store(MakeKey(), MakePlacement(16, 8), pixels.data());
+  CHECK(!Loads(cache, MakeKey()));
+  cache.Prune(4);
+
+  // Turning the cache off again.
+  cache.SetStorage(&storage);
+  StoreOne(cache, storage);
+  cache.SetStorage(nullptr);
+  CHECK(!Loads(cache, MakeKey()));
+  CHECK_EQUAL(0, storage.maps);
+  CHECK_EQUAL(size_t(1), storage.files.size());
+}
+
+
+TEST(WallpaperDiskCache, StaleKeysMiss) {
+  MemoryStorage storage;
+  WallpaperDiskCache cache;
+  cache.SetStorage(&storage);
+  StoreOne(cache, storage);
+  CHECK(Loads(cache, MakeKey()));
+
+  // Paths are case insensitive.
+  WallpaperDiskCache::Key key = MakeKey();
+  key.file = L"c:\\WALLPAPERS\\mountains.JPG";
+  CHECK(Loads(cache, key));
+
+  // Anything else which changes the pixels misses.
+  std::vector<WallpaperDiskCache::Key> stale(7, MakeKey());
+  stale[0].file = L"C:\\Wallpapers\\Lakes.jpg";
+  stale[1].modifiedTime += 1;
+  stale[2].fileSize += 1;
+  stale[3].position = 3;
+  stale[4].monitor[2] = 1920;
+  stale[5].desktop[0] = 0;
+  stale[6].file = L"C:\\Wallpapers\\Mountains.jpg ";
+  for (const WallpaperDiskCache::Key &staleKey : stale) {
+    CHECK(!Loads(cache, staleKey));
+  }
+
+  // Misses leave the file which is still good alone.
+  CHECK_EQUAL(size_t(1), storage.files.size());
+  CHECK(Loads(cache, MakeKey()));
+}
+
+
+TEST(WallpaperDiskCache, FilesForAnotherKeyAreDeleted) {
+  // As if two keys hashed to the same name.
+  MemoryStorage storage;
+  WallpaperDiskCache cache;
+  cache.SetStorage(&storage);
+  const std::wstring name = StoreOne(cache, storage);
+
+  WallpaperDiskCache::Key other = MakeKey();
+  other.modifiedTime += 1;
+  const std::wstring otherName = WallpaperDiskCache::GetFileName(other);
+  CHECK(otherName != name);
+  storage.files[otherName] = storage.files[name];
+
+  CHECK(!Loads(cache, other));
+  CHECK_EQUAL(size_t(0), storage.files.count(otherName));
+  CHECK(Loads(cache, MakeKey()));
+}
+
+
+TEST(WallpaperDiskCache, DamagedHeadersAreRejected) {
+  MemoryStorage storage;
+  WallpaperDiskCache cache;
+  cache.SetStorage(&storage);
+  const std::wstring name = StoreOne(cache, storage);
+  const std::vector<uint8_t> good = storage.files[name];
+
+  // The magic, the version, the header size, and every field of the key, including the hash of
+  // the path, and then the size of the pixels.
+  std::vector<size_t> checked;
+  for (size_t i = 0; i < KEY_END; ++i) {
+    checked.push_back(i);
+  }
+  for (size_t i = WIDTH_OFFSET; i < TILE_OFFSET; ++i) {
+    checked.push_back(i);
+  }
+
+  for (size_t offset : checked) {
+    storage.files[name] = good;
+    storage.files[name][offset] ^= 0x01;
+    CHECK(!Loads(cache, MakeKey()));
+    CHECK_EQUAL(size_t(0), storage.files.count(name));
+  }
+
+  storage.files[name] = good;
+  CHECK(Loads(cache, MakeKey()));
+}
+
+
+TEST(WallpaperDiskCache, TruncatedOrExtendedFilesAreRejected) {
+  MemoryStorage storage;
+  WallpaperDiskCache cache;
+  cache.SetStorage(&storage);
+  const std::wstring name = StoreOne(cache, storage);
+  const std::vector<uint8_t> good = storage.files[name];
+
+  const size_t sizes[] = {
+    0, 1, WallpaperDiskCache::HEADER_SIZE - 1, WallpaperDiskCache::HEADER_SIZE,
+    good.size() - 4, good.size() - 1, good.size() + 1, good.size() + 4
+  };
+  for (size_t size : sizes) {
+    std::vector<uint8_t> resized = good;
+    resized.resize(size);
+    storage.files[name] = resized;
+    CHECK(!Loads(cache, MakeKey()));
+    CHECK_EQUAL(size_t(0), storage.files.count(name));
+  }
+}
+
+
+TEST(WallpaperDiskCache, EmptyWallpapersAreRejected) {
+  MemoryStorage storage;
+  WallpaperDiskCache cache;
+  cache.SetStorage(&storage);
+
+  cache.Store(MakeKey(), MakePlacement(0, 8), nullptr);
+  CHECK(!Loads(cache, MakeKey()));
+  CHECK(storage.files.empty());
+}
+
+
+TEST(WallpaperDiskCache, FileNamesDependOnlyOnTheKey) {
+  WallpaperDiskCache::Key key = MakeKey();
+  const std::wstring name = WallpaperDiskCache::GetFileName(key);
+  CHECK_EQUAL(size_t(16) + wcslen(WallpaperDiskCache::FILE_EXTENSION), name.size());
+  CHECK(name.compare(16, std::wstring::npos, WallpaperDiskCache::FILE_EXTENSION) == 0);
+  CHECK(name.find_first_not_of(L"0123456789abcdef") == 16);
+
+  key.file = L"c:\\wallpapers\\mountains.jpg";
+  CHECK(name == WallpaperDiskCache::GetFileName(key));
+  key.position = 0;
+  CHECK(name != WallpaperDiskCache::GetFileName(key));
+}
+
+
+TEST(WallpaperDiskCache, PruneKeepsOnlyCacheFiles) {
+  MemoryStorage storage;
+  WallpaperDiskCache cache;
+  cache.SetStorage(&storage);
+  cache.Prune(16);
+  CHECK(storage.pruneExtension == WallpaperDiskCache::FILE_EXTENSION);
+  CHECK_EQUAL(16u, storage.pruneLimit);
+}
@@ -0,0 +1,268 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/WallpaperLoaderTests.cpp
+// The nModules Project
+//
+// Tests for nDesk's wallpaper loader, with a decoder the tests can hold up.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nDesk/WallpaperLoader.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+  /// <summary>
+  /// Decodes every request to a 1 pixel wide image, as high as the path is long. Decoding blocks
+  /// while the decoder is held, until it is released or the request is cancelled.
+  /// </summary>
+  class FakeDecoder : public WallpaperLoader::IDecoder {
+  public:
+    FakeDecoder() : held(false), cancellations(0) {}
+
+    bool Decode(const WallpaperLoader::Request &request, const std::function<bool()> &cancelled,
+        WallpaperLoader::Image *image) override {
+      std::unique_lock<std::mutex> lock(mutex);
+      started.push_back(request.path);
+      changed.notify_all();
+      while (held) {
+        if (cancelled()) {
+          ++cancellations;
+          changed.notify_all();
+          return false;
+        }
+        changed.wait_for(lock, std::chrono::milliseconds(1));
+      }
+      if (request.path.empty()) {
+        return false;
+      }
+      image->width = 1;
+      image->height = uint32_t(request.path.size());
+      image->pixels.assign(4 * request.path.size(), 0xFF);
+      image->frameCount = 1;
+      return true;
+    }
+
+    void Hold() {
+      std::lock_guard<std::mutex> lock(mutex);
+      held = true;
+    }
+
+    void Release() {
+      std::lock_guard<std::mutex> lock(mutex);
+      held = false;
+      changed.notify_all();
+    }
+
+    // Waits for the decoder to have started count requests.
+    bool WaitForStarted(size_t count) {
+      std::unique_lock<std::mutex> lock(mutex);
+      return changed.wait_for(lock, std::chrono::seconds(5), [this, count] () {
+        return started.size() >= count;
+      });
+    }
+
+    bool WaitForCancellations(int count) {
+      std::unique_lock<std::mutex> lock(mutex);
+      return changed.wait_for(lock, std::chrono::seconds(5), [this, count] () {
+        return cancellations >= count;
+      });
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool held;
+    int cancellations;
+    std::vector<std::wstring> started;
+  };
+
+  /// <summary>
+  /// Counts the loader's ready notifications.
+  /// </summary>
+  class ReadyCounter {
+  public:
+    ReadyCounter() : count(0) {}
+
+    void Notify() {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++count;
+      changed.notify_all();
+    }
+
+    bool WaitFor(int expected) {
+      std::unique_lock<std::mutex> lock(mutex);
+      return changed.wait_for(lock, std::chrono::seconds(5), [this, expected] () {
+        return count >= expected;
+      });
+    }
+
+    int Get() {
+      std::lock_guard<std::mutex> lock(mutex);
+      return count;
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    int count;
+  };
+
+  WallpaperLoader::Request MakeRequest(const wchar_t *path, int style) {
+    WallpaperLoader::Request request;
+    request.path = path;
+    request.style = style;
+    request.tile = false;
+    request.monitorWidth = 1920;
+    request.monitorHeight = 1080;
+    request.desktopWidth = 3840;
+    request.desktopHeight = 1080;
+    return request;
+  }
+}
+
+
+TEST(WallpaperLoader, DeliversTheDecodedImage) {
+  FakeDecoder decoder;
+  ReadyCounter ready;
+  WallpaperLoader loader(&decoder, [&ready] () { ready.Notify(); });
+
+  WallpaperLoader::Image image;
+  CHECK(!loader.TakeResult(&image));
+
+  loader.Load(MakeRequest(L"abc", 10));
+  CHECK(ready.WaitFor(1));
+  CHECK(!loader.IsLoading());
+  CHECK(loader.TakeResult(&image));
+  CHECK_EQUAL(1u, image.width);
+  CHECK_EQUAL(3u, image.height);
+  CHECK_EQUAL(12u, image.pixels.size());
+  CHECK_EQUAL(10, image.style);
+  CHECK(!image.tile);
+
+  // The result can only be taken once.
+  CHECK(!loader.TakeResult(&image));
+}
+
+
+TEST(WallpaperLoader, FailuresDeliverAnEmptyImage) {
+  FakeDecoder decoder;
+  ReadyCounter ready;
+  WallpaperLoader loader(&decoder, [&ready] () { ready.Notify(); });
+
+  WallpaperLoader::Request request = MakeRequest(L"", 2);
+  request.tile = true;
+  loader.Load(request);
+  CHECK(ready.WaitFor(1));
+
+  WallpaperLoader::Image image;
+  CHECK(loader.TakeResult(&image));
+  CHECK_EQUAL(0u, image.width);
+  CHECK(image.pixels.empty());
+  // The style still comes through, so the desktop can paint its background color correctly.
+  CHECK_EQUAL(2, image.style);
+  CHECK(image.tile);
+}
+
+
+TEST(WallpaperLoader, NewRequestsSupersedeTheOneBeingDecoded) {
+  FakeDecoder decoder;
+  ReadyCounter ready;
+  WallpaperLoader loader(&decoder, [&ready] () { ready.Notify(); });
+
+  decoder.Hold();
+  loader.Load(MakeRequest(L"first", 0));
+  CHECK(decoder.WaitForStarted(1));
+  CHECK(loader.IsLoading());
+
+  loader.Load(MakeRequest(L"second wallpaper", 6));
+  CHECK(decoder.WaitForCancellations(1));
+  decoder.Release();
+  CHECK(ready.WaitFor(1));
+
+  WallpaperLoader::Image image;
+  CHECK(loader.TakeResult(&image));
+  CHECK_EQUAL(16u, image.height);
+  CHECK_EQUAL(6, image.style);
+  CHECK_EQUAL(1, ready.Get());
+  CHECK_EQUAL(2u, decoder.started.size());
+}
+
+
+TEST(WallpaperLoader, OnlyTheLatestOfManyRequestsIsDelivered) {
+  FakeDecoder decoder;
+  ReadyCounter ready;
+  WallpaperLoader loader(&decoder, [&ready] () { ready.Notify(); });
+
+  decoder.Hold();
+  loader.Load(MakeRequest(L"a", 0));
+  CHECK(decoder.WaitForStarted(1));
+  // Requests which arrive while the worker is busy replace each other without being decoded.
+  loader.Load(MakeRequest(L"bb", 0));
+  loader.Load(MakeRequest(L"ccc", 0));
+  loader.Load(MakeRequest(L"dddd", 0));
+  decoder.Release();
+  CHECK(ready.WaitFor(1));
+
+  WallpaperLoader::Image image;
+  CHECK(loader.TakeResult(&image));
+  CHECK_EQUAL(4u, image.height);
+  CHECK(decoder.started.size() <= 2u);
+  CHECK(decoder.started.back() == L"dddd");
+}
+
+
+TEST(WallpaperLoader, CancelDropsTheRequest) {
+  FakeDecoder decoder;
+  ReadyCounter ready;
+  WallpaperLoader loader(&decoder, [&ready] () { ready.Notify(); });
+
+  decoder.Hold();
+  loader.Load(MakeRequest(L"cancelled", 0));
+  CHECK(decoder.WaitForStarted(1));
+  loader.Cancel();
+  CHECK(decoder.WaitForCancellations(1));
+  decoder.Release();
+
+  // A later request still goes through, and is the only one delivered.
+  loader.Load(MakeRequest(L"xy", 0));
+  CHECK(ready.WaitFor(1));
+  WallpaperLoader::Image image;
+  CHECK(loader.TakeResult(&image));
+  CHECK_EQUAL(2u, image.height);
+  CHECK_EQUAL(1, ready.Get());
+}
+
+
+TEST(WallpaperLoader, LoadingDiscardsAnUntakenResult) {
+  FakeDecoder decoder;
+  ReadyCounter ready;
+  WallpaperLoader loader(&decoder, [&ready] () { ready.Notify(); });
+
+  loader.Load(MakeRequest(L"old", 0));
+  CHECK(ready.WaitFor(1));
+
+  decoder.Hold();
+  loader.Load(MakeRequest(L"newer", 0));
+  WallpaperLoader::Image image;
+  CHECK(!loader.TakeResult(&image));
+  decoder.Release();
+  CHECK(ready.WaitFor(2));
+  CHECK(loader.TakeResult(&image));
+  CHECK_EQUAL(5u, image.height);
+}
+
+
+TEST(WallpaperLoader, DestructionCancelsTheDecode) {
+  FakeDecoder decoder;
+  int readyCount = 0;
+  {
+    WallpaperLoader loader(&decoder, [&readyCount] () { ++readyCount; });
+    decoder.Hold();
+    loader.Load(MakeRequest(L"never", 0));
+    CHECK(decoder.WaitForStarted(1));
+  }
+  CHECK_EQUAL(1, decoder.cancellations);
+  CHECK_EQUAL(0, readyCount);
+}
@@ -0,0 +1,384 @@
+//-------------------------------------------------------------------------------------------------
+// /Tests/WorkerPoolTests.cpp
+// The nModules Project
+//
+// Tests for nCore's worker pool and completion queue, with fake jobs.
+//-------------------------------------------------------------------------------------------------
+#include "Test.hpp"
+
+#include "../nCore/CompletionQueue.hpp"
+#include "../nCore/WorkerPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+  typedef WorkerPool::Priority Priority;
+
+  /// <summary>
+  /// Blocks the jobs which wait on it until it is opened.
+  /// </summary>
+  class Gate {
+  public:
+    Gate() : mOpen(false), mWaiting(0) {}
+
+    void Wait() {
+      std::unique_lock<std::mutex> lock(mMutex);
+      ++mWaiting;
+      mChanged.notify_all();
+      mChanged.wait(lock, [this] () { return mOpen; });
+    }
+
+    void Open() {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mOpen = true;
+      mChanged.notify_all();
+    }
+
+    // Waits for count jobs to be blocked on the gate.
+    bool WaitForWaiting(int count) {
+      std::unique_lock<std::mutex> lock(mMutex);
+      return mChanged.wait_for(lock, std::chrono::seconds(5), [this, count] () {
+        return mWaiting >= count;
+      });
+    }
+
+  private:
+    std::mutex mMutex;
+    std::condition_variable mChanged;
+    bool mOpen;
+    int mWaiting;
+  };
+
+  /// <summary>
+  /// Records the order jobs ran or were discarded in.
+  /// </summary>
+  class Log {
+  public:
+    void Add(int value) {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mValues.push_back(value);
+      mChanged.notify_all();
+    }
+
+    bool WaitForCount(size_t count) {
+      std::unique_lock<std::mutex> lock(mMutex);
+      return mChanged.wait_for(lock, std::chrono::seconds(5), [this, count] () {
+        return mValues.size() >= count;
+      });
+    }
+
+    std::vector<int> Get() {
+      std::lock_guard<std::mutex> lock(mMutex);
+      return mValues;
+    }
+
+  private:
+    std::mutex mMutex;
+    std::condition_variable mChanged;
+    std::vector<int> mValues;
+  };
+}
+
+
+TEST(WorkerPool, RunsEveryJob) {
+  Log log;
+  WorkerPool pool(4);
+  CHECK_EQUAL(size_t(4), pool.GetThreadCount());
+
+  for (int i = 0; i < 100; ++i) {
+    pool.Submit(Priority::Offscreen, WorkerPool::CancellationToken(), [&log, i] () { log.Add(i); });
+  }
+  CHECK(log.WaitForCount(100));
+
+  std::vector<int> values = log.Get();
+  std::sort(values.begin(), values.end());
+  for (int i = 0; i < 100; ++i) {
+    CHECK_EQUAL(i, values[i]);
+  }
+}
+
+
+TEST(WorkerPool, CallsTheThreadHooksOnEveryThread) {
+  std::atomic<int> started(0), exited(0);
+  {
+    WorkerPool pool(3, [&started] () { ++started; }, [&exited] () { ++exited; });
+    Log log;
+    pool.Submit(Priority::Visible, WorkerPool::CancellationToken(), [&log] () { log.Add(0); });
+    CHECK(log.WaitForCount(1));
+  }
+  CHECK_EQUAL(3, started.load());
+  CHECK_EQUAL(3, exited.load());
+}
+
+
+TEST(WorkerPool, HigherPrioritiesRunFirst) {
+  Gate gate;
+  Log log;
+  WorkerPool pool(1);
+
+  // Hold up the only thread while the jobs are queued.
+  pool.Submit(Priority::Visible, WorkerPool::CancellationToken(), [&gate] () { gate.Wait(); });
+  CHECK(gate.WaitForWaiting(1));
+
+  WorkerPool::CancellationToken token;
+  pool.Submit(Priority::Prefetch, token, [&log] () { log.Add(5); });
+  pool.Submit(Priority::Offscreen, token, [&log] () { log.Add(3); });
+  pool.Submit(Priority::Prefetch, token, [&log] () { log.Add(6); });
+  pool.Submit(Priority::Visible, token, [&log] () { log.Add(1); });
+  pool.Submit(Priority::Offscreen, token, [&log] () { log.Add(4); });
+  pool.Submit(Priority::Visible, token, [&log] () { log.Add(2); });
+  CHECK_EQUAL(size_t(6), pool.GetPendingCount());
+
+  gate.Open();
+  CHECK(log.WaitForCount(6));
+
+  // Within a priority, jobs run in the order they were submitted.
+  std::vector<int> expected = { 1, 2, 3, 4, 5, 6 };
+  CHECK(log.Get() == expected);
+  CHECK_EQUAL(size_t(0), pool.GetPendingCount());
+}
+
+
+TEST(WorkerPool, HigherPrioritiesAreTakenFromOtherThreadsFirst) {
+  Gate first, second;
+  Log log;
+  WorkerPool pool(2);
+
+  pool.Submit(Priority::Visible, WorkerPool::CancellationToken(), [&first] () { first.Wait(); });
+  CHECK(first.WaitForWaiting(1));
+  pool.Submit(Priority::Visible, WorkerPool::CancellationToken(), [&second] () { second.Wait(); });
+  CHECK(second.WaitForWaiting(1));
+
+  // Alternates between the two queues, so that both of them hold prefetch jobs, and only one of
+  // them the visible job.
+  WorkerPool::CancellationToken token;
+  pool.Submit(Priority::Prefetch, token, [&log] () { log.Add(2); });
+  pool.Submit(Priority::Prefetch, token, [&log] () { log.Add(2); });
+  pool.Submit(Priority::Prefetch, token, [&log] () { log.Add(2); });
+  pool.Submit(Priority::Visible, token, [&log] () { log.Add(1); });
+
+  // Whichever thread this frees, it finds the visible job before any prefetch job.
+  first.Open();
+  CHECK(log.WaitForCount(4));
+  std::vector<int> values = log.Get();
+  CHECK_EQUAL(1, values[0]);
+  second.Open();
+}
+
+
+TEST(WorkerPool, IdleThreadsStealWork) {
+  Gate gate;
+  Log log;
+  WorkerPool pool(2);
+
+  pool.Submit(Priority::Visible, WorkerPool::CancellationToken(), [&gate] () { gate.Wait(); });
+  CHECK(gate.WaitForWaiting(1));
+
+  // Half of these go to the queue of the thread which is held up. The other thread has to take
+  // them all.
+  for (int i = 0; i < 10; ++i) {
+    pool.Submit(Priority::Offscreen, WorkerPool::CancellationToken(), [&log, i] () { log.Add(i); });
+  }
+  CHECK(log.WaitForCount(10));
+  CHECK(pool.GetStolenCount() >= 5);
+
+  gate.Open();
+}
+
+
+TEST(WorkerPool, CancelledJobsAreDiscarded) {
+  Gate gate;
+  Log log;
+  WorkerPool pool(1);
+
+  pool.Submit(Priority::Visible, WorkerPool::CancellationToken(), [&gate] () { gate.Wait(); });
+  CHECK(gate.WaitForWaiting(1));
+
+  WorkerPool::CancellationToken cancelled, kept;
+  pool.Submit(Priority::Visible, cancelled, [&log] () { log.Add(1); }, [&log] () { log.Add(-1); });
+  pool.Submit(Priority::Visible, kept, [&log] () { log.Add(2); }, [&log] () { log.Add(-2); });
+
+  // Copies of a token share the flag.
+  WorkerPool::CancellationToken copy = cancelled;
+  copy.Cancel();
+  CHECK(cancelled.IsCancelled());
+  CHECK(!kept.IsCancelled());
+
+  gate.Open();
+  CHECK(log.WaitForCount(2));
+  std::vector<int> expected = { -1, 2 };
+  CHECK(log.Get() == expected);
+}
+
+
+TEST(WorkerPool, ShutdownDiscardsJobsWhichHaveNotStarted) {
+  Gate gate;
+  Log log;
+  WorkerPool pool(1);
+
+  pool.Submit(Priority::Visible, WorkerPool::CancellationToken(), [&gate, &log] () {
+    gate.Wait();
+    log.Add(0);
+  });
+  CHECK(gate.WaitForWaiting(1));
+  pool.Submit(Priority::Prefetch, WorkerPool::CancellationToken(), [&log] () { log.Add(1); },
+    [&log] () { log.Add(-1); });
+
+  // Shutdown waits for the running job.
+  std::thread opener([&gate] () {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    gate.Open();
+  });
+  pool.Shutdown();
+  opener.join();
+
+  std::vector<int> expected = { 0, -1 };
+  CHECK(log.Get() == expected);
+
+  // Jobs submitted afterwards never run.
+  pool.Submit(Priority::Visible, WorkerPool::CancellationToken(), [&log] () { log.Add(2); },
+    [&log] () { log.Add(-2); });
+  expected.push_back(-2);
+  CHECK(log.Get() == expected);
+}
+
+
+TEST(WorkerPool, EveryJobRunsOrIsDiscardedExactlyOnceUnderLoad) {
+  const int submitters = 8;
+  const int jobsPerSubmitter = 2000;
+  const int total = submitters * jobsPerSubmitter;
+
+  std::unique_ptr<std::atomic<int>[]> counts(new std::atomic<int>[total]);
+  for (int i = 0; i < total; ++i) {
+    counts[i] = 0;
+  }
+  std::atomic<int> ran(0), discarded(0);
+
+  {
+    WorkerPool pool(4);
+    std::vector<std::thread> threads;
+    for (int s = 0; s < submitters; ++s) {
+      threads.emplace_back([&, s] () {
+        std::mt19937 random(s);
+        std::vector<WorkerPool::CancellationToken> tokens;
+        for (int j = 0; j < jobsPerSubmitter; ++j) {
+          const int id = s * jobsPerSubmitter + j;
+          WorkerPool::CancellationToken token;
+          pool.Submit(Priority(random() % unsigned(Priority::Count)), token,
+            [&, id] () { ++counts[id]; ++ran; },
+            [&, id] () { ++counts[id]; ++discarded; });
+          if (random() % 4 == 0) {
+            tokens.push_back(token);
+          }
+          if (tokens.size() > 8) {
+            tokens[random() % tokens.size()].Cancel();
+            tokens.clear();
+          }
+        }
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+  }
+
+  CHECK_EQUAL(total, ran.load() + discarded.load());
+  int wrong = 0;
+  for (int i = 0; i < total; ++i) {
+    if (counts[i] != 1) {
+      ++wrong;
+    }
+  }
+  CHECK_EQUAL(0, wrong);
+}
+
+
+TEST(CompletionQueue, OnlyTheFirstResultWakesTheReceiver) {
+  CompletionQueue<int> queue;
+  CHECK(queue.Push(1));
+  CHECK(!queue.Push(2));
+  CHECK(!queue.Push(3));
+
+  std::vector<int> results;
+  CHECK(!queue.Drain(results));
+  std::vector<int> expected = { 1, 2, 3 };
+  CHECK(results == expected);
+
+  // Once the receiver has emptied the queue, it has to be woken up again.
+  CHECK(queue.Push(4));
+}
+
+
+TEST(CompletionQueue, DrainsInBatchesByWeight) {
+  CompletionQueue<int> queue;
+  queue.Push(1, 3);
+  queue.Push(2, 3);
+  queue.Push(3, 3);
+  CHECK_EQUAL(size_t(9), queue.GetWeight());
+
+  std::vector<int> results;
+  CHECK(queue.Drain(results, 5));
+  std::vector<int> expected = { 1, 2 };
+  CHECK(results == expected);
+  CHECK_EQUAL(size_t(3), queue.GetWeight());
+
+  // The receiver comes back on its own, so results which arrive meanwhile don't wake it.
+  CHECK(!queue.Push(4, 1));
+
+  // At least one result is taken, however heavy.
+  CHECK(queue.Drain(results, 1));
+  CHECK_EQUAL(size_t(1), results.size());
+  CHECK_EQUAL(3, results[0]);
+
+  CHECK(!queue.Drain(results, 1));
+  CHECK_EQUAL(4, results[0]);
+  CHECK_EQUAL(size_t(0), queue.GetWeight());
+}
+
+
+TEST(CompletionQueue, WorkersWaitWhileTheQueueIsFull) {
+  CompletionQueue<int> queue(4);
+  queue.Push(1, 4);
+
+  std::atomic<bool> pushed(false);
+  std::thread worker([&queue, &pushed] () {
+    queue.Push(2, 1);
+    pushed = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  CHECK(!pushed.load());
+
+  std::vector<int> results;
+  queue.Drain(results);
+  worker.join();
+  CHECK(pushed.load());
+  CHECK_EQUAL(size_t(1), queue.GetWeight());
+}
+
+
+TEST(CompletionQueue, CancelledOrClosedPushesDoNotWait) {
+  CompletionQueue<int> queue(1);
+  queue.Push(1);
+
+  // The result is still added.
+  queue.Push(2, 1, [] () { return true; });
+  CHECK_EQUAL(size_t(2), queue.GetWeight());
+
+  std::thread worker([&queue] () { queue.Push(3); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  queue.Close();
+  worker.join();
+  CHECK_EQUAL(size_t(3), queue.GetWeight());
+
+  queue.Push(4);
+  CHECK_EQUAL(size_t(4), queue.GetWeight());
+}
@@ -6,6 +6,10 @@
 //-------------------------------------------------------------------------------------------------
 #pragma once
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 namespace std {
   /// <summary>
   /// Gets a value from a map or the default value.
@@ -15,4 +19,52 @@ namespace std {
     typename C<K, V, Args...>::const_iterator it = m.find(key);
     return it == m.end() ? defval : it->second;
   }
+
+
+  /// <summary>
+  /// Merges sorted runs into a single sorted vector in O(n log k), by keeping the first remaining
+  /// element of every run in a heap. Elements which are equal keep the order of their runs.
+  /// </summary>
+  template <typename T, typename Compare>
+  void merge_runs(const vector<vector<T>> &runs, vector<T> &out, Compare comp) {
+    // The run, and the position in it.
+    typedef pair<size_t, size_t> Head;
+
+    // The standard heap functions keep the largest element on top, so the heap is ordered by
+    // which head should come last.
+    auto comesAfter = [&runs, &comp] (const Head &a, const Head &b) -> bool {
+      const T &x = runs[a.first][a.second];
+      const T &y = runs[b.first][b.second];
+      if (comp(y, x)) {
+        return true;
+      }
+      if (comp(x, y)) {
+        return false;
+      }
+      return a.first > b.first;
+    };
+
+    vector<Head> heap;
+    size_t total = 0;
+    for (size_t run = 0; run < runs.size(); ++run) {
+      total += runs[run].size();
+      if (!runs[run].empty()) {
+        heap.emplace_back(run, 0);
+      }
+    }
+    make_heap(heap.begin(), heap.end(), comesAfter);
+
+    out.clear();
+    out.reserve(total);
+    while (!heap.empty()) {
+      pop_heap(heap.begin(), heap.end(), comesAfter);
+      Head &head = heap.back();
+      out.push_back(runs[head.first][head.second]);
+      if (++head.second < runs[head.first].size()) {
+        push_heap(heap.begin(), heap.end(), comesAfter);
+      } else {
+        heap.pop_back();
+      }
+    }
+  }
 }
@@ -0,0 +1,207 @@
+//-------------------------------------------------------------------------------------------------
+// /Utilities/ChangeCoalescer.hpp
+// The nModules Project
+//
+// Collects changes to the items of a folder, and boils them down to their net effect.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Collects create, delete, rename and update events for the items of a folder, so that a burst of
+/// them can be applied as one batch. Events which undo each other cancel out, e.g. a file which is
+/// created and deleted again never shows up, and a file which is renamed back and forth ends up
+/// unchanged.
+///
+/// Items are identified by name. The value is whatever the caller needs to load an item, and the
+/// one given with the last event for an item is the one which is handed back.
+/// </summary>
+template<
+  typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename Equal = std::equal_to<Key>
+>
+class ChangeCoalescer {
+public:
+  struct Change {
+    Key key;
+    Value value;
+  };
+
+  struct NameChange {
+    Key from;
+    Key to;
+    Value value;
+  };
+
+  /// <summary>
+  /// The net effect of a batch of events. Should be applied in the order of the members, and the
+  /// renames all at once, since items may have swapped names.
+  /// </summary>
+  struct Changes {
+    // Items which existed before the batch, and don't anymore.
+    std::vector<Key> deleted;
+
+    // Items which existed before the batch, and now go by another name. If an item is renamed over
+    // one which is known to have existed before the batch, that one is reported as deleted, so the
+    // deletes have to be applied first. A name nothing was heard about is assumed to have been free.
+    std::vector<NameChange> renamed;
+
+    // Items which didn't exist before the batch.
+    std::vector<Change> created;
+
+    // Items which existed before the batch, by their current names, which have changed. Items which
+    // were deleted and created again are reported as updated.
+    std::vector<Change> updated;
+  };
+
+public:
+  void Create(const Key &key, const Value &value) {
+    Slot &slot = GetSlot(key, false);
+    slot.value = value;
+    if (slot.occupied) {
+      // We missed the delete, or the item was overwritten.
+      slot.updated = true;
+    } else {
+      slot.occupied = true;
+      slot.isOriginal = false;
+      slot.updated = false;
+    }
+  }
+
+  void Delete(const Key &key) {
+    Slot &slot = GetSlot(key, true);
+    if (slot.occupied) {
+      Destroy(slot);
+    }
+  }
+
+  void Update(const Key &key, const Value &value) {
+    Slot &slot = GetSlot(key, true);
+    if (slot.occupied) {
+      slot.updated = true;
+      slot.value = value;
+    }
+  }
+
+  void Rename(const Key &from, const Key &to, const Value &value) {
+    if (Equal()(from, to)) {
+      Update(to, value);
+      return;
+    }
+
+    // References to the elements of an unordered_map survive insertions.
+    Slot &source = GetSlot(from, true);
+    Slot &target = GetSlot(to, false);
+    if (!source.occupied) {
+      Create(to, value);
+      return;
+    }
+
+    if (target.occupied) {
+      Destroy(target);
+    }
+    target.occupied = true;
+    target.isOriginal = source.isOriginal;
+    target.origin = source.origin;
+    target.updated = source.updated;
+    target.value = value;
+    source.occupied = false;
+  }
+
+  bool IsEmpty() const {
+    return mSlots.empty();
+  }
+
+  /// <summary>
+  /// Retrieves the net effect of every event since the last call, and starts over.
+  /// </summary>
+  Changes Take() {
+    Changes changes;
+    for (auto &entry : mSlots) {
+      const Key &key = entry.first;
+      Slot &slot = entry.second;
+
+      if (slot.existedBefore && !slot.originalAlive && !(slot.occupied && !slot.isOriginal)) {
+        changes.deleted.push_back(key);
+      }
+
+      if (!slot.occupied) {
+        continue;
+      }
+
+      if (!slot.isOriginal) {
+        if (slot.existedBefore && !slot.originalAlive) {
+          changes.updated.push_back(Change { key, slot.value });
+        } else {
+          changes.created.push_back(Change { key, slot.value });
+        }
+        continue;
+      }
+
+      if (!Equal()(slot.origin, key)) {
+        changes.renamed.push_back(NameChange { slot.origin, key, slot.value });
+      }
+      if (slot.updated) {
+        changes.updated.push_back(Change { key, slot.value });
+      }
+    }
+
+    mSlots.clear();
+    return changes;
+  }
+
+private:
+  // What is known about a name.
+  struct Slot {
+    // True if an item had this name before the batch.
+    bool existedBefore;
+
+    // True if the item which had this name before the batch still exists, under any name.
+    bool originalAlive;
+
+    // True if an item has this name now.
+    bool occupied;
+
+    // True if the item which has this name now existed before the batch, under the origin name.
+    bool isOriginal;
+    Key origin;
+
+    bool updated;
+    Value value;
+  };
+
+private:
+  // Finds what is known about a name. If nothing is, the first event for the name tells whether it
+  // existed before the batch.
+  Slot &GetSlot(const Key &key, bool existedBefore) {
+    auto slot = mSlots.find(key);
+    if (slot != mSlots.end()) {
+      return slot->second;
+    }
+
+    Slot &created = mSlots[key];
+    created.existedBefore = existedBefore;
+    created.originalAlive = existedBefore;
+    created.occupied = existedBefore;
+    created.isOriginal = existedBefore;
+    created.origin = key;
+    created.updated = false;
+    return created;
+  }
+
+  // Removes the item which has a name now.
+  void Destroy(Slot &slot) {
+    if (slot.isOriginal) {
+      mSlots.find(slot.origin)->second.originalAlive = false;
+    }
+    slot.occupied = false;
+  }
+
+private:
+  std::unordered_map<Key, Slot, Hash, Equal> mSlots;
+};
@@ -6,6 +6,10 @@
 //-------------------------------------------------------------------------------------------------
 #include "Clock.hpp"
 
+#include "../nCoreCom/Core.h"
+
+#include <algorithm>
+
 static const WindowSettings sClockWindowDefaults([] (WindowSettings &defaults) {
   defaults.evaluateText = true;
   defaults.registerWithCore = true;
@@ -32,8 +36,10 @@ Clock::Clock(LPCTSTR clockName) : Drawable(clockName) {
   mWindow->AddPrePainter(&mMinuteHand);
   mWindow->AddPrePainter(&mSecondHand);
 
+  mUpdateRate = (UINT)std::max(1, mSettings->GetInt(L"UpdateRate", 1000));
+
   UpdateHands();
-  mUpdateTimer = mWindow->SetCallbackTimer(mSettings->GetInt(L"UpdateRate", 1000), this);
+  nCore::ScheduleFrame(this, mWindow->GetFrameSurface(), nCore::GetFrameTime() + TimeToNextUpdate());
 
   mWindow->Show();
 }
@@ -43,9 +49,30 @@ Clock::Clock(LPCTSTR clockName) : Drawable(clockName) {
 /// Destructor
 /// </summary>
 Clock::~Clock() {
-  if (mUpdateTimer != 0) {
-    mWindow->ClearCallbackTimer(mUpdateTimer);
-  }
+  nCore::UnscheduleFrame(this);
+}
+
+
+/// <summary>
+/// Called by the frame scheduler when the hands should move.
+/// </summary>
+double Clock::OnFrame(double time) {
+  UpdateHands();
+  mWindow->Repaint();
+  return time + TimeToNextUpdate();
+}
+
+
+/// <summary>
+/// Returns the time until the next multiple of the update rate on the wall clock, so that the
+/// second hand moves when the second changes rather than at some arbitrary offset.
+/// </summary>
+double Clock::TimeToNextUpdate() const {
+  SYSTEMTIME time;
+  GetLocalTime(&time);
+
+  UINT msOfDay = ((time.wHour * 60 + time.wMinute) * 60 + time.wSecond) * 1000 + time.wMilliseconds;
+  return (mUpdateRate - msOfDay % mUpdateRate) / 1000.0;
 }
 
 
@@ -71,19 +98,13 @@ void Clock::UpdateHands() {
 /// </summary>
 LRESULT WINAPI Clock::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARAM lParam, LPVOID) {
   switch (msg) {
-  case WM_TIMER:
-    if (wParam == mUpdateTimer) {
-      UpdateHands();
-      mWindow->Repaint();
-    }
-    return 0;
-
   case Window::WM_TOPPARENTLOST:
-    mUpdateTimer = 0;
+    nCore::UnscheduleFrame(this);
     return 0;
 
   case Window::WM_NEWTOPPARENT:
-    mUpdateTimer = mWindow->SetCallbackTimer(mSettings->GetInt(L"UpdateRate", 1000), this);
+    UpdateHands();
+    nCore::ScheduleFrame(this, mWindow->GetFrameSurface(), nCore::GetFrameTime() + TimeToNextUpdate());
     return 0;
   }
 
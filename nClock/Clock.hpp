@@ -11,7 +11,9 @@
 #include "../nShared/Drawable.hpp"
 #include "../nShared/StateRender.hpp"
 
-class Clock : public Drawable {
+#include "../nCore/IFrameListener.hpp"
+
+class Clock : public Drawable, IFrameListener {
 private:
   enum class States {
     Base,
@@ -25,6 +27,14 @@ public:
 public:
   void UpdateHands();
 
+  // IFrameListener
+private:
+  double OnFrame(double time) override;
+
+private:
+  // Returns the time until the next multiple of the update rate on the wall clock, in seconds.
+  double TimeToNextUpdate() const;
+
   // MessageHandler
 public:
   LRESULT WINAPI HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARAM lParam, LPVOID) override;
@@ -32,7 +42,8 @@ public:
 private:
   StateRender<States> mStateRender;
 
-  UINT_PTR mUpdateTimer;
+  // How often the hands should be updated, in milliseconds.
+  UINT mUpdateRate;
   bool mUse24HourDial;
 
   ClockHand mSecondHand;
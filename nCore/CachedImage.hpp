@@ -0,0 +1,20 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/CachedImage.hpp
+// The nModules Project
+//
+// An image held by nCore's image cache.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+
+/// <summary>
+/// Decoded pixels, in premultiplied 32bpp BGRA. Owned by the image cache, and valid until the
+/// image is released.
+/// </summary>
+struct CachedImage {
+  uint32_t width;
+  uint32_t height;
+  uint32_t stride;
+  const uint8_t *pixels;
+};
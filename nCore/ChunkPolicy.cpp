@@ -0,0 +1,44 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ChunkPolicy.cpp
+// The nModules Project
+//
+// Decides when a stream of results is split into chunks.
+//-------------------------------------------------------------------------------------------------
+#include "ChunkPolicy.hpp"
+
+#include <algorithm>
+
+
+ChunkPolicy::ChunkPolicy(size_t firstChunk, size_t maxChunk, double maxDelay)
+  : mMaxChunk(std::max<size_t>(1, maxChunk))
+  , mMaxDelay(maxDelay)
+  , mLimit(std::min(std::max<size_t>(1, firstChunk), mMaxChunk))
+  , mCount(0)
+  , mStarted(0)
+{
+}
+
+
+bool ChunkPolicy::Add(double now) {
+  if (mCount++ == 0) {
+    mStarted = now;
+  }
+
+  if (mCount < mLimit && now - mStarted < mMaxDelay) {
+    return false;
+  }
+
+  mLimit = std::min(mLimit * 2, mMaxChunk);
+  mCount = 0;
+  return true;
+}
+
+
+size_t ChunkPolicy::GetCount() const {
+  return mCount;
+}
+
+
+size_t ChunkPolicy::GetLimit() const {
+  return mLimit;
+}
@@ -0,0 +1,47 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ChunkPolicy.hpp
+// The nModules Project
+//
+// Decides when a stream of results is split into chunks.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stddef.h>
+
+/// <summary>
+/// Splits a stream of results into chunks. The first chunk is small, so that something shows up
+/// right away, and every chunk after it is twice as large as the one before, up to a limit, so
+/// that large streams don't cost a message per handful of results. A chunk is also sent once its
+/// oldest result has waited for too long, for streams which trickle in slowly.
+/// </summary>
+class ChunkPolicy {
+public:
+  /// <param name="firstChunk">The number of results in the first chunk.</param>
+  /// <param name="maxChunk">The most results in a chunk.</param>
+  /// <param name="maxDelay">The longest a result waits for its chunk to fill up, in seconds.</param>
+  ChunkPolicy(size_t firstChunk, size_t maxChunk, double maxDelay);
+
+public:
+  /// <summary>
+  /// Adds a result to the current chunk.
+  /// </summary>
+  /// <param name="now">The current time, in seconds.</param>
+  /// <returns>True if the chunk should be sent now. The next result starts a new chunk.</returns>
+  bool Add(double now);
+
+  // The number of results in the current chunk.
+  size_t GetCount() const;
+
+  // The size the current chunk is sent at.
+  size_t GetLimit() const;
+
+private:
+  const size_t mMaxChunk;
+  const double mMaxDelay;
+
+  size_t mLimit;
+  size_t mCount;
+
+  // When the first result of the current chunk was added.
+  double mStarted;
+};
@@ -0,0 +1,110 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/CompletionQueue.hpp
+// The nModules Project
+//
+// Collects results from worker threads, so that they can be handed over in batches.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stddef.h>
+#include <vector>
+
+/// <summary>
+/// Results which worker threads have finished, waiting for the thread that asked for them. Only
+/// the first result pushed to an empty queue needs to wake the receiver, which then takes results
+/// in batches of a limited size, and keeps coming back on its own until the queue is empty.
+///
+/// Every result has a weight, e.g. the number of items in it. Once the queue holds more than its
+/// capacity, workers wait for the receiver to catch up before they add more.
+/// </summary>
+template <typename T>
+class CompletionQueue {
+public:
+  /// <param name="capacity">The total weight of results the queue holds before Push waits.
+  /// </param>
+  explicit CompletionQueue(size_t capacity = size_t(-1))
+    : mCapacity(capacity)
+    , mWeight(0)
+    , mSignalled(false)
+    , mClosed(false)
+  {
+  }
+
+  CompletionQueue(const CompletionQueue&) = delete;
+  CompletionQueue &operator=(const CompletionQueue&) = delete;
+
+public:
+  /// <summary>
+  /// Adds a result. Waits while the queue is over capacity, unless cancelled returns true or the
+  /// queue is closed. The result is always added.
+  /// </summary>
+  /// <returns>True if the receiver should be woken up.</returns>
+  bool Push(T &&result, size_t weight = 1, const std::function<bool()> &cancelled = nullptr) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (mWeight >= mCapacity && !mClosed && !(cancelled && cancelled())) {
+      // Cancellation doesn't wake us up, so check for it every now and then.
+      mDrained.wait_for(lock, std::chrono::milliseconds(20));
+    }
+
+    mResults.emplace_back(std::move(result), weight);
+    mWeight += weight;
+    if (mSignalled) {
+      return false;
+    }
+    mSignalled = true;
+    return true;
+  }
+
+  /// <summary>
+  /// Takes results, in order, until their total weight reaches the budget. At least one result is
+  /// taken if there are any.
+  /// </summary>
+  /// <returns>True if results are left, in which case the receiver has to come back for them
+  /// without being woken up.</returns>
+  bool Drain(std::vector<T> &results, size_t budget = size_t(-1)) {
+    results.clear();
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t taken = 0;
+    while (!mResults.empty() && (results.empty() || taken < budget)) {
+      taken += mResults.front().second;
+      results.push_back(std::move(mResults.front().first));
+      mResults.pop_front();
+    }
+    mWeight -= taken;
+    mSignalled = !mResults.empty();
+    mDrained.notify_all();
+    return mSignalled;
+  }
+
+  /// <summary>
+  /// Stops Push from waiting, e.g. when shutting down.
+  /// </summary>
+  void Close() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mClosed = true;
+    mDrained.notify_all();
+  }
+
+  // The total weight of the results in the queue.
+  size_t GetWeight() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mWeight;
+  }
+
+private:
+  const size_t mCapacity;
+
+  std::mutex mMutex;
+  std::condition_variable mDrained;
+  std::deque<std::pair<T, size_t>> mResults;
+  size_t mWeight;
+
+  // True if the receiver has been woken up, and hasn't emptied the queue since.
+  bool mSignalled;
+  bool mClosed;
+};
@@ -7,8 +7,7 @@
 #pragma once
 
 // Internal nCore messages
-#define NCORE_FILE_SYSTEM_LOAD_COMPLETE             0x0500
-#define NCORE_FILE_SYSTEM_ITEM_LOAD_COMPLETE        0x0501
+#define NCORE_FILE_SYSTEM_RESULTS_READY             0x0500
 
 // nCore -> Modules
 #define NCORE_DISPLAYCHANGE                         0x9000
@@ -7,13 +7,20 @@
 // Exports the following functions:
 //   - void CancelLoad(UINT64 id)
 //   - UINT64 LoadFolder(LoadFolderRequest&, FileSystemLoaderResponseHandler*)
+//   - UINT64 LoadFolderItem(LoadItemRequest&, FileSystemLoaderResponseHandler*)
 //-------------------------------------------------------------------------------------------------
+#include "ChunkPolicy.hpp"
+#include "CompletionQueue.hpp"
 #include "CoreMessages.h"
 #include "FileSystemLoader.h"
+#include "IFrameListener.hpp"
+#include "WorkerPool.hpp"
 
 #include "../Utilities/Macros.h"
 
+#include <algorithm>
 #include <CommonControls.h>
+#include <memory>
 #include <shellapi.h>
 #include <Shlobj.h>
 #include <Shlwapi.h>
@@ -24,20 +31,97 @@
 
 extern HWND ghWndMsgHandler;
 
+EXPORT_CDECL(void) ScheduleFrame(IFrameListener*, IFrameSurface*, double time);
+EXPORT_CDECL(void) UnscheduleFrame(IFrameListener*);
+EXPORT_CDECL(IWICBitmap*) LoadCachedThumbnail(LPCWSTR path, UINT iconSize);
+EXPORT_CDECL(void) CacheThumbnailBitmap(LPCWSTR path, UINT iconSize, HBITMAP bitmap);
+EXPORT_CDECL(void) CacheThumbnailIcon(LPCWSTR path, UINT iconSize, HICON icon);
+
+// The most threads to extract icons on. Most of the time is spent waiting on the disk and shell
+// extensions, so there is no point in using every core.
+static const unsigned MAX_THREADS = 4;
+
+// Folder items are sent in chunks which start out small, so that the first icons can be laid out
+// right away, and grow from there.
+static const size_t FIRST_ITEM_CHUNK = 32;
+static const size_t MAX_ITEM_CHUNK = 512;
+
+// Thumbnails are slower, so they are sent in smaller chunks.
+static const size_t FIRST_THUMBNAIL_CHUNK = 4;
+static const size_t MAX_THUMBNAIL_CHUNK = 64;
+
+// The longest a result waits for its chunk to fill up, in seconds.
+static const double MAX_CHUNK_DELAY = 0.05;
+
+// The number of thumbnails extracted by a single job.
+static const size_t THUMBNAILS_PER_JOB = 16;
+
+// The most items handed to modules per frame.
+static const size_t ITEMS_PER_FRAME = 256;
+
+// The number of items waiting to be delivered before the loader threads wait for the UI.
+static const size_t MAX_QUEUED_ITEMS = 4096;
+
+typedef std::shared_ptr<IShellFolder2> FolderPtr;
+
 struct RequestData {
   RequestData(FileSystemLoaderResponseHandler *handler) {
     this->handler = handler;
-    abort = new bool;
-    *abort = false;
   }
 
   FileSystemLoaderResponseHandler *handler;
-  bool *abort;
+  WorkerPool::CancellationToken token;
+};
+
+/// <summary>
+/// The state shared by the jobs of a folder request.
+/// </summary>
+struct FolderLoad {
+  UINT64 requestId;
+  FolderPtr folder;
+  UINT targetIconWidth;
+  WorkerPool::Priority priority;
+  UINT visibleCount;
+  UINT thumbnailCount;
+  WorkerPool::CancellationToken token;
+
+  // The jobs which haven't finished yet. The last one to finish completes the request.
+  std::atomic<size_t> remainingJobs;
+};
+
+/// <summary>
+/// A finished part of a request, waiting to be handed to its handler on nCore's thread.
+/// </summary>
+struct CompletedLoad {
+  enum class Type {
+    Item,
+    FolderItems,
+    FolderThumbnails
+  };
+
+  UINT64 requestId;
+  Type type;
+  FolderPtr folder;
+  LoadItemResponse item;
+  LoadFolderItemsResponse folderItems;
+  LoadFolderResponse folderThumbnails;
+};
+
+/// <summary>
+/// Hands finished parts of requests over a bit at a time.
+/// </summary>
+class LoadDeliverer : public IFrameListener {
+public:
+  double OnFrame(double time) override;
 };
 
 static UINT64 sNextRequestId = 0;
 static std::unordered_map<UINT64, RequestData> sOutstandingRequests;
 
+static WorkerPool *sPool = nullptr;
+static CompletionQueue<std::unique_ptr<CompletedLoad>> sCompleted(MAX_QUEUED_ITEMS);
+static LoadDeliverer sDeliverer;
+
 
 /// <summary>
 /// Tries to load the icon using IThumbnailProvider.
@@ -137,9 +221,38 @@ static HRESULT LoadIconUsingExtractIcon(LoadThumbnailResponse &response, int ico
 }
 
 
+/// <summary>
+/// Tries to load the icon from the thumbnail cache.
+/// </summary>
+static HRESULT LoadIconFromCache(LoadThumbnailResponse &response, int iconSize, LPCWSTR path) {
+  response.thumbnail.wicBitmap = LoadCachedThumbnail(path, iconSize);
+  if (response.thumbnail.wicBitmap == nullptr) {
+    return S_FALSE;
+  }
+
+  UINT width, height;
+  response.thumbnail.wicBitmap->GetSize(&width, &height);
+  response.size.height = (FLOAT)height;
+  response.size.width = (FLOAT)width;
+  response.type = LoadThumbnailResponse::Type::WICBitmap;
+  return S_OK;
+}
+
+
 static void LoadThumbnail(LoadThumbnailResponse &response, int iconSize, IShellFolder2 *folder, LPCITEMIDLIST *item) {
   response.size.height = (FLOAT)iconSize;
   response.size.width = (FLOAT)iconSize;
+
+  // Thumbnails which have been extracted before are kept on disk, by parsing name.
+  STRRET ret;
+  WCHAR path[MAX_PATH] = L"";
+  if (SUCCEEDED(folder->GetDisplayNameOf(*item, SHGDN_FORPARSING, &ret))) {
+    StrRetToBufW(&ret, *item, path, _countof(path));
+  }
+  if (LoadIconFromCache(response, iconSize, path) == S_OK) {
+    return;
+  }
+
   HRESULT hr = LoadIconUsingThumbnailProvider(response, iconSize, folder, item);
   if (hr != S_OK) {
     hr = LoadIconUsingExtractImage(response, iconSize, folder, item);
@@ -150,81 +263,283 @@ static void LoadThumbnail(LoadThumbnailResponse &response, int iconSize, IShellF
   if (hr != S_OK) {
     response.thumbnail.icon = LoadIcon(nullptr, IDI_ERROR);
     response.type = LoadThumbnailResponse::Type::HICON;
+  } else if (response.type == LoadThumbnailResponse::Type::HBITMAP) {
+    CacheThumbnailBitmap(path, iconSize, response.thumbnail.bitmap);
+  } else {
+    CacheThumbnailIcon(path, iconSize, response.thumbnail.icon);
   }
 }
 
 
-static void LoadFolderItemThread(LoadItemRequest request, UINT64 requestId, volatile bool *abort, HWND hwnd) {
-  CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+/// <summary>
+/// The time, in seconds, for deciding when to send chunks.
+/// </summary>
+static double GetTime() {
+  return GetTickCount64() / 1000.0;
+}
 
-  LoadItemResponse item;
-  item.id = request.id;
-  LoadThumbnail(item.thumbnail, request.targetIconWidth, request.folder, (LPCITEMIDLIST*)&request.id);
 
-  if (!*abort) {
-    SendMessage(hwnd, NCORE_FILE_SYSTEM_ITEM_LOAD_COMPLETE, (WPARAM)requestId, (LPARAM)&item);
-  }
-  delete abort;
+/// <summary>
+/// Holds a reference to the folder for as long as any job or result needs it.
+/// </summary>
+static FolderPtr ShareFolder(IShellFolder2 *folder) {
+  folder->AddRef();
+  return FolderPtr(folder, [] (IShellFolder2 *folder) {
+    folder->Release();
+  });
+}
+
 
-  ILFree(item.id);
-  if (item.thumbnail.type == LoadThumbnailResponse::Type::HBITMAP) {
-    DeleteObject(item.thumbnail.thumbnail.bitmap);
-  } else if (item.thumbnail.type == LoadThumbnailResponse::Type::HICON) {
-    DestroyIcon(item.thumbnail.thumbnail.icon);
+static void FreeThumbnail(LoadThumbnailResponse &thumbnail) {
+  if (thumbnail.type == LoadThumbnailResponse::Type::HBITMAP) {
+    DeleteObject(thumbnail.thumbnail.bitmap);
+  } else if (thumbnail.type == LoadThumbnailResponse::Type::HICON) {
+    DestroyIcon(thumbnail.thumbnail.icon);
+  } else if (thumbnail.type == LoadThumbnailResponse::Type::WICBitmap) {
+    thumbnail.thumbnail.wicBitmap->Release();
   } else {
     ASSERT(false);
   }
+}
+
+
+/// <summary>
+/// Frees everything a finished request holds on to.
+/// </summary>
+static void FreeCompletedLoad(CompletedLoad &load) {
+  switch (load.type) {
+  case CompletedLoad::Type::Item:
+    ILFree(load.item.id);
+    FreeThumbnail(load.item.thumbnail);
+    break;
+
+  case CompletedLoad::Type::FolderItems:
+    for (PITEMID_CHILD id : load.folderItems.items) {
+      ILFree(id);
+    }
+    break;
+
+  case CompletedLoad::Type::FolderThumbnails:
+    for (LoadItemResponse &item : load.folderThumbnails.items) {
+      ILFree(item.id);
+      FreeThumbnail(item.thumbnail);
+    }
+    break;
+  }
+}
 
-  CoUninitialize();
+
+static std::unique_ptr<CompletedLoad> CreateCompletedLoad(UINT64 requestId,
+    CompletedLoad::Type type, const FolderPtr &folder) {
+  std::unique_ptr<CompletedLoad> load(new CompletedLoad());
+  load->requestId = requestId;
+  load->type = type;
+  load->folder = folder;
+  load->folderItems.first = 0;
+  load->folderThumbnails.complete = false;
+  return load;
 }
 
 
-static void LoadFolderThread(LoadFolderRequest request, UINT64 requestId, volatile bool *abort, HWND hwnd) {
-  LoadFolderResponse response;
+/// <summary>
+/// Hands part of a request over to nCore's thread. Waits if nCore's thread is falling behind.
+/// </summary>
+static void Complete(std::unique_ptr<CompletedLoad> &&load, const WorkerPool::CancellationToken &token) {
+  size_t weight = 1;
+  if (load->type == CompletedLoad::Type::FolderItems) {
+    weight = std::max<size_t>(weight, load->folderItems.items.size());
+  } else if (load->type == CompletedLoad::Type::FolderThumbnails) {
+    weight = std::max<size_t>(weight, load->folderThumbnails.items.size());
+  }
+
+  if (token.IsCancelled()) {
+    FreeCompletedLoad(*load);
+  } else if (sCompleted.Push(std::move(load), weight, [&token] () { return token.IsCancelled(); })) {
+    PostMessage(ghWndMsgHandler, NCORE_FILE_SYSTEM_RESULTS_READY, 0, 0);
+  }
+}
 
-  CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+
+/// <summary>
+/// Called when a job of a folder request is done. The last one tells the handler that the folder
+/// has been loaded.
+/// </summary>
+static void FinishFolderJob(const std::shared_ptr<FolderLoad> &load) {
+  if (--load->remainingJobs == 0) {
+    std::unique_ptr<CompletedLoad> done = CreateCompletedLoad(load->requestId,
+      CompletedLoad::Type::FolderThumbnails, load->folder);
+    done->folderThumbnails.complete = true;
+    Complete(std::move(done), load->token);
+  }
+}
+
+
+static void LoadFolderItemJob(LoadItemRequest request, UINT64 requestId, FolderPtr folder,
+    WorkerPool::CancellationToken token) {
+  std::unique_ptr<CompletedLoad> load = CreateCompletedLoad(requestId, CompletedLoad::Type::Item,
+    folder);
+
+  LoadItemResponse &item = load->item;
+  item.id = request.id;
+  item.index = 0;
+  LoadThumbnail(item.thumbnail, request.targetIconWidth, folder.get(), (LPCITEMIDLIST*)&request.id);
+
+  Complete(std::move(load), token);
+}
+
+
+/// <summary>
+/// Loads the thumbnails of a run of folder items.
+/// </summary>
+static void LoadThumbnailsJob(std::shared_ptr<FolderLoad> load, std::vector<PITEMID_CHILD> ids,
+    UINT first) {
+  ChunkPolicy policy(FIRST_THUMBNAIL_CHUNK, MAX_THUMBNAIL_CHUNK, MAX_CHUNK_DELAY);
+  std::unique_ptr<CompletedLoad> chunk;
+
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (load->token.IsCancelled()) {
+      ILFree(ids[i]);
+      continue;
+    }
+
+    if (!chunk) {
+      chunk = CreateCompletedLoad(load->requestId, CompletedLoad::Type::FolderThumbnails,
+        load->folder);
+    }
+    chunk->folderThumbnails.items.emplace_back();
+    LoadItemResponse &item = chunk->folderThumbnails.items.back();
+    item.id = ids[i];
+    item.index = first + UINT(i);
+    LoadThumbnail(item.thumbnail, load->targetIconWidth, load->folder.get(), (LPCITEMIDLIST*)&item.id);
+
+    if (policy.Add(GetTime())) {
+      Complete(std::move(chunk), load->token);
+    }
+  }
+
+  if (chunk) {
+    Complete(std::move(chunk), load->token);
+  }
+  FinishFolderJob(load);
+}
+
+
+/// <summary>
+/// Sends a chunk of folder items, and queues up loading their thumbnails. Items which will be on
+/// screen are loaded first, and items past the request's thumbnail count aren't loaded at all.
+/// </summary>
+static void SendFolderItems(const std::shared_ptr<FolderLoad> &load,
+    std::unique_ptr<CompletedLoad> &&chunk) {
+  UINT first = chunk->folderItems.first;
+  std::vector<PITEMID_CHILD> ids;
+  for (PITEMID_CHILD id : chunk->folderItems.items) {
+    if (first + UINT(ids.size()) >= load->thumbnailCount) {
+      break;
+    }
+    ids.push_back(ILClone(id));
+  }
+  Complete(std::move(chunk), load->token);
+
+  for (size_t start = 0; start < ids.size(); start += THUMBNAILS_PER_JOB) {
+    size_t end = std::min(start + THUMBNAILS_PER_JOB, ids.size());
+    std::vector<PITEMID_CHILD> run(ids.begin() + start, ids.begin() + end);
+    UINT runFirst = first + UINT(start);
+
+    WorkerPool::Priority priority = runFirst < load->visibleCount
+      ? WorkerPool::Priority::Visible : WorkerPool::Priority::Offscreen;
+    priority = std::max(priority, load->priority);
+
+    ++load->remainingJobs;
+    sPool->Submit(priority, load->token, [load, run, runFirst] () {
+      LoadThumbnailsJob(load, run, runFirst);
+    }, [run] () {
+      for (PITEMID_CHILD id : run) {
+        ILFree(id);
+      }
+    });
+  }
+}
+
+
+/// <summary>
+/// Finds the items of a folder.
+/// </summary>
+static void EnumerateFolderJob(std::shared_ptr<FolderLoad> load,
+    const StringKeyedSets<std::wstring>::UnorderedSet &blackList) {
+  ChunkPolicy policy(FIRST_ITEM_CHUNK, MAX_ITEM_CHUNK, MAX_CHUNK_DELAY);
+  std::unique_ptr<CompletedLoad> chunk;
+  UINT index = 0;
 
   IEnumIDList *enumIdList;
-  if (SUCCEEDED(request.folder->EnumObjects(nullptr, SHCONTF_FOLDERS | SHCONTF_NONFOLDERS, &enumIdList))) {
-    PIDLIST_RELATIVE idNext;
-    while (!*abort && enumIdList->Next(1, &idNext, nullptr) != S_FALSE) {
+  if (SUCCEEDED(load->folder->EnumObjects(nullptr, SHCONTF_FOLDERS | SHCONTF_NONFOLDERS, &enumIdList))) {
+    PITEMID_CHILD idNext;
+    while (!load->token.IsCancelled() && enumIdList->Next(1, &idNext, nullptr) == S_OK) {
       STRRET ret;
-      if (SUCCEEDED(request.folder->GetDisplayNameOf(idNext, SHGDN_FORPARSING, &ret))) {
-        WCHAR buffer[MAX_PATH];
-        StrRetToBufW(&ret, idNext, buffer, _countof(buffer));
-        if (request.blackList.count(buffer) == 0) {
-          response.items.emplace_back();
-          LoadItemResponse &item = response.items.back();
-          item.id = idNext;
-          LoadThumbnail(item.thumbnail, request.targetIconWidth, request.folder, (LPCITEMIDLIST*)&idNext);
-        } else {
-          CoTaskMemFree(idNext);
-        }
+      WCHAR buffer[MAX_PATH];
+      if (FAILED(load->folder->GetDisplayNameOf(idNext, SHGDN_FORPARSING, &ret))
+          || FAILED(StrRetToBufW(&ret, idNext, buffer, _countof(buffer)))
+          || blackList.count(buffer) != 0) {
+        ILFree(idNext);
+        continue;
+      }
+
+      if (!chunk) {
+        chunk = CreateCompletedLoad(load->requestId, CompletedLoad::Type::FolderItems,
+          load->folder);
+        chunk->folderItems.first = index;
+      }
+      chunk->folderItems.items.push_back(idNext);
+      chunk->folderItems.names.push_back(buffer);
+      ++index;
+
+      if (policy.Add(GetTime())) {
+        SendFolderItems(load, std::move(chunk));
       }
     }
     enumIdList->Release();
   }
 
-  if (!*abort) {
-    SendMessage(hwnd, NCORE_FILE_SYSTEM_LOAD_COMPLETE, (WPARAM)requestId, (LPARAM)&response);
+  if (chunk) {
+    SendFolderItems(load, std::move(chunk));
   }
+  FinishFolderJob(load);
+}
 
-  delete abort;
 
-  for (LoadItemResponse &item : response.items) {
-    CoTaskMemFree(item.id);
-    if (item.thumbnail.type == LoadThumbnailResponse::Type::HBITMAP) {
-      DeleteObject(item.thumbnail.thumbnail.bitmap);
-    } else if (item.thumbnail.type == LoadThumbnailResponse::Type::HICON) {
-      DestroyIcon(item.thumbnail.thumbnail.icon);
-    } else {
-      ASSERT(false);
-    }
+/// <summary>
+/// Starts the threads which load folders and icons.
+/// </summary>
+void InitializeFileSystemLoader() {
+  unsigned threads = std::max(2u, std::min(MAX_THREADS, std::thread::hardware_concurrency()));
+  sPool = new WorkerPool(threads, [] () {
+    CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+  }, [] () {
+    CoUninitialize();
+  });
+}
+
+
+/// <summary>
+/// Stops the loader threads, and throws away every result which hasn't been delivered.
+/// </summary>
+void ShutdownFileSystemLoader() {
+  for (auto &request : sOutstandingRequests) {
+    request.second.token.Cancel();
   }
+  sOutstandingRequests.clear();
+  UnscheduleFrame(&sDeliverer);
 
-  request.folder->Release();
+  if (sPool) {
+    sCompleted.Close();
+    sPool->Shutdown();
+    SAFEDELETE(sPool);
+  }
 
-  CoUninitialize();
+  std::vector<std::unique_ptr<CompletedLoad>> loads;
+  sCompleted.Drain(loads);
+  for (auto &load : loads) {
+    FreeCompletedLoad(*load);
+  }
 }
 
 
@@ -238,10 +553,20 @@ EXPORT_CDECL(UINT64) LoadFolder(LoadFolderRequest &request, FileSystemLoaderResp
     std::forward_as_tuple(requestId),
     std::forward_as_tuple(handler)).first;
 
-  request.folder->AddRef();
-
-  std::thread(LoadFolderThread, request, requestId, requestData->second.abort,
-    ghWndMsgHandler).detach();
+  std::shared_ptr<FolderLoad> load = std::make_shared<FolderLoad>();
+  load->requestId = requestId;
+  load->folder = ShareFolder(request.folder);
+  load->targetIconWidth = request.targetIconWidth;
+  load->priority = WorkerPool::Priority(request.priority);
+  load->visibleCount = request.visibleCount;
+  load->thumbnailCount = request.thumbnailCount;
+  load->token = requestData->second.token;
+  load->remainingJobs = 1;
+
+  StringKeyedSets<std::wstring>::UnorderedSet blackList = request.blackList;
+  sPool->Submit(load->priority, load->token, [load, blackList] () {
+    EnumerateFolderJob(load, blackList);
+  });
 
   return requestId;
 }
@@ -257,43 +582,79 @@ EXPORT_CDECL(UINT64) LoadFolderItem(LoadItemRequest &request, FileSystemLoaderRe
     std::forward_as_tuple(requestId),
     std::forward_as_tuple(handler)).first;
 
-  request.folder->AddRef();
-
-  std::thread(LoadFolderItemThread, request, requestId, requestData->second.abort,
-    ghWndMsgHandler).detach();
+  FolderPtr folder = ShareFolder(request.folder);
+  PITEMID_CHILD id = request.id;
+  WorkerPool::CancellationToken token = requestData->second.token;
+  sPool->Submit(WorkerPool::Priority(request.priority), token, [request, requestId, folder, token] () {
+    LoadFolderItemJob(request, requestId, folder, token);
+  }, [id] () {
+    ILFree(id);
+  });
 
   return requestId;
 }
 
 
 /// <summary>
-/// Cancels an outstanding request.
+/// Cancels an outstanding request. Does nothing if the request has already been delivered.
 /// </summary>
 EXPORT_CDECL(void) CancelLoad(UINT64 id) {
   auto request = sOutstandingRequests.find(id);
-  ASSERT(request != sOutstandingRequests.end());
-  *request->second.abort = true;
-  sOutstandingRequests.erase(request);
+  if (request != sOutstandingRequests.end()) {
+    request->second.token.Cancel();
+    sOutstandingRequests.erase(request);
+  }
 }
 
 
 /// <summary>
-/// Called by nCores window procedure when it receives a message from the thread.
+/// Hands a frame's worth of finished requests to their handlers.
 /// </summary>
-void LoadCompleted(UINT64 id, LPVOID result) {
-  auto request = sOutstandingRequests.find(id);
-  if (request != sOutstandingRequests.end()) {
-    request->second.handler->FolderLoaded(id, (LoadFolderResponse*)result);
+/// <returns>True if there are more left.</returns>
+static bool DeliverBatch() {
+  std::vector<std::unique_ptr<CompletedLoad>> loads;
+  bool more = sCompleted.Drain(loads, ITEMS_PER_FRAME);
+
+  for (auto &load : loads) {
+    auto request = sOutstandingRequests.find(load->requestId);
+    if (request != sOutstandingRequests.end()) {
+      FileSystemLoaderResponseHandler *handler = request->second.handler;
+      switch (load->type) {
+      case CompletedLoad::Type::Item:
+        sOutstandingRequests.erase(request);
+        handler->ItemLoaded(load->requestId, &load->item);
+        break;
+
+      case CompletedLoad::Type::FolderItems:
+        handler->FolderItemsFound(load->requestId, &load->folderItems);
+        break;
+
+      case CompletedLoad::Type::FolderThumbnails:
+        if (load->folderThumbnails.complete) {
+          sOutstandingRequests.erase(request);
+        }
+        handler->FolderLoaded(load->requestId, &load->folderThumbnails);
+        break;
+      }
+    }
+    FreeCompletedLoad(*load);
   }
+
+  return more;
+}
+
+
+double LoadDeliverer::OnFrame(double time) {
+  return DeliverBatch() ? time : -1;
 }
 
 
 /// <summary>
-/// Called by nCores window procedure when it receives a message from the thread.
+/// Called by nCores window procedure when loader threads have posted results. Whatever doesn't
+/// fit in this frame is delivered on the following ones.
 /// </summary>
-void LoadItemCompleted(UINT64 id, LPVOID result) {
-  auto request = sOutstandingRequests.find(id);
-  if (request != sOutstandingRequests.end()) {
-    request->second.handler->ItemLoaded(id, (LoadItemResponse*)result);
+void DeliverLoadResults() {
+  if (DeliverBatch()) {
+    ScheduleFrame(&sDeliverer, nullptr, 0);
   }
 }
@@ -13,6 +13,17 @@
 
 #include <Shobjidl.h>
 #include <Shlwapi.h>
+#include <wincodec.h>
+
+// How soon a request should be handled. Matches WorkerPool::Priority.
+enum class LoadPriority {
+  // The icons will be shown as soon as they are loaded.
+  Visible,
+  // The icons are needed, but won't be on screen.
+  Offscreen,
+  // The icons might be needed later.
+  Prefetch
+};
 
 struct LoadFolderRequest {
   // A set of item names which should not be included in the response.
@@ -21,6 +32,14 @@ struct LoadFolderRequest {
   UINT targetIconWidth;
   // The folder to load from.
   IShellFolder2 *folder;
+  // How soon the folder should be loaded.
+  LoadPriority priority;
+  // The number of items, in the order they are found, which will be on screen. Their thumbnails
+  // are loaded before the others.
+  UINT visibleCount;
+  // The number of items, in the order they are found, whose thumbnails should be loaded with the
+  // folder. The rest are only sent as items, and can be loaded with LoadFolderItem when needed.
+  UINT thumbnailCount;
 };
 
 struct LoadItemRequest {
@@ -28,8 +47,10 @@ struct LoadItemRequest {
   UINT targetIconWidth;
   // The folder to load from.
   IShellFolder2 *folder;
-  // The item to load.
+  // The item to load. The loader takes ownership of it.
   PITEMID_CHILD id;
+  // How soon the item should be loaded.
+  LoadPriority priority;
 };
 
 
@@ -38,18 +59,35 @@ struct LoadThumbnailResponse {
   union {
     HICON icon;
     HBITMAP bitmap;
+    // Premultiplied BGRA, from the thumbnail cache.
+    IWICBitmap *wicBitmap;
   } thumbnail;
   enum class Type {
     HICON,
-    HBITMAP
+    HBITMAP,
+    WICBitmap
   } type;
 };
 
 struct LoadItemResponse {
   LoadThumbnailResponse thumbnail;
   PITEMID_CHILD id;
+  // For folder loads, where the item is in the order the folder's items were found.
+  UINT index;
+};
+
+// Items of a folder which have been found, but whose thumbnails haven't been loaded yet.
+struct LoadFolderItemsResponse {
+  // Where the first item is in the order the folder's items are found.
+  UINT first;
+  std::vector<PITEMID_CHILD> items;
+  // The parsing names of the items, in the same order.
+  std::vector<std::wstring> names;
 };
 
+// Thumbnails of items which have been sent as a LoadFolderItemsResponse.
 struct LoadFolderResponse {
   std::vector<LoadItemResponse> items;
+  // True for the last response to a request.
+  bool complete;
 };
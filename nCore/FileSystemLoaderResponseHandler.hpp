@@ -10,8 +10,14 @@
 
 #include "../Utilities/Common.h"
 
+/// <summary>
+/// Folders are delivered in parts. The items are sent to FolderItemsFound as they are found, and
+/// their thumbnails to FolderLoaded as they are loaded, visible items first. The responses, and
+/// everything in them, are only valid during the call.
+/// </summary>
 class FileSystemLoaderResponseHandler {
 public:
+  virtual LPARAM FolderItemsFound(UINT64, struct LoadFolderItemsResponse*) = 0;
   virtual LPARAM FolderLoaded(UINT64, struct LoadFolderResponse*) = 0;
   virtual LPARAM ItemLoaded(UINT64, struct LoadItemResponse*) = 0;
 };
@@ -0,0 +1,165 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/FrameScheduler.cpp
+// The nModules Project
+//
+// Drives every animation and timed update in the shell from a single clock.
+//-------------------------------------------------------------------------------------------------
+#include "FrameScheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+
+FrameScheduler::FrameScheduler(IClock *clock, IHost *host)
+  : mClock(clock)
+  , mHost(host)
+  , mWakeupTime(-1.0)
+  , mInTick(false)
+{
+}
+
+
+double FrameScheduler::GetTime() const {
+  return mClock->GetTime();
+}
+
+
+bool FrameScheduler::IsIdle() const {
+  return mListeners.empty();
+}
+
+
+void FrameScheduler::RemoveSurface(IFrameSurface *surface) {
+  for (auto iter = mListeners.begin(); iter != mListeners.end();) {
+    if (iter->second.surface == surface) {
+      iter = mListeners.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  if (mInTick) {
+    mRemovedSurfaces.insert(surface);
+  } else {
+    UpdateWakeup();
+  }
+}
+
+
+void FrameScheduler::Schedule(IFrameListener *listener, IFrameSurface *surface, double time) {
+  Entry &entry = mListeners[listener];
+  entry.surface = surface;
+  entry.time = time;
+  if (!mInTick) {
+    UpdateWakeup();
+  }
+}
+
+
+void FrameScheduler::SetClock(IClock *clock) {
+  mClock = clock;
+  if (!mInTick) {
+    mWakeupTime = -1.0;
+    UpdateWakeup();
+  }
+}
+
+
+void FrameScheduler::Tick() {
+  const double now = mClock->GetTime();
+  // Timer wakeups are never exact, so anything due within half a frame belongs to this frame.
+  const double frameEnd = now + mClock->GetFrameInterval() / 2;
+
+  mDue.clear();
+  for (auto &listener : mListeners) {
+    if (listener.second.time <= frameEnd) {
+      mDue.emplace_back(listener.second.surface, listener.first);
+    }
+  }
+
+  // Group the listeners by surface, so that each surface is only repainted once.
+  std::sort(mDue.begin(), mDue.end(), [] (const std::pair<IFrameSurface*, IFrameListener*> &a,
+      const std::pair<IFrameSurface*, IFrameListener*> &b) -> bool {
+    // Surfaces are unrelated objects, which only std::less is guaranteed to order.
+    return std::less<IFrameSurface*>()(a.first, b.first);
+  });
+
+  mInTick = true;
+  for (size_t i = 0; i < mDue.size();) {
+    IFrameSurface *surface = mDue[i].first;
+    if (surface && mRemovedSurfaces.count(surface) == 0) {
+      surface->BeginFrame();
+    }
+
+    for (; i < mDue.size() && mDue[i].first == surface; ++i) {
+      IFrameListener *listener = mDue[i].second;
+
+      // Earlier listeners may have unscheduled, or rescheduled, this one.
+      auto entry = mListeners.find(listener);
+      if (entry == mListeners.end() || entry->second.surface != surface
+          || mRemovedSurfaces.count(surface) != 0) {
+        continue;
+      }
+
+      double next = listener->OnFrame(now);
+
+      entry = mListeners.find(listener);
+      if (entry != mListeners.end() && entry->second.surface == surface) {
+        if (next < 0) {
+          mListeners.erase(entry);
+        } else {
+          entry->second.time = next;
+        }
+      }
+    }
+
+    if (surface && mRemovedSurfaces.count(surface) == 0) {
+      surface->EndFrame();
+    }
+  }
+  mInTick = false;
+  mRemovedSurfaces.clear();
+
+  mWakeupTime = -1.0;
+  UpdateWakeup();
+}
+
+
+void FrameScheduler::Unschedule(IFrameListener *listener) {
+  mListeners.erase(listener);
+  if (!mInTick) {
+    UpdateWakeup();
+  }
+}
+
+
+double FrameScheduler::AlignToFrame(double time) const {
+  double interval = mClock->GetFrameInterval();
+  double phase = mClock->GetFramePhase();
+  return phase + ceil((time - phase) / interval) * interval;
+}
+
+
+void FrameScheduler::UpdateWakeup() {
+  if (mListeners.empty()) {
+    if (mWakeupTime >= 0) {
+      mHost->CancelTick();
+      mWakeupTime = -1.0;
+    }
+    return;
+  }
+
+  double earliest = mListeners.begin()->second.time;
+  for (auto &listener : mListeners) {
+    earliest = std::min(earliest, listener.second.time);
+  }
+
+  // Never wake up for the frame we're currently in.
+  const double now = mClock->GetTime();
+  double wakeup = AlignToFrame(std::max(earliest, now + mClock->GetFrameInterval() / 2));
+
+  if (wakeup != mWakeupTime) {
+    mWakeupTime = wakeup;
+    mHost->RequestTick(wakeup - now);
+  }
+}
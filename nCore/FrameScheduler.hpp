@@ -0,0 +1,109 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/FrameScheduler.hpp
+// The nModules Project
+//
+// Drives every animation and timed update in the shell from a single clock.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "IFrameListener.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/// <summary>
+/// Runs all scheduled listeners on a shared frame grid. Listeners which are due in the same frame
+/// are updated together, grouped by surface, and the scheduler requests no wakeups at all while
+/// nothing is scheduled. The clock and the wakeup mechanism are provided by the host, so that the
+/// scheduler itself has no dependency on windowing.
+/// </summary>
+class FrameScheduler {
+public:
+  /// <summary>
+  /// The time source for the scheduler.
+  /// </summary>
+  class IClock {
+  public:
+    // Returns the current time, in seconds. Must be monotonic.
+    virtual double GetTime() = 0;
+
+    // Returns the time between two frames, in seconds.
+    virtual double GetFrameInterval() = 0;
+
+    // Returns the time of any frame boundary, e.g. the last vertical blank.
+    virtual double GetFramePhase() = 0;
+  };
+
+  /// <summary>
+  /// Provides wakeups for the scheduler.
+  /// </summary>
+  class IHost {
+  public:
+    // Tick should be called once, in the given number of seconds. Replaces any earlier request.
+    virtual void RequestTick(double delay) = 0;
+
+    // Tick does not need to be called until the next RequestTick.
+    virtual void CancelTick() = 0;
+  };
+
+public:
+  FrameScheduler(IClock *clock, IHost *host);
+
+  FrameScheduler(const FrameScheduler&) = delete;
+  FrameScheduler &operator=(const FrameScheduler&) = delete;
+
+public:
+  // Returns the current time on the scheduler's clock.
+  double GetTime() const;
+
+  // Returns true if no listeners are scheduled.
+  bool IsIdle() const;
+
+  // Removes every listener painting to the given surface. Call this before destroying a surface.
+  void RemoveSurface(IFrameSurface *surface);
+
+  // Calls the listener on the first frame at or after the given time. Replaces any earlier
+  // schedule for the same listener.
+  void Schedule(IFrameListener *listener, IFrameSurface *surface, double time);
+
+  // Replaces the clock. The new clock should share the time base of the old one.
+  void SetClock(IClock *clock);
+
+  // Runs all due listeners. Called by the host after RequestTick.
+  void Tick();
+
+  // Cancels any calls to the listener.
+  void Unschedule(IFrameListener *listener);
+
+private:
+  struct Entry {
+    IFrameSurface *surface;
+    double time;
+  };
+
+private:
+  // Returns the first frame boundary at or after the given time.
+  double AlignToFrame(double time) const;
+
+  // Asks the host for a wakeup at the next frame which has due listeners.
+  void UpdateWakeup();
+
+private:
+  IClock *mClock;
+  IHost *const mHost;
+
+  std::unordered_map<IFrameListener*, Entry> mListeners;
+
+  // The time of the wakeup requested from the host, or a negative value.
+  double mWakeupTime;
+
+  // True while Tick is running listeners.
+  bool mInTick;
+
+  // Surfaces removed while ticking, which must not be touched for the rest of the tick.
+  std::unordered_set<IFrameSurface*> mRemovedSurfaces;
+
+  // Scratch space for Tick.
+  std::vector<std::pair<IFrameSurface*, IFrameListener*>> mDue;
+};
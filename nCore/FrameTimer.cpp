@@ -0,0 +1,189 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/FrameTimer.cpp
+// The nModules Project
+//
+// Connects the frame scheduler to the performance counter, DWM, and nCore's message window.
+//
+// Exports the following functions:
+//   - double GetFrameTime()
+//   - void RemoveFrameSurface(IFrameSurface*)
+//   - void ScheduleFrame(IFrameListener*, IFrameSurface*, double time)
+//   - void UnscheduleFrame(IFrameListener*)
+//-------------------------------------------------------------------------------------------------
+#include "FrameScheduler.hpp"
+
+#include "../Utilities/Common.h"
+#include "../Utilities/Macros.h"
+
+#include <algorithm>
+#include <dwmapi.h>
+#include <math.h>
+
+extern HWND ghWndMsgHandler;
+
+// The ID of the timer used to wake up the frame scheduler.
+static const UINT_PTR FRAME_TIMER_ID = 2;
+
+// Used when DWM can't tell us the refresh rate, e.g. when composition is disabled.
+static const double DEFAULT_FRAME_INTERVAL = 1.0 / 60.0;
+
+
+/// <summary>
+/// Reads the time from the performance counter, and the frame grid from DWM.
+/// </summary>
+class Win32FrameClock : public FrameScheduler::IClock {
+public:
+  Win32FrameClock() {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    mFrequency = double(frequency.QuadPart);
+    mInterval = DEFAULT_FRAME_INTERVAL;
+    mPhase = 0;
+    Update();
+  }
+
+public:
+  double GetTime() override {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return double(counter.QuadPart) / mFrequency;
+  }
+
+  double GetFrameInterval() override {
+    return mInterval;
+  }
+
+  double GetFramePhase() override {
+    return mPhase;
+  }
+
+public:
+  // Re-reads the refresh period and the time of the last vertical blank.
+  void Update() {
+    DWM_TIMING_INFO info;
+    ZeroMemory(&info, sizeof(DWM_TIMING_INFO));
+    info.cbSize = sizeof(DWM_TIMING_INFO);
+    if (SUCCEEDED(DwmGetCompositionTimingInfo(nullptr, &info)) && info.qpcRefreshPeriod > 0) {
+      mInterval = double(info.qpcRefreshPeriod) / mFrequency;
+      mPhase = double(info.qpcVBlank) / mFrequency;
+    } else {
+      DEVMODEW mode;
+      ZeroMemory(&mode, sizeof(DEVMODEW));
+      mode.dmSize = sizeof(DEVMODEW);
+      if (EnumDisplaySettingsW(nullptr, ENUM_CURRENT_SETTINGS, &mode) && mode.dmDisplayFrequency > 1) {
+        mInterval = 1.0 / mode.dmDisplayFrequency;
+      } else {
+        mInterval = DEFAULT_FRAME_INTERVAL;
+      }
+    }
+  }
+
+private:
+  double mFrequency;
+  double mInterval;
+  double mPhase;
+};
+
+
+/// <summary>
+/// Wakes the scheduler up with a timer on nCore's message window.
+/// </summary>
+/// <remarks>
+/// Window timers are only accurate to the system timer resolution, which is why the scheduler
+/// treats anything due within half a frame as belonging to the current frame.
+/// </remarks>
+class Win32FrameHost : public FrameScheduler::IHost {
+public:
+  void RequestTick(double delay) override {
+    UINT ms = UINT(std::max(0.0, floor(delay * 1000.0)));
+    SetTimer(ghWndMsgHandler, FRAME_TIMER_ID, std::max(ms, UINT(USER_TIMER_MINIMUM)), nullptr);
+  }
+
+  void CancelTick() override {
+    KillTimer(ghWndMsgHandler, FRAME_TIMER_ID);
+  }
+};
+
+
+static Win32FrameClock *sClock = nullptr;
+static Win32FrameHost sHost;
+static FrameScheduler *sScheduler = nullptr;
+
+
+/// <summary>
+/// Creates the frame scheduler. Called once the message window exists.
+/// </summary>
+void InitializeFrameTimer() {
+  sClock = new Win32FrameClock();
+  sScheduler = new FrameScheduler(sClock, &sHost);
+}
+
+
+/// <summary>
+/// Destroys the frame scheduler.
+/// </summary>
+void ShutdownFrameTimer() {
+  sHost.CancelTick();
+  SAFEDELETE(sScheduler);
+  SAFEDELETE(sClock);
+}
+
+
+/// <summary>
+/// Handles WM_TIMER for nCore's message window.
+/// </summary>
+/// <returns>True if the timer belonged to the frame scheduler.</returns>
+bool HandleFrameTimer(UINT_PTR timer) {
+  if (timer != FRAME_TIMER_ID || !sScheduler) {
+    return false;
+  }
+
+  // The timer is a one-shot wakeup. The scheduler sets it again if it has more work.
+  KillTimer(ghWndMsgHandler, FRAME_TIMER_ID);
+  sClock->Update();
+  sScheduler->Tick();
+  return true;
+}
+
+
+/// <summary>
+/// Picks up changes to the refresh rate.
+/// </summary>
+void FrameTimerDisplayChange() {
+  if (sClock) {
+    sClock->Update();
+    sScheduler->SetClock(sClock);
+  }
+}
+
+
+/// <summary>
+/// Returns the current time on the frame scheduler's clock, in seconds.
+/// </summary>
+EXPORT_CDECL(double) GetFrameTime() {
+  return sScheduler->GetTime();
+}
+
+
+/// <summary>
+/// Removes every listener drawing to the given surface.
+/// </summary>
+EXPORT_CDECL(void) RemoveFrameSurface(IFrameSurface *surface) {
+  sScheduler->RemoveSurface(surface);
+}
+
+
+/// <summary>
+/// Calls the listener on the first frame at or after the given time.
+/// </summary>
+EXPORT_CDECL(void) ScheduleFrame(IFrameListener *listener, IFrameSurface *surface, double time) {
+  sScheduler->Schedule(listener, surface, time);
+}
+
+
+/// <summary>
+/// Stops calling the listener.
+/// </summary>
+EXPORT_CDECL(void) UnscheduleFrame(IFrameListener *listener) {
+  sScheduler->Unschedule(listener);
+}
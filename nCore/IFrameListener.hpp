@@ -0,0 +1,41 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/IFrameListener.hpp
+// The nModules Project
+//
+// Interfaces for objects which are driven by nCore's frame scheduler.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+/// <summary>
+/// Something which should be updated on specific frames, e.g. an animation.
+/// </summary>
+class IFrameListener {
+public:
+  /// <summary>
+  /// Called by the frame scheduler when the listener is due.
+  /// </summary>
+  /// <param name="time">The time of the frame, in seconds, on the scheduler's clock.</param>
+  /// <returns>
+  /// The time at which the listener wants to be called again. Any time before the next frame,
+  /// e.g. the time passed in, means the next frame. A negative value unschedules the listener.
+  /// </returns>
+  virtual double OnFrame(double time) = 0;
+};
+
+/// <summary>
+/// Something that listeners paint to, typically a top-level window. All listeners sharing a
+/// surface are updated between a single BeginFrame/EndFrame pair, so that a surface is repainted
+/// at most once per frame.
+/// </summary>
+class IFrameSurface {
+public:
+  /// <summary>
+  /// Called before any listener on this surface is updated.
+  /// </summary>
+  virtual void BeginFrame() = 0;
+
+  /// <summary>
+  /// Called after all listeners on this surface have been updated for this frame.
+  /// </summary>
+  virtual void EndFrame() = 0;
+};
@@ -0,0 +1,186 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/IconLoader.cpp
+// The nModules Project
+//
+// Connects the icon store to HICONs.
+//
+// Exports the following functions:
+//   - HICON FindIcon(LPCWSTR path, int index, UINT size)
+//   - void GetIconStoreStatistics(IconStore::Statistics*)
+//   - void ReleaseIcon(HICON)
+//   - HICON StoreIcon(LPCWSTR path, int index, UINT size, HICON)
+//-------------------------------------------------------------------------------------------------
+#include "IconStore.hpp"
+
+#include "../nShared/LiteStep.h"
+
+#include "../Utilities/Common.h"
+#include "../Utilities/Hashing.h"
+#include "../Utilities/Macros.h"
+
+#include <algorithm>
+#include <mutex>
+
+// The default memory budget of the icon store, in megabytes.
+static const int DEFAULT_STORE_SIZE = 16;
+
+static IconStore *sStore = nullptr;
+
+// Modules may look up icons from their own threads.
+static std::mutex sStoreLock;
+
+
+/// <summary>
+/// Reads the bits of one of an icon's bitmaps, as 32bpp top-down rows.
+/// </summary>
+static bool ReadBits(HDC dc, HBITMAP bitmap, LONG width, LONG height, std::vector<BYTE> *bits) {
+  BITMAPINFO info;
+  ZeroMemory(&info, sizeof(info));
+  info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+  info.bmiHeader.biWidth = width;
+  info.bmiHeader.biHeight = -height;
+  info.bmiHeader.biPlanes = 1;
+  info.bmiHeader.biBitCount = 32;
+  info.bmiHeader.biCompression = BI_RGB;
+
+  bits->resize(size_t(width) * height * 4);
+  return GetDIBits(dc, bitmap, 0, UINT(height), bits->data(), &info, DIB_RGB_COLORS) != 0;
+}
+
+
+/// <summary>
+/// Hashes what an icon looks like, and estimates the memory it uses.
+/// </summary>
+static bool HashIcon(HICON icon, uint64_t *hash, size_t *cost) {
+  ICONINFO iconInfo;
+  if (!GetIconInfo(icon, &iconInfo)) {
+    return false;
+  }
+
+  // Monochrome icons have no color bitmap, just a mask which holds both.
+  BITMAP bitmap;
+  bool success = GetObjectW(iconInfo.hbmColor ? iconInfo.hbmColor : iconInfo.hbmMask,
+    sizeof(BITMAP), &bitmap) != 0;
+
+  if (success) {
+    HDC dc = CreateCompatibleDC(nullptr);
+    std::vector<BYTE> bits;
+    LONG dimensions[] = { bitmap.bmWidth, bitmap.bmHeight };
+    *hash = Hashing::Crc64(dimensions, sizeof(dimensions));
+    if (iconInfo.hbmColor) {
+      success = ReadBits(dc, iconInfo.hbmColor, bitmap.bmWidth, bitmap.bmHeight, &bits);
+      *hash = Hashing::Crc64(bits.data(), bits.size(), *hash);
+    }
+    if (success) {
+      success = ReadBits(dc, iconInfo.hbmMask, bitmap.bmWidth, bitmap.bmHeight, &bits);
+      *hash = Hashing::Crc64(bits.data(), bits.size(), *hash);
+    }
+    DeleteDC(dc);
+    *cost = size_t(bitmap.bmWidth) * bitmap.bmHeight * 4;
+  }
+
+  if (iconInfo.hbmColor) {
+    DeleteObject(iconInfo.hbmColor);
+  }
+  DeleteObject(iconInfo.hbmMask);
+  return success;
+}
+
+
+/// <summary>
+/// Creates the icon store.
+/// </summary>
+void InitializeIconStore() {
+  int megabytes = LiteStep::GetRCInt(L"nCoreIconStoreSize", DEFAULT_STORE_SIZE);
+  sStore = new IconStore(size_t(std::max(megabytes, 0)) * 1024 * 1024, [] (IconStore::Icon icon) {
+    DestroyIcon(HICON(icon));
+  });
+}
+
+
+/// <summary>
+/// Destroys the icon store, and every icon in it. Every module should have released its icons by
+/// now.
+/// </summary>
+void ShutdownIconStore() {
+  std::lock_guard<std::mutex> lock(sStoreLock);
+  if (sStore) {
+    IconStore::Statistics statistics = sStore->GetStatistics();
+    TRACE("Icon store: %llu hits, %llu misses, %llu shared, %llu evictions", statistics.hits,
+      statistics.misses, statistics.shared, statistics.evictions);
+  }
+  SAFEDELETE(sStore);
+}
+
+
+/// <summary>
+/// Retrieves the icon which was last stored for the given location. The icon must be released
+/// with ReleaseIcon.
+/// </summary>
+/// <param name="path">The file the icon was extracted from.</param>
+/// <param name="index">The index of the icon in the file.</param>
+/// <param name="size">The size the icon was extracted at.</param>
+/// <returns>The icon, or nullptr if it hasn't been stored.</returns>
+EXPORT_CDECL(HICON) FindIcon(LPCWSTR path, int index, UINT size) {
+  std::lock_guard<std::mutex> lock(sStoreLock);
+  if (!sStore || path == nullptr) {
+    return nullptr;
+  }
+  IconStore::Location location = { path, index, size };
+  return HICON(sStore->Find(location));
+}
+
+
+/// <summary>
+/// Adds an icon to the store, which takes ownership of it. If an icon which looks the same is
+/// already stored, the given icon is destroyed and the stored one is returned instead. Either way,
+/// the returned icon must be released with ReleaseIcon, and not destroyed.
+/// </summary>
+/// <param name="path">The file the icon was extracted from, or nullptr if it didn't come from a
+/// file, e.g. for window icons.</param>
+EXPORT_CDECL(HICON) StoreIcon(LPCWSTR path, int index, UINT size, HICON icon) {
+  uint64_t hash;
+  size_t cost;
+  if (icon == nullptr) {
+    return nullptr;
+  }
+  if (!HashIcon(icon, &hash, &cost)) {
+    // Keep it anyway, so that it is destroyed like any other icon. It just won't be shared.
+    hash = uint64_t(UINT_PTR(icon)) | 1ULL << 63;
+    cost = 0;
+  }
+
+  std::lock_guard<std::mutex> lock(sStoreLock);
+  if (!sStore) {
+    return icon;
+  }
+  if (path == nullptr) {
+    return HICON(sStore->Insert(nullptr, icon, hash, cost));
+  }
+  IconStore::Location location = { path, index, size };
+  return HICON(sStore->Insert(&location, icon, hash, cost));
+}
+
+
+/// <summary>
+/// Releases an icon returned by FindIcon or StoreIcon.
+/// </summary>
+EXPORT_CDECL(void) ReleaseIcon(HICON icon) {
+  std::lock_guard<std::mutex> lock(sStoreLock);
+  if (sStore) {
+    sStore->Release(icon);
+  }
+}
+
+
+/// <summary>
+/// Retrieves the number of hits, misses, shared icons and evictions since nCore was loaded.
+/// </summary>
+EXPORT_CDECL(void) GetIconStoreStatistics(IconStore::Statistics *statistics) {
+  std::lock_guard<std::mutex> lock(sStoreLock);
+  if (sStore) {
+    *statistics = sStore->GetStatistics();
+  } else {
+    ZeroMemory(statistics, sizeof(IconStore::Statistics));
+  }
+}
@@ -0,0 +1,197 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/IconStore.cpp
+// The nModules Project
+//
+// Keeps icons in memory, so that they can be shared between modules.
+//-------------------------------------------------------------------------------------------------
+#include "IconStore.hpp"
+
+#include <algorithm>
+#include <wctype.h>
+
+
+IconStore::IconStore(size_t budget, std::function<void(Icon)> destroy)
+  : mDestroy(destroy)
+  , mBudget(budget)
+  , mCost(0)
+{
+  mStatistics.hits = 0;
+  mStatistics.misses = 0;
+  mStatistics.shared = 0;
+  mStatistics.evictions = 0;
+}
+
+
+IconStore::~IconStore() {
+  for (Entry &entry : mEntries) {
+    mDestroy(entry.icon);
+  }
+}
+
+
+IconStore::Icon IconStore::Find(const Location &location) {
+  auto iter = mByLocation.find(Normalize(location));
+  if (iter == mByLocation.end()) {
+    ++mStatistics.misses;
+    return nullptr;
+  }
+
+  ++mStatistics.hits;
+  return Use(iter->second);
+}
+
+
+IconStore::Icon IconStore::Insert(const Location *location, Icon icon, uint64_t contentHash,
+    size_t cost) {
+  EntryList::iterator entry;
+  auto same = mByContent.find(contentHash);
+  if (same != mByContent.end()) {
+    // The same icon may be added twice, e.g. if it was released and found again.
+    if (same->second->icon != icon) {
+      mDestroy(icon);
+      ++mStatistics.shared;
+    }
+    entry = same->second;
+    Use(entry);
+  } else {
+    mEntries.emplace_front();
+    entry = mEntries.begin();
+    entry->icon = icon;
+    entry->contentHash = contentHash;
+    entry->cost = cost;
+    entry->refs = 1;
+
+    mByContent.emplace(contentHash, entry);
+    mByIcon.emplace(icon, entry);
+    mCost += cost;
+  }
+
+  if (location != nullptr) {
+    SetLocation(Normalize(*location), entry);
+  }
+
+  Trim();
+
+  return entry->icon;
+}
+
+
+void IconStore::Release(Icon icon) {
+  auto iter = mByIcon.find(icon);
+  if (iter == mByIcon.end()) {
+    return;
+  }
+
+  EntryList::iterator entry = iter->second;
+  if (--entry->refs > 0) {
+    return;
+  }
+
+  // Unreferenced entries are evicted from the back, so this one goes last.
+  mEntries.splice(mEntries.begin(), mEntries, entry);
+  Trim();
+}
+
+
+void IconStore::Clear() {
+  for (auto iter = mEntries.begin(); iter != mEntries.end();) {
+    auto next = std::next(iter);
+    if (iter->refs == 0) {
+      Destroy(iter);
+    }
+    iter = next;
+  }
+}
+
+
+void IconStore::SetBudget(size_t budget) {
+  mBudget = budget;
+  Trim();
+}
+
+
+size_t IconStore::GetCost() const {
+  return mCost;
+}
+
+
+size_t IconStore::GetCount() const {
+  return mEntries.size();
+}
+
+
+IconStore::Statistics IconStore::GetStatistics() const {
+  return mStatistics;
+}
+
+
+IconStore::Location IconStore::Normalize(const Location &location) {
+  Location normalized = location;
+  std::transform(normalized.path.begin(), normalized.path.end(), normalized.path.begin(),
+    towlower);
+  return normalized;
+}
+
+
+IconStore::Icon IconStore::Use(EntryList::iterator entry) {
+  ++entry->refs;
+  mEntries.splice(mEntries.begin(), mEntries, entry);
+  return entry->icon;
+}
+
+
+void IconStore::SetLocation(const Location &location, EntryList::iterator entry) {
+  auto iter = mByLocation.find(location);
+  if (iter != mByLocation.end()) {
+    if (iter->second == entry) {
+      return;
+    }
+
+    // The file's icon has changed.
+    std::vector<Location> &locations = iter->second->locations;
+    locations.erase(std::find(locations.begin(), locations.end(), location));
+    iter->second = entry;
+  } else {
+    mByLocation.emplace(location, entry);
+  }
+  entry->locations.push_back(location);
+}
+
+
+void IconStore::Destroy(EntryList::iterator entry) {
+  for (const Location &location : entry->locations) {
+    mByLocation.erase(location);
+  }
+  mByContent.erase(entry->contentHash);
+  mByIcon.erase(entry->icon);
+  mCost -= entry->cost;
+  mDestroy(entry->icon);
+  mEntries.erase(entry);
+}
+
+
+void IconStore::Trim() {
+  for (auto iter = mEntries.end(); mCost > mBudget && iter != mEntries.begin();) {
+    --iter;
+    if (iter->refs == 0) {
+      EntryList::iterator victim = iter;
+      // Step forward again, since the victim is about to be erased.
+      ++iter;
+      Destroy(victim);
+      ++mStatistics.evictions;
+    }
+  }
+}
+
+
+bool IconStore::Location::operator==(const Location &other) const {
+  return index == other.index && size == other.size && path == other.path;
+}
+
+
+size_t IconStore::LocationHash::operator()(const Location &location) const {
+  size_t hash = std::hash<std::wstring>()(location.path);
+  hash = hash * 31 + size_t(location.index);
+  hash = hash * 31 + location.size;
+  return hash;
+}
@@ -0,0 +1,129 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/IconStore.hpp
+// The nModules Project
+//
+// Keeps icons in memory, so that they can be shared between modules.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <functional>
+#include <list>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// A refcounted store of icons. Icons are found by the location they were extracted from, i.e. a
+/// path, an index in that file, and a size. Icons which look the same are only kept once, however
+/// many locations or windows they came from. Icons which nobody holds on to are kept around, least
+/// recently used first, until the store goes over its memory budget.
+///
+/// Icons are opaque handles to the store. Not thread safe.
+/// </summary>
+class IconStore {
+public:
+  typedef void *Icon;
+
+  struct Location {
+    // Compared case insensitively.
+    std::wstring path;
+    int index;
+    uint32_t size;
+
+    bool operator==(const Location &other) const;
+  };
+
+  struct Statistics {
+    // Lookups by location.
+    uint64_t hits;
+    uint64_t misses;
+
+    // Icons which were added, but turned out to look the same as one already in the store.
+    uint64_t shared;
+
+    // Icons which were destroyed to stay within the memory budget.
+    uint64_t evictions;
+  };
+
+public:
+  /// <param name="budget">The number of bytes the icons may use.</param>
+  /// <param name="destroy">Frees icons which are no longer needed.</param>
+  IconStore(size_t budget, std::function<void(Icon)> destroy);
+
+  // Destroys every icon, whether it is referenced or not.
+  ~IconStore();
+
+  IconStore(const IconStore&) = delete;
+  IconStore &operator=(const IconStore&) = delete;
+
+public:
+  // Returns the icon last added for the given location, or nullptr. Every icon returned must be
+  // passed to Release.
+  Icon Find(const Location &location);
+
+  // Adds an icon, and takes ownership of it. The location may be nullptr, for icons which didn't
+  // come from a file. If an icon with the same contents is already in the store, the given icon is
+  // destroyed, and the stored one is returned instead. Either way, the returned icon must be passed
+  // to Release.
+  Icon Insert(const Location *location, Icon icon, uint64_t contentHash, size_t cost);
+
+  // Gives up a reference to an icon.
+  void Release(Icon icon);
+
+  // Destroys every icon which isn't referenced.
+  void Clear();
+
+  // Changes the memory budget, destroying unreferenced icons if necessary.
+  void SetBudget(size_t budget);
+
+public:
+  size_t GetCost() const;
+  size_t GetCount() const;
+  Statistics GetStatistics() const;
+
+private:
+  struct LocationHash {
+    size_t operator()(const Location &location) const;
+  };
+
+  struct Entry {
+    Icon icon;
+    uint64_t contentHash;
+    size_t cost;
+    unsigned refs;
+    // Every location which leads to this icon.
+    std::vector<Location> locations;
+  };
+
+  typedef std::list<Entry> EntryList;
+
+private:
+  // Lower cases the path of a location.
+  static Location Normalize(const Location &location);
+
+  // Moves an entry to the front of the list, and adds a reference to it.
+  Icon Use(EntryList::iterator entry);
+
+  // Points a location at an entry, instead of whichever one it led to before.
+  void SetLocation(const Location &location, EntryList::iterator entry);
+
+  // Removes an entry, and destroys its icon.
+  void Destroy(EntryList::iterator entry);
+
+  // Destroys unreferenced icons, least recently used first, until the store is within its budget.
+  void Trim();
+
+private:
+  const std::function<void(Icon)> mDestroy;
+  size_t mBudget;
+  size_t mCost;
+  Statistics mStatistics;
+
+  // Most recently used first.
+  EntryList mEntries;
+  std::unordered_map<Location, EntryList::iterator, LocationHash> mByLocation;
+  std::unordered_map<uint64_t, EntryList::iterator> mByContent;
+  std::unordered_map<Icon, EntryList::iterator> mByIcon;
+};
@@ -0,0 +1,322 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ImageCache.cpp
+// The nModules Project
+//
+// Keeps decoded images in memory, so that they can be shared between windows and modules.
+//-------------------------------------------------------------------------------------------------
+#include "ImageCache.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <math.h>
+#include <wctype.h>
+
+
+ImageCache::ImageCache(IDecoder *decoder, size_t budget)
+  : mDecoder(decoder)
+  , mBudget(budget)
+  , mCost(0)
+{
+}
+
+
+const CachedImage *ImageCache::Acquire(const wchar_t *path, uint32_t width, uint32_t height) {
+  if (width == 0 || height == 0) {
+    width = height = 0;
+  }
+
+  Key key;
+  key.path = path;
+  std::transform(key.path.begin(), key.path.end(), key.path.begin(), towlower);
+  key.width = width;
+  key.height = height;
+
+  uint64_t modifiedTime;
+  if (!mDecoder->GetModifiedTime(path, &modifiedTime)) {
+    modifiedTime = 0;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (const CachedImage *image = Find(key, modifiedTime)) {
+      return image;
+    }
+  }
+
+  // Decode or scale without the lock.
+  std::vector<uint8_t> pixels;
+  if (width == 0) {
+    if (!mDecoder->Decode(path, &width, &height, &pixels) || width == 0 || height == 0
+        || pixels.size() < size_t(width) * height * 4) {
+      return nullptr;
+    }
+  } else {
+    // Scaled variants are made from the original, which stays cached for other sizes.
+    const CachedImage *source = Acquire(path, 0, 0);
+    if (source == nullptr) {
+      return nullptr;
+    }
+    if (source->width == width && source->height == height) {
+      return source;
+    }
+
+    pixels.resize(size_t(width) * height * 4);
+    Resample(source->pixels, source->width, source->height, source->stride, pixels.data(), width,
+      height, width * 4);
+    Release(source);
+  }
+
+  std::lock_guard<std::mutex> lock(mLock);
+
+  // Another thread may have loaded the same image in the meantime. Keep the image it got.
+  if (const CachedImage *image = Find(key, modifiedTime)) {
+    return image;
+  }
+  return Insert(std::move(key), modifiedTime, width, height, std::move(pixels));
+}
+
+
+void ImageCache::Release(const CachedImage *image) {
+  std::lock_guard<std::mutex> lock(mLock);
+  auto iter = mByImage.find(image);
+  if (iter == mByImage.end()) {
+    return;
+  }
+
+  EntryList::iterator entry = iter->second;
+  if (--entry->refs > 0) {
+    return;
+  }
+
+  if (!entry->indexed) {
+    mCost -= entry->buffer.size();
+    mByImage.erase(iter);
+    mEntries.erase(entry);
+    return;
+  }
+
+  // Unreferenced entries are evicted from the back, so this one goes last.
+  mEntries.splice(mEntries.begin(), mEntries, entry);
+  Trim();
+}
+
+
+void ImageCache::Clear() {
+  std::lock_guard<std::mutex> lock(mLock);
+  for (auto iter = mEntries.begin(); iter != mEntries.end();) {
+    auto next = std::next(iter);
+    if (iter->indexed && iter->refs == 0) {
+      Detach(iter);
+    }
+    iter = next;
+  }
+}
+
+
+void ImageCache::SetBudget(size_t budget) {
+  std::lock_guard<std::mutex> lock(mLock);
+  mBudget = budget;
+  Trim();
+}
+
+
+size_t ImageCache::GetCost() const {
+  std::lock_guard<std::mutex> lock(mLock);
+  return mCost;
+}
+
+
+size_t ImageCache::GetCount() const {
+  std::lock_guard<std::mutex> lock(mLock);
+  return mEntries.size();
+}
+
+
+const CachedImage *ImageCache::Find(const Key &key, uint64_t modifiedTime) {
+  auto iter = mIndex.find(key);
+  if (iter == mIndex.end()) {
+    return nullptr;
+  }
+
+  Entry &entry = *iter->second;
+  if (entry.modifiedTime != modifiedTime) {
+    Detach(iter->second);
+    return nullptr;
+  }
+
+  ++entry.refs;
+  mEntries.splice(mEntries.begin(), mEntries, iter->second);
+  return &entry;
+}
+
+
+const CachedImage *ImageCache::Insert(Key &&key, uint64_t modifiedTime, uint32_t width,
+    uint32_t height, std::vector<uint8_t> &&pixels) {
+  mEntries.emplace_front();
+  Entry &entry = mEntries.front();
+  entry.key = std::move(key);
+  entry.modifiedTime = modifiedTime;
+  entry.buffer = std::move(pixels);
+  entry.refs = 1;
+  entry.indexed = true;
+  entry.width = width;
+  entry.height = height;
+  entry.stride = width * 4;
+  entry.pixels = entry.buffer.data();
+
+  mIndex.emplace(entry.key, mEntries.begin());
+  mByImage.emplace(&entry, mEntries.begin());
+  mCost += entry.buffer.size();
+
+  Trim();
+
+  return &entry;
+}
+
+
+void ImageCache::Detach(EntryList::iterator entry) {
+  mIndex.erase(entry->key);
+  entry->indexed = false;
+  if (entry->refs == 0) {
+    mCost -= entry->buffer.size();
+    mByImage.erase(&*entry);
+    mEntries.erase(entry);
+  }
+}
+
+
+void ImageCache::Trim() {
+  for (auto iter = mEntries.end(); mCost > mBudget && iter != mEntries.begin();) {
+    --iter;
+    if (iter->refs == 0) {
+      EntryList::iterator victim = iter;
+      // Step forward again, since the victim is about to be erased.
+      ++iter;
+      Detach(victim);
+    }
+  }
+}
+
+
+/// <summary>
+/// The source pixels, and their weights, which make up one destination pixel.
+/// </summary>
+struct ResampleTap {
+  uint32_t first;
+  uint32_t count;
+  // Index of the first weight in the weight list.
+  size_t weights;
+};
+
+
+/// <summary>
+/// Computes the tent filter taps for scaling a row or column of source pixels to dest pixels.
+/// </summary>
+static void ComputeTaps(uint32_t source, uint32_t dest, std::vector<ResampleTap> &taps,
+    std::vector<float> &weights) {
+  const double scale = double(dest) / double(source);
+  // When shrinking, the filter covers every source pixel which falls in the destination pixel.
+  const double support = scale < 1.0 ? 1.0 / scale : 1.0;
+
+  taps.resize(dest);
+  weights.clear();
+  for (uint32_t i = 0; i < dest; ++i) {
+    const double center = (i + 0.5) / scale;
+    int64_t first = std::max<int64_t>(0, int64_t(floor(center - support)));
+    int64_t last = std::min<int64_t>(source - 1, int64_t(ceil(center + support)));
+
+    ResampleTap &tap = taps[i];
+    tap.weights = weights.size();
+    tap.first = uint32_t(first);
+    tap.count = 0;
+
+    float total = 0.0f;
+    for (int64_t x = first; x <= last; ++x) {
+      float weight = float(std::max(0.0, 1.0 - fabs(x + 0.5 - center) / support));
+      if (weight > 0.0f || tap.count > 0) {
+        if (tap.count == 0) {
+          tap.first = uint32_t(x);
+        }
+        weights.push_back(weight);
+        total += weight;
+        ++tap.count;
+      }
+    }
+
+    if (total > 0.0f) {
+      for (size_t w = tap.weights; w < weights.size(); ++w) {
+        weights[w] /= total;
+      }
+    } else {
+      // Can't happen with a tent this wide, but fall back to the nearest pixel rather than black.
+      weights.resize(tap.weights);
+      weights.push_back(1.0f);
+      tap.first = uint32_t(std::min<int64_t>(source - 1, int64_t(center)));
+      tap.count = 1;
+    }
+  }
+}
+
+
+void ImageCache::Resample(const uint8_t *source, uint32_t sourceWidth, uint32_t sourceHeight,
+    uint32_t sourceStride, uint8_t *dest, uint32_t destWidth, uint32_t destHeight,
+    uint32_t destStride) {
+  std::vector<ResampleTap> taps;
+  std::vector<float> weights;
+
+  // Scale horizontally into an intermediate buffer of destWidth x sourceHeight.
+  std::vector<float> rows(size_t(destWidth) * sourceHeight * 4);
+  ComputeTaps(sourceWidth, destWidth, taps, weights);
+  for (uint32_t y = 0; y < sourceHeight; ++y) {
+    const uint8_t *in = source + size_t(y) * sourceStride;
+    float *out = rows.data() + size_t(y) * destWidth * 4;
+    for (uint32_t x = 0; x < destWidth; ++x, out += 4) {
+      const ResampleTap &tap = taps[x];
+      float sum[4] = { 0, 0, 0, 0 };
+      for (uint32_t i = 0; i < tap.count; ++i) {
+        const uint8_t *pixel = in + size_t(tap.first + i) * 4;
+        const float weight = weights[tap.weights + i];
+        for (int c = 0; c < 4; ++c) {
+          sum[c] += pixel[c] * weight;
+        }
+      }
+      std::copy(sum, sum + 4, out);
+    }
+  }
+
+  // Then vertically into the destination.
+  ComputeTaps(sourceHeight, destHeight, taps, weights);
+  for (uint32_t y = 0; y < destHeight; ++y) {
+    const ResampleTap &tap = taps[y];
+    uint8_t *out = dest + size_t(y) * destStride;
+    for (uint32_t x = 0; x < destWidth; ++x, out += 4) {
+      float sum[4] = { 0, 0, 0, 0 };
+      for (uint32_t i = 0; i < tap.count; ++i) {
+        const float *pixel = rows.data() + (size_t(tap.first + i) * destWidth + x) * 4;
+        const float weight = weights[tap.weights + i];
+        for (int c = 0; c < 4; ++c) {
+          sum[c] += pixel[c] * weight;
+        }
+      }
+      // Keep the color channels premultiplied, i.e. never brighter than alpha.
+      const float alpha = std::min(255.0f, std::max(0.0f, sum[3]));
+      for (int c = 0; c < 3; ++c) {
+        out[c] = uint8_t(std::min(alpha, std::max(0.0f, sum[c])) + 0.5f);
+      }
+      out[3] = uint8_t(alpha + 0.5f);
+    }
+  }
+}
+
+
+bool ImageCache::Key::operator==(const Key &other) const {
+  return width == other.width && height == other.height && path == other.path;
+}
+
+
+size_t ImageCache::KeyHash::operator()(const Key &key) const {
+  size_t hash = std::hash<std::wstring>()(key.path);
+  hash = hash * 31 + key.width;
+  hash = hash * 31 + key.height;
+  return hash;
+}
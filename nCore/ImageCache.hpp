@@ -0,0 +1,129 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ImageCache.hpp
+// The nModules Project
+//
+// Keeps decoded images in memory, so that they can be shared between windows and modules.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "CachedImage.hpp"
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// A refcounted cache of decoded images, in premultiplied 32bpp BGRA. Images are keyed on their
+/// path and the size they were scaled to, and are decoded again when the file's modification time
+/// changes. Images which nobody holds on to are kept around, least recently used first, until the
+/// cache goes over its memory budget.
+///
+/// Thread safe. Images are decoded and scaled without holding the lock, so that a slow decode
+/// never holds up other threads. If two threads load the same image at once, the first one to
+/// finish wins, and the other one's pixels are thrown away.
+/// </summary>
+class ImageCache {
+public:
+  /// <summary>
+  /// Reads images from disk. May be called from several threads at once.
+  /// </summary>
+  class IDecoder {
+  public:
+    // Retrieves the last modification time of the file. Returns false if it can't be determined,
+    // e.g. because the path isn't a plain file.
+    virtual bool GetModifiedTime(const wchar_t *path, uint64_t *time) = 0;
+
+    // Decodes the image into tightly packed, premultiplied 32bpp BGRA.
+    virtual bool Decode(const wchar_t *path, uint32_t *width, uint32_t *height,
+      std::vector<uint8_t> *pixels) = 0;
+  };
+
+public:
+  /// <param name="decoder">Decodes images. Must outlive the cache.</param>
+  /// <param name="budget">The number of bytes the cached pixels may use.</param>
+  ImageCache(IDecoder *decoder, size_t budget);
+
+  ImageCache(const ImageCache&) = delete;
+  ImageCache &operator=(const ImageCache&) = delete;
+
+public:
+  // Returns the image scaled to the given size, decoding and scaling it if necessary. A width or
+  // height of 0 gives the image at its original size. Returns nullptr if the image can't be loaded.
+  // Every image returned must be passed to Release.
+  const CachedImage *Acquire(const wchar_t *path, uint32_t width, uint32_t height);
+
+  // Gives up a reference to an image.
+  void Release(const CachedImage *image);
+
+  // Drops every image which isn't referenced.
+  void Clear();
+
+  // Changes the memory budget, evicting unreferenced images if necessary.
+  void SetBudget(size_t budget);
+
+public:
+  size_t GetCost() const;
+  size_t GetCount() const;
+
+public:
+  // Scales premultiplied 32bpp pixels with a tent filter, which averages when shrinking and
+  // interpolates linearly when enlarging.
+  static void Resample(const uint8_t *source, uint32_t sourceWidth, uint32_t sourceHeight,
+    uint32_t sourceStride, uint8_t *dest, uint32_t destWidth, uint32_t destHeight,
+    uint32_t destStride);
+
+private:
+  struct Key {
+    std::wstring path;
+    uint32_t width;
+    uint32_t height;
+
+    bool operator==(const Key &other) const;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+
+  struct Entry : public CachedImage {
+    Key key;
+    uint64_t modifiedTime;
+    std::vector<uint8_t> buffer;
+    unsigned refs;
+    // False once the file has changed, and the entry only lives on until it is released.
+    bool indexed;
+  };
+
+  typedef std::list<Entry> EntryList;
+
+private:
+  // Returns the entry for the key, with a new reference, if it is up to date. Entries for older
+  // versions of the file are detached. Requires the lock.
+  const CachedImage *Find(const Key &key, uint64_t modifiedTime);
+
+  // Adds an entry for the given pixels, with a single reference. Requires the lock.
+  const CachedImage *Insert(Key &&key, uint64_t modifiedTime, uint32_t width, uint32_t height,
+    std::vector<uint8_t> &&pixels);
+
+  // Removes an entry from the index, and frees it if nobody references it.
+  void Detach(EntryList::iterator entry);
+
+  // Frees unreferenced entries, least recently used first, until the cache is within its budget.
+  void Trim();
+
+private:
+  IDecoder *const mDecoder;
+
+  // Protects everything below.
+  mutable std::mutex mLock;
+
+  size_t mBudget;
+  size_t mCost;
+
+  // Most recently used first.
+  EntryList mEntries;
+  std::unordered_map<Key, EntryList::iterator, KeyHash> mIndex;
+  std::unordered_map<const CachedImage*, EntryList::iterator> mByImage;
+};
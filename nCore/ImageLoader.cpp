@@ -0,0 +1,123 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ImageLoader.cpp
+// The nModules Project
+//
+// Connects the image cache to LiteStep's image loading and WIC.
+//
+// Exports the following functions:
+//   - const CachedImage *AcquireImage(LPCWSTR path, UINT width, UINT height)
+//   - void ReleaseImage(const CachedImage*)
+//-------------------------------------------------------------------------------------------------
+#include "ImageCache.hpp"
+
+#include "../nShared/Factories.h"
+#include "../nShared/LiteStep.h"
+
+#include "../Utilities/Common.h"
+#include "../Utilities/Macros.h"
+
+#include <algorithm>
+#include <wincodec.h>
+
+// The default memory budget of the image cache, in megabytes.
+static const int DEFAULT_CACHE_SIZE = 64;
+
+
+/// <summary>
+/// Decodes images with LoadLSImage, so that every path LiteStep understands works, and converts
+/// them to premultiplied BGRA with WIC.
+/// </summary>
+class Win32ImageDecoder : public ImageCache::IDecoder {
+public:
+  bool GetModifiedTime(const wchar_t *path, uint64_t *time) override {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &data)) {
+      return false;
+    }
+    *time = uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32 | data.ftLastWriteTime.dwLowDateTime;
+    return true;
+  }
+
+  bool Decode(const wchar_t *path, uint32_t *width, uint32_t *height,
+      std::vector<uint8_t> *pixels) override {
+    IWICImagingFactory *factory = nullptr;
+    IWICBitmap *wicBitmap = nullptr;
+    IWICFormatConverter *converter = nullptr;
+    UINT bitmapWidth = 0, bitmapHeight = 0;
+
+    HBITMAP hBitmap = LiteStep::LoadLSImage(path, nullptr);
+    if (!hBitmap) {
+      return false;
+    }
+
+    HRESULT hr = Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&factory));
+    if (SUCCEEDED(hr)) {
+      hr = factory->CreateFormatConverter(&converter);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = factory->CreateBitmapFromHBITMAP(hBitmap, nullptr, WICBitmapUseAlpha, &wicBitmap);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = converter->Initialize(wicBitmap, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone,
+        nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = converter->GetSize(&bitmapWidth, &bitmapHeight);
+    }
+    if (SUCCEEDED(hr)) {
+      pixels->resize(size_t(bitmapWidth) * bitmapHeight * 4);
+      hr = converter->CopyPixels(nullptr, bitmapWidth * 4, UINT(pixels->size()), pixels->data());
+    }
+
+    DeleteObject(hBitmap);
+    SAFERELEASE(wicBitmap);
+    SAFERELEASE(converter);
+
+    *width = bitmapWidth;
+    *height = bitmapHeight;
+    return SUCCEEDED(hr);
+  }
+};
+
+
+static Win32ImageDecoder sDecoder;
+// Modules may load images from worker threads. The cache does its own locking, and only holds
+// its lock while it looks images up or adds them, never while it decodes.
+static ImageCache *sCache = nullptr;
+
+
+/// <summary>
+/// Creates the image cache.
+/// </summary>
+void InitializeImageCache() {
+  int megabytes = LiteStep::GetRCInt(L"nCoreImageCacheSize", DEFAULT_CACHE_SIZE);
+  sCache = new ImageCache(&sDecoder, size_t(std::max(megabytes, 0)) * 1024 * 1024);
+}
+
+
+/// <summary>
+/// Destroys the image cache. Every module should have released its images, and stopped loading
+/// new ones, by now.
+/// </summary>
+void ShutdownImageCache() {
+  SAFEDELETE(sCache);
+}
+
+
+/// <summary>
+/// Returns the image at the given path, scaled to the given size. Pass a width and height of 0 to
+/// get the image at its original size. The image must be released with ReleaseImage.
+/// </summary>
+EXPORT_CDECL(const CachedImage*) AcquireImage(LPCWSTR path, UINT width, UINT height) {
+  return sCache ? sCache->Acquire(path, width, height) : nullptr;
+}
+
+
+/// <summary>
+/// Releases an image returned by AcquireImage.
+/// </summary>
+EXPORT_CDECL(void) ReleaseImage(const CachedImage *image) {
+  if (sCache) {
+    sCache->Release(image);
+  }
+}
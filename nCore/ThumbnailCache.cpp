@@ -0,0 +1,389 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ThumbnailCache.cpp
+// The nModules Project
+//
+// Connects the thumbnail store to the disk and WIC.
+//
+// Exports the following functions:
+//   - void CacheThumbnailBitmap(LPCWSTR path, UINT iconSize, HBITMAP bitmap)
+//   - void CacheThumbnailIcon(LPCWSTR path, UINT iconSize, HICON icon)
+//   - IWICBitmap *LoadCachedThumbnail(LPCWSTR path, UINT iconSize)
+//-------------------------------------------------------------------------------------------------
+#include "ThumbnailStore.hpp"
+
+#include "../nShared/Factories.h"
+#include "../nShared/LiteStep.h"
+
+#include "../Utilities/Common.h"
+#include "../Utilities/Macros.h"
+
+#include <algorithm>
+#include <mutex>
+#include <Shlobj.h>
+#include <strsafe.h>
+#include <wincodec.h>
+
+// The default size cap of the thumbnail cache, in megabytes.
+static const int DEFAULT_CACHE_SIZE = 64;
+
+
+/// <summary>
+/// Keeps the store in %LOCALAPPDATA%\nModules\nCore\Thumbnails. The data file stays open, and is
+/// mapped again whenever its size has changed.
+/// </summary>
+class Win32ThumbnailStorage : public ThumbnailStore::IStorage {
+public:
+  Win32ThumbnailStorage()
+    : mFile(INVALID_HANDLE_VALUE)
+    , mMapping(nullptr)
+    , mView(nullptr)
+    , mMappedSize(0)
+  {
+  }
+
+  ~Win32ThumbnailStorage() {
+    Close();
+  }
+
+public:
+  bool Open(LPCWSTR directory) {
+    mDataPath = std::wstring(directory) + L"\\thumbnails.dat";
+    mIndexPath = std::wstring(directory) + L"\\thumbnails.idx";
+    return OpenDataFile();
+  }
+
+  void Close() {
+    Unmap();
+    if (mFile != INVALID_HANDLE_VALUE) {
+      CloseHandle(mFile);
+      mFile = INVALID_HANDLE_VALUE;
+    }
+  }
+
+public:
+  uint64_t GetDataSize() override {
+    LARGE_INTEGER size;
+    if (mFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(mFile, &size)) {
+      return 0;
+    }
+    return uint64_t(size.QuadPart);
+  }
+
+  bool AppendData(const void *data, size_t size) override {
+    LARGE_INTEGER distance = { 0 };
+    DWORD written;
+    return mFile != INVALID_HANDLE_VALUE && SetFilePointerEx(mFile, distance, nullptr, FILE_END)
+      && WriteFile(mFile, data, DWORD(size), &written, nullptr) && written == size;
+  }
+
+  bool TruncateData(uint64_t size) override {
+    // A file can't be made smaller while it is mapped.
+    Unmap();
+    LARGE_INTEGER distance;
+    distance.QuadPart = LONGLONG(size);
+    return mFile != INVALID_HANDLE_VALUE && SetFilePointerEx(mFile, distance, nullptr, FILE_BEGIN)
+      && SetEndOfFile(mFile);
+  }
+
+  const uint8_t *MapData() override {
+    uint64_t size = GetDataSize();
+    if (mView != nullptr && size == mMappedSize) {
+      return mView;
+    }
+
+    Unmap();
+    if (size == 0) {
+      return nullptr;
+    }
+    mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mMapping != nullptr) {
+      mView = (const uint8_t*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+      mMappedSize = size;
+    }
+    return mView;
+  }
+
+  bool RewriteData(const void *header, size_t headerSize,
+      const std::vector<std::pair<uint64_t, uint64_t>> &ranges) override {
+    const uint8_t *data = ranges.empty() ? nullptr : MapData();
+    if (!ranges.empty() && data == nullptr) {
+      return false;
+    }
+
+    std::wstring tempPath = mDataPath + L".tmp";
+    if (!WriteFileContents(tempPath, header, headerSize, data, ranges)) {
+      return false;
+    }
+
+    // Swap the files, so that a crash leaves either the old or the new one behind.
+    Close();
+    bool moved = MoveFileExW(tempPath.c_str(), mDataPath.c_str(),
+      MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+    if (!moved) {
+      DeleteFileW(tempPath.c_str());
+    }
+    return OpenDataFile() && moved;
+  }
+
+  bool ReadIndex(std::vector<uint8_t> *data) override {
+    HANDLE file = CreateFileW(mIndexPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+
+    LARGE_INTEGER size;
+    DWORD read = 0;
+    bool success = GetFileSizeEx(file, &size) && size.QuadPart < MAXDWORD;
+    if (success) {
+      data->resize(size_t(size.QuadPart));
+      success = data->empty()
+        || ReadFile(file, data->data(), DWORD(data->size()), &read, nullptr) && read == data->size();
+    }
+    CloseHandle(file);
+    return success;
+  }
+
+  bool WriteIndex(const std::vector<uint8_t> &data) override {
+    std::wstring tempPath = mIndexPath + L".tmp";
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    if (!WriteFileContents(tempPath, data.data(), data.size(), nullptr, ranges)) {
+      return false;
+    }
+    return MoveFileExW(tempPath.c_str(), mIndexPath.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+  }
+
+private:
+  bool OpenDataFile() {
+    mFile = CreateFileW(mDataPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+      OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return mFile != INVALID_HANDLE_VALUE;
+  }
+
+  void Unmap() {
+    if (mView != nullptr) {
+      UnmapViewOfFile(mView);
+      mView = nullptr;
+    }
+    if (mMapping != nullptr) {
+      CloseHandle(mMapping);
+      mMapping = nullptr;
+    }
+    mMappedSize = 0;
+  }
+
+  /// <summary>
+  /// Creates a file with the given header, followed by the given ranges of data.
+  /// </summary>
+  static bool WriteFileContents(const std::wstring &path, const void *header, size_t headerSize,
+      const uint8_t *data, const std::vector<std::pair<uint64_t, uint64_t>> &ranges) {
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+
+    DWORD written;
+    bool success = headerSize == 0
+      || WriteFile(file, header, DWORD(headerSize), &written, nullptr) && written == headerSize;
+    for (auto &range : ranges) {
+      success = success && WriteFile(file, data + range.first, DWORD(range.second), &written,
+        nullptr) && written == range.second;
+    }
+    success = FlushFileBuffers(file) && success;
+    CloseHandle(file);
+
+    if (!success) {
+      DeleteFileW(path.c_str());
+    }
+    return success;
+  }
+
+private:
+  std::wstring mDataPath;
+  std::wstring mIndexPath;
+
+  HANDLE mFile;
+  HANDLE mMapping;
+  const uint8_t *mView;
+  uint64_t mMappedSize;
+};
+
+
+static Win32ThumbnailStorage sStorage;
+static ThumbnailStore *sStore = nullptr;
+
+// Thumbnails are loaded and stored from the file system loader's threads.
+static std::mutex sStoreLock;
+
+
+/// <summary>
+/// Builds the key of the thumbnail of a file. Items which aren't files, and so have no
+/// modification time, aren't cached.
+/// </summary>
+static bool GetKey(LPCWSTR path, UINT iconSize, ThumbnailStore::Key *key) {
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (path == nullptr || *path == L'\0'
+      || !GetFileAttributesExW(path, GetFileExInfoStandard, &data)) {
+    return false;
+  }
+
+  // Paths are case insensitive.
+  key->path = path;
+  CharLowerBuffW(&key->path[0], DWORD(key->path.length()));
+  key->modifiedTime =
+    uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32 | data.ftLastWriteTime.dwLowDateTime;
+  key->fileSize = uint64_t(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+  key->iconSize = iconSize;
+  return true;
+}
+
+
+/// <summary>
+/// Checks whether the cache is open, so that thumbnails aren't converted for nothing. The cache may
+/// be shut down by the time they are stored, which Store checks again.
+/// </summary>
+static bool IsOpen() {
+  std::lock_guard<std::mutex> lock(sStoreLock);
+  return sStore != nullptr;
+}
+
+
+/// <summary>
+/// Converts a WIC bitmap to premultiplied BGRA, and adds it to the store.
+/// </summary>
+static void Store(const ThumbnailStore::Key &key, IWICImagingFactory *factory,
+    IWICBitmapSource *source) {
+  IWICFormatConverter *converter = nullptr;
+  UINT width = 0, height = 0;
+  std::vector<uint8_t> pixels;
+
+  HRESULT hr = factory->CreateFormatConverter(&converter);
+  if (SUCCEEDED(hr)) {
+    hr = converter->Initialize(source, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone,
+      nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = converter->GetSize(&width, &height);
+  }
+  if (SUCCEEDED(hr)) {
+    pixels.resize(size_t(width) * height * 4);
+    hr = converter->CopyPixels(nullptr, width * 4, UINT(pixels.size()), pixels.data());
+  }
+  SAFERELEASE(converter);
+
+  if (SUCCEEDED(hr)) {
+    std::lock_guard<std::mutex> lock(sStoreLock);
+    if (sStore) {
+      sStore->Insert(key, width, height, pixels.data());
+    }
+  }
+}
+
+
+/// <summary>
+/// Opens the thumbnail cache.
+/// </summary>
+void InitializeThumbnailCache() {
+  int megabytes = LiteStep::GetRCInt(L"nCoreThumbnailCacheSize", DEFAULT_CACHE_SIZE);
+  if (megabytes <= 0) {
+    return;
+  }
+
+  WCHAR directory[MAX_PATH];
+  PWSTR localAppData;
+  if (FAILED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) {
+    return;
+  }
+  StringCchPrintf(directory, _countof(directory), L"%s\\nModules\\nCore\\Thumbnails", localAppData);
+  CoTaskMemFree(localAppData);
+  SHCreateDirectoryExW(nullptr, directory, nullptr);
+
+  // Worker threads convert thumbnails, so make sure the WIC factory exists before they do.
+  IWICImagingFactory *factory;
+  Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&factory));
+
+  std::lock_guard<std::mutex> lock(sStoreLock);
+  if (sStorage.Open(directory)) {
+    sStore = new ThumbnailStore(&sStorage, uint64_t(megabytes) * 1024 * 1024);
+    if (!sStore->Open()) {
+      SAFEDELETE(sStore);
+      sStorage.Close();
+    }
+  }
+}
+
+
+/// <summary>
+/// Writes out the index of the thumbnail cache, and closes it.
+/// </summary>
+void ShutdownThumbnailCache() {
+  std::lock_guard<std::mutex> lock(sStoreLock);
+  if (sStore) {
+    sStore->Flush();
+    SAFEDELETE(sStore);
+  }
+  sStorage.Close();
+}
+
+
+/// <summary>
+/// Retrieves the thumbnail of a file, as it was when its thumbnail was cached at the given size.
+/// </summary>
+/// <returns>A premultiplied BGRA bitmap, which the caller has to release, or nullptr if the
+/// thumbnail hasn't been cached.</returns>
+EXPORT_CDECL(IWICBitmap*) LoadCachedThumbnail(LPCWSTR path, UINT iconSize) {
+  ThumbnailStore::Key key;
+  if (!GetKey(path, iconSize, &key)) {
+    return nullptr;
+  }
+
+  uint32_t width, height;
+  std::vector<uint8_t> pixels;
+  {
+    std::lock_guard<std::mutex> lock(sStoreLock);
+    if (!sStore || !sStore->Lookup(key, &width, &height, &pixels)) {
+      return nullptr;
+    }
+  }
+
+  IWICImagingFactory *factory = nullptr;
+  IWICBitmap *bitmap = nullptr;
+  if (SUCCEEDED(Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&factory)))) {
+    factory->CreateBitmapFromMemory(width, height, GUID_WICPixelFormat32bppPBGRA, width * 4,
+      UINT(pixels.size()), pixels.data(), &bitmap);
+  }
+  return bitmap;
+}
+
+
+/// <summary>
+/// Adds a thumbnail, extracted at the given size, to the cache.
+/// </summary>
+EXPORT_CDECL(void) CacheThumbnailBitmap(LPCWSTR path, UINT iconSize, HBITMAP bitmap) {
+  ThumbnailStore::Key key;
+  IWICImagingFactory *factory = nullptr;
+  IWICBitmap *source = nullptr;
+  if (IsOpen() && GetKey(path, iconSize, &key)
+      && SUCCEEDED(Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&factory)))
+      && SUCCEEDED(factory->CreateBitmapFromHBITMAP(bitmap, nullptr, WICBitmapUseAlpha, &source))) {
+    Store(key, factory, source);
+  }
+  SAFERELEASE(source);
+}
+
+
+/// <summary>
+/// Adds an icon, extracted at the given size, to the cache.
+/// </summary>
+EXPORT_CDECL(void) CacheThumbnailIcon(LPCWSTR path, UINT iconSize, HICON icon) {
+  ThumbnailStore::Key key;
+  IWICImagingFactory *factory = nullptr;
+  IWICBitmap *source = nullptr;
+  if (IsOpen() && GetKey(path, iconSize, &key)
+      && SUCCEEDED(Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&factory)))
+      && SUCCEEDED(factory->CreateBitmapFromHICON(icon, &source))) {
+    Store(key, factory, source);
+  }
+  SAFERELEASE(source);
+}
@@ -0,0 +1,466 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ThumbnailStore.cpp
+// The nModules Project
+//
+// Keeps extracted thumbnails on disk, so that they don't have to be extracted again.
+//-------------------------------------------------------------------------------------------------
+#include "ThumbnailStore.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+// Identify the files, and the version of their layout.
+static const uint32_t FILE_MAGIC = 0x4354484E;    // NHTC
+static const uint32_t RECORD_MAGIC = 0x5254484E;  // NHTR
+static const uint32_t INDEX_MAGIC = 0x4954484E;   // NHTI
+static const uint32_t FILE_VERSION = 1;
+
+// Anything larger than this is not a thumbnail, and most likely a broken record.
+static const uint32_t MAX_DIMENSION = 2048;
+static const uint32_t MAX_PATH_LENGTH = 32768;
+
+
+/// <summary>
+/// The start of the data file. Records follow immediately.
+/// </summary>
+struct ThumbnailStore::FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t generation;
+  uint32_t reserved;
+};
+
+
+/// <summary>
+/// The start of every record. It is followed by the path, in UTF-16, and then the pixels. Both are
+/// padded to a multiple of 8 bytes.
+/// </summary>
+struct ThumbnailStore::RecordHeader {
+  uint32_t magic;
+  uint32_t pathLength;
+  uint64_t keyHash;
+  uint64_t modifiedTime;
+  uint64_t fileSize;
+  uint32_t iconSize;
+  uint32_t width;
+  uint32_t height;
+
+  // Of the path and the pixels, to find records which were only partially written.
+  uint32_t checksum;
+};
+
+
+/// <summary>
+/// The start of the index file. One IndexEntry per record follows.
+/// </summary>
+struct ThumbnailStore::IndexHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t generation;
+  uint32_t reserved;
+
+  // The size of the data file when the index was written.
+  uint64_t dataSize;
+  uint64_t clock;
+  uint64_t count;
+};
+
+
+struct ThumbnailStore::IndexEntry {
+  uint64_t keyHash;
+  uint64_t offset;
+  uint64_t lastUse;
+};
+
+
+/// <summary>
+/// 64-bit FNV-1a.
+/// </summary>
+static uint64_t Hash(const void *data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+  const uint8_t *bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+static uint64_t Align(uint64_t size) {
+  return (size + 7) & ~uint64_t(7);
+}
+
+
+/// <summary>
+/// Paths are stored as UTF-16, whatever the size of wchar_t.
+/// </summary>
+static std::vector<uint16_t> ToUtf16(const std::wstring &path) {
+  return std::vector<uint16_t>(path.begin(), path.end());
+}
+
+
+ThumbnailStore::ThumbnailStore(IStorage *storage, uint64_t capacity)
+  : mStorage(storage)
+  , mCapacity(capacity)
+  , mDataSize(0)
+  , mGeneration(0)
+  , mClock(0)
+  , mDirty(false)
+  , mOpen(false)
+{
+  static_assert(sizeof(FileHeader) == 16, "The file header should not have any padding");
+  static_assert(sizeof(RecordHeader) == 48, "The record header should not have any padding");
+  static_assert(sizeof(IndexHeader) == 40, "The index header should not have any padding");
+  static_assert(sizeof(IndexEntry) == 24, "Index entries should not have any padding");
+}
+
+
+bool ThumbnailStore::Open() {
+  mEntries.clear();
+  mDataSize = 0;
+  mClock = 0;
+  mOpen = false;
+
+  const uint64_t size = mStorage->GetDataSize();
+  const uint8_t *data = size >= sizeof(FileHeader) ? mStorage->MapData() : nullptr;
+  if (data == nullptr) {
+    return Reset();
+  }
+
+  FileHeader fileHeader;
+  memcpy(&fileHeader, data, sizeof(FileHeader));
+  if (fileHeader.magic != FILE_MAGIC || fileHeader.version != FILE_VERSION) {
+    return Reset();
+  }
+  mGeneration = fileHeader.generation;
+  mDataSize = size;
+  mOpen = true;
+
+  // Use the index for as much of the data file as it covers.
+  uint64_t scanFrom = sizeof(FileHeader);
+  std::vector<uint8_t> index;
+  IndexHeader indexHeader;
+  if (mStorage->ReadIndex(&index) && index.size() >= sizeof(IndexHeader)) {
+    memcpy(&indexHeader, index.data(), sizeof(IndexHeader));
+    bool valid = indexHeader.magic == INDEX_MAGIC && indexHeader.version == FILE_VERSION
+      && indexHeader.generation == mGeneration && indexHeader.dataSize <= size
+      && indexHeader.dataSize >= sizeof(FileHeader)
+      && indexHeader.count == (index.size() - sizeof(IndexHeader)) / sizeof(IndexEntry)
+      && (index.size() - sizeof(IndexHeader)) % sizeof(IndexEntry) == 0;
+
+    if (valid) {
+      mClock = indexHeader.clock;
+      for (uint64_t i = 0; i < indexHeader.count; ++i) {
+        IndexEntry indexEntry;
+        memcpy(&indexEntry, index.data() + sizeof(IndexHeader) + i * sizeof(IndexEntry),
+          sizeof(IndexEntry));
+
+        uint64_t length;
+        RecordHeader record;
+        if (ValidateRecord(data, indexHeader.dataSize, indexEntry.offset, false, &length)) {
+          memcpy(&record, data + indexEntry.offset, sizeof(RecordHeader));
+          if (record.keyHash == indexEntry.keyHash) {
+            Entry &entry = mEntries[indexEntry.keyHash];
+            entry.offset = indexEntry.offset;
+            entry.length = length;
+            entry.lastUse = indexEntry.lastUse;
+            mClock = std::max(mClock, indexEntry.lastUse);
+          }
+        }
+      }
+      scanFrom = indexHeader.dataSize;
+    }
+  }
+
+  // Recover whatever was added after the index was written.
+  return Scan(scanFrom);
+}
+
+
+bool ThumbnailStore::Lookup(const Key &key, uint32_t *width, uint32_t *height,
+    std::vector<uint8_t> *pixels) {
+  if (!mOpen) {
+    return false;
+  }
+
+  auto entry = mEntries.find(HashKey(key));
+  if (entry == mEntries.end()) {
+    return false;
+  }
+
+  const uint8_t *data = mStorage->MapData();
+  if (data == nullptr) {
+    return false;
+  }
+
+  // The hash may collide, so check the whole key.
+  const uint8_t *record = data + entry->second.offset;
+  RecordHeader header;
+  memcpy(&header, record, sizeof(RecordHeader));
+  std::vector<uint16_t> path = ToUtf16(key.path);
+  if (header.modifiedTime != key.modifiedTime || header.fileSize != key.fileSize
+      || header.iconSize != key.iconSize || header.pathLength != path.size()
+      || memcmp(record + sizeof(RecordHeader), path.data(), path.size() * sizeof(uint16_t)) != 0) {
+    return false;
+  }
+
+  const uint8_t *source = record + sizeof(RecordHeader) + Align(path.size() * sizeof(uint16_t));
+  pixels->assign(source, source + size_t(header.width) * header.height * 4);
+  *width = header.width;
+  *height = header.height;
+
+  entry->second.lastUse = ++mClock;
+  mDirty = true;
+  return true;
+}
+
+
+bool ThumbnailStore::Insert(const Key &key, uint32_t width, uint32_t height,
+    const uint8_t *pixels) {
+  std::vector<uint16_t> path = ToUtf16(key.path);
+  if (!mOpen || width == 0 || height == 0 || width > MAX_DIMENSION || height > MAX_DIMENSION
+      || path.size() > MAX_PATH_LENGTH) {
+    return false;
+  }
+
+  const size_t pathBytes = path.size() * sizeof(uint16_t);
+  const size_t pixelBytes = size_t(width) * height * 4;
+  const size_t pathOffset = sizeof(RecordHeader);
+  const size_t pixelOffset = pathOffset + size_t(Align(pathBytes));
+  const size_t length = pixelOffset + size_t(Align(pixelBytes));
+
+  // A single thumbnail shouldn't push out a large part of the cache.
+  if (length > mCapacity / 4) {
+    return false;
+  }
+
+  RecordHeader header;
+  memset(&header, 0, sizeof(RecordHeader));
+  header.magic = RECORD_MAGIC;
+  header.pathLength = uint32_t(path.size());
+  header.keyHash = HashKey(key);
+  header.modifiedTime = key.modifiedTime;
+  header.fileSize = key.fileSize;
+  header.iconSize = key.iconSize;
+  header.width = width;
+  header.height = height;
+  header.checksum = uint32_t(Hash(pixels, pixelBytes, Hash(path.data(), pathBytes)));
+
+  std::vector<uint8_t> record(length, 0);
+  memcpy(record.data(), &header, sizeof(RecordHeader));
+  memcpy(record.data() + pathOffset, path.data(), pathBytes);
+  memcpy(record.data() + pixelOffset, pixels, pixelBytes);
+
+  if (mDataSize + length > mCapacity) {
+    Compact(mCapacity - mCapacity / 4);
+  }
+
+  if (!mStorage->AppendData(record.data(), record.size())) {
+    // Don't leave half a record behind.
+    if (mStorage->GetDataSize() != mDataSize) {
+      mStorage->TruncateData(mDataSize);
+    }
+    return false;
+  }
+
+  Entry &entry = mEntries[header.keyHash];
+  entry.offset = mDataSize;
+  entry.length = length;
+  entry.lastUse = ++mClock;
+  mDataSize += length;
+  mDirty = true;
+  return true;
+}
+
+
+void ThumbnailStore::Flush() {
+  if (!mOpen || !mDirty) {
+    return;
+  }
+
+  std::vector<uint8_t> index(sizeof(IndexHeader) + mEntries.size() * sizeof(IndexEntry));
+  IndexHeader header;
+  memset(&header, 0, sizeof(IndexHeader));
+  header.magic = INDEX_MAGIC;
+  header.version = FILE_VERSION;
+  header.generation = mGeneration;
+  header.dataSize = mDataSize;
+  header.clock = mClock;
+  header.count = mEntries.size();
+  memcpy(index.data(), &header, sizeof(IndexHeader));
+
+  uint8_t *out = index.data() + sizeof(IndexHeader);
+  for (auto &entry : mEntries) {
+    IndexEntry indexEntry = { entry.first, entry.second.offset, entry.second.lastUse };
+    memcpy(out, &indexEntry, sizeof(IndexEntry));
+    out += sizeof(IndexEntry);
+  }
+
+  if (mStorage->WriteIndex(index)) {
+    mDirty = false;
+  }
+}
+
+
+void ThumbnailStore::Compact(uint64_t size) {
+  if (!mOpen) {
+    return;
+  }
+
+  std::vector<std::pair<uint64_t, const Entry*>> entries;
+  for (auto &entry : mEntries) {
+    entries.emplace_back(entry.first, &entry.second);
+  }
+  std::sort(entries.begin(), entries.end(), [] (const std::pair<uint64_t, const Entry*> &a,
+      const std::pair<uint64_t, const Entry*> &b) {
+    return a.second->lastUse > b.second->lastUse;
+  });
+
+  std::vector<uint64_t> keep;
+  uint64_t total = sizeof(FileHeader);
+  for (auto &entry : entries) {
+    if (total + entry.second->length > size) {
+      break;
+    }
+    total += entry.second->length;
+    keep.push_back(entry.first);
+  }
+
+  // Keep the records in the order they were added, so that the file is copied front to back.
+  std::sort(keep.begin(), keep.end(), [this] (uint64_t a, uint64_t b) {
+    return mEntries[a].offset < mEntries[b].offset;
+  });
+
+  if (!Rewrite(keep)) {
+    Reset();
+  }
+}
+
+
+size_t ThumbnailStore::GetCount() const {
+  return mEntries.size();
+}
+
+
+uint64_t ThumbnailStore::GetDataSize() const {
+  return mDataSize;
+}
+
+
+uint64_t ThumbnailStore::HashKey(const Key &key) {
+  std::vector<uint16_t> path = ToUtf16(key.path);
+  uint64_t hash = Hash(path.data(), path.size() * sizeof(uint16_t));
+  hash = Hash(&key.modifiedTime, sizeof(key.modifiedTime), hash);
+  hash = Hash(&key.fileSize, sizeof(key.fileSize), hash);
+  return Hash(&key.iconSize, sizeof(key.iconSize), hash);
+}
+
+
+bool ThumbnailStore::ValidateRecord(const uint8_t *data, uint64_t dataSize, uint64_t offset,
+    bool checkContents, uint64_t *length) const {
+  if (offset % 8 != 0 || offset < sizeof(FileHeader) || offset > dataSize
+      || dataSize - offset < sizeof(RecordHeader)) {
+    return false;
+  }
+
+  RecordHeader header;
+  memcpy(&header, data + offset, sizeof(RecordHeader));
+  if (header.magic != RECORD_MAGIC || header.width == 0 || header.height == 0
+      || header.width > MAX_DIMENSION || header.height > MAX_DIMENSION
+      || header.pathLength > MAX_PATH_LENGTH) {
+    return false;
+  }
+
+  const uint64_t pathBytes = uint64_t(header.pathLength) * sizeof(uint16_t);
+  const uint64_t pixelBytes = uint64_t(header.width) * header.height * 4;
+  *length = sizeof(RecordHeader) + Align(pathBytes) + Align(pixelBytes);
+  if (*length > dataSize - offset) {
+    return false;
+  }
+
+  if (checkContents) {
+    const uint8_t *path = data + offset + sizeof(RecordHeader);
+    const uint8_t *pixels = path + Align(pathBytes);
+    if (uint32_t(Hash(pixels, size_t(pixelBytes), Hash(path, size_t(pathBytes)))) != header.checksum) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool ThumbnailStore::Scan(uint64_t offset) {
+  const uint8_t *data = mStorage->MapData();
+  if (data == nullptr) {
+    return Reset();
+  }
+
+  uint64_t length;
+  while (offset < mDataSize && ValidateRecord(data, mDataSize, offset, true, &length)) {
+    RecordHeader header;
+    memcpy(&header, data + offset, sizeof(RecordHeader));
+    Entry &entry = mEntries[header.keyHash];
+    entry.offset = offset;
+    entry.length = length;
+    entry.lastUse = ++mClock;
+    mDirty = true;
+    offset += length;
+  }
+
+  // Whatever follows was only partially written.
+  if (offset < mDataSize) {
+    if (!mStorage->TruncateData(offset)) {
+      return Reset();
+    }
+    mDataSize = offset;
+    mDirty = true;
+  }
+
+  return true;
+}
+
+
+bool ThumbnailStore::Reset() {
+  mEntries.clear();
+  mDataSize = 0;
+  mOpen = true;
+  if (!Rewrite(std::vector<uint64_t>())) {
+    mOpen = false;
+  }
+  return mOpen;
+}
+
+
+bool ThumbnailStore::Rewrite(const std::vector<uint64_t> &keys) {
+  FileHeader header;
+  memset(&header, 0, sizeof(FileHeader));
+  header.magic = FILE_MAGIC;
+  header.version = FILE_VERSION;
+  header.generation = mGeneration + 1;
+
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  for (uint64_t key : keys) {
+    const Entry &entry = mEntries[key];
+    ranges.emplace_back(entry.offset, entry.length);
+  }
+
+  if (!mStorage->RewriteData(&header, sizeof(FileHeader), ranges)) {
+    return false;
+  }
+
+  std::unordered_map<uint64_t, Entry> entries;
+  uint64_t offset = sizeof(FileHeader);
+  for (uint64_t key : keys) {
+    Entry entry = mEntries[key];
+    entry.offset = offset;
+    offset += entry.length;
+    entries[key] = entry;
+  }
+
+  mEntries.swap(entries);
+  mDataSize = offset;
+  mGeneration = header.generation;
+  mDirty = true;
+  Flush();
+  return true;
+}
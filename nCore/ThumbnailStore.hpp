@@ -0,0 +1,143 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/ThumbnailStore.hpp
+// The nModules Project
+//
+// Keeps extracted thumbnails on disk, so that they don't have to be extracted again.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// A persistent cache of thumbnails, in premultiplied 32bpp BGRA. Thumbnails are keyed on the
+/// path of the item, its modification time and size, and the size the thumbnail was extracted at.
+///
+/// Thumbnails are appended to a single data file, which is read through a memory mapping. An index
+/// of where every thumbnail is, and when it was last used, is written next to it on Flush. If the
+/// index is missing or out of date, whatever was appended since it was written is recovered by
+/// scanning the data file. Once the data file goes over its size cap, it is rewritten with only
+/// the most recently used thumbnails.
+///
+/// Not thread safe.
+/// </summary>
+class ThumbnailStore {
+public:
+  struct Key {
+    // The parsing name of the item. Compared exactly, so it should be normalized first.
+    std::wstring path;
+    uint64_t modifiedTime;
+    uint64_t fileSize;
+
+    // The size the thumbnail was extracted at.
+    uint32_t iconSize;
+  };
+
+  /// <summary>
+  /// Where the data file and the index are kept.
+  /// </summary>
+  class IStorage {
+  public:
+    virtual uint64_t GetDataSize() = 0;
+    virtual bool AppendData(const void *data, size_t size) = 0;
+    virtual bool TruncateData(uint64_t size) = 0;
+
+    // Maps the data file into memory. The mapping stays valid until the data file changes.
+    virtual const uint8_t *MapData() = 0;
+
+    // Replaces the data file with the given header, followed by the given ranges of the current
+    // data file, in order. Should never leave a partially written data file behind.
+    virtual bool RewriteData(const void *header, size_t headerSize,
+      const std::vector<std::pair<uint64_t, uint64_t>> &ranges) = 0;
+
+    // Reads and replaces the index. Returns false if there is no index.
+    virtual bool ReadIndex(std::vector<uint8_t> *data) = 0;
+    virtual bool WriteIndex(const std::vector<uint8_t> &data) = 0;
+  };
+
+public:
+  /// <param name="storage">Holds the files. Must outlive the store.</param>
+  /// <param name="capacity">The size, in bytes, the data file is allowed to grow to.</param>
+  ThumbnailStore(IStorage *storage, uint64_t capacity);
+
+  ThumbnailStore(const ThumbnailStore&) = delete;
+  ThumbnailStore &operator=(const ThumbnailStore&) = delete;
+
+public:
+  /// <summary>
+  /// Loads the index, recovering it from the data file if necessary.
+  /// </summary>
+  /// <returns>False if the data file can't be used.</returns>
+  bool Open();
+
+  /// <summary>
+  /// Retrieves a thumbnail.
+  /// </summary>
+  /// <returns>False if the thumbnail isn't in the store.</returns>
+  bool Lookup(const Key &key, uint32_t *width, uint32_t *height, std::vector<uint8_t> *pixels);
+
+  /// <summary>
+  /// Adds a thumbnail. Tightly packed, premultiplied 32bpp BGRA.
+  /// </summary>
+  bool Insert(const Key &key, uint32_t width, uint32_t height, const uint8_t *pixels);
+
+  // Writes the index, if it has changed.
+  void Flush();
+
+  // Rewrites the data file with the most recently used thumbnails which fit in the given size.
+  void Compact(uint64_t size);
+
+public:
+  size_t GetCount() const;
+  uint64_t GetDataSize() const;
+
+private:
+  struct FileHeader;
+  struct RecordHeader;
+  struct IndexHeader;
+  struct IndexEntry;
+
+  struct Entry {
+    uint64_t offset;
+    uint64_t length;
+    uint64_t lastUse;
+  };
+
+private:
+  static uint64_t HashKey(const Key &key);
+
+  // Checks that a record is complete, and retrieves its length.
+  bool ValidateRecord(const uint8_t *data, uint64_t dataSize, uint64_t offset, bool checkContents,
+    uint64_t *length) const;
+
+  // Indexes the records from the given offset to the end of the data file, and cuts the data file
+  // off at the first one which is broken.
+  bool Scan(uint64_t offset);
+
+  // Creates an empty data file.
+  bool Reset();
+
+  // Replaces the data file with the given records, in order.
+  bool Rewrite(const std::vector<uint64_t> &keys);
+
+private:
+  IStorage *mStorage;
+  const uint64_t mCapacity;
+
+  std::unordered_map<uint64_t, Entry> mEntries;
+  uint64_t mDataSize;
+
+  // Changes every time the data file is rewritten, so that an index of an older one isn't used.
+  uint32_t mGeneration;
+
+  // Counts up on every use, for finding the least recently used thumbnails.
+  uint64_t mClock;
+
+  // True if mEntries has changed since the index was written.
+  bool mDirty;
+  bool mOpen;
+};
@@ -0,0 +1,180 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/WorkerPool.cpp
+// The nModules Project
+//
+// A fixed set of worker threads which run jobs in order of priority.
+//-------------------------------------------------------------------------------------------------
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+
+
+WorkerPool::CancellationToken::CancellationToken()
+  : mCancelled(std::make_shared<std::atomic<bool>>(false))
+{
+}
+
+
+void WorkerPool::CancellationToken::Cancel() {
+  mCancelled->store(true);
+}
+
+
+bool WorkerPool::CancellationToken::IsCancelled() const {
+  return mCancelled->load();
+}
+
+
+WorkerPool::WorkerPool(size_t threads, Job onThreadStart, Job onThreadExit)
+  : mOnThreadStart(onThreadStart)
+  , mOnThreadExit(onThreadExit)
+  , mNextQueue(0)
+  , mPending(0)
+  , mStolen(0)
+  , mStopping(false)
+{
+  threads = std::max<size_t>(1, threads);
+  for (size_t i = 0; i < threads; ++i) {
+    mQueues.emplace_back(new Queue());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    mThreads.emplace_back(&WorkerPool::Run, this, i);
+  }
+}
+
+
+WorkerPool::~WorkerPool() {
+  Shutdown();
+}
+
+
+void WorkerPool::Submit(Priority priority, const CancellationToken &token, Job run, Job discard) {
+  Task task = { token, std::move(run), std::move(discard) };
+  bool queued = false;
+  {
+    std::lock_guard<std::mutex> lock(mSleepMutex);
+    if (!mStopping) {
+      Queue &queue = *mQueues[mNextQueue++ % mQueues.size()];
+      std::lock_guard<std::mutex> queueLock(queue.mutex);
+      queue.lanes[size_t(priority)].push_back(std::move(task));
+      ++mPending;
+      queued = true;
+    }
+  }
+
+  if (queued) {
+    mWake.notify_one();
+  } else {
+    // The pool has shut down, so the job will never run.
+    Execute(task, true);
+  }
+}
+
+
+void WorkerPool::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mSleepMutex);
+    if (mStopping) {
+      return;
+    }
+    mStopping = true;
+  }
+  mWake.notify_all();
+  for (std::thread &thread : mThreads) {
+    thread.join();
+  }
+
+  // Nothing else can touch the queues now.
+  for (auto &queue : mQueues) {
+    for (std::deque<Task> &lane : queue->lanes) {
+      for (Task &task : lane) {
+        Execute(task, true);
+      }
+      lane.clear();
+    }
+  }
+  mPending = 0;
+}
+
+
+size_t WorkerPool::GetThreadCount() const {
+  return mThreads.size();
+}
+
+
+size_t WorkerPool::GetPendingCount() const {
+  return mPending;
+}
+
+
+uint64_t WorkerPool::GetStolenCount() const {
+  return mStolen;
+}
+
+
+void WorkerPool::Run(size_t index) {
+  if (mOnThreadStart) {
+    mOnThreadStart();
+  }
+
+  for (;;) {
+    Task task;
+    if (!mStopping && Take(index, &task)) {
+      Execute(task, false);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mSleepMutex);
+    mWake.wait(lock, [this] () { return mPending > 0 || mStopping; });
+    if (mStopping) {
+      break;
+    }
+  }
+
+  if (mOnThreadExit) {
+    mOnThreadExit();
+  }
+}
+
+
+bool WorkerPool::Take(size_t index, Task *task) {
+  const size_t count = mQueues.size();
+  for (size_t lane = 0; lane < size_t(Priority::Count); ++lane) {
+    // Our own jobs, oldest first.
+    {
+      Queue &queue = *mQueues[index];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.lanes[lane].empty()) {
+        *task = std::move(queue.lanes[lane].front());
+        queue.lanes[lane].pop_front();
+        --mPending;
+        return true;
+      }
+    }
+
+    // Someone else's, from the other end, so that we don't fight over the same jobs.
+    for (size_t i = 1; i < count; ++i) {
+      Queue &queue = *mQueues[(index + i) % count];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.lanes[lane].empty()) {
+        *task = std::move(queue.lanes[lane].back());
+        queue.lanes[lane].pop_back();
+        --mPending;
+        ++mStolen;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+
+void WorkerPool::Execute(Task &task, bool discard) {
+  if (discard || task.token.IsCancelled()) {
+    if (task.discard) {
+      task.discard();
+    }
+  } else {
+    task.run();
+  }
+}
@@ -0,0 +1,134 @@
+//-------------------------------------------------------------------------------------------------
+// /nCore/WorkerPool.hpp
+// The nModules Project
+//
+// A fixed set of worker threads which run jobs in order of priority.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Runs jobs on a fixed number of threads. Every thread has its own queue per priority, which jobs
+/// are spread over as they are submitted. A thread which runs out of work takes jobs from the back
+/// of the other threads' queues, and always looks for jobs of a higher priority across the whole
+/// pool before it runs one of a lower priority.
+/// </summary>
+class WorkerPool {
+public:
+  /// <summary>
+  /// How soon a job should run. Lower values run first.
+  /// </summary>
+  enum class Priority {
+    // The result is needed for something which is on screen.
+    Visible,
+    // The result is needed, but not on screen.
+    Offscreen,
+    // The result might be needed later.
+    Prefetch,
+    Count
+  };
+
+  /// <summary>
+  /// Shared between whoever submits a job and the job itself, to call it off. Copies refer to the
+  /// same flag.
+  /// </summary>
+  class CancellationToken {
+  public:
+    CancellationToken();
+
+  public:
+    void Cancel();
+    bool IsCancelled() const;
+
+  private:
+    std::shared_ptr<std::atomic<bool>> mCancelled;
+  };
+
+  typedef std::function<void()> Job;
+
+public:
+  /// <param name="threads">The number of worker threads.</param>
+  /// <param name="onThreadStart">Called on every worker thread before it runs any jobs.</param>
+  /// <param name="onThreadExit">Called on every worker thread before it exits.</param>
+  WorkerPool(size_t threads, Job onThreadStart = nullptr, Job onThreadExit = nullptr);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool &operator=(const WorkerPool&) = delete;
+
+public:
+  /// <summary>
+  /// Queues a job.
+  /// </summary>
+  /// <param name="run">Called on a worker thread, unless the token is cancelled first.</param>
+  /// <param name="discard">Called instead of run if the token is cancelled before the job starts,
+  /// or the pool shuts down, so that the job can clean up after itself. May be null.</param>
+  void Submit(Priority priority, const CancellationToken &token, Job run, Job discard = nullptr);
+
+  /// <summary>
+  /// Waits for the jobs which are running to finish, and discards every job which hasn't started.
+  /// Nothing can be submitted afterwards.
+  /// </summary>
+  void Shutdown();
+
+public:
+  size_t GetThreadCount() const;
+
+  // The number of jobs which haven't started yet.
+  size_t GetPendingCount() const;
+
+  // The number of jobs which were taken from another thread's queue.
+  uint64_t GetStolenCount() const;
+
+private:
+  struct Task {
+    CancellationToken token;
+    Job run;
+    Job discard;
+  };
+
+  /// <summary>
+  /// The jobs which were given to one thread.
+  /// </summary>
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> lanes[size_t(Priority::Count)];
+  };
+
+private:
+  void Run(size_t index);
+
+  // Takes the most urgent job, preferring the given thread's own queue.
+  bool Take(size_t index, Task *task);
+
+  // Runs or discards a job, depending on its token.
+  static void Execute(Task &task, bool discard);
+
+private:
+  Job mOnThreadStart;
+  Job mOnThreadExit;
+
+  std::vector<std::unique_ptr<Queue>> mQueues;
+  std::vector<std::thread> mThreads;
+
+  // The queue the next job goes to.
+  std::atomic<size_t> mNextQueue;
+
+  // The number of jobs in the queues. Jobs are only queued while holding mSleepMutex, so that a
+  // thread which is going to sleep can't miss one.
+  std::atomic<size_t> mPending;
+  std::atomic<uint64_t> mStolen;
+
+  std::mutex mSleepMutex;
+  std::condition_variable mWake;
+  std::atomic<bool> mStopping;
+};
@@ -5,6 +5,7 @@
 // Main .cpp file for the nCore module.
 //-------------------------------------------------------------------------------------------------
 #include "CoreMessages.h"
+#include "IFrameListener.hpp"
 #include "ParsedText.hpp"
 #include "Scripting.h"
 #include "TextFunctions.h"
@@ -35,16 +36,47 @@ MonitorInfo gMonitorInfo;
 // Constants
 static const LPCWSTR gMsgHandler = L"LSnCore";
 
-// When the [time] text function should send out change notifications.
-UINT_PTR timeTimer;
-
 // Service functions
 EXPORT_CDECL(Window*) FindRegisteredWindow(LPCWSTR prefix);
-extern void LoadCompleted(UINT64 id, LPVOID result);
-extern void LoadItemCompleted(UINT64 id, LPVOID result);
+EXPORT_CDECL(double) GetFrameTime();
+EXPORT_CDECL(void) ScheduleFrame(IFrameListener*, IFrameSurface*, double time);
+EXPORT_CDECL(void) UnscheduleFrame(IFrameListener*);
+extern void InitializeFrameTimer();
+extern void ShutdownFrameTimer();
+extern void InitializeIconStore();
+extern void ShutdownIconStore();
+extern void InitializeImageCache();
+extern void ShutdownImageCache();
+extern void InitializeThumbnailCache();
+extern void ShutdownThumbnailCache();
+extern bool HandleFrameTimer(UINT_PTR timer);
+extern void FrameTimerDisplayChange();
+extern void InitializeFileSystemLoader();
+extern void ShutdownFileSystemLoader();
+extern void DeliverLoadResults();
 extern void SendCoreMessage(UINT message, WPARAM, LPARAM);
 
 
+/// <summary>
+/// Sends out change notifications for the [time] text function at the start of every second.
+/// </summary>
+static class TimeUpdater : public IFrameListener {
+public:
+  double OnFrame(double time) override {
+    DynamicTextChangeNotification(L"Time", 0);
+    DynamicTextChangeNotification(L"Time", 1);
+    DynamicTextChangeNotification(L"WindowTitle", 1);
+    return time + TimeToNextSecond();
+  }
+
+  static double TimeToNextSecond() {
+    SYSTEMTIME now;
+    GetLocalTime(&now);
+    return (1000 - now.wMilliseconds) / 1000.0;
+  }
+} sTimeUpdater;
+
+
 /// <summary>
 /// Gets the current core version.
 /// </summary>
@@ -98,23 +130,16 @@ static LRESULT WINAPI MainProc(HWND window, UINT message, WPARAM wParam, LPARAM
 
   case WM_DISPLAYCHANGE:
     gMonitorInfo.Update();
+    FrameTimerDisplayChange();
     SendCoreMessage(NCORE_DISPLAYCHANGE, wParam, lParam);
     return 0;
 
   case WM_TIMER:
-    if (wParam == timeTimer) {
-      DynamicTextChangeNotification(L"Time", 0);
-      DynamicTextChangeNotification(L"Time", 1);
-      DynamicTextChangeNotification(L"WindowTitle", 1);
-    }
-    return 0;
-
-  case NCORE_FILE_SYSTEM_LOAD_COMPLETE:
-    LoadCompleted(UINT64(wParam), LPVOID(lParam));
+    HandleFrameTimer(wParam);
     return 0;
 
-  case NCORE_FILE_SYSTEM_ITEM_LOAD_COMPLETE:
-    LoadItemCompleted(UINT64(wParam), LPVOID(lParam));
+  case NCORE_FILE_SYSTEM_RESULTS_READY:
+    DeliverLoadResults();
     return 0;
   }
   return DefWindowProcW(window, message, wParam, lParam);
@@ -177,7 +202,12 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR path) {
   }
 
   TextFunctions::_Register();
-  timeTimer = SetTimer(ghWndMsgHandler, 1, 1000, nullptr);
+  InitializeFrameTimer();
+  InitializeIconStore();
+  InitializeImageCache();
+  InitializeThumbnailCache();
+  InitializeFileSystemLoader();
+  ScheduleFrame(&sTimeUpdater, nullptr, GetFrameTime() + sTimeUpdater.TimeToNextSecond());
 
   // We need to be connected to the core for some of the functions in nShared to work... xD
   nCore::Connect(MakeVersion(MODULE_VERSION));
@@ -206,13 +236,18 @@ EXPORT_CDECL(void) quitModule(HINSTANCE instance) {
   BrushBangs::UnRegister(L"n");
 
   // Deinitalize
+  ShutdownFileSystemLoader();
   if (ghWndMsgHandler) {
-    KillTimer(ghWndMsgHandler, timeTimer);
+    UnscheduleFrame(&sTimeUpdater);
+    ShutdownFrameTimer();
     SendMessageW(LiteStep::GetLitestepWnd(), LM_UNREGISTERMESSAGE, (WPARAM)ghWndMsgHandler, (LPARAM)gLSMessages);
     DestroyWindow(ghWndMsgHandler);
   }
 
   TextFunctions::_Unregister();
+  ShutdownImageCache();
+  ShutdownThumbnailCache();
+  ShutdownIconStore();
 
   UnregisterClassW(gMsgHandler, instance);
 }
@@ -7,8 +7,11 @@
 //-------------------------------------------------------------------------------------------------
 #pragma once
 
+#include "../nCore/CachedImage.hpp"
 #include "../nCore/CoreMessages.h"
 #include "../nCore/FileSystemLoader.h"
+#include "../nCore/IconStore.hpp"
+#include "../nCore/IFrameListener.hpp"
 #include "../nCore/IParsedText.hpp"
 
 #include "../nShared/MonitorInfo.hpp"
@@ -31,6 +34,28 @@ namespace nCore {
   // FileSystemLoader
   UINT64 LoadFolder(LoadFolderRequest&, FileSystemLoaderResponseHandler*);
   UINT64 LoadFolderItem(LoadItemRequest&, FileSystemLoaderResponseHandler*);
+  void CancelLoad(UINT64 id);
+
+  // Frame Scheduler
+  double GetFrameTime();
+  void RemoveFrameSurface(IFrameSurface*);
+  void ScheduleFrame(IFrameListener*, IFrameSurface*, double time);
+  void UnscheduleFrame(IFrameListener*);
+
+  // Icon Store
+  HICON FindIcon(LPCWSTR path, int index, UINT size);
+  void GetIconStoreStatistics(IconStore::Statistics*);
+  void ReleaseIcon(HICON);
+  HICON StoreIcon(LPCWSTR path, int index, UINT size, HICON);
+
+  // Image Cache
+  const CachedImage *AcquireImage(LPCWSTR path, UINT width, UINT height);
+  void ReleaseImage(const CachedImage*);
+
+  // Thumbnail Cache
+  IWICBitmap *LoadCachedThumbnail(LPCWSTR path, UINT iconSize);
+  void CacheThumbnailBitmap(LPCWSTR path, UINT iconSize, HBITMAP bitmap);
+  void CacheThumbnailIcon(LPCWSTR path, UINT iconSize, HICON icon);
 
   namespace System {
     // Dynamic Text Service
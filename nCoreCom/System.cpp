@@ -14,6 +14,20 @@ namespace nCore {
   DECL_FUNC_VAR(FetchMonitorInfo);
   DECL_FUNC_VAR(LoadFolder);
   DECL_FUNC_VAR(LoadFolderItem);
+  DECL_FUNC_VAR(CancelLoad);
+  DECL_FUNC_VAR(GetFrameTime);
+  DECL_FUNC_VAR(RemoveFrameSurface);
+  DECL_FUNC_VAR(ScheduleFrame);
+  DECL_FUNC_VAR(UnscheduleFrame);
+  DECL_FUNC_VAR(FindIcon);
+  DECL_FUNC_VAR(GetIconStoreStatistics);
+  DECL_FUNC_VAR(ReleaseIcon);
+  DECL_FUNC_VAR(StoreIcon);
+  DECL_FUNC_VAR(AcquireImage);
+  DECL_FUNC_VAR(ReleaseImage);
+  DECL_FUNC_VAR(LoadCachedThumbnail);
+  DECL_FUNC_VAR(CacheThumbnailBitmap);
+  DECL_FUNC_VAR(CacheThumbnailIcon);
 
   namespace System {
     DECL_FUNC_VAR(ParseText);
@@ -39,6 +53,24 @@ HRESULT nCore::System::_Init(HMODULE hCoreInstance) {
 
   INIT_FUNC(LoadFolder);
   INIT_FUNC(LoadFolderItem);
+  INIT_FUNC(CancelLoad);
+
+  INIT_FUNC(GetFrameTime);
+  INIT_FUNC(RemoveFrameSurface);
+  INIT_FUNC(ScheduleFrame);
+  INIT_FUNC(UnscheduleFrame);
+
+  INIT_FUNC(FindIcon);
+  INIT_FUNC(GetIconStoreStatistics);
+  INIT_FUNC(ReleaseIcon);
+  INIT_FUNC(StoreIcon);
+
+  INIT_FUNC(AcquireImage);
+  INIT_FUNC(ReleaseImage);
+
+  INIT_FUNC(LoadCachedThumbnail);
+  INIT_FUNC(CacheThumbnailBitmap);
+  INIT_FUNC(CacheThumbnailIcon);
 
   INIT_FUNC(ParseText);
   INIT_FUNC(RegisterDynamicTextFunction);
@@ -63,6 +95,24 @@ void nCore::System::_DeInit() {
 
   FUNC_VAR_NAME(LoadFolder) = nullptr;
   FUNC_VAR_NAME(LoadFolderItem) = nullptr;
+  FUNC_VAR_NAME(CancelLoad) = nullptr;
+
+  FUNC_VAR_NAME(GetFrameTime) = nullptr;
+  FUNC_VAR_NAME(RemoveFrameSurface) = nullptr;
+  FUNC_VAR_NAME(ScheduleFrame) = nullptr;
+  FUNC_VAR_NAME(UnscheduleFrame) = nullptr;
+
+  FUNC_VAR_NAME(FindIcon) = nullptr;
+  FUNC_VAR_NAME(GetIconStoreStatistics) = nullptr;
+  FUNC_VAR_NAME(ReleaseIcon) = nullptr;
+  FUNC_VAR_NAME(StoreIcon) = nullptr;
+
+  FUNC_VAR_NAME(AcquireImage) = nullptr;
+  FUNC_VAR_NAME(ReleaseImage) = nullptr;
+
+  FUNC_VAR_NAME(LoadCachedThumbnail) = nullptr;
+  FUNC_VAR_NAME(CacheThumbnailBitmap) = nullptr;
+  FUNC_VAR_NAME(CacheThumbnailIcon) = nullptr;
 
   FUNC_VAR_NAME(ParseText) = nullptr;
   FUNC_VAR_NAME(RegisterDynamicTextFunction) = nullptr;
@@ -148,3 +198,87 @@ UINT64 nCore::LoadFolderItem(LoadItemRequest &request, FileSystemLoaderResponseH
   ASSERT(nCore::Initialized());
   return FUNC_VAR_NAME(LoadFolderItem)(request, handler);
 }
+
+
+void nCore::CancelLoad(UINT64 id) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(CancelLoad)(id);
+}
+
+
+double nCore::GetFrameTime() {
+  ASSERT(nCore::Initialized());
+  return FUNC_VAR_NAME(GetFrameTime)();
+}
+
+
+void nCore::RemoveFrameSurface(IFrameSurface *surface) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(RemoveFrameSurface)(surface);
+}
+
+
+void nCore::ScheduleFrame(IFrameListener *listener, IFrameSurface *surface, double time) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(ScheduleFrame)(listener, surface, time);
+}
+
+
+void nCore::UnscheduleFrame(IFrameListener *listener) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(UnscheduleFrame)(listener);
+}
+
+
+HICON nCore::FindIcon(LPCWSTR path, int index, UINT size) {
+  ASSERT(nCore::Initialized());
+  return FUNC_VAR_NAME(FindIcon)(path, index, size);
+}
+
+
+void nCore::GetIconStoreStatistics(IconStore::Statistics *statistics) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(GetIconStoreStatistics)(statistics);
+}
+
+
+void nCore::ReleaseIcon(HICON icon) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(ReleaseIcon)(icon);
+}
+
+
+HICON nCore::StoreIcon(LPCWSTR path, int index, UINT size, HICON icon) {
+  ASSERT(nCore::Initialized());
+  return FUNC_VAR_NAME(StoreIcon)(path, index, size, icon);
+}
+
+
+const CachedImage *nCore::AcquireImage(LPCWSTR path, UINT width, UINT height) {
+  ASSERT(nCore::Initialized());
+  return FUNC_VAR_NAME(AcquireImage)(path, width, height);
+}
+
+
+void nCore::ReleaseImage(const CachedImage *image) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(ReleaseImage)(image);
+}
+
+
+IWICBitmap *nCore::LoadCachedThumbnail(LPCWSTR path, UINT iconSize) {
+  ASSERT(nCore::Initialized());
+  return FUNC_VAR_NAME(LoadCachedThumbnail)(path, iconSize);
+}
+
+
+void nCore::CacheThumbnailBitmap(LPCWSTR path, UINT iconSize, HBITMAP bitmap) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(CacheThumbnailBitmap)(path, iconSize, bitmap);
+}
+
+
+void nCore::CacheThumbnailIcon(LPCWSTR path, UINT iconSize, HICON icon) {
+  ASSERT(nCore::Initialized());
+  FUNC_VAR_NAME(CacheThumbnailIcon)(path, iconSize, icon);
+}
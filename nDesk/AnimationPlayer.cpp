@@ -0,0 +1,249 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/AnimationPlayer.cpp
+// The nModules Project
+//
+// Plays animated wallpapers from a bounded buffer of decoded frames.
+//-------------------------------------------------------------------------------------------------
+#include "AnimationPlayer.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+const double AnimationPlayer::IDLE = -1.0;
+const double AnimationPlayer::MAX_LAG = 0.25;
+
+
+AnimationPlayer::Frame::Frame()
+  : sequence(0)
+  , duration(0)
+  , width(0)
+  , height(0)
+{
+}
+
+
+AnimationPlayer::AnimationPlayer(std::unique_ptr<ISource> source, size_t capacity,
+    std::function<void()> onReady)
+  : mSource(std::move(source))
+  , mCapacity(std::max<size_t>(1, capacity))
+  , mOnReady(onReady)
+  , mSkipBefore(0)
+  , mWaiting(false)
+  , mSourceDone(false)
+  , mHasCurrent(false)
+  , mNextDue(0)
+  , mNextSequence(0)
+  , mPaused(false)
+  , mPausedAt(0)
+  , mDropped(0)
+  , mStopping(false)
+{
+  mWorker = std::thread(&AnimationPlayer::Run, this);
+}
+
+
+AnimationPlayer::~AnimationPlayer() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopping = true;
+  }
+  mWake.notify_one();
+  mWorker.join();
+}
+
+
+double AnimationPlayer::Update(double now, const Frame **present) {
+  std::unique_lock<std::mutex> lock(mMutex);
+  *present = nullptr;
+
+  if (IsPausedLocked()) {
+    return IDLE;
+  }
+
+  // Take every frame which is due. Only the last one which has pixels is shown.
+  Frame shown;
+  bool hasShown = false;
+  while (!mRing.empty()) {
+    Frame &next = mRing.front();
+    if (!mHasCurrent && !hasShown) {
+      mNextDue = now;
+    } else if (now < mNextDue) {
+      break;
+    } else if (now - mNextDue > MAX_LAG && !next.pixels.empty()) {
+      // Rather than racing through everything that was missed, carry on from here.
+      mNextDue = now;
+    }
+
+    mNextDue += next.duration;
+    mNextSequence = next.sequence + 1;
+    if (next.pixels.empty()) {
+      ++mDropped;
+    } else {
+      if (hasShown) {
+        ++mDropped;
+        mPool.push_back(std::move(shown.pixels));
+      }
+      shown = std::move(next);
+      hasShown = true;
+    }
+    mRing.pop_front();
+  }
+
+  if (hasShown) {
+    if (mHasCurrent) {
+      mPool.push_back(std::move(mCurrent.pixels));
+    }
+    mCurrent = std::move(shown);
+    mHasCurrent = true;
+    *present = &mCurrent;
+  }
+
+  // The worker has room again.
+  mWake.notify_one();
+
+  if (!mRing.empty()) {
+    return mNextDue;
+  }
+  if (mSourceDone) {
+    return IDLE;
+  }
+
+  // The worker is behind. Have it skip the frames which are already late, and say when the next
+  // one is ready.
+  if (mHasCurrent && now > mNextDue && mCurrent.duration > 0) {
+    uint64_t late = uint64_t(floor((now - mNextDue) / mCurrent.duration)) + 1;
+    mSkipBefore = std::max(mSkipBefore, mNextSequence + late);
+  }
+  mWaiting = true;
+  return IDLE;
+}
+
+
+void AnimationPlayer::SetPaused(bool paused, double now) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  bool wasPaused = IsPausedLocked();
+  mPaused = paused;
+  UpdatePause(wasPaused, now);
+}
+
+
+void AnimationPlayer::SetMonitorCount(size_t count) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  mCovered.assign(count, false);
+}
+
+
+void AnimationPlayer::SetMonitorCovered(size_t monitor, bool covered, double now) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  if (monitor < mCovered.size()) {
+    bool wasPaused = IsPausedLocked();
+    mCovered[monitor] = covered;
+    UpdatePause(wasPaused, now);
+  }
+}
+
+
+bool AnimationPlayer::IsPaused() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return IsPausedLocked();
+}
+
+
+bool AnimationPlayer::IsCovered(size_t monitor) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return monitor < mCovered.size() && mCovered[monitor];
+}
+
+
+bool AnimationPlayer::IsFinished() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mSourceDone && mRing.empty();
+}
+
+
+size_t AnimationPlayer::GetBufferedCount() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mRing.size();
+}
+
+
+uint64_t AnimationPlayer::GetDroppedCount() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mDropped;
+}
+
+
+bool AnimationPlayer::IsPausedLocked() const {
+  return mPaused || (!mCovered.empty()
+    && std::find(mCovered.begin(), mCovered.end(), false) == mCovered.end());
+}
+
+
+void AnimationPlayer::UpdatePause(bool wasPaused, double now) {
+  bool paused = IsPausedLocked();
+  if (!wasPaused && paused) {
+    mPausedAt = now;
+  } else if (wasPaused && !paused && mHasCurrent) {
+    // Carry on with whatever was left of the current frame.
+    mNextDue += now - mPausedAt;
+  }
+}
+
+
+void AnimationPlayer::Run() {
+  bool opened = mSource->Open();
+  const uint32_t frameCount = opened ? mSource->GetFrameCount() : 0;
+  const uint32_t loopCount = opened ? mSource->GetLoopCount() : 0;
+
+  // A single frame isn't an animation.
+  const uint64_t totalFrames = frameCount < 2 ? 0
+    : loopCount == 0 ? std::numeric_limits<uint64_t>::max() : uint64_t(loopCount) * frameCount;
+
+  const std::function<bool()> cancelled = [this] () {
+    return mStopping.load();
+  };
+
+  for (uint64_t sequence = 0; sequence < totalFrames; ++sequence) {
+    Frame frame;
+    frame.sequence = sequence;
+    bool skip;
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mWake.wait(lock, [this] () { return mRing.size() < mCapacity || mStopping; });
+      if (mStopping) {
+        break;
+      }
+      skip = sequence < mSkipBefore;
+      if (!skip && !mPool.empty()) {
+        frame.pixels = std::move(mPool.back());
+        mPool.pop_back();
+      }
+    }
+
+    if (!mSource->Compose(uint32_t(sequence % frameCount), &frame.duration)) {
+      break;
+    }
+    if (skip) {
+      frame.pixels.clear();
+    } else if (!mSource->Render(cancelled, &frame) || frame.pixels.empty()) {
+      break;
+    }
+
+    bool notify;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mRing.push_back(std::move(frame));
+      notify = mWaiting;
+      mWaiting = false;
+    }
+    if (notify) {
+      mOnReady();
+    }
+  }
+
+  mSource->Close();
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  mSourceDone = true;
+}
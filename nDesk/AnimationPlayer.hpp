@@ -0,0 +1,177 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/AnimationPlayer.hpp
+// The nModules Project
+//
+// Plays animated wallpapers from a bounded buffer of decoded frames.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Plays an animated wallpaper. A worker thread decodes and scales frames ahead of time into a
+/// small ring, and every update picks the frame which is due. When updates are late, the frames
+/// which were due in between are dropped. When the worker is late, the current frame is held, and
+/// frames which would be late anyway are composed but never scaled, until it has caught up.
+/// Playback pauses while every monitor is covered by a fullscreen window, and the worker goes to
+/// sleep once the ring is full.
+/// </summary>
+class AnimationPlayer {
+public:
+  /// <summary>
+  /// A decoded frame.
+  /// </summary>
+  struct Frame {
+    Frame();
+
+    // The position of the frame in the playback, counting every loop.
+    uint64_t sequence;
+
+    // How long the frame is shown, in seconds.
+    double duration;
+
+    // The scaled frame, in premultiplied 32bpp BGRA. Empty if the frame was dropped.
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> pixels;
+  };
+
+  /// <summary>
+  /// Decodes the frames. Every method is called on the worker thread.
+  /// </summary>
+  class ISource {
+  public:
+    virtual ~ISource() {}
+
+    /// <summary>
+    /// Opens the animation. Close is called once the worker is done, even if this fails.
+    /// </summary>
+    /// <returns>False if the animation can't be played.</returns>
+    virtual bool Open() = 0;
+    virtual void Close() = 0;
+
+    virtual uint32_t GetFrameCount() = 0;
+
+    // The number of times to play the animation, or 0 to loop forever.
+    virtual uint32_t GetLoopCount() = 0;
+
+    /// <summary>
+    /// Builds the given frame, and retrieves how long it is shown. Frames are composed in order,
+    /// starting over at 0 for every loop, so that frames which only update part of the image
+    /// work.
+    /// </summary>
+    virtual bool Compose(uint32_t index, double *duration) = 0;
+
+    /// <summary>
+    /// Scales the last composed frame into frame. Should check cancelled every now and then, and
+    /// give up if it returns true.
+    /// </summary>
+    virtual bool Render(const std::function<bool()> &cancelled, Frame *frame) = 0;
+  };
+
+public:
+  // Returned by Update when there is nothing to do until something changes.
+  static const double IDLE;
+
+  // How far behind updates may fall before playback slips, instead of skipping ahead.
+  static const double MAX_LAG;
+
+public:
+  /// <param name="source">Decodes the frames.</param>
+  /// <param name="capacity">The maximum number of decoded frames to buffer.</param>
+  /// <param name="onReady">Called on the worker thread when a frame has arrived after Update
+  /// returned IDLE because none was ready.</param>
+  AnimationPlayer(std::unique_ptr<ISource> source, size_t capacity, std::function<void()> onReady);
+  ~AnimationPlayer();
+
+  AnimationPlayer(const AnimationPlayer&) = delete;
+  AnimationPlayer &operator=(const AnimationPlayer&) = delete;
+
+public:
+  /// <summary>
+  /// Advances playback to the given time.
+  /// </summary>
+  /// <param name="present">Receives the frame to show, or nullptr if it hasn't changed. The frame
+  /// stays valid until the next call.</param>
+  /// <returns>The time the next frame is due, or IDLE.</returns>
+  double Update(double now, const Frame **present);
+
+  // Pauses or resumes playback. Playback resumes where it was paused.
+  void SetPaused(bool paused, double now);
+
+  // Sets the number of monitors the animation is shown on. None of them are covered.
+  void SetMonitorCount(size_t count);
+
+  // Marks a monitor as covered, or no longer covered, by a fullscreen window.
+  void SetMonitorCovered(size_t monitor, bool covered, double now);
+
+public:
+  bool IsPaused();
+  bool IsCovered(size_t monitor);
+
+  // True once the animation has played all of its loops, or failed to decode.
+  bool IsFinished();
+
+  // The number of decoded frames waiting to be shown.
+  size_t GetBufferedCount();
+
+  // The number of frames which were never shown.
+  uint64_t GetDroppedCount();
+
+private:
+  void Run();
+
+  // Whether playback is paused. Requires the mutex.
+  bool IsPausedLocked() const;
+
+  // Applies a change to the pause state. Requires the mutex.
+  void UpdatePause(bool wasPaused, double now);
+
+private:
+  std::unique_ptr<ISource> mSource;
+  const size_t mCapacity;
+  std::function<void()> mOnReady;
+
+  std::mutex mMutex;
+  std::condition_variable mWake;
+
+  // Frames which have been decoded, in order.
+  std::deque<Frame> mRing;
+
+  // Pixel buffers of frames which have been shown, for the worker to reuse.
+  std::vector<std::vector<uint8_t>> mPool;
+
+  // The worker composes, but doesn't scale, frames before this one.
+  uint64_t mSkipBefore;
+
+  // True if Update ran out of frames, and is waiting for the worker.
+  bool mWaiting;
+
+  // True once the worker won't produce any more frames.
+  bool mSourceDone;
+
+  // The frame on screen, and the time the one after it is due.
+  Frame mCurrent;
+  bool mHasCurrent;
+  double mNextDue;
+
+  // The sequence number of the next frame to show.
+  uint64_t mNextSequence;
+
+  bool mPaused;
+  std::vector<bool> mCovered;
+  double mPausedAt;
+
+  uint64_t mDropped;
+
+  std::atomic<bool> mStopping;
+  std::thread mWorker;
+};
@@ -0,0 +1,373 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/AnimationSource.cpp
+// The nModules Project
+//
+// Decodes the frames of animated wallpapers with WIC.
+//-------------------------------------------------------------------------------------------------
+#include "../Utilities/Common.h"
+#include "AnimationSource.hpp"
+#include "WallpaperDecoder.hpp"
+
+#include <algorithm>
+#include <Shlwapi.h>
+
+// The number of rows to scale between checks for cancellation.
+static const UINT ROWS_PER_SLICE = 64;
+
+// GIF delays are in 1/100ths of a second. Like browsers, treat tiny delays as 1/10th of a second.
+static const double DEFAULT_DELAY = 0.1;
+
+// The files which are part of an image sequence.
+static const LPCWSTR SEQUENCE_EXTENSIONS[] = {
+  L".bmp", L".gif", L".jpeg", L".jpg", L".png", L".tif", L".tiff"
+};
+
+
+/// <summary>
+/// Reads an unsigned integer from the metadata.
+/// </summary>
+static bool ReadMetadata(IWICMetadataQueryReader *reader, LPCWSTR name, UINT *value) {
+  PROPVARIANT variant;
+  PropVariantInit(&variant);
+  bool found = false;
+  if (SUCCEEDED(reader->GetMetadataByName(name, &variant))) {
+    if (variant.vt == VT_UI1) {
+      *value = variant.bVal;
+      found = true;
+    } else if (variant.vt == VT_UI2) {
+      *value = variant.uiVal;
+      found = true;
+    }
+  }
+  PropVariantClear(&variant);
+  return found;
+}
+
+
+/// <summary>
+/// Reads the number of times to play a GIF from its NETSCAPE2.0 extension. Without one, the GIF
+/// is played once.
+/// </summary>
+static UINT ReadLoopCount(IWICMetadataQueryReader *reader) {
+  UINT loops = 1;
+  PROPVARIANT application, data;
+  PropVariantInit(&application);
+  PropVariantInit(&data);
+
+  if (SUCCEEDED(reader->GetMetadataByName(L"/appext/Application", &application))
+      && application.vt == (VT_UI1 | VT_VECTOR) && application.caub.cElems == 11
+      && memcmp(application.caub.pElems, "NETSCAPE2.0", 11) == 0
+      && SUCCEEDED(reader->GetMetadataByName(L"/appext/Data", &data))
+      && data.vt == (VT_UI1 | VT_VECTOR) && data.caub.cElems >= 4
+      && data.caub.pElems[0] >= 3 && data.caub.pElems[1] == 1) {
+    // The count is the number of repetitions after the first, and 0 means forever.
+    UINT repetitions = data.caub.pElems[2] | data.caub.pElems[3] << 8;
+    loops = repetitions == 0 ? 0 : repetitions + 1;
+  }
+
+  PropVariantClear(&application);
+  PropVariantClear(&data);
+  return loops;
+}
+
+
+AnimationSource::AnimationSource(const WallpaperLoader::Request &request, double frameRate)
+  : mRequest(request)
+  , mFrameRate(frameRate > 0 ? frameRate : 24.0)
+  , mFactory(nullptr)
+  , mDecoder(nullptr)
+  , mComInitialized(false)
+  , mFrameCount(0)
+  , mLoopCount(0)
+  , mCanvasWidth(0)
+  , mCanvasHeight(0)
+  , mDisposal(Disposal::None)
+{
+  ZeroMemory(&mDisposalRect, sizeof(mDisposalRect));
+}
+
+
+bool AnimationSource::Open() {
+  mComInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+
+  // The shared factory is created lazily on the UI thread, so use one of our own.
+  if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+      IID_IWICImagingFactory, reinterpret_cast<LPVOID*>(&mFactory)))) {
+    return false;
+  }
+
+  DWORD attributes = GetFileAttributes(mRequest.path.c_str());
+  if (attributes == INVALID_FILE_ATTRIBUTES) {
+    return false;
+  }
+  return (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0 ? OpenSequence() : OpenAnimation();
+}
+
+
+void AnimationSource::Close() {
+  SAFERELEASE(mDecoder);
+  SAFERELEASE(mFactory);
+  if (mComInitialized) {
+    CoUninitialize();
+    mComInitialized = false;
+  }
+}
+
+
+uint32_t AnimationSource::GetFrameCount() {
+  return mFrameCount;
+}
+
+
+uint32_t AnimationSource::GetLoopCount() {
+  return mLoopCount;
+}
+
+
+bool AnimationSource::OpenSequence() {
+  WIN32_FIND_DATA findData;
+  HANDLE find = FindFirstFile((mRequest.path + L"\\*").c_str(), &findData);
+  if (find == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  do {
+    if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+      LPCWSTR extension = PathFindExtension(findData.cFileName);
+      for (LPCWSTR sequenceExtension : SEQUENCE_EXTENSIONS) {
+        if (_wcsicmp(extension, sequenceExtension) == 0) {
+          mFiles.push_back(mRequest.path + L"\\" + findData.cFileName);
+          break;
+        }
+      }
+    }
+  } while (FindNextFile(find, &findData));
+  FindClose(find);
+
+  // Play frame10 after frame9.
+  std::sort(mFiles.begin(), mFiles.end(), [] (const std::wstring &a, const std::wstring &b) {
+    return StrCmpLogicalW(a.c_str(), b.c_str()) < 0;
+  });
+
+  mFrameCount = (uint32_t)mFiles.size();
+  mLoopCount = 0;
+  return mFrameCount > 1;
+}
+
+
+bool AnimationSource::OpenAnimation() {
+  HRESULT hr = mFactory->CreateDecoderFromFilename(mRequest.path.c_str(), nullptr, GENERIC_READ,
+    WICDecodeMetadataCacheOnLoad, &mDecoder);
+  if (SUCCEEDED(hr)) {
+    hr = mDecoder->GetFrameCount(&mFrameCount);
+  }
+  if (FAILED(hr) || mFrameCount < 2) {
+    return false;
+  }
+
+  // Frames are drawn onto a canvas the size of the logical screen. Formats without one just use
+  // the size of the first frame.
+  UINT width = 0, height = 0;
+  mLoopCount = 0;
+  IWICMetadataQueryReader *reader;
+  if (SUCCEEDED(mDecoder->GetMetadataQueryReader(&reader))) {
+    ReadMetadata(reader, L"/logscrdesc/Width", &width);
+    ReadMetadata(reader, L"/logscrdesc/Height", &height);
+    mLoopCount = ReadLoopCount(reader);
+    reader->Release();
+  }
+  if (width == 0 || height == 0) {
+    IWICBitmapFrameDecode *frame;
+    hr = mDecoder->GetFrame(0, &frame);
+    if (SUCCEEDED(hr)) {
+      hr = frame->GetSize(&width, &height);
+      frame->Release();
+    }
+  }
+
+  mCanvasWidth = width;
+  mCanvasHeight = height;
+  return SUCCEEDED(hr) && width > 0 && height > 0;
+}
+
+
+bool AnimationSource::Compose(uint32_t index, double *duration) {
+  if (!mFiles.empty()) {
+    *duration = 1.0 / mFrameRate;
+    return ComposeFile(index);
+  }
+  return ComposeFrame(index, duration);
+}
+
+
+bool AnimationSource::ComposeFile(uint32_t index) {
+  IWICBitmapDecoder *decoder = nullptr;
+  IWICBitmapFrameDecode *frame = nullptr;
+  UINT width, height;
+
+  HRESULT hr = mFactory->CreateDecoderFromFilename(mFiles[index].c_str(), nullptr, GENERIC_READ,
+    WICDecodeMetadataCacheOnDemand, &decoder);
+  if (SUCCEEDED(hr)) {
+    hr = decoder->GetFrame(0, &frame);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = frame->GetSize(&width, &height);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = CopyFrame(frame, width, height, mCanvas);
+  }
+  if (SUCCEEDED(hr)) {
+    mCanvasWidth = width;
+    mCanvasHeight = height;
+  }
+
+  SAFERELEASE(frame);
+  SAFERELEASE(decoder);
+
+  return SUCCEEDED(hr);
+}
+
+
+bool AnimationSource::ComposeFrame(uint32_t index, double *duration) {
+  const size_t canvasStride = size_t(mCanvasWidth) * 4;
+
+  // Start every loop from a clear canvas, and otherwise clean up after the previous frame.
+  if (index == 0 || mCanvas.empty()) {
+    mCanvas.assign(canvasStride * mCanvasHeight, 0);
+  } else if (mDisposal == Disposal::Background) {
+    for (INT y = mDisposalRect.Y; y < mDisposalRect.Y + mDisposalRect.Height; ++y) {
+      memset(&mCanvas[y * canvasStride + size_t(mDisposalRect.X) * 4], 0,
+        size_t(mDisposalRect.Width) * 4);
+    }
+  } else if (mDisposal == Disposal::Previous) {
+    for (INT y = 0; y < mDisposalRect.Height; ++y) {
+      memcpy(&mCanvas[(mDisposalRect.Y + y) * canvasStride + size_t(mDisposalRect.X) * 4],
+        &mSaved[size_t(y) * mDisposalRect.Width * 4], size_t(mDisposalRect.Width) * 4);
+    }
+  }
+  mDisposal = Disposal::None;
+
+  IWICBitmapFrameDecode *frame;
+  UINT width, height;
+  HRESULT hr = mDecoder->GetFrame(index, &frame);
+  if (FAILED(hr)) {
+    return false;
+  }
+  hr = frame->GetSize(&width, &height);
+
+  // Where the frame goes, how long it's shown for, and what happens to it afterwards.
+  UINT left = 0, top = 0, delay = 0, disposal = 0;
+  IWICMetadataQueryReader *reader;
+  if (SUCCEEDED(hr) && SUCCEEDED(frame->GetMetadataQueryReader(&reader))) {
+    ReadMetadata(reader, L"/imgdesc/Left", &left);
+    ReadMetadata(reader, L"/imgdesc/Top", &top);
+    ReadMetadata(reader, L"/grctlext/Delay", &delay);
+    ReadMetadata(reader, L"/grctlext/Disposal", &disposal);
+    reader->Release();
+  }
+  *duration = delay <= 1 ? DEFAULT_DELAY : delay / 100.0;
+
+  if (SUCCEEDED(hr)) {
+    hr = CopyFrame(frame, width, height, mFrame);
+  }
+  frame->Release();
+  if (FAILED(hr)) {
+    return false;
+  }
+
+  // Frames may hang off the edge of the canvas.
+  WICRect rect;
+  rect.X = (INT)std::min(left, mCanvasWidth);
+  rect.Y = (INT)std::min(top, mCanvasHeight);
+  rect.Width = (INT)std::min(width, mCanvasWidth - rect.X);
+  rect.Height = (INT)std::min(height, mCanvasHeight - rect.Y);
+
+  if (disposal == 3) {
+    mSaved.resize(size_t(rect.Width) * rect.Height * 4);
+    for (INT y = 0; y < rect.Height; ++y) {
+      memcpy(&mSaved[size_t(y) * rect.Width * 4],
+        &mCanvas[(rect.Y + y) * canvasStride + size_t(rect.X) * 4], size_t(rect.Width) * 4);
+    }
+  }
+
+  // Draw the frame over the canvas.
+  for (INT y = 0; y < rect.Height; ++y) {
+    const uint8_t *source = &mFrame[size_t(y) * width * 4];
+    uint8_t *dest = &mCanvas[(rect.Y + y) * canvasStride + size_t(rect.X) * 4];
+    for (INT x = 0; x < rect.Width; ++x, source += 4, dest += 4) {
+      const uint8_t alpha = source[3];
+      if (alpha == 255) {
+        memcpy(dest, source, 4);
+      } else if (alpha != 0) {
+        for (int c = 0; c < 4; ++c) {
+          dest[c] = uint8_t(source[c] + dest[c] * (255 - alpha) / 255);
+        }
+      }
+    }
+  }
+
+  mDisposal = disposal == 2 ? Disposal::Background
+    : disposal == 3 ? Disposal::Previous : Disposal::None;
+  mDisposalRect = rect;
+
+  return true;
+}
+
+
+bool AnimationSource::Render(const std::function<bool()> &cancelled,
+    AnimationPlayer::Frame *frame) {
+  uint32_t width, height;
+  WallpaperDecoder::GetScaledSize(mRequest, mCanvasWidth, mCanvasHeight, &width, &height);
+
+  IWICBitmap *bitmap = nullptr;
+  IWICBitmapScaler *scaler = nullptr;
+  const UINT canvasStride = mCanvasWidth * 4;
+  HRESULT hr = mFactory->CreateBitmapFromMemory(mCanvasWidth, mCanvasHeight,
+    GUID_WICPixelFormat32bppPBGRA, canvasStride, (UINT)mCanvas.size(), mCanvas.data(), &bitmap);
+  if (SUCCEEDED(hr)) {
+    hr = mFactory->CreateBitmapScaler(&scaler);
+  }
+  if (SUCCEEDED(hr)) {
+    // Frames have to keep up with the animation, so use a cheaper filter than for wallpapers.
+    hr = scaler->Initialize(bitmap, width, height, WICBitmapInterpolationModeLinear);
+  }
+
+  if (SUCCEEDED(hr)) {
+    const UINT stride = width * 4;
+    frame->pixels.resize(size_t(stride) * height);
+    for (UINT y = 0; y < height && SUCCEEDED(hr); y += ROWS_PER_SLICE) {
+      if (cancelled()) {
+        hr = E_ABORT;
+        break;
+      }
+      WICRect rect = { 0, (INT)y, (INT)width, (INT)std::min(ROWS_PER_SLICE, height - y) };
+      hr = scaler->CopyPixels(&rect, stride, stride * rect.Height,
+        frame->pixels.data() + size_t(stride) * y);
+    }
+  }
+  if (SUCCEEDED(hr)) {
+    frame->width = width;
+    frame->height = height;
+  }
+
+  SAFERELEASE(scaler);
+  SAFERELEASE(bitmap);
+
+  return SUCCEEDED(hr);
+}
+
+
+HRESULT AnimationSource::CopyFrame(IWICBitmapSource *source, UINT width, UINT height,
+    std::vector<uint8_t> &out) {
+  IWICFormatConverter *converter;
+  HRESULT hr = mFactory->CreateFormatConverter(&converter);
+  if (SUCCEEDED(hr)) {
+    hr = converter->Initialize(source, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone,
+      nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
+    if (SUCCEEDED(hr)) {
+      out.resize(size_t(width) * height * 4);
+      hr = converter->CopyPixels(nullptr, width * 4, (UINT)out.size(), out.data());
+    }
+    converter->Release();
+  }
+  return hr;
+}
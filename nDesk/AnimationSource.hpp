@@ -0,0 +1,81 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/AnimationSource.hpp
+// The nModules Project
+//
+// Decodes the frames of animated wallpapers with WIC.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "AnimationPlayer.hpp"
+#include "WallpaperLoader.hpp"
+
+#include <string>
+#include <vector>
+#include <wincodec.h>
+
+/// <summary>
+/// Decodes the frames of an animated image, e.g. a GIF, or of a folder of images which are played
+/// in order, and scales them the same way the wallpaper is scaled.
+/// </summary>
+class AnimationSource : public AnimationPlayer::ISource {
+public:
+  /// <param name="request">The file or folder to play, and the layout to scale it for.</param>
+  /// <param name="frameRate">The frame rate of image sequences.</param>
+  AnimationSource(const WallpaperLoader::Request &request, double frameRate);
+
+public:
+  bool Open() override;
+  void Close() override;
+  uint32_t GetFrameCount() override;
+  uint32_t GetLoopCount() override;
+  bool Compose(uint32_t index, double *duration) override;
+  bool Render(const std::function<bool()> &cancelled, AnimationPlayer::Frame *frame) override;
+
+private:
+  // How GIF frames are cleared before the next one is drawn.
+  enum class Disposal {
+    None,
+    Background,
+    Previous
+  };
+
+private:
+  bool OpenSequence();
+  bool OpenAnimation();
+
+  // Loads an image of a sequence onto the canvas.
+  bool ComposeFile(uint32_t index);
+
+  // Draws a frame of the animation over the canvas.
+  bool ComposeFrame(uint32_t index, double *duration);
+
+  // Converts a decoded frame to premultiplied BGRA.
+  HRESULT CopyFrame(IWICBitmapSource *source, UINT width, UINT height, std::vector<uint8_t> &out);
+
+private:
+  WallpaperLoader::Request mRequest;
+  double mFrameRate;
+
+  IWICImagingFactory *mFactory;
+  IWICBitmapDecoder *mDecoder;
+  bool mComInitialized;
+
+  // The files of an image sequence. Empty when playing an animated image.
+  std::vector<std::wstring> mFiles;
+
+  uint32_t mFrameCount;
+  uint32_t mLoopCount;
+
+  // The composed image, in premultiplied BGRA.
+  uint32_t mCanvasWidth;
+  uint32_t mCanvasHeight;
+  std::vector<uint8_t> mCanvas;
+
+  // What to do with the area of the last frame before drawing the next.
+  Disposal mDisposal;
+  WICRect mDisposalRect;
+  std::vector<uint8_t> mSaved;
+
+  // Scratch space for decoded frames.
+  std::vector<uint8_t> mFrame;
+};
@@ -63,6 +63,16 @@ static const BangItem bangMap[] = {
   // Sets or clears the invalid all on update flag.
   BangItem(L"SetInvalidateAllOnUpdate", [] (HWND, LPCTSTR args) {
     g_pDesktopPainter->SetInvalidateAllOnUpdate(LiteStep::ParseBool(args));
+  }),
+
+  // Pauses animated wallpapers.
+  BangItem(L"PauseAnimation", [] (HWND, LPCTSTR) {
+    g_pDesktopPainter->SetAnimationPaused(true);
+  }),
+
+  // Resumes animated wallpapers.
+  BangItem(L"ResumeAnimation", [] (HWND, LPCTSTR) {
+    g_pDesktopPainter->SetAnimationPaused(false);
   })
 };
 
@@ -0,0 +1,188 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/BlendKernels.cpp
+// The nModules Project
+//
+// Row kernels for compositing premultiplied 32bpp BGRA pixels on the CPU.
+//-------------------------------------------------------------------------------------------------
+#include "BlendKernels.hpp"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLEND_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 is picked at runtime, so it is compiled in on every x86 target.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BLEND_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#include <cpuid.h>
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+using BlendKernels::InstructionSet;
+
+typedef void (*LerpFunction)(const uint8_t*, const uint8_t*, uint8_t*, uint32_t, uint32_t);
+
+
+/// <summary>
+/// The reference implementation. The vector versions have to match it exactly.
+/// </summary>
+static void LerpScalar(const uint8_t *a, const uint8_t *b, uint8_t *out, uint32_t pixels,
+    uint32_t weight) {
+  const uint32_t inverse = 256 - weight;
+  for (uint32_t i = 0; i < pixels * 4; ++i) {
+    out[i] = uint8_t((a[i] * inverse + b[i] * weight + 128) >> 8);
+  }
+}
+
+
+#ifdef BLEND_SSE2
+static void LerpSSE2(const uint8_t *a, const uint8_t *b, uint8_t *out, uint32_t pixels,
+    uint32_t weight) {
+  // Both products fit in 16 bits, and so does their sum, since the weights add up to 256.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i weightA = _mm_set1_epi16(short(256 - weight));
+  const __m128i weightB = _mm_set1_epi16(short(weight));
+  const __m128i half = _mm_set1_epi16(128);
+
+  uint32_t i = 0;
+  for (; i + 4 <= pixels; i += 4) {
+    const __m128i va = _mm_loadu_si128((const __m128i*)(a + i * 4));
+    const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i * 4));
+    __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), weightA),
+      _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), weightB));
+    __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), weightA),
+      _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), weightB));
+    low = _mm_srli_epi16(_mm_add_epi16(low, half), 8);
+    high = _mm_srli_epi16(_mm_add_epi16(high, half), 8);
+    _mm_storeu_si128((__m128i*)(out + i * 4), _mm_packus_epi16(low, high));
+  }
+  LerpScalar(a + i * 4, b + i * 4, out + i * 4, pixels - i, weight);
+}
+#endif
+
+
+#ifdef BLEND_AVX2
+AVX2_FUNCTION static void LerpAVX2(const uint8_t *a, const uint8_t *b, uint8_t *out,
+    uint32_t pixels, uint32_t weight) {
+  // Unpacking and packing both work within 128-bit lanes, so the pixels end up where they started.
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i weightA = _mm256_set1_epi16(short(256 - weight));
+  const __m256i weightB = _mm256_set1_epi16(short(weight));
+  const __m256i half = _mm256_set1_epi16(128);
+
+  uint32_t i = 0;
+  for (; i + 8 <= pixels; i += 8) {
+    const __m256i va = _mm256_loadu_si256((const __m256i*)(a + i * 4));
+    const __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i * 4));
+    __m256i low = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), weightA),
+      _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), weightB));
+    __m256i high = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), weightA),
+      _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), weightB));
+    low = _mm256_srli_epi16(_mm256_add_epi16(low, half), 8);
+    high = _mm256_srli_epi16(_mm256_add_epi16(high, half), 8);
+    _mm256_storeu_si256((__m256i*)(out + i * 4), _mm256_packus_epi16(low, high));
+  }
+  LerpScalar(a + i * 4, b + i * 4, out + i * 4, pixels - i, weight);
+}
+
+
+/// <summary>
+/// Checks that both the CPU and the OS support AVX2.
+/// </summary>
+static bool SupportsAVX2() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+
+static InstructionSet BestInstructionSet() {
+#ifdef BLEND_AVX2
+  if (SupportsAVX2()) {
+    return InstructionSet::AVX2;
+  }
+#endif
+#ifdef BLEND_SSE2
+  return InstructionSet::SSE2;
+#else
+  return InstructionSet::Scalar;
+#endif
+}
+
+
+static InstructionSet sInstructionSet = BestInstructionSet();
+static LerpFunction sLerp = nullptr;
+
+
+static LerpFunction LerpFor(InstructionSet instructionSet) {
+  switch (instructionSet) {
+#ifdef BLEND_AVX2
+  case InstructionSet::AVX2:
+    return LerpAVX2;
+#endif
+#ifdef BLEND_SSE2
+  case InstructionSet::SSE2:
+    return LerpSSE2;
+#endif
+  default:
+    return LerpScalar;
+  }
+}
+
+
+void BlendKernels::Lerp(const uint8_t *a, const uint8_t *b, uint8_t *out, uint32_t pixels,
+    uint32_t weight) {
+  if (weight == 0) {
+    Copy(a, out, pixels);
+  } else if (weight >= 256) {
+    Copy(b, out, pixels);
+  } else {
+    if (sLerp == nullptr) {
+      sLerp = LerpFor(sInstructionSet);
+    }
+    sLerp(a, b, out, pixels, weight);
+  }
+}
+
+
+void BlendKernels::Copy(const uint8_t *in, uint8_t *out, uint32_t pixels) {
+  if (in != out) {
+    memmove(out, in, size_t(pixels) * 4);
+  }
+}
+
+
+InstructionSet BlendKernels::GetInstructionSet() {
+  return sInstructionSet;
+}
+
+
+void BlendKernels::SetInstructionSet(InstructionSet instructionSet) {
+  const InstructionSet best = BestInstructionSet();
+  sInstructionSet = int(instructionSet) <= int(best) ? instructionSet : best;
+  sLerp = LerpFor(sInstructionSet);
+}
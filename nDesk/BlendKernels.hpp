@@ -0,0 +1,43 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/BlendKernels.hpp
+// The nModules Project
+//
+// Row kernels for compositing premultiplied 32bpp BGRA pixels on the CPU.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stdint.h>
+
+namespace BlendKernels {
+  /// <summary>
+  /// The instruction sets the kernels are implemented with. Every implementation gives exactly
+  /// the same results.
+  /// </summary>
+  enum class InstructionSet {
+    Scalar,
+    SSE2,
+    AVX2
+  };
+
+  /// <summary>
+  /// Interpolates between two rows of pixels. Weights are in the range [0, 256], where 0 gives a
+  /// and 256 gives b.
+  /// </summary>
+  void Lerp(const uint8_t *a, const uint8_t *b, uint8_t *out, uint32_t pixels, uint32_t weight);
+
+  /// <summary>
+  /// Copies a row of pixels.
+  /// </summary>
+  void Copy(const uint8_t *in, uint8_t *out, uint32_t pixels);
+
+  /// <summary>
+  /// Returns the instruction set the kernels are currently using.
+  /// </summary>
+  InstructionSet GetInstructionSet();
+
+  /// <summary>
+  /// Forces the kernels to use the given instruction set, or the best one the CPU supports if it
+  /// doesn't support the given one. Meant for comparing the implementations.
+  /// </summary>
+  void SetInstructionSet(InstructionSet instructionSet);
+}
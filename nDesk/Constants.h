@@ -8,3 +8,9 @@
 #pragma once
 
 #define WM_UPDATE_DONE 1
+
+// Posted to the desktop window when a wallpaper has been decoded
+#define NDESK_WALLPAPER_LOADED (WM_APP + 1)
+
+// Posted to the desktop window when the animation has decoded a frame it was waiting for
+#define NDESK_ANIMATION_READY (WM_APP + 2)
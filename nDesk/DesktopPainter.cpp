@@ -9,13 +9,14 @@
 #include <math.h>
 #include "shlwapi.h"
 #include "DesktopPainter.hpp"
+#include "AnimationSource.hpp"
 #include "../nShared/MonitorInfo.hpp"
-#include "../nShared/Factories.h"
+#include <ShellScalingApi.h>
 #include "../Utilities/CommonD2D.h"
 #include "../Utilities/StopWatch.hpp"
 #include "../nCoreCom/Core.h"
 #include "ClickHandler.hpp"
-#include <wincodec.h>
+#include "Constants.h"
 #include <assert.h>
 #include <algorithm>
 
@@ -26,15 +27,34 @@ using namespace D2D1;
 /// <summary>
 /// Creates a new instance of the DesktopPainter class.
 /// </summary>
-DesktopPainter::DesktopPainter(HWND hWnd) : Window(hWnd, L"nDesk", g_pClickHandler) {
+DesktopPainter::DesktopPainter(HWND hWnd)
+  : Window(hWnd, L"nDesk", g_pClickHandler)
+  , mTransitionListener(this)
+  , mAnimationListener(this)
+  , mWallpaperLoader(&mWallpaperDecoder, [hWnd] () {
+      PostMessage(hWnd, NDESK_WALLPAPER_LOADED, 0, 0);
+    })
+{
   // Initalize
   m_pWallpaperBrush = nullptr;
   m_pOldWallpaperBrush = nullptr;
+  mBackground = nullptr;
+  mAnimationTarget = nullptr;
+  mAnimationFrame = nullptr;
+  mSequenceFrameRate = 24.0;
+  mAnimationBufferSize = 4;
+  mAnimationPaused = false;
   m_TransitionEffect = nullptr;
   m_bInvalidateAllOnUpdate = false;
+  mSkipNextTransition = false;
+  mSoftwareRendering = false;
+  mSoftwareDC = nullptr;
+  mSoftwareBitmap = nullptr;
+  mSoftwarePreviousBitmap = nullptr;
+  ZeroMemory(&mSoftwareSurface, sizeof(mSoftwareSurface));
   mDontRenderWallpaper = LiteStep::GetRCBool(L"nDeskDontRenderWallpaper", TRUE) != FALSE;
   this->transitionStartTime = 0;
-  this->transitionEndTime = 0;
+  this->transitionFrameTime = 0;
   ZeroMemory(&m_TransitionSettings, sizeof(TransitionEffect::TransitionSettings));
 
   //
@@ -71,9 +91,13 @@ DesktopPainter::DesktopPainter(HWND hWnd) : Window(hWnd, L"nDesk", g_pClickHandl
 /// Destroys this instance of the DesktopPainter class.
 /// </summary>
 DesktopPainter::~DesktopPainter() {
+  mWallpaperLoader.Cancel();
+  StopAnimation();
+  nCore::UnscheduleFrame(&mTransitionListener);
   nCore::System::UnRegisterWindow(L"nDesk");
 
   DiscardDeviceResources();
+  DiscardSoftwareResources();
 
   if (m_TransitionEffect) {
     delete m_TransitionEffect;
@@ -84,9 +108,61 @@ DesktopPainter::~DesktopPainter() {
 /// Releases all D2D device depenent resources
 /// </summary>
 void DesktopPainter::DiscardDeviceResources() {
+  // The transition effect holds on to resources of its own.
+  if (m_pOldWallpaperBrush != nullptr) {
+    m_TransitionEffect->End();
+  }
+  SAFERELEASE(mBackground);
+  SAFERELEASE(mAnimationFrame);
+  SAFERELEASE(mAnimationTarget);
   SAFERELEASE(m_pWallpaperBrush);
   SAFERELEASE(m_pOldWallpaperBrush);
   Window::DiscardDeviceResources();
+  mMonitorTargets.Discard();
+}
+
+/// <summary>
+/// Creates a render target for every monitor. The window's own render target is the context the
+/// monitors' targets create their resources with, so that the wallpaper and the child windows can
+/// be drawn to any of them.
+/// </summary>
+HRESULT DesktopPainter::CreateRenderTarget(ID2D1RenderTarget **renderTarget) {
+  const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
+
+  std::vector<MonitorTargets::Monitor> monitors;
+  for (size_t surface = 0; surface < mMonitorLayout.GetSurfaceCount(); ++surface) {
+    MonitorTargets::Monitor monitor;
+    monitor.rect = mMonitorLayout.GetSurface(surface);
+
+    RECT screenRect = {
+      monitor.rect.left + virtualDesktop.rect.left, monitor.rect.top + virtualDesktop.rect.top,
+      monitor.rect.right + virtualDesktop.rect.left, monitor.rect.bottom + virtualDesktop.rect.top
+    };
+    UINT dpiX, dpiY;
+    if (FAILED(GetDpiForMonitor(MonitorFromRect(&screenRect, MONITOR_DEFAULTTONEAREST),
+        MDT_EFFECTIVE_DPI, &dpiX, &dpiY))) {
+      dpiX = dpiY = 96;
+    }
+    monitor.dpiX = (float)dpiX;
+    monitor.dpiY = (float)dpiY;
+    monitors.push_back(monitor);
+  }
+
+  if (SUCCEEDED(mMonitorTargets.Create(m_hWnd, monitors))) {
+    *renderTarget = mMonitorTargets.GetResourceContext();
+    (*renderTarget)->AddRef();
+    return S_OK;
+  }
+
+  // A single target for the whole desktop, which may have been resized since we were initialized.
+  ID2D1HwndRenderTarget *hwndRenderTarget;
+  HRESULT hr = Window::CreateRenderTarget(renderTarget);
+  if (SUCCEEDED(hr) && SUCCEEDED((*renderTarget)->QueryInterface(&hwndRenderTarget))) {
+    hwndRenderTarget->Resize(D2D1::SizeU(virtualDesktop.width, virtualDesktop.height));
+    hwndRenderTarget->Release();
+  }
+
+  return hr;
 }
 
 /// <summary>
@@ -104,7 +180,19 @@ HRESULT DesktopPainter::ReCreateDeviceResources() {
 
   if (!mRenderTarget) {
     Window::ReCreateDeviceResources();
-    UpdateWallpaper(true);
+    if (mRenderTarget) {
+      // The brushes went with the old render target. The image is still around.
+      DiscardSoftwareResources();
+      ShowWallpaper(true);
+    } else if (!mSoftwareRendering) {
+      // No device, e.g. in a remote session or with a broken driver. Paint on the CPU until a
+      // render target can be created.
+      if (CreateSoftwareResources()) {
+        ShowWallpaper(true);
+      } else {
+        hr = E_FAIL;
+      }
+    }
   }
 
   return hr;
@@ -198,6 +286,13 @@ void DesktopPainter::SetSquareSize(int iSquareSize) {
   if (m_TransitionEffect) m_TransitionEffect->Resize();
 }
 
+/// <summary>
+/// Changes the seed for random transitions. 0 uses a different seed for every transition.
+/// </summary>
+void DesktopPainter::SetTransitionSeed(unsigned int seed) {
+  m_TransitionSettings.uSeed = seed;
+}
+
 /// <summary>
 /// Changes m_bInvalidateAllOnUpdate.
 /// </summary>
@@ -205,10 +300,87 @@ void DesktopPainter::SetInvalidateAllOnUpdate(bool bValue) {
   m_bInvalidateAllOnUpdate = bValue;
 }
 
+/// <summary>
+/// Sets the folder of images to play over the wallpaper. An empty folder turns it off.
+/// </summary>
+void DesktopPainter::SetWallpaperSequence(LPCWSTR folder, double frameRate) {
+  std::wstring sequenceFolder(folder != nullptr ? folder : L"");
+  if (sequenceFolder == mSequenceFolder && frameRate == mSequenceFrameRate) {
+    return;
+  }
+  mSequenceFolder = sequenceFolder;
+  mSequenceFrameRate = frameRate;
+
+  // Restart playback from the static wallpaper, which is also what's left if the sequence was
+  // turned off.
+  if (mRenderTarget && m_pWallpaperBrush != nullptr) {
+    StopAnimation();
+    ShowWallpaper(true);
+    StartAnimation();
+  }
+}
+
+/// <summary>
+/// Sets the number of frames to decode ahead of time. Takes effect on the next wallpaper.
+/// </summary>
+void DesktopPainter::SetAnimationBufferSize(int frames) {
+  mAnimationBufferSize = (UINT)std::max(2, frames);
+}
+
+/// <summary>
+/// Pauses or resumes animated wallpapers.
+/// </summary>
+void DesktopPainter::SetAnimationPaused(bool paused) {
+  mAnimationPaused = paused;
+  if (mAnimation) {
+    mAnimation->SetPaused(paused, nCore::GetFrameTime());
+    ScheduleAnimation();
+  }
+}
+
+/// <summary>
+/// Called when a fullscreen window shows up on a monitor.
+/// </summary>
+void DesktopPainter::OnFullscreenActivated(HMONITOR monitor) {
+  if (std::find(mFullscreenMonitors.begin(), mFullscreenMonitors.end(), monitor) == mFullscreenMonitors.end()) {
+    mFullscreenMonitors.push_back(monitor);
+  }
+  SetMonitorCovered(monitor, true);
+}
+
+/// <summary>
+/// Called when a monitor no longer has a fullscreen window.
+/// </summary>
+void DesktopPainter::OnFullscreenDeactivated(HMONITOR monitor) {
+  mFullscreenMonitors.erase(std::remove(mFullscreenMonitors.begin(), mFullscreenMonitors.end(), monitor),
+    mFullscreenMonitors.end());
+  SetMonitorCovered(monitor, false);
+}
+
+/// <summary>
+/// Tells the animation whether a monitor can be seen. Playback pauses while none of them can.
+/// </summary>
+void DesktopPainter::SetMonitorCovered(HMONITOR monitor, bool covered) {
+  if (!mAnimation) {
+    return;
+  }
+
+  const std::vector<MonitorInfo::Monitor> &monitors = nCore::FetchMonitorInfo().GetMonitors();
+  for (size_t i = 0; i < monitors.size(); ++i) {
+    if (MonitorFromRect(&monitors[i].rect, MONITOR_DEFAULTTONULL) == monitor) {
+      mAnimation->SetMonitorCovered(i, covered, nCore::GetFrameTime());
+    }
+  }
+  ScheduleAnimation();
+}
+
 /// <summary>
 /// Should be called when the desktop has been resized.
 /// </summary>
 void DesktopPainter::Resize() {
+  // Any animation was scaled for the old layout
+  StopAnimation();
+
   // Resize the window
   const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
   SetWindowPos(m_hWnd, HWND_BOTTOM, virtualDesktop.rect.left, virtualDesktop.rect.top,
@@ -221,11 +393,20 @@ void DesktopPainter::Resize() {
   }
 
   if (mRenderTarget) {
-    // Resize the render target
-    mRenderTarget->Resize(D2D1::SizeU(virtualDesktop.width, virtualDesktop.height));
-
-    UpdateWallpaper(true);
+    // The monitors' targets are laid out for the old monitors. Recreating them also recreates the
+    // brushes, which shows the old wallpaper in the new layout until the new one has been loaded.
+    DiscardDeviceResources();
+    ReCreateDeviceResources();
+  } else if (mSoftwareRendering) {
+    // Show the old wallpaper in the new layout until the new one has been loaded.
+    DiscardSoftwareResources();
+    if (CreateSoftwareResources()) {
+      ShowWallpaper(true);
+    }
   }
+
+  // The wallpaper has to be scaled for the new layout.
+  UpdateWallpaper(true);
 }
 
 /// <summary>
@@ -238,30 +419,204 @@ void DesktopPainter::CalculateSizeDepdenentStuff() {
   const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
   m_TransitionSettings.WPRect.bottom = (float)virtualDesktop.height;
   m_TransitionSettings.WPRect.right = (float)virtualDesktop.width;
+
+  // Give every monitor a surface of its own, in window coordinates
+  std::vector<MonitorLayout::Rect> monitors;
+  for (const MonitorInfo::Monitor &monitor : nCore::FetchMonitorInfo().GetMonitors()) {
+    MonitorLayout::Rect rect = {
+      monitor.rect.left - virtualDesktop.rect.left, monitor.rect.top - virtualDesktop.rect.top,
+      monitor.rect.right - virtualDesktop.rect.left, monitor.rect.bottom - virtualDesktop.rect.top
+    };
+    monitors.push_back(rect);
+  }
+  mMonitorLayout.SetMonitors(monitors);
 }
 
 /// <summary>
-/// Updates the desktop wallpaper.
+/// Updates the desktop wallpaper. The wallpaper is decoded in the background, and shown once it
+/// is ready. Any update which hasn't been shown yet is cancelled.
 /// </summary>
 /// <param name="bNoTransition">If true, there will be no transition.</param>
 void DesktopPainter::UpdateWallpaper(bool bNoTransition) {
   if (!mDontRenderWallpaper) {
-    // If we are currently doing a transition, end it.
-    if (m_pOldWallpaperBrush != nullptr) {
-      m_TransitionEffect->End();
-      SAFERELEASE(m_pOldWallpaperBrush)
+    WallpaperLoader::Request request;
+    GetWallpaperRequest(&request);
+    mSkipNextTransition = bNoTransition;
+    mWallpaperRequest = request;
+    mWallpaperLoader.Load(request);
+  } else {
+    Redraw();
+  }
+}
+
+/// <summary>
+/// Called when the loader has decoded a wallpaper.
+/// </summary>
+void DesktopPainter::OnWallpaperLoaded() {
+  if (mWallpaperLoader.TakeResult(&mWallpaperImage) && (mRenderTarget || mSoftwareRendering)) {
+    ShowWallpaper(mSkipNextTransition);
+    // Animations are uploaded to the render target frame by frame.
+    if (mRenderTarget) {
+      StartAnimation();
     }
+  }
+}
+
+/// <summary>
+/// Starts playing the wallpaper if it is animated, or the wallpaper sequence if there is one. The
+/// static wallpaper stays up until the first frame is ready.
+/// </summary>
+void DesktopPainter::StartAnimation() {
+  StopAnimation();
+
+  WallpaperLoader::Request request = mWallpaperRequest;
+  if (!mSequenceFolder.empty()) {
+    request.path = mSequenceFolder;
+  } else if (mWallpaperImage.frameCount < 2) {
+    return;
+  }
 
-    m_pOldWallpaperBrush = m_pWallpaperBrush;
-    CreateWallpaperBrush(&m_pWallpaperBrush);
+  HWND window = m_hWnd;
+  mAnimation.reset(new AnimationPlayer(
+    std::unique_ptr<AnimationPlayer::ISource>(new AnimationSource(request, mSequenceFrameRate)),
+    mAnimationBufferSize, [window] () {
+      PostMessage(window, NDESK_ANIMATION_READY, 0, 0);
+    }));
+
+  const double now = nCore::GetFrameTime();
+  const std::vector<MonitorInfo::Monitor> &monitors = nCore::FetchMonitorInfo().GetMonitors();
+  mAnimation->SetMonitorCount(monitors.size());
+  for (size_t i = 0; i < monitors.size(); ++i) {
+    HMONITOR monitor = MonitorFromRect(&monitors[i].rect, MONITOR_DEFAULTTONULL);
+    if (std::find(mFullscreenMonitors.begin(), mFullscreenMonitors.end(), monitor) != mFullscreenMonitors.end()) {
+      mAnimation->SetMonitorCovered(i, true, now);
+    }
+  }
+  mAnimation->SetPaused(mAnimationPaused, now);
+}
 
-    // If we are going to do a transition animation
-    if (!bNoTransition && m_pOldWallpaperBrush != nullptr && m_TransitionType != NONE) {
-      TransitionStart();
-    } else {
-      SAFERELEASE(m_pOldWallpaperBrush)
+/// <summary>
+/// Stops the animation. The last frame stays up until the wallpaper is shown again.
+/// </summary>
+void DesktopPainter::StopAnimation() {
+  nCore::UnscheduleFrame(&mAnimationListener);
+  mAnimation.reset();
+  SAFERELEASE(mAnimationFrame);
+  SAFERELEASE(mAnimationTarget);
+}
+
+/// <summary>
+/// Lets the animation pick up on the next frame, after a frame has been decoded or playback has
+/// been resumed.
+/// </summary>
+void DesktopPainter::ScheduleAnimation() {
+  if (mAnimation) {
+    nCore::ScheduleFrame(&mAnimationListener, GetFrameSurface(), nCore::GetFrameTime());
+  }
+}
+
+/// <summary>
+/// Shows whichever frame is due.
+/// </summary>
+double DesktopPainter::OnAnimationFrame(double time) {
+  if (!mAnimation) {
+    return -1.0;
+  }
+
+  const AnimationPlayer::Frame *frame;
+  double next = mAnimation->Update(time, &frame);
+  if (frame != nullptr) {
+    PresentFrame(*frame);
+  }
+  return next;
+}
+
+/// <summary>
+/// Uploads a frame, lays it out like the wallpaper, and repaints the monitors which can be seen.
+/// </summary>
+void DesktopPainter::PresentFrame(const AnimationPlayer::Frame &frame) {
+  if (!mRenderTarget) {
+    return;
+  }
+
+  // While animating, the background is a render target of its own which every frame is drawn
+  // into. Everything which paints from the wallpaper picks the frames up from there.
+  if (!mAnimationTarget) {
+    ID2D1Bitmap *bitmap;
+    D2D1_SIZE_F size = D2D1::SizeF(m_TransitionSettings.WPRect.right, m_TransitionSettings.WPRect.bottom);
+    D2D1_SIZE_U pixelSize = D2D1::SizeU(UINT32(size.width), UINT32(size.height));
+    if (FAILED(mRenderTarget->CreateCompatibleRenderTarget(size, pixelSize, &mAnimationTarget))) {
+      return;
+    }
+    mAnimationTarget->GetBitmap(&bitmap);
+    if (m_pWallpaperBrush != nullptr) {
+      m_pWallpaperBrush->SetBitmap(bitmap);
+    }
+    SAFERELEASE(mBackground);
+    mBackground = bitmap;
+  }
+
+  if (mAnimationFrame != nullptr) {
+    D2D1_SIZE_U size = mAnimationFrame->GetPixelSize();
+    if (size.width != frame.width || size.height != frame.height) {
+      SAFERELEASE(mAnimationFrame);
+    }
+  }
+  if (mAnimationFrame == nullptr && FAILED(mRenderTarget->CreateBitmap(D2D1::SizeU(frame.width, frame.height),
+      D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED)),
+      &mAnimationFrame))) {
+    return;
+  }
+  mAnimationFrame->CopyFromMemory(nullptr, frame.pixels.data(), frame.width * 4);
+
+  mAnimationTarget->BeginDraw();
+  DrawWallpaperBitmap(mAnimationTarget, mAnimationFrame, mWallpaperRequest.style, mWallpaperRequest.tile);
+  mAnimationTarget->EndDraw();
+
+  // Monitors with fullscreen windows on them don't need to be repainted.
+  const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
+  const std::vector<MonitorInfo::Monitor> &monitors = nCore::FetchMonitorInfo().GetMonitors();
+  for (size_t i = 0; i < monitors.size(); ++i) {
+    if (!mAnimation->IsCovered(i)) {
+      RECT rect = monitors[i].rect;
+      OffsetRect(&rect, -virtualDesktop.rect.left, -virtualDesktop.rect.top);
+      InvalidateRect(m_hWnd, &rect, FALSE);
     }
   }
+  UpdateWindow(m_hWnd);
+}
+
+/// <summary>
+/// Switches to the decoded wallpaper.
+/// </summary>
+/// <param name="bNoTransition">If true, there will be no transition.</param>
+void DesktopPainter::ShowWallpaper(bool bNoTransition) {
+  if (mSoftwareRendering) {
+    ShowSoftwareWallpaper(bNoTransition);
+    return;
+  }
+
+  // If we are currently doing a transition, end it.
+  if (m_pOldWallpaperBrush != nullptr) {
+    m_TransitionEffect->End();
+    SAFERELEASE(m_pOldWallpaperBrush)
+  }
+
+  m_pOldWallpaperBrush = m_pWallpaperBrush;
+  CreateWallpaperBrush(&m_pWallpaperBrush);
+
+  // The old background is only needed by the transition, which paints from the brushes.
+  SAFERELEASE(mBackground);
+  if (m_pWallpaperBrush != nullptr) {
+    m_pWallpaperBrush->GetBitmap(&mBackground);
+  }
+
+  // If we are going to do a transition animation
+  if (!bNoTransition && m_pOldWallpaperBrush != nullptr && m_TransitionType != NONE) {
+    TransitionStart();
+  } else {
+    SAFERELEASE(m_pOldWallpaperBrush)
+  }
 
   Redraw();
 }
@@ -275,53 +630,419 @@ void DesktopPainter::Redraw() {
 }
 
 /// <summary>
-/// Regular painting
+/// Regular painting. Copies the part of the background under the rect straight from the cached
+/// background layer.
+/// </summary>
+void DesktopPainter::Paint(ID2D1RenderTarget *target, D2D1_RECT_F *rect) {
+  if (mBackground != nullptr) {
+    target->DrawBitmap(mBackground, rect, 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR, rect);
+  }
+}
+
+/// <summary>
+/// Hands the pieces of the update region to the monitor layout, which splits them up by monitor.
+/// When only a few small, scattered things changed, e.g. two icons on different monitors, this
+/// avoids repainting everything in between.
 /// </summary>
-void DesktopPainter::Paint(D2D1_RECT_F *rect) {
-  mRenderTarget->FillRectangle(rect, m_pWallpaperBrush);
+void DesktopPainter::InvalidateRegion(HRGN region, LPCRECT bounds) {
+  std::vector<BYTE> buffer(GetRegionData(region, 0, nullptr));
+  LPRGNDATA data = (LPRGNDATA)buffer.data();
+
+  if (!buffer.empty() && GetRegionData(region, (DWORD)buffer.size(), data) != 0) {
+    LPCRECT parts = (LPCRECT)data->Buffer;
+    for (DWORD i = 0; i < data->rdh.nCount; ++i) {
+      MonitorLayout::Rect rect = { parts[i].left, parts[i].top, parts[i].right, parts[i].bottom };
+      mMonitorLayout.Invalidate(rect);
+    }
+  } else {
+    MonitorLayout::Rect rect = { bounds->left, bounds->top, bounds->right, bounds->bottom };
+    mMonitorLayout.Invalidate(rect);
+  }
 }
 
 /// <summary>
 /// Called prior to the first painting call, to let the transition effect initialize.
 /// </summary>
 void DesktopPainter::TransitionStart() {
-  this->transitionStartTime = GetTickCount();
-  this->transitionEndTime = this->transitionStartTime + this->m_TransitionSettings.iTime;
-  m_TransitionEffect->Start(m_pOldWallpaperBrush, m_pWallpaperBrush);
-
-  while (m_pOldWallpaperBrush != nullptr) {
-    mRenderTarget->BeginDraw();
-    bool inAnimation = true;
-    PaintComposite();
-    PaintChildren(inAnimation, &this->m_TransitionSettings.WPRect);
-    mRenderTarget->EndDraw();
+  this->transitionStartTime = nCore::GetFrameTime();
+  this->transitionFrameTime = this->transitionStartTime;
+  if (!mSoftwareRendering) {
+    m_TransitionEffect->Start(m_pOldWallpaperBrush, m_pWallpaperBrush);
   }
-  Redraw();
+
+  nCore::ScheduleFrame(&mTransitionListener, GetFrameSurface(), this->transitionStartTime);
 }
 
 /// <summary>
 /// Called after the transition is done, to let the transition effect do cleanup.
 /// </summary>
 void DesktopPainter::TransitionEnd() {
+  nCore::UnscheduleFrame(&mTransitionListener);
+  if (mSoftwareRendering) {
+    mSoftwareOldBackground.clear();
+    return;
+  }
   m_TransitionEffect->End();
   SAFERELEASE(m_pOldWallpaperBrush)
+}
+
+/// <summary>
+/// Whether there is a transition running, in either renderer.
+/// </summary>
+bool DesktopPainter::IsTransitioning() const {
+  return m_pOldWallpaperBrush != nullptr || !mSoftwareOldBackground.empty();
+}
+
+/// <summary>
+/// How far along the running transition is, in the range [0, 1].
+/// </summary>
+float DesktopPainter::GetTransitionProgress() const {
+  float progress = this->m_TransitionSettings.iTime > 0
+    ? float(this->transitionFrameTime - this->transitionStartTime) * 1000.0f / this->m_TransitionSettings.iTime
+    : 1.0f;
+  return std::min(1.0f, progress);
+}
+
+/// <summary>
+/// Creates a listener which drives the transitions of the given painter.
+/// </summary>
+DesktopPainter::TransitionListener::TransitionListener(DesktopPainter *painter)
+  : mPainter(painter)
+{
+}
+
+/// <summary>
+/// Paints the next frame of the running transition.
+/// </summary>
+double DesktopPainter::TransitionListener::OnFrame(double time) {
+  mPainter->transitionFrameTime = time;
+  mPainter->Redraw();
+  return mPainter->IsTransitioning() ? time : -1.0;
+}
 
-    // Repaint, just for good measure
-    Paint(&m_TransitionSettings.WPRect);
+/// <summary>
+/// Creates a listener which plays the animated wallpaper of the given painter.
+/// </summary>
+DesktopPainter::AnimationListener::AnimationListener(DesktopPainter *painter)
+  : mPainter(painter)
+{
+}
+
+/// <summary>
+/// Shows the next frame of the animation, if it is due.
+/// </summary>
+double DesktopPainter::AnimationListener::OnFrame(double time) {
+  return mPainter->OnAnimationFrame(time);
 }
 
 /// <summary>
 /// Paints a composite of the previous wallpaper and the current one.
 /// </summary>
-void DesktopPainter::PaintComposite() {
-  float progress = std::min(1.0f, float(GetTickCount() - this->transitionStartTime) / (this->m_TransitionSettings.iTime));
+void DesktopPainter::PaintComposite(ID2D1RenderTarget *target, D2D1_RECT_F *rect) {
+  float progress = GetTransitionProgress();
 
-  m_TransitionEffect->Paint(mRenderTarget, progress);
+  m_TransitionEffect->Paint(target, progress);
 
-  // We are done with the transition, let go of the old wallpaper
+  // We are done with the transition, let go of the old wallpaper. Repaint, just for good measure.
   if (progress >= 1.0f) {
     TransitionEnd();
+    Paint(target, rect);
+  }
+}
+
+/// <summary>
+/// Paints every monitor which has been damaged into its own render target, and presents it.
+/// </summary>
+void DesktopPainter::PaintMonitors() {
+  for (size_t surface = 0; surface < mMonitorLayout.GetSurfaceCount(); ++surface) {
+    std::vector<MonitorLayout::Rect> dirtyRects;
+    mMonitorLayout.TakeDirty(surface, dirtyRects);
+    if (dirtyRects.empty()) {
+      continue;
+    }
+
+    ID2D1DeviceContext *target = mMonitorTargets.BeginDraw(surface, dirtyRects);
+
+    for (const MonitorLayout::Rect &dirty : dirtyRects) {
+      D2D1_RECT_F dirtyRect = D2D1::RectF((FLOAT)dirty.left, (FLOAT)dirty.top, (FLOAT)dirty.right,
+        (FLOAT)dirty.bottom);
+      target->PushAxisAlignedClip(dirtyRect, D2D1_ANTIALIAS_MODE_ALIASED);
+
+      if (this->m_pOldWallpaperBrush != nullptr) {
+        PaintComposite(target, &dirtyRect);
+      } else {
+        Paint(target, &dirtyRect);
+      }
+
+      PaintChildren(&dirtyRect, target);
+
+      target->PopAxisAlignedClip();
+    }
+
+    // If presenting fails we need to recreate all device-dependent resources
+    if (FAILED(mMonitorTargets.EndDraw(surface))) {
+      DiscardDeviceResources();
+      break;
+    }
+  }
+}
+
+/// <summary>
+/// Sets up the DIB section which the software renderer paints into.
+/// </summary>
+bool DesktopPainter::CreateSoftwareResources() {
+  const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
+
+  BITMAPINFO info;
+  ZeroMemory(&info, sizeof(info));
+  info.bmiHeader.biSize = sizeof(info.bmiHeader);
+  info.bmiHeader.biWidth = virtualDesktop.width;
+  // Top-down, like the compositor's surfaces.
+  info.bmiHeader.biHeight = -virtualDesktop.height;
+  info.bmiHeader.biPlanes = 1;
+  info.bmiHeader.biBitCount = 32;
+  info.bmiHeader.biCompression = BI_RGB;
+
+  LPVOID bits = nullptr;
+  mSoftwareDC = CreateCompatibleDC(nullptr);
+  mSoftwareBitmap = CreateDIBSection(nullptr, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+  if (mSoftwareDC == nullptr || mSoftwareBitmap == nullptr) {
+    DiscardSoftwareResources();
+    return false;
+  }
+  mSoftwarePreviousBitmap = SelectObject(mSoftwareDC, mSoftwareBitmap);
+
+  mSoftwareSurface.pixels = (uint8_t*)bits;
+  mSoftwareSurface.width = virtualDesktop.width;
+  mSoftwareSurface.height = virtualDesktop.height;
+  mSoftwareSurface.stride = virtualDesktop.width * 4;
+  mSoftwareRendering = true;
+
+  return true;
+}
+
+/// <summary>
+/// Releases everything the software renderer uses, and goes back to Direct2D.
+/// </summary>
+void DesktopPainter::DiscardSoftwareResources() {
+  if (mSoftwareDC != nullptr) {
+    if (mSoftwarePreviousBitmap != nullptr) {
+      SelectObject(mSoftwareDC, mSoftwarePreviousBitmap);
+      mSoftwarePreviousBitmap = nullptr;
+    }
+    DeleteDC(mSoftwareDC);
+    mSoftwareDC = nullptr;
+  }
+  if (mSoftwareBitmap != nullptr) {
+    DeleteObject(mSoftwareBitmap);
+    mSoftwareBitmap = nullptr;
+  }
+  ZeroMemory(&mSoftwareSurface, sizeof(mSoftwareSurface));
+
+  mSoftwareBackground.clear();
+  mSoftwareOldBackground.clear();
+  mSoftwareRendering = false;
+}
+
+/// <summary>
+/// Switches to the decoded wallpaper, when rendering in software.
+/// </summary>
+void DesktopPainter::ShowSoftwareWallpaper(bool bNoTransition) {
+  // Whatever was on the screen is what the transition starts from.
+  mSoftwareOldBackground.swap(mSoftwareBackground);
+  ComposeSoftwareBackground(mSoftwareBackground);
+
+  if (!bNoTransition && m_TransitionType != NONE
+      && mSoftwareOldBackground.size() == mSoftwareBackground.size()) {
+    mSoftwareCompositor.SetTransition(SoftwareTransitionFromType(m_TransitionType));
+    TransitionStart();
+  } else {
+    nCore::UnscheduleFrame(&mTransitionListener);
+    mSoftwareOldBackground.clear();
+  }
+
+  Redraw();
+}
+
+/// <summary>
+/// Fills the pixels with the desktop color, and lays the scaled wallpaper out over the monitors,
+/// the same way DrawWallpaperBitmap does.
+/// </summary>
+void DesktopPainter::ComposeSoftwareBackground(std::vector<uint8_t> &pixels) {
+  const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
+  pixels.resize(size_t(virtualDesktop.width) * virtualDesktop.height * 4);
+
+  SoftwareCompositor::Surface target = { pixels.data(), (uint32_t)virtualDesktop.width,
+    (uint32_t)virtualDesktop.height, (uint32_t)virtualDesktop.width * 4 };
+  const SoftwareCompositor::Rect everything = { 0, 0, virtualDesktop.width, virtualDesktop.height };
+
+  DWORD desktopColor = GetSysColor(COLOR_DESKTOP);
+  SoftwareCompositor::Fill(target, everything, 0xFF000000 | GetRValue(desktopColor) << 16
+    | GetGValue(desktopColor) << 8 | GetBValue(desktopColor));
+
+  const WallpaperLoader::Image &image = mWallpaperImage;
+  if (image.width == 0) {
+    return;
+  }
+
+  // Blit only reads from the source.
+  const SoftwareCompositor::Surface source = { const_cast<uint8_t*>(image.pixels.data()),
+    image.width, image.height, image.width * 4 };
+  const int WallpaperResX = (int)image.width, WallpaperResY = (int)image.height;
+
+  if (image.tile) {
+    int xInitial = -virtualDesktop.rect.left + (int)floor((float)virtualDesktop.rect.left / WallpaperResX)*WallpaperResX;
+    int yInitial = -virtualDesktop.rect.top + (int)floor((float)virtualDesktop.rect.top / WallpaperResY)*WallpaperResY;
+    for (int x = xInitial; x < virtualDesktop.width - virtualDesktop.rect.left; x += WallpaperResX) {
+      for (int y = yInitial; y < virtualDesktop.height - virtualDesktop.rect.top; y += WallpaperResY) {
+        SoftwareCompositor::Blit(source, target, x, y, everything);
+      }
+    }
+  } else if (image.style == 22) {
+    // Center the stretched wallpaper on the virtual desktop
+    if (WallpaperResY == virtualDesktop.height) {
+      SoftwareCompositor::Blit(source, target, (virtualDesktop.width - WallpaperResX) / 2, 0, everything);
+    } else {
+      SoftwareCompositor::Blit(source, target, 0, (virtualDesktop.height - WallpaperResY) / 2, everything);
+    }
+  } else for (const MonitorInfo::Monitor &monitor : nCore::FetchMonitorInfo().GetMonitors()) {
+    // Center the wallpaper on each monitor, cropped to it
+    const int left = monitor.rect.left - virtualDesktop.rect.left;
+    const int top = monitor.rect.top - virtualDesktop.rect.top;
+    const SoftwareCompositor::Rect clip = { left, top, left + monitor.width, top + monitor.height };
+    SoftwareCompositor::Blit(source, target, left + (monitor.width - WallpaperResX) / 2,
+      top + (monitor.height - WallpaperResY) / 2, clip);
+  }
+}
+
+/// <summary>
+/// Paints the dirty parts of the desktop with the software compositor, and copies them to the
+/// window.
+/// </summary>
+void DesktopPainter::PaintSoftware(const std::vector<MonitorLayout::Rect> &dirtyRects) {
+  if (mSoftwareBackground.size() != size_t(mSoftwareSurface.stride) * mSoftwareSurface.height) {
+    return;
+  }
+
+  SoftwareCompositor::Surface background = mSoftwareSurface;
+  background.pixels = mSoftwareBackground.data();
+
+  if (!mSoftwareOldBackground.empty()) {
+    // Transitions repaint the whole desktop on every frame anyway.
+    SoftwareCompositor::Surface oldBackground = mSoftwareSurface;
+    oldBackground.pixels = mSoftwareOldBackground.data();
+    float progress = GetTransitionProgress();
+    mSoftwareCompositor.Paint(oldBackground, background, mSoftwareSurface, progress);
+    if (progress >= 1.0f) {
+      TransitionEnd();
+    }
+  } else {
+    for (const MonitorLayout::Rect &dirty : dirtyRects) {
+      const SoftwareCompositor::Rect clip = {
+        (int32_t)dirty.left, (int32_t)dirty.top, (int32_t)dirty.right, (int32_t)dirty.bottom
+      };
+      SoftwareCompositor::Blit(background, mSoftwareSurface, 0, 0, clip);
+    }
   }
+
+  // Make sure the pixels have landed before GDI reads them.
+  GdiFlush();
+  HDC dc = GetDC(m_hWnd);
+  for (const MonitorLayout::Rect &dirty : dirtyRects) {
+    BitBlt(dc, dirty.left, dirty.top, dirty.right - dirty.left, dirty.bottom - dirty.top,
+      mSoftwareDC, dirty.left, dirty.top, SRCCOPY);
+  }
+  ReleaseDC(m_hWnd, dc);
+}
+
+/// <summary>
+/// Describes the transition type to the software compositor.
+/// </summary>
+SoftwareCompositor::Transition DesktopPainter::SoftwareTransitionFromType(TransitionType transitionType) {
+  typedef SoftwareCompositor::Direction Direction;
+  typedef SoftwareCompositor::SlideType SlideType;
+
+  SoftwareCompositor::Transition transition;
+  transition.squareSize = (uint32_t)std::max(1, m_TransitionSettings.iSquareSize);
+  transition.fadeTime = m_TransitionSettings.fFadeTime;
+  transition.seed = m_TransitionSettings.uSeed != 0 ? m_TransitionSettings.uSeed : GetTickCount();
+
+  switch (transitionType) {
+  case SLIDE_BOTH_LEFT: case SLIDE_IN_LEFT: case SLIDE_OUT_LEFT: case SCAN_LEFT:
+    transition.direction = Direction::Left;
+    break;
+  case SLIDE_BOTH_RIGHT: case SLIDE_IN_RIGHT: case SLIDE_OUT_RIGHT: case SCAN_RIGHT:
+    transition.direction = Direction::Right;
+    break;
+  case SLIDE_BOTH_UP: case SLIDE_IN_UP: case SLIDE_OUT_UP: case SCAN_UP:
+    transition.direction = Direction::Up;
+    break;
+  case SLIDE_BOTH_DOWN: case SLIDE_IN_DOWN: case SLIDE_OUT_DOWN: case SCAN_DOWN:
+    transition.direction = Direction::Down;
+    break;
+  default:
+    break;
+  }
+
+  switch (transitionType) {
+  case SLIDE_BOTH_LEFT: case SLIDE_BOTH_RIGHT: case SLIDE_BOTH_UP: case SLIDE_BOTH_DOWN:
+    transition.effect = SoftwareCompositor::Effect::Slide;
+    transition.slideType = SlideType::Both;
+    break;
+  case SLIDE_IN_LEFT: case SLIDE_IN_RIGHT: case SLIDE_IN_UP: case SLIDE_IN_DOWN:
+    transition.effect = SoftwareCompositor::Effect::Slide;
+    transition.slideType = SlideType::New;
+    break;
+  case SLIDE_OUT_LEFT: case SLIDE_OUT_RIGHT: case SLIDE_OUT_UP: case SLIDE_OUT_DOWN:
+    transition.effect = SoftwareCompositor::Effect::Slide;
+    transition.slideType = SlideType::Old;
+    break;
+  case SCAN_LEFT: case SCAN_RIGHT: case SCAN_UP: case SCAN_DOWN:
+    transition.effect = SoftwareCompositor::Effect::Slide;
+    transition.slideType = SlideType::Scan;
+    break;
+
+  case SQUARES_RANDOM_IN: case SQUARES_RANDOM_OUT:
+    transition.effect = SoftwareCompositor::Effect::Grid;
+    transition.gridType = GridSchedule::RANDOM;
+    break;
+  case SQUARES_LINEAR_VERTICAL_IN: case SQUARES_LINEAR_VERTICAL_OUT:
+    transition.effect = SoftwareCompositor::Effect::Grid;
+    transition.gridType = GridSchedule::LINEAR_VERTICAL;
+    break;
+  case SQUARES_LINEAR_HORIZONTAL_IN: case SQUARES_LINEAR_HORIZONTAL_OUT:
+    transition.effect = SoftwareCompositor::Effect::Grid;
+    transition.gridType = GridSchedule::LINEAR_HORIZONTAL;
+    break;
+  case SQUARES_TRIANGULAR_BOTTOM_RIGHT_IN: case SQUARES_TRIANGULAR_BOTTOM_RIGHT_OUT:
+    transition.effect = SoftwareCompositor::Effect::Grid;
+    transition.gridType = GridSchedule::TRIANGULAR;
+    break;
+  case SQUARES_CLOCKWISE_IN: case SQUARES_CLOCKWISE_OUT:
+    transition.effect = SoftwareCompositor::Effect::Grid;
+    transition.gridType = GridSchedule::CLOCKWISE;
+    break;
+  case SQUARES_COUNTERCLOCKWISE_IN: case SQUARES_COUNTERCLOCKWISE_OUT:
+    transition.effect = SoftwareCompositor::Effect::Grid;
+    transition.gridType = GridSchedule::COUNTERCLOCKWISE;
+    break;
+
+  default:
+    // Fading in and fading out look the same with opaque wallpapers.
+    transition.effect = SoftwareCompositor::Effect::Fade;
+    break;
+  }
+
+  switch (transitionType) {
+  case SQUARES_RANDOM_OUT: case SQUARES_LINEAR_VERTICAL_OUT: case SQUARES_LINEAR_HORIZONTAL_OUT:
+  case SQUARES_TRIANGULAR_BOTTOM_RIGHT_OUT: case SQUARES_CLOCKWISE_OUT: case SQUARES_COUNTERCLOCKWISE_OUT:
+    transition.hideOld = true;
+    break;
+  default:
+    break;
+  }
+
+  return transition;
 }
 
 /// <summary>
@@ -337,52 +1058,63 @@ LRESULT DesktopPainter::HandleMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARA
       if (!mDontRenderWallpaper) {
         UpdateLock lock(this);
 
-        bool inAnimation = false;
-
         RECT updateRect;
 
         if (GetUpdateRect(hWnd, &updateRect, FALSE) != FALSE) {
+          HRGN updateRegion = CreateRectRgn(0, 0, 0, 0);
+          GetUpdateRgn(hWnd, updateRegion, FALSE);
           ValidateRect(hWnd, NULL);
 
           if (SUCCEEDED(ReCreateDeviceResources())) {
-            mRenderTarget->BeginDraw();
-
-            D2D1_RECT_F d2dUpdateRect = D2D1::RectF(
-              (FLOAT)updateRect.left, (FLOAT)updateRect.top, (FLOAT)updateRect.right, (FLOAT)updateRect.bottom);
-
-            mRenderTarget->PushAxisAlignedClip(d2dUpdateRect, D2D1_ANTIALIAS_MODE_ALIASED);
+            InvalidateRegion(updateRegion, &updateRect);
 
-            // m_pOldWallpaperBrush being non zero indicates that we are in the middle of a transition
-            if (this->m_pOldWallpaperBrush != nullptr) {
-              PaintComposite();
+            if (mMonitorTargets.IsCreated()) {
+              PaintMonitors();
             } else {
-              Paint(&d2dUpdateRect);
-            }
-
-            PaintChildren(inAnimation, &d2dUpdateRect);
-
-            mRenderTarget->PopAxisAlignedClip();
-
-            // Paint actual owned/child windows.
-            //EnumChildWindows(hWnd, [] (HWND hwnd, LPARAM) -> BOOL
-            //{
-            //    SendMessage(hwnd, WM_PAINT, 0, 0);
-            //    return TRUE;
-            //}, 0);
-
-            // If EndDraw fails we need to recreate all device-dependent resources
-            if (mRenderTarget->EndDraw() == D2DERR_RECREATE_TARGET) {
-              DiscardDeviceResources();
+              // Every monitor gets painted separately, and only where it has been damaged.
+              std::vector<MonitorLayout::Rect> dirtyRects;
+              for (size_t surface = 0; surface < mMonitorLayout.GetSurfaceCount(); ++surface) {
+                mMonitorLayout.TakeDirty(surface, dirtyRects);
+              }
+
+              if (mSoftwareRendering) {
+                PaintSoftware(dirtyRects);
+              } else {
+                mRenderTarget->BeginDraw();
+
+                for (const MonitorLayout::Rect &dirty : dirtyRects) {
+                  D2D1_RECT_F dirtyRect = D2D1::RectF((FLOAT)dirty.left, (FLOAT)dirty.top, (FLOAT)dirty.right, (FLOAT)dirty.bottom);
+                  mRenderTarget->PushAxisAlignedClip(dirtyRect, D2D1_ANTIALIAS_MODE_ALIASED);
+
+                  // m_pOldWallpaperBrush being non zero indicates that we are in the middle of a transition
+                  if (this->m_pOldWallpaperBrush != nullptr) {
+                    PaintComposite(mRenderTarget, &dirtyRect);
+                  } else {
+                    Paint(mRenderTarget, &dirtyRect);
+                  }
+
+                  PaintChildren(&dirtyRect);
+
+                  mRenderTarget->PopAxisAlignedClip();
+                }
+
+                // Paint actual owned/child windows.
+                //EnumChildWindows(hWnd, [] (HWND hwnd, LPARAM) -> BOOL
+                //{
+                //    SendMessage(hwnd, WM_PAINT, 0, 0);
+                //    return TRUE;
+                //}, 0);
+
+                // If EndDraw fails we need to recreate all device-dependent resources
+                if (mRenderTarget->EndDraw() == D2DERR_RECREATE_TARGET) {
+                  DiscardDeviceResources();
+                }
+              }
             }
           }
 
+          DeleteObject(updateRegion);
           mNeedsUpdate = false;
-
-          if (this->m_pOldWallpaperBrush != NULL) {
-            Redraw();
-          } else if (inAnimation) {
-            PostMessage(hWnd, WM_ANIMATIONPAINT, 0, 0);
-          }
         }
       } else {
         ValidateRect(hWnd, NULL);
@@ -394,234 +1126,172 @@ LRESULT DesktopPainter::HandleMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARA
     {
     }
     return 0;
+
+  case NDESK_WALLPAPER_LOADED:
+    OnWallpaperLoaded();
+    return 0;
+
+  case NDESK_ANIMATION_READY:
+    ScheduleAnimation();
+    return 0;
   }
   return Window::HandleMessage(hWnd, uMsg, wParam, lParam, NULL);
 }
 
 /// <summary>
-/// Creates a brush of the current wallpaper.
+/// Reads the wallpaper settings, for the loader.
 /// </summary>
-HRESULT DesktopPainter::CreateWallpaperBrush(ID2D1BitmapBrush** ppBitmapBrush) {
-  //
-  HRESULT hr = S_OK;
-
+void DesktopPainter::GetWallpaperRequest(WallpaperLoader::Request *request) {
   // Information about the wallpaper
-  WCHAR wszWallpaperPath[MAX_PATH];
-  int iWallpaperStyle;
-  bool bTileWallpaper;
+  WCHAR wszWallpaperPath[MAX_PATH] = L"";
 
   // Temporary values
   WCHAR szTemp[32];
   DWORD dwSize, dwType;
 
-  // D2D/WIC interfaces
-  ID2D1Bitmap *pBitmap = nullptr;
-  ID2D1BitmapRenderTarget* pBitmapRender = nullptr;
-  IWICImagingFactory *pWICFactory = nullptr;
-  IWICBitmapDecoder *pDecoder = nullptr;
-  IWICBitmapFrameDecode *pSource = nullptr;
-  IWICFormatConverter *pConverter = nullptr;
-  IWICBitmapScaler *pScaler = nullptr;
-
   // Get the path to the wallpaper
   dwSize = sizeof(wszWallpaperPath); dwType = REG_SZ;
   SHGetValueW(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"Wallpaper", &dwType, &wszWallpaperPath, &dwSize);
+  request->path = wszWallpaperPath;
 
   // Get whether or not to tile the wallpaper
   dwSize = sizeof(szTemp);
   SHGetValue(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"TileWallpaper", &dwType, &szTemp, &dwSize);
-  bTileWallpaper = _wtoi(szTemp) ? true : false;
+  request->tile = _wtoi(szTemp) ? true : false;
 
   // Get whether or not to stretch the wallpaper
   dwSize = sizeof(szTemp);
   SHGetValue(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"WallpaperStyle", &dwType, &szTemp, &dwSize);
-  iWallpaperStyle = _wtoi(szTemp);
-
-  // Create a bitmap the size of the virtual screen
-  mRenderTarget->CreateCompatibleRenderTarget(&pBitmapRender);
+  request->style = _wtoi(szTemp);
 
-  // Start rendering the wallpaper
-  pBitmapRender->BeginDraw();
-
-  // Fill the bitmap with the background color
-  DWORD DesktopColor = GetSysColor(COLOR_DESKTOP);
-  pBitmapRender->Clear(D2D1::ColorF(RGB(GetBValue(DesktopColor), GetGValue(DesktopColor), GetRValue(DesktopColor))));
-
-  // Load the desktop background
-  Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&pWICFactory));
-  if (SUCCEEDED(hr = pWICFactory->CreateDecoderFromFilename(wszWallpaperPath, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &pDecoder))) {
-    // Get the first frame of the wallpaper
-    pDecoder->GetFrame(0, &pSource);
-
-    // Get the size of the wallpaper
-    UINT cxWallpaper, cyWallpaper;
-    pSource->GetSize(&cxWallpaper, &cyWallpaper);
-
-    const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
-    const MonitorInfo::Monitor &primaryMonitor = nCore::FetchMonitorInfo().GetMonitor(0);
-
-    if (bTileWallpaper) {
-      // Convert it to a D2D1 bitmap
-      pWICFactory->CreateFormatConverter(&pConverter);
-      pConverter->Initialize(pSource, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
-      mRenderTarget->CreateBitmapFromWicBitmap(pConverter, 0, &pBitmap);
-
-      // The x/y points where we should start tiling the image
-      int xInitial = -virtualDesktop.rect.left + (int)floor((float)virtualDesktop.rect.left / cxWallpaper)*cxWallpaper;
-      int yInitial = -virtualDesktop.rect.top + (int)floor((float)virtualDesktop.rect.top / cyWallpaper)*cyWallpaper;
-      // Do the tiling
-      for (int x = xInitial; x < virtualDesktop.width - virtualDesktop.rect.left; x += cxWallpaper) {
-        for (int y = yInitial; y < virtualDesktop.height - virtualDesktop.rect.top; y += cyWallpaper) {
-          D2D1_RECT_F f; f.top = (float)y; f.left = (float)x; f.right = (float)(x + cxWallpaper); f.bottom = (float)(y + cyWallpaper);
-          pBitmapRender->DrawBitmap(pBitmap, f);
-        }
-      }
-    } else // Some type of stretching
-    {
-      // Work out the dimensions the wallpaper should be stretched to
-      int WallpaperResX, WallpaperResY;
-      double scaleX, scaleY;
-      switch (iWallpaperStyle) {
-      case 2: // Stretch
-        {
-          WallpaperResX = primaryMonitor.width;
-          WallpaperResY = primaryMonitor.height;
-        }
-        break;
-
-      case 6: // Fit
-        {
-          scaleX = (double)primaryMonitor.width / cxWallpaper;
-          scaleY = (double)primaryMonitor.height / cyWallpaper;
-          if (scaleX > scaleY) {
-            WallpaperResY = primaryMonitor.height;
-            WallpaperResX = (int)(scaleY*cxWallpaper);
-          } else {
-            WallpaperResY = (int)(scaleX*cyWallpaper);
-            WallpaperResX = primaryMonitor.width;
-          }
-        }
-        break;
-
-      case 10: // Fill
-        {
-          scaleX = (double)primaryMonitor.width / cxWallpaper;
-          scaleY = (double)primaryMonitor.height / cyWallpaper;
-          if (scaleX < scaleY) {
-            WallpaperResY = primaryMonitor.height;
-            WallpaperResX = (int)(scaleY*cxWallpaper);
-          } else {
-            WallpaperResY = (int)(scaleX*cyWallpaper);
-            WallpaperResX = primaryMonitor.width;
-          }
-        }
-        break;
-
-      case 22: // Span, essentially a fill over the virtual desktop
-        {
-          scaleX = (double)virtualDesktop.width / cxWallpaper;
-          scaleY = (double)virtualDesktop.height / cyWallpaper;
-          if (scaleX < scaleY) {
-            WallpaperResY = virtualDesktop.height;
-            WallpaperResX = (int)(scaleY*cxWallpaper);
-          } else {
-            WallpaperResY = (int)(scaleX*cyWallpaper);
-            WallpaperResX = virtualDesktop.width;
-          }
-        }
-        break;
+  const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
+  const MonitorInfo::Monitor &primaryMonitor = nCore::FetchMonitorInfo().GetMonitor(0);
+  request->monitorWidth = primaryMonitor.width;
+  request->monitorHeight = primaryMonitor.height;
+  request->desktopWidth = virtualDesktop.width;
+  request->desktopHeight = virtualDesktop.height;
+}
 
-      default: // Center (actually 0), but this way we can fail graciously if the value is invalid
-        {
-          WallpaperResX = cxWallpaper;
-          WallpaperResY = cyWallpaper;
-        }
-        break;
-      }
+/// <summary>
+/// Creates a brush of the current wallpaper, from the last image the loader decoded.
+/// </summary>
+HRESULT DesktopPainter::CreateWallpaperBrush(ID2D1BitmapBrush** ppBitmapBrush) {
+  const WallpaperLoader::Image &image = mWallpaperImage;
 
-      // Stretch the wallpaper as necesary
-      pWICFactory->CreateBitmapScaler(&pScaler);
-      pScaler->Initialize(pSource, (UINT)WallpaperResX, (UINT)WallpaperResY, WICBitmapInterpolationModeCubic);
-
-      // Convert it to a D2D1 bitmap
-      pWICFactory->CreateFormatConverter(&pConverter);
-      pConverter->Initialize(pScaler, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
-      mRenderTarget->CreateBitmapFromWicBitmap(pConverter, 0, &pBitmap);
-
-      if (iWallpaperStyle == 22) {
-        // Center the stretched wallpaper on the virtual desktop
-        D2D1_RECT_F dest, source;
-        dest.left = 0;
-        dest.top = 0;
-        dest.right = (float)virtualDesktop.width;
-        dest.bottom = (float)virtualDesktop.height;
-        source = dest;
-
-        if (WallpaperResY == virtualDesktop.height) {
-          // Center by width
-          source.left = (WallpaperResX - virtualDesktop.width) / 2.0f;
-          source.right = (float)(source.left + virtualDesktop.width);
-        } else {
-          // Center by height
-          source.top = (WallpaperResY - virtualDesktop.height) / 2.0f;
-          source.bottom = (float)(source.top + virtualDesktop.height);
-        }
+  // D2D interfaces
+  ID2D1Bitmap *pBitmap = nullptr;
+  ID2D1BitmapRenderTarget* pBitmapRender = nullptr;
 
-        pBitmapRender->DrawBitmap(pBitmap, dest, 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_LINEAR, source);
-      } else for (const MonitorInfo::Monitor &monitor : nCore::FetchMonitorInfo().GetMonitors()) {
-        // Center the stretched wallpaper on all monitors
-        D2D1_RECT_F dest, source;
-
-        // Work out X coordinates and width
-        if (monitor.width > WallpaperResX) {
-          dest.left = (monitor.width - WallpaperResX) / 2.0f;
-          dest.right = (float)(dest.left + WallpaperResX);
-          source.left = 0.0f;
-          source.right = (float)WallpaperResX;
-        } else {
-          dest.left = 0.0f;
-          dest.right = (float)monitor.width;
-          source.left = (WallpaperResX - monitor.width) / 2.0f;
-          source.right = (float)(source.left + monitor.width);
-        }
-        dest.left += monitor.rect.left - virtualDesktop.rect.left;
-        dest.right += monitor.rect.left - virtualDesktop.rect.left;
-
-        // Work out Y coordinates and height
-        if (monitor.height > WallpaperResY) {
-          dest.top = (monitor.height - WallpaperResY) / 2.0f;
-          dest.bottom = (float)(dest.top + WallpaperResY);
-          source.top = 0.0f;
-          source.bottom = (float)WallpaperResY;
-        } else {
-          dest.top = 0.0f;
-          dest.bottom = (float)monitor.height;
-          source.top = (WallpaperResY - monitor.height) / 2.0f;
-          source.bottom = (float)(source.top + monitor.height);
-        }
-        dest.top += monitor.rect.top - virtualDesktop.rect.top;
-        dest.bottom += monitor.rect.top - virtualDesktop.rect.top;
+  // Create a bitmap the size of the virtual screen
+  D2D1_SIZE_F size = D2D1::SizeF(m_TransitionSettings.WPRect.right, m_TransitionSettings.WPRect.bottom);
+  mRenderTarget->CreateCompatibleRenderTarget(size, D2D1::SizeU(UINT32(size.width), UINT32(size.height)),
+    &pBitmapRender);
 
-        pBitmapRender->DrawBitmap(pBitmap, dest, 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_LINEAR, source);
-      }
-    }
+  // Start rendering the wallpaper
+  pBitmapRender->BeginDraw();
 
-    SAFERELEASE(pConverter);
-    SAFERELEASE(pDecoder);
-    SAFERELEASE(pBitmap);
-    SAFERELEASE(pSource);
-    SAFERELEASE(pScaler);
+  // Upload the decoded wallpaper. It has already been scaled.
+  if (image.width != 0) {
+    mRenderTarget->CreateBitmap(D2D1::SizeU(image.width, image.height), image.pixels.data(), image.width * 4,
+      D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED)),
+      &pBitmap);
   }
+  DrawWallpaperBitmap(pBitmapRender, pBitmap, image.style, image.tile);
+  SAFERELEASE(pBitmap);
 
   // Finish rendering
   pBitmapRender->EndDraw();
 
   pBitmapRender->GetBitmap(&pBitmap);
   mRenderTarget->CreateBitmapBrush(pBitmap, ppBitmapBrush);
-  //(*ppBitmapBrush)->SetTransform(D2D1::Matrix3x2F::Translation(g_pMonitorInfo->m_virtualDesktop.rect.top, g_pMonitorInfo->m_virtualDesktop.rect.top))
 
   SAFERELEASE(pBitmap);
   SAFERELEASE(pBitmapRender);
 
   return S_OK;
 }
+
+/// <summary>
+/// Fills the target with the desktop color, and lays the scaled wallpaper out over the monitors.
+/// </summary>
+void DesktopPainter::DrawWallpaperBitmap(ID2D1RenderTarget *target, ID2D1Bitmap *bitmap, int style, bool tile) {
+  // Fill the bitmap with the background color
+  DWORD DesktopColor = GetSysColor(COLOR_DESKTOP);
+  target->Clear(D2D1::ColorF(RGB(GetBValue(DesktopColor), GetGValue(DesktopColor), GetRValue(DesktopColor))));
+
+  if (bitmap == nullptr) {
+    return;
+  }
+
+  const D2D1_SIZE_U size = bitmap->GetPixelSize();
+  const MonitorInfo::Monitor &virtualDesktop = nCore::FetchMonitorInfo().GetVirtualDesktop();
+  const int WallpaperResX = (int)size.width, WallpaperResY = (int)size.height;
+
+  if (tile) {
+    // The x/y points where we should start tiling the image
+    int xInitial = -virtualDesktop.rect.left + (int)floor((float)virtualDesktop.rect.left / WallpaperResX)*WallpaperResX;
+    int yInitial = -virtualDesktop.rect.top + (int)floor((float)virtualDesktop.rect.top / WallpaperResY)*WallpaperResY;
+    // Do the tiling
+    for (int x = xInitial; x < virtualDesktop.width - virtualDesktop.rect.left; x += WallpaperResX) {
+      for (int y = yInitial; y < virtualDesktop.height - virtualDesktop.rect.top; y += WallpaperResY) {
+        D2D1_RECT_F f; f.top = (float)y; f.left = (float)x; f.right = (float)(x + WallpaperResX); f.bottom = (float)(y + WallpaperResY);
+        target->DrawBitmap(bitmap, f);
+      }
+    }
+  } else if (style == 22) {
+    // Center the stretched wallpaper on the virtual desktop
+    D2D1_RECT_F dest, source;
+    dest.left = 0;
+    dest.top = 0;
+    dest.right = (float)virtualDesktop.width;
+    dest.bottom = (float)virtualDesktop.height;
+    source = dest;
+
+    if (WallpaperResY == virtualDesktop.height) {
+      // Center by width
+      source.left = (WallpaperResX - virtualDesktop.width) / 2.0f;
+      source.right = (float)(source.left + virtualDesktop.width);
+    } else {
+      // Center by height
+      source.top = (WallpaperResY - virtualDesktop.height) / 2.0f;
+      source.bottom = (float)(source.top + virtualDesktop.height);
+    }
+
+    target->DrawBitmap(bitmap, dest, 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_LINEAR, source);
+  } else for (const MonitorInfo::Monitor &monitor : nCore::FetchMonitorInfo().GetMonitors()) {
+    // Center the stretched wallpaper on all monitors
+    D2D1_RECT_F dest, source;
+
+    // Work out X coordinates and width
+    if (monitor.width > WallpaperResX) {
+      dest.left = (monitor.width - WallpaperResX) / 2.0f;
+      dest.right = (float)(dest.left + WallpaperResX);
+      source.left = 0.0f;
+      source.right = (float)WallpaperResX;
+    } else {
+      dest.left = 0.0f;
+      dest.right = (float)monitor.width;
+      source.left = (WallpaperResX - monitor.width) / 2.0f;
+      source.right = (float)(source.left + monitor.width);
+    }
+    dest.left += monitor.rect.left - virtualDesktop.rect.left;
+    dest.right += monitor.rect.left - virtualDesktop.rect.left;
+
+    // Work out Y coordinates and height
+    if (monitor.height > WallpaperResY) {
+      dest.top = (monitor.height - WallpaperResY) / 2.0f;
+      dest.bottom = (float)(dest.top + WallpaperResY);
+      source.top = 0.0f;
+      source.bottom = (float)WallpaperResY;
+    } else {
+      dest.top = 0.0f;
+      dest.bottom = (float)monitor.height;
+      source.top = (WallpaperResY - monitor.height) / 2.0f;
+      source.bottom = (float)(source.top + monitor.height);
+    }
+    dest.top += monitor.rect.top - virtualDesktop.rect.top;
+    dest.bottom += monitor.rect.top - virtualDesktop.rect.top;
+
+    target->DrawBitmap(bitmap, dest, 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_LINEAR, source);
+  }
+}
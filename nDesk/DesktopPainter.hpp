@@ -8,12 +8,41 @@
 #pragma once
 
 #include "../Utilities/CommonD2D.h"
+#include "AnimationPlayer.hpp"
+#include "MonitorLayout.hpp"
+#include "MonitorTargets.hpp"
+#include "SoftwareCompositor.hpp"
 #include "TransitionEffects.h"
+#include "WallpaperDecoder.hpp"
 #include "../nShared/StateRender.hpp"
 #include "../nShared/Window.hpp"
+#include "../nCore/IFrameListener.hpp"
 
 class DesktopPainter : protected Window
 {
+private:
+    // Repaints the desktop on every frame while a transition is running.
+    class TransitionListener : public IFrameListener
+    {
+    public:
+        explicit TransitionListener(DesktopPainter *painter);
+        double OnFrame(double time) override;
+
+    private:
+        DesktopPainter *mPainter;
+    };
+
+    // Shows the frames of an animated wallpaper as they become due.
+    class AnimationListener : public IFrameListener
+    {
+    public:
+        explicit AnimationListener(DesktopPainter *painter);
+        double OnFrame(double time) override;
+
+    private:
+        DesktopPainter *mPainter;
+    };
+
 public:
     // Available transition types
     enum TransitionType
@@ -61,9 +90,17 @@ public:
     void SetTransitionType(TransitionType);
     void SetTransitionTime(int);
     void SetSquareSize(int);
+    void SetTransitionSeed(unsigned int);
 
     void SetInvalidateAllOnUpdate(bool);
 
+    void SetWallpaperSequence(LPCWSTR folder, double frameRate);
+    void SetAnimationBufferSize(int frames);
+    void SetAnimationPaused(bool paused);
+
+    void OnFullscreenActivated(HMONITOR monitor);
+    void OnFullscreenDeactivated(HMONITOR monitor);
+
     void UpdateWallpaper(bool bNoTransition = false);
     void Resize();
     LRESULT WINAPI HandleMessage(HWND, UINT, WPARAM, LPARAM);
@@ -79,28 +116,62 @@ private:
     void CalculateSizeDepdenentStuff();
     HRESULT ReCreateDeviceResources();
     void DiscardDeviceResources();
+    HRESULT CreateRenderTarget(ID2D1RenderTarget **renderTarget) override;
 
-    void Paint(D2D1_RECT_F*);
-    void PaintComposite();
+    void Paint(ID2D1RenderTarget *target, D2D1_RECT_F *rect);
+    void PaintComposite(ID2D1RenderTarget *target, D2D1_RECT_F *rect);
+    void PaintMonitors();
+    void InvalidateRegion(HRGN region, LPCRECT bounds);
     void Redraw();
 
+    void ShowWallpaper(bool bNoTransition);
+    void OnWallpaperLoaded();
+    void GetWallpaperRequest(WallpaperLoader::Request *request);
+
     void TransitionStart();
     void TransitionEnd();
+    bool IsTransitioning() const;
+    float GetTransitionProgress() const;
     TransitionEffect* TransitionEffectFromType(TransitionType transitionType);
 
+    bool CreateSoftwareResources();
+    void DiscardSoftwareResources();
+    void ShowSoftwareWallpaper(bool bNoTransition);
+    void ComposeSoftwareBackground(std::vector<uint8_t> &pixels);
+    void PaintSoftware(const std::vector<MonitorLayout::Rect> &dirtyRects);
+    SoftwareCompositor::Transition SoftwareTransitionFromType(TransitionType transitionType);
+
+    void StartAnimation();
+    void StopAnimation();
+    void ScheduleAnimation();
+    double OnAnimationFrame(double time);
+    void PresentFrame(const AnimationPlayer::Frame &frame);
+    void SetMonitorCovered(HMONITOR monitor, bool covered);
+
     HRESULT CreateWallpaperBrush(ID2D1BitmapBrush** ppBitmapBrush);
+    void DrawWallpaperBitmap(ID2D1RenderTarget *target, ID2D1Bitmap *bitmap, int style, bool tile);
 
     //
     HWND m_hWnd;
 
+    // The frame time at which the current transition started, and the time of the frame being
+    // painted.
+    double transitionStartTime;
+    double transitionFrameTime;
+
     //
-    DWORD transitionEndTime;
-    DWORD transitionStartTime;
+    TransitionListener mTransitionListener;
+    AnimationListener mAnimationListener;
 
     // Direct2D targets
     ID2D1BitmapBrush* m_pWallpaperBrush;
     ID2D1BitmapBrush* m_pOldWallpaperBrush;
 
+    // The composited background, i.e. the wallpaper laid out over every monitor. Everything which
+    // isn't part of a child window is copied from this, so that nothing has to be composited again
+    // unless the wallpaper or the monitors change.
+    ID2D1Bitmap* mBackground;
+
     StateRender<States> mStateRender;
 
     //
@@ -115,6 +186,63 @@ private:
     // Holds all settings for transitions. Passed in to the transitions on init.
     TransitionEffect::TransitionSettings m_TransitionSettings;
 
+    // The monitors, and what needs to be repainted on each
+    MonitorLayout mMonitorLayout;
+
+    // A render target for each surface of the monitor layout, at the DPI of its monitor. When
+    // these can't be created, e.g. without DirectComposition, everything is painted through a
+    // single render target for the whole window instead.
+    MonitorTargets mMonitorTargets;
+
+    // Set while no render target can be created. The desktop is then composited on the CPU into a
+    // DIB section, and copied to the window from there. Child windows aren't painted.
+    bool mSoftwareRendering;
+    SoftwareCompositor mSoftwareCompositor;
+
+    // The composited background, and the previous one while transitioning, laid out like
+    // mBackground.
+    std::vector<uint8_t> mSoftwareBackground;
+    std::vector<uint8_t> mSoftwareOldBackground;
+
+    // The DIB section which is copied to the window.
+    HDC mSoftwareDC;
+    HBITMAP mSoftwareBitmap;
+    HGDIOBJ mSoftwarePreviousBitmap;
+    SoftwareCompositor::Surface mSoftwareSurface;
+
+    // Decodes wallpapers in the background
+    WallpaperDecoder mWallpaperDecoder;
+    WallpaperLoader mWallpaperLoader;
+
+    // The last wallpaper the loader decoded. Kept to recreate the brush if the device is lost.
+    WallpaperLoader::Image mWallpaperImage;
+
+    // The request for the last wallpaper, which animations are scaled to
+    WallpaperLoader::Request mWallpaperRequest;
+
+    // Whether the wallpaper being loaded should be shown without a transition
+    bool mSkipNextTransition;
+
+    // Plays the wallpaper if it is animated, or the wallpaper sequence. Null for static
+    // wallpapers, which don't need any of this.
+    std::unique_ptr<AnimationPlayer> mAnimation;
+
+    // The background is rendered into this while animating, from the uploaded frame.
+    ID2D1BitmapRenderTarget* mAnimationTarget;
+    ID2D1Bitmap* mAnimationFrame;
+
+    // A folder of images to play over the wallpaper, and its frame rate
+    std::wstring mSequenceFolder;
+    double mSequenceFrameRate;
+
+    // The number of frames to decode ahead of time
+    UINT mAnimationBufferSize;
+
+    bool mAnimationPaused;
+
+    // The monitors which are covered by fullscreen windows
+    std::vector<HMONITOR> mFullscreenMonitors;
+
     // If on, every window will be repainted when the wallpaper is changed instead of just the
     // desktop background. Fixes issues with other modules (xModules).
     bool m_bInvalidateAllOnUpdate;
@@ -0,0 +1,139 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/MonitorLayout.cpp
+// The nModules Project
+//
+// Splits the desktop into one surface per monitor, and tracks what needs repainting on each.
+//-------------------------------------------------------------------------------------------------
+#include "MonitorLayout.hpp"
+
+#include <algorithm>
+
+
+static bool IsEmpty(const MonitorLayout::Rect &rect) {
+  return rect.left >= rect.right || rect.top >= rect.bottom;
+}
+
+
+static bool Contains(const MonitorLayout::Rect &outer, const MonitorLayout::Rect &inner) {
+  return outer.left <= inner.left && outer.top <= inner.top && outer.right >= inner.right
+    && outer.bottom >= inner.bottom;
+}
+
+
+static MonitorLayout::Rect Intersection(const MonitorLayout::Rect &a,
+    const MonitorLayout::Rect &b) {
+  MonitorLayout::Rect rect = {
+    std::max(a.left, b.left), std::max(a.top, b.top),
+    std::min(a.right, b.right), std::min(a.bottom, b.bottom)
+  };
+  return rect;
+}
+
+
+static MonitorLayout::Rect Union(const MonitorLayout::Rect &a, const MonitorLayout::Rect &b) {
+  MonitorLayout::Rect rect = {
+    std::min(a.left, b.left), std::min(a.top, b.top),
+    std::max(a.right, b.right), std::max(a.bottom, b.bottom)
+  };
+  return rect;
+}
+
+
+static long long Area(const MonitorLayout::Rect &rect) {
+  return (long long)(rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+
+void MonitorLayout::SetMonitors(const std::vector<Rect> &monitors) {
+  mSurfaces.clear();
+  for (const Rect &monitor : monitors) {
+    if (IsEmpty(monitor)) {
+      continue;
+    }
+    bool mirrored = std::any_of(mSurfaces.begin(), mSurfaces.end(),
+        [&monitor] (const Surface &surface) {
+      return surface.rect.left == monitor.left && surface.rect.top == monitor.top
+        && surface.rect.right == monitor.right && surface.rect.bottom == monitor.bottom;
+    });
+    if (!mirrored) {
+      Surface surface;
+      surface.rect = monitor;
+      mSurfaces.push_back(surface);
+    }
+  }
+}
+
+
+size_t MonitorLayout::GetSurfaceCount() const {
+  return mSurfaces.size();
+}
+
+
+const MonitorLayout::Rect &MonitorLayout::GetSurface(size_t surface) const {
+  return mSurfaces[surface].rect;
+}
+
+
+void MonitorLayout::Invalidate(const Rect &rect) {
+  for (Surface &surface : mSurfaces) {
+    Rect part = Intersection(rect, surface.rect);
+    if (!IsEmpty(part)) {
+      AddDirty(surface, part);
+    }
+  }
+}
+
+
+void MonitorLayout::InvalidateAll() {
+  for (Surface &surface : mSurfaces) {
+    surface.dirty.assign(1, surface.rect);
+  }
+}
+
+
+bool MonitorLayout::TakeDirty(size_t index, std::vector<Rect> &rects) {
+  Surface &surface = mSurfaces[index];
+  if (surface.dirty.empty()) {
+    return false;
+  }
+
+  // Painting each rect has a cost of its own, so only keep them apart if that saves a good part
+  // of their bounding rect.
+  Rect bounds = surface.dirty.front();
+  long long area = 0;
+  for (const Rect &rect : surface.dirty) {
+    bounds = Union(bounds, rect);
+    area += Area(rect);
+  }
+  if (area * 2 >= Area(bounds)) {
+    rects.push_back(bounds);
+  } else {
+    rects.insert(rects.end(), surface.dirty.begin(), surface.dirty.end());
+  }
+
+  surface.dirty.clear();
+  return true;
+}
+
+
+void MonitorLayout::AddDirty(Surface &surface, const Rect &rect) {
+  std::vector<Rect> &dirty = surface.dirty;
+  for (const Rect &existing : dirty) {
+    if (Contains(existing, rect)) {
+      return;
+    }
+  }
+  dirty.erase(std::remove_if(dirty.begin(), dirty.end(), [&rect] (const Rect &existing) {
+    return Contains(rect, existing);
+  }), dirty.end());
+
+  if (dirty.size() == MAX_DIRTY_RECTS) {
+    Rect bounds = rect;
+    for (const Rect &existing : dirty) {
+      bounds = Union(bounds, existing);
+    }
+    dirty.assign(1, bounds);
+  } else {
+    dirty.push_back(rect);
+  }
+}
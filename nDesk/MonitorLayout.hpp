@@ -0,0 +1,64 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/MonitorLayout.hpp
+// The nModules Project
+//
+// Splits the desktop into one surface per monitor, and tracks what needs repainting on each.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+/// <summary>
+/// Splits the desktop into one surface per monitor. Damage is clipped to the surfaces it falls on
+/// and tracked per surface, so that changes on two monitors never cause the space between them to
+/// be repainted, and nothing in the gaps of an irregular layout is ever painted at all.
+/// </summary>
+class MonitorLayout {
+public:
+  struct Rect {
+    long left, top, right, bottom;
+  };
+
+public:
+  /// <summary>
+  /// Sets the monitors, in desktop window coordinates. Monitors which mirror each other share a
+  /// surface. All damage is dropped.
+  /// </summary>
+  void SetMonitors(const std::vector<Rect> &monitors);
+
+  size_t GetSurfaceCount() const;
+  const Rect &GetSurface(size_t surface) const;
+
+  /// <summary>
+  /// Marks the rect as needing a repaint on every surface it touches.
+  /// </summary>
+  void Invalidate(const Rect &rect);
+
+  /// <summary>
+  /// Marks every surface as needing a full repaint.
+  /// </summary>
+  void InvalidateAll();
+
+  /// <summary>
+  /// Retrieves, and clears, the parts of the surface which need repainting.
+  /// </summary>
+  /// <returns>False if the surface doesn't need to be repainted.</returns>
+  bool TakeDirty(size_t surface, std::vector<Rect> &rects);
+
+public:
+  // The most separate rects a surface keeps track of. Any more, and they are merged.
+  static const size_t MAX_DIRTY_RECTS = 8;
+
+private:
+  struct Surface {
+    Rect rect;
+    std::vector<Rect> dirty;
+  };
+
+private:
+  static void AddDirty(Surface &surface, const Rect &rect);
+
+private:
+  std::vector<Surface> mSurfaces;
+};
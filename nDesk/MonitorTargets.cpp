@@ -0,0 +1,278 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/MonitorTargets.cpp
+// The nModules Project
+//
+// One Direct2D render target per monitor, for the desktop window.
+//-------------------------------------------------------------------------------------------------
+#include "MonitorTargets.hpp"
+
+#include "../nShared/Factories.h"
+#include "../Utilities/Macros.h"
+
+#include <d3d11.h>
+#include <dcomp.h>
+#include <dxgi1_2.h>
+
+
+MonitorTargets::MonitorTargets()
+  : mD3DDevice(nullptr)
+  , mDXGIFactory(nullptr)
+  , mD2DDevice(nullptr)
+  , mResourceContext(nullptr)
+  , mCompositionDevice(nullptr)
+  , mCompositionTarget(nullptr)
+  , mRootVisual(nullptr) {}
+
+
+MonitorTargets::~MonitorTargets() {
+  Discard();
+}
+
+
+HRESULT MonitorTargets::Create(HWND window, const std::vector<Monitor> &monitors) {
+  Discard();
+
+  // Direct2D needs BGRA surfaces. If the hardware can't provide them, WARP can.
+  const UINT flags = D3D11_CREATE_DEVICE_BGRA_SUPPORT;
+  HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, flags, nullptr, 0,
+    D3D11_SDK_VERSION, &mD3DDevice, nullptr, nullptr);
+  if (FAILED(hr)) {
+    hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, flags, nullptr, 0,
+      D3D11_SDK_VERSION, &mD3DDevice, nullptr, nullptr);
+  }
+
+  IDXGIDevice *dxgiDevice = nullptr;
+  if (SUCCEEDED(hr)) {
+    hr = mD3DDevice->QueryInterface(&dxgiDevice);
+  }
+
+  if (SUCCEEDED(hr)) {
+    IDXGIAdapter *adapter = nullptr;
+    hr = dxgiDevice->GetAdapter(&adapter);
+    if (SUCCEEDED(hr)) {
+      hr = adapter->GetParent(__uuidof(IDXGIFactory2), (LPVOID*)&mDXGIFactory);
+      adapter->Release();
+    }
+  }
+
+  if (SUCCEEDED(hr)) {
+    ID2D1Factory *factory = nullptr;
+    hr = Factories::GetD2DFactory((LPVOID*)&factory);
+    if (SUCCEEDED(hr)) {
+      ID2D1Factory1 *factory1 = nullptr;
+      hr = factory->QueryInterface(&factory1);
+      if (SUCCEEDED(hr)) {
+        hr = factory1->CreateDevice(dxgiDevice, &mD2DDevice);
+        factory1->Release();
+      }
+    }
+  }
+
+  if (SUCCEEDED(hr)) {
+    hr = mD2DDevice->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE, &mResourceContext);
+  }
+  if (SUCCEEDED(hr)) {
+    mResourceContext->SetDpi(96.0f, 96.0f);
+  }
+
+  if (SUCCEEDED(hr)) {
+    hr = DCompositionCreateDevice(dxgiDevice, __uuidof(IDCompositionDevice),
+      (LPVOID*)&mCompositionDevice);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = mCompositionDevice->CreateTargetForHwnd(window, TRUE, &mCompositionTarget);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = mCompositionDevice->CreateVisual(&mRootVisual);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = mCompositionTarget->SetRoot(mRootVisual);
+  }
+
+  SAFERELEASE(dxgiDevice);
+
+  for (const Monitor &monitor : monitors) {
+    if (SUCCEEDED(hr)) {
+      hr = CreateTarget(monitor);
+    }
+  }
+
+  if (SUCCEEDED(hr)) {
+    hr = mCompositionDevice->Commit();
+  }
+
+  if (FAILED(hr)) {
+    Discard();
+  }
+
+  return hr;
+}
+
+
+HRESULT MonitorTargets::CreateTarget(const Monitor &monitor) {
+  Target target;
+  target.monitor = monitor;
+  target.swapChain = nullptr;
+  target.context = nullptr;
+  target.backBuffer = nullptr;
+  target.visual = nullptr;
+  target.presented = false;
+
+  const UINT width = UINT(monitor.rect.right - monitor.rect.left);
+  const UINT height = UINT(monitor.rect.bottom - monitor.rect.top);
+
+  DXGI_SWAP_CHAIN_DESC1 desc;
+  ZeroMemory(&desc, sizeof(desc));
+  desc.Width = width;
+  desc.Height = height;
+  desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+  desc.SampleDesc.Count = 1;
+  desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+  desc.BufferCount = 2;
+  desc.Scaling = DXGI_SCALING_STRETCH;
+  desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+  desc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
+
+  HRESULT hr = mDXGIFactory->CreateSwapChainForComposition(mD3DDevice, &desc, nullptr,
+    &target.swapChain);
+
+  if (SUCCEEDED(hr)) {
+    hr = mD2DDevice->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE, &target.context);
+  }
+
+  if (SUCCEEDED(hr)) {
+    IDXGISurface *surface = nullptr;
+    hr = target.swapChain->GetBuffer(0, IID_PPV_ARGS(&surface));
+    if (SUCCEEDED(hr)) {
+      D2D1_BITMAP_PROPERTIES1 properties = D2D1::BitmapProperties1(
+        D2D1_BITMAP_OPTIONS_TARGET | D2D1_BITMAP_OPTIONS_CANNOT_DRAW,
+        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE),
+        monitor.dpiX, monitor.dpiY);
+      hr = target.context->CreateBitmapFromDxgiSurface(surface, &properties, &target.backBuffer);
+      surface->Release();
+    }
+  }
+
+  if (SUCCEEDED(hr)) {
+    target.context->SetTarget(target.backBuffer);
+    target.context->SetDpi(monitor.dpiX, monitor.dpiY);
+    hr = mCompositionDevice->CreateVisual(&target.visual);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = target.visual->SetContent(target.swapChain);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = target.visual->SetOffsetX(float(monitor.rect.left));
+  }
+  if (SUCCEEDED(hr)) {
+    hr = target.visual->SetOffsetY(float(monitor.rect.top));
+  }
+  if (SUCCEEDED(hr)) {
+    hr = mRootVisual->AddVisual(target.visual, FALSE, nullptr);
+  }
+
+  if (SUCCEEDED(hr)) {
+    target.previous.push_back(monitor.rect);
+    mTargets.push_back(target);
+  } else {
+    SAFERELEASE(target.visual);
+    SAFERELEASE(target.backBuffer);
+    SAFERELEASE(target.context);
+    SAFERELEASE(target.swapChain);
+  }
+
+  return hr;
+}
+
+
+void MonitorTargets::Discard() {
+  for (Target &target : mTargets) {
+    SAFERELEASE(target.visual);
+    SAFERELEASE(target.backBuffer);
+    SAFERELEASE(target.context);
+    SAFERELEASE(target.swapChain);
+  }
+  mTargets.clear();
+
+  SAFERELEASE(mRootVisual);
+  SAFERELEASE(mCompositionTarget);
+  SAFERELEASE(mCompositionDevice);
+  SAFERELEASE(mResourceContext);
+  SAFERELEASE(mD2DDevice);
+  SAFERELEASE(mDXGIFactory);
+  SAFERELEASE(mD3DDevice);
+}
+
+
+bool MonitorTargets::IsCreated() const {
+  return mResourceContext != nullptr;
+}
+
+
+size_t MonitorTargets::GetCount() const {
+  return mTargets.size();
+}
+
+
+ID2D1DeviceContext *MonitorTargets::GetResourceContext() const {
+  return mResourceContext;
+}
+
+
+ID2D1DeviceContext *MonitorTargets::BeginDraw(size_t monitor,
+    std::vector<MonitorLayout::Rect> &rects) {
+  Target &target = mTargets[monitor];
+
+  // The back buffer we are about to draw into was last drawn two frames ago, so it is missing
+  // whatever changed in the last frame, as well as what changed in this one.
+  target.changed = rects;
+  rects.insert(rects.end(), target.previous.begin(), target.previous.end());
+
+  // Layout is in window pixels. Undo the monitor's DPI scaling, so that a pixel stays a pixel.
+  const Monitor &m = target.monitor;
+  target.context->SetTransform(
+    D2D1::Matrix3x2F::Translation(-float(m.rect.left), -float(m.rect.top)) *
+    D2D1::Matrix3x2F::Scale(96.0f / m.dpiX, 96.0f / m.dpiY));
+  target.context->SetTextAntialiasMode(mResourceContext->GetTextAntialiasMode());
+
+  target.context->BeginDraw();
+  return target.context;
+}
+
+
+HRESULT MonitorTargets::EndDraw(size_t monitor) {
+  Target &target = mTargets[monitor];
+  const MonitorLayout::Rect &origin = target.monitor.rect;
+
+  HRESULT hr = target.context->EndDraw();
+
+  if (SUCCEEDED(hr)) {
+    std::vector<RECT> dirty;
+    for (const MonitorLayout::Rect &rect : target.changed) {
+      RECT local = {
+        rect.left - origin.left, rect.top - origin.top,
+        rect.right - origin.left, rect.bottom - origin.top
+      };
+      dirty.push_back(local);
+    }
+
+    // Nothing may be left out of the first present, and presenting nothing at all isn't allowed.
+    DXGI_PRESENT_PARAMETERS parameters;
+    ZeroMemory(&parameters, sizeof(parameters));
+    if (target.presented && !dirty.empty()) {
+      parameters.DirtyRectsCount = UINT(dirty.size());
+      parameters.pDirtyRects = dirty.data();
+    }
+    hr = target.swapChain->Present1(0, 0, &parameters);
+    target.presented = true;
+  }
+
+  target.previous.swap(target.changed);
+  target.changed.clear();
+
+  if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET) {
+    hr = D2DERR_RECREATE_TARGET;
+  }
+
+  return hr;
+}
@@ -0,0 +1,117 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/MonitorTargets.hpp
+// The nModules Project
+//
+// One Direct2D render target per monitor, for the desktop window.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "MonitorLayout.hpp"
+
+#include "../Utilities/Common.h"
+
+#include <d2d1_1.h>
+#include <vector>
+
+struct ID3D11Device;
+struct IDXGIFactory2;
+struct IDXGISwapChain1;
+struct IDCompositionDevice;
+struct IDCompositionTarget;
+struct IDCompositionVisual;
+
+/// <summary>
+/// Gives every monitor a render target of its own, which draws at that monitor's DPI and presents
+/// on its own. Each target is a Direct2D device context drawing into a swap chain the size of its
+/// monitor, and DirectComposition places the swap chains over the monitors in the desktop window.
+/// All of the contexts share one Direct2D device, so anything created with one of them can be
+/// drawn with all of them.
+/// </summary>
+class MonitorTargets {
+public:
+  struct Monitor {
+    // Where the monitor is, in window coordinates.
+    MonitorLayout::Rect rect;
+
+    // The monitor's DPI.
+    float dpiX;
+    float dpiY;
+  };
+
+public:
+  MonitorTargets();
+  ~MonitorTargets();
+
+  MonitorTargets(const MonitorTargets&) = delete;
+  MonitorTargets &operator=(const MonitorTargets&) = delete;
+
+public:
+  /// <summary>
+  /// Creates the device, and a target for each monitor.
+  /// </summary>
+  /// <returns>An error if DirectComposition or Direct3D can't be used, in which case nothing is
+  /// created.</returns>
+  HRESULT Create(HWND window, const std::vector<Monitor> &monitors);
+
+  /// <summary>
+  /// Releases the targets and the device.
+  /// </summary>
+  void Discard();
+
+  bool IsCreated() const;
+  size_t GetCount() const;
+
+  /// <summary>
+  /// A context which isn't tied to any monitor, for creating resources. It is at 96 DPI, so that
+  /// bitmaps created with it are as many DIPs as they are pixels, and come out the same size on
+  /// every monitor.
+  /// </summary>
+  ID2D1DeviceContext *GetResourceContext() const;
+
+  /// <summary>
+  /// Starts drawing to a monitor. Everything is drawn in window coordinates, in pixels, whatever
+  /// the DPI of the monitor. Anything which asks the context for its DPI gets the monitor's.
+  /// </summary>
+  /// <param name="rects">The parts of the monitor which changed, in window coordinates. The parts
+  /// which the back buffer is missing from earlier frames are added, and all of them have to be
+  /// painted.</param>
+  ID2D1DeviceContext *BeginDraw(size_t monitor, std::vector<MonitorLayout::Rect> &rects);
+
+  /// <summary>
+  /// Finishes drawing to a monitor, and presents the parts which changed.
+  /// </summary>
+  /// <returns>D2DERR_RECREATE_TARGET if the device has been lost.</returns>
+  HRESULT EndDraw(size_t monitor);
+
+private:
+  struct Target {
+    Monitor monitor;
+    IDXGISwapChain1 *swapChain;
+    ID2D1DeviceContext *context;
+    ID2D1Bitmap1 *backBuffer;
+    IDCompositionVisual *visual;
+
+    // Whether anything has been presented yet. The first present has to be of everything.
+    bool presented;
+
+    // What changed in this frame, and in the frame before it, which the back buffer doesn't have
+    // yet, since the swap chain flips between two buffers.
+    std::vector<MonitorLayout::Rect> changed;
+    std::vector<MonitorLayout::Rect> previous;
+  };
+
+private:
+  HRESULT CreateTarget(const Monitor &monitor);
+
+private:
+  ID3D11Device *mD3DDevice;
+  IDXGIFactory2 *mDXGIFactory;
+  ID2D1Device *mD2DDevice;
+  ID2D1DeviceContext *mResourceContext;
+
+  IDCompositionDevice *mCompositionDevice;
+  IDCompositionTarget *mCompositionTarget;
+  IDCompositionVisual *mRootVisual;
+
+  std::vector<Target> mTargets;
+};
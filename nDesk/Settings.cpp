@@ -29,12 +29,22 @@ void nDesk::Settings::Load() {
     // 
     g_pDesktopPainter->SetSquareSize(LiteStep::GetRCInt(L"nDeskTransitionSquareSize", 150));
 
+    // Makes random transitions repeatable. 0 picks a new order every time.
+    g_pDesktopPainter->SetTransitionSeed((unsigned int)LiteStep::GetRCInt(L"nDeskTransitionSeed", 0));
+
     // 
     LiteStep::GetRCString(L"nDeskTransitionEffect",  buf, L"FadeOut", _countof(buf));
     g_pDesktopPainter->SetTransitionType(TransitionTypeFromString(buf));
 
     // 
     g_pDesktopPainter->SetInvalidateAllOnUpdate(LiteStep::GetRCBoolDef(L"nDeskInvalidateAllOnUpdate", FALSE) != FALSE);
+
+    // Animated wallpapers decode this many frames ahead
+    g_pDesktopPainter->SetAnimationBufferSize(LiteStep::GetRCInt(L"nDeskAnimationBufferFrames", 4));
+
+    // A folder of images to play as the wallpaper, in frames per second
+    LiteStep::GetRCString(L"nDeskWallpaperSequence", buf, L"", _countof(buf));
+    g_pDesktopPainter->SetWallpaperSequence(buf, LiteStep::GetRCDouble(L"nDeskWallpaperSequenceFrameRate", 24.0));
 }
 
 
@@ -0,0 +1,370 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/SoftwareCompositor.cpp
+// The nModules Project
+//
+// Renders wallpaper transitions on the CPU.
+//-------------------------------------------------------------------------------------------------
+#include "SoftwareCompositor.hpp"
+#include "BlendKernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+
+using std::min;
+using std::max;
+
+
+static uint8_t *Row(const SoftwareCompositor::Surface &surface, uint32_t y) {
+  return surface.pixels + size_t(y) * surface.stride;
+}
+
+
+/// <summary>
+/// Converts a coverage in the range [0, 1] to a kernel weight.
+/// </summary>
+static uint32_t Weight(float coverage) {
+  return uint32_t(min(1.0f, max(0.0f, coverage)) * 256.0f + 0.5f);
+}
+
+
+/// <summary>
+/// Rounds a position along an edge to a whole pixel.
+/// </summary>
+static uint32_t Snap(float position, uint32_t size) {
+  return uint32_t(min(float(size), max(0.0f, floorf(position + 0.5f))));
+}
+
+
+SoftwareCompositor::Transition::Transition()
+  : effect(Effect::Fade)
+  , direction(Direction::Left)
+  , slideType(SlideType::Both)
+  , gridType(GridSchedule::RANDOM)
+  , seed(0)
+  , fadeTime(0.2f)
+  , squareSize(100)
+  , hideOld(false)
+{
+}
+
+
+SoftwareCompositor::SoftwareCompositor()
+  : mSquaresX(0)
+  , mSquaresY(0)
+  , mScheduleValid(false)
+{
+  ResetFrameStats();
+}
+
+
+void SoftwareCompositor::SetTransition(const Transition &transition) {
+  mTransition = transition;
+  mTransition.squareSize = max(1u, mTransition.squareSize);
+  mScheduleValid = false;
+}
+
+
+void SoftwareCompositor::Paint(const Surface &oldImage, const Surface &newImage,
+    const Surface &target, float progress) {
+  if (oldImage.width != target.width || oldImage.height != target.height
+      || newImage.width != target.width || newImage.height != target.height) {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  progress = min(1.0f, max(0.0f, progress));
+
+  switch (mTransition.effect) {
+  case Effect::Fade:
+    PaintFade(oldImage, newImage, target, progress);
+    break;
+
+  case Effect::Slide:
+    PaintSlide(oldImage, newImage, target, progress);
+    break;
+
+  case Effect::Grid:
+    PaintGrid(oldImage, newImage, target, progress);
+    break;
+
+  case Effect::Blinds:
+    PaintBlinds(oldImage, newImage, target, progress);
+    break;
+
+  case Effect::Circular:
+    PaintCircular(oldImage, newImage, target, progress);
+    break;
+  }
+
+  const double ms = std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - start).count();
+  mFrameStats.frames++;
+  mFrameStats.lastMs = ms;
+  mFrameStats.maxMs = max(mFrameStats.maxMs, ms);
+  mFrameStats.totalMs += ms;
+}
+
+
+const SoftwareCompositor::FrameStats &SoftwareCompositor::GetFrameStats() const {
+  return mFrameStats;
+}
+
+
+void SoftwareCompositor::ResetFrameStats() {
+  mFrameStats.frames = 0;
+  mFrameStats.lastMs = 0;
+  mFrameStats.maxMs = 0;
+  mFrameStats.totalMs = 0;
+}
+
+
+/// <summary>
+/// Clips the rect to the target. Returns false if nothing is left.
+/// </summary>
+static bool Clip(const SoftwareCompositor::Surface &target, SoftwareCompositor::Rect &rect) {
+  rect.left = max(rect.left, 0);
+  rect.top = max(rect.top, 0);
+  rect.right = min(rect.right, int32_t(target.width));
+  rect.bottom = min(rect.bottom, int32_t(target.height));
+  return rect.left < rect.right && rect.top < rect.bottom;
+}
+
+
+void SoftwareCompositor::Fill(const Surface &target, const Rect &clip, uint32_t color) {
+  Rect rect = clip;
+  if (!Clip(target, rect)) {
+    return;
+  }
+
+  for (int32_t y = rect.top; y < rect.bottom; ++y) {
+    uint8_t *out = Row(target, uint32_t(y)) + size_t(rect.left) * 4;
+    for (int32_t x = rect.left; x < rect.right; ++x, out += 4) {
+      out[0] = uint8_t(color);
+      out[1] = uint8_t(color >> 8);
+      out[2] = uint8_t(color >> 16);
+      out[3] = uint8_t(color >> 24);
+    }
+  }
+}
+
+
+void SoftwareCompositor::Blit(const Surface &source, const Surface &target, int32_t x, int32_t y,
+    const Rect &clip) {
+  Rect rect = { max(clip.left, x), max(clip.top, y),
+    int32_t(min(int64_t(clip.right), int64_t(x) + source.width)),
+    int32_t(min(int64_t(clip.bottom), int64_t(y) + source.height)) };
+  if (!Clip(target, rect)) {
+    return;
+  }
+
+  for (int32_t row = rect.top; row < rect.bottom; ++row) {
+    BlendKernels::Copy(Row(source, uint32_t(row - y)) + size_t(rect.left - x) * 4,
+      Row(target, uint32_t(row)) + size_t(rect.left) * 4, uint32_t(rect.right - rect.left));
+  }
+}
+
+
+void SoftwareCompositor::PaintFade(const Surface &oldImage, const Surface &newImage,
+    const Surface &target, float progress) {
+  // The wallpapers are opaque, so fading the new image in and fading the old one out are the
+  // same thing.
+  const uint32_t weight = Weight(progress);
+  for (uint32_t y = 0; y < target.height; ++y) {
+    BlendKernels::Lerp(Row(oldImage, y), Row(newImage, y), Row(target, y), target.width, weight);
+  }
+}
+
+
+void SoftwareCompositor::PaintSlide(const Surface &oldImage, const Surface &newImage,
+    const Surface &target, float progress) {
+  const SlideType type = mTransition.slideType;
+  const bool slideOld = type == SlideType::Both || type == SlideType::Old;
+  const bool slideNew = type == SlideType::Both || type == SlideType::New;
+  const uint32_t width = target.width, height = target.height;
+
+  switch (mTransition.direction) {
+  case Direction::Left:
+  case Direction::Right:
+    {
+      // The old image is on one side of the edge, and the new one on the other. Each image is
+      // either shifted along with the edge, or stays where it is.
+      const bool left = mTransition.direction == Direction::Left;
+      const uint32_t edge = Snap(width * (left ? 1.0f - progress : progress), width);
+      for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t *oldRow = Row(oldImage, y), *newRow = Row(newImage, y);
+        uint8_t *out = Row(target, y);
+        if (left) {
+          BlendKernels::Copy(oldRow + (slideOld ? width - edge : 0) * 4, out, edge);
+          BlendKernels::Copy(newRow + (slideNew ? 0 : edge) * 4, out + edge * 4, width - edge);
+        } else {
+          BlendKernels::Copy(newRow + (slideNew ? width - edge : 0) * 4, out, edge);
+          BlendKernels::Copy(oldRow + (slideOld ? 0 : edge) * 4, out + edge * 4, width - edge);
+        }
+      }
+    }
+    break;
+
+  case Direction::Up:
+  case Direction::Down:
+    {
+      const bool up = mTransition.direction == Direction::Up;
+      const uint32_t edge = Snap(height * (up ? 1.0f - progress : progress), height);
+      for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t *in;
+        if (up) {
+          in = y < edge ? Row(oldImage, slideOld ? y + height - edge : y)
+            : Row(newImage, slideNew ? y - edge : y);
+        } else {
+          in = y < edge ? Row(newImage, slideNew ? y + height - edge : y)
+            : Row(oldImage, slideOld ? y - edge : y);
+        }
+        BlendKernels::Copy(in, Row(target, y), width);
+      }
+    }
+    break;
+  }
+}
+
+
+void SoftwareCompositor::PaintGrid(const Surface &oldImage, const Surface &newImage,
+    const Surface &target, float progress) {
+  UpdateSchedule(target.width, target.height);
+
+  // Hiding the old image is showing it in reverse, on top of the new one.
+  const Surface &bottom = mTransition.hideOld ? newImage : oldImage;
+  const Surface &top = mTransition.hideOld ? oldImage : newImage;
+  if (mTransition.hideOld) {
+    progress = 1.0f - progress;
+  }
+
+  const float fadeTime = mTransition.fadeTime;
+  for (size_t i = 0; i < mStartTimes.size(); ++i) {
+    const float elapsed = progress - mStartTimes[i];
+    mWeights[i] = fadeTime > 0.0f ? Weight(elapsed / fadeTime) : elapsed >= 0.0f ? 256 : 0;
+  }
+
+  const uint32_t size = mTransition.squareSize;
+  for (uint32_t y = 0; y < target.height; ++y) {
+    const uint32_t *weight = mWeights.data() + y / size;
+    const uint8_t *bottomRow = Row(bottom, y), *topRow = Row(top, y);
+    uint8_t *out = Row(target, y);
+    for (uint32_t x = 0; x < target.width; x += size, weight += mSquaresY) {
+      const size_t offset = size_t(x) * 4;
+      BlendKernels::Lerp(bottomRow + offset, topRow + offset, out + offset,
+        min(size, target.width - x), *weight);
+    }
+  }
+}
+
+
+void SoftwareCompositor::PaintBlinds(const Surface &oldImage, const Surface &newImage,
+    const Surface &target, float progress) {
+  // Each slat opens from the edge it is moving away from, until it covers the whole slat.
+  const uint32_t size = mTransition.squareSize;
+  const float opening = progress * size;
+  const uint32_t full = uint32_t(opening);
+  const uint32_t partial = Weight(opening - full);
+
+  switch (mTransition.direction) {
+  case Direction::Up:
+  case Direction::Down:
+    {
+      const bool down = mTransition.direction == Direction::Down;
+      for (uint32_t y = 0; y < target.height; ++y) {
+        const uint32_t offset = y % size;
+        const uint32_t row = down ? offset : size - 1 - offset;
+        const uint32_t weight = row < full ? 256 : row == full ? partial : 0;
+        BlendKernels::Lerp(Row(oldImage, y), Row(newImage, y), Row(target, y), target.width,
+          weight);
+      }
+    }
+    break;
+
+  case Direction::Left:
+  case Direction::Right:
+    {
+      const bool right = mTransition.direction == Direction::Right;
+      for (uint32_t y = 0; y < target.height; ++y) {
+        const uint8_t *oldRow = Row(oldImage, y), *newRow = Row(newImage, y);
+        uint8_t *out = Row(target, y);
+        for (uint32_t x = 0; x < target.width; x += size) {
+          // Split the slat into [shown, edge pixel, hidden], from the side it opens from.
+          const uint32_t slat = min(size, target.width - x);
+          const uint32_t shown = min(full, slat);
+          const uint32_t edge = min(1u, slat - shown);
+          const uint32_t hidden = slat - shown - edge;
+          const uint32_t shownStart = right ? x : x + slat - shown;
+          const uint32_t edgeStart = right ? x + shown : x + hidden;
+          const uint32_t hiddenStart = right ? x + shown + edge : x;
+
+          BlendKernels::Copy(newRow + shownStart * 4, out + shownStart * 4, shown);
+          BlendKernels::Lerp(oldRow + edgeStart * 4, newRow + edgeStart * 4, out + edgeStart * 4,
+            edge, partial);
+          BlendKernels::Copy(oldRow + hiddenStart * 4, out + hiddenStart * 4, hidden);
+        }
+      }
+    }
+    break;
+  }
+}
+
+
+void SoftwareCompositor::PaintCircular(const Surface &oldImage, const Surface &newImage,
+    const Surface &target, float progress) {
+  // A circle from the center which reaches the corners at the end of the transition. Either the
+  // new image grows inside it, or the old image shrinks inside it.
+  const Surface &inner = mTransition.hideOld ? oldImage : newImage;
+  const Surface &outer = mTransition.hideOld ? newImage : oldImage;
+  const float cx = target.width / 2.0f, cy = target.height / 2.0f;
+  const float radius = sqrtf(cx * cx + cy * cy) * (mTransition.hideOld ? 1.0f - progress : progress);
+
+  for (uint32_t y = 0; y < target.height; ++y) {
+    const uint8_t *innerRow = Row(inner, y), *outerRow = Row(outer, y);
+    uint8_t *out = Row(target, y);
+
+    const float dy = y + 0.5f - cy;
+    const float chord = radius * radius - dy * dy;
+    if (chord <= 0.0f) {
+      BlendKernels::Copy(outerRow, out, target.width);
+      continue;
+    }
+
+    // The span of the row inside the circle. The pixels at its ends are blended by how much of
+    // them it covers.
+    const float half = sqrtf(chord);
+    const float left = max(0.0f, cx - half), right = min(float(target.width), cx + half);
+    const uint32_t first = uint32_t(left), last = min(target.width - 1, uint32_t(right));
+
+    BlendKernels::Copy(outerRow, out, first);
+    if (first == last) {
+      BlendKernels::Lerp(outerRow + first * 4, innerRow + first * 4, out + first * 4, 1,
+        Weight(right - left));
+    } else {
+      BlendKernels::Lerp(outerRow + first * 4, innerRow + first * 4, out + first * 4, 1,
+        Weight(first + 1 - left));
+      BlendKernels::Copy(innerRow + (first + 1) * 4, out + (first + 1) * 4, last - first - 1);
+      BlendKernels::Lerp(outerRow + last * 4, innerRow + last * 4, out + last * 4, 1,
+        Weight(right - last));
+    }
+    BlendKernels::Copy(outerRow + (last + 1) * 4, out + (last + 1) * 4, target.width - last - 1);
+  }
+}
+
+
+void SoftwareCompositor::UpdateSchedule(uint32_t width, uint32_t height) {
+  const uint32_t size = mTransition.squareSize;
+  const uint32_t squaresX = (width + size - 1) / size;
+  const uint32_t squaresY = (height + size - 1) / size;
+  if (mScheduleValid && squaresX == mSquaresX && squaresY == mSquaresY) {
+    return;
+  }
+
+  mSquaresX = squaresX;
+  mSquaresY = squaresY;
+  mStartTimes.resize(size_t(squaresX) * squaresY);
+  mWeights.resize(mStartTimes.size());
+  GridSchedule::ComputeStartTimes(mTransition.gridType, int(squaresX), int(squaresY),
+    mTransition.fadeTime, mTransition.seed, mStartTimes.data());
+  mScheduleValid = true;
+}
@@ -0,0 +1,158 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/SoftwareCompositor.hpp
+// The nModules Project
+//
+// Renders wallpaper transitions on the CPU.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "TransitionEffects/GridSchedule.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+/// <summary>
+/// A software implementation of the wallpaper transitions, which composes premultiplied 32bpp
+/// BGRA buffers instead of painting Direct2D brushes. It gives the same frame for the same
+/// input on every machine, so it can be used to produce reference frames for the effects, to time
+/// them without a GPU, and to paint into a DIB section when no render target can be created.
+/// </summary>
+class SoftwareCompositor {
+public:
+  /// <summary>
+  /// Premultiplied 32bpp BGRA pixels.
+  /// </summary>
+  struct Surface {
+    uint8_t *pixels;
+    uint32_t width;
+    uint32_t height;
+    // The number of bytes between the start of each row.
+    uint32_t stride;
+  };
+
+  /// <summary>
+  /// A rectangle of pixels, from left to right and top to bottom, exclusive.
+  /// </summary>
+  struct Rect {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+  };
+
+  enum class Effect {
+    Fade,
+    Slide,
+    Grid,
+    Blinds,
+    Circular
+  };
+
+  enum class Direction {
+    Up,
+    Down,
+    Left,
+    Right
+  };
+
+  /// <summary>
+  /// Which images move during a slide. Matches SlideEffect::SlideType.
+  /// </summary>
+  enum class SlideType {
+    Both,
+    New,
+    Old,
+    Scan
+  };
+
+  /// <summary>
+  /// Describes a transition. Only the fields used by the effect matter.
+  /// </summary>
+  struct Transition {
+    Transition();
+
+    Effect effect;
+
+    // Slide; and Blinds, where up and down give horizontal slats.
+    Direction direction;
+    SlideType slideType;
+
+    // Grid.
+    GridSchedule::GridType gridType;
+    unsigned seed;
+    // The fraction of the transition that each square spends fading.
+    float fadeTime;
+
+    // Grid and Blinds. The size of each square or slat, in pixels.
+    uint32_t squareSize;
+
+    // Grid and Circular. Removes the old image from on top of the new one, rather than putting
+    // the new image on top of the old one.
+    bool hideOld;
+  };
+
+  /// <summary>
+  /// Timings of the frames painted so far.
+  /// </summary>
+  struct FrameStats {
+    uint32_t frames;
+    double lastMs;
+    double maxMs;
+    double totalMs;
+  };
+
+public:
+  SoftwareCompositor();
+
+public:
+  void SetTransition(const Transition &transition);
+
+  /// <summary>
+  /// Paints the transition at the given progress, in the range [0, 1]. All surfaces must have the
+  /// same size, and the target must not overlap the images.
+  /// </summary>
+  void Paint(const Surface &oldImage, const Surface &newImage, const Surface &target,
+    float progress);
+
+  const FrameStats &GetFrameStats() const;
+  void ResetFrameStats();
+
+public:
+  /// <summary>
+  /// Fills the part of the target inside the clip rect with a color, packed as 0xAARRGGBB.
+  /// </summary>
+  static void Fill(const Surface &target, const Rect &clip, uint32_t color);
+
+  /// <summary>
+  /// Copies the source to (x, y) in the target, leaving out anything outside the clip rect. Used to
+  /// lay wallpapers out, and to copy the background to the screen.
+  /// </summary>
+  static void Blit(const Surface &source, const Surface &target, int32_t x, int32_t y,
+    const Rect &clip);
+
+private:
+  void PaintFade(const Surface &oldImage, const Surface &newImage, const Surface &target,
+    float progress);
+  void PaintSlide(const Surface &oldImage, const Surface &newImage, const Surface &target,
+    float progress);
+  void PaintGrid(const Surface &oldImage, const Surface &newImage, const Surface &target,
+    float progress);
+  void PaintBlinds(const Surface &oldImage, const Surface &newImage, const Surface &target,
+    float progress);
+  void PaintCircular(const Surface &oldImage, const Surface &newImage, const Surface &target,
+    float progress);
+
+  // Recomputes the grid schedule if the transition or the size has changed.
+  void UpdateSchedule(uint32_t width, uint32_t height);
+
+private:
+  Transition mTransition;
+  FrameStats mFrameStats;
+
+  // When each grid square starts to fade, and its weight in the current frame.
+  std::vector<float> mStartTimes;
+  std::vector<uint32_t> mWeights;
+  uint32_t mSquaresX;
+  uint32_t mSquaresY;
+  bool mScheduleValid;
+};
@@ -23,6 +23,10 @@ public:
 		// For animations that fade different parts at different times, how long the fading of an induvidual part should take.
 		float fFadeTime;
 
+		// Seeds random transitions, so that they play out the same way every time. 0 picks a new
+		// seed for every transition.
+		unsigned int uSeed;
+
 		// The rect encompassing the entire screen
 		D2D1_RECT_F WPRect;
 
@@ -5,6 +5,7 @@
 *
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 #include "GridEffect.hpp"
+#include "../../nShared/Factories.h"
 
 #include <algorithm>
 #include <ctime>
@@ -19,9 +20,11 @@ using std::max;
 GridEffect::GridEffect(GridType fadeType, GridStyle gridStyle) {
   m_gridType = fadeType;
   m_gridStyle = gridStyle;
-  srand((unsigned)time(NULL));
-  m_StartTimes = nullptr;
-  m_Squares = nullptr;
+  m_seed = (unsigned)time(NULL);
+  m_pOldBrush = nullptr;
+  m_pNewBrush = nullptr;
+  m_pLayer = nullptr;
+  m_layerSquares = 0;
   m_iSquaresY = 0;
   m_iSquaresX = 0;
   m_iSquares = 0;
@@ -31,8 +34,7 @@ GridEffect::GridEffect(GridType fadeType, GridStyle gridStyle) {
 /// Destructor
 /// </summary>
 GridEffect::~GridEffect() {
-  free(m_StartTimes);
-  free(m_Squares);
+  DiscardLayer();
 }
 
 /// <summary>
@@ -47,104 +49,37 @@ void GridEffect::Initialize(TransitionSettings* transitionSettings) {
 /// Called just before a new painting session is about to begin
 /// </summary>
 void GridEffect::Start(ID2D1BitmapBrush *oldBrush, ID2D1BitmapBrush *newBrush) {
-  if (m_gridStyle == HIDE_OLD) {
-    m_pNewBrush = oldBrush;
-    m_pOldBrush = newBrush;
-  } else {
-    m_pOldBrush = oldBrush;
-    m_pNewBrush = newBrush;
-  }
-
-  // Generate values in the range [0, 1 - fadeTime]
-  switch (m_gridType) {
-  case RANDOM: {
-      for (int i = 0; i < m_iSquares; i++) {
-        m_StartTimes[i] = (rand() % 10000 * (1.0f - m_pTransitionSettings->fFadeTime)) / 10000.0f;
-      }
-      break;
-    }
-
-  case LINEAR_HORIZONTAL: {
-      int i = 0;
-      for (int y = 0; y < m_iSquaresY; y++) {
-        for (int x = 0; x < m_iSquaresX; x++) {
-          m_StartTimes[x*m_iSquaresY + y] = (i++)*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-      }
-      break;
-    }
-
-  case LINEAR_VERTICAL: {
-      for (int i = 0; i < m_iSquares; i++) {
-        m_StartTimes[i] = i*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-      }
-      break;
-    }
-
-  case TRIANGULAR: {
-      float alpha = (float)atan2((double)m_iSquaresY, (double)m_iSquaresX);
-      float up = sqrt(float(m_iSquaresX*m_iSquaresX + m_iSquaresY*m_iSquaresY)) / (1.0f - m_pTransitionSettings->fFadeTime);
-      for (int x = 0; x < m_iSquaresX; x++) {
-        for (int y = 0; y < m_iSquaresY; y++) {
-          m_StartTimes[x*m_iSquaresY + y] = sqrt(float(x*x + y*y))*cos(atan2((float)y, (float)x) - alpha) / up;
-        }
-      }
-      break;
-    }
-
-  case CLOCKWISE: {
-      int index = 0;
-      for (int depth = 0; depth < min(m_iSquaresX, m_iSquaresY) / 2; depth++) {
-        for (int x = depth; x < m_iSquaresX - depth - 1; x++) {
-          m_StartTimes[x*m_iSquaresY + depth] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int y = depth; y < m_iSquaresY - depth - 1; y++) {
-          m_StartTimes[(m_iSquaresX - depth - 1)*m_iSquaresY + y] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int x = m_iSquaresX - depth - 1; x > depth; x--) {
-          m_StartTimes[(x + 1)*m_iSquaresY - depth - 1] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int y = m_iSquaresY - depth - 1; y > depth; y--) {
-          m_StartTimes[depth*m_iSquaresY + y] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-      }
-      break;
-    }
-
-  case COUNTERCLOCKWISE: {
-      int index = 0;
-      for (int depth = 0; depth < min(m_iSquaresX, m_iSquaresY) / 2; depth++) {
-        for (int y = depth; y < m_iSquaresY - depth - 1; y++) {
-          m_StartTimes[depth*m_iSquaresY + y] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int x = depth; x < m_iSquaresX - depth - 1; x++) {
-          m_StartTimes[(x + 1)*m_iSquaresY - depth - 1] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int y = m_iSquaresY - depth - 1; y > depth; y--) {
-          m_StartTimes[(m_iSquaresX - depth - 1)*m_iSquaresY + y] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-        for (int x = m_iSquaresX - depth - 1; x > depth; x--) {
-          m_StartTimes[x*m_iSquaresY + depth] = index++*(1.0f - m_pTransitionSettings->fFadeTime) / m_iSquares;
-        }
-      }
-      break;
-    }
-  }
+  m_pOldBrush = oldBrush;
+  m_pNewBrush = newBrush;
+  BuildSchedule();
 }
 
 /// <summary>
 /// Paints the state of the animation at progress to the specified rendertarget
 /// </summary>
 void GridEffect::Paint(ID2D1RenderTarget* renderTarget, float fProgress) {
-  if (m_gridStyle == HIDE_OLD) {
-    fProgress = 1.0f - fProgress; // Run in reverse
+  const float fadeTime = max(m_pTransitionSettings->fFadeTime, 0.0001f);
+  const GridSchedule::Timeline::Band band = m_timeline.GetBand(fProgress);
+  const size_t done = band.done, started = band.started;
+
+  if (UpdateLayer(renderTarget, done)) {
+    ID2D1Bitmap *bitmap;
+    m_pLayer->GetBitmap(&bitmap);
+    renderTarget->DrawBitmap(bitmap, m_pTransitionSettings->WPRect);
+    bitmap->Release();
+  } else {
+    // Fall back to painting every finished square.
+    renderTarget->FillRectangle(m_pTransitionSettings->WPRect, m_pOldBrush);
+    for (size_t i = 0; i < done; i++) {
+      renderTarget->FillRectangle(m_Squares[m_timeline.GetSquare(i)], m_pNewBrush);
+    }
   }
 
-  renderTarget->FillRectangle(m_pTransitionSettings->WPRect, m_pOldBrush);
-  for (int i = 0; i < m_iSquares; i++) {
-    m_pNewBrush->SetOpacity(min(1.0f, max(fProgress - m_StartTimes[i], 0.0f) / m_pTransitionSettings->fFadeTime));
-    renderTarget->FillRectangle(m_Squares[i], m_pNewBrush);
+  for (size_t i = done; i < started; i++) {
+    m_pNewBrush->SetOpacity(min(1.0f, (fProgress - m_timeline.GetStartTime(i)) / fadeTime));
+    renderTarget->FillRectangle(m_Squares[m_timeline.GetSquare(i)], m_pNewBrush);
   }
+  m_pNewBrush->SetOpacity(1.0f);
 }
 
 /// <summary>
@@ -152,6 +87,7 @@ void GridEffect::Paint(ID2D1RenderTarget* renderTarget, float fProgress) {
 /// </summary>
 void GridEffect::End() {
   m_pNewBrush->SetOpacity(1.0f);
+  DiscardLayer();
 
   m_pOldBrush = NULL;
   m_pNewBrush = NULL;
@@ -165,19 +101,108 @@ void GridEffect::Resize() {
   m_iSquaresY = (int)ceil(m_pTransitionSettings->WPRect.bottom / m_pTransitionSettings->iSquareSize);
   m_iSquares = m_iSquaresY * m_iSquaresX;
 
-  // Reallocate memory for the squares
-  m_StartTimes = (float*)realloc(m_StartTimes, sizeof(float)*m_iSquares);
-  m_Squares = (D2D1_RECT_F*)realloc(m_Squares, sizeof(D2D1_RECT_F)*m_iSquares);
-
   // Work out the square positions
-  int square = 0;
+  m_Squares.clear();
+  m_Squares.reserve(m_iSquares);
   for (float x = m_pTransitionSettings->WPRect.left; x < m_pTransitionSettings->WPRect.right; x += m_pTransitionSettings->iSquareSize) {
     for (float y = m_pTransitionSettings->WPRect.top; y < m_pTransitionSettings->WPRect.bottom; y += m_pTransitionSettings->iSquareSize) {
-      m_Squares[square].left = x;
-      m_Squares[square].right = x + m_pTransitionSettings->iSquareSize;
-      m_Squares[square].top = y;
-      m_Squares[square].bottom = y + m_pTransitionSettings->iSquareSize;
-      square++;
+      m_Squares.push_back(D2D1::RectF(x, y, x + m_pTransitionSettings->iSquareSize, y + m_pTransitionSettings->iSquareSize));
     }
   }
-}
\ No newline at end of file
+
+  // The layer is the size of the old render target, and the old squares are painted to it.
+  DiscardLayer();
+  if (m_pNewBrush != nullptr) {
+    BuildSchedule();
+  }
+}
+
+/// <summary>
+/// Computes when each square fades in, and sorts them by it.
+/// </summary>
+void GridEffect::BuildSchedule() {
+  const unsigned seed = m_pTransitionSettings->uSeed != 0 ? m_pTransitionSettings->uSeed : m_seed++;
+
+  // Hiding the old squares in one order, on top of the new wallpaper, looks the same as showing
+  // the new squares in the reverse order. Always doing the latter means that squares only ever
+  // finish, so that finished squares can be kept in the layer.
+  m_timeline.Build(m_gridType, m_iSquaresX, m_iSquaresY, m_pTransitionSettings->fFadeTime, seed,
+    m_gridStyle == HIDE_OLD);
+
+  m_layerSquares = 0;
+  DiscardLayer();
+}
+
+/// <summary>
+/// Brings the layer up to date with the squares which have finished fading in.
+/// </summary>
+bool GridEffect::UpdateLayer(ID2D1RenderTarget* renderTarget, size_t doneSquares) {
+  if (m_pLayer != nullptr && doneSquares < m_layerSquares) {
+    DiscardLayer();
+  }
+
+  bool clear = false;
+  if (m_pLayer == nullptr) {
+    // The layer covers the whole desktop at 96 DPI, so that it can be drawn to any target on the
+    // same device, whatever the DPI of its monitor.
+    const D2D1_RECT_F &rect = m_pTransitionSettings->WPRect;
+    if (FAILED(renderTarget->CreateCompatibleRenderTarget(D2D1::SizeF(rect.right, rect.bottom),
+        D2D1::SizeU(UINT32(rect.right), UINT32(rect.bottom)), &m_pLayer))) {
+      m_pLayer = nullptr;
+      return false;
+    }
+    m_pLayer->SetAntialiasMode(D2D1_ANTIALIAS_MODE_ALIASED);
+    m_layerSquares = 0;
+    clear = true;
+  }
+
+  if (!clear && doneSquares == m_layerSquares) {
+    return true;
+  }
+
+  m_pLayer->BeginDraw();
+  if (clear) {
+    m_pLayer->FillRectangle(m_pTransitionSettings->WPRect, m_pOldBrush);
+  }
+
+  // Paint every square which finished since the last frame, as a single geometry.
+  if (doneSquares > m_layerSquares) {
+    ID2D1Factory *factory = nullptr;
+    ID2D1PathGeometry *geometry = nullptr;
+    ID2D1GeometrySink *sink = nullptr;
+    Factories::GetD2DFactory(reinterpret_cast<LPVOID*>(&factory));
+    if (SUCCEEDED(factory->CreatePathGeometry(&geometry)) && SUCCEEDED(geometry->Open(&sink))) {
+      for (size_t i = m_layerSquares; i < doneSquares; i++) {
+        const D2D1_RECT_F &rect = m_Squares[m_timeline.GetSquare(i)];
+        const D2D1_POINT_2F corners[] = {
+          D2D1::Point2F(rect.right, rect.top),
+          D2D1::Point2F(rect.right, rect.bottom),
+          D2D1::Point2F(rect.left, rect.bottom)
+        };
+        sink->BeginFigure(D2D1::Point2F(rect.left, rect.top), D2D1_FIGURE_BEGIN_FILLED);
+        sink->AddLines(corners, _countof(corners));
+        sink->EndFigure(D2D1_FIGURE_END_CLOSED);
+      }
+      if (SUCCEEDED(sink->Close())) {
+        m_pLayer->FillGeometry(geometry, m_pNewBrush);
+      }
+    }
+    SAFERELEASE(sink);
+    SAFERELEASE(geometry);
+  }
+
+  m_layerSquares = doneSquares;
+  if (m_pLayer->EndDraw() == D2DERR_RECREATE_TARGET) {
+    DiscardLayer();
+    return false;
+  }
+  return true;
+}
+
+/// <summary>
+/// Releases the layer.
+/// </summary>
+void GridEffect::DiscardLayer() {
+  SAFERELEASE(m_pLayer);
+  m_layerSquares = 0;
+}
@@ -8,18 +8,14 @@
 #pragma once
 
 #include "../TransitionEffect.hpp"
+#include "GridSchedule.hpp"
+
+#include <vector>
 
 class GridEffect : public TransitionEffect {
 public:
     //
-    enum GridType {
-        RANDOM,
-        LINEAR_VERTICAL,
-        LINEAR_HORIZONTAL,
-        TRIANGULAR,
-        CLOCKWISE,
-        COUNTERCLOCKWISE
-    };
+    typedef GridSchedule::GridType GridType;
 
     //
     enum GridStyle {
@@ -36,6 +32,17 @@ public:
     void Resize();
     void End();
 
+private:
+    // Computes when each square fades in, and sorts them by it.
+    void BuildSchedule();
+
+    // Makes sure that the layer exists on the device of the render target, and holds the first
+    // doneSquares squares of the schedule. Returns false if the layer couldn't be created.
+    bool UpdateLayer(ID2D1RenderTarget* renderTarget, size_t doneSquares);
+
+    // Releases the layer.
+    void DiscardLayer();
+
 private:
     // The type of fade we are doing
     GridType m_gridType;
@@ -43,11 +50,21 @@ private:
     // The
     GridStyle m_gridStyle;
 
-    // When to start showing the square
-    float* m_StartTimes;
+    // Seeds the random square order when TransitionSettings::uSeed is 0
+    unsigned m_seed;
 
     // Where the squares are of the screen
-    D2D1_RECT_F* m_Squares;
+    std::vector<D2D1_RECT_F> m_Squares;
+
+    // The squares, by when they start fading in. Squares which have finished fading in are a
+    // prefix of this, and the ones which are fading come right after them.
+    GridSchedule::Timeline m_timeline;
+
+    // The old wallpaper, with every finished square painted on top of it.
+    ID2D1BitmapRenderTarget* m_pLayer;
+
+    // The number of squares in the schedule which have been painted to the layer
+    size_t m_layerSquares;
 
     // The number of squares in a row/column
     int m_iSquaresY, m_iSquaresX, m_iSquares;
@@ -0,0 +1,161 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/TransitionEffects/GridSchedule.cpp
+// The nModules Project
+//
+// Decides when each square of a grid transition starts to fade.
+//-------------------------------------------------------------------------------------------------
+#include "GridSchedule.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+
+using std::min;
+
+
+void GridSchedule::ComputeStartTimes(GridType gridType, int squaresX, int squaresY,
+    float fadeTime, unsigned seed, float *startTimes) {
+  const int squares = squaresX * squaresY;
+  const float range = 1.0f - fadeTime;
+
+  // The spirals don't reach the middle of non-square grids. Let those go last.
+  std::fill(startTimes, startTimes + squares, range);
+
+  switch (gridType) {
+  case RANDOM:
+    {
+      std::minstd_rand random(seed);
+      for (int i = 0; i < squares; i++) {
+        startTimes[i] = (random() % 10000 * range) / 10000.0f;
+      }
+    }
+    break;
+
+  case LINEAR_HORIZONTAL:
+    {
+      int i = 0;
+      for (int y = 0; y < squaresY; y++) {
+        for (int x = 0; x < squaresX; x++) {
+          startTimes[x*squaresY + y] = (i++)*range / squares;
+        }
+      }
+    }
+    break;
+
+  case LINEAR_VERTICAL:
+    {
+      for (int i = 0; i < squares; i++) {
+        startTimes[i] = i*range / squares;
+      }
+    }
+    break;
+
+  case TRIANGULAR:
+    {
+      float alpha = (float)atan2((double)squaresY, (double)squaresX);
+      float up = sqrt(float(squaresX*squaresX + squaresY*squaresY)) / range;
+      for (int x = 0; x < squaresX; x++) {
+        for (int y = 0; y < squaresY; y++) {
+          startTimes[x*squaresY + y] = sqrt(float(x*x + y*y))*cos(atan2((float)y, (float)x) - alpha) / up;
+        }
+      }
+    }
+    break;
+
+  case CLOCKWISE:
+    {
+      int index = 0;
+      for (int depth = 0; depth < min(squaresX, squaresY) / 2; depth++) {
+        for (int x = depth; x < squaresX - depth - 1; x++) {
+          startTimes[x*squaresY + depth] = index++*range / squares;
+        }
+        for (int y = depth; y < squaresY - depth - 1; y++) {
+          startTimes[(squaresX - depth - 1)*squaresY + y] = index++*range / squares;
+        }
+        for (int x = squaresX - depth - 1; x > depth; x--) {
+          startTimes[(x + 1)*squaresY - depth - 1] = index++*range / squares;
+        }
+        for (int y = squaresY - depth - 1; y > depth; y--) {
+          startTimes[depth*squaresY + y] = index++*range / squares;
+        }
+      }
+    }
+    break;
+
+  case COUNTERCLOCKWISE:
+    {
+      int index = 0;
+      for (int depth = 0; depth < min(squaresX, squaresY) / 2; depth++) {
+        for (int y = depth; y < squaresY - depth - 1; y++) {
+          startTimes[depth*squaresY + y] = index++*range / squares;
+        }
+        for (int x = depth; x < squaresX - depth - 1; x++) {
+          startTimes[(x + 1)*squaresY - depth - 1] = index++*range / squares;
+        }
+        for (int y = squaresY - depth - 1; y > depth; y--) {
+          startTimes[(squaresX - depth - 1)*squaresY + y] = index++*range / squares;
+        }
+        for (int x = squaresX - depth - 1; x > depth; x--) {
+          startTimes[x*squaresY + depth] = index++*range / squares;
+        }
+      }
+    }
+    break;
+  }
+}
+
+
+GridSchedule::Timeline::Timeline()
+  : mFadeTime(0.0001f)
+{
+}
+
+
+void GridSchedule::Timeline::Build(GridType gridType, int squaresX, int squaresY, float fadeTime,
+    unsigned seed, bool reverse) {
+  const int squares = squaresX * squaresY;
+  std::vector<float> startTimes(squares);
+  ComputeStartTimes(gridType, squaresX, squaresY, fadeTime, seed, startTimes.data());
+
+  mEntries.resize(squares);
+  for (int i = 0; i < squares; i++) {
+    mEntries[i].startTime = reverse ? 1.0f - fadeTime - startTimes[i] : startTimes[i];
+    mEntries[i].square = i;
+  }
+  std::stable_sort(mEntries.begin(), mEntries.end(), [] (const Entry &a, const Entry &b) {
+    return a.startTime < b.startTime;
+  });
+
+  mFadeTime = std::max(fadeTime, 0.0001f);
+}
+
+
+GridSchedule::Timeline::Band GridSchedule::Timeline::GetBand(float progress) const {
+  auto startsAfter = [] (float progress, const Entry &entry) {
+    return progress < entry.startTime;
+  };
+
+  // Squares which started fading at least fadeTime ago are done, and everything after the ones
+  // which have started hasn't.
+  Band band;
+  band.done = std::upper_bound(mEntries.begin(), mEntries.end(), progress - mFadeTime,
+    startsAfter) - mEntries.begin();
+  band.started = std::upper_bound(mEntries.begin() + band.done, mEntries.end(), progress,
+    startsAfter) - mEntries.begin();
+  return band;
+}
+
+
+size_t GridSchedule::Timeline::GetCount() const {
+  return mEntries.size();
+}
+
+
+int GridSchedule::Timeline::GetSquare(size_t position) const {
+  return mEntries[position].square;
+}
+
+
+float GridSchedule::Timeline::GetStartTime(size_t position) const {
+  return mEntries[position].startTime;
+}
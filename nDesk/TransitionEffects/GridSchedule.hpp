@@ -0,0 +1,79 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/TransitionEffects/GridSchedule.hpp
+// The nModules Project
+//
+// Decides when each square of a grid transition starts to fade.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+namespace GridSchedule {
+  /// <summary>
+  /// The order in which the squares fade.
+  /// </summary>
+  enum GridType {
+    RANDOM,
+    LINEAR_VERTICAL,
+    LINEAR_HORIZONTAL,
+    TRIANGULAR,
+    CLOCKWISE,
+    COUNTERCLOCKWISE
+  };
+
+  /// <summary>
+  /// Computes the progress, in the range [0, 1 - fadeTime], at which each square starts to fade.
+  /// Squares are stored column by column, i.e. square (x, y) is at x * squaresY + y.
+  /// </summary>
+  /// <param name="seed">Seeds the random order, so that the same seed gives the same schedule.
+  /// </param>
+  void ComputeStartTimes(GridType gridType, int squaresX, int squaresY, float fadeTime,
+    unsigned seed, float *startTimes);
+
+  /// <summary>
+  /// The squares of a grid, sorted by when they start to fade. At any progress, the squares which
+  /// are done fading come first, followed by the ones which are fading, so a frame only has to
+  /// look at the squares which are in flight.
+  /// </summary>
+  class Timeline {
+  public:
+    // The first done squares are done fading, and the ones up to started are fading.
+    struct Band {
+      size_t done;
+      size_t started;
+    };
+
+  public:
+    Timeline();
+
+  public:
+    /// <summary>
+    /// Computes when each square starts to fade, and sorts them by it. If reverse is set, the
+    /// squares go in the opposite order, e.g. when hiding the old squares instead of showing the
+    /// new ones.
+    /// </summary>
+    void Build(GridType gridType, int squaresX, int squaresY, float fadeTime, unsigned seed,
+      bool reverse);
+
+    // Finds the squares which are fading at the given progress, in O(log n).
+    Band GetBand(float progress) const;
+
+    size_t GetCount() const;
+
+    // The square at a place in the timeline, as an index into the grid.
+    int GetSquare(size_t position) const;
+
+    float GetStartTime(size_t position) const;
+
+  private:
+    struct Entry {
+      float startTime;
+      int square;
+    };
+
+  private:
+    float mFadeTime;
+    std::vector<Entry> mEntries;
+  };
+}
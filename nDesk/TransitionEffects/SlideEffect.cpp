@@ -54,7 +54,7 @@ void SlideEffect::Paint(ID2D1RenderTarget* renderTarget, float fProgress) {
         m_newRect.left = m_oldRect.right = m_pTransitionSettings->WPRect.right * (1.0f - fProgress);
         if (m_bSlideNew)
             m_pNewBrush->SetTransform(D2D1::Matrix3x2F::Translation(m_newRect.left, 0));
-        if (m_slideType != NEW)
+        if (m_bSlideOld)
             m_pOldBrush->SetTransform(D2D1::Matrix3x2F::Translation(m_oldRect.right - m_pTransitionSettings->WPRect.right, 0));
         break;
 
@@ -0,0 +1,158 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/WallpaperDecoder.cpp
+// The nModules Project
+//
+// Decodes wallpapers with WIC.
+//-------------------------------------------------------------------------------------------------
+#include "../Utilities/Common.h"
+#include "WallpaperDecoder.hpp"
+
+#include <algorithm>
+#include <wincodec.h>
+
+// The number of rows to copy between checks for cancellation.
+static const UINT ROWS_PER_SLICE = 64;
+
+
+/// <summary>
+/// Works out the dimensions the wallpaper should be stretched to.
+/// </summary>
+void WallpaperDecoder::GetScaledSize(const WallpaperLoader::Request &request,
+    uint32_t cxWallpaper, uint32_t cyWallpaper, uint32_t *width, uint32_t *height) {
+  double scaleX, scaleY;
+
+  if (request.tile) {
+    *width = cxWallpaper;
+    *height = cyWallpaper;
+    return;
+  }
+
+  switch (request.style) {
+  case 2: // Stretch
+    *width = request.monitorWidth;
+    *height = request.monitorHeight;
+    break;
+
+  case 6: // Fit
+    scaleX = (double)request.monitorWidth / cxWallpaper;
+    scaleY = (double)request.monitorHeight / cyWallpaper;
+    if (scaleX > scaleY) {
+      *height = request.monitorHeight;
+      *width = (UINT)(scaleY*cxWallpaper);
+    } else {
+      *height = (UINT)(scaleX*cyWallpaper);
+      *width = request.monitorWidth;
+    }
+    break;
+
+  case 10: // Fill
+    scaleX = (double)request.monitorWidth / cxWallpaper;
+    scaleY = (double)request.monitorHeight / cyWallpaper;
+    if (scaleX < scaleY) {
+      *height = request.monitorHeight;
+      *width = (UINT)(scaleY*cxWallpaper);
+    } else {
+      *height = (UINT)(scaleX*cyWallpaper);
+      *width = request.monitorWidth;
+    }
+    break;
+
+  case 22: // Span, essentially a fill over the virtual desktop
+    scaleX = (double)request.desktopWidth / cxWallpaper;
+    scaleY = (double)request.desktopHeight / cyWallpaper;
+    if (scaleX < scaleY) {
+      *height = request.desktopHeight;
+      *width = (UINT)(scaleY*cxWallpaper);
+    } else {
+      *height = (UINT)(scaleX*cyWallpaper);
+      *width = request.desktopWidth;
+    }
+    break;
+
+  default: // Center (actually 0), but this way we can fail graciously if the value is invalid
+    *width = cxWallpaper;
+    *height = cyWallpaper;
+    break;
+  }
+
+  *width = std::max(1u, *width);
+  *height = std::max(1u, *height);
+}
+
+
+/// <summary>
+/// Decodes the wallpaper, and scales it as necessary.
+/// </summary>
+bool WallpaperDecoder::Decode(const WallpaperLoader::Request &request,
+    const std::function<bool()> &cancelled, WallpaperLoader::Image *image) {
+  CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+  IWICImagingFactory *factory = nullptr;
+  IWICBitmapDecoder *decoder = nullptr;
+  IWICBitmapFrameDecode *source = nullptr;
+  IWICBitmapScaler *scaler = nullptr;
+  IWICFormatConverter *converter = nullptr;
+  UINT cxWallpaper, cyWallpaper, width, height;
+
+  // The shared factory is created lazily on the UI thread, so use one of our own.
+  HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+    IID_IWICImagingFactory, reinterpret_cast<LPVOID*>(&factory));
+  if (SUCCEEDED(hr)) {
+    hr = factory->CreateDecoderFromFilename(request.path.c_str(), nullptr, GENERIC_READ,
+      WICDecodeMetadataCacheOnDemand, &decoder);
+  }
+  if (SUCCEEDED(hr)) {
+    // Only the first frame is decoded here. Animations are played from the frame count.
+    hr = decoder->GetFrameCount(&image->frameCount);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = decoder->GetFrame(0, &source);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = source->GetSize(&cxWallpaper, &cyWallpaper);
+  }
+  if (SUCCEEDED(hr)) {
+    GetScaledSize(request, cxWallpaper, cyWallpaper, &width, &height);
+    hr = factory->CreateBitmapScaler(&scaler);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = scaler->Initialize(source, width, height, WICBitmapInterpolationModeCubic);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = factory->CreateFormatConverter(&converter);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = converter->Initialize(scaler, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone,
+      nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
+  }
+
+  // WIC decodes and scales lazily, so copying the pixels a slice at a time spreads the work out,
+  // and lets a newer wallpaper cancel this one.
+  if (SUCCEEDED(hr)) {
+    const UINT stride = width * 4;
+    image->pixels.resize(size_t(stride) * height);
+    for (UINT y = 0; y < height && SUCCEEDED(hr); y += ROWS_PER_SLICE) {
+      if (cancelled()) {
+        hr = E_ABORT;
+        break;
+      }
+      WICRect rect = { 0, (INT)y, (INT)width, (INT)std::min(ROWS_PER_SLICE, height - y) };
+      hr = converter->CopyPixels(&rect, stride, stride * rect.Height,
+        image->pixels.data() + size_t(stride) * y);
+    }
+  }
+  if (SUCCEEDED(hr)) {
+    image->width = width;
+    image->height = height;
+  }
+
+  SAFERELEASE(converter);
+  SAFERELEASE(scaler);
+  SAFERELEASE(source);
+  SAFERELEASE(decoder);
+  SAFERELEASE(factory);
+
+  CoUninitialize();
+
+  return SUCCEEDED(hr);
+}
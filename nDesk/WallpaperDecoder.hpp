@@ -0,0 +1,25 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/WallpaperDecoder.hpp
+// The nModules Project
+//
+// Decodes wallpapers with WIC.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "WallpaperLoader.hpp"
+
+/// <summary>
+/// Decodes wallpapers with WIC, and scales them according to the wallpaper style.
+/// </summary>
+class WallpaperDecoder : public WallpaperLoader::IDecoder {
+public:
+  /// <summary>
+  /// Works out the dimensions an image of the given size should be stretched to.
+  /// </summary>
+  static void GetScaledSize(const WallpaperLoader::Request &request, uint32_t cxWallpaper,
+    uint32_t cyWallpaper, uint32_t *width, uint32_t *height);
+
+public:
+  bool Decode(const WallpaperLoader::Request &request, const std::function<bool()> &cancelled,
+    WallpaperLoader::Image *image) override;
+};
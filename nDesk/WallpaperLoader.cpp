@@ -0,0 +1,118 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/WallpaperLoader.cpp
+// The nModules Project
+//
+// Decodes wallpapers on a worker thread.
+//-------------------------------------------------------------------------------------------------
+#include "WallpaperLoader.hpp"
+
+
+WallpaperLoader::Image::Image()
+  : width(0)
+  , height(0)
+  , frameCount(0)
+  , style(0)
+  , tile(false)
+{
+}
+
+
+WallpaperLoader::WallpaperLoader(IDecoder *decoder, std::function<void()> onReady)
+  : mDecoder(decoder)
+  , mOnReady(onReady)
+  , mGeneration(0)
+  , mHasRequest(false)
+  , mHasResult(false)
+  , mDecoding(false)
+  , mStopping(false)
+{
+  mWorker = std::thread(&WallpaperLoader::Run, this);
+}
+
+
+WallpaperLoader::~WallpaperLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopping = true;
+    ++mGeneration;
+  }
+  mWake.notify_one();
+  mWorker.join();
+}
+
+
+void WallpaperLoader::Load(const Request &request) {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mGeneration;
+    mRequest = request;
+    mHasRequest = true;
+    mHasResult = false;
+    mResult = Image();
+  }
+  mWake.notify_one();
+}
+
+
+void WallpaperLoader::Cancel() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  ++mGeneration;
+  mHasRequest = false;
+  mHasResult = false;
+  mResult = Image();
+}
+
+
+bool WallpaperLoader::TakeResult(Image *image) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  if (!mHasResult) {
+    return false;
+  }
+  *image = std::move(mResult);
+  mResult = Image();
+  mHasResult = false;
+  return true;
+}
+
+
+bool WallpaperLoader::IsLoading() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mHasRequest || mDecoding;
+}
+
+
+void WallpaperLoader::Run() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  for (;;) {
+    mWake.wait(lock, [this] () { return mHasRequest || mStopping; });
+    if (mStopping) {
+      return;
+    }
+
+    const Request request = std::move(mRequest);
+    const uint64_t generation = mGeneration;
+    mHasRequest = false;
+    mDecoding = true;
+    lock.unlock();
+
+    Image image;
+    bool success = mDecoder->Decode(request, [this, generation] () {
+      return mGeneration != generation;
+    }, &image);
+    if (!success) {
+      image = Image();
+    }
+    image.style = request.style;
+    image.tile = request.tile;
+
+    lock.lock();
+    mDecoding = false;
+    if (generation == mGeneration) {
+      mResult = std::move(image);
+      mHasResult = true;
+      lock.unlock();
+      mOnReady();
+      lock.lock();
+    }
+  }
+}
@@ -0,0 +1,134 @@
+//-------------------------------------------------------------------------------------------------
+// /nDesk/WallpaperLoader.hpp
+// The nModules Project
+//
+// Decodes wallpapers on a worker thread.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Decodes and scales wallpapers on a worker thread, so that large images don't hold up the
+/// desktop's message loop. Only the latest request matters. Starting a new one cancels the one
+/// being decoded, and its result is never delivered.
+/// </summary>
+class WallpaperLoader {
+public:
+  /// <summary>
+  /// What to load, and the layout it should be scaled for.
+  /// </summary>
+  struct Request {
+    std::wstring path;
+
+    // The WallpaperStyle and TileWallpaper values from the registry.
+    int style;
+    bool tile;
+
+    // The size of the primary monitor and the virtual desktop.
+    uint32_t monitorWidth;
+    uint32_t monitorHeight;
+    uint32_t desktopWidth;
+    uint32_t desktopHeight;
+  };
+
+  /// <summary>
+  /// A decoded wallpaper, scaled for the request, in premultiplied 32bpp BGRA.
+  /// </summary>
+  struct Image {
+    Image();
+
+    // 0 if the wallpaper couldn't be loaded.
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> pixels;
+
+    // The number of frames in the file. More than 1 for animations.
+    uint32_t frameCount;
+
+    int style;
+    bool tile;
+  };
+
+  /// <summary>
+  /// Does the actual decoding.
+  /// </summary>
+  class IDecoder {
+  public:
+    /// <summary>
+    /// Decodes the wallpaper. Called on the worker thread. This should check cancelled every now
+    /// and then, and give up if it returns true.
+    /// </summary>
+    /// <returns>False if the image couldn't be decoded, or if the request was cancelled.</returns>
+    virtual bool Decode(const Request &request, const std::function<bool()> &cancelled,
+      Image *image) = 0;
+  };
+
+public:
+  /// <param name="decoder">Decodes the images. Must outlive the loader.</param>
+  /// <param name="onReady">Called on the worker thread when the result of the latest request is
+  /// ready to be taken.</param>
+  WallpaperLoader(IDecoder *decoder, std::function<void()> onReady);
+  ~WallpaperLoader();
+
+  WallpaperLoader(const WallpaperLoader&) = delete;
+  WallpaperLoader &operator=(const WallpaperLoader&) = delete;
+
+public:
+  /// <summary>
+  /// Starts loading a wallpaper, superseding any earlier request.
+  /// </summary>
+  void Load(const Request &request);
+
+  /// <summary>
+  /// Cancels the current request, if any.
+  /// </summary>
+  void Cancel();
+
+  /// <summary>
+  /// Takes the result of the latest request.
+  /// </summary>
+  /// <returns>False if there is no result, e.g. because the request is still being decoded.
+  /// </returns>
+  bool TakeResult(Image *image);
+
+  /// <summary>
+  /// True if a request hasn't finished decoding yet.
+  /// </summary>
+  bool IsLoading();
+
+private:
+  void Run();
+
+private:
+  IDecoder *mDecoder;
+  std::function<void()> mOnReady;
+
+  std::mutex mMutex;
+  std::condition_variable mWake;
+
+  // Incremented for every request. Anything decoded for an older generation is thrown away. Only
+  // changed with the mutex held, but read without it to check for cancellation.
+  std::atomic<uint64_t> mGeneration;
+
+  // The request waiting for the worker.
+  bool mHasRequest;
+  Request mRequest;
+
+  // The result of the latest request.
+  bool mHasResult;
+  Image mResult;
+
+  // True while the worker is decoding the latest request.
+  bool mDecoding;
+
+  bool mStopping;
+  std::thread mWorker;
+};
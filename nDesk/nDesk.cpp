@@ -21,7 +21,7 @@
 
 
 // The messages we want from the core
-UINT gLSMessages[] = { LM_GETREVID, LM_REFRESH, 0 };
+UINT gLSMessages[] = { LM_GETREVID, LM_REFRESH, LM_FULLSCREENACTIVATED, LM_FULLSCREENDEACTIVATED, 0 };
 
 // Class pointers
 DesktopPainter *g_pDesktopPainter;
@@ -130,6 +130,14 @@ LRESULT WINAPI LSMessageHandler(HWND window, UINT message, WPARAM wParam, LPARAM
         }
         return 0;
 
+    case LM_FULLSCREENACTIVATED:
+        g_pDesktopPainter->OnFullscreenActivated((HMONITOR)wParam);
+        return 0;
+
+    case LM_FULLSCREENDEACTIVATED:
+        g_pDesktopPainter->OnFullscreenDeactivated((HMONITOR)wParam);
+        return 0;
+
     case WM_PAINT:
     case WM_ERASEBKGND:
         return g_pDesktopPainter->HandleMessage(window, message, wParam, lParam);
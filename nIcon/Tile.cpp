@@ -20,11 +20,12 @@
 #include <thread>
 
 
-Tile::Tile(Drawable* parent, PCITEMID_CHILD item, IShellFolder2 *shellFolder, int width, int height, TileSettings &tileSettings, LoadThumbnailResponse &thumbnail)
+Tile::Tile(Drawable* parent, PCITEMID_CHILD item, IShellFolder2 *shellFolder, int width, int height, TileSettings &tileSettings, LoadThumbnailResponse *thumbnail)
     : Drawable(parent, L"Icon")
     , mTileSettings(tileSettings)
     , mMouseOver(false)
     , mGhosted(false)
+    , mHasThumbnail(false)
 {
     WCHAR name[MAX_PATH];
 
@@ -39,7 +40,9 @@ Tile::Tile(Drawable* parent, PCITEMID_CHILD item, IShellFolder2 *shellFolder, in
     mWindow->SetText(name);
     mWindow->Resize((float)width, (float)height);
 
-    SetThumbnail(thumbnail);
+    if (thumbnail) {
+      SetThumbnail(*thumbnail);
+    }
 
     mWindow->Show();
 }
@@ -140,12 +143,33 @@ void Tile::Hide() {
 }
 
 
+void Tile::Show() {
+  mWindow->Show();
+}
+
+
+/// <summary>
+/// Switches this tile over to a different item, dropping everything about the old one.
+/// </summary>
+/// <param name="item">The item ID for the new icon.</param>
+void Tile::SetItem(PCITEMID_CHILD item) {
+  mWindow->ClearOverlays();
+  mHasThumbnail = false;
+  mGhosted = false;
+  mMouseOver = false;
+  mTileSettings.mTileStateRender.ClearState(State::Hover, mWindow);
+  Deselect();
+  Rename(item);
+}
+
+
 /// <summary>
 /// Updates the icon.
 /// </summary>
 /// <param name="repaint">Repaints the icon.</param>
 void Tile::UpdateIcon(bool repaint) {
   mWindow->ClearOverlays();
+  mHasThumbnail = false;
   if (repaint) {
     mWindow->Repaint();
   }
@@ -179,7 +203,9 @@ bool Tile::IsGhosted() {
 /// Enabled ghots mode -- i.e. when the tile is "cut"
 /// </summary>
 void Tile::SetGhost() {
-  mIconOverlay->GetBrush()->SetOpacity(mTileSettings.mGhostOpacity);
+  if (mHasThumbnail) {
+    mIconOverlay->GetBrush()->SetOpacity(mTileSettings.mGhostOpacity);
+  }
   mGhosted = true;
 }
 
@@ -188,7 +214,9 @@ void Tile::SetGhost() {
 /// Enabled ghots mode -- i.e. when the tile is "cut"
 /// </summary>
 void Tile::ClearGhost() {
-  mIconOverlay->GetBrush()->SetOpacity(1.0f);
+  if (mHasThumbnail) {
+    mIconOverlay->GetBrush()->SetOpacity(1.0f);
+  }
   mGhosted = false;
 }
 
@@ -218,9 +246,17 @@ void Tile::SetThumbnail(LoadThumbnailResponse &thumbnail) {
     mIconOverlay = mWindow->AddOverlay(pos, thumbnail.thumbnail.bitmap);
   } else if (thumbnail.type == LoadThumbnailResponse::Type::HICON) {
     mIconOverlay = mWindow->AddOverlay(pos, thumbnail.thumbnail.icon);
+  } else if (thumbnail.type == LoadThumbnailResponse::Type::WICBitmap) {
+    // The overlay keeps its own reference, the loader releases the response's.
+    thumbnail.thumbnail.wicBitmap->AddRef();
+    mIconOverlay = mWindow->AddOverlay(pos, thumbnail.thumbnail.wicBitmap);
   } else {
     ASSERT(false);
   }
+  mHasThumbnail = true;
+  if (mGhosted) {
+    mIconOverlay->GetBrush()->SetOpacity(mTileSettings.mGhostOpacity);
+  }
   mWindow->Repaint();
 }
 
@@ -25,7 +25,8 @@ public:
   };
 
 public:
-  Tile(Drawable *parent, PCITEMID_CHILD item, IShellFolder2 *shellFolder, int width, int height, class TileSettings&, LoadThumbnailResponse &thumbnail);
+  // Pass a null thumbnail if it is still being loaded, and call SetThumbnail once it is.
+  Tile(Drawable *parent, PCITEMID_CHILD item, IShellFolder2 *shellFolder, int width, int height, class TileSettings&, LoadThumbnailResponse *thumbnail);
   ~Tile();
 
 private:
@@ -48,12 +49,21 @@ public:
   // Hides this icon.
   void Hide();
 
+  // Shows this icon.
+  void Show();
+
+  // Makes this tile show a different item, so that it can be reused.
+  void SetItem(PCITEMID_CHILD item);
+
   // Renames this item.
   void Rename(PCITEMID_CHILD newItem);
 
   // Updates the icon.
   void UpdateIcon(bool repaint = true);
 
+  // Shows the thumbnail, once it has been loaded.
+  void SetThumbnail(LoadThumbnailResponse &thumbnail);
+
   // Shows the right-click menu for the icon.
   void ShowContextMenu();
 
@@ -79,7 +89,8 @@ private:
   // The PID of this icon.
   PITEMID_CHILD mItem;
 
-  void SetThumbnail(LoadThumbnailResponse &thumbnail);
+  // True once the thumbnail has been set.
+  bool mHasThumbnail;
 
   //
   int mPositionID;
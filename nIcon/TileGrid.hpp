@@ -0,0 +1,149 @@
+//-------------------------------------------------------------------------------------------------
+// /nIcon/TileGrid.hpp
+// The nModules Project
+//
+// Finds the tiles which overlap a rectangle, without looking at every tile.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// A spatial index of tiles. A grid is laid over the group, and every tile is listed under the
+/// cells it overlaps. With cells the size of a tile plus the spacing, a tile is in at most 4 of
+/// them, and finding the tiles in a rectangle only looks at the cells it covers. Tiles may be laid
+/// out above or left of the origin.
+///
+/// Rectangles include their left and top edges, but not their right and bottom ones. Values are
+/// compared with ==, and each one should only be added once.
+/// </summary>
+template <typename Value>
+class TileGrid {
+public:
+  struct Rect {
+    int left;
+    int top;
+    int right;
+    int bottom;
+  };
+
+public:
+  TileGrid() : mCellWidth(1), mCellHeight(1) {}
+
+public:
+  /// <summary>
+  /// Removes everything, and changes the size of the cells.
+  /// </summary>
+  void Reset(int cellWidth, int cellHeight) {
+    mCells.clear();
+    mCellWidth = std::max(1, cellWidth);
+    mCellHeight = std::max(1, cellHeight);
+  }
+
+  void Insert(const Value &value, const Rect &rect) {
+    ForEachCell(rect, [this, &value, &rect] (uint64_t cell) {
+      Entry entry = { value, rect };
+      mCells[cell].push_back(entry);
+    });
+  }
+
+  /// <summary>
+  /// Removes a value, which must have been added with the given rectangle.
+  /// </summary>
+  void Remove(const Value &value, const Rect &rect) {
+    ForEachCell(rect, [this, &value] (uint64_t cell) {
+      auto bucket = mCells.find(cell);
+      if (bucket != mCells.end()) {
+        std::vector<Entry> &entries = bucket->second;
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [&value] (const Entry &entry) {
+          return entry.value == value;
+        }), entries.end());
+        if (entries.empty()) {
+          mCells.erase(bucket);
+        }
+      }
+    });
+  }
+
+  void Move(const Value &value, const Rect &from, const Rect &to) {
+    Remove(value, from);
+    Insert(value, to);
+  }
+
+  /// <summary>
+  /// Calls the function once for every value whose rectangle overlaps the area by at least a
+  /// pixel. Tiles which only touch the area along an edge don't.
+  /// </summary>
+  template <typename Function>
+  void FindInRect(const Rect &area, Function function) const {
+    ForEachCell(area, [this, &area, &function] (uint64_t cell) {
+      auto bucket = mCells.find(cell);
+      if (bucket == mCells.end()) {
+        return;
+      }
+      for (const Entry &entry : bucket->second) {
+        // A tile which is in several of the cells is only reported from the first of them, i.e.
+        // the one with its, or the area's, top left corner.
+        const Rect &rect = entry.rect;
+        if (rect.left < area.right && area.left < rect.right && rect.top < area.bottom
+            && area.top < rect.bottom
+            && cell == CellAt(std::max(rect.left, area.left), std::max(rect.top, area.top))) {
+          function(entry.value);
+        }
+      }
+    });
+  }
+
+  size_t GetCellCount() const {
+    return mCells.size();
+  }
+
+private:
+  struct Entry {
+    Value value;
+    Rect rect;
+  };
+
+private:
+  /// <summary>
+  /// Rounds towards negative infinity.
+  /// </summary>
+  static int FloorDiv(int value, int divisor) {
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+  }
+
+  static uint64_t CellKey(int x, int y) {
+    return uint64_t(uint32_t(x)) << 32 | uint32_t(y);
+  }
+
+  uint64_t CellAt(int x, int y) const {
+    return CellKey(FloorDiv(x, mCellWidth), FloorDiv(y, mCellHeight));
+  }
+
+  /// <summary>
+  /// Calls the function for every cell which overlaps the area.
+  /// </summary>
+  template <typename Function>
+  void ForEachCell(const Rect &area, Function function) const {
+    if (area.right <= area.left || area.bottom <= area.top) {
+      return;
+    }
+    int right = FloorDiv(area.right - 1, mCellWidth);
+    int bottom = FloorDiv(area.bottom - 1, mCellHeight);
+    for (int x = FloorDiv(area.left, mCellWidth); x <= right; ++x) {
+      for (int y = FloorDiv(area.top, mCellHeight); y <= bottom; ++y) {
+        function(CellKey(x, y));
+      }
+    }
+  }
+
+private:
+  int mCellWidth;
+  int mCellHeight;
+
+  // The values whose rectangles overlap each cell, by cell.
+  std::unordered_map<uint64_t, std::vector<Entry>> mCells;
+};
@@ -12,9 +12,11 @@
 #include "../nShared/LSModule.hpp"
 
 #include "../Utilities/DoubleNullStringList.hpp"
+#include "../Utilities/Math.h"
 
 #include <algorithm>
 #include <functional>
+#include <math.h>
 #include <shellapi.h>
 #include <Shlwapi.h>
 #include <strsafe.h>
@@ -25,6 +27,9 @@
         | SHCNE_RMDIR | SHCNE_RENAMEITEM | SHCNE_RENAMEFOLDER | SHCNE_UPDATEITEM \
         | SHCNE_UPDATEDIR | SHCNE_UPDATEIMAGE | SHCNE_ASSOCCHANGED
 
+// The number of tiles kept around for reuse, once their items have gone out of view.
+static const size_t MAX_SPARE_TILES = 32;
+
 static const WindowSettings sWindowDefaults([] (WindowSettings &defaults) {
   defaults.width = 500;
   defaults.height = 300;
@@ -58,9 +63,15 @@ TileGroup::TileGroup(LPCTSTR prefix)
   , mClipBoardCutFiles(false)
   , mInRectangleSelection(false)
   , mNextPositionID(0)
+  , mPendingItems(0)
+  , mFolderRequest(0)
+  , mFolderThumbnailCount(0)
+  , mChangeTimer(0)
   , mRootFolder(nullptr)
+  , mTiles(MAX_SPARE_TILES)
 {
   LoadSettings();
+  RebuildGrid();
 
   WindowSettings windowSettings;
   windowSettings.Load(mSettings, &sWindowDefaults);
@@ -102,8 +113,20 @@ TileGroup::~TileGroup() {
     mWindow->ReleaseUserMessage(mIconLoadedMessage);
   }
 
-  for (auto tile : mTiles) {
-    delete tile;
+  if (mChangeTimer != 0) {
+    mWindow->ClearCallbackTimer(mChangeTimer);
+  }
+
+  if (mFolderRequest != 0) {
+    nCore::CancelLoad(mFolderRequest);
+  }
+  for (auto &request : mThumbnailRequests) {
+    nCore::CancelLoad(request.first);
+  }
+
+  for (Item &item : mItems) {
+    mTiles.Destroy(item);
+    ILFree(item.id);
   }
 
   SAFERELEASE(mWorkingFolder);
@@ -127,6 +150,9 @@ void TileGroup::LoadSettings() {
   mTileWidth = tileSettings->GetInt(L"Width", iconSize + 20);
   delete tileSettings;
 
+  mTileMargin = mSettings->GetInt(L"OffscreenMargin", std::max(mTileWidth, mTileHeight));
+  mChangeDelay = UINT(std::max(0, mSettings->GetInt(L"ChangeNotificationDelay", 100)));
+
   mLayoutSettings.Load(mSettings, &sLayoutDefaults);
 
   if (!mSettings->GetBool(L"DontHideDesktopSystemIcons", false)) {
@@ -204,7 +230,14 @@ void TileGroup::SetFolder(LPWSTR folder) {
   request.blackList = mHiddenItems;
   request.folder = mWorkingFolder;
   request.targetIconWidth = mTileSettings.mIconSize;
-  nCore::LoadFolder(request, this);
+  request.priority = LoadPriority::Visible;
+  request.visibleCount = (UINT)mLayoutSettings.ItemLimit(mTileWidth, mTileHeight,
+    int(mWindow->GetSize().width + 0.5f), int(mWindow->GetSize().height + 0.5f));
+  // Items further out get their thumbnails if and when they come into view.
+  request.thumbnailCount = GetNearbyPositionCount();
+  mFolderThumbnailCount = request.thumbnailCount;
+  mLoadingItems.clear();
+  mFolderRequest = nCore::LoadFolder(request, this);
 
   // Register for change notifications
   SHChangeNotifyEntry watchEntries[] = { idList, FALSE };
@@ -221,32 +254,318 @@ void TileGroup::SetFolder(LPWSTR folder) {
 }
 
 
+/// <summary>
+/// Lays out the items of the folder as soon as they are found. Their thumbnails follow later.
+/// </summary>
+LPARAM TileGroup::FolderItemsFound(UINT64 id, LoadFolderItemsResponse *response) {
+  if (id != mFolderRequest) {
+    return 0;
+  }
+
+  Window::UpdateLock lock(mWindow);
+  for (size_t i = 0; i < response->items.size(); ++i) {
+    UINT index = response->first + UINT(i);
+    bool loadingFromFolder = index < mFolderThumbnailCount;
+    Item *item = AddItem(response->items[i], response->names[i].c_str(), nullptr,
+      loadingFromFolder);
+    if (item && loadingFromFolder) {
+      item->folderIndex = index;
+      mLoadingItems[index] = item;
+    }
+  }
+  return 0;
+}
+
+
+/// <summary>
+/// Shows thumbnails for items added by FolderItemsFound.
+/// </summary>
 LPARAM TileGroup::FolderLoaded(UINT64 id, LoadFolderResponse *response) {
+  if (id != mFolderRequest) {
+    return 0;
+  }
+
   Window::UpdateLock lock(mWindow);
-  for (auto item : response->items) {
-    ItemLoaded(id, &item);
+  for (LoadItemResponse &loaded : response->items) {
+    auto loading = mLoadingItems.find(loaded.index);
+    if (loading != mLoadingItems.end()) {
+      Item *item = loading->second;
+      item->loadingFromFolder = false;
+      if (item->tile) {
+        item->tile->SetThumbnail(loaded.thumbnail);
+      }
+      mLoadingItems.erase(loading);
+    }
+  }
+  if (response->complete) {
+    // Whatever the folder request didn't get to has to be loaded separately.
+    for (auto &loading : mLoadingItems) {
+      Item *item = loading.second;
+      item->loadingFromFolder = false;
+      if (item->tile) {
+        RequestThumbnail(*item);
+      }
+    }
+    mLoadingItems.clear();
+    mFolderRequest = 0;
   }
   return 0;
 }
 
 
-LPARAM TileGroup::ItemLoaded(UINT64 id, LoadItemResponse *item) {
-  int iconPosition = GetIconPosition(item->id);
-  RECT pos = mLayoutSettings.RectFromID(iconPosition, mTileWidth, mTileHeight, int(mWindow->GetSize().width + 0.5f), int(mWindow->GetSize().height + 0.5f));
-  Tile *icon = new Tile(this, item->id, mWorkingFolder, mTileWidth, mTileHeight, mTileSettings, item->thumbnail);
-  icon->SetPosition(iconPosition, (int)pos.left, (int)pos.top);
-  mTiles.push_back(icon);
+/// <summary>
+/// Handles both items added by AddIcon, and thumbnails requested by RequestThumbnail.
+/// </summary>
+LPARAM TileGroup::ItemLoaded(UINT64 id, LoadItemResponse *loaded) {
+  auto request = mThumbnailRequests.find(id);
+  if (request != mThumbnailRequests.end()) {
+    Item *item = request->second;
+    mThumbnailRequests.erase(request);
+    item->thumbnailRequest = 0;
+    if (item->tile) {
+      item->tile->SetThumbnail(loaded->thumbnail);
+    }
+    return 0;
+  }
 
+  if (mPendingItems > 0) {
+    --mPendingItems;
+  }
+  // The item may have been added while it was loading, by the folder request or by another change
+  // notification, in which case AddItem leaves it alone.
+  AddItem(loaded->id, nullptr, &loaded->thumbnail, false);
   return 0;
 }
 
 
+/// <summary>
+/// Adds an item in the first free spot, and creates a tile for it if it is near the visible area.
+/// </summary>
+/// <param name="name">The parsing name of the item, or nullptr to look it up.</param>
+/// <param name="thumbnail">The thumbnail, or nullptr if it hasn't been loaded.</param>
+/// <param name="loadingFromFolder">True if the folder request will deliver the thumbnail.</param>
+/// <returns>The new item, or nullptr if there already is an item by that name.</returns>
+TileGroup::Item *TileGroup::AddItem(PCITEMID_CHILD id, LPCWSTR name,
+    LoadThumbnailResponse *thumbnail, bool loadingFromFolder) {
+  WCHAR buffer[MAX_PATH];
+  if (!name) {
+    name = SUCCEEDED(GetDisplayNameOf(id, SHGDN_FORPARSING, buffer, _countof(buffer)))
+      ? buffer : L"";
+  }
+  if (*name != L'\0' && mItemsByName.find(name) != mItemsByName.end()) {
+    return nullptr;
+  }
+
+  mItems.emplace_back();
+  Item &item = mItems.back();
+  item.id = ILClone(id);
+  item.name = name;
+  item.positionID = GetIconPosition(id);
+  item.folderIndex = 0;
+  item.loadingFromFolder = loadingFromFolder;
+  item.thumbnailRequest = 0;
+
+  if (!item.name.empty()) {
+    mItemsByName[item.name] = std::prev(mItems.end());
+  }
+  AddToGrid(item);
+
+  if (IsInArea(item.positionID, mTileMargin)) {
+    Materialize(item, thumbnail);
+  }
+  return &item;
+}
+
+
+/// <summary>
+/// Retrieves where the tile with the given position ID goes, in the current window size.
+/// </summary>
+RECT TileGroup::GetTileRect(int positionID) {
+  return mLayoutSettings.RectFromID(positionID, mTileWidth, mTileHeight,
+    int(mWindow->GetSize().width + 0.5f), int(mWindow->GetSize().height + 0.5f));
+}
+
+
+/// <summary>
+/// Checks if the tile with the given position ID is within margin pixels of the window.
+/// </summary>
+bool TileGroup::IsInArea(int positionID, int margin) {
+  RECT tile = GetTileRect(positionID);
+  RECT area = {
+    -margin,
+    -margin,
+    int(mWindow->GetSize().width + 0.5f) + margin,
+    int(mWindow->GetSize().height + 0.5f) + margin
+  };
+  RECT intersection;
+  return IntersectRect(&intersection, &tile, &area) != FALSE;
+}
+
+
+/// <summary>
+/// Counts the positions, from the first one, which are near enough to the window to get tiles.
+/// </summary>
+UINT TileGroup::GetNearbyPositionCount() {
+  int count = 0;
+  while (IsInArea(count, mTileMargin)) {
+    ++count;
+  }
+  return UINT(count);
+}
+
+
+/// <summary>
+/// Gives an item a tile, reusing a spare one if there is one.
+/// </summary>
+/// <param name="thumbnail">The thumbnail, or nullptr if it has to be loaded.</param>
+void TileGroup::Materialize(Item &item, LoadThumbnailResponse *thumbnail) {
+  mTiles.Materialize(item, [this, &item, thumbnail] () {
+    return new Tile(this, item.id, mWorkingFolder, mTileWidth, mTileHeight, mTileSettings,
+      thumbnail);
+  }, [&item, thumbnail] (Tile *tile) {
+    tile->SetItem(item.id);
+    if (thumbnail) {
+      tile->SetThumbnail(*thumbnail);
+    }
+  });
+
+  RECT pos = GetTileRect(item.positionID);
+  item.tile->SetPosition(item.positionID, (int)pos.left, (int)pos.top);
+
+  if (!thumbnail && !item.loadingFromFolder) {
+    RequestThumbnail(item);
+  }
+}
+
+
+/// <summary>
+/// Takes the tile away from an item which has gone out of view.
+/// </summary>
+void TileGroup::Dematerialize(Item &item) {
+  CancelThumbnail(item);
+  mTiles.Dematerialize(item);
+}
+
+
+/// <summary>
+/// Loads the thumbnail of an item which has a tile, but no thumbnail.
+/// </summary>
+void TileGroup::RequestThumbnail(Item &item) {
+  CancelThumbnail(item);
+
+  LoadItemRequest request;
+  request.folder = mWorkingFolder;
+  request.targetIconWidth = mTileSettings.mIconSize;
+  request.id = ILClone(item.id);
+  request.priority = IsInArea(item.positionID, 0) ? LoadPriority::Visible : LoadPriority::Offscreen;
+  item.thumbnailRequest = nCore::LoadFolderItem(request, this);
+  mThumbnailRequests[item.thumbnailRequest] = &item;
+}
+
+
+/// <summary>
+/// Stops loading the thumbnail of an item, if it is being loaded by RequestThumbnail.
+/// </summary>
+void TileGroup::CancelThumbnail(Item &item) {
+  if (item.thumbnailRequest != 0) {
+    nCore::CancelLoad(item.thumbnailRequest);
+    mThumbnailRequests.erase(item.thumbnailRequest);
+    item.thumbnailRequest = 0;
+  }
+}
+
+
+/// <summary>
+/// Moves the tiles to where they go in the current window size, taking them from items which went
+/// out of view, and giving them to items which came into view.
+/// </summary>
+void TileGroup::UpdateVisibleTiles() {
+  Window::UpdateLock lock(mWindow);
+  RebuildGrid();
+
+  // Free up tiles first, so that they can be reused below.
+  for (Item &item : mItems) {
+    if (item.tile && !IsInArea(item.positionID, mTileMargin)) {
+      Dematerialize(item);
+    }
+  }
+
+  for (Item &item : mItems) {
+    if (item.tile) {
+      RECT pos = GetTileRect(item.positionID);
+      item.tile->SetPosition(item.positionID, (int)pos.left, (int)pos.top);
+    } else if (IsInArea(item.positionID, mTileMargin)) {
+      Materialize(item, nullptr);
+    }
+  }
+}
+
+
+bool TileGroup::IsSelected(const Item &item) const {
+  return mTiles.IsSelected(item);
+}
+
+
+void TileGroup::SetSelected(Item &item, bool selected) {
+  mTiles.SetSelected(item, selected);
+}
+
+
+/// <summary>
+/// Converts a tile's rectangle to the grid's.
+/// </summary>
+TileGroup::Grid::Rect TileGroup::ToGridRect(const RECT &rect) {
+  Grid::Rect gridRect = { int(rect.left), int(rect.top), int(rect.right),
+    int(rect.bottom) };
+  return gridRect;
+}
+
+
+void TileGroup::AddToGrid(Item &item) {
+  mGrid.Insert(&item, ToGridRect(GetTileRect(item.positionID)));
+}
+
+
+void TileGroup::RemoveFromGrid(Item &item) {
+  mGrid.Remove(&item, ToGridRect(GetTileRect(item.positionID)));
+}
+
+
+/// <summary>
+/// Puts every item back in the grid, after the window has been resized and the tiles have moved.
+/// The cells are the size of a tile plus the spacing.
+/// </summary>
+void TileGroup::RebuildGrid() {
+  mGrid.Reset(mTileWidth + mLayoutSettings.mColumnSpacing,
+    mTileHeight + mLayoutSettings.mRowSpacing);
+  for (Item &item : mItems) {
+    AddToGrid(item);
+  }
+}
+
+
+/// <summary>
+/// Finds the items whose tiles are touched by the rectangle.
+/// </summary>
+void TileGroup::FindItemsInRect(D2D1_RECT_F rect, std::unordered_set<Item*> *items) {
+  // Tiles are on whole pixels, so rounding the rectangle outwards doesn't touch any more of them.
+  RECT area = { LONG(floorf(rect.left)), LONG(floorf(rect.top)), LONG(ceilf(rect.right)),
+    LONG(ceilf(rect.bottom)) };
+  if (rect.right <= rect.left || rect.bottom <= rect.top) {
+    return;
+  }
+  mGrid.FindInRect(ToGridRect(area), [items] (Item *item) {
+    items->insert(item);
+  });
+}
+
+
 /// <summary>
 /// Add's the icon with the specified ID to the view
 /// </summary>
 void TileGroup::AddIcon(PCITEMID_CHILD pidl) {
   // Don't add existing icons
-  if (FindIcon(pidl) != nullptr) return;
+  if (FindItem(pidl) != mItems.end()) return;
 
   // Check if the icon should be supressed
   WCHAR buffer[MAX_PATH];
@@ -257,44 +576,79 @@ void TileGroup::AddIcon(PCITEMID_CHILD pidl) {
   request.folder = mWorkingFolder;
   request.targetIconWidth = mTileSettings.mIconSize;
   request.id = ILClone(pidl);
+  request.priority = GetLoadPriority();
   nCore::LoadFolderItem(request, this);
+  ++mPendingItems;
 }
 
 
 /// <summary>
-///
+/// Removes an item, and frees up its spot.
 /// </summary>
-void TileGroup::RemoveIcon(PCITEMID_CHILD pidl) {
-  mTiles.remove_if([pidl, this] (Tile *tile) -> bool {
-    if (tile->CompareID(pidl) == 0) {
-      mEmptySpots.insert(tile->GetPositionID());
-      delete tile;
-      return true;
-    }
-    return false;
-  });
-  mWindow->Repaint();
+void TileGroup::RemoveItem(std::list<Item>::iterator item) {
+  mEmptySpots.insert(item->positionID);
+  if (item->loadingFromFolder) {
+    mLoadingItems.erase(item->folderIndex);
+  }
+  if (item->tile) {
+    Dematerialize(*item);
+  }
+  if (!item->name.empty()) {
+    mItemsByName.erase(item->name);
+  }
+  RemoveFromGrid(*item);
+  mRectangleSelection.erase(&*item);
+  ILFree(item->id);
+  mItems.erase(item);
 }
 
 
 /// <summary>
-///
+/// Reloads the thumbnail of an item which has changed.
 /// </summary>
-void TileGroup::UpdateIcon(PCITEMID_CHILD pidl) {
-  auto icon = FindIcon(pidl);
-  if (icon != nullptr) {
-    icon->UpdateIcon();
+/// <param name="id">The current ID of the item, which may hold new information about it.</param>
+void TileGroup::UpdateItem(Item &item, PCITEMID_CHILD id) {
+  ILFree(item.id);
+  item.id = ILClone(id);
+  if (item.tile) {
+    item.tile->Rename(item.id);
+    if (!item.loadingFromFolder) {
+      item.tile->UpdateIcon();
+      RequestThumbnail(item);
+    }
   }
 }
 
 
 /// <summary>
-///
+/// Gives items new names. Every item is taken off its old name before any of them get their new
+/// ones, since items may have swapped names.
 /// </summary>
-void TileGroup::RenameIcon(PCITEMID_CHILD oldID, PCITEMID_CHILD newID) {
-  auto icon = FindIcon(oldID);
-  if (icon != nullptr) {
-    icon->Rename(newID);
+void TileGroup::RenameItems(const std::vector<ChangeQueue::NameChange> &renames) {
+  std::vector<std::pair<std::list<Item>::iterator, const ChangeQueue::NameChange*>> moved;
+  for (const ChangeQueue::NameChange &rename : renames) {
+    auto item = mItemsByName.find(rename.from);
+    if (item != mItemsByName.end()) {
+      moved.emplace_back(item->second, &rename);
+      mItemsByName.erase(item);
+    }
+  }
+
+  for (auto &move : moved) {
+    // An item which is renamed over another one replaces it.
+    auto existing = mItemsByName.find(move.second->to);
+    if (existing != mItemsByName.end()) {
+      RemoveItem(existing->second);
+    }
+
+    Item &item = *move.first;
+    ILFree(item.id);
+    item.id = ILClone(move.second->value.get());
+    item.name = move.second->to;
+    mItemsByName[item.name] = move.first;
+    if (item.tile) {
+      item.tile->Rename(item.id);
+    }
   }
 }
 
@@ -313,24 +667,52 @@ int TileGroup::GetIconPosition(PCITEMID_CHILD /* pidl */) {
 
 
 /// <summary>
-///
+/// Decides how soon the next icon passed to AddIcon should be loaded. Icons take the free spots in
+/// the order they finish loading, so this guesses where it will end up, behind every icon which is
+/// still loading, and only hurries if that is on screen.
 /// </summary>
-Tile *TileGroup::FindIcon(PCITEMID_CHILD pidl) const {
-  for (auto tile : mTiles) {
-    if (tile->CompareID(pidl) == 0) {
-      return tile;
+LoadPriority TileGroup::GetLoadPriority() {
+  int position;
+  if (size_t(mPendingItems) < mEmptySpots.size()) {
+    position = *std::next(mEmptySpots.begin(), mPendingItems);
+  } else {
+    position = mNextPositionID + mPendingItems - int(mEmptySpots.size());
+  }
+
+  return IsInArea(position, 0) ? LoadPriority::Visible : LoadPriority::Offscreen;
+}
+
+
+/// <summary>
+/// Finds an item by its parsing name. Only if the name can't be retrieved, the items are compared
+/// one by one.
+/// </summary>
+/// <returns>The item, or mItems.end() if it isn't in the group.</returns>
+std::list<TileGroup::Item>::iterator TileGroup::FindItem(PCITEMID_CHILD pidl) {
+  WCHAR buffer[MAX_PATH];
+  if (SUCCEEDED(GetDisplayNameOf(pidl, SHGDN_FORPARSING, buffer, _countof(buffer)))) {
+    auto item = mItemsByName.find(buffer);
+    return item != mItemsByName.end() ? item->second : mItems.end();
+  }
+
+  for (auto item = mItems.begin(); item != mItems.end(); ++item) {
+    if (mWorkingFolder->CompareIDs(0, item->id, pidl) == 0) {
+      return item;
     }
   }
-  return nullptr;
+  return mItems.end();
 }
 
 
 /// <summary>
-/// Updates all icons.
+/// Updates all icons. Items without tiles will load theirs when they get one.
 /// </summary>
 void TileGroup::UpdateAllIcons() {
-  for (auto icon : mTiles) {
-    icon->UpdateIcon(false);
+  for (Item &item : mItems) {
+    if (item.tile && !item.loadingFromFolder) {
+      item.tile->UpdateIcon(false);
+      RequestThumbnail(item);
+    }
   }
   mWindow->Repaint();
 }
@@ -343,7 +725,7 @@ HRESULT TileGroup::GetDisplayNameOf(PCITEMID_CHILD pidl, SHGDNF flags, LPWSTR bu
   STRRET ret;
   HRESULT hr;
 
-  hr = mRootFolder->GetDisplayNameOf(pidl, flags, &ret);
+  hr = mWorkingFolder->GetDisplayNameOf(pidl, flags, &ret);
 
   if (SUCCEEDED(hr)) {
     hr = StrRetToBufW(&ret, pidl, buf, cchBuf);
@@ -384,8 +766,8 @@ HRESULT TileGroup::GetFolderPath(LPWSTR buf, UINT cchBuf) const {
 /// Deselects all items.
 /// </summary>
 void TileGroup::DeselectAll() {
-  for (Tile *tile : mTiles) {
-    tile->Deselect();
+  for (Item &item : mItems) {
+    SetSelected(item, false);
   }
   mWindow->Repaint();
 }
@@ -395,8 +777,8 @@ void TileGroup::DeselectAll() {
 /// Deselects all items.
 /// </summary>
 void TileGroup::SelectAll() {
-  for (Tile *tile : mTiles) {
-    tile->Select();
+  for (Item &item : mItems) {
+    SetSelected(item, true);
   }
   mWindow->Repaint();
 }
@@ -411,9 +793,9 @@ void TileGroup::ContextMenu() {
   std::vector<LPCITEMIDLIST> items;
   HRESULT hr;
 
-  for (Tile *tile : mTiles) {
-    if (tile->IsSelected()) {
-      items.push_back(tile->GetItem());
+  for (const Item &item : mItems) {
+    if (IsSelected(item)) {
+      items.push_back(item.id);
     }
   }
 
@@ -531,11 +913,15 @@ void TileGroup::DoCopy(bool cut) {
 
   ClearAllGhosting(!cut);
 
-  for (Tile *tile : mTiles) {
-    if (tile->IsSelected()) {
-      tile->GetDisplayName(SHGDN_FORPARSING, buffer, _countof(buffer));
+  for (Item &item : mItems) {
+    if (IsSelected(item)) {
+      GetDisplayNameOf(item.id, SHGDN_FORPARSING, buffer, _countof(buffer));
       if (cut) {
-        tile->SetGhost();
+        if (item.tile) {
+          item.tile->SetGhost();
+        } else {
+          item.ghosted = true;
+        }
       }
       files.Push(buffer);
     }
@@ -578,9 +964,9 @@ void TileGroup::DeleteSelectedFiles() {
   // Generate a double-null terminated list of files to copy.
   DoubleNullStringList files;
   WCHAR buffer[MAX_PATH];
-  for (Tile *tile : mTiles) {
-    if (tile->IsSelected()) {
-      tile->GetDisplayName(SHGDN_FORPARSING, buffer, _countof(buffer));
+  for (const Item &item : mItems) {
+    if (IsSelected(item)) {
+      GetDisplayNameOf(item.id, SHGDN_FORPARSING, buffer, _countof(buffer));
       files.Push(buffer);
     }
   }
@@ -601,10 +987,10 @@ void TileGroup::DeleteSelectedFiles() {
 /// Opens the selected files.
 /// </summary>
 void TileGroup::OpenSelectedFiles() {
-  for (Tile *tile : mTiles) {
-    if (tile->IsSelected()) {
+  for (const Item &item : mItems) {
+    if (IsSelected(item)) {
       WCHAR command[MAX_LINE_LENGTH];
-      tile->GetDisplayName(SHGDN_FORPARSING, command, MAX_LINE_LENGTH);
+      GetDisplayNameOf(item.id, SHGDN_FORPARSING, command, MAX_LINE_LENGTH);
       ShellExecuteW(nullptr, nullptr, command, nullptr, nullptr, SW_SHOW);
     }
   }
@@ -624,10 +1010,11 @@ void TileGroup::RenameSelectedFiles() {
 void TileGroup::ClearAllGhosting(bool repaint) {
   if (mClipBoardCutFiles) {
     mClipBoardCutFiles = false;
-    for (Tile *tile : mTiles) {
-      if (tile->IsGhosted()) {
-        tile->ClearGhost();
+    for (Item &item : mItems) {
+      if (item.tile && item.tile->IsGhosted()) {
+        item.tile->ClearGhost();
       }
+      item.ghosted = false;
     }
     if (repaint) {
       mWindow->Repaint();
@@ -640,6 +1027,9 @@ void TileGroup::ClearAllGhosting(bool repaint) {
 ///
 /// </summary>
 void TileGroup::StartRectangleSelection(D2D1_POINT_2U point) {
+  // From here on, only the items which enter or leave the rectangle have to be updated.
+  DeselectAll();
+  mRectangleSelection.clear();
   mRectangleStart = point;
   mInRectangleSelection = true;
   mWindow->DisableMouseForwarding();
@@ -663,13 +1053,8 @@ void TileGroup::EndRectangleSelection(D2D1_POINT_2U point) {
     float(std::max(mRectangleStart.y, point.y))
   );
 
-  for (Tile *tile : mTiles) {
-    if (tile->IsInRect(rect)) {
-      tile->Select();
-    } else {
-      tile->Deselect();
-    }
-  }
+  SelectInRect(rect);
+  mRectangleSelection.clear();
 
   mWindow->EnableMouseForwarding();
   mWindow->Repaint(&rect);
@@ -691,19 +1076,32 @@ void TileGroup::MoveRectangleSelection(D2D1_POINT_2U point) {
 
   mSelectionRectagle.SetRect(rect);
 
-  for (Tile *tile : mTiles) {
-    if (tile->IsInRect(rect)) {
-      tile->Select();
-    } else {
-      tile->Deselect();
-    }
-  }
+  SelectInRect(rect);
 
   mSelectionRectagle.Show();
   mWindow->Repaint(&rect);
 }
 
 
+/// <summary>
+/// Selects the items which are touched by the rectangle, and deselects the ones which were touched
+/// by it before, but no longer are.
+/// </summary>
+void TileGroup::SelectInRect(D2D1_RECT_F rect) {
+  std::unordered_set<Item*> inRect;
+  FindItemsInRect(rect, &inRect);
+  for (Item *item : mRectangleSelection) {
+    if (inRect.count(item) == 0) {
+      SetSelected(*item, false);
+    }
+  }
+  for (Item *item : inRect) {
+    SetSelected(*item, true);
+  }
+  mRectangleSelection.swap(inRect);
+}
+
+
 /// <summary>
 /// Handles changes to the clipboard.
 /// </summary>
@@ -735,7 +1133,18 @@ UINT TileGroup::GetIconLoadedMessage() const {
 
 
 /// <summary>
-/// Handles change notifications for the current folder.
+/// Makes a reference counted copy of an item ID.
+/// </summary>
+static TileGroup::SharedItemID ShareItemID(PCITEMID_CHILD id) {
+  return TileGroup::SharedItemID(ILClone(id), [] (ITEMIDLIST *copy) {
+    ILFree(copy);
+  });
+}
+
+
+/// <summary>
+/// Handles change notifications for the current folder. Changes to items are queued up, and
+/// applied together once no more have come in for a little while.
 /// </summary>
 LRESULT TileGroup::HandleChangeNotify(HANDLE changeHandle, DWORD processId) {
   long event;
@@ -743,26 +1152,42 @@ LRESULT TileGroup::HandleChangeNotify(HANDLE changeHandle, DWORD processId) {
   HANDLE notifyLock = SHChangeNotification_Lock(changeHandle, processId, &idList, &event);
 
   if (notifyLock) {
+    PCITEMID_CHILD item = ILFindLastID(idList[0]);
+    WCHAR name[MAX_PATH], newName[MAX_PATH];
+
+    // Items are queued up by name, and items whose names can't be retrieved can't be in the group.
     switch (event) {
     case SHCNE_ATTRIBUTES:
     case SHCNE_UPDATEITEM:
     case SHCNE_UPDATEDIR:
-      UpdateIcon(ILFindLastID(idList[0]));
+      if (SUCCEEDED(GetDisplayNameOf(item, SHGDN_FORPARSING, name, _countof(name)))) {
+        mChanges.Update(name, ShareItemID(item));
+      }
       break;
 
     case SHCNE_MKDIR:
     case SHCNE_CREATE:
-      AddIcon(ILFindLastID(idList[0]));
+      if (SUCCEEDED(GetDisplayNameOf(item, SHGDN_FORPARSING, name, _countof(name)))) {
+        mChanges.Create(name, ShareItemID(item));
+      }
       break;
 
     case SHCNE_RMDIR:
     case SHCNE_DELETE:
-      RemoveIcon(ILFindLastID(idList[0]));
+      if (SUCCEEDED(GetDisplayNameOf(item, SHGDN_FORPARSING, name, _countof(name)))) {
+        mChanges.Delete(name);
+      }
       break;
 
     case SHCNE_RENAMEITEM:
     case SHCNE_RENAMEFOLDER:
-      RenameIcon(ILFindLastID(idList[0]), ILFindLastID(idList[1]));
+      {
+        PCITEMID_CHILD newItem = ILFindLastID(idList[1]);
+        if (SUCCEEDED(GetDisplayNameOf(item, SHGDN_FORPARSING, name, _countof(name)))
+            && SUCCEEDED(GetDisplayNameOf(newItem, SHGDN_FORPARSING, newName, _countof(newName)))) {
+          mChanges.Rename(name, newName, ShareItemID(newItem));
+        }
+      }
       break;
 
     case SHCNE_ASSOCCHANGED:
@@ -773,10 +1198,59 @@ LRESULT TileGroup::HandleChangeNotify(HANDLE changeHandle, DWORD processId) {
 
     SHChangeNotification_Unlock(notifyLock);
   }
+
+  if (!mChanges.IsEmpty() && mChangeTimer == 0) {
+    if (mChangeDelay == 0) {
+      ApplyChanges();
+    } else {
+      mChangeTimer = mWindow->SetCallbackTimer(mChangeDelay, this);
+    }
+  }
   return 0;
 }
 
 
+/// <summary>
+/// Applies the net effect of the queued up changes, and repaints once.
+/// </summary>
+void TileGroup::ApplyChanges() {
+  if (mChangeTimer != 0) {
+    mWindow->ClearCallbackTimer(mChangeTimer);
+    mChangeTimer = 0;
+  }
+
+  ChangeQueue::Changes changes = mChanges.Take();
+  Window::UpdateLock lock(mWindow);
+
+  for (const std::wstring &name : changes.deleted) {
+    auto item = mItemsByName.find(name);
+    if (item != mItemsByName.end()) {
+      RemoveItem(item->second);
+    }
+  }
+
+  RenameItems(changes.renamed);
+
+  for (const ChangeQueue::Change &change : changes.created) {
+    auto item = mItemsByName.find(change.key);
+    if (item != mItemsByName.end()) {
+      UpdateItem(*item->second, change.value.get());
+    } else {
+      AddIcon(change.value.get());
+    }
+  }
+
+  for (const ChangeQueue::Change &change : changes.updated) {
+    auto item = mItemsByName.find(change.key);
+    if (item != mItemsByName.end()) {
+      UpdateItem(*item->second, change.value.get());
+    }
+  }
+
+  mWindow->Repaint();
+}
+
+
 /// <summary>
 /// Handles window messages.
 /// </summary>
@@ -879,7 +1353,19 @@ LRESULT WINAPI TileGroup::HandleMessage(HWND window, UINT message, WPARAM wParam
     }
     break;
 
+  case Window::WM_SIZECHANGE:
+    UpdateVisibleTiles();
+    break;
+
+  case WM_TIMER:
+    if (wParam == mChangeTimer) {
+      ApplyChanges();
+    }
+    break;
+
   case Window::WM_TOPPARENTLOST:
+    // Our timers went with the top parent. The queued up changes are applied once we get a new one.
+    mChangeTimer = 0;
     mChangeNotifyMsg = 0;
     if (mChangeNotifyUID != 0) {
       SHChangeNotifyDeregister(mChangeNotifyUID);
@@ -914,6 +1400,10 @@ LRESULT WINAPI TileGroup::HandleMessage(HWND window, UINT message, WPARAM wParam
         }
         ipsf2->Release();
       }
+
+      if (!mChanges.IsEmpty()) {
+        mChangeTimer = mWindow->SetCallbackTimer(std::max(mChangeDelay, 1u), this);
+      }
     }
     break;
   }
@@ -8,7 +8,9 @@
 #pragma once
 
 #include "Tile.hpp"
+#include "TileGrid.hpp"
 #include "TileSettings.hpp"
+#include "TileVirtualizer.hpp"
 #include "SelectionRectangle.hpp"
 
 #include "../nCoreCom/Core.h"
@@ -18,11 +20,17 @@
 #include "../nShared/Settings.hpp"
 #include "../nShared/Window.hpp"
 
+#include "../Utilities/ChangeCoalescer.hpp"
 #include "../Utilities/StringUtils.h"
 
+#include <functional>
+#include <list>
+#include <memory>
 #include <set>
 #include <ShlObj.h>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 class TileGroup : public Drawable, public FileSystemLoaderResponseHandler {
 public:
@@ -31,12 +39,40 @@ public:
     Count
   };
 
+  // An item ID which is freed once the last reference to it is gone.
+  typedef std::shared_ptr<ITEMIDLIST> SharedItemID;
+
+  // Changes to the items of the folder, by parsing name.
+  typedef ChangeCoalescer<std::wstring, SharedItemID, CaseInsensitive::Hash,
+    CaseInsensitive::Equal> ChangeQueue;
+
+private:
+  // Every item in the folder has one of these. Only items near the visible area have a tile.
+  struct Item : TileVirtualizer<Tile>::Slot {
+    // Owned by the item.
+    PITEMID_CHILD id;
+    int positionID;
+
+    // The parsing name, which the item is indexed by.
+    std::wstring name;
+
+    // Where the item is in the folder request, if loadingFromFolder is set.
+    UINT folderIndex;
+
+    // True while the thumbnail is being loaded by the folder request.
+    bool loadingFromFolder;
+
+    // The LoadFolderItem request loading the thumbnail, or 0.
+    UINT64 thumbnailRequest;
+  };
+
 public:
   explicit TileGroup(LPCTSTR prefix);
   ~TileGroup();
 
   // FileSystemLoaderResponseHandler
 public:
+  LPARAM FolderItemsFound(UINT64, LoadFolderItemsResponse*) override;
   LPARAM FolderLoaded(UINT64, LoadFolderResponse*) override;
   LPARAM ItemLoaded(UINT64, LoadItemResponse*) override;
 
@@ -45,6 +81,7 @@ public:
 
 private:
   LRESULT HandleChangeNotify(HANDLE changeHandle, DWORD processId);
+  void ApplyChanges();
 
 public:
   void SetFolder(LPWSTR path);
@@ -60,12 +97,37 @@ private:
   HRESULT GetDisplayNameOf(PCITEMID_CHILD pidl, SHGDNF flags, LPWSTR buf, UINT cchBuf) const;
   HRESULT GetFolderPath(LPWSTR buf, UINT cchBuf) const;
   void AddIcon(PCITEMID_CHILD pidl);
-  void RemoveIcon(PCITEMID_CHILD pidl);
-  void UpdateIcon(PCITEMID_CHILD pidl);
+  void RemoveItem(std::list<Item>::iterator);
+  void UpdateItem(Item&, PCITEMID_CHILD id);
   void UpdateAllIcons();
-  void RenameIcon(PCITEMID_CHILD oldID, PCITEMID_CHILD newID);
+  void RenameItems(const std::vector<ChangeQueue::NameChange>&);
   int GetIconPosition(PCITEMID_CHILD);
-  Tile *FindIcon(PCITEMID_CHILD) const;
+  LoadPriority GetLoadPriority();
+  Item *AddItem(PCITEMID_CHILD, LPCWSTR name, LoadThumbnailResponse*, bool loadingFromFolder);
+  std::list<Item>::iterator FindItem(PCITEMID_CHILD);
+
+  // Tile virtualization
+private:
+  RECT GetTileRect(int positionID);
+  bool IsInArea(int positionID, int margin);
+  UINT GetNearbyPositionCount();
+  void Materialize(Item&, LoadThumbnailResponse*);
+  void Dematerialize(Item&);
+  void RequestThumbnail(Item&);
+  void CancelThumbnail(Item&);
+  void UpdateVisibleTiles();
+  bool IsSelected(const Item&) const;
+  void SetSelected(Item&, bool selected);
+
+  // Spatial index
+private:
+  typedef TileGrid<Item*> Grid;
+
+  static Grid::Rect ToGridRect(const RECT&);
+  void AddToGrid(Item&);
+  void RemoveFromGrid(Item&);
+  void RebuildGrid();
+  void FindItemsInRect(D2D1_RECT_F rect, std::unordered_set<Item*> *items);
 
   void ImportFolderContents();
   void AddNameFilter(LPCWSTR name);
@@ -81,6 +143,9 @@ private:
   int mTileWidth;
   int mTileHeight;
 
+  // How far outside the window items get tiles, so that they are ready before they are needed.
+  int mTileMargin;
+
   // Items which should not be shown on the desktop
   StringKeyedSets<std::wstring>::UnorderedSet mHiddenItems;
 
@@ -91,8 +156,41 @@ private:
   std::set<int> mEmptySpots;
   int mNextPositionID;
 
-  // All icons currently part of this group.
-  std::list<Tile*> mTiles;
+  // The number of icons added by AddIcon which are still loading.
+  int mPendingItems;
+
+  // The folder request which is being loaded.
+  UINT64 mFolderRequest;
+
+  // The number of items whose thumbnails are loaded by the folder request.
+  UINT mFolderThumbnailCount;
+
+  // Items whose thumbnails are still being loaded, by where they are in the folder request.
+  std::unordered_map<UINT, Item*> mLoadingItems;
+
+  // Items whose thumbnails are being loaded by LoadFolderItem, by request.
+  std::unordered_map<UINT64, Item*> mThumbnailRequests;
+
+  // All items currently part of this group.
+  std::list<Item> mItems;
+
+  // Every item in mItems, by parsing name.
+  StringKeyedMaps<std::wstring, std::list<Item>::iterator>::UnorderedMap mItemsByName;
+
+  // The items, by where their tiles are.
+  Grid mGrid;
+
+  // Which items have tiles, and the tiles which are ready to be reused.
+  TileVirtualizer<Tile> mTiles;
+
+  // Changes which haven't been applied yet.
+  ChangeQueue mChanges;
+
+  // Fires when the queued up changes should be applied, or 0.
+  UINT_PTR mChangeTimer;
+
+  // How long to wait for more changes, in milliseconds.
+  UINT mChangeDelay;
 
   // Return value of the latest SHChangeNofityRegister call.
   ULONG mChangeNotifyUID;
@@ -122,8 +220,11 @@ private:
   void StartRectangleSelection(D2D1_POINT_2U point);
   void EndRectangleSelection(D2D1_POINT_2U point);
   void MoveRectangleSelection(D2D1_POINT_2U point);
+  void SelectInRect(D2D1_RECT_F rect);
   D2D1_POINT_2U mRectangleStart;
   bool mInRectangleSelection;
+  // The items which are currently in the selection rectangle.
+  std::unordered_set<Item*> mRectangleSelection;
   SelectionRectangle mSelectionRectagle;
 
   // Context menu temps
@@ -0,0 +1,125 @@
+//-------------------------------------------------------------------------------------------------
+// /nIcon/TileVirtualizer.hpp
+// The nModules Project
+//
+// Gives tiles to the items which are near the visible area, and takes them back from the rest.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+/// <summary>
+/// Keeps track of which items of a group have tiles. Creating a tile means creating a window, so
+/// only items near the visible area get one. An item which goes out of view keeps the selection and
+/// ghosting of its tile, and gets them back along with its next tile. Tiles which are taken back
+/// are hidden and kept for reuse, up to a limit, rather than destroyed.
+///
+/// TileType needs IsSelected, IsGhosted, Select, Deselect, SetGhost, Show and Hide. Tiles are
+/// created by the caller, and deleted by the virtualizer.
+/// </summary>
+template <typename TileType>
+class TileVirtualizer {
+public:
+  /// <summary>
+  /// An item's tile, or the state of it while the item doesn't have one.
+  /// </summary>
+  struct Slot {
+    Slot() : tile(nullptr), selected(false), ghosted(false) {}
+
+    // The tile showing the item, or nullptr.
+    TileType *tile;
+
+    // Only up to date while the item doesn't have a tile.
+    bool selected;
+    bool ghosted;
+  };
+
+public:
+  explicit TileVirtualizer(size_t maxSpareTiles) : mMaxSpareTiles(maxSpareTiles) {}
+
+  ~TileVirtualizer() {
+    for (TileType *tile : mSpareTiles) {
+      delete tile;
+    }
+  }
+
+  TileVirtualizer(const TileVirtualizer&) = delete;
+  TileVirtualizer &operator=(const TileVirtualizer&) = delete;
+
+public:
+  /// <summary>
+  /// Gives a slot which doesn't have a tile one, and returns it. A spare tile is reused if there
+  /// is one, after reuse has switched it over to the item. Otherwise, create makes a new one.
+  /// Either way, the tile gets the selection and ghosting which the slot kept.
+  /// </summary>
+  template <typename Create, typename Reuse>
+  TileType *Materialize(Slot &slot, Create create, Reuse reuse) {
+    if (!mSpareTiles.empty()) {
+      slot.tile = mSpareTiles.back();
+      mSpareTiles.pop_back();
+      reuse(slot.tile);
+      slot.tile->Show();
+    } else {
+      slot.tile = create();
+    }
+
+    if (slot.selected) {
+      slot.tile->Select();
+    }
+    if (slot.ghosted) {
+      slot.tile->SetGhost();
+    }
+    return slot.tile;
+  }
+
+  /// <summary>
+  /// Takes the tile away from a slot which has one, keeping its selection and ghosting.
+  /// </summary>
+  void Dematerialize(Slot &slot) {
+    slot.selected = slot.tile->IsSelected();
+    slot.ghosted = slot.tile->IsGhosted();
+
+    if (mSpareTiles.size() < mMaxSpareTiles) {
+      slot.tile->Hide();
+      mSpareTiles.push_back(slot.tile);
+    } else {
+      delete slot.tile;
+    }
+    slot.tile = nullptr;
+  }
+
+  /// <summary>
+  /// Deletes the tile of a slot which is going away, without keeping it for reuse.
+  /// </summary>
+  void Destroy(Slot &slot) {
+    delete slot.tile;
+    slot.tile = nullptr;
+  }
+
+  bool IsSelected(const Slot &slot) const {
+    return slot.tile ? slot.tile->IsSelected() : slot.selected;
+  }
+
+  void SetSelected(Slot &slot, bool selected) {
+    if (slot.tile) {
+      if (selected) {
+        slot.tile->Select();
+      } else {
+        slot.tile->Deselect();
+      }
+    } else {
+      slot.selected = selected;
+    }
+  }
+
+  size_t GetSpareCount() const {
+    return mSpareTiles.size();
+  }
+
+private:
+  const size_t mMaxSpareTiles;
+
+  // Tiles which have been taken off items which went out of view, ready to be reused.
+  std::vector<TileType*> mSpareTiles;
+};
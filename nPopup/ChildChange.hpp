@@ -0,0 +1,57 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  ChildChange.hpp
+ *  The nModules Project
+ *
+ *  Works out what a change notification means for the items of a folder.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#pragma once
+
+// The kinds of change notifications a popup registers for.
+enum class ChangeEvent
+{
+    Create,
+    Delete,
+    Update,
+    Rename
+};
+
+// What a change notification does to the items of a watched folder.
+enum class ChildChange
+{
+    Ignore,
+    Create,
+    Delete,
+    Update,
+    Rename
+};
+
+/// <summary>
+/// Works out what a change notification means for the direct children of a watched folder. The
+/// shell may report changes further down, e.g. to a file in a subfolder, which are not about the
+/// folder's items at all. For renames, isChild is about the old name and newIsChild about the new
+/// one, so an item which is moved into the folder is created, and one moved out is deleted.
+/// </summary>
+inline ChildChange ClassifyChildChange(ChangeEvent event, bool isChild, bool newIsChild)
+{
+    switch (event)
+    {
+    case ChangeEvent::Create:
+        return isChild ? ChildChange::Create : ChildChange::Ignore;
+
+    case ChangeEvent::Delete:
+        return isChild ? ChildChange::Delete : ChildChange::Ignore;
+
+    case ChangeEvent::Update:
+        return isChild ? ChildChange::Update : ChildChange::Ignore;
+
+    case ChangeEvent::Rename:
+        if (isChild)
+        {
+            return newIsChild ? ChildChange::Rename : ChildChange::Delete;
+        }
+        return newIsChild ? ChildChange::Create : ChildChange::Ignore;
+    }
+
+    return ChildChange::Ignore;
+}
@@ -6,12 +6,15 @@
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 #include "../nShared/LiteStep.h"
+#include "../nCoreCom/Core.h"
 #include <strsafe.h>
 #include "ContentPopup.hpp"
 #include "CommandItem.hpp"
 #include "FolderItem.hpp"
+#include "Snapshot.hpp"
 #include <Shlwapi.h>
 #include <algorithm>
+#include "../Utilities/AlgorithmExtension.h"
 
 
 ContentPopup::ContentPopup(ContentSource source, LPCTSTR title, LPCTSTR bang, LPCTSTR prefix) : Popup(title, bang, prefix)
@@ -19,6 +22,8 @@ ContentPopup::ContentPopup(ContentSource source, LPCTSTR title, LPCTSTR bang, LP
     this->loaded = false;
     this->dynamic = true;
     this->source = source;
+    this->changeTimer = 0;
+    this->changeDelay = UINT(std::max(1, mSettings->GetInt(L"ChangeNotificationDelay", 100)));
 }
 
 
@@ -27,6 +32,8 @@ ContentPopup::ContentPopup(LPCTSTR path, bool dynamic, LPCTSTR title, LPCTSTR ba
     this->loaded = false;
     this->dynamic = dynamic;
     this->source = ContentSource::PATH;
+    this->changeTimer = 0;
+    this->changeDelay = UINT(std::max(1, mSettings->GetInt(L"ChangeNotificationDelay", 100)));
 
     TCHAR processedPath[MAX_PATH], originalPath[MAX_PATH];
     LPCTSTR splitter, end = wcschr(path, L'\0');
@@ -45,13 +52,8 @@ ContentPopup::ContentPopup(LPCTSTR path, bool dynamic, LPCTSTR title, LPCTSTR ba
 
 ContentPopup::~ContentPopup()
 {
-    for (WATCHFOLDERMAP::const_iterator iter = this->watchedFolders.begin(); iter != this->watchedFolders.end(); ++iter)
-    {
-        iter->second.second->Release();
-        mWindow->ReleaseUserMessage(iter->first);
-        SHChangeNotifyDeregister(iter->second.first);
-    }
-    this->watchedFolders.clear();
+    ReleasePrefetches();
+    StopWatching();
 
     for (std::list<LPCTSTR>::const_iterator iter = this->paths.begin(); iter != this->paths.end(); ++iter)
     {
@@ -66,7 +68,6 @@ void ContentPopup::PreShow()
     if (!this->loaded)
     {
         LoadContent();
-        std::sort(this->items.begin(), this->items.end(), [] (PopupItem* a, PopupItem* b) { return a->CompareTo(b); });
         this->loaded = true;
     }
 }
@@ -76,25 +77,36 @@ void ContentPopup::PostClose()
 {
     if (this->dynamic)
     {
-        for (WATCHFOLDERMAP::const_iterator iter = this->watchedFolders.begin(); iter != this->watchedFolders.end(); ++iter)
-        {
-            iter->second.second->Release();
-            mWindow->ReleaseUserMessage(iter->first);
-            SHChangeNotifyDeregister(iter->second.first);
-        }
-        this->watchedFolders.clear();
-
-        for (vector<PopupItem*>::const_iterator iter = this->items.begin(); iter != this->items.end(); ++iter)
-        {
-            delete *iter;
-        }
-        this->items.clear();
+        StopWatching();
+        this->folderItems.clear();
+        ClearItems();
 
         this->loaded = false;
     }
 }
 
 
+void ContentPopup::StopWatching()
+{
+    Snapshot::ForgetHandler(this);
+
+    for (WATCHFOLDERMAP::const_iterator iter = this->watchedFolders.begin(); iter != this->watchedFolders.end(); ++iter)
+    {
+        iter->second.folder->Release();
+        ILFree(iter->second.idList);
+        mWindow->ReleaseUserMessage(iter->first);
+        SHChangeNotifyDeregister(iter->second.notifyId);
+    }
+    this->watchedFolders.clear();
+
+    if (this->changeTimer != 0)
+    {
+        mWindow->ClearCallbackTimer(this->changeTimer);
+        this->changeTimer = 0;
+    }
+}
+
+
 void ContentPopup::AddPath(LPCTSTR path)
 {
     TCHAR processedPath[MAX_PATH];
@@ -105,65 +117,107 @@ void ContentPopup::AddPath(LPCTSTR path)
 
     if (this->loaded)
     {
-        LoadPath(processedPath);
-        std::sort(this->items.begin(), this->items.end(), [] (PopupItem* a, PopupItem* b) { return a->CompareTo(b); });
+        vector<ItemRun> runs;
+        LoadPath(processedPath, runs);
+        MergeItems(runs);
     }
 }
 
 
+bool ContentPopup::RemovePath(LPCTSTR path)
+{
+    TCHAR processedPath[MAX_PATH];
+
+    PathCanonicalize(processedPath, path);
+    PathRemoveBackslash(processedPath);
+    for (std::list<LPCTSTR>::iterator iter = this->paths.begin(); iter != this->paths.end(); ++iter)
+    {
+        if (_wcsicmp(*iter, processedPath) == 0)
+        {
+            free((LPVOID)*iter);
+            this->paths.erase(iter);
+            break;
+        }
+    }
+
+    // The items of the path are mixed in with the others, and may have been merged with them, so
+    // everything is loaded again.
+    if (this->loaded && !this->paths.empty())
+    {
+        StopWatching();
+        this->folderItems.clear();
+        ClearItems();
+        LoadContent();
+    }
+
+    return !this->paths.empty();
+}
+
+
+/// <summary>
+/// Loads the items of every source, and merges them into the popup.
+/// </summary>
 void ContentPopup::LoadContent()
 {
+    vector<ItemRun> runs;
+
     switch (this->source)
     {
     case ADMIN_TOOLS:
-        LoadShellFolder(FOLDERID_AdminTools);
+        LoadShellFolder(FOLDERID_AdminTools, runs);
         break;
 
     case CONTROL_PANEL:
-        LoadShellFolder(FOLDERID_ControlPanelFolder, true);
+        LoadShellFolder(FOLDERID_ControlPanelFolder, runs, true);
         break;
 
     case MY_COMPUTER:
-        LoadShellFolder(FOLDERID_ComputerFolder);
+        LoadShellFolder(FOLDERID_ComputerFolder, runs);
         break;
 
     case NETWORK:
-        LoadShellFolder(FOLDERID_NetworkFolder);
+        LoadShellFolder(FOLDERID_NetworkFolder, runs);
         break;
 
     case PATH:
         for (std::list<LPCTSTR>::const_iterator iter = paths.begin(); iter != paths.end(); ++iter)
         {
-            LoadPath(*iter);
+            if (!LoadPrefetched(*iter, runs))
+            {
+                LoadPath(*iter, runs);
+            }
         }
         break;
 
     case PRINTERS:
-        LoadShellFolder(FOLDERID_PrintersFolder);
+        LoadShellFolder(FOLDERID_PrintersFolder, runs);
         break;
 
     case RECENT_DOCUMENTS:
-        LoadShellFolder(FOLDERID_Recent);
+        LoadShellFolder(FOLDERID_Recent, runs);
         break;
 
     case RECYCLE_BIN:
-        LoadShellFolder(FOLDERID_RecycleBinFolder);
+        LoadShellFolder(FOLDERID_RecycleBinFolder, runs);
         break;
 
     case START_MENU:
-        LoadShellFolder(FOLDERID_StartMenu);
-        LoadShellFolder(FOLDERID_CommonStartMenu);
+        LoadShellFolder(FOLDERID_StartMenu, runs);
+        LoadShellFolder(FOLDERID_CommonStartMenu, runs);
         break;
 
     case PROGRAMS:
-        LoadShellFolder(FOLDERID_Programs);
-        LoadShellFolder(FOLDERID_CommonPrograms);
+        LoadShellFolder(FOLDERID_Programs, runs);
+        LoadShellFolder(FOLDERID_CommonPrograms, runs);
         break;
     }
+
+    ReleasePrefetches();
+    MergeItems(runs);
 }
 
 
-void ContentPopup::LoadShellFolder(GUID folder, bool dontExpandFolders)
+void ContentPopup::LoadShellFolder(GUID folder, vector<ItemRun> &runs, bool dontExpandFolders)
 {
     PIDLIST_ABSOLUTE idList;
     IShellFolder *targetFolder, *rootFolder;
@@ -175,7 +229,7 @@ void ContentPopup::LoadShellFolder(GUID folder, bool dontExpandFolders)
     rootFolder->Release();
 
     //
-    LoadFromIDList(targetFolder, idList, dontExpandFolders);
+    LoadFromIDList(targetFolder, idList, dontExpandFolders, runs);
 
     if (idList != NULL)
     {
@@ -184,7 +238,7 @@ void ContentPopup::LoadShellFolder(GUID folder, bool dontExpandFolders)
 }
 
 
-void ContentPopup::LoadPath(LPCTSTR path)
+void ContentPopup::LoadPath(LPCTSTR path, vector<ItemRun> &runs)
 {
     PIDLIST_ABSOLUTE idList = NULL;
     IShellFolder *targetFolder, *rootFolder;
@@ -195,7 +249,7 @@ void ContentPopup::LoadPath(LPCTSTR path)
     rootFolder->BindToObject(idList, NULL, IID_IShellFolder, reinterpret_cast<LPVOID*>(&targetFolder));
     rootFolder->Release();
 
-    LoadFromIDList(targetFolder, idList, false);
+    LoadFromIDList(targetFolder, idList, false, runs);
 
     if (idList != NULL)
     {
@@ -206,7 +260,7 @@ void ContentPopup::LoadPath(LPCTSTR path)
 
 static float time;
 
-void ContentPopup::LoadFromIDList(IShellFolder *targetFolder, PIDLIST_ABSOLUTE idList, bool dontExpandFolders)
+void ContentPopup::LoadFromIDList(IShellFolder *targetFolder, PIDLIST_ABSOLUTE idList, bool dontExpandFolders, vector<ItemRun> &runs)
 {
     PIDLIST_RELATIVE idNext = NULL;
     IEnumIDList* enumIDList;
@@ -218,29 +272,60 @@ void ContentPopup::LoadFromIDList(IShellFolder *targetFolder, PIDLIST_ABSOLUTE i
 
     time = 0.0f;
 
+    // Folders on disk can tell whether they have changed since they were put in the snapshot.
+    WCHAR path[MAX_PATH];
+    UINT64 stamp = 0;
+    bool snapshotted = !dontExpandFolders && SHGetPathFromIDListW(idList, path) && Snapshot::GetFolderStamp(path, &stamp);
+
     StopWatch watch;
+    const PopupSnapshot::Folder *snapshot = snapshotted ? Snapshot::Find(path, stamp) : nullptr;
+    if (snapshot != nullptr)
+    {
+        ItemRun run;
+        ItemsByName names;
+        for (const PopupSnapshot::Item &snapshotItem : snapshot->items)
+        {
+            PopupItem *item = LoadSnapshotItem(snapshotItem);
+            if (item != nullptr)
+            {
+                run.push_back(item);
+            }
+            names[snapshotItem.command] = GetShownItem(item, snapshotItem.title.c_str());
+        }
+        runs.push_back(std::move(run));
+
+        // Make sure the snapshot is right, once, without holding up the popup.
+        if (!snapshot->verified)
+        {
+            Snapshot::Refresh(targetFolder, path, stamp, !this->noIcons, this);
+        }
+
+        WatchFolder(targetFolder, idList, names);
+    }
     // Enumerate the contents of this folder
-    if (SUCCEEDED(targetFolder->EnumObjects(NULL, SHCONTF_FOLDERS | SHCONTF_NONFOLDERS, &enumIDList)))
+    else if (SUCCEEDED(targetFolder->EnumObjects(NULL, SHCONTF_FOLDERS | SHCONTF_NONFOLDERS, &enumIDList)))
     {
+        ItemRun run;
+        ItemsByName names;
+        vector<PopupSnapshot::Item> snapshotItems;
         while (enumIDList->Next(1, &idNext, NULL) != S_FALSE)
         {
-            LoadSingleItem(targetFolder, idNext, dontExpandFolders);
+            PopupItem *item = LoadSingleItem(targetFolder, idNext, dontExpandFolders, snapshotted ? &snapshotItems : nullptr, &names);
+            if (item != nullptr)
+            {
+                run.push_back(item);
+            }
             CoTaskMemFree(idNext);
         }
         enumIDList->Release();
+        runs.push_back(std::move(run));
 
-        // Register for change notifications
-        SHChangeNotifyEntry watchEntries[] = { idList, TRUE };
-        UINT message = mWindow->RegisterUserMessage(this);
-        ULONG shnrUID = SHChangeNotifyRegister(
-            mWindow->GetWindowHandle(),
-            SHCNRF_ShellLevel | SHCNRF_InterruptLevel | SHCNRF_NewDelivery,
-            SHCNE_CREATE | SHCNE_DELETE | SHCNE_ATTRIBUTES | SHCNE_MKDIR | SHCNE_RMDIR | SHCNE_RENAMEITEM | SHCNE_RENAMEFOLDER | SHCNE_UPDATEITEM,
-            message,
-            1,
-            watchEntries);
+        if (snapshotted)
+        {
+            Snapshot::Store(path, stamp, std::move(snapshotItems));
+        }
 
-        this->watchedFolders.insert(WATCHFOLDERMAP::value_type(message, std::pair<UINT, IShellFolder*>(shnrUID, targetFolder)));
+        WatchFolder(targetFolder, idList, names);
     }
 
     TRACE("[Popup::LoadFromIDList] Total Time: %.5f, %.5f", watch.Clock(), time);
@@ -248,17 +333,37 @@ void ContentPopup::LoadFromIDList(IShellFolder *targetFolder, PIDLIST_ABSOLUTE i
 }
 
 
-void ContentPopup::LoadSingleItem(IShellFolder *targetFolder, PIDLIST_RELATIVE itemID, bool dontExpandFolders)
+void ContentPopup::WatchFolder(IShellFolder *targetFolder, PIDLIST_ABSOLUTE idList, ItemsByName &items)
+{
+    // Register for change notifications. Only the folder's own items are shown, so changes further
+    // down are of no interest.
+    SHChangeNotifyEntry watchEntries[] = { idList, FALSE };
+    UINT message = mWindow->RegisterUserMessage(this);
+    ULONG shnrUID = SHChangeNotifyRegister(
+        mWindow->GetWindowHandle(),
+        SHCNRF_ShellLevel | SHCNRF_InterruptLevel | SHCNRF_NewDelivery,
+        SHCNE_CREATE | SHCNE_DELETE | SHCNE_ATTRIBUTES | SHCNE_MKDIR | SHCNE_RMDIR | SHCNE_RENAMEITEM | SHCNE_RENAMEFOLDER | SHCNE_UPDATEITEM,
+        message,
+        1,
+        watchEntries);
+
+    WatchedFolder &watched = this->watchedFolders[message];
+    watched.notifyId = shnrUID;
+    watched.folder = targetFolder;
+    watched.idList = ILCloneFull(idList);
+    watched.items.swap(items);
+}
+
+
+PopupItem *ContentPopup::LoadSingleItem(IShellFolder *targetFolder, PIDLIST_RELATIVE itemID, bool dontExpandFolders, vector<PopupSnapshot::Item> *snapshot, ItemsByName *names)
 {
     STRRET ret;
     LPTSTR name, command;
     IExtractIconW* extractIcon;
     SFGAOF attributes;
-    TCHAR quotedCommand[MAX_LINE_LENGTH];
     bool openable;
     HRESULT hr;
-    PopupItem* item;
-    vector<PopupItem*>::const_iterator iter;
+    PopupItem* item = nullptr;
 
     if (SUCCEEDED(targetFolder->GetDisplayNameOf(itemID, SHGDN_NORMAL, &ret)))
     {
@@ -272,74 +377,521 @@ void ContentPopup::LoadSingleItem(IShellFolder *targetFolder, PIDLIST_RELATIVE i
             hr = targetFolder->GetAttributesOf(1, (LPCITEMIDLIST *)&itemID, &attributes);
             openable = SUCCEEDED(hr) && !dontExpandFolders && (((attributes & SFGAO_FOLDER) == SFGAO_FOLDER) || ((attributes & SFGAO_BROWSABLE) == SFGAO_BROWSABLE));
 
+            if (snapshot != nullptr)
+            {
+                PopupSnapshot::Item snapshotItem = { name, command, openable };
+                snapshot->push_back(std::move(snapshotItem));
+            }
 
             StopWatch watch;
-            if (openable)
+            item = CreateItem(name, command, openable);
+            time += watch.Clock();
+
+            if (names != nullptr)
+            {
+                (*names)[command] = GetShownItem(item, name);
+            }
+
+            if (!this->noIcons && item != nullptr)
             {
-                for (iter = this->items.begin(); iter != this->items.end() && !(*iter)->CheckMerge(name); ++iter);
+                // Icons which have been extracted before are kept by the core.
+                IWICBitmap *cachedIcon = nCore::LoadCachedThumbnail(command, PopupItem::ICON_EXTRACT_SIZE);
 
-                if (iter != this->items.end())
+                if (cachedIcon != nullptr)
                 {
-                    item = NULL;
-                    ((nPopup::FolderItem*)*iter)->AddPath(command);
+                    item->SetIcon(cachedIcon);
                 }
                 else
                 {
-                    if (this->dynamic)
+                    // Get the IExtractIcon interface for this item.
+                    hr = targetFolder->GetUIObjectOf(NULL, 1, (LPCITEMIDLIST *)&itemID, IID_IExtractIconW, nullptr, reinterpret_cast<LPVOID*>(&extractIcon));
+
+                    if (SUCCEEDED(hr))
                     {
-                        item = new nPopup::FolderItem(this, name, [] (nPopup::FolderItem::CreationData* data) -> Popup*
-                        {
-                            ContentPopup *popup = new ContentPopup(data->command, true, data->name, nullptr, data->prefix);
+                        item->SetIcon(extractIcon, command);
+                    }
+                }
+            }
 
-                            for (auto path : data->paths)
-                            {
-                                popup->AddPath(path);
-                            }
+            CoTaskMemFree(command);
+        }
+        CoTaskMemFree(name);
+    }
 
-                            return popup;
-                        }, new nPopup::FolderItem::CreationData(command, name, mSettings->GetPrefix()));
-                    }
-                    else
+    return item;
+}
+
+
+/// <summary>
+/// Shows an item the way it was when it was put in the snapshot. Only icons which the core has
+/// cached are shown, since the item itself hasn't been loaded. The rest are filled in by
+/// FolderRefreshed.
+/// </summary>
+PopupItem *ContentPopup::LoadSnapshotItem(const PopupSnapshot::Item &snapshotItem)
+{
+    PopupItem *item = CreateItem(snapshotItem.title.c_str(), snapshotItem.command.c_str(), snapshotItem.folder);
+
+    if (!this->noIcons && item != nullptr)
+    {
+        IWICBitmap *cachedIcon = nCore::LoadCachedThumbnail(snapshotItem.command.c_str(), PopupItem::ICON_EXTRACT_SIZE);
+
+        if (cachedIcon != nullptr)
+        {
+            item->SetIcon(cachedIcon);
+        }
+    }
+
+    return item;
+}
+
+
+PopupItem *ContentPopup::CreateItem(LPCTSTR name, LPCTSTR command, bool openable)
+{
+    TCHAR quotedCommand[MAX_LINE_LENGTH];
+    PopupItem* item = nullptr;
+
+    if (openable)
+    {
+        auto folderItem = this->folderItems.find(name);
+
+        if (folderItem != this->folderItems.end())
+        {
+            folderItem->second->AddPath(command);
+        }
+        else
+        {
+            if (this->dynamic)
+            {
+                item = new nPopup::FolderItem(this, name, [] (nPopup::FolderItem::CreationData* data) -> Popup*
+                {
+                    ContentPopup *popup = new ContentPopup(data->command, true, data->name, nullptr, data->prefix);
+
+                    for (auto path : data->paths)
                     {
-                        item = new nPopup::FolderItem(this, name, new ContentPopup(command, this->dynamic, name, NULL, mSettings->GetPrefix()));
+                        popup->AddPath(path);
                     }
-                }
+
+                    return popup;
+                }, new nPopup::FolderItem::CreationData(command, name, mSettings->GetPrefix()));
             }
             else
             {
-                StringCchPrintf(quotedCommand, sizeof(quotedCommand), L"\"%s\"", command);
-                item = new CommandItem(this, name, quotedCommand);
+                item = new nPopup::FolderItem(this, name, new ContentPopup(command, this->dynamic, name, NULL, mSettings->GetPrefix()));
             }
-            time += watch.Clock();
+            this->folderItems[name] = (nPopup::FolderItem*)item;
+        }
+    }
+    else
+    {
+        StringCchPrintf(quotedCommand, sizeof(quotedCommand), L"\"%s\"", command);
+        item = new CommandItem(this, name, quotedCommand);
+    }
 
-            if (!this->noIcons && item != nullptr)
-            {
-                // Get the IExtractIcon interface for this item.
-                hr = targetFolder->GetUIObjectOf(NULL, 1, (LPCITEMIDLIST *)&itemID, IID_IExtractIconW, nullptr, reinterpret_cast<LPVOID*>(&extractIcon));
+    return item;
+}
 
-                if (SUCCEEDED(hr))
-                {
-                    item->SetIcon(extractIcon);
-                }
+
+PopupItem *ContentPopup::GetShownItem(PopupItem *created, LPCTSTR name)
+{
+    if (created != nullptr)
+    {
+        return created;
+    }
+
+    auto folderItem = this->folderItems.find(name);
+    return folderItem != this->folderItems.end() ? folderItem->second : nullptr;
+}
+
+
+/// <summary>
+/// Adds runs of new items to the popup. Rather than sorting every item again, each run is sorted on
+/// its own, and the runs are merged with the items, which are already sorted, in a single pass.
+/// </summary>
+void ContentPopup::MergeItems(vector<ItemRun> &runs)
+{
+    auto comesBefore = [] (PopupItem* a, PopupItem* b) { return a->CompareTo(b); };
+
+    bool added = false;
+    for (ItemRun &run : runs)
+    {
+        std::sort(run.begin(), run.end(), comesBefore);
+        added = added || !run.empty();
+    }
+
+    if (added)
+    {
+        // The existing items go first, so that they stay ahead of new items which compare equal.
+        runs.insert(runs.begin(), std::move(this->items));
+        std::merge_runs(runs, this->items, comesBefore);
+        ItemsChanged();
+    }
+}
+
+
+/// <summary>
+/// Retrieves the parsing name of an item in a folder.
+/// </summary>
+static bool GetItemName(IShellFolder *folder, PCUITEMID_CHILD item, LPWSTR name, UINT cchName)
+{
+    STRRET ret;
+    return SUCCEEDED(folder->GetDisplayNameOf(item, SHGDN_FORPARSING, &ret)) && SUCCEEDED(StrRetToBufW(&ret, item, name, cchName));
+}
+
+
+/// <summary>
+/// Makes a reference counted copy of an item ID.
+/// </summary>
+static std::shared_ptr<ITEMIDLIST> ShareItemID(PCUITEMID_CHILD item)
+{
+    return std::shared_ptr<ITEMIDLIST>(ILClone(item), [] (ITEMIDLIST *copy) { ILFree(copy); });
+}
+
+
+/// <summary>
+/// Starts enumerating the folders of the popup, and extracting the icons of their items, on nCore's
+/// worker threads. The icons end up in the core's thumbnail cache, which LoadSingleItem looks in
+/// first, and the items are kept until the popup is opened.
+/// </summary>
+void ContentPopup::Prefetch()
+{
+    // Only folders on disk can tell whether they have changed since they were prefetched.
+    if (this->loaded || this->source != PATH || !this->prefetchedFolders.empty())
+    {
+        return;
+    }
+
+    for (LPCTSTR path : this->paths)
+    {
+        UINT64 stamp;
+        PIDLIST_ABSOLUTE idList = nullptr;
+        IShellFolder *rootFolder;
+        IShellFolder2 *targetFolder = nullptr;
+
+        if (!Snapshot::GetFolderStamp(path, &stamp))
+        {
+            continue;
+        }
+
+        SHGetDesktopFolder(&rootFolder);
+        if (SUCCEEDED(rootFolder->ParseDisplayName(NULL, NULL, (LPTSTR)path, NULL, &idList, NULL)))
+        {
+            rootFolder->BindToObject(idList, NULL, IID_IShellFolder2, reinterpret_cast<LPVOID*>(&targetFolder));
+        }
+        rootFolder->Release();
+
+        if (targetFolder == nullptr)
+        {
+            if (idList != nullptr)
+            {
+                CoTaskMemFree(idList);
             }
+            continue;
+        }
+
+        LoadFolderRequest request;
+        request.folder = targetFolder;
+        request.targetIconWidth = PopupItem::ICON_EXTRACT_SIZE;
+        request.priority = LoadPriority::Prefetch;
+        request.visibleCount = 0;
+        request.thumbnailCount = this->noIcons ? 0 : UINT(-1);
+
+        this->prefetchedFolders.emplace_back();
+        PrefetchedFolder &prefetched = this->prefetchedFolders.back();
+        prefetched.path = path;
+        prefetched.folder = targetFolder;
+        prefetched.idList = idList;
+        prefetched.request = nCore::LoadFolder(request, this);
+
+        UINT64 requestId = prefetched.request;
+        prefetched.items.Start(stamp, [requestId] () { nCore::CancelLoad(requestId); });
+    }
+}
+
+
+/// <summary>
+/// Throws away the prefetches, unless they have all finished loading.
+/// </summary>
+void ContentPopup::CancelPrefetch()
+{
+    for (PrefetchedFolder &prefetched : this->prefetchedFolders)
+    {
+        if (prefetched.items.GetState() == FolderPrefetch<UINT64, SharedItemID>::State::Loading)
+        {
+            ReleasePrefetches();
+            return;
+        }
+    }
+}
+
+
+void ContentPopup::ReleasePrefetches()
+{
+    for (PrefetchedFolder &prefetched : this->prefetchedFolders)
+    {
+        prefetched.items.Cancel();
+        prefetched.folder->Release();
+        CoTaskMemFree(prefetched.idList);
+    }
+    this->prefetchedFolders.clear();
+}
+
+
+bool ContentPopup::LoadPrefetched(LPCTSTR path, vector<ItemRun> &runs)
+{
+    for (PrefetchedFolder &prefetched : this->prefetchedFolders)
+    {
+        UINT64 stamp;
+        vector<SharedItemID> ids;
+
+        if (_wcsicmp(prefetched.path.c_str(), path) != 0)
+        {
+            continue;
+        }
+
+        // A prefetch which hasn't finished, or whose folder has changed since, is thrown away.
+        if (!Snapshot::GetFolderStamp(path, &stamp) || !prefetched.items.Take(stamp, ids))
+        {
+            return false;
+        }
+
+        WCHAR folderPath[MAX_PATH];
+        bool snapshotted = SHGetPathFromIDListW(prefetched.idList, folderPath) != FALSE;
 
+        ItemRun run;
+        ItemsByName names;
+        vector<PopupSnapshot::Item> snapshotItems;
+        for (const SharedItemID &id : ids)
+        {
+            PopupItem *item = LoadSingleItem(prefetched.folder, (PIDLIST_RELATIVE)id.get(), false, snapshotted ? &snapshotItems : nullptr, &names);
             if (item != nullptr)
             {
-                AddItem(item);
+                run.push_back(item);
             }
+        }
+        runs.push_back(std::move(run));
 
-            CoTaskMemFree(command);
+        if (snapshotted)
+        {
+            Snapshot::Store(folderPath, stamp, std::move(snapshotItems));
+        }
+
+        prefetched.folder->AddRef();
+        WatchFolder(prefetched.folder, prefetched.idList, names);
+        return true;
+    }
+    return false;
+}
+
+
+LPARAM ContentPopup::FolderItemsFound(UINT64 id, LoadFolderItemsResponse *response)
+{
+    for (PrefetchedFolder &prefetched : this->prefetchedFolders)
+    {
+        if (prefetched.request == id)
+        {
+            for (PITEMID_CHILD item : response->items)
+            {
+                prefetched.items.Add(ShareItemID(item));
+            }
         }
-        CoTaskMemFree(name);
+    }
+    return 0;
+}
+
+
+/// <summary>
+/// The thumbnails have been added to the thumbnail cache by now, so only completion matters.
+/// </summary>
+LPARAM ContentPopup::FolderLoaded(UINT64 id, LoadFolderResponse *response)
+{
+    for (PrefetchedFolder &prefetched : this->prefetchedFolders)
+    {
+        if (prefetched.request == id && response->complete)
+        {
+            prefetched.items.Complete();
+        }
+    }
+    return 0;
+}
+
+
+LPARAM ContentPopup::ItemLoaded(UINT64, LoadItemResponse*)
+{
+    return 0;
+}
+
+
+/// <summary>
+/// Shows the icons which the core has extracted since the items of a folder were shown from the
+/// snapshot.
+/// </summary>
+void ContentPopup::FolderRefreshed(LPCWSTR path)
+{
+    if (this->noIcons)
+    {
+        return;
+    }
+
+    bool changed = false;
+    for (WATCHFOLDERMAP::iterator iter = this->watchedFolders.begin(); iter != this->watchedFolders.end(); ++iter)
+    {
+        WCHAR folderPath[MAX_PATH];
+        if (!SHGetPathFromIDListW(iter->second.idList, folderPath) || _wcsicmp(folderPath, path) != 0)
+        {
+            continue;
+        }
+
+        for (auto &item : iter->second.items)
+        {
+            if (item.second == nullptr || item.second->HasIcon())
+            {
+                continue;
+            }
+
+            IWICBitmap *cachedIcon = nCore::LoadCachedThumbnail(item.first.c_str(), PopupItem::ICON_EXTRACT_SIZE);
+            if (cachedIcon != nullptr)
+            {
+                item.second->SetIcon(cachedIcon);
+                changed = true;
+            }
+        }
+    }
+
+    if (changed)
+    {
+        mWindow->Repaint();
+    }
+}
+
+
+/// <summary>
+/// Applies the net effect of the changes to the watched folders since the last time. Items which
+/// are gone are removed, and items which are new, renamed or updated are loaded again and merged
+/// into the items.
+/// </summary>
+void ContentPopup::ApplyChanges()
+{
+    if (this->changeTimer != 0)
+    {
+        mWindow->ClearCallbackTimer(this->changeTimer);
+        this->changeTimer = 0;
+    }
+
+    vector<ItemRun> runs;
+    for (WATCHFOLDERMAP::iterator iter = this->watchedFolders.begin(); iter != this->watchedFolders.end(); ++iter)
+    {
+        WatchedFolder &watched = iter->second;
+        ChangeQueue::Changes changes = watched.changes.Take();
+        ItemRun run;
+
+        // Deletes go first, since items may have been renamed over deleted ones.
+        for (const std::wstring &name : changes.deleted)
+        {
+            ForgetItem(watched, name);
+        }
+
+        // A renamed item has a new title, so it's loaded again. Every old name is let go of before
+        // any new one is taken, since items may have swapped names.
+        for (const ChangeQueue::NameChange &change : changes.renamed)
+        {
+            ForgetItem(watched, change.from);
+        }
+        for (const ChangeQueue::NameChange &change : changes.renamed)
+        {
+            LoadChangedItem(watched, change.to, change.value, run);
+        }
+
+        for (const ChangeQueue::Change &change : changes.created)
+        {
+            LoadChangedItem(watched, change.key, change.value, run);
+        }
+
+        for (const ChangeQueue::Change &change : changes.updated)
+        {
+            LoadChangedItem(watched, change.key, change.value, run);
+        }
+
+        runs.push_back(std::move(run));
+    }
+
+    MergeItems(runs);
+}
+
+
+/// <summary>
+/// Removes the item which was loaded from a watched folder under a name. Folder items may show the
+/// folders of several sources, and only go once the last of them is gone.
+/// </summary>
+void ContentPopup::ForgetItem(WatchedFolder &watched, const std::wstring &name)
+{
+    ItemsByName::iterator entry = watched.items.find(name);
+    if (entry == watched.items.end())
+    {
+        return;
+    }
+
+    PopupItem *item = entry->second;
+    watched.items.erase(entry);
+    if (item == nullptr)
+    {
+        return;
+    }
+
+    if (item->IsFolder())
+    {
+        if (((nPopup::FolderItem*)item)->RemovePath(name.c_str()))
+        {
+            return;
+        }
+
+        for (auto folderItem = this->folderItems.begin(); folderItem != this->folderItems.end(); ++folderItem)
+        {
+            if (folderItem->second == item)
+            {
+                this->folderItems.erase(folderItem);
+                break;
+            }
+        }
+
+        // Other sources may still refer to the folder item, under the paths which they were merged in by.
+        for (WATCHFOLDERMAP::iterator iter = this->watchedFolders.begin(); iter != this->watchedFolders.end(); ++iter)
+        {
+            for (ItemsByName::iterator other = iter->second.items.begin(); other != iter->second.items.end();)
+            {
+                other = other->second == item ? iter->second.items.erase(other) : std::next(other);
+            }
+        }
+    }
+
+    RemoveItem(item);
+}
+
+
+void ContentPopup::LoadChangedItem(WatchedFolder &watched, const std::wstring &name, const SharedItemID &id, ItemRun &run)
+{
+    // An updated item replaces the old one. The name may also be taken already if a create
+    // notification came through twice.
+    ForgetItem(watched, name);
+
+    PopupItem *item = LoadSingleItem(watched.folder, (PIDLIST_RELATIVE)id.get(), false, nullptr, &watched.items);
+    if (item != nullptr)
+    {
+        run.push_back(item);
     }
 }
 
 
 LRESULT WINAPI ContentPopup::HandleMessage(HWND window, UINT message, WPARAM wParam, LPARAM lParam, LPVOID Window)
 {
+    if (message == WM_TIMER && wParam == this->changeTimer && this->changeTimer != 0)
+    {
+        ApplyChanges();
+        return 0;
+    }
+
     if (message >= Window::WM_FIRSTREGISTERED)
     {
-        WATCHFOLDERMAP::const_iterator folder = this->watchedFolders.find(message);
+        WATCHFOLDERMAP::iterator folder = this->watchedFolders.find(message);
         if (folder != this->watchedFolders.end())
         {
             long event;
@@ -348,34 +900,91 @@ LRESULT WINAPI ContentPopup::HandleMessage(HWND window, UINT message, WPARAM wPa
 
             if (notifyLock)
             {
-                // TODO::Have to handle deletes and renames as well
+                // Changes are queued up, and applied together once no more have come in for a little while.
+                WatchedFolder &watched = folder->second;
+                IShellFolder *shellFolder = watched.folder;
+                ChangeQueue &changes = watched.changes;
+                WCHAR name[MAX_PATH], newName[MAX_PATH];
+
+                ChangeEvent changeEvent = ChangeEvent::Update;
+                bool known = true;
                 switch (event)
                 {
                 case SHCNE_CREATE:
                 case SHCNE_MKDIR:
+                    changeEvent = ChangeEvent::Create;
+                    break;
+
+                case SHCNE_DELETE:
+                case SHCNE_RMDIR:
+                    changeEvent = ChangeEvent::Delete;
+                    break;
+
+                case SHCNE_ATTRIBUTES:
+                case SHCNE_UPDATEITEM:
+                    changeEvent = ChangeEvent::Update;
+                    break;
+
+                case SHCNE_RENAMEITEM:
+                case SHCNE_RENAMEFOLDER:
+                    changeEvent = ChangeEvent::Rename;
+                    break;
+
+                default:
+                    known = false;
+                    break;
+                }
+
+                // Item IDs are only names relative to the watched folder for its direct children.
+                bool isChild = idList[0] != nullptr && ILIsParent(watched.idList, idList[0], TRUE);
+                bool newIsChild = known && changeEvent == ChangeEvent::Rename && idList[1] != nullptr
+                    && ILIsParent(watched.idList, idList[1], TRUE);
+                PCUITEMID_CHILD item = isChild ? ILFindLastID(idList[0]) : nullptr;
+                PCUITEMID_CHILD newItem = newIsChild ? ILFindLastID(idList[1]) : nullptr;
+
+                switch (known ? ClassifyChildChange(changeEvent, isChild, newIsChild) : ChildChange::Ignore)
+                {
+                case ChildChange::Create:
+                    // Items which are moved in are reported under their new name.
+                    item = item != nullptr ? item : newItem;
+                    if (GetItemName(shellFolder, item, name, _countof(name)))
                     {
-                        LoadSingleItem(folder->second.second, (PIDLIST_RELATIVE)ILFindLastID(idList[0]), false);
-                        std::sort(this->items.begin(), this->items.end(), [] (PopupItem* a, PopupItem* b) { return a->CompareTo(b); });
+                        changes.Create(name, ShareItemID(item));
                     }
                     break;
 
-                // A non-folder item has been renamed.
-                case SHCNE_RENAMEITEM:
+                case ChildChange::Delete:
+                    if (GetItemName(shellFolder, item, name, _countof(name)))
                     {
-                        //TRACEW(L"Non-Folder renamed: %s -> %s", file1, file2);
+                        changes.Delete(name);
                     }
                     break;
 
-                // A folder has been renamed.
-                case SHCNE_RENAMEFOLDER:
+                case ChildChange::Update:
+                    if (GetItemName(shellFolder, item, name, _countof(name)))
+                    {
+                        changes.Update(name, ShareItemID(item));
+                    }
+                    break;
+
+                case ChildChange::Rename:
+                    if (GetItemName(shellFolder, item, name, _countof(name)) && GetItemName(shellFolder, newItem, newName, _countof(newName)))
                     {
-                        //TRACEW(L"Folder renamed: %s -> %s", file1, file2);
+                        changes.Rename(name, newName, ShareItemID(newItem));
                     }
                     break;
+
+                case ChildChange::Ignore:
+                    break;
                 }
 
                 SHChangeNotification_Unlock(notifyLock);
             }
+
+            if (!folder->second.changes.IsEmpty() && this->changeTimer == 0)
+            {
+                this->changeTimer = mWindow->SetCallbackTimer(this->changeDelay, this);
+            }
             return 0;
         }
     }
@@ -8,10 +8,18 @@
 #pragma once
 
 #include "Popup.hpp"
+#include "ChildChange.hpp"
 #include "FolderItem.hpp"
+#include "FolderPrefetch.hpp"
+#include "PopupSnapshot.hpp"
+#include "Snapshot.hpp"
+#include "../nCoreCom/Core.h"
+#include "../Utilities/ChangeCoalescer.hpp"
+#include "../Utilities/StringUtils.h"
+#include <memory>
 #include <ShlObj.h>
 
-class ContentPopup : public Popup {
+class ContentPopup : public Popup, public FileSystemLoaderResponseHandler, public Snapshot::RefreshHandler {
 public:
     enum ContentSource {
         PATH,
@@ -36,26 +44,78 @@ public:
     //
     void AddPath(LPCTSTR path);
 
+    // Stops showing the items of a path. Returns false if the popup has no paths left.
+    bool RemovePath(LPCTSTR path);
+
+    //
+    void Prefetch() override;
+    void CancelPrefetch() override;
+
+    // FileSystemLoaderResponseHandler
+    LPARAM FolderItemsFound(UINT64, LoadFolderItemsResponse*) override;
+    LPARAM FolderLoaded(UINT64, LoadFolderResponse*) override;
+    LPARAM ItemLoaded(UINT64, LoadItemResponse*) override;
+
+    // Snapshot::RefreshHandler
+    void FolderRefreshed(LPCWSTR path) override;
+
 protected:
     void PreShow() override;
     virtual void PostClose() override;
 
 private:
 
+    // Items loaded from one folder, which haven't been added to the popup yet.
+    typedef vector<PopupItem*> ItemRun;
+
     //
     void LoadContent();
 
     //
-    void LoadShellFolder(GUID folder, bool dontExpandFolders = false);
+    void LoadShellFolder(GUID folder, vector<ItemRun> &runs, bool dontExpandFolders = false);
 
     //
-    void LoadPath(LPCTSTR path);
+    void LoadPath(LPCTSTR path, vector<ItemRun> &runs);
 
-    //
-    void LoadFromIDList(IShellFolder *targetFolder, PIDLIST_ABSOLUTE idList, bool dontExpandFolders);
+    // Loads the items of a folder as a new run.
+    void LoadFromIDList(IShellFolder *targetFolder, PIDLIST_ABSOLUTE idList, bool dontExpandFolders, vector<ItemRun> &runs);
 
-    //
-    void LoadSingleItem(IShellFolder *targetFolder, PIDLIST_RELATIVE itemID, bool dontExpandFolders);
+    // Loads the items of a folder which has been prefetched as a new run, if the prefetch is complete and up to date.
+    bool LoadPrefetched(LPCTSTR path, vector<ItemRun> &runs);
+
+    // The items loaded from a folder, by parsing name. Entries which were merged into a folder item from another
+    // source map to that folder item.
+    typedef StringKeyedMaps<std::wstring, PopupItem*>::UnorderedMap ItemsByName;
+
+    // Starts watching a folder whose items have been loaded for changes. Takes over the reference to the folder, and
+    // the items.
+    void WatchFolder(IShellFolder *targetFolder, PIDLIST_ABSOLUTE idList, ItemsByName &items);
+
+    // Returns the new item, or nullptr if the item was merged into an existing folder or couldn't be loaded.
+    // If snapshot is given, the item is added to it. If names is given, the item is added to it unless it couldn't
+    // be loaded.
+    PopupItem *LoadSingleItem(IShellFolder *targetFolder, PIDLIST_RELATIVE itemID, bool dontExpandFolders, vector<PopupSnapshot::Item> *snapshot = nullptr, ItemsByName *names = nullptr);
+
+    // Returns the new item, or nullptr if the item was merged into an existing folder.
+    PopupItem *LoadSnapshotItem(const PopupSnapshot::Item &snapshotItem);
+
+    // Returns the new item, or nullptr if the item was merged into an existing folder.
+    PopupItem *CreateItem(LPCTSTR name, LPCTSTR command, bool openable);
+
+    // Returns the item an entry shows up as: the item created for it, or the folder item it was merged into.
+    PopupItem *GetShownItem(PopupItem *created, LPCTSTR name);
+
+    // Sorts each run, and merges them into the items, which are kept sorted.
+    void MergeItems(vector<ItemRun> &runs);
+
+    // Applies the changes which have been queued up for the watched folders.
+    void ApplyChanges();
+
+    // Releases the watched folders, and forgets about their changes.
+    void StopWatching();
+
+    // Cancels the prefetches, and releases the prefetched folders.
+    void ReleasePrefetches();
 
     // True if the content needs to be reloaded every time the popup is shown.
     bool dynamic;
@@ -69,9 +129,58 @@ private:
     // What to retrive the popup contents from.
     ContentSource source;
 
-    // Message, SHChangeNofityRegister return value, IShellFolder
-    typedef std::map<UINT, std::pair<ULONG, IShellFolder *>> WATCHFOLDERMAP;
+    // The folder items, by name, which folders from other sources with the same name are merged into.
+    StringKeyedMaps<std::wstring, nPopup::FolderItem*>::UnorderedMap folderItems;
+
+    // An item ID which is freed once the last reference to it is gone.
+    typedef std::shared_ptr<ITEMIDLIST> SharedItemID;
+
+    // Changes to the items of a folder, by parsing name.
+    typedef ChangeCoalescer<std::wstring, SharedItemID, CaseInsensitive::Hash, CaseInsensitive::Equal> ChangeQueue;
+
+    struct WatchedFolder
+    {
+        // SHChangeNotifyRegister return value.
+        ULONG notifyId;
+        IShellFolder *folder;
+        // The folder, which change notifications are checked against.
+        PIDLIST_ABSOLUTE idList;
+        // Changes which haven't been applied yet.
+        ChangeQueue changes;
+        // The items which were loaded from the folder.
+        ItemsByName items;
+    };
+
+    // Removes the item which was loaded from a watched folder under a name, if there is one.
+    void ForgetItem(WatchedFolder &watched, const std::wstring &name);
+
+    // Loads an item which has shown up in a watched folder, and adds it to the run.
+    void LoadChangedItem(WatchedFolder &watched, const std::wstring &name, const SharedItemID &id, ItemRun &run);
+
+    // Message -> folder
+    typedef std::map<UINT, WatchedFolder> WATCHFOLDERMAP;
 
     // Folders which this popup is watching for changes.
     WATCHFOLDERMAP watchedFolders;
+
+    // Fires when the queued up changes should be applied, or 0.
+    UINT_PTR changeTimer;
+
+    // How long to wait for more changes, in milliseconds.
+    UINT changeDelay;
+
+    struct PrefetchedFolder
+    {
+        // The path, as in paths.
+        std::wstring path;
+        IShellFolder2 *folder;
+        PIDLIST_ABSOLUTE idList;
+        // The FileSystemLoader request.
+        UINT64 request;
+        // The items, stamped with when the folder was last modified.
+        FolderPrefetch<UINT64, SharedItemID> items;
+    };
+
+    // The folders which are being, or have been, loaded ahead of time.
+    std::list<PrefetchedFolder> prefetchedFolders;
 };
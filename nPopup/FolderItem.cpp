@@ -116,6 +116,63 @@ void nPopup::FolderItem::AddPath(LPCTSTR path)
 }
 
 
+/// <summary>
+/// Stops showing the contents of a path in the child popup. If the path is the one the popup would
+/// be created from, the next path takes its place.
+/// </summary>
+/// <returns>False if the folder has no paths left.</returns>
+bool nPopup::FolderItem::RemovePath(LPCTSTR path)
+{
+    if (mPopup)
+    {
+        return ((ContentPopup*) mPopup)->RemovePath(path);
+    }
+
+    if (mCreationData)
+    {
+        if (_wcsicmp(mCreationData->command, path) != 0)
+        {
+            mCreationData->paths.remove_if([path] (const TCHAR (&other)[MAX_PATH]) { return _wcsicmp(other, path) == 0; });
+            return true;
+        }
+
+        if (mCreationData->paths.empty())
+        {
+            return false;
+        }
+        StringCchCopy(mCreationData->command, _countof(mCreationData->command), mCreationData->paths.front());
+        mCreationData->paths.pop_front();
+        return true;
+    }
+
+    return false;
+}
+
+
+/// <summary>
+/// Starts loading the contents of the child popup, since the user seems to be about to open it.
+/// </summary>
+void nPopup::FolderItem::Prefetch()
+{
+    if (GetPopup())
+    {
+        mPopup->Prefetch();
+    }
+}
+
+
+/// <summary>
+/// Stops loading the contents of the child popup, if Prefetch started to.
+/// </summary>
+void nPopup::FolderItem::CancelPrefetch()
+{
+    if (mPopup)
+    {
+        mPopup->CancelPrefetch();
+    }
+}
+
+
 /// <summary>
 /// 
 /// </summary>
@@ -58,6 +58,9 @@ namespace nPopup
         int GetDesiredWidth(int maxWidth);
         Popup* GetPopup();
         void AddPath(LPCTSTR path);
+        bool RemovePath(LPCTSTR path);
+        void Prefetch();
+        void CancelPrefetch();
 
     private:
         Popup *mPopup;
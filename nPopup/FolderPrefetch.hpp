@@ -0,0 +1,123 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  FolderPrefetch.hpp
+ *  The nModules Project
+ *
+ *  The items of a folder, loaded before they are needed.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#pragma once
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Collects the items of a folder while they are loaded in the background. The prefetch remembers
+/// what the folder looked like when it started, e.g. when it was last modified, and is thrown away
+/// if the folder has changed by the time the items are needed.
+///
+/// A prefetch which is cancelled, or destroyed, while it is loading stops the load.
+/// </summary>
+template <typename Stamp, typename Item>
+class FolderPrefetch
+{
+public:
+    enum class State
+    {
+        // Not started.
+        Idle,
+        Loading,
+        Complete,
+        // The items have been taken, or thrown away.
+        Finished
+    };
+
+public:
+    FolderPrefetch()
+        : mState(State::Idle)
+    {
+    }
+
+    ~FolderPrefetch()
+    {
+        Cancel();
+    }
+
+    FolderPrefetch(const FolderPrefetch&) = delete;
+    FolderPrefetch &operator=(const FolderPrefetch&) = delete;
+
+public:
+    /// <param name="stamp">What the folder looks like now.</param>
+    /// <param name="cancel">Stops the load which delivers the items.</param>
+    void Start(const Stamp &stamp, std::function<void()> cancel)
+    {
+        Cancel();
+        mStamp = stamp;
+        mCancel = std::move(cancel);
+        mItems.clear();
+        mState = State::Loading;
+    }
+
+    // Items which arrive after the prefetch has been cancelled are ignored.
+    void Add(Item &&item)
+    {
+        if (mState == State::Loading)
+        {
+            mItems.push_back(std::move(item));
+        }
+    }
+
+    void Complete()
+    {
+        if (mState == State::Loading)
+        {
+            mState = State::Complete;
+            mCancel = nullptr;
+        }
+    }
+
+    void Cancel()
+    {
+        if (mState == State::Loading && mCancel)
+        {
+            mCancel();
+        }
+        mCancel = nullptr;
+        mItems.clear();
+        if (mState != State::Idle)
+        {
+            mState = State::Finished;
+        }
+    }
+
+    /// <summary>
+    /// Hands over the items, if they have all been loaded and the folder still looks the way it did
+    /// when the prefetch started. Otherwise, the prefetch is cancelled. Either way, the prefetch
+    /// can't be used again.
+    /// </summary>
+    /// <param name="stamp">What the folder looks like now.</param>
+    bool Take(const Stamp &stamp, std::vector<Item> &items)
+    {
+        if (mState != State::Complete || !(mStamp == stamp))
+        {
+            Cancel();
+            return false;
+        }
+
+        items = std::move(mItems);
+        mItems.clear();
+        mState = State::Finished;
+        return true;
+    }
+
+    State GetState() const
+    {
+        return mState;
+    }
+
+private:
+    State mState;
+    Stamp mStamp;
+    std::function<void()> mCancel;
+    std::vector<Item> mItems;
+};
@@ -0,0 +1,147 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  HoverIntent.cpp
+ *  The nModules Project
+ *
+ *  Guesses which item of a popup the user is about to open.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "HoverIntent.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// How far back the samples the direction of the mouse is worked out from go.
+static const double SAMPLE_WINDOW = 0.1;
+
+// The shortest stretch of time the direction of the mouse is worked out over. Any shorter, and a
+// single jittery sample decides where the mouse is heading.
+static const double MIN_SAMPLE_SPAN = 0.03;
+
+
+HoverIntent::HoverIntent(double dwellTime, float dwellRadius, float proximity, double aimTime, float minSpeed)
+    : mDwellTime(dwellTime)
+    , mDwellRadius(dwellRadius)
+    , mProximity(proximity)
+    , mAimTime(aimTime)
+    , mMinSpeed(minSpeed)
+    , mResting(false)
+{
+}
+
+
+void HoverIntent::SetTargets(std::vector<Area> &&targets)
+{
+    mTargets = std::move(targets);
+}
+
+
+HoverIntent::Target HoverIntent::Move(float x, float y, double now)
+{
+    Sample sample = { x, y, now };
+    mSamples.push_back(sample);
+    while (mSamples.size() > 2 && now - mSamples[1].time >= SAMPLE_WINDOW)
+    {
+        mSamples.pop_front();
+    }
+
+    if (!mResting || std::hypot(x - mRest.x, y - mRest.y) > mDwellRadius)
+    {
+        mRest = sample;
+        mResting = true;
+    }
+
+    // Where the mouse is heading says more than where it happens to be.
+    const Sample &oldest = mSamples.front();
+    double span = now - oldest.time;
+    if (span >= MIN_SAMPLE_SPAN)
+    {
+        float dx = float((x - oldest.x) / span);
+        float dy = float((y - oldest.y) / span);
+        if (std::hypot(dx, dy) >= mMinSpeed)
+        {
+            Target target = FindAimedAt(sample, dx, dy);
+            if (target != nullptr)
+            {
+                return target;
+            }
+        }
+    }
+
+    if (now - mRest.time >= mDwellTime)
+    {
+        return FindClosest(x, y);
+    }
+
+    return nullptr;
+}
+
+
+void HoverIntent::Leave()
+{
+    mSamples.clear();
+    mResting = false;
+}
+
+
+HoverIntent::Target HoverIntent::FindAimedAt(const Sample &from, float dx, float dy) const
+{
+    Target best = nullptr;
+    double bestTime = mAimTime;
+
+    for (const Area &area : mTargets)
+    {
+        // Work out when the mouse enters and leaves the area along each axis, and so overall.
+        double enter = 0.0, leave = std::numeric_limits<double>::infinity();
+        const float position[] = { from.x, from.y };
+        const float velocity[] = { dx, dy };
+        const float low[] = { area.left, area.top };
+        const float high[] = { area.right, area.bottom };
+
+        bool hits = true;
+        for (int axis = 0; axis < 2 && hits; ++axis)
+        {
+            if (velocity[axis] == 0.0f)
+            {
+                hits = position[axis] >= low[axis] && position[axis] <= high[axis];
+            }
+            else
+            {
+                double first = (low[axis] - position[axis]) / velocity[axis];
+                double second = (high[axis] - position[axis]) / velocity[axis];
+                enter = std::max(enter, std::min(first, second));
+                leave = std::min(leave, std::max(first, second));
+                hits = enter <= leave;
+            }
+        }
+
+        if (hits && enter <= bestTime)
+        {
+            best = area.target;
+            bestTime = enter;
+        }
+    }
+
+    return best;
+}
+
+
+HoverIntent::Target HoverIntent::FindClosest(float x, float y) const
+{
+    Target best = nullptr;
+    float bestDistance = mProximity;
+
+    for (const Area &area : mTargets)
+    {
+        float dx = std::max(std::max(area.left - x, x - area.right), 0.0f);
+        float dy = std::max(std::max(area.top - y, y - area.bottom), 0.0f);
+        float distance = std::hypot(dx, dy);
+        if (distance <= bestDistance)
+        {
+            best = area.target;
+            bestDistance = distance;
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,82 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  HoverIntent.hpp
+ *  The nModules Project
+ *
+ *  Guesses which item of a popup the user is about to open.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#pragma once
+
+#include <deque>
+#include <vector>
+
+/// <summary>
+/// Guesses which item the user is about to open from how the mouse moves, so that whatever the item
+/// opens can be loaded ahead of time. An item is intended when the mouse is heading towards it, fast
+/// enough to get there soon, or when the mouse has been resting close to it for a while.
+///
+/// Positions are in pixels, and times in seconds.
+/// </summary>
+class HoverIntent
+{
+public:
+    typedef const void *Target;
+
+    struct Area
+    {
+        Target target;
+        float left, top, right, bottom;
+    };
+
+public:
+    /// <param name="dwellTime">How long the mouse has to rest close to an item.</param>
+    /// <param name="dwellRadius">How far the mouse may wander while it is resting.</param>
+    /// <param name="proximity">How close to an item the mouse has to rest.</param>
+    /// <param name="aimTime">How soon the mouse has to reach an item it is heading towards.</param>
+    /// <param name="minSpeed">How fast the mouse has to move, in pixels per second, to be heading anywhere.</param>
+    HoverIntent(double dwellTime, float dwellRadius, float proximity, double aimTime, float minSpeed);
+
+public:
+    // Replaces the items which may be intended.
+    void SetTargets(std::vector<Area> &&targets);
+
+    /// <summary>
+    /// Records where the mouse is. Should be called regularly while the mouse is over the popup,
+    /// whether it moves or not, since resting is only noticed here.
+    /// </summary>
+    /// <returns>The item the user seems to be about to open, or nullptr.</returns>
+    Target Move(float x, float y, double now);
+
+    // Forgets about the mouse, e.g. when it leaves the popup.
+    void Leave();
+
+private:
+    struct Sample
+    {
+        float x, y;
+        double time;
+    };
+
+private:
+    // The item the mouse reaches first, within the aim time, if it keeps going.
+    Target FindAimedAt(const Sample &from, float dx, float dy) const;
+
+    // The closest item which the point is within the proximity of.
+    Target FindClosest(float x, float y) const;
+
+private:
+    const double mDwellTime;
+    const float mDwellRadius;
+    const float mProximity;
+    const double mAimTime;
+    const float mMinSpeed;
+
+    std::vector<Area> mTargets;
+
+    // The most recent positions of the mouse, oldest first.
+    std::deque<Sample> mSamples;
+
+    // Where, and since when, the mouse has been resting.
+    Sample mRest;
+    bool mResting;
+};
@@ -15,12 +15,29 @@
 #include "../nCoreCom/Core.h"
 #include <algorithm>
 
+// How often the mouse is sampled while it is over a popup, in milliseconds.
+static const UINT HOVER_SAMPLE_INTERVAL = 25;
+
+// How far the mouse may wander while it rests by an item, in pixels.
+static const float HOVER_DWELL_RADIUS = 4.0f;
+
+// How close to an item the mouse has to rest, in pixels.
+static const float HOVER_PROXIMITY = 8.0f;
+
+// How fast the mouse has to move to be heading towards an item, in pixels per second.
+static const float HOVER_MIN_SPEED = 200.0f;
+
 
 Popup::Popup(LPCTSTR title, LPCTSTR bang, LPCTSTR prefix)
     : Drawable(prefix)
     , bang(bang != nullptr ? _wcsdup(bang) : nullptr)
     , openChild(nullptr)
     , owner(nullptr)
+    , mHoverIntent(mSettings->GetInt(L"PrefetchDwellTime", 150) / 1000.0, HOVER_DWELL_RADIUS, HOVER_PROXIMITY,
+        mSettings->GetInt(L"PrefetchAimTime", 250) / 1000.0, HOVER_MIN_SPEED)
+    , mHasHoverTargets(false)
+    , mHoverTimer(0)
+    , mPrefetchItem(nullptr)
 {
     this->itemSpacing = mSettings->GetInt(L"ItemSpacing", 2);
     this->maxWidth = mSettings->GetInt(L"MaxWidth", 300);
@@ -30,6 +47,7 @@ Popup::Popup(LPCTSTR title, LPCTSTR bang, LPCTSTR prefix)
     this->confineToWorkArea = mSettings->GetBool(L"ConfineToWorkArea", false);
     mChildOffsetX = mSettings->GetInt(L"ChildOffsetX", 0);
     mChildOffsetY = mSettings->GetInt(L"ChildOffsetY", 0);
+    mPrefetch = mSettings->GetBool(L"Prefetch", true);
     this->padding = mSettings->GetOffsetRect(L"Padding", 5, 5, 5, 5);
 
     mPopupSettings.Load(mSettings);
@@ -73,7 +91,14 @@ Popup::~Popup()
 void Popup::AddItem(PopupItem* item)
 {
     this->items.push_back(item);
+    ItemsChanged();
+}
+
+
+void Popup::ItemsChanged()
+{
     this->sized = false;
+    UpdateHoverTargets();
     if (mWindow->IsVisible())
     {
         /*MonitorInfo* monInfo = mWindow->GetMonitorInformation();
@@ -95,8 +120,48 @@ void Popup::AddItem(PopupItem* item)
 }
 
 
-void Popup::RemoveItem(PopupItem* /* item */)
+/// <summary>
+/// Removes an item from the popup, and deletes it.
+/// </summary>
+void Popup::RemoveItem(PopupItem* item)
+{
+    vector<PopupItem*>::iterator position = std::find(this->items.begin(), this->items.end(), item);
+    if (position == this->items.end())
+    {
+        return;
+    }
+
+    if (item == this->childItem)
+    {
+        CloseChild();
+    }
+    if (item == mPrefetchItem)
+    {
+        ((nPopup::FolderItem*)mPrefetchItem)->CancelPrefetch();
+        mPrefetchItem = nullptr;
+    }
+
+    this->items.erase(position);
+    delete item;
+    ItemsChanged();
+}
+
+
+void Popup::ClearItems()
 {
+    CloseChild();
+    if (mPrefetchItem != nullptr)
+    {
+        ((nPopup::FolderItem*)mPrefetchItem)->CancelPrefetch();
+        mPrefetchItem = nullptr;
+    }
+
+    for (PopupItem *item : this->items)
+    {
+        delete item;
+    }
+    this->items.clear();
+    ItemsChanged();
 }
 
 
@@ -142,6 +207,91 @@ LPCTSTR Popup::GetBang()
 }
 
 
+void Popup::Prefetch()
+{
+}
+
+
+void Popup::CancelPrefetch()
+{
+}
+
+
+void Popup::UpdateHoverTargets()
+{
+    std::vector<HoverIntent::Area> targets;
+    for (PopupItem *item : this->items)
+    {
+        if (item->IsFolder())
+        {
+            D2D1_RECT_F rect = item->GetDrawingRect();
+            HoverIntent::Area area = { item, rect.left, rect.top, rect.right, rect.bottom };
+            targets.push_back(area);
+        }
+    }
+
+    mHasHoverTargets = !targets.empty();
+    mHoverIntent.SetTargets(std::move(targets));
+}
+
+
+void Popup::StartTrackingHoverIntent()
+{
+    // Popups without folders have nothing to prefetch.
+    if (!mHasHoverTargets)
+    {
+        return;
+    }
+
+    mHoverClock.Clock();
+    mHoverTimer = mWindow->SetCallbackTimer(HOVER_SAMPLE_INTERVAL, this);
+}
+
+
+void Popup::TrackHoverIntent()
+{
+    POINT pt;
+    GetCursorPos(&pt);
+    ScreenToClient(mWindow->GetWindowHandle(), &pt);
+
+    // The mouse may well be on its way into the child which is being prefetched.
+    D2D1_SIZE_F size = mWindow->GetSize();
+    if (pt.x < 0 || pt.y < 0 || pt.x > size.width || pt.y > size.height)
+    {
+        StopTrackingHoverIntent(false);
+        return;
+    }
+
+    PopupItem *target = (PopupItem*)mHoverIntent.Move(float(pt.x), float(pt.y), mHoverClock.GetTime());
+    if (target != nullptr && target != mPrefetchItem)
+    {
+        if (mPrefetchItem != nullptr)
+        {
+            ((nPopup::FolderItem*)mPrefetchItem)->CancelPrefetch();
+        }
+        mPrefetchItem = target;
+        ((nPopup::FolderItem*)mPrefetchItem)->Prefetch();
+    }
+}
+
+
+void Popup::StopTrackingHoverIntent(bool closing)
+{
+    if (mHoverTimer != 0)
+    {
+        mWindow->ClearCallbackTimer(mHoverTimer);
+        mHoverTimer = 0;
+    }
+    mHoverIntent.Leave();
+
+    if (closing && mPrefetchItem != nullptr)
+    {
+        ((nPopup::FolderItem*)mPrefetchItem)->CancelPrefetch();
+        mPrefetchItem = nullptr;
+    }
+}
+
+
 bool Popup::CheckFocus(HWND newActive, __int8 direction)
 {
     if (mWindow->GetWindowHandle() == newActive || this->mouseOver)
@@ -240,6 +390,9 @@ void Popup::Size(LPRECT limits)
     // Size the main window
     mWindow->Resize((float)width, (float)height);
     this->sized = true;
+
+    // The items have moved.
+    UpdateHoverTargets();
 }
 
 
@@ -303,6 +456,8 @@ LRESULT Popup::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARAM lParam
     {
     case Window::WM_HIDDEN:
         {
+            // The items may be about to be deleted.
+            StopTrackingHoverIntent(true);
             PostClose();
         }
         return 0;
@@ -321,8 +476,20 @@ LRESULT Popup::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARAM lParam
 
     case WM_MOUSEMOVE:
         this->mouseOver = true;
+        if (mPrefetch && mHoverTimer == 0)
+        {
+            StartTrackingHoverIntent();
+        }
         return 0;
 
+    case WM_TIMER:
+        if (wParam == mHoverTimer && mHoverTimer != 0)
+        {
+            TrackHoverIntent();
+            return 0;
+        }
+        return DefWindowProc(window, msg, wParam, lParam);
+
     case WM_MOUSELEAVE:
         this->mouseOver = false;
         return 0;
@@ -11,10 +11,12 @@ class Popup;
 
 #include "PopupItem.hpp"
 #include "PopupSettings.hpp"
+#include "HoverIntent.hpp"
 #include <vector>
 #include "../nShared/MessageHandler.hpp"
 #include "../nShared/Settings.hpp"
 #include "../nShared/Window.hpp"
+#include "../Utilities/StopWatch.hpp"
 
 using std::vector;
 
@@ -44,6 +46,12 @@ public:
     // Called by items, children, or the owner.
     virtual void Close();
 
+    // Called by the owner when the popup seems to be about to be opened, to load its contents ahead of time.
+    virtual void Prefetch();
+
+    // Called by the owner when the popup no longer seems to be about to be opened.
+    virtual void CancelPrefetch();
+
     //
     LPCTSTR GetBang();
 
@@ -68,6 +76,12 @@ protected:
     //
     void Size(LPRECT limits);
 
+    // Should be called after the items have been modified directly.
+    void ItemsChanged();
+
+    // Removes and deletes every item.
+    void ClearItems();
+
     //
     vector<PopupItem*> items;
 
@@ -78,6 +92,18 @@ private:
     //
     bool CheckFocus(HWND newActive, __int8 direction);
 
+    // Gives the hover intent the folder items, where they are now. Called whenever the items change or move.
+    void UpdateHoverTargets();
+
+    // Starts sampling the mouse, to find out which folder the user is about to open.
+    void StartTrackingHoverIntent();
+
+    // Samples the mouse, and prefetches the folder the user seems to be about to open.
+    void TrackHoverIntent();
+
+    // Stops sampling the mouse. Also cancels the prefetch if the popup is closing.
+    void StopTrackingHoverIntent(bool closing);
+
     //
     int itemSpacing;
 
@@ -113,4 +139,22 @@ private:
 
     int mChildOffsetX;
     int mChildOffsetY;
+
+    // True if folders should be loaded when the user seems to be about to open them.
+    bool mPrefetch;
+
+    // Guesses which folder the user is about to open.
+    HoverIntent mHoverIntent;
+
+    // True if any of the items is a folder, which the hover intent may pick.
+    bool mHasHoverTargets;
+
+    // The time since tracking started, which the mouse samples are taken at.
+    StopWatch mHoverClock;
+
+    // Fires while the mouse is over the popup, or 0.
+    UINT_PTR mHoverTimer;
+
+    // The folder item whose contents are being prefetched, or nullptr.
+    PopupItem *mPrefetchItem;
 };
@@ -7,18 +7,17 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 #include "Popup.hpp"
 #include "../nShared/LSModule.hpp"
-#include "IconCache.hpp"
+#include "../nCoreCom/Core.h"
 #include <shellapi.h>
 
 
 extern LSModule gLSModule;
-static IconCache iconCache;
 
 
 PopupItem::PopupItem(Drawable* parent, LPCTSTR prefix, Type type, bool independent)
     : Drawable(parent, prefix, independent)
     , mItemType(type)
-    , mHasIcon(false)
+    , mIcon(nullptr)
 {
     this->iconSettings = mSettings->CreateChild(L"Icon");
 }
@@ -27,9 +26,9 @@ PopupItem::PopupItem(Drawable* parent, LPCTSTR prefix, Type type, bool independe
 PopupItem::~PopupItem()
 {
     SAFEDELETE(this->iconSettings);
-    if (mHasIcon)
+    if (mIcon != nullptr)
     {
-        iconCache.ReleaseIcon(mIconHash);
+        nCore::ReleaseIcon(mIcon);
     }
 }
 
@@ -58,6 +57,21 @@ bool PopupItem::CheckMerge(LPCWSTR name)
 }
 
 
+bool PopupItem::IsFolder()
+{
+    return mItemType == Type::Folder;
+}
+
+
+/// <summary>
+/// Where the item is, relative to the popup.
+/// </summary>
+D2D1_RECT_F PopupItem::GetDrawingRect()
+{
+    return mWindow->GetDrawingRect();
+}
+
+
 bool PopupItem::ParseDotIcon(LPCTSTR dotIcon)
 {
     if (dotIcon == NULL || ((Popup*)mParent)->noIcons)
@@ -88,13 +102,31 @@ bool PopupItem::ParseDotIcon(LPCTSTR dotIcon)
 }
 
 
-void PopupItem::AddIcon(HICON icon) {
+D2D1_RECT_F PopupItem::GetIconPosition() {
     D2D1_RECT_F f;
     f.top = this->iconSettings->GetFloat(L"Y", 2.0f);
     f.bottom = f.top + this->iconSettings->GetFloat(L"Size", 16.0f);
     f.left = this->iconSettings->GetFloat(L"X", 2.0f);
     f.right = f.left + this->iconSettings->GetFloat(L"Size", 16.0f);
-    this->iconOverlay = mWindow->AddOverlay(f, icon);
+    return f;
+}
+
+
+void PopupItem::AddIcon(HICON icon) {
+    this->iconOverlay = mWindow->AddOverlay(GetIconPosition(), icon);
+}
+
+
+/// <summary>
+/// Sets the icon to one from the core's thumbnail cache. Takes ownership of the bitmap.
+/// </summary>
+void PopupItem::SetIcon(IWICBitmap* icon) {
+    this->iconOverlay = mWindow->AddOverlay(GetIconPosition(), icon);
+}
+
+
+bool PopupItem::HasIcon() {
+    return this->iconOverlay.mValid;
 }
 
 
@@ -103,7 +135,7 @@ bool PopupItem::CompareTo(PopupItem* b) {
 }
 
 
-void PopupItem::SetIcon(IExtractIconW* extractIcon) {
+void PopupItem::SetIcon(IExtractIconW* extractIcon, LPCWSTR path) {
     HICON icon = NULL;
     WCHAR iconFile[MAX_PATH];
     int iconIndex = 0;
@@ -118,21 +150,20 @@ void PopupItem::SetIcon(IExtractIconW* extractIcon) {
         //
         if (SUCCEEDED(hr))
         {
-            mIconHash = iconCache.ComputeHash(iconFile, iconIndex);
-
-            icon = iconCache.GetIcon(mIconHash);
+            // Other popups, and other modules, may already have extracted this icon.
+            mIcon = nCore::FindIcon(iconFile, iconIndex, ICON_EXTRACT_SIZE);
 
-            if (icon)
+            if (mIcon)
             {
-                mHasIcon = true;
-                AddIcon(icon);
+                AddIcon(mIcon);
+                nCore::CacheThumbnailIcon(path, ICON_EXTRACT_SIZE, mIcon);
             }
             else
             {
                 // Extract the icon.
                 if (SUCCEEDED(hr))
                 {
-                    hr = extractIcon->Extract(iconFile, iconIndex, &icon, NULL, MAKELONG(64, 0));
+                    hr = extractIcon->Extract(iconFile, iconIndex, &icon, NULL, MAKELONG(ICON_EXTRACT_SIZE, 0));
                 }
     
                 // If the extraction failed, fall back to a 32x32 icon.
@@ -154,7 +185,10 @@ void PopupItem::SetIcon(IExtractIconW* extractIcon) {
 
                 if (SUCCEEDED(hr) && icon != NULL)
                 {
-                    AddIcon(icon);
+                    // The store may hand back an identical icon it already has.
+                    mIcon = nCore::StoreIcon(iconFile, iconIndex, ICON_EXTRACT_SIZE, icon);
+                    AddIcon(mIcon);
+                    nCore::CacheThumbnailIcon(path, ICON_EXTRACT_SIZE, mIcon);
                 }
                 else
                 {
@@ -165,16 +199,13 @@ void PopupItem::SetIcon(IExtractIconW* extractIcon) {
 
                     if (icon != NULL)
                     {
-                        AddIcon(icon);
+                        // Not under the item's location, or every later lookup for it would find
+                        // the default icon instead of trying to extract the real one again.
+                        mIcon = nCore::StoreIcon(nullptr, 0, ICON_EXTRACT_SIZE, icon);
+                        AddIcon(mIcon);
                         hr = S_FALSE;
                     }
                 }
-
-                if (icon != nullptr)
-                {
-                    mHasIcon = true;
-                    iconCache.StoreIcon(mIconHash, icon);
-                }
             }
         }
     }
@@ -24,6 +24,10 @@ protected:
         Separator
     };
 
+public:
+    // The size icons of shell items are extracted at.
+    static const UINT ICON_EXTRACT_SIZE = 64;
+
 public:
     explicit PopupItem(Drawable* parent, LPCTSTR prefix, Type type, bool independent = false);
     virtual ~PopupItem();
@@ -31,14 +35,19 @@ public:
     virtual LRESULT WINAPI HandleMessage(HWND, UINT, WPARAM, LPARAM, LPVOID) = 0;
     int GetHeight();
     bool CompareTo(PopupItem* b);
-    void SetIcon(IExtractIconW* extractIcon);
+    void SetIcon(IExtractIconW* extractIcon, LPCWSTR path);
+    void SetIcon(IWICBitmap* icon);
+    bool HasIcon();
     void SetWidth(int width);
     virtual int GetDesiredWidth(int maxWidth) = 0;
     bool CheckMerge(LPCWSTR name);
+    bool IsFolder();
+    D2D1_RECT_F GetDrawingRect();
 
 protected:
     bool ParseDotIcon(LPCTSTR dotIcon);
     void AddIcon(HICON icon);
+    D2D1_RECT_F GetIconPosition();
 
     Settings* iconSettings;
 
@@ -47,6 +56,6 @@ protected:
     Window::OVERLAY iconOverlay;
 
 private:
-    UINT32 mIconHash;
-    bool mHasIcon;
+    // The icon from nCore's icon store, if there is one.
+    HICON mIcon;
 };
@@ -0,0 +1,297 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  PopupSnapshot.cpp
+ *  The nModules Project
+ *
+ *  What the folders shown in popups contained, the last time they were loaded.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "PopupSnapshot.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+// Identifies the file, and the version of its layout.
+static const uint32_t SNAPSHOT_MAGIC = 0x5350504E;  // NPPS
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+// Anything longer than this is not a path, and most likely a damaged snapshot.
+static const uint32_t MAX_STRING_LENGTH = 32768;
+
+// Items are flagged as folders in here.
+static const uint32_t ITEM_FOLDER = 0x1;
+
+
+/// <summary>
+/// The start of the snapshot. The folders follow, each as a FolderHeader, the path, and then the
+/// items, each as an ItemHeader, the title and the command. Strings are stored as UTF-16, whatever
+/// the size of wchar_t.
+/// </summary>
+struct SnapshotHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t folderCount;
+    uint32_t reserved;
+
+    // Of everything after the header.
+    uint64_t checksum;
+};
+
+
+struct FolderHeader
+{
+    uint64_t modifiedTime;
+    uint32_t pathLength;
+    uint32_t itemCount;
+};
+
+
+struct ItemHeader
+{
+    uint32_t titleLength;
+    uint32_t commandLength;
+    uint32_t flags;
+};
+
+
+/// <summary>
+/// 64-bit FNV-1a.
+/// </summary>
+static uint64_t Hash(const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t*)data;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+static void Append(std::vector<uint8_t> &data, const void *source, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t*)source;
+    data.insert(data.end(), bytes, bytes + size);
+}
+
+
+static void AppendString(std::vector<uint8_t> &data, const std::wstring &string)
+{
+    for (wchar_t character : string)
+    {
+        uint16_t unit = uint16_t(character);
+        Append(data, &unit, sizeof(unit));
+    }
+}
+
+
+/// <summary>
+/// Reads through a snapshot, never past its end.
+/// </summary>
+class SnapshotReader
+{
+public:
+    SnapshotReader(const uint8_t *data, size_t size)
+        : mPosition(data)
+        , mEnd(data + size)
+    {
+    }
+
+public:
+    bool Read(void *target, size_t size)
+    {
+        if (GetRemaining() < size)
+        {
+            return false;
+        }
+        memcpy(target, mPosition, size);
+        mPosition += size;
+        return true;
+    }
+
+    bool ReadString(std::wstring &string, uint32_t length)
+    {
+        if (length > MAX_STRING_LENGTH || GetRemaining() < length * sizeof(uint16_t))
+        {
+            return false;
+        }
+        string.resize(length);
+        for (uint32_t i = 0; i < length; ++i)
+        {
+            uint16_t unit;
+            memcpy(&unit, mPosition, sizeof(unit));
+            mPosition += sizeof(unit);
+            string[i] = wchar_t(unit);
+        }
+        return true;
+    }
+
+    size_t GetRemaining() const
+    {
+        return size_t(mEnd - mPosition);
+    }
+
+private:
+    const uint8_t *mPosition;
+    const uint8_t *mEnd;
+};
+
+
+PopupSnapshot::PopupSnapshot()
+    : mDirty(false)
+{
+    static_assert(sizeof(SnapshotHeader) == 24, "The snapshot header should not have any padding");
+    static_assert(sizeof(FolderHeader) == 16, "Folder headers should not have any padding");
+    static_assert(sizeof(ItemHeader) == 12, "Item headers should not have any padding");
+}
+
+
+bool PopupSnapshot::Read(const uint8_t *data, size_t size)
+{
+    mFolders.clear();
+    mDirty = false;
+
+    SnapshotReader reader(data, size);
+    SnapshotHeader header;
+    if (!reader.Read(&header, sizeof(header)) || header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION
+        || header.checksum != Hash(data + sizeof(header), size - sizeof(header)))
+    {
+        return false;
+    }
+
+    for (uint32_t folderIndex = 0; folderIndex < header.folderCount; ++folderIndex)
+    {
+        FolderHeader folderHeader;
+        std::wstring path;
+        if (!reader.Read(&folderHeader, sizeof(folderHeader)) || !reader.ReadString(path, folderHeader.pathLength)
+            || folderHeader.itemCount > reader.GetRemaining() / sizeof(ItemHeader))
+        {
+            mFolders.clear();
+            return false;
+        }
+
+        Folder &folder = mFolders[path];
+        folder.modifiedTime = folderHeader.modifiedTime;
+        folder.verified = false;
+        folder.items.resize(folderHeader.itemCount);
+        for (Item &item : folder.items)
+        {
+            ItemHeader itemHeader;
+            if (!reader.Read(&itemHeader, sizeof(itemHeader)) || !reader.ReadString(item.title, itemHeader.titleLength)
+                || !reader.ReadString(item.command, itemHeader.commandLength))
+            {
+                mFolders.clear();
+                return false;
+            }
+            item.folder = (itemHeader.flags & ITEM_FOLDER) != 0;
+        }
+    }
+
+    if (reader.GetRemaining() != 0)
+    {
+        mFolders.clear();
+        return false;
+    }
+
+    return true;
+}
+
+
+void PopupSnapshot::Write(std::vector<uint8_t> &data) const
+{
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.folderCount = uint32_t(mFolders.size());
+
+    data.assign(sizeof(header), 0);
+    for (auto &entry : mFolders)
+    {
+        const Folder &folder = entry.second;
+        FolderHeader folderHeader = { folder.modifiedTime, uint32_t(entry.first.size()), uint32_t(folder.items.size()) };
+        Append(data, &folderHeader, sizeof(folderHeader));
+        AppendString(data, entry.first);
+
+        for (const Item &item : folder.items)
+        {
+            ItemHeader itemHeader = { uint32_t(item.title.size()), uint32_t(item.command.size()), item.folder ? ITEM_FOLDER : 0 };
+            Append(data, &itemHeader, sizeof(itemHeader));
+            AppendString(data, item.title);
+            AppendString(data, item.command);
+        }
+    }
+
+    header.checksum = Hash(data.data() + sizeof(header), data.size() - sizeof(header));
+    memcpy(data.data(), &header, sizeof(header));
+}
+
+
+void PopupSnapshot::Validate(const StampFunction &getStamp)
+{
+    for (auto iter = mFolders.begin(); iter != mFolders.end();)
+    {
+        uint64_t modifiedTime;
+        if (!getStamp(iter->first, &modifiedTime) || modifiedTime != iter->second.modifiedTime)
+        {
+            iter = mFolders.erase(iter);
+            mDirty = true;
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+
+const PopupSnapshot::Folder *PopupSnapshot::Find(const std::wstring &path, uint64_t modifiedTime) const
+{
+    auto folder = mFolders.find(path);
+    if (folder == mFolders.end() || folder->second.modifiedTime != modifiedTime)
+    {
+        return nullptr;
+    }
+    return &folder->second;
+}
+
+
+void PopupSnapshot::Store(const std::wstring &path, uint64_t modifiedTime, std::vector<Item> &&items)
+{
+    auto sameItem = [] (const Item &a, const Item &b)
+    {
+        return a.folder == b.folder && a.title == b.title && a.command == b.command;
+    };
+
+    auto inserted = mFolders.emplace(path, Folder());
+    Folder &folder = inserted.first->second;
+    bool changed = inserted.second || folder.modifiedTime != modifiedTime || folder.items.size() != items.size()
+        || !std::equal(items.begin(), items.end(), folder.items.begin(), sameItem);
+
+    folder.verified = true;
+    if (changed)
+    {
+        folder.modifiedTime = modifiedTime;
+        folder.items = std::move(items);
+        mDirty = true;
+    }
+}
+
+
+size_t PopupSnapshot::GetFolderCount() const
+{
+    return mFolders.size();
+}
+
+
+bool PopupSnapshot::IsDirty() const
+{
+    return mDirty;
+}
+
+
+void PopupSnapshot::ClearDirty()
+{
+    mDirty = false;
+}
@@ -0,0 +1,87 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  PopupSnapshot.hpp
+ *  The nModules Project
+ *
+ *  What the folders shown in popups contained, the last time they were loaded.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#pragma once
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// The items of the folders shown in popups, as they were the last time the folders were loaded, so
+/// that a popup can be shown right after startup without enumerating its folders first. Every
+/// folder is stamped with when it was last modified, and is only used while that still holds.
+///
+/// Kept on disk in a compact binary format, which is checked for damage when it is read. Paths are
+/// compared exactly, so they should be normalized first.
+/// </summary>
+class PopupSnapshot
+{
+public:
+    struct Item
+    {
+        // What the item is called in the popup.
+        std::wstring title;
+
+        // The parsing name of the item, which it is opened by, and its icon is cached by.
+        std::wstring command;
+
+        // True if the item opens a popup of its own.
+        bool folder;
+    };
+
+    struct Folder
+    {
+        uint64_t modifiedTime;
+        std::vector<Item> items;
+
+        // True if the items have been loaded from the folder itself since the snapshot was read.
+        // Not kept on disk.
+        bool verified;
+    };
+
+    // Retrieves when a folder was last modified. Returns false if the folder doesn't exist.
+    typedef std::function<bool(const std::wstring &path, uint64_t *modifiedTime)> StampFunction;
+
+public:
+    PopupSnapshot();
+
+public:
+    /// <summary>
+    /// Replaces the folders with those of a snapshot written by Write.
+    /// </summary>
+    /// <returns>False, leaving the snapshot empty, if the data is damaged or from another version.</returns>
+    bool Read(const uint8_t *data, size_t size);
+
+    void Write(std::vector<uint8_t> &data) const;
+
+    // Drops every folder which has been modified since it was stored, or no longer exists.
+    void Validate(const StampFunction &getStamp);
+
+    // Returns the folder, if it is in the snapshot with the given modification time, or nullptr.
+    const Folder *Find(const std::wstring &path, uint64_t modifiedTime) const;
+
+    // Adds or replaces a folder, which has just been loaded. Storing what is already there only
+    // marks the folder as verified.
+    void Store(const std::wstring &path, uint64_t modifiedTime, std::vector<Item> &&items);
+
+public:
+    size_t GetFolderCount() const;
+
+    // True if folders have been stored or dropped since the snapshot was read, or ClearDirty was called.
+    bool IsDirty() const;
+
+    // Should be called once the snapshot has been saved.
+    void ClearDirty();
+
+private:
+    std::unordered_map<std::wstring, Folder> mFolders;
+    bool mDirty;
+};
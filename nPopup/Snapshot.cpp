@@ -0,0 +1,324 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Snapshot.cpp
+ *  The nModules Project
+ *
+ *  Keeps the popup snapshot on disk, and up to date.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "../nShared/LiteStep.h"
+#include "../nCoreCom/Core.h"
+#include <strsafe.h>
+#include "Snapshot.hpp"
+#include "PopupItem.hpp"
+#include <Shlwapi.h>
+#include <algorithm>
+#include <map>
+
+// Anything larger than this is not a snapshot.
+static const LONGLONG MAX_SNAPSHOT_SIZE = 64 * 1024 * 1024;
+
+
+/// <summary>
+/// Loads folders which were shown from the snapshot, and stores what they actually contain.
+/// </summary>
+class SnapshotRefresher : public FileSystemLoaderResponseHandler
+{
+public:
+    void Start(IShellFolder *folder, LPCWSTR path, UINT64 stamp, bool loadIcons, Snapshot::RefreshHandler *handler);
+    void ForgetHandler(Snapshot::RefreshHandler *handler);
+    void CancelAll();
+
+public:
+    LPARAM FolderItemsFound(UINT64, LoadFolderItemsResponse*) override;
+    LPARAM FolderLoaded(UINT64, LoadFolderResponse*) override;
+    LPARAM ItemLoaded(UINT64, LoadItemResponse*) override;
+
+private:
+    struct Refresh
+    {
+        std::wstring path;
+        UINT64 stamp;
+        IShellFolder2 *folder;
+        std::vector<PopupSnapshot::Item> items;
+        // Told when the folder has been loaded.
+        std::vector<Snapshot::RefreshHandler*> handlers;
+    };
+
+    // FileSystemLoader request -> refresh
+    std::map<UINT64, Refresh> mRefreshes;
+};
+
+
+static bool sEnabled = false;
+static PopupSnapshot sSnapshot;
+static SnapshotRefresher sRefresher;
+
+
+/// <summary>
+/// Retrieves the path of the snapshot file, creating its folder if necessary.
+/// </summary>
+static bool GetSnapshotPath(LPWSTR path, UINT cchPath)
+{
+    WCHAR directory[MAX_PATH];
+    PWSTR localAppData;
+    if (FAILED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData)))
+    {
+        return false;
+    }
+    StringCchPrintf(directory, _countof(directory), L"%s\\nModules\\nPopup", localAppData);
+    CoTaskMemFree(localAppData);
+    SHCreateDirectoryExW(nullptr, directory, nullptr);
+    return SUCCEEDED(StringCchPrintf(path, cchPath, L"%s\\snapshot.dat", directory));
+}
+
+
+void Snapshot::Load()
+{
+    WCHAR path[MAX_PATH];
+    sEnabled = LiteStep::GetRCBoolDef(L"nPopupSnapshot", TRUE) != FALSE;
+    if (!sEnabled || !GetSnapshotPath(path, _countof(path)))
+    {
+        return;
+    }
+
+    HANDLE file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    std::vector<uint8_t> data;
+    LARGE_INTEGER size;
+    DWORD read;
+    if (GetFileSizeEx(file, &size) && size.QuadPart <= MAX_SNAPSHOT_SIZE)
+    {
+        data.resize(size_t(size.QuadPart));
+        if (!ReadFile(file, data.data(), DWORD(data.size()), &read, nullptr) || read != data.size())
+        {
+            data.clear();
+        }
+    }
+    CloseHandle(file);
+
+    if (!sSnapshot.Read(data.data(), data.size()))
+    {
+        TRACEW(L"Discarding the popup snapshot in %s", path);
+        return;
+    }
+
+    sSnapshot.Validate([] (const std::wstring &folder, uint64_t *stamp) -> bool
+    {
+        return GetFolderStamp(folder.c_str(), stamp);
+    });
+}
+
+
+void Snapshot::Shutdown()
+{
+    WCHAR path[MAX_PATH], tempPath[MAX_PATH];
+    sRefresher.CancelAll();
+    if (!sEnabled || !sSnapshot.IsDirty() || !GetSnapshotPath(path, _countof(path)))
+    {
+        return;
+    }
+
+    std::vector<uint8_t> data;
+    sSnapshot.Write(data);
+
+    // Write a new file and swap it in, so that a crash leaves either the old or the new one behind.
+    StringCchPrintf(tempPath, _countof(tempPath), L"%s.tmp", path);
+    HANDLE file = CreateFileW(tempPath, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+    DWORD written;
+    bool success = WriteFile(file, data.data(), DWORD(data.size()), &written, nullptr) && written == data.size();
+    CloseHandle(file);
+
+    if (success && MoveFileExW(tempPath, path, MOVEFILE_REPLACE_EXISTING))
+    {
+        sSnapshot.ClearDirty();
+    }
+    else
+    {
+        DeleteFileW(tempPath);
+    }
+}
+
+
+bool Snapshot::GetFolderStamp(LPCWSTR path, UINT64 *stamp)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+    {
+        return false;
+    }
+    *stamp = UINT64(data.ftLastWriteTime.dwHighDateTime) << 32 | data.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+
+const PopupSnapshot::Folder *Snapshot::Find(LPCWSTR path, UINT64 stamp)
+{
+    return sEnabled ? sSnapshot.Find(path, stamp) : nullptr;
+}
+
+
+void Snapshot::Store(LPCWSTR path, UINT64 stamp, std::vector<PopupSnapshot::Item> &&items)
+{
+    if (sEnabled)
+    {
+        sSnapshot.Store(path, stamp, std::move(items));
+    }
+}
+
+
+void Snapshot::Refresh(IShellFolder *folder, LPCWSTR path, UINT64 stamp, bool loadIcons, RefreshHandler *handler)
+{
+    if (sEnabled)
+    {
+        sRefresher.Start(folder, path, stamp, loadIcons, handler);
+    }
+}
+
+
+void Snapshot::ForgetHandler(RefreshHandler *handler)
+{
+    sRefresher.ForgetHandler(handler);
+}
+
+
+/// <summary>
+/// Starts loading a folder on nCore's worker threads. Its icons, if they are loaded, end up in the
+/// core's thumbnail cache, where popups look for them once the handlers are told.
+/// </summary>
+void SnapshotRefresher::Start(IShellFolder *folder, LPCWSTR path, UINT64 stamp, bool loadIcons, Snapshot::RefreshHandler *handler)
+{
+    IShellFolder2 *folder2;
+
+    for (auto &refresh : mRefreshes)
+    {
+        if (refresh.second.path == path)
+        {
+            std::vector<Snapshot::RefreshHandler*> &handlers = refresh.second.handlers;
+            if (handler != nullptr && std::find(handlers.begin(), handlers.end(), handler) == handlers.end())
+            {
+                handlers.push_back(handler);
+            }
+            return;
+        }
+    }
+
+    if (FAILED(folder->QueryInterface(IID_IShellFolder2, reinterpret_cast<LPVOID*>(&folder2))))
+    {
+        return;
+    }
+
+    LoadFolderRequest request;
+    request.folder = folder2;
+    request.targetIconWidth = PopupItem::ICON_EXTRACT_SIZE;
+    request.priority = LoadPriority::Offscreen;
+    request.visibleCount = 0;
+    request.thumbnailCount = loadIcons ? UINT(-1) : 0;
+
+    Refresh &refresh = mRefreshes[nCore::LoadFolder(request, this)];
+    refresh.path = path;
+    refresh.stamp = stamp;
+    refresh.folder = folder2;
+    if (handler != nullptr)
+    {
+        refresh.handlers.push_back(handler);
+    }
+}
+
+
+void SnapshotRefresher::ForgetHandler(Snapshot::RefreshHandler *handler)
+{
+    for (auto &refresh : mRefreshes)
+    {
+        std::vector<Snapshot::RefreshHandler*> &handlers = refresh.second.handlers;
+        handlers.erase(std::remove(handlers.begin(), handlers.end(), handler), handlers.end());
+    }
+}
+
+
+void SnapshotRefresher::CancelAll()
+{
+    for (auto &refresh : mRefreshes)
+    {
+        nCore::CancelLoad(refresh.first);
+        refresh.second.folder->Release();
+    }
+    mRefreshes.clear();
+}
+
+
+/// <summary>
+/// Works out how the items are shown, the same way ContentPopup::LoadSingleItem does.
+/// </summary>
+LPARAM SnapshotRefresher::FolderItemsFound(UINT64 id, LoadFolderItemsResponse *response)
+{
+    auto refresh = mRefreshes.find(id);
+    if (refresh == mRefreshes.end())
+    {
+        return 0;
+    }
+
+    IShellFolder2 *folder = refresh->second.folder;
+    for (size_t i = 0; i < response->items.size(); ++i)
+    {
+        PopupSnapshot::Item item;
+        STRRET ret;
+        WCHAR title[MAX_PATH];
+        SFGAOF attributes = SFGAO_BROWSABLE | SFGAO_FOLDER;
+        PCUITEMID_CHILD itemID = response->items[i];
+
+        if (FAILED(folder->GetDisplayNameOf(itemID, SHGDN_NORMAL, &ret)) || FAILED(StrRetToBufW(&ret, itemID, title, _countof(title))))
+        {
+            continue;
+        }
+
+        item.title = title;
+        item.command = response->names[i];
+        item.folder = SUCCEEDED(folder->GetAttributesOf(1, &itemID, &attributes)) && (attributes & (SFGAO_FOLDER | SFGAO_BROWSABLE)) != 0;
+        refresh->second.items.push_back(std::move(item));
+    }
+    return 0;
+}
+
+
+LPARAM SnapshotRefresher::FolderLoaded(UINT64 id, LoadFolderResponse *response)
+{
+    auto refresh = mRefreshes.find(id);
+    if (refresh == mRefreshes.end() || !response->complete)
+    {
+        return 0;
+    }
+
+    // The folder may have changed while it was being loaded.
+    UINT64 stamp;
+    if (Snapshot::GetFolderStamp(refresh->second.path.c_str(), &stamp) && stamp == refresh->second.stamp)
+    {
+        sSnapshot.Store(refresh->second.path, stamp, std::move(refresh->second.items));
+    }
+
+    // The icons were loaded either way. The handlers may start new refreshes, so the refresh is
+    // gone before they are told.
+    std::wstring path = std::move(refresh->second.path);
+    std::vector<Snapshot::RefreshHandler*> handlers = std::move(refresh->second.handlers);
+    refresh->second.folder->Release();
+    mRefreshes.erase(refresh);
+
+    for (Snapshot::RefreshHandler *handler : handlers)
+    {
+        handler->FolderRefreshed(path.c_str());
+    }
+    return 0;
+}
+
+
+LPARAM SnapshotRefresher::ItemLoaded(UINT64, LoadItemResponse*)
+{
+    return 0;
+}
@@ -0,0 +1,51 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *  Snapshot.hpp
+ *  The nModules Project
+ *
+ *  Keeps the popup snapshot on disk, and up to date.
+ *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#pragma once
+
+#include "../nShared/LiteStep.h"
+#include "PopupSnapshot.hpp"
+#include <ShlObj.h>
+
+/// <summary>
+/// The snapshot of the folders shown in popups, kept in %LOCALAPPDATA%\nModules\nPopup. Folders
+/// which are shown from the snapshot are loaded again on nCore's worker threads, and the snapshot
+/// is updated with what they actually contain.
+/// </summary>
+namespace Snapshot
+{
+    // Told when a folder which was shown from the snapshot has been loaded again. By then, the icons
+    // of its items are in the core's thumbnail cache.
+    class RefreshHandler
+    {
+    public:
+        virtual void FolderRefreshed(LPCWSTR path) = 0;
+    };
+
+    // Reads the snapshot, and drops the folders which have changed since it was written.
+    void Load();
+
+    // Cancels the refreshes, and writes the snapshot if it has changed.
+    void Shutdown();
+
+    // Retrieves when a folder was last modified, which changes whenever an item is added to,
+    // removed from, or renamed in it. Fails for folders which aren't on disk.
+    bool GetFolderStamp(LPCWSTR path, UINT64 *stamp);
+
+    // Returns the items of a folder, if they are in the snapshot and the folder hasn't changed since.
+    const PopupSnapshot::Folder *Find(LPCWSTR path, UINT64 stamp);
+
+    // Records the items of a folder, which have just been loaded.
+    void Store(LPCWSTR path, UINT64 stamp, std::vector<PopupSnapshot::Item> &&items);
+
+    // Loads a folder which was shown from the snapshot again, in the background, and stores what it contains.
+    // The handler, if there is one, is told once the folder has been loaded.
+    void Refresh(IShellFolder *folder, LPCWSTR path, UINT64 stamp, bool loadIcons, RefreshHandler *handler);
+
+    // Stops telling a handler about the refreshes it asked for.
+    void ForgetHandler(RefreshHandler *handler);
+}
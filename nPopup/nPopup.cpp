@@ -14,6 +14,7 @@
 #include "Popup.hpp"
 #include "PopupItem.hpp"
 #include "SeparatorItem.hpp"
+#include "Snapshot.hpp"
 #include "SuicidalContentPopup.hpp"
 #include "Version.h"
 
@@ -105,6 +106,7 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR path)
     }
 
     // Load settings
+    Snapshot::Load();
     LoadPopups();
 
     return 0;
@@ -125,6 +127,7 @@ EXPORT_CDECL(void) quitModule(HINSTANCE instance)
         delete popup.second;
     }
     LiteStep::RemoveBangCommand(L"!PopupDynamicFolder");
+    Snapshot::Shutdown();
     gLSModule.DeInitalize();
 }
 
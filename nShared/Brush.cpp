@@ -9,8 +9,8 @@
 #include "Brush.hpp"
 #include "Color.h"
 #include "Factories.h"
+#include "ImageBitmaps.hpp"
 #include "LiteStep.h"
-#include <wincodec.h>
 #include "../nCoreCom/Core.h"
 #include "../Utilities/StringUtils.h"
 #include <algorithm>
@@ -25,6 +25,7 @@ Brush::Brush()
     , gradientStopColors(nullptr)
     , gradientStopCount(0)
     , gradientStops(nullptr)
+    , mImageBitmap(nullptr)
     , mTransformTimeStamp(0)
     , scalingMode(ImageScalingMode::Center)
 {}
@@ -127,6 +128,10 @@ void Brush::LoadGradientStops() {
 
 void Brush::Discard() {
   SAFERELEASE(this->brush);
+  if (mImageBitmap) {
+    ImageBitmaps::Release(mImageBitmap);
+    mImageBitmap = nullptr;
+  }
 }
 
 
@@ -445,35 +450,25 @@ bool Brush::UpdateDWMColor(ARGB newColor, ID2D1RenderTarget *renderTarget) {
 }
 
 
+/// <summary>
+/// Creates a bitmap brush for the given image. The pixels come from nCore's image cache, and the
+/// bitmap is shared with other brushes drawing the same image to the same render target.
+/// </summary>
 HRESULT Brush::LoadImageFile(ID2D1RenderTarget *renderTarget, LPCTSTR image, ID2D1Brush **brush) {
-  IWICImagingFactory *factory = nullptr;
-  IWICBitmap *wicBitmap = nullptr;
-  IWICFormatConverter *converter = nullptr;
   ID2D1Bitmap *bitmap = nullptr;
-  Factories::GetWICFactory(reinterpret_cast<LPVOID*>(&factory));
-  HRESULT hr = E_FAIL;
 
-  HBITMAP hBitmap = LiteStep::LoadLSImage(image, nullptr);
-  if (hBitmap) {
-    hr = factory->CreateFormatConverter(&converter);
-    if (SUCCEEDED(hr)) {
-      hr = factory->CreateBitmapFromHBITMAP(hBitmap, nullptr, WICBitmapUseAlpha, &wicBitmap);
-    }
-    if (SUCCEEDED(hr)) {
-      hr = converter->Initialize(wicBitmap, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone,
-        nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
-    }
+  HRESULT hr = ImageBitmaps::Acquire(renderTarget, image, 0, 0, &bitmap);
+  if (SUCCEEDED(hr)) {
+    hr = renderTarget->CreateBitmapBrush(bitmap, reinterpret_cast<ID2D1BitmapBrush**>(brush));
     if (SUCCEEDED(hr)) {
-      hr = renderTarget->CreateBitmapFromWicBitmap(converter, nullptr, &bitmap);
-    }
-    if (SUCCEEDED(hr)) {
-      hr = renderTarget->CreateBitmapBrush(bitmap, reinterpret_cast<ID2D1BitmapBrush**>(brush));
+      // The old bitmap is still held by the old brush, if it is in use.
+      if (mImageBitmap) {
+        ImageBitmaps::Release(mImageBitmap);
+      }
+      mImageBitmap = bitmap;
+    } else {
+      ImageBitmaps::Release(bitmap);
     }
-
-    DeleteObject(hBitmap);
-    SAFERELEASE(wicBitmap);
-    SAFERELEASE(bitmap);
-    SAFERELEASE(converter);
   } else if (!PathFileExists(image)) {
     hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
   }
@@ -139,6 +139,9 @@ private:
     // The number of gradient stops we have.
     UINT gradientStopCount;
 
+    // The shared bitmap behind an image brush.
+    ID2D1Bitmap *mImageBitmap;
+
     // The last time a change which requires the transforms to be recomputed occured.
     ULONGLONG mTransformTimeStamp;
 
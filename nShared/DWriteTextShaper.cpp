@@ -0,0 +1,80 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/DWriteTextShaper.cpp
+// The nModules Project
+//
+// Creates text layouts with DirectWrite.
+//-------------------------------------------------------------------------------------------------
+#include "DWriteTextShaper.hpp"
+#include "Factories.h"
+
+// The amount of memory cached layouts may use in each module.
+static const size_t CACHE_BUDGET = 4 * 1024 * 1024;
+
+// DirectWrite doesn't tell us how much memory a layout uses. These are rough figures for the
+// layout object itself, and for the glyph, cluster, and line data per character.
+static const size_t LAYOUT_BASE_COST = 2048;
+static const size_t LAYOUT_CHAR_COST = 64;
+
+static DWriteTextShaper sShaper;
+static TextLayoutCache *sCache = nullptr;
+
+
+DWriteTextShaper::Layout::Layout(IDWriteTextLayout *layout) : mLayout(layout) {}
+
+
+DWriteTextShaper::Layout::~Layout() {
+  SAFERELEASE(mLayout);
+}
+
+
+void DWriteTextShaper::Layout::GetSize(float *width, float *height) const {
+  DWRITE_TEXT_METRICS metrics;
+  if (SUCCEEDED(mLayout->GetMetrics(&metrics))) {
+    *width = metrics.width;
+    *height = metrics.height;
+  } else {
+    *width = *height = 0.0f;
+  }
+}
+
+
+IDWriteTextLayout *DWriteTextShaper::Layout::Get() const {
+  return mLayout;
+}
+
+
+ITextShaper::Layout *DWriteTextShaper::CreateLayout(const wchar_t *text, size_t length,
+    const void *format, float maxWidth, float maxHeight, size_t *cost) {
+  IDWriteFactory *factory;
+  IDWriteTextLayout *layout = nullptr;
+  if (FAILED(Factories::GetDWriteFactory(reinterpret_cast<LPVOID*>(&factory)))) {
+    return nullptr;
+  }
+  if (FAILED(factory->CreateTextLayout(text, UINT32(length), (IDWriteTextFormat*)format,
+      maxWidth, maxHeight, &layout))) {
+    return nullptr;
+  }
+
+  *cost = LAYOUT_BASE_COST + length * LAYOUT_CHAR_COST;
+  return new Layout(layout);
+}
+
+
+TextLayoutCache &DWriteTextShaper::GetSharedCache() {
+  if (sCache == nullptr) {
+    sCache = new TextLayoutCache(&sShaper, CACHE_BUDGET);
+  }
+  return *sCache;
+}
+
+
+void DWriteTextShaper::PurgeSharedCache(const void *format) {
+  if (sCache != nullptr) {
+    sCache->Purge(format);
+  }
+}
+
+
+void DWriteTextShaper::ReleaseSharedCache() {
+  SAFEDELETE(sCache);
+}
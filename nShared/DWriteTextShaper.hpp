@@ -0,0 +1,47 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/DWriteTextShaper.hpp
+// The nModules Project
+//
+// Creates text layouts with DirectWrite.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "TextLayoutCache.hpp"
+#include "TextShaper.hpp"
+
+#include "../Utilities/Common.h"
+
+#include <dwrite.h>
+
+/// <summary>
+/// Shapes text with DirectWrite. The format passed to CreateLayout must be an IDWriteTextFormat.
+/// </summary>
+class DWriteTextShaper : public ITextShaper {
+public:
+  class Layout : public ITextShaper::Layout {
+  public:
+    explicit Layout(IDWriteTextLayout *layout);
+    ~Layout();
+
+  public:
+    void GetSize(float *width, float *height) const override;
+    IDWriteTextLayout *Get() const;
+
+  private:
+    IDWriteTextLayout *mLayout;
+  };
+
+public:
+  ITextShaper::Layout *CreateLayout(const wchar_t *text, size_t length, const void *format,
+    float maxWidth, float maxHeight, size_t *cost) override;
+
+public:
+  // Returns the layout cache shared by every window in this module.
+  static TextLayoutCache &GetSharedCache();
+
+  // Removes every layout using the given format from the shared cache.
+  static void PurgeSharedCache(const void *format);
+
+  // Releases every cached layout. Called before the DirectWrite factory is released.
+  static void ReleaseSharedCache();
+};
@@ -6,21 +6,28 @@
 //-------------------------------------------------------------------------------------------------
 #include "Easing.h"
 
-#include "../Utilities/AlgorithmExtension.h"
-#include "../Utilities/StringUtils.h"
-
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 
-/// <summary>
-/// Easing Name -> Easing::Type
-/// </summary>
-static StringKeyedMaps<LPCWSTR, Easing::Type>::ConstUnorderedMap sStringToEasing({
-  { L"Cubic", Easing::Type::Cubic },
-  { L"Sine", Easing::Type::Sine },
-  { L"Bounce", Easing::Type::Bounce },
-  { L"Linear", Easing::Type::Linear }
-});
+static const float PI = 3.14159265358979f;
+
+
+static float BounceOut(float p) {
+  const float n = 7.5625f, d = 2.75f;
+  if (p < 1.0f / d) {
+    return n*p*p;
+  } else if (p < 2.0f / d) {
+    p -= 1.5f / d;
+    return n*p*p + 0.75f;
+  } else if (p < 2.5f / d) {
+    p -= 2.25f / d;
+    return n*p*p + 0.9375f;
+  }
+  p -= 2.625f / d;
+  return n*p*p + 0.984375f;
+}
 
 
 /// <summary>
@@ -28,26 +35,191 @@ static StringKeyedMaps<LPCWSTR, Easing::Type>::ConstUnorderedMap sStringToEasing
 /// </summary>
 /// <param name="progress>How far the actual progress has gone. 0 <= progress <= 1.</param>
 /// <returns>The transformed progress. Transform(0, x) == 0, Transform(1, x) == 1.</returns>
-float Easing::Transform(float progress, Type easingType) {
+float Easing::Transform(float p, Type easingType) {
+  // Back overshoots by about 10%.
+  const float back = 1.70158f;
+  const float backInOut = back * 1.525f;
+
   switch (easingType) {
   case Type::Linear:
-    return progress;
+  case Type::Squared:
+  case Type::Quadractic:
+    return p;
+
+  case Type::QuadIn:
+    return p*p;
+  case Type::QuadOut:
+    return 1 - (1 - p)*(1 - p);
+  case Type::QuadInOut:
+    return p < 0.5f ? 2*p*p : 1 - 2*(1 - p)*(1 - p);
+
   case Type::Cubic:
-    return progress*progress*progress;
-  case Type::Sine:
-    return (float)sin(1.57079632679*progress);
+  case Type::CubicIn:
+    return p*p*p;
+  case Type::CubicOut:
+    return 1 - (1 - p)*(1 - p)*(1 - p);
+  case Type::CubicInOut:
+    return p < 0.5f ? 4*p*p*p : 1 - 4*(1 - p)*(1 - p)*(1 - p);
+
+  case Type::QuartIn:
+    return p*p*p*p;
+  case Type::QuartOut:
+    return 1 - (1 - p)*(1 - p)*(1 - p)*(1 - p);
+  case Type::QuartInOut:
+    return p < 0.5f ? 8*p*p*p*p : 1 - 8*(1 - p)*(1 - p)*(1 - p)*(1 - p);
+
+  case Type::ExpoIn:
+    return p <= 0 ? 0 : powf(2, 10*p - 10);
+  case Type::ExpoOut:
+    return p >= 1 ? 1 : 1 - powf(2, -10*p);
+  case Type::ExpoInOut:
+    if (p <= 0 || p >= 1) {
+      return p <= 0 ? 0.0f : 1.0f;
+    }
+    return p < 0.5f ? powf(2, 20*p - 10) / 2 : (2 - powf(2, 10 - 20*p)) / 2;
+
+  case Type::BackIn:
+    return p*p*((back + 1)*p - back);
+  case Type::BackOut:
+    return 1 + (p - 1)*(p - 1)*((back + 1)*(p - 1) + back);
+  case Type::BackInOut:
+    return p < 0.5f
+      ? 2*p*p*((backInOut + 1)*2*p - backInOut)
+      : 1 + 2*(p - 1)*(p - 1)*((backInOut + 1)*(2*p - 2) + backInOut);
+
+  case Type::ElasticIn:
+    if (p <= 0 || p >= 1) {
+      return p <= 0 ? 0.0f : 1.0f;
+    }
+    return -powf(2, 10*p - 10) * sinf((10*p - 10.75f) * 2*PI/3);
+  case Type::Elastic:
+  case Type::ElasticOut:
+    if (p <= 0 || p >= 1) {
+      return p <= 0 ? 0.0f : 1.0f;
+    }
+    return powf(2, -10*p) * sinf((10*p - 0.75f) * 2*PI/3) + 1;
+  case Type::ElasticInOut:
+    if (p <= 0 || p >= 1) {
+      return p <= 0 ? 0.0f : 1.0f;
+    }
+    return p < 0.5f
+      ? -powf(2, 20*p - 10) * sinf((20*p - 11.125f) * 2*PI/4.5f) / 2
+      : powf(2, 10 - 20*p) * sinf((20*p - 11.125f) * 2*PI/4.5f) / 2 + 1;
+
+  case Type::BounceIn:
+    return 1 - BounceOut(1 - p);
   case Type::Bounce:
-    //if (progress < 0.6) return progress*progress/0.36f;
-    //if (progress < 0.8) return pow(progress-0.6, 2)
+  case Type::BounceOut:
+    return BounceOut(p);
+  case Type::BounceInOut:
+    return p < 0.5f ? (1 - BounceOut(1 - 2*p)) / 2 : (1 + BounceOut(2*p - 1)) / 2;
+
+  case Type::SineIn:
+    return 1 - cosf(p * PI/2);
+  case Type::Sine:
+  case Type::SineOut:
+    return sinf(p * PI/2);
+  case Type::SineInOut:
+    return (1 - cosf(p * PI)) / 2;
+
   default:
-    return progress;
+    return p;
   }
 }
 
 
 /// <summary>
-/// Parses a string into an easing.
+/// Returns a shared table for the easing.
 /// </summary>
-Easing::Type Easing::EasingFromString(LPCWSTR str) {
-  return std::get(sStringToEasing, str, Type::Linear);
+const Easing::Table &Easing::GetTable(Type easingType) {
+  struct Tables {
+    Tables() {
+      for (int i = 0; i < int(Type::Count); ++i) {
+        tables.emplace_back(Type(i));
+      }
+    }
+    std::vector<Table> tables;
+  };
+  static const Tables sTables;
+
+  return sTables.tables[std::min(int(easingType), int(Type::Count) - 1)];
+}
+
+
+Easing::CubicBezier::CubicBezier(float x1, float y1, float x2, float y2) {
+  x1 = std::min(1.0f, std::max(0.0f, x1));
+  x2 = std::min(1.0f, std::max(0.0f, x2));
+
+  mCx = 3*x1;
+  mBx = 3*(x2 - x1) - mCx;
+  mAx = 1 - mCx - mBx;
+  mCy = 3*y1;
+  mBy = 3*(y2 - y1) - mCy;
+  mAy = 1 - mCy - mBy;
+}
+
+
+float Easing::CubicBezier::Transform(float progress) const {
+  const float t = SolveT(progress);
+  return ((mAy*t + mBy)*t + mCy)*t;
+}
+
+
+float Easing::CubicBezier::SolveT(float x) const {
+  if (x <= 0 || x >= 1) {
+    return x <= 0 ? 0.0f : 1.0f;
+  }
+
+  // Newton's method converges in a few steps, except where the curve is nearly flat in x.
+  float t = x;
+  for (int i = 0; i < 8; ++i) {
+    const float error = ((mAx*t + mBx)*t + mCx)*t - x;
+    if (fabsf(error) < 1e-6f) {
+      return t;
+    }
+    const float slope = (3*mAx*t + 2*mBx)*t + mCx;
+    if (fabsf(slope) < 1e-6f) {
+      break;
+    }
+    t -= error / slope;
+  }
+
+  // Fall back to bisection. x(t) is monotonic, since the control points are within [0, 1].
+  float low = 0, high = 1;
+  t = x;
+  for (int i = 0; i < 32; ++i) {
+    const float value = ((mAx*t + mBx)*t + mCx)*t;
+    if (fabsf(value - x) < 1e-6f) {
+      break;
+    }
+    if (value < x) {
+      low = t;
+    } else {
+      high = t;
+    }
+    t = (low + high) / 2;
+  }
+  return t;
+}
+
+
+Easing::Table::Table(Type easingType) {
+  for (int i = 0; i <= SAMPLES; ++i) {
+    mValues[i] = Easing::Transform(float(i) / SAMPLES, easingType);
+  }
+}
+
+
+Easing::Table::Table(const CubicBezier &curve) {
+  for (int i = 0; i <= SAMPLES; ++i) {
+    mValues[i] = curve.Transform(float(i) / SAMPLES);
+  }
+}
+
+
+float Easing::Table::Transform(float progress) const {
+  const float position = std::min(1.0f, std::max(0.0f, progress)) * SAMPLES;
+  const int index = std::min(int(position), SAMPLES - 1);
+  const float fraction = position - index;
+  return mValues[index] + (mValues[index + 1] - mValues[index]) * fraction;
 }
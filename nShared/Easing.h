@@ -6,19 +6,101 @@
 //-------------------------------------------------------------------------------------------------
 #pragma once
 
-#include "../Utilities/Common.h"
-
 namespace Easing {
   enum class Type {
     Linear,
+
+    // The original easings. Squared and Quadractic have always been linear, and stay that way so
+    // that existing code animates the same; QuadIn and QuartIn are the real curves. Cubic and Sine
+    // are the same as CubicIn and SineOut. Bounce and Elastic used to be linear as well, and are
+    // now BounceOut and ElasticOut.
     Squared,
     Cubic,
     Quadractic,
     Bounce,
     Elastic,
-    Sine
+    Sine,
+
+    QuadIn,
+    QuadOut,
+    QuadInOut,
+    CubicIn,
+    CubicOut,
+    CubicInOut,
+    QuartIn,
+    QuartOut,
+    QuartInOut,
+    ExpoIn,
+    ExpoOut,
+    ExpoInOut,
+    BackIn,
+    BackOut,
+    BackInOut,
+    ElasticIn,
+    ElasticOut,
+    ElasticInOut,
+    BounceIn,
+    BounceOut,
+    BounceInOut,
+    SineIn,
+    SineOut,
+    SineInOut,
+
+    Count
+  };
+
+  /// <summary>
+  /// A cubic bezier curve from (0, 0) to (1, 1), like CSS's cubic-bezier(x1, y1, x2, y2).
+  /// </summary>
+  class CubicBezier {
+  public:
+    /// <summary>
+    /// The x coordinates of the control points are clamped to [0, 1], so that the curve is a
+    /// function of x. The y coordinates may go outside of it, to overshoot.
+    /// </summary>
+    CubicBezier(float x1, float y1, float x2, float y2);
+
+  public:
+    float Transform(float progress) const;
+
+  private:
+    // Solves x(t) = x for t.
+    float SolveT(float x) const;
+
+  private:
+    // The polynomial coefficients of x(t) and y(t), i.e. x(t) = ((ax*t + bx)*t + cx)*t.
+    float mAx, mBx, mCx;
+    float mAy, mBy, mCy;
+  };
+
+  /// <summary>
+  /// A precomputed easing, for when an easing is evaluated many times per frame. Values between
+  /// the samples are linearly interpolated. This is accurate to about 1e-5 for the polynomial and
+  /// sine easings, and to about 2e-3 for Expo, Elastic and Bounce. It only pays off for the
+  /// easings which call into the math library, and for bezier curves.
+  /// </summary>
+  class Table {
+  public:
+    static const int SAMPLES = 512;
+
+  public:
+    explicit Table(Type easingType);
+    explicit Table(const CubicBezier &curve);
+
+  public:
+    float Transform(float progress) const;
+
+  private:
+    float mValues[SAMPLES + 1];
   };
 
   float Transform(float progress, Type easingType);
-  Type EasingFromString(LPCWSTR str);
+
+  // Defined in EasingNames.cpp, so that the rest doesn't depend on Windows.
+  Type EasingFromString(const wchar_t *str);
+
+  /// <summary>
+  /// Returns a shared table for the easing. The tables are built the first time this is called.
+  /// </summary>
+  const Table &GetTable(Type easingType);
 }
@@ -0,0 +1,54 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/EasingNames.cpp
+// The nModules Project
+//
+// Maps the names used in settings and scripts to easings.
+//-------------------------------------------------------------------------------------------------
+#include "Easing.h"
+
+#include "../Utilities/AlgorithmExtension.h"
+#include "../Utilities/StringUtils.h"
+
+
+/// <summary>
+/// Easing Name -> Easing::Type
+/// </summary>
+static StringKeyedMaps<LPCWSTR, Easing::Type>::ConstUnorderedMap sStringToEasing({
+  { L"Linear", Easing::Type::Linear },
+  { L"Cubic", Easing::Type::Cubic },
+  { L"Sine", Easing::Type::Sine },
+  { L"Bounce", Easing::Type::Bounce },
+  { L"Elastic", Easing::Type::Elastic },
+  { L"QuadIn", Easing::Type::QuadIn },
+  { L"QuadOut", Easing::Type::QuadOut },
+  { L"QuadInOut", Easing::Type::QuadInOut },
+  { L"CubicIn", Easing::Type::CubicIn },
+  { L"CubicOut", Easing::Type::CubicOut },
+  { L"CubicInOut", Easing::Type::CubicInOut },
+  { L"QuartIn", Easing::Type::QuartIn },
+  { L"QuartOut", Easing::Type::QuartOut },
+  { L"QuartInOut", Easing::Type::QuartInOut },
+  { L"ExpoIn", Easing::Type::ExpoIn },
+  { L"ExpoOut", Easing::Type::ExpoOut },
+  { L"ExpoInOut", Easing::Type::ExpoInOut },
+  { L"BackIn", Easing::Type::BackIn },
+  { L"BackOut", Easing::Type::BackOut },
+  { L"BackInOut", Easing::Type::BackInOut },
+  { L"ElasticIn", Easing::Type::ElasticIn },
+  { L"ElasticOut", Easing::Type::ElasticOut },
+  { L"ElasticInOut", Easing::Type::ElasticInOut },
+  { L"BounceIn", Easing::Type::BounceIn },
+  { L"BounceOut", Easing::Type::BounceOut },
+  { L"BounceInOut", Easing::Type::BounceInOut },
+  { L"SineIn", Easing::Type::SineIn },
+  { L"SineOut", Easing::Type::SineOut },
+  { L"SineInOut", Easing::Type::SineInOut }
+});
+
+
+/// <summary>
+/// Parses a string into an easing.
+/// </summary>
+Easing::Type Easing::EasingFromString(LPCWSTR str) {
+  return std::get(sStringToEasing, str, Type::Linear);
+}
@@ -5,6 +5,7 @@
  *  Manages Direct2D/DirectWrite/... factories
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+#include "DWriteTextShaper.hpp"
 #include "Factories.h"
 
 #include "../Utilities/CommonD2D.h"
@@ -22,6 +23,7 @@ static IWICImagingFactory *sWICFactory = nullptr;
 /// Releases all allocated factories.
 /// </summary>
 void Factories::Release() {
+  DWriteTextShaper::ReleaseSharedCache();
   SAFERELEASE(sDWFactory);
   SAFERELEASE(sD2DFactory);
   SAFERELEASE(sWICFactory);
@@ -0,0 +1,81 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/ImageBitmaps.cpp
+// The nModules Project
+//
+// Shares Direct2D bitmaps of cached images between brushes drawing to the same render target.
+//-------------------------------------------------------------------------------------------------
+#include "ImageBitmaps.hpp"
+
+#include "../nCoreCom/Core.h"
+
+#include <unordered_map>
+
+struct BitmapKey {
+  ID2D1RenderTarget *renderTarget;
+  const CachedImage *image;
+
+  bool operator==(const BitmapKey &other) const {
+    return renderTarget == other.renderTarget && image == other.image;
+  }
+};
+
+struct BitmapKeyHash {
+  size_t operator()(const BitmapKey &key) const {
+    return std::hash<const void*>()(key.renderTarget) * 31 + std::hash<const void*>()(key.image);
+  }
+};
+
+struct BitmapEntry {
+  BitmapKey key;
+  UINT refs;
+};
+
+// Bitmaps can only be used with the render target which created them, so every render target
+// gets its own bitmap of an image. Windows which share a render target share the bitmap.
+static std::unordered_map<BitmapKey, ID2D1Bitmap*, BitmapKeyHash> sBitmaps;
+static std::unordered_map<ID2D1Bitmap*, BitmapEntry> sEntries;
+
+
+HRESULT ImageBitmaps::Acquire(ID2D1RenderTarget *renderTarget, LPCWSTR path, UINT width,
+    UINT height, ID2D1Bitmap **bitmap) {
+  const CachedImage *image = nCore::AcquireImage(path, width, height);
+  if (image == nullptr) {
+    return E_FAIL;
+  }
+
+  BitmapKey key = { renderTarget, image };
+  auto iter = sBitmaps.find(key);
+  if (iter != sBitmaps.end()) {
+    // The bitmap already holds a reference to the image.
+    nCore::ReleaseImage(image);
+    ++sEntries[iter->second].refs;
+    *bitmap = iter->second;
+    return S_OK;
+  }
+
+  HRESULT hr = renderTarget->CreateBitmap(D2D1::SizeU(image->width, image->height), image->pixels,
+    image->stride, D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM,
+    D2D1_ALPHA_MODE_PREMULTIPLIED)), bitmap);
+  if (FAILED(hr)) {
+    nCore::ReleaseImage(image);
+    return hr;
+  }
+
+  BitmapEntry entry = { key, 1 };
+  sBitmaps[key] = *bitmap;
+  sEntries[*bitmap] = entry;
+  return S_OK;
+}
+
+
+void ImageBitmaps::Release(ID2D1Bitmap *bitmap) {
+  auto iter = sEntries.find(bitmap);
+  if (iter == sEntries.end() || --iter->second.refs > 0) {
+    return;
+  }
+
+  nCore::ReleaseImage(iter->second.key.image);
+  sBitmaps.erase(iter->second.key);
+  sEntries.erase(iter);
+  bitmap->Release();
+}
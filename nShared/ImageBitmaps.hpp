@@ -0,0 +1,19 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/ImageBitmaps.hpp
+// The nModules Project
+//
+// Shares Direct2D bitmaps of cached images between brushes drawing to the same render target.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "../Utilities/CommonD2D.h"
+
+namespace ImageBitmaps {
+  // Returns a bitmap of the image at the given path, created from nCore's image cache. A width or
+  // height of 0 loads the image at its original size. The bitmap must be passed to Release.
+  HRESULT Acquire(ID2D1RenderTarget *renderTarget, LPCWSTR path, UINT width, UINT height,
+    ID2D1Bitmap **bitmap);
+
+  // Gives up a bitmap returned by Acquire.
+  void Release(ID2D1Bitmap *bitmap);
+}
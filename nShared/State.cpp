@@ -6,6 +6,7 @@
  *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 #include "Color.h"
+#include "DWriteTextShaper.hpp"
 #include "Factories.h"
 #include "LiteStep.h"
 #include "State.hpp"
@@ -30,6 +31,7 @@ State::State()
 State::~State() {
   DiscardDeviceResources();
   SAFEDELETE(this->settings);
+  DWriteTextShaper::PurgeSharedCache(this->textFormat);
   SAFERELEASE(this->textFormat);
   SAFERELEASE(mTextRender);
 }
@@ -50,10 +52,8 @@ void State::UpdatePosition(D2D1_RECT_F position, WindowData *windowData) {
   windowData->textArea.left += mStateSettings.textOffsetLeft;
   windowData->textArea.right -= mStateSettings.textOffsetRight;
 
-  if (windowData->textLayout) {
-    windowData->textLayout->SetMaxHeight(windowData->textArea.bottom - windowData->textArea.top);
-    windowData->textLayout->SetMaxWidth(windowData->textArea.right - windowData->textArea.left);
-  }
+  // Layouts are shared between windows, so pick up one for the new size on the next paint.
+  windowData->textLayout.reset();
 
   // Adjust the drawing area to account for the outline.
   windowData->drawingArea.rect.left += mStateSettings.outlineWidth / 2.0f;
@@ -111,24 +111,24 @@ void State::Paint(ID2D1RenderTarget* renderTarget, WindowData *windowData) {
 
 void State::PaintText(ID2D1RenderTarget* renderTarget, WindowData *windowData, Window *window) {
   if (mBrushes[BrushType::Text].brush && *window->GetText() != L'\0') {
-    renderTarget->SetTransform(Matrix3x2F::Rotation(mStateSettings.textRotation, windowData->textRotationOrigin));
+    // The render target may already be transformed, e.g. to a monitor of the desktop.
+    D2D1_MATRIX_3X2_F transform;
+    renderTarget->GetTransform(&transform);
+    renderTarget->SetTransform(Matrix3x2F::Rotation(mStateSettings.textRotation, windowData->textRotationOrigin) * transform);
     mBrushes[BrushType::Text].brush->SetTransform(windowData->brushData[BrushType::Text].brushTransform);
 
-    // TODO::Avoid re-creation of the layout here.
     if (!windowData->textLayout) {
-      IDWriteFactory *dwFactory;
-      if (SUCCEEDED(Factories::GetDWriteFactory((LPVOID*)&dwFactory))) {
-        dwFactory->CreateTextLayout(window->GetText(), lstrlenW(window->GetText()), textFormat,
-          windowData->textArea.right - windowData->textArea.left,
-          windowData->textArea.bottom - windowData->textArea.top, &windowData->textLayout);
-      }
+      windowData->textLayout = DWriteTextShaper::GetSharedCache().Get(window->GetText(), textFormat,
+        windowData->textArea.right - windowData->textArea.left,
+        windowData->textArea.bottom - windowData->textArea.top);
     }
 
     if (windowData->textLayout) {
-      windowData->textLayout->Draw(renderTarget, mTextRender, windowData->textArea.left, windowData->textArea.top);
+      const DWriteTextShaper::Layout *layout = (const DWriteTextShaper::Layout*)windowData->textLayout.get();
+      layout->Get()->Draw(renderTarget, mTextRender, windowData->textArea.left, windowData->textArea.top);
     }
 
-    renderTarget->SetTransform(Matrix3x2F::Identity());
+    renderTarget->SetTransform(transform);
   }
 }
 
@@ -163,19 +163,18 @@ bool State::UpdateDWMColor(ARGB newColor, ID2D1RenderTarget *renderTarget) {
 /// <param name="maxHeight">Out. The maximum height to return.</param>
 /// <param name="size">Out. The desired size will be placed in this SIZE.</param>
 void State::GetDesiredSize(int maxWidth, int maxHeight, LPSIZE size, Window *window) {
-  IDWriteFactory* factory = NULL;
-  IDWriteTextLayout* textLayout = NULL;
-  DWRITE_TEXT_METRICS metrics;
+  float width = 0.0f, height = 0.0f;
   maxWidth -= int(mStateSettings.textOffsetLeft + mStateSettings.textOffsetRight);
   maxHeight -= int(mStateSettings.textOffsetTop + mStateSettings.textOffsetBottom);
 
-  Factories::GetDWriteFactory(reinterpret_cast<LPVOID*>(&factory));
-  factory->CreateTextLayout(window->GetText(), lstrlenW(window->GetText()), this->textFormat, (float)maxWidth, (float)maxHeight, &textLayout);
-  textLayout->GetMetrics(&metrics);
-  SAFERELEASE(textLayout);
+  TextLayoutCache::LayoutPtr layout = DWriteTextShaper::GetSharedCache().Get(window->GetText(),
+    this->textFormat, (float)maxWidth, (float)maxHeight);
+  if (layout) {
+    layout->GetSize(&width, &height);
+  }
 
-  size->cx = long(metrics.width + mStateSettings.textOffsetLeft + mStateSettings.textOffsetRight) + 1;
-  size->cy = long(metrics.height + mStateSettings.textOffsetTop + mStateSettings.textOffsetBottom) + 1;
+  size->cx = long(width + mStateSettings.textOffsetLeft + mStateSettings.textOffsetRight) + 1;
+  size->cy = long(height + mStateSettings.textOffsetTop + mStateSettings.textOffsetBottom) + 1;
 }
 
 
@@ -254,11 +253,13 @@ void State::SetOutlineWidth(float width) {
 
 void State::SetReadingDirection(DWRITE_READING_DIRECTION direction) {
   this->textFormat->SetReadingDirection(direction);
+  DWriteTextShaper::PurgeSharedCache(this->textFormat);
 }
 
 
 void State::SetTextAlignment(DWRITE_TEXT_ALIGNMENT alignment) {
   this->textFormat->SetTextAlignment(alignment);
+  DWriteTextShaper::PurgeSharedCache(this->textFormat);
 }
 
 
@@ -273,16 +274,19 @@ void State::SetTextTrimmingGranuality(DWRITE_TRIMMING_GRANULARITY granularity) {
   this->textFormat->GetTrimming(&options, &trimmingSign);
   options.granularity = granularity;
   this->textFormat->SetTrimming(&options, trimmingSign);
+  DWriteTextShaper::PurgeSharedCache(this->textFormat);
 }
 
 
 void State::SetTextVerticalAlign(DWRITE_PARAGRAPH_ALIGNMENT alignment) {
   this->textFormat->SetParagraphAlignment(alignment);
+  DWriteTextShaper::PurgeSharedCache(this->textFormat);
 }
 
 
 void State::SetWordWrapping(DWRITE_WORD_WRAPPING wrapping) {
   this->textFormat->SetWordWrapping(wrapping);
+  DWriteTextShaper::PurgeSharedCache(this->textFormat);
 }
 
 
@@ -13,6 +13,7 @@ class State;
 #include "IPainter.hpp"
 #include "IBrushOwner.hpp"
 #include "StateTextRender.hpp"
+#include "TextLayoutCache.hpp"
 #include "Window.hpp"
 
 class State : public IBrushOwner
@@ -31,19 +32,6 @@ public:
 
     struct WindowData
     {
-        WindowData()
-            : textLayout(nullptr)
-        {
-        }
-
-        ~WindowData()
-        {
-            if (textLayout != nullptr)
-            {
-                textLayout->Release();
-            }
-        }
-
         // The area we draw text in
         D2D1_RECT_F textArea;
 
@@ -59,8 +47,9 @@ public:
         // Per-brush window data.
         EnumArray<Brush::WindowData, BrushType> brushData;
 
-        //
-        IDWriteTextLayout *textLayout;
+        // The layout of the current text in the text area, shared with other windows through the
+        // layout cache. Reset when the text or the text area changes.
+        TextLayoutCache::LayoutPtr textLayout;
     };
 
 public:
@@ -307,7 +307,7 @@ public:
         
         for (StateEnum state = StateEnum::Base; state != StateEnum::Count; EnumIncrement(state))
         {
-            SAFERELEASE(data->data[state].textLayout);
+            data->data[state].textLayout.reset();
         }
     }
 };
@@ -0,0 +1,132 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/TextLayoutCache.cpp
+// The nModules Project
+//
+// Shares text layouts between windows which draw the same text in the same box.
+//-------------------------------------------------------------------------------------------------
+#include "TextLayoutCache.hpp"
+
+#include <functional>
+
+
+TextLayoutCache::TextLayoutCache(ITextShaper *shaper, size_t budget)
+  : mShaper(shaper)
+  , mBudget(budget)
+  , mCost(0)
+  , mHits(0)
+  , mMisses(0)
+{
+}
+
+
+void TextLayoutCache::Clear() {
+  mIndex.clear();
+  mEntries.clear();
+  mCost = 0;
+}
+
+
+TextLayoutCache::LayoutPtr TextLayoutCache::Get(const wchar_t *text, const void *format,
+    float maxWidth, float maxHeight) {
+  Key key;
+  key.text = text;
+  key.textHash = std::hash<std::wstring>()(key.text);
+  key.format = format;
+  key.maxWidth = maxWidth;
+  key.maxHeight = maxHeight;
+
+  auto iter = mIndex.find(key);
+  if (iter != mIndex.end()) {
+    ++mHits;
+    mEntries.splice(mEntries.begin(), mEntries, iter->second);
+    return iter->second->layout;
+  }
+
+  ++mMisses;
+  size_t cost = 0;
+  LayoutPtr layout(mShaper->CreateLayout(key.text.c_str(), key.text.length(), format, maxWidth,
+    maxHeight, &cost));
+  if (!layout) {
+    return layout;
+  }
+
+  // The key is stored twice, so count it as part of the cost.
+  cost += 2 * (sizeof(Key) + key.text.capacity() * sizeof(wchar_t));
+
+  mEntries.emplace_front();
+  Entry &entry = mEntries.front();
+  entry.key = key;
+  entry.layout = layout;
+  entry.cost = cost;
+  mIndex.emplace(std::move(key), mEntries.begin());
+  mCost += cost;
+
+  Trim();
+
+  return layout;
+}
+
+
+void TextLayoutCache::Purge(const void *format) {
+  for (auto iter = mEntries.begin(); iter != mEntries.end();) {
+    if (iter->key.format == format) {
+      mCost -= iter->cost;
+      mIndex.erase(iter->key);
+      iter = mEntries.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+}
+
+
+void TextLayoutCache::SetBudget(size_t budget) {
+  mBudget = budget;
+  Trim();
+}
+
+
+size_t TextLayoutCache::GetCost() const {
+  return mCost;
+}
+
+
+size_t TextLayoutCache::GetCount() const {
+  return mEntries.size();
+}
+
+
+size_t TextLayoutCache::GetHits() const {
+  return mHits;
+}
+
+
+size_t TextLayoutCache::GetMisses() const {
+  return mMisses;
+}
+
+
+void TextLayoutCache::Trim() {
+  // Always keep the most recent entry, even if it alone is over budget.
+  while (mCost > mBudget && mEntries.size() > 1) {
+    Entry &entry = mEntries.back();
+    mCost -= entry.cost;
+    mIndex.erase(entry.key);
+    mEntries.pop_back();
+  }
+}
+
+
+bool TextLayoutCache::Key::operator==(const Key &other) const {
+  return textHash == other.textHash && format == other.format && maxWidth == other.maxWidth
+    && maxHeight == other.maxHeight && text == other.text;
+}
+
+
+size_t TextLayoutCache::KeyHash::operator()(const Key &key) const {
+  size_t hash = key.textHash;
+  hash = hash * 31 + std::hash<const void*>()(key.format);
+  hash = hash * 31 + std::hash<float>()(key.maxWidth);
+  hash = hash * 31 + std::hash<float>()(key.maxHeight);
+  return hash;
+}
@@ -0,0 +1,91 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/TextLayoutCache.hpp
+// The nModules Project
+//
+// Shares text layouts between windows which draw the same text in the same box.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "TextShaper.hpp"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/// <summary>
+/// An LRU cache of text layouts, keyed on the text, the format, and the layout box. Layouts are
+/// handed out as shared pointers, so evicting an entry never frees a layout which a window is
+/// still holding on to.
+/// </summary>
+class TextLayoutCache {
+public:
+  typedef std::shared_ptr<const ITextShaper::Layout> LayoutPtr;
+
+public:
+  /// <param name="shaper">Creates the layouts. Must outlive the cache.</param>
+  /// <param name="budget">The approximate number of bytes the cached layouts may use.</param>
+  TextLayoutCache(ITextShaper *shaper, size_t budget);
+
+  TextLayoutCache(const TextLayoutCache&) = delete;
+  TextLayoutCache &operator=(const TextLayoutCache&) = delete;
+
+public:
+  // Removes every entry.
+  void Clear();
+
+  // Returns a layout of the text, creating it if it isn't cached.
+  LayoutPtr Get(const wchar_t *text, const void *format, float maxWidth, float maxHeight);
+
+  // Removes every entry using the given format. Call this after modifying a format, and before
+  // destroying it.
+  void Purge(const void *format);
+
+  // Changes the memory budget, evicting entries if necessary.
+  void SetBudget(size_t budget);
+
+public:
+  size_t GetCost() const;
+  size_t GetCount() const;
+  size_t GetHits() const;
+  size_t GetMisses() const;
+
+private:
+  struct Key {
+    std::wstring text;
+    size_t textHash;
+    const void *format;
+    float maxWidth;
+    float maxHeight;
+
+    bool operator==(const Key &other) const;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+
+  struct Entry {
+    Key key;
+    LayoutPtr layout;
+    size_t cost;
+  };
+
+  typedef std::list<Entry> EntryList;
+
+private:
+  // Drops the least recently used entries until the cache is within its budget.
+  void Trim();
+
+private:
+  ITextShaper *const mShaper;
+  size_t mBudget;
+  size_t mCost;
+
+  // Most recently used first.
+  EntryList mEntries;
+  std::unordered_map<Key, EntryList::iterator, KeyHash> mIndex;
+
+  size_t mHits;
+  size_t mMisses;
+};
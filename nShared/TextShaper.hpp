@@ -0,0 +1,43 @@
+//-------------------------------------------------------------------------------------------------
+// /nShared/TextShaper.hpp
+// The nModules Project
+//
+// Abstract interface for creating and measuring text layouts.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <stddef.h>
+
+/// <summary>
+/// Creates text layouts. The layout cache only talks to this interface, so that its policy does
+/// not depend on DirectWrite.
+/// </summary>
+class ITextShaper {
+public:
+  /// <summary>
+  /// A shaped block of text.
+  /// </summary>
+  class Layout {
+  public:
+    virtual ~Layout() {}
+
+    // Retrieves the size of the shaped text.
+    virtual void GetSize(float *width, float *height) const = 0;
+  };
+
+public:
+  virtual ~ITextShaper() {}
+
+  /// <summary>
+  /// Shapes the given text.
+  /// </summary>
+  /// <param name="text">The text to shape.</param>
+  /// <param name="length">The number of characters in text.</param>
+  /// <param name="format">The format to shape the text with. Opaque to the cache.</param>
+  /// <param name="maxWidth">The width of the layout box.</param>
+  /// <param name="maxHeight">The height of the layout box.</param>
+  /// <param name="cost">Receives the approximate number of bytes the layout uses.</param>
+  /// <returns>The new layout, or nullptr on failure.</returns>
+  virtual Layout *CreateLayout(const wchar_t *text, size_t length, const void *format,
+    float maxWidth, float maxHeight, size_t *cost) = 0;
+};
@@ -47,6 +47,7 @@ void Window::TextChangeHandler(LPVOID drawable) {
 Window::Window(Settings* settings, MessageHandler* msgHandler)
     : activeChild(nullptr)
     , mAnimating(false)
+    , mAnimationStartTime(0)
     , initialized(false)
     , isTrackingMouse(false)
     , msgHandler(msgHandler)
@@ -66,6 +67,7 @@ Window::Window(Settings* settings, MessageHandler* msgHandler)
     , mCoveredByFullscreen(false)
     , mWindowData(nullptr)
     , mStateRender(nullptr)
+    , mFrameLock(nullptr)
 {
     ZeroMemory(&this->drawingArea, sizeof(this->drawingArea));
 }
@@ -187,6 +189,10 @@ Window::Window(Window* parent, Settings* settings, MessageHandler* msgHandler)
 /// </summary>
 Window::~Window() {
   this->initialized = false;
+  nCore::UnscheduleFrame(this);
+  if (!mIsChild) {
+    nCore::RemoveFrameSurface(this);
+  }
   if (mParent) {
     mParent->RemoveChild(this);
   } else if (mIsChild) {
@@ -197,6 +203,7 @@ Window::~Window() {
   for (UpdateLock *lock : mActiveLocks) {
     lock->mLocked = false;
   }
+  SAFEDELETE(mFrameLock);
 
   // Register with the core
   if (mWindowSettings.registerWithCore) {
@@ -323,11 +330,14 @@ Window::PAINTER Window::AddPrePainter(IPainter* painter)
 /// <summary>
 /// Performs an animation step.
 /// </summary>
-void Window::Animate() {
-  float progress = Easing::Transform(Clamp(0.0f, mAnimationClock.GetTime() / mAnimationDuration, 1.0f), mAnimationEasing);
+double Window::OnFrame(double time) {
+  float linear = mAnimationDuration > 0.0f
+    ? float(time - mAnimationStartTime) / mAnimationDuration : 1.0f;
+  float progress = Easing::GetTable(mAnimationEasing).Transform(Clamp(0.0f, linear, 1.0f));
 
-  if (progress >= 1.0f) {
+  if (linear >= 1.0f) {
     mAnimating = false;
+    progress = 1.0f;
   }
 
   Rect step;
@@ -337,6 +347,60 @@ void Window::Animate() {
   step.bottom = mAnimationStart.bottom + (mAnimationTarget.bottom - mAnimationStart.bottom)*progress;
 
   SetPosition(step.left, step.top, step.right - step.left, step.bottom - step.top);
+
+  return mAnimating ? time : -1.0;
+}
+
+
+/// <summary>
+/// Starts grouping repaints for this frame.
+/// </summary>
+void Window::BeginFrame() {
+  if (!mFrameLock) {
+    mFrameLock = new UpdateLock(this);
+  }
+}
+
+
+/// <summary>
+/// Repaints everything that changed during this frame.
+/// </summary>
+void Window::EndFrame() {
+  SAFEDELETE(mFrameLock);
+}
+
+
+/// <summary>
+/// Moves running animations in this subtree to the current top-level window, or pauses them
+/// while there is none.
+/// </summary>
+void Window::UpdateAnimationSurface() {
+  if (mAnimating) {
+    IFrameSurface *surface = GetFrameSurface();
+    if (surface) {
+      nCore::ScheduleFrame(this, surface, nCore::GetFrameTime());
+    } else {
+      nCore::UnscheduleFrame(this);
+    }
+  }
+  for (Window *child : this->children) {
+    child->UpdateAnimationSurface();
+  }
+}
+
+
+/// <summary>
+/// Returns the top-level window this window paints to.
+/// </summary>
+IFrameSurface *Window::GetFrameSurface() {
+  Window *window = this;
+  while (window->mIsChild) {
+    window = window->mParent;
+    if (window == nullptr) {
+      return nullptr;
+    }
+  }
+  return window;
 }
 
 
@@ -695,7 +759,6 @@ LRESULT WINAPI Window::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARA
 
     case WM_PAINT:
         {
-            bool inAnimation = false;
             RECT updateRect;
 
             UpdateLock lock(this);
@@ -711,7 +774,7 @@ LRESULT WINAPI Window::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARA
                     mRenderTarget->PushAxisAlignedClip(&d2dUpdateRect, D2D1_ANTIALIAS_MODE_ALIASED);
                     mRenderTarget->Clear();
 
-                    Paint(inAnimation, &d2dUpdateRect);
+                    Paint(&d2dUpdateRect);
 
                     mRenderTarget->PopAxisAlignedClip();
 
@@ -732,22 +795,10 @@ LRESULT WINAPI Window::HandleMessage(HWND window, UINT msg, WPARAM wParam, LPARA
                 //    SendMessage(hwnd, WM_PAINT, 0, 0);
                 //    return TRUE;
                 //}, 0);
-
-                // Handled specially here for top-level windows, as we must NOT resize
-                // the top-level window between BeginPaint and EndPaint.
-                if (mAnimating)
-                {
-                    Animate();
-                }
             }
 
             // We just painted, don't update
             mNeedsUpdate = false;
-
-            if (inAnimation)
-            {
-                PostMessage(window, WM_ANIMATIONPAINT, 0, 0);
-            }
         }
         return 0;
 
@@ -928,7 +979,7 @@ void Window::Move(Distance x, Distance y)
 /// <summary>
 /// Removes the specified child.
 /// </summary>
-void Window::Paint(bool &inAnimation, D2D1_RECT_F *updateRect)
+void Window::Paint(D2D1_RECT_F *updateRect)
 {
     UpdateLock lock(this);
     if (this->visible && RectIntersectArea(updateRect, &this->drawingArea) > 0)
@@ -951,7 +1002,7 @@ void Window::Paint(bool &inAnimation, D2D1_RECT_F *updateRect)
         PaintOverlays(updateRect);
 
         // Paint all children.
-        PaintChildren(inAnimation, updateRect);
+        PaintChildren(updateRect);
 
         // Post painters.
         for (IPainter *painter : this->postPainters)
@@ -959,12 +1010,6 @@ void Window::Paint(bool &inAnimation, D2D1_RECT_F *updateRect)
             painter->Paint(mRenderTarget);
         }
 
-        inAnimation |= mAnimating;
-        if (mAnimating && mIsChild)
-        {
-            Animate();
-        }
-
         mRenderTarget->PopAxisAlignedClip();
     }
 }
@@ -973,11 +1018,41 @@ void Window::Paint(bool &inAnimation, D2D1_RECT_F *updateRect)
 /// <summary>
 /// Paints all child windows.
 /// </summary>
-void Window::PaintChildren(bool &inAnimation, D2D1_RECT_F *updateRect)
+void Window::PaintChildren(D2D1_RECT_F *updateRect)
+{
+    for (Window *child : this->children)
+    {
+        child->Paint(updateRect);
+    }
+}
+
+
+/// <summary>
+/// Paints all child windows into the given render target, and then points them back at ours.
+/// </summary>
+void Window::PaintChildren(D2D1_RECT_F *updateRect, ID2D1RenderTarget *renderTarget)
 {
     for (Window *child : this->children)
     {
-        child->Paint(inAnimation, updateRect);
+        child->RouteRenderTarget(renderTarget);
+        child->Paint(updateRect);
+        child->RouteRenderTarget(mRenderTarget);
+    }
+}
+
+
+/// <summary>
+/// Switches the render target of this window, and its children, if they have one.
+/// </summary>
+void Window::RouteRenderTarget(ID2D1RenderTarget *renderTarget)
+{
+    if (mRenderTarget)
+    {
+        mRenderTarget = renderTarget;
+        for (Window *child : this->children)
+        {
+            child->RouteRenderTarget(renderTarget);
+        }
     }
 }
 
@@ -1003,6 +1078,7 @@ void Window::ParentLeft()
 {
     mParent = nullptr;
     UpdateParentVariables();
+    UpdateAnimationSurface();
     SendToAll(nullptr, WM_TOPPARENTLOST, 0, 0, this);
 
     if (*mParentName != '\0')
@@ -1089,26 +1165,10 @@ HRESULT Window::ReCreateDeviceResources()
     {
         if (!mIsChild)
         {
-            ID2D1Factory *pD2DFactory = nullptr;
-            hr = Factories::GetD2DFactory(reinterpret_cast<LPVOID*>(&pD2DFactory));
-
-            // Create the render target
+            hr = CreateRenderTarget(&mRenderTarget);
             if (SUCCEEDED(hr))
             {
-                hr = pD2DFactory->CreateHwndRenderTarget(
-                    D2D1::RenderTargetProperties(
-                        D2D1_RENDER_TARGET_TYPE_DEFAULT,
-                        D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED),
-                        96.0f,
-                        96.0f
-                    ),
-                    D2D1::HwndRenderTargetProperties(this->window, D2D1::SizeU((UINT32)mSize.width, (UINT32)mSize.height)),
-                    &mRenderTarget
-                );
-                if (SUCCEEDED(hr))
-                {
-                    mRenderTarget->SetTextAntialiasMode(mWindowSettings.textAntiAliasMode);
-                }
+                mRenderTarget->SetTextAntialiasMode(mWindowSettings.textAntiAliasMode);
             }
         }
         else
@@ -1156,6 +1216,38 @@ HRESULT Window::ReCreateDeviceResources()
 }
 
 
+/// <summary>
+/// Creates a render target for the whole window.
+/// </summary>
+/// <returns>S_OK if successful, an error code otherwise.</returns>
+HRESULT Window::CreateRenderTarget(ID2D1RenderTarget **renderTarget)
+{
+    ID2D1Factory *pD2DFactory = nullptr;
+    ID2D1HwndRenderTarget *hwndRenderTarget = nullptr;
+
+    HRESULT hr = Factories::GetD2DFactory(reinterpret_cast<LPVOID*>(&pD2DFactory));
+    if (SUCCEEDED(hr))
+    {
+        hr = pD2DFactory->CreateHwndRenderTarget(
+            D2D1::RenderTargetProperties(
+                D2D1_RENDER_TARGET_TYPE_DEFAULT,
+                D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED),
+                96.0f,
+                96.0f
+            ),
+            D2D1::HwndRenderTargetProperties(this->window, D2D1::SizeU((UINT32)mSize.width, (UINT32)mSize.height)),
+            &hwndRenderTarget
+        );
+    }
+    if (SUCCEEDED(hr))
+    {
+        *renderTarget = hwndRenderTarget;
+    }
+
+    return hr;
+}
+
+
 /// <summary>
 /// Releases a SetMouseCapture
 /// </summary>
@@ -1336,11 +1428,11 @@ void Window::SetAnimation(Distance x, Distance y, Distance width, Distance heigh
     mAnimationTarget = Rect(x, y, x + width, y + height);
     mAnimationStart = Rect(mWindowSettings.x, mWindowSettings.y, mWindowSettings.x + mWindowSettings.width, mWindowSettings.y + mWindowSettings.height);
     mAnimationEasing = easing;
-    mAnimationClock.Clock();
+    mAnimationStartTime = nCore::GetFrameTime();
     mAnimationDuration = duration / 1000.0f;
     mAnimating = true;
 
-    Repaint();
+    nCore::ScheduleFrame(this, GetFrameSurface(), mAnimationStartTime);
 }
 
 
@@ -1494,6 +1586,7 @@ void Window::SetParent(Window *newParent)
 
     UpdateParentVariables();
     SendToAll(this->window, WM_NEWTOPPARENT, 0, 0, this);
+    UpdateAnimationSurface();
 
     SetPosition(mWindowSettings.x, mWindowSettings.y,
         mWindowSettings.width, mWindowSettings.height);
@@ -1559,8 +1652,11 @@ void Window::SetPosition(Distance x, Distance y, Distance width, Distance height
   if (!mIsChild) {
     SetWindowPos(this->window, 0, int(mPosition.x + 0.5f), int(mPosition.y + 0.5f), int(mSize.width + 0.5f), int(mSize.height + 0.5f), SWP_NOZORDER | SWP_NOACTIVATE);
     this->drawingArea = D2D1::RectF(0, 0, mSize.width, mSize.height);
-    if (mRenderTarget) {
-      VERIFY_HR(mRenderTarget->Resize(D2D1::SizeU(UINT32(mSize.width + 0.5f), UINT32(mSize.height + 0.5f))));
+    // Windows which create their own kind of render target handle resizing it themselves.
+    ID2D1HwndRenderTarget *hwndRenderTarget;
+    if (mRenderTarget && SUCCEEDED(mRenderTarget->QueryInterface(&hwndRenderTarget))) {
+      VERIFY_HR(hwndRenderTarget->Resize(D2D1::SizeU(UINT32(mSize.width + 0.5f), UINT32(mSize.height + 0.5f))));
+      hwndRenderTarget->Release();
     }
   } else if(mParent) {
     this->drawingArea = D2D1::RectF(
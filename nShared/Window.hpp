@@ -17,6 +17,7 @@
 #include <map>
 #include "../Utilities/UIDGenerator.hpp"
 #include "Easing.h"
+#include "../nCore/IFrameListener.hpp"
 #include "../nCore/IParsedText.hpp"
 #include "IPainter.hpp"
 #include "BrushSettings.hpp"
@@ -28,7 +29,7 @@
 #include <set>
 
 
-class Window : MessageHandler, IDropTarget
+class Window : MessageHandler, IDropTarget, IFrameListener, IFrameSurface
 {
     // typedefs
 public:
@@ -295,19 +296,37 @@ public:
     HRESULT WINAPI DragLeave() override;
     HRESULT WINAPI Drop(IDataObject *dataObj, DWORD keyState, POINTL point, DWORD *effect) override;
 
+    // IFrameListener
+private:
+    double OnFrame(double time) override;
+
+    // IFrameSurface
+private:
+    void BeginFrame() override;
+    void EndFrame() override;
+
+public:
+    // The top-level window this window paints to, or nullptr if it has no parent yet. Listeners
+    // which repaint this window should be scheduled on this surface.
+    IFrameSurface *GetFrameSurface();
+
 
 protected:
     // Paints this window.
-    void Paint(bool &inAnimation, D2D1_RECT_F *updateRect);
+    void Paint(D2D1_RECT_F *updateRect);
 
     // Paints all overlays.
     void PaintOverlays(D2D1_RECT_F *updateRect);
 
     // Paints all children.
-    void PaintChildren(bool &inAnimation, D2D1_RECT_F *updateRect);
+    void PaintChildren(D2D1_RECT_F *updateRect);
+
+    // Paints the children into another render target than this window's. The target has to be on
+    // the same Direct2D device as this window's, so that the children's resources work with it.
+    void PaintChildren(D2D1_RECT_F *updateRect, ID2D1RenderTarget *renderTarget);
 
     // The render target to draw to.
-    ID2D1HwndRenderTarget *mRenderTarget;
+    ID2D1RenderTarget *mRenderTarget;
 
     // Discards device-dependent stuff.
     void DiscardDeviceResources();
@@ -315,7 +334,13 @@ protected:
     // (Re)Creates D2D device-dependent stuff.
     HRESULT ReCreateDeviceResources();
 
+    // Creates the render target of a top-level window. By default, one which covers the window.
+    virtual HRESULT CreateRenderTarget(ID2D1RenderTarget **renderTarget);
+
 private:
+    // Makes this window, and all its children, paint into the given render target.
+    void RouteRenderTarget(ID2D1RenderTarget *renderTarget);
+
     // Called by IParsedText objects when we should update the text.
     static void TextChangeHandler(LPVOID drawable);
 
@@ -327,8 +352,8 @@ private:
     bool UpdateDWMColor(ARGB newColor);
 
 private:
-    //
-    void Animate();
+    // Reschedules running animations after the top-level window has changed.
+    void UpdateAnimationSurface();
 
     // Removes the specified child.
     void RemoveChild(Window* child);
@@ -364,8 +389,8 @@ private:
     // If we are currently doing an animation, the position at the start of the animation.
     Rect mAnimationStart;
 
-    // If we are currently doing an animation, how far along we are.
-    StopWatch mAnimationClock;
+    // If we are currently doing an animation, the frame time at which it started.
+    double mAnimationStartTime;
 
     // If we are currently doing an animation, the position target of the animation.
     Rect mAnimationTarget;
@@ -454,6 +479,9 @@ private:
     // All currently active locks.
     std::set<UpdateLock*> mActiveLocks;
 
+    // Held between BeginFrame and EndFrame, so that the window is only repainted once per frame.
+    UpdateLock *mFrameLock;
+
 public:
     // Registers a part of this window as a drop-region
     void AddDropRegion(LPRECT region, IDropTarget *handler);
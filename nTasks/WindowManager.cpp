@@ -142,6 +142,7 @@ void WindowManager::AddWindow(HWND hWnd)
         wndInfo.uMonitor = nCore::FetchMonitorInfo().MonitorFromHWND(hWnd);
         wndInfo.lastUpdateTime = GetTickCount64();
         wndInfo.updateDuringMaintenance = false;
+        wndInfo.hSourceIcon = nullptr;
 
         // Add it to any taskbar that wants it
         for (TaskbarMap::value_type &taskbar : gTaskbars)
@@ -594,16 +595,28 @@ void WindowManager::SetIcon(HWND hWnd, HICON hIcon)
     WindowMap::iterator window = windowMap.find(hWnd);
     if (window != windowMap.end())
     {
+        // The icon is asked for every time the window changes, and is nearly always the one we
+        // got last time, in which case there is no need to copy and hash it again. Applications
+        // create a new icon before destroying the one the window is using, so a changed icon
+        // always comes with a different handle.
+        if (hIcon != nullptr && hIcon == window->second.hSourceIcon)
+        {
+            return;
+        }
+        window->second.hSourceIcon = hIcon;
+
         for (TaskButton *button : window->second.buttons)
         {
             button->SetIcon(hIcon);
         }
-        if (window->second.hIcon != nullptr)
+        // Windows of the same application tend to have the same icon, which the core only keeps
+        // once. Store the new icon before releasing the old one, in case they are the same.
+        HICON oldIcon = window->second.hIcon;
+        window->second.hIcon = hIcon != nullptr ? nCore::StoreIcon(nullptr, 0, 0, CopyIcon(hIcon)) : nullptr;
+        if (oldIcon != nullptr)
         {
-            DestroyIcon(window->second.hIcon);
+            nCore::ReleaseIcon(oldIcon);
         }
-
-        window->second.hIcon = CopyIcon(hIcon);
     }
 }
 
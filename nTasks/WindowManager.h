@@ -7,6 +7,8 @@
 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 #pragma once
 
+#include "../nCoreCom/Core.h"
+
 #include <string>
 #include <unordered_map>
 
@@ -24,7 +26,7 @@ namespace WindowManager
         {
             if (hIcon != nullptr)
             {
-                DestroyIcon(hIcon);
+                nCore::ReleaseIcon(hIcon);
             }
             if (hOverlayIcon != nullptr)
             {
@@ -41,6 +43,9 @@ namespace WindowManager
         // The main icon of the window
         HICON hIcon;
 
+        // The icon the window handed us, which hIcon is a stored copy of
+        HICON hSourceIcon;
+
         // Any overlay icon
         HICON hOverlayIcon;
 
@@ -5,6 +5,8 @@
 // Manages nWallpaper specific bang commmands.
 //-------------------------------------------------------------------------------------------------
 #include "Bangs.h"
+#include "nWallpaper.h"
+#include "Slideshow.hpp"
 
 #include "../nCoreCom/Core.h"
 
@@ -60,6 +62,24 @@ static const BangItem bangMap[] = {
       SHSetValue(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"WallpaperStyle", REG_SZ, value, (DWORD)wcslen(value)*sizeof(wchar_t));
       SendNotifyMessage(HWND_BROADCAST, WM_SETTINGCHANGE, SPI_SETDESKWALLPAPER, 0);
     }
+  }),
+  BangItem(L"!WallpaperSlideshowNext", [] (HWND, LPCWSTR) {
+    if (gSlideshow) {
+      gSlideshow->Next(GetTickCount64());
+      ScheduleSlideshow();
+    }
+  }),
+  BangItem(L"!WallpaperSlideshowPause", [] (HWND, LPCWSTR) {
+    if (gSlideshow) {
+      gSlideshow->Stop();
+      ScheduleSlideshow();
+    }
+  }),
+  BangItem(L"!WallpaperSlideshowResume", [] (HWND, LPCWSTR) {
+    if (gSlideshow) {
+      gSlideshow->Start(GetTickCount64());
+      ScheduleSlideshow();
+    }
   })
 };
 
@@ -0,0 +1,116 @@
+//-------------------------------------------------------------------------------------------------
+// /nWallpaper/Playlist.cpp
+// The nModules Project
+//
+// The order in which a slideshow shows its files.
+//-------------------------------------------------------------------------------------------------
+#include "Playlist.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+
+Playlist::Playlist()
+  : mOrder(Order::Sequential)
+  , mCurrent(NONE)
+{
+}
+
+
+void Playlist::SetFiles(std::vector<std::wstring> &&files) {
+  size_t current = NONE;
+  if (mCurrent != NONE) {
+    auto iter = std::find(files.begin(), files.end(), mFiles[mCurrent]);
+    if (iter != files.end()) {
+      current = size_t(iter - files.begin());
+    }
+  }
+
+  mFiles = std::move(files);
+  mCurrent = current;
+  mUpcoming.clear();
+}
+
+
+void Playlist::SetOrder(Order order) {
+  mOrder = order;
+  mUpcoming.clear();
+}
+
+
+void Playlist::SetSeed(uint32_t seed) {
+  mRandom.seed(seed);
+  mUpcoming.clear();
+}
+
+
+bool Playlist::IsEmpty() const {
+  return mFiles.empty();
+}
+
+
+size_t Playlist::GetSize() const {
+  return mFiles.size();
+}
+
+
+const std::wstring &Playlist::Next() {
+  Fill(0);
+  mCurrent = mUpcoming.front();
+  mUpcoming.pop_front();
+  return mFiles[mCurrent];
+}
+
+
+const std::wstring &Playlist::Peek(size_t ahead) {
+  Fill(ahead);
+  return mFiles[mUpcoming[ahead]];
+}
+
+
+const std::wstring *Playlist::GetCurrent() const {
+  return mCurrent == NONE ? nullptr : &mFiles[mCurrent];
+}
+
+
+void Playlist::Fill(size_t count) {
+  const size_t size = mFiles.size();
+
+  while (mUpcoming.size() <= count) {
+    const size_t last = GetLast();
+
+    switch (mOrder) {
+    case Order::Sequential:
+      mUpcoming.push_back(last == NONE ? 0 : (last + 1) % size);
+      break;
+
+    case Order::Shuffle:
+      {
+        std::vector<size_t> cycle(size);
+        std::iota(cycle.begin(), cycle.end(), size_t(0));
+        std::shuffle(cycle.begin(), cycle.end(), mRandom);
+        // Don't repeat the last file of the previous cycle.
+        if (size > 1 && cycle.front() == last) {
+          std::swap(cycle.front(), cycle.back());
+        }
+        mUpcoming.insert(mUpcoming.end(), cycle.begin(), cycle.end());
+      }
+      break;
+
+    case Order::Random:
+      if (size == 1 || last == NONE) {
+        mUpcoming.push_back(std::uniform_int_distribution<size_t>(0, size - 1)(mRandom));
+      } else {
+        // Pick from every file but the last one.
+        size_t index = std::uniform_int_distribution<size_t>(0, size - 2)(mRandom);
+        mUpcoming.push_back(index >= last ? index + 1 : index);
+      }
+      break;
+    }
+  }
+}
+
+
+size_t Playlist::GetLast() const {
+  return mUpcoming.empty() ? mCurrent : mUpcoming.back();
+}
@@ -0,0 +1,89 @@
+//-------------------------------------------------------------------------------------------------
+// /nWallpaper/Playlist.hpp
+// The nModules Project
+//
+// The order in which a slideshow shows its files.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <deque>
+#include <random>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Picks the files a slideshow shows, and lets the slideshow look ahead at the files which come
+/// next, so that they can be prepared before they are needed.
+/// </summary>
+class Playlist {
+public:
+  enum class Order {
+    // In the order the files were given in.
+    Sequential,
+    // Every file once, in a random order, then again in a new random order.
+    Shuffle,
+    // A random file every time. Never the same file twice in a row.
+    Random
+  };
+
+public:
+  Playlist();
+
+public:
+  /// <summary>
+  /// Replaces the files. If the current file is still there, a sequential playlist continues
+  /// from it.
+  /// </summary>
+  void SetFiles(std::vector<std::wstring> &&files);
+
+  /// <summary>
+  /// Changes the order. Anything already looked at with Peek is forgotten.
+  /// </summary>
+  void SetOrder(Order order);
+
+  /// <summary>
+  /// Seeds the random number generator, for shuffle and random orders.
+  /// </summary>
+  void SetSeed(uint32_t seed);
+
+  bool IsEmpty() const;
+  size_t GetSize() const;
+
+  /// <summary>
+  /// Moves on to the next file, and returns it. The playlist must not be empty.
+  /// </summary>
+  const std::wstring &Next();
+
+  /// <summary>
+  /// Returns the file which Next will return after it has been called ahead more times. The
+  /// playlist must not be empty.
+  /// </summary>
+  const std::wstring &Peek(size_t ahead);
+
+  /// <summary>
+  /// Returns the file Next returned last, or nullptr.
+  /// </summary>
+  const std::wstring *GetCurrent() const;
+
+private:
+  // Makes sure that there are more than count files in mUpcoming.
+  void Fill(size_t count);
+
+  // The last file which has been picked, whether it has been shown or not.
+  size_t GetLast() const;
+
+private:
+  static const size_t NONE = size_t(-1);
+
+private:
+  std::vector<std::wstring> mFiles;
+  Order mOrder;
+  std::minstd_rand mRandom;
+
+  // Indices of the files which have been picked, but not returned by Next yet.
+  std::deque<size_t> mUpcoming;
+
+  // The index of the current file, or NONE.
+  size_t mCurrent;
+};
@@ -0,0 +1,219 @@
+//-------------------------------------------------------------------------------------------------
+// /nWallpaper/Prefetcher.cpp
+// The nModules Project
+//
+// Prepares upcoming wallpapers on a worker thread.
+//-------------------------------------------------------------------------------------------------
+#include "Prefetcher.hpp"
+
+#include <algorithm>
+
+static const size_t NO_WORK = size_t(-1);
+
+
+Prefetcher::Image::Image()
+  : bytes(0)
+{
+}
+
+
+Prefetcher::Prefetcher(IPreparer *preparer)
+  : mPreparer(preparer)
+  , mMaxImages(2)
+  , mMaxBytes(256ull << 20)
+  , mPreparedBytes(0)
+  , mLargest(0)
+  , mBusy(false)
+  , mGeneration(0)
+  , mStopping(false)
+{
+  mWorker = std::thread(&Prefetcher::Run, this);
+}
+
+
+Prefetcher::~Prefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopping = true;
+    ++mGeneration;
+  }
+  mWake.notify_one();
+  mWorker.join();
+
+  for (const Image &image : mPrepared) {
+    if (!image.path.empty()) {
+      mPreparer->Discard(image);
+    }
+  }
+}
+
+
+void Prefetcher::SetLimits(size_t maxImages, uint64_t maxBytes) {
+  std::vector<std::wstring> upcoming;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mMaxImages = maxImages;
+    mMaxBytes = maxBytes;
+    upcoming = mUpcoming;
+  }
+
+  // Drops whatever no longer fits.
+  SetUpcoming(upcoming);
+}
+
+
+void Prefetcher::SetUpcoming(const std::vector<std::wstring> &sources) {
+  std::vector<Image> discarded;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mUpcoming.clear();
+    for (const std::wstring &source : sources) {
+      if (mUpcoming.size() == mMaxImages) {
+        break;
+      }
+      if (std::find(mUpcoming.begin(), mUpcoming.end(), source) == mUpcoming.end()) {
+        mUpcoming.push_back(source);
+      }
+    }
+
+    auto unneeded = std::stable_partition(mPrepared.begin(), mPrepared.end(),
+        [this] (const Image &image) {
+      return std::find(mUpcoming.begin(), mUpcoming.end(), image.source) != mUpcoming.end();
+    });
+    for (auto iter = unneeded; iter != mPrepared.end(); ++iter) {
+      mPreparedBytes -= iter->bytes;
+      if (!iter->path.empty()) {
+        discarded.push_back(std::move(*iter));
+      }
+    }
+    mPrepared.erase(unneeded, mPrepared.end());
+
+    if (mBusy && std::find(mUpcoming.begin(), mUpcoming.end(), mWorking) == mUpcoming.end()) {
+      ++mGeneration;
+    }
+  }
+  mWake.notify_one();
+
+  for (const Image &image : discarded) {
+    mPreparer->Discard(image);
+  }
+}
+
+
+bool Prefetcher::Take(const std::wstring &source, Image *image) {
+  bool taken = false;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = std::find_if(mPrepared.begin(), mPrepared.end(), [&source] (const Image &image) {
+      return image.source == source;
+    });
+    if (iter != mPrepared.end()) {
+      taken = !iter->path.empty();
+      mPreparedBytes -= iter->bytes;
+      *image = std::move(*iter);
+      mPrepared.erase(iter);
+    }
+    // It's no longer upcoming. The caller will say so if it's needed again.
+    mUpcoming.erase(std::remove(mUpcoming.begin(), mUpcoming.end(), source), mUpcoming.end());
+  }
+  // There is room for another one.
+  mWake.notify_one();
+  return taken;
+}
+
+
+void Prefetcher::Discard(const Image &image) {
+  if (!image.path.empty()) {
+    mPreparer->Discard(image);
+  }
+}
+
+
+size_t Prefetcher::GetPreparedCount() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return size_t(std::count_if(mPrepared.begin(), mPrepared.end(), [] (const Image &image) {
+    return !image.path.empty();
+  }));
+}
+
+
+uint64_t Prefetcher::GetPreparedBytes() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mPreparedBytes;
+}
+
+
+bool Prefetcher::IsIdle() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return !mBusy && FindWork() == NO_WORK;
+}
+
+
+void Prefetcher::Run() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  for (;;) {
+    size_t work;
+    mWake.wait(lock, [this, &work] () {
+      return mStopping || (work = FindWork()) != NO_WORK;
+    });
+    if (mStopping) {
+      return;
+    }
+
+    Image image;
+    image.source = mUpcoming[work];
+    const uint64_t generation = mGeneration;
+    mWorking = image.source;
+    mBusy = true;
+    lock.unlock();
+
+    bool success = mPreparer->Prepare([this, generation] () {
+      return mGeneration != generation;
+    }, &image);
+
+    lock.lock();
+    mBusy = false;
+    const bool wanted = generation == mGeneration
+      && std::find(mUpcoming.begin(), mUpcoming.end(), image.source) != mUpcoming.end();
+    if (wanted) {
+      if (!success) {
+        // Remember the failure, so that it isn't tried again while it's upcoming.
+        Image failed;
+        failed.source = std::move(image.source);
+        mPrepared.push_back(std::move(failed));
+      } else {
+        mPreparedBytes += image.bytes;
+        mLargest = std::max(mLargest, image.bytes);
+        mPrepared.push_back(std::move(image));
+      }
+    } else if (success) {
+      lock.unlock();
+      mPreparer->Discard(image);
+      lock.lock();
+    }
+  }
+}
+
+
+size_t Prefetcher::FindWork() const {
+  const bool empty = mPreparedBytes == 0;
+  for (size_t i = 0; i < mUpcoming.size(); ++i) {
+    if (IsPrepared(mUpcoming[i])) {
+      continue;
+    }
+    // Stay within the budget, but always have something ready.
+    if (!empty && mPreparedBytes + mLargest > mMaxBytes) {
+      return NO_WORK;
+    }
+    return i;
+  }
+  return NO_WORK;
+}
+
+
+bool Prefetcher::IsPrepared(const std::wstring &source) const {
+  return std::any_of(mPrepared.begin(), mPrepared.end(), [&source] (const Image &image) {
+    return image.source == source;
+  });
+}
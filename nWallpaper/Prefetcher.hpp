@@ -0,0 +1,141 @@
+//-------------------------------------------------------------------------------------------------
+// /nWallpaper/Prefetcher.hpp
+// The nModules Project
+//
+// Prepares upcoming wallpapers on a worker thread.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Prepares the wallpapers a slideshow is about to show on a worker thread, in the order they are
+/// needed, so that switching to one doesn't have to decode or scale anything. The number of
+/// prepared images, and the number of bytes they take up, are both bounded.
+/// </summary>
+class Prefetcher {
+public:
+  /// <summary>
+  /// A prepared wallpaper.
+  /// </summary>
+  struct Image {
+    Image();
+
+    // The file the image was prepared from.
+    std::wstring source;
+
+    // What to set as the wallpaper. Empty if the source couldn't be prepared.
+    std::wstring path;
+
+    // How much memory or disk space the image is holding on to.
+    uint64_t bytes;
+  };
+
+  /// <summary>
+  /// Does the actual preparation.
+  /// </summary>
+  class IPreparer {
+  public:
+    /// <summary>
+    /// Prepares image->source. Called on the worker thread. This should check cancelled every now
+    /// and then, and give up if it returns true.
+    /// </summary>
+    /// <returns>False if the image couldn't be prepared, or if it was cancelled.</returns>
+    virtual bool Prepare(const std::function<bool()> &cancelled, Image *image) = 0;
+
+    /// <summary>
+    /// Frees a prepared image. Called on any thread.
+    /// </summary>
+    virtual void Discard(const Image &image) = 0;
+  };
+
+public:
+  /// <param name="preparer">Prepares the images. Must outlive the prefetcher.</param>
+  explicit Prefetcher(IPreparer *preparer);
+  ~Prefetcher();
+
+  Prefetcher(const Prefetcher&) = delete;
+  Prefetcher &operator=(const Prefetcher&) = delete;
+
+public:
+  /// <summary>
+  /// Limits how far ahead to prepare. At least one image is always prepared, even if it is larger
+  /// than maxBytes.
+  /// </summary>
+  void SetLimits(size_t maxImages, uint64_t maxBytes);
+
+  /// <summary>
+  /// Sets the files which will be needed next, the most urgent first. Prepared images which are
+  /// no longer needed are discarded, and work on them is cancelled.
+  /// </summary>
+  void SetUpcoming(const std::vector<std::wstring> &sources);
+
+  /// <summary>
+  /// Takes the prepared image for the file, and removes the file from the upcoming files. The
+  /// caller becomes responsible for discarding the image.
+  /// </summary>
+  /// <returns>False if the file hasn't been prepared.</returns>
+  bool Take(const std::wstring &source, Image *image);
+
+  /// <summary>
+  /// Frees an image which has been taken.
+  /// </summary>
+  void Discard(const Image &image);
+
+  /// <summary>
+  /// The number of prepared images, and the bytes they take up.
+  /// </summary>
+  size_t GetPreparedCount();
+  uint64_t GetPreparedBytes();
+
+  /// <summary>
+  /// True if the worker has nothing left to do within the limits.
+  /// </summary>
+  bool IsIdle();
+
+private:
+  void Run();
+
+  // Returns the index of the next upcoming file to prepare, or -1. Called with the mutex held.
+  size_t FindWork() const;
+
+  // Whether the file has been prepared, or has failed to. Called with the mutex held.
+  bool IsPrepared(const std::wstring &source) const;
+
+private:
+  IPreparer *mPreparer;
+
+  std::mutex mMutex;
+  std::condition_variable mWake;
+
+  size_t mMaxImages;
+  uint64_t mMaxBytes;
+
+  // The files which will be needed, the most urgent first, up to mMaxImages of them.
+  std::vector<std::wstring> mUpcoming;
+
+  // Images which have been prepared, and files which failed to prepare.
+  std::vector<Image> mPrepared;
+  uint64_t mPreparedBytes;
+
+  // The largest image prepared so far, to guess whether the next one fits within the budget.
+  uint64_t mLargest;
+
+  // The file the worker is preparing, if mBusy.
+  std::wstring mWorking;
+  bool mBusy;
+
+  // Incremented to cancel the file being prepared. Only changed with the mutex held, but read
+  // without it to check for cancellation.
+  std::atomic<uint64_t> mGeneration;
+
+  bool mStopping;
+  std::thread mWorker;
+};
@@ -0,0 +1,120 @@
+//-------------------------------------------------------------------------------------------------
+// /nWallpaper/Slideshow.cpp
+// The nModules Project
+//
+// Rotates the wallpaper through a list of files.
+//-------------------------------------------------------------------------------------------------
+#include "Slideshow.hpp"
+
+#include <algorithm>
+
+const uint64_t Slideshow::NEVER;
+
+
+Slideshow::Slideshow(Prefetcher::IPreparer *preparer, ApplyHandler apply)
+  : mPrefetcher(preparer)
+  , mApply(apply)
+  , mInterval(5 * 60 * 1000)
+  , mPrefetchImages(2)
+  , mRunning(false)
+  , mNextSwitch(0)
+{
+  mPrefetcher.SetLimits(mPrefetchImages, 256ull << 20);
+}
+
+
+void Slideshow::SetFiles(std::vector<std::wstring> &&files) {
+  mPlaylist.SetFiles(std::move(files));
+  Prefetch();
+}
+
+
+void Slideshow::SetOrder(Playlist::Order order) {
+  mPlaylist.SetOrder(order);
+  Prefetch();
+}
+
+
+void Slideshow::SetSeed(uint32_t seed) {
+  mPlaylist.SetSeed(seed);
+  Prefetch();
+}
+
+
+void Slideshow::SetInterval(uint64_t interval) {
+  if (mRunning) {
+    mNextSwitch = mNextSwitch - mInterval + interval;
+  }
+  mInterval = interval;
+}
+
+
+void Slideshow::SetPrefetch(size_t images, uint64_t bytes) {
+  mPrefetchImages = images;
+  mPrefetcher.SetLimits(images, bytes);
+  Prefetch();
+}
+
+
+void Slideshow::Start(uint64_t now) {
+  if (!mRunning) {
+    mRunning = true;
+    mNextSwitch = now + mInterval;
+  }
+}
+
+
+void Slideshow::Stop() {
+  mRunning = false;
+}
+
+
+bool Slideshow::IsRunning() const {
+  return mRunning;
+}
+
+
+void Slideshow::Next(uint64_t now) {
+  mNextSwitch = now + mInterval;
+  if (mPlaylist.IsEmpty()) {
+    return;
+  }
+
+  const std::wstring &file = mPlaylist.Next();
+  Prefetcher::Image image;
+  if (mPrefetcher.Take(file, &image)) {
+    mApply(image.path);
+  } else {
+    // Not ready yet. Let the desktop deal with the original.
+    image = Prefetcher::Image();
+    mApply(file);
+  }
+
+  mPrefetcher.Discard(mShown);
+  mShown = std::move(image);
+
+  Prefetch();
+}
+
+
+uint64_t Slideshow::Update(uint64_t now) {
+  if (!mRunning) {
+    return NEVER;
+  }
+  if (now >= mNextSwitch) {
+    Next(now);
+  }
+  return mNextSwitch - now;
+}
+
+
+void Slideshow::Prefetch() {
+  std::vector<std::wstring> upcoming;
+  if (!mPlaylist.IsEmpty()) {
+    const size_t count = std::min(mPrefetchImages, mPlaylist.GetSize());
+    for (size_t i = 0; i < count; ++i) {
+      upcoming.push_back(mPlaylist.Peek(i));
+    }
+  }
+  mPrefetcher.SetUpcoming(upcoming);
+}
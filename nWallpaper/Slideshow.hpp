@@ -0,0 +1,88 @@
+//-------------------------------------------------------------------------------------------------
+// /nWallpaper/Slideshow.hpp
+// The nModules Project
+//
+// Rotates the wallpaper through a list of files.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "Playlist.hpp"
+#include "Prefetcher.hpp"
+
+#include <functional>
+
+/// <summary>
+/// Switches the wallpaper at a fixed interval, and keeps the next few wallpapers prepared so that
+/// the switch itself is free. The slideshow has no clock of its own. The owner passes in the time
+/// and calls Update when it is due.
+/// </summary>
+class Slideshow {
+public:
+  /// <summary>
+  /// Sets the wallpaper to the given file.
+  /// </summary>
+  typedef std::function<void (const std::wstring &file)> ApplyHandler;
+
+  static const uint64_t NEVER = uint64_t(-1);
+
+public:
+  /// <param name="preparer">Prepares upcoming wallpapers. Must outlive the slideshow.</param>
+  /// <param name="apply">Called to switch wallpaper.</param>
+  Slideshow(Prefetcher::IPreparer *preparer, ApplyHandler apply);
+
+  Slideshow(const Slideshow&) = delete;
+  Slideshow &operator=(const Slideshow&) = delete;
+
+public:
+  void SetFiles(std::vector<std::wstring> &&files);
+  void SetOrder(Playlist::Order order);
+  void SetSeed(uint32_t seed);
+  void SetInterval(uint64_t interval);
+
+  /// <summary>
+  /// Sets how many upcoming wallpapers to prepare, and how many bytes they may use.
+  /// </summary>
+  void SetPrefetch(size_t images, uint64_t bytes);
+
+  /// <summary>
+  /// Starts switching wallpapers, the first time once the interval has passed.
+  /// </summary>
+  void Start(uint64_t now);
+
+  /// <summary>
+  /// Stops switching wallpapers. The upcoming wallpapers stay prepared.
+  /// </summary>
+  void Stop();
+
+  bool IsRunning() const;
+
+  /// <summary>
+  /// Switches to the next wallpaper right away, and restarts the interval.
+  /// </summary>
+  void Next(uint64_t now);
+
+  /// <summary>
+  /// Switches wallpaper if the interval has passed.
+  /// </summary>
+  /// <returns>The time until the next switch, or NEVER if the slideshow isn't running.</returns>
+  uint64_t Update(uint64_t now);
+
+private:
+  // Tells the prefetcher which files are next.
+  void Prefetch();
+
+private:
+  Playlist mPlaylist;
+  Prefetcher mPrefetcher;
+  ApplyHandler mApply;
+
+  uint64_t mInterval;
+  size_t mPrefetchImages;
+
+  bool mRunning;
+  uint64_t mNextSwitch;
+
+  // The prepared image which is the wallpaper now. Freed once it is replaced, but not when the
+  // slideshow goes away, since it is still the wallpaper.
+  Prefetcher::Image mShown;
+};
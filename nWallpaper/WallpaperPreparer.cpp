@@ -0,0 +1,241 @@
+//-------------------------------------------------------------------------------------------------
+// /nWallpaper/WallpaperPreparer.cpp
+// The nModules Project
+//
+// Pre-scales slideshow wallpapers to the desktop.
+//-------------------------------------------------------------------------------------------------
+#include "WallpaperPreparer.hpp"
+
+#include "../Utilities/FileIterator.hpp"
+
+#include <algorithm>
+#include <Shlwapi.h>
+#include <ShlObj.h>
+#include <strsafe.h>
+#include <vector>
+#include <wincodec.h>
+
+// The number of rows to copy between checks for cancellation.
+static const UINT ROWS_PER_SLICE = 64;
+
+static const LPCWSTR FILE_PATTERN = L"\\*.bmp";
+
+
+/// <summary>
+/// Works out the size the wallpaper will be shown at, with the current style. This has to match
+/// how the desktop scales wallpapers, otherwise the desktop will scale it again.
+/// </summary>
+static void GetScaledSize(UINT cxWallpaper, UINT cyWallpaper, UINT *width, UINT *height) {
+  WCHAR szTemp[32];
+  DWORD dwSize, dwType;
+
+  dwSize = sizeof(szTemp);
+  if (SHGetValue(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"TileWallpaper", &dwType, &szTemp, &dwSize) == ERROR_SUCCESS
+      && _wtoi(szTemp) != 0) {
+    *width = cxWallpaper;
+    *height = cyWallpaper;
+    return;
+  }
+
+  dwSize = sizeof(szTemp);
+  int style = 0;
+  if (SHGetValue(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"WallpaperStyle", &dwType, &szTemp, &dwSize) == ERROR_SUCCESS) {
+    style = _wtoi(szTemp);
+  }
+
+  double areaWidth = GetSystemMetrics(SM_CXSCREEN);
+  double areaHeight = GetSystemMetrics(SM_CYSCREEN);
+  if (style == 22) {
+    areaWidth = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+    areaHeight = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+  }
+
+  double scaleX = areaWidth / cxWallpaper;
+  double scaleY = areaHeight / cyWallpaper;
+  switch (style) {
+  case 2: // Stretch
+    *width = (UINT)areaWidth;
+    *height = (UINT)areaHeight;
+    break;
+
+  case 6: // Fit
+    if (scaleX > scaleY) {
+      *height = (UINT)areaHeight;
+      *width = (UINT)(scaleY*cxWallpaper);
+    } else {
+      *height = (UINT)(scaleX*cyWallpaper);
+      *width = (UINT)areaWidth;
+    }
+    break;
+
+  case 10: // Fill
+  case 22: // Span
+    if (scaleX < scaleY) {
+      *height = (UINT)areaHeight;
+      *width = (UINT)(scaleY*cxWallpaper);
+    } else {
+      *height = (UINT)(scaleX*cyWallpaper);
+      *width = (UINT)areaWidth;
+    }
+    break;
+
+  default: // Center
+    *width = cxWallpaper;
+    *height = cyWallpaper;
+    break;
+  }
+
+  *width = std::max(1u, *width);
+  *height = std::max(1u, *height);
+}
+
+
+/// <summary>
+/// Writes a top-down 32bpp bitmap file.
+/// </summary>
+static bool WriteBitmap(LPCWSTR path, UINT width, UINT height, const std::vector<BYTE> &pixels) {
+  BITMAPFILEHEADER fileHeader;
+  BITMAPINFOHEADER infoHeader;
+  ZeroMemory(&fileHeader, sizeof(fileHeader));
+  ZeroMemory(&infoHeader, sizeof(infoHeader));
+
+  fileHeader.bfType = 'MB';
+  fileHeader.bfOffBits = sizeof(fileHeader) + sizeof(infoHeader);
+  fileHeader.bfSize = fileHeader.bfOffBits + DWORD(pixels.size());
+  infoHeader.biSize = sizeof(infoHeader);
+  infoHeader.biWidth = LONG(width);
+  infoHeader.biHeight = -LONG(height);
+  infoHeader.biPlanes = 1;
+  infoHeader.biBitCount = 32;
+  infoHeader.biCompression = BI_RGB;
+  infoHeader.biSizeImage = DWORD(pixels.size());
+
+  HANDLE file = CreateFile(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  DWORD written;
+  bool success = WriteFile(file, &fileHeader, sizeof(fileHeader), &written, nullptr) != FALSE
+    && written == sizeof(fileHeader)
+    && WriteFile(file, &infoHeader, sizeof(infoHeader), &written, nullptr) != FALSE
+    && written == sizeof(infoHeader)
+    && WriteFile(file, pixels.data(), DWORD(pixels.size()), &written, nullptr) != FALSE
+    && written == pixels.size();
+  CloseHandle(file);
+
+  if (!success) {
+    DeleteFile(path);
+  }
+  return success;
+}
+
+
+WallpaperPreparer::WallpaperPreparer(LPCWSTR directory)
+  : mDirectory(directory)
+{
+  SHCreateDirectoryEx(nullptr, directory, nullptr);
+}
+
+
+bool WallpaperPreparer::Prepare(const std::function<bool()> &cancelled, Prefetcher::Image *image) {
+  CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+  IWICImagingFactory *factory = nullptr;
+  IWICBitmapDecoder *decoder = nullptr;
+  IWICBitmapFrameDecode *source = nullptr;
+  IWICBitmapScaler *scaler = nullptr;
+  IWICFormatConverter *converter = nullptr;
+  UINT cxWallpaper, cyWallpaper, width, height;
+  std::vector<BYTE> pixels;
+
+  // The shared factory is created lazily on the main thread, so use one of our own.
+  HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+    IID_IWICImagingFactory, reinterpret_cast<LPVOID*>(&factory));
+  if (SUCCEEDED(hr)) {
+    hr = factory->CreateDecoderFromFilename(image->source.c_str(), nullptr, GENERIC_READ,
+      WICDecodeMetadataCacheOnDemand, &decoder);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = decoder->GetFrame(0, &source);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = source->GetSize(&cxWallpaper, &cyWallpaper);
+  }
+  if (SUCCEEDED(hr)) {
+    GetScaledSize(cxWallpaper, cyWallpaper, &width, &height);
+    hr = factory->CreateBitmapScaler(&scaler);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = scaler->Initialize(source, width, height, WICBitmapInterpolationModeCubic);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = factory->CreateFormatConverter(&converter);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = converter->Initialize(scaler, GUID_WICPixelFormat32bppBGR, WICBitmapDitherTypeNone,
+      nullptr, 0.f, WICBitmapPaletteTypeMedianCut);
+  }
+
+  // Copy a slice at a time, so that a file which is no longer needed can be given up on.
+  if (SUCCEEDED(hr)) {
+    const UINT stride = width * 4;
+    pixels.resize(size_t(stride) * height);
+    for (UINT y = 0; y < height && SUCCEEDED(hr); y += ROWS_PER_SLICE) {
+      if (cancelled()) {
+        hr = E_ABORT;
+        break;
+      }
+      WICRect rect = { 0, (INT)y, (INT)width, (INT)std::min(ROWS_PER_SLICE, height - y) };
+      hr = converter->CopyPixels(&rect, stride, stride * rect.Height,
+        pixels.data() + size_t(stride) * y);
+    }
+  }
+
+  SAFERELEASE(converter);
+  SAFERELEASE(scaler);
+  SAFERELEASE(source);
+  SAFERELEASE(decoder);
+  SAFERELEASE(factory);
+
+  CoUninitialize();
+
+  if (FAILED(hr) || cancelled()) {
+    return false;
+  }
+
+  // Name the file after the time, so that it never replaces the current wallpaper.
+  FILETIME now;
+  GetSystemTimeAsFileTime(&now);
+  WCHAR name[32];
+  StringCchPrintf(name, _countof(name), L"\\%08x%08x.bmp", now.dwHighDateTime, now.dwLowDateTime);
+  std::wstring path = mDirectory + name;
+
+  if (!WriteBitmap(path.c_str(), width, height, pixels)) {
+    return false;
+  }
+
+  image->path = path;
+  image->bytes = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + pixels.size();
+  return true;
+}
+
+
+void WallpaperPreparer::Discard(const Prefetcher::Image &image) {
+  DeleteFile(image.path.c_str());
+}
+
+
+void WallpaperPreparer::Clean(LPCWSTR keep) {
+  std::vector<std::wstring> stale;
+  for (const WIN32_FIND_DATA &findData : FileIterator((mDirectory + FILE_PATTERN).c_str())) {
+    std::wstring path = mDirectory + L"\\" + findData.cFileName;
+    if (_wcsicmp(path.c_str(), keep) != 0) {
+      stale.push_back(path);
+    }
+  }
+  for (const std::wstring &path : stale) {
+    DeleteFile(path.c_str());
+  }
+}
@@ -0,0 +1,35 @@
+//-------------------------------------------------------------------------------------------------
+// /nWallpaper/WallpaperPreparer.hpp
+// The nModules Project
+//
+// Pre-scales slideshow wallpapers to the desktop.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+#include "Prefetcher.hpp"
+
+#include "../Utilities/Common.h"
+
+/// <summary>
+/// Decodes wallpapers and scales them to the size the current wallpaper style will show them at,
+/// then stores them as uncompressed bitmaps. Setting one of those as the wallpaper takes no
+/// decoding, and no scaling, by whoever paints the desktop.
+/// </summary>
+class WallpaperPreparer : public Prefetcher::IPreparer {
+public:
+  /// <param name="directory">Where to keep the prepared bitmaps.</param>
+  explicit WallpaperPreparer(LPCWSTR directory);
+
+public:
+  bool Prepare(const std::function<bool()> &cancelled, Prefetcher::Image *image) override;
+  void Discard(const Prefetcher::Image &image) override;
+
+public:
+  /// <summary>
+  /// Deletes bitmaps left behind by earlier sessions, except for the given one.
+  /// </summary>
+  void Clean(LPCWSTR keep);
+
+private:
+  std::wstring mDirectory;
+};
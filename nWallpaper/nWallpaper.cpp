@@ -5,12 +5,21 @@
 // nWallpaper entry points.
 //-------------------------------------------------------------------------------------------------
 #include "Bangs.h"
+#include "nWallpaper.h"
+#include "Slideshow.hpp"
 #include "Version.h"
+#include "WallpaperPreparer.hpp"
 
 #include "../nShared/LiteStep.h"
 #include "../nShared/LSModule.hpp"
 
+#include "../Utilities/FileIterator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <Shlwapi.h>
 #include <strsafe.h>
+#include <thread>
 
 // The LSModule class
 LSModule gLSModule(TEXT(MODULE_NAME), TEXT(MODULE_AUTHOR), MakeVersion(MODULE_VERSION));
@@ -18,6 +27,32 @@ LSModule gLSModule(TEXT(MODULE_NAME), TEXT(MODULE_AUTHOR), MakeVersion(MODULE_VE
 // The messages we want from the core
 const UINT gLSMessages[] = { LM_GETREVID, LM_REFRESH, 0 };
 
+Slideshow *gSlideshow = nullptr;
+static WallpaperPreparer *gPreparer = nullptr;
+
+// Scans the slideshow folders, so that large folders don't hold up startup.
+static std::thread gScanner;
+static std::atomic<bool> gScanCancelled(false);
+static std::vector<std::wstring> gScannedFiles;
+
+// Identifies the latest scan, so that a notification from an earlier one is ignored.
+static WPARAM gScanId = 0;
+
+static const UINT_PTR SLIDESHOW_TIMER = 1;
+
+// Posted to the message window once gScanner has finished, with the scan's id as wParam
+static const UINT NWALLPAPER_SCAN_DONE = WM_APP + 1;
+
+// The files which the slideshow picks up
+static const LPCWSTR imageExtensions[] = {
+  L".bmp", L".dib", L".gif", L".jpe", L".jpeg", L".jpg", L".jxr", L".png", L".tif", L".tiff",
+  L".wdp"
+};
+
+static void LoadSlideshow();
+static void UnloadSlideshow();
+static void OnScanDone(WPARAM scanId);
+
 
 /// <summary>
 /// Called by the LiteStep core when this module is loaded.
@@ -30,6 +65,7 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
     return 1;
   }
   Bangs::_Register();
+  LoadSlideshow();
 
   return 0;
 }
@@ -39,6 +75,7 @@ EXPORT_CDECL(int) initModuleW(HWND parent, HINSTANCE instance, LPCWSTR /* path *
 /// Called by the LiteStep core when this module is about to be unloaded.
 /// </summary>
 void quitModule(HINSTANCE /* instance */) {
+  UnloadSlideshow();
   Bangs::_Unregister();
   gLSModule.DeInitalize();
 }
@@ -63,7 +100,199 @@ LRESULT WINAPI LSMessageHandler(HWND window, UINT message, WPARAM wParam, LPARAM
     return 0;
 
   case LM_REFRESH:
+    UnloadSlideshow();
+    LoadSlideshow();
+    return 0;
+
+  case WM_TIMER:
+    if (wParam == SLIDESHOW_TIMER) {
+      ScheduleSlideshow();
+    }
+    return 0;
+
+  case NWALLPAPER_SCAN_DONE:
+    OnScanDone(wParam);
     return 0;
   }
   return DefWindowProc(window, message, wParam, lParam);
 }
+
+
+/// <summary>
+/// Adds all images in the folder to the list. Gives up if the scan is cancelled.
+/// </summary>
+static void ScanFolder(LPCWSTR folder, bool recursive, std::vector<std::wstring> &files) {
+  WCHAR pattern[MAX_PATH];
+  StringCchPrintf(pattern, _countof(pattern), L"%s\\*", folder);
+
+  std::vector<std::wstring> subFolders;
+  for (const WIN32_FIND_DATA &findData : FileIterator(pattern)) {
+    if (gScanCancelled) {
+      return;
+    }
+    std::wstring path = std::wstring(folder) + L"\\" + findData.cFileName;
+    if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+      if (recursive && wcscmp(findData.cFileName, L".") != 0 && wcscmp(findData.cFileName, L"..") != 0) {
+        subFolders.push_back(path);
+      }
+    } else {
+      LPCWSTR extension = PathFindExtension(findData.cFileName);
+      for (LPCWSTR imageExtension : imageExtensions) {
+        if (_wcsicmp(extension, imageExtension) == 0) {
+          files.push_back(path);
+          break;
+        }
+      }
+    }
+  }
+
+  for (const std::wstring &subFolder : subFolders) {
+    ScanFolder(subFolder.c_str(), recursive, files);
+  }
+}
+
+
+/// <summary>
+/// Scans the folders into gScannedFiles, sorted, on the scanner thread.
+/// </summary>
+static void ScanFolders(std::vector<std::wstring> folders, bool recursive, HWND notify,
+    WPARAM scanId) {
+  std::vector<std::wstring> files;
+  for (const std::wstring &folder : folders) {
+    ScanFolder(folder.c_str(), recursive, files);
+  }
+
+  // Sort in the same order as explorer, so that a sequential slideshow makes sense.
+  std::sort(files.begin(), files.end(), [] (const std::wstring &a, const std::wstring &b) {
+    return StrCmpLogicalW(a.c_str(), b.c_str()) < 0;
+  });
+
+  gScannedFiles = std::move(files);
+  if (!gScanCancelled) {
+    PostMessage(notify, NWALLPAPER_SCAN_DONE, scanId, 0);
+  }
+}
+
+
+/// <summary>
+/// Sets the wallpaper.
+/// </summary>
+static void SetWallpaper(const std::wstring &file) {
+  SHSetValue(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"Wallpaper", REG_SZ, file.c_str(),
+    DWORD(file.length() + 1)*sizeof(wchar_t));
+  SendNotifyMessage(HWND_BROADCAST, WM_SETTINGCHANGE, SPI_SETDESKWALLPAPER, 0);
+}
+
+
+/// <summary>
+/// Sets up the slideshow, if any folders have been configured.
+/// </summary>
+static void LoadSlideshow() {
+  using namespace LiteStep;
+
+  std::vector<std::wstring> folders;
+  IterateOverLineTokens(L"*nWallpaperSlideshowFolder", [&folders] (LPCWSTR folder) {
+    folders.push_back(folder);
+  });
+  if (folders.empty()) {
+    return;
+  }
+
+  WCHAR directory[MAX_PATH];
+  PWSTR localAppData;
+  if (FAILED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData))) {
+    return;
+  }
+  StringCchPrintf(directory, _countof(directory), L"%s\\nModules\\nWallpaper\\Slideshow", localAppData);
+  CoTaskMemFree(localAppData);
+
+  // The current wallpaper may be one we prepared last time.
+  WCHAR current[MAX_PATH] = L"";
+  DWORD size = sizeof(current), type;
+  SHGetValue(HKEY_CURRENT_USER, L"Control Panel\\Desktop", L"Wallpaper", &type, current, &size);
+
+  gPreparer = new WallpaperPreparer(directory);
+  gPreparer->Clean(current);
+
+  Playlist::Order order = Playlist::Order::Shuffle;
+  WCHAR orderName[32];
+  GetRCString(L"nWallpaperSlideshowOrder", orderName, L"Shuffle", _countof(orderName));
+  if (_wcsicmp(orderName, L"Sequential") == 0) {
+    order = Playlist::Order::Sequential;
+  } else if (_wcsicmp(orderName, L"Random") == 0) {
+    order = Playlist::Order::Random;
+  }
+
+  gSlideshow = new Slideshow(gPreparer, SetWallpaper);
+  gSlideshow->SetSeed(GetTickCount());
+  gSlideshow->SetOrder(order);
+  gSlideshow->SetInterval(uint64_t(std::max(1, GetRCInt(L"nWallpaperSlideshowInterval", 300))) * 1000);
+  gSlideshow->SetPrefetch(std::max(1, GetRCInt(L"nWallpaperSlideshowPrefetch", 2)),
+    uint64_t(std::max(1, GetRCInt(L"nWallpaperSlideshowPrefetchMemory", 256))) << 20);
+  gSlideshow->Start(GetTickCount64());
+
+  // The files arrive in OnScanDone. Until then, the slideshow has nothing to switch to.
+  gScanCancelled = false;
+  gScanner = std::thread(ScanFolders, std::move(folders),
+    GetRCBool(L"nWallpaperSlideshowRecursive", TRUE) != FALSE, gLSModule.GetMessageWindow(),
+    ++gScanId);
+
+  ScheduleSlideshow();
+}
+
+
+/// <summary>
+/// Hands the scanned files to the slideshow.
+/// </summary>
+static void OnScanDone(WPARAM scanId) {
+  if (scanId != gScanId || !gScanner.joinable()) {
+    return;
+  }
+  gScanner.join();
+
+  if (gScannedFiles.empty()) {
+    UnloadSlideshow();
+  } else if (gSlideshow) {
+    gSlideshow->SetFiles(std::move(gScannedFiles));
+  }
+  gScannedFiles.clear();
+}
+
+
+/// <summary>
+/// Stops the slideshow.
+/// </summary>
+static void UnloadSlideshow() {
+  if (gScanner.joinable()) {
+    gScanCancelled = true;
+    gScanner.join();
+    gScannedFiles.clear();
+  }
+  KillTimer(gLSModule.GetMessageWindow(), SLIDESHOW_TIMER);
+  if (gSlideshow) {
+    delete gSlideshow;
+    gSlideshow = nullptr;
+  }
+  if (gPreparer) {
+    delete gPreparer;
+    gPreparer = nullptr;
+  }
+}
+
+
+/// <summary>
+/// Switches wallpaper if it's time to, and sets the timer for the next switch.
+/// </summary>
+void ScheduleSlideshow() {
+  if (!gSlideshow) {
+    return;
+  }
+
+  uint64_t delay = gSlideshow->Update(GetTickCount64());
+  if (delay == Slideshow::NEVER) {
+    KillTimer(gLSModule.GetMessageWindow(), SLIDESHOW_TIMER);
+  } else {
+    SetTimer(gLSModule.GetMessageWindow(), SLIDESHOW_TIMER,
+      UINT(std::min<uint64_t>(delay, USER_TIMER_MAXIMUM)), nullptr);
+  }
+}
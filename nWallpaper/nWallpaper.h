@@ -0,0 +1,17 @@
+//-------------------------------------------------------------------------------------------------
+// /nWallpaper/nWallpaper.h
+// The nModules Project
+//
+// General declarations for nWallpaper.
+//-------------------------------------------------------------------------------------------------
+#pragma once
+
+class Slideshow;
+
+// The slideshow, if one has been configured.
+extern Slideshow *gSlideshow;
+
+/// <summary>
+/// Switches wallpaper if it's time to, and sets the timer for the next switch.
+/// </summary>
+void ScheduleSlideshow();